@@ -125,17 +125,26 @@ struct PlaybackEvent {
   engine_version: Option<String>,
 }
 
+// Owned by the cpal data callback, which never takes a lock: live controls
+// reach the context through its posted-command queue instead.
 struct PlaybackRenderState {
   live: sbagenxlib::LivePlaybackContext,
   output_channels: usize,
   scratch: Vec<f32>,
   finished: bool,
-  error: Option<String>,
+  status: Arc<PlaybackStatus>,
+  errors: std::sync::mpsc::Sender<String>,
+}
+
+#[derive(Default)]
+struct PlaybackStatus {
+  finished: AtomicBool,
 }
 
 struct LivePlaybackSession {
   stop_flag: Arc<AtomicBool>,
-  shared: Arc<Mutex<PlaybackRenderState>>,
+  controls: Arc<Mutex<sbagenxlib::LiveControlHandle>>,
+  status: Arc<PlaybackStatus>,
   thread: Option<JoinHandle<()>>,
 }
 
@@ -165,7 +174,8 @@ struct LiveControlArgs {
 
 struct PlaybackStartup {
   result: LivePreviewResult,
-  shared: Arc<Mutex<PlaybackRenderState>>,
+  controls: Arc<Mutex<sbagenxlib::LiveControlHandle>>,
+  status: Arc<PlaybackStatus>,
 }
 
 #[derive(Serialize)]
@@ -481,11 +491,11 @@ fn stop_active_session(controller: &PlaybackController) {
   }
 }
 
-fn with_live_playback_state<T, F>(controller: &PlaybackController, f: F) -> Result<T, String>
+fn with_live_controls<T, F>(controller: &PlaybackController, f: F) -> Result<T, String>
 where
-  F: FnOnce(&mut PlaybackRenderState) -> Result<T, String>,
+  F: FnOnce(&mut sbagenxlib::LiveControlHandle) -> Result<T, String>,
 {
-  let shared = {
+  let (controls, status) = {
     let guard = controller
       .session
       .lock()
@@ -493,19 +503,19 @@ where
     let session = guard
       .as_ref()
       .ok_or_else(|| "no live preview is currently running".to_string())?;
-    session.shared.clone()
+    (session.controls.clone(), session.status.clone())
   };
 
-  let mut state = shared
-    .lock()
-    .map_err(|_| "failed to access live playback state".to_string())?;
-  if state.finished || state.live.is_finished() {
+  if status.finished.load(Ordering::SeqCst) {
     return Err("live preview is not running".to_string());
   }
-  f(&mut state)
+  let mut controls = controls
+    .lock()
+    .map_err(|_| "failed to access live playback controls".to_string())?;
+  f(&mut controls)
 }
 
-fn render_into_output<T>(data: &mut [T], shared: &Arc<Mutex<PlaybackRenderState>>, stop: &Arc<AtomicBool>)
+fn render_into_output<T>(data: &mut [T], state: &mut PlaybackRenderState, stop: &Arc<AtomicBool>)
 where
   T: cpal::Sample + cpal::FromSample<f32>,
 {
@@ -513,77 +523,40 @@ where
     return;
   }
 
-  let output_channels = {
-    let guard = match shared.lock() {
-      Ok(guard) => guard,
-      Err(_) => {
-        for sample in data.iter_mut() {
-          *sample = T::from_sample(0.0);
-        }
-        return;
-      }
-    };
-    guard.output_channels.max(1)
-  };
-
-  if stop.load(Ordering::SeqCst) {
+  if stop.load(Ordering::SeqCst) || state.finished {
     for sample in data.iter_mut() {
       *sample = T::from_sample(0.0);
     }
     return;
   }
 
+  let output_channels = state.output_channels.max(1);
   let frames = data.len() / output_channels;
   if frames == 0 {
     return;
   }
 
-  let mut guard = match shared.lock() {
-    Ok(guard) => guard,
-    Err(_) => {
-      for sample in data.iter_mut() {
-        *sample = T::from_sample(0.0);
-      }
-      return;
-    }
-  };
-
-  if guard.finished {
-    for sample in data.iter_mut() {
-      *sample = T::from_sample(0.0);
-    }
-    return;
-  }
-
-  let mut scratch = std::mem::take(&mut guard.scratch);
-  if scratch.len() < frames * 2 {
-    scratch.resize(frames * 2, 0.0);
+  if state.scratch.len() < frames * 2 {
+    state.scratch.resize(frames * 2, 0.0);
   }
 
-  let render_result = guard.live.render_interleaved_f32(&mut scratch[..frames * 2]);
-  let mut restore_now = false;
-  let rendered_frames = match render_result {
+  let rendered_frames = match state.live.render_interleaved_f32(&mut state.scratch[..frames * 2]) {
     Ok(rendered_frames) => rendered_frames,
     Err(err) => {
-      guard.error = Some(err);
-      guard.finished = true;
-      restore_now = true;
-      0
+      let _ = state.errors.send(err);
+      state.finished = true;
+      state.status.finished.store(true, Ordering::SeqCst);
+      for sample in data.iter_mut() {
+        *sample = T::from_sample(0.0);
+      }
+      return;
     }
   };
 
-  if restore_now {
-    guard.scratch = scratch;
-    for sample in data.iter_mut() {
-      *sample = T::from_sample(0.0);
-    }
-    return;
-  }
-
   for frame_idx in 0..frames {
     let (left, right) = if frame_idx < rendered_frames {
       let base = frame_idx * 2;
-      (scratch[base], scratch[base + 1])
+      (state.scratch[base], state.scratch[base + 1])
     } else {
       (0.0, 0.0)
     };
@@ -601,10 +574,10 @@ where
     }
   }
 
-  if rendered_frames < frames || guard.live.is_finished() {
-    guard.finished = true;
+  if rendered_frames < frames || state.live.is_finished() {
+    state.finished = true;
+    state.status.finished.store(true, Ordering::SeqCst);
   }
-  guard.scratch = scratch;
 }
 
 fn program_request_from_args(args: ProgramRequestArgs) -> Result<sbagenxlib::ProgramRuntimeRequest, String> {
@@ -661,24 +634,36 @@ where
       }
     };
 
-    let shared = Arc::new(Mutex::new(PlaybackRenderState {
+    let duration_sec = live.duration_sec();
+    let limited = live.limited();
+    let engine_version = live.engine_version();
+    let controls = match live.control_handle() {
+      Ok(controls) => Arc::new(Mutex::new(controls)),
+      Err(err) => {
+        let _ = startup_tx.send(Err(err));
+        return;
+      }
+    };
+    let status = Arc::new(PlaybackStatus::default());
+    let (error_tx, error_rx) = std::sync::mpsc::channel();
+    let mut render_state = PlaybackRenderState {
       live,
       output_channels,
       scratch: Vec::new(),
       finished: false,
-      error: None,
-    }));
+      status: status.clone(),
+      errors: error_tx,
+    };
 
     let stream_config: cpal::StreamConfig = default_config.config();
     let stream = match default_config.sample_format() {
       cpal::SampleFormat::F32 => {
-        let shared = shared.clone();
         let stop = stop_flag.clone();
         let app_for_errors = app.clone();
         let stop_for_errors = stop_flag.clone();
         device.build_output_stream(
           &stream_config,
-          move |data: &mut [f32], _| render_into_output(data, &shared, &stop),
+          move |data: &mut [f32], _| render_into_output(data, &mut render_state, &stop),
           move |err| {
             emit_playback_event(
               &app_for_errors,
@@ -699,13 +684,12 @@ where
         )
       }
       cpal::SampleFormat::I16 => {
-        let shared = shared.clone();
         let stop = stop_flag.clone();
         let app_for_errors = app.clone();
         let stop_for_errors = stop_flag.clone();
         device.build_output_stream(
           &stream_config,
-          move |data: &mut [i16], _| render_into_output(data, &shared, &stop),
+          move |data: &mut [i16], _| render_into_output(data, &mut render_state, &stop),
           move |err| {
             emit_playback_event(
               &app_for_errors,
@@ -726,13 +710,12 @@ where
         )
       }
       cpal::SampleFormat::U16 => {
-        let shared = shared.clone();
         let stop = stop_flag.clone();
         let app_for_errors = app.clone();
         let stop_for_errors = stop_flag.clone();
         device.build_output_stream(
           &stream_config,
-          move |data: &mut [u16], _| render_into_output(data, &shared, &stop),
+          move |data: &mut [u16], _| render_into_output(data, &mut render_state, &stop),
           move |err| {
             emit_playback_event(
               &app_for_errors,
@@ -780,21 +763,6 @@ where
       return;
     }
 
-    let (duration_sec, limited, engine_version) = {
-      let guard = match shared.lock() {
-        Ok(guard) => guard,
-        Err(_) => {
-          let _ = startup_tx.send(Err("failed to read live playback state".to_string()));
-          return;
-        }
-      };
-      (
-        guard.live.duration_sec(),
-        guard.live.limited(),
-        guard.live.engine_version(),
-      )
-    };
-
     let start_result = LivePreviewResult {
       duration_sec,
       limited,
@@ -805,7 +773,8 @@ where
     };
     let _ = startup_tx.send(Ok(PlaybackStartup {
       result: start_result.clone(),
-      shared: shared.clone(),
+      controls,
+      status: status.clone(),
     }));
     emit_playback_event(
       &app,
@@ -817,7 +786,7 @@ where
         sample_rate_hz: Some(sample_rate_hz),
         channels: Some(output_channels as u16),
         bridge: "tauri-rust",
-        engine_version: Some(engine_version),
+        engine_version: Some(engine_version.clone()),
       },
     );
 
@@ -826,22 +795,10 @@ where
         break;
       }
 
-      let (finished, error, engine_version, duration_sec, limited) = {
-        let mut guard = match shared.lock() {
-          Ok(guard) => guard,
-          Err(_) => break,
-        };
-        let error = guard.error.take();
-        (
-          guard.finished,
-          error,
-          guard.live.engine_version(),
-          guard.live.duration_sec(),
-          guard.live.limited(),
-        )
-      };
-
-      if let Some(message) = error {
+      // The callback sends its error before it flags the end, so checking
+      // in the other order never reports a failed preview as finished.
+      let finished = status.finished.load(Ordering::SeqCst);
+      if let Ok(message) = error_rx.try_recv() {
         emit_playback_event(
           &app,
           PlaybackEvent {
@@ -1248,7 +1205,8 @@ fn start_live_preview(
     Ok(Ok(startup)) => {
       let session = LivePlaybackSession {
         stop_flag,
-        shared: startup.shared,
+        controls: startup.controls,
+        status: startup.status,
         thread: Some(playback_thread),
       };
       let mut guard = controller
@@ -1289,7 +1247,8 @@ fn start_program_live_preview(
     Ok(Ok(startup)) => {
       let session = LivePlaybackSession {
         stop_flag,
-        shared: startup.shared,
+        controls: startup.controls,
+        status: startup.status,
         thread: Some(playback_thread),
       };
       let mut guard = controller
@@ -1338,8 +1297,8 @@ fn stop_live_preview(
 fn get_live_preview_controls(
   controller: State<'_, PlaybackController>,
 ) -> Result<LiveControlSnapshot, String> {
-  with_live_playback_state(controller.inner(), |state| {
-    let snapshot = state.live.snapshot_live_controls()?;
+  with_live_controls(controller.inner(), |controls| {
+    let snapshot = controls.snapshot_live_controls()?;
     Ok(LiveControlSnapshot {
       time_sec: snapshot.time_sec,
       carrier_hz: snapshot.carrier_hz,
@@ -1357,8 +1316,8 @@ fn apply_live_preview_controls(
   controller: State<'_, PlaybackController>,
   args: LiveControlArgs,
 ) -> Result<LiveControlSnapshot, String> {
-  with_live_playback_state(controller.inner(), |state| {
-    let snapshot = state.live.apply_live_controls(
+  with_live_controls(controller.inner(), |controls| {
+    let snapshot = controls.apply_live_controls(
       args.carrier_hz,
       args.beat_hz,
       args.amplitude_pct,
@@ -1381,8 +1340,8 @@ fn apply_live_preview_controls(
 fn clear_live_preview_controls(
   controller: State<'_, PlaybackController>,
 ) -> Result<LiveControlSnapshot, String> {
-  with_live_playback_state(controller.inner(), |state| {
-    let snapshot = state.live.clear_live_controls()?;
+  with_live_controls(controller.inner(), |controls| {
+    let snapshot = controls.clear_live_controls()?;
     Ok(LiveControlSnapshot {
       time_sec: snapshot.time_sec,
       carrier_hz: snapshot.carrier_hz,
@@ -8,12 +8,14 @@ use std::os::unix::ffi::OsStrExt;
 use std::os::windows::ffi::OsStrExt;
 use std::os::raw::{c_char, c_int, c_void};
 use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
 use std::time::{SystemTime, UNIX_EPOCH};
 
 const SBX_MAX_AMP_ADJUST_POINTS: usize = 16;
 const SBX_DIAG_CODE_MAX: usize = 32;
 const SBX_DIAG_MESSAGE_MAX: usize = 256;
 const SBX_OK: c_int = 0;
+const SBX_EBUSY: c_int = 4;
 const SBX_DIAG_ERROR: c_int = 1;
 const SBX_AUDIO_FILE_WAV: c_int = 1;
 const SBX_AUDIO_FILE_OGG: c_int = 2;
@@ -347,6 +349,8 @@ struct SbxCurveTimelineConfig {
   slide: c_int,
   mute_program_tone: c_int,
   fade_sec: f64,
+  adaptive_tolerance: f64,
+  adaptive_max_gap_sec: f64,
 }
 
 #[repr(C)]
@@ -355,6 +359,7 @@ struct SbxCurveTimeline {
   program_frame_count: usize,
   mix_frames: *mut SbxMixAmpKeyframe,
   mix_frame_count: usize,
+  max_error: f64,
 }
 
 #[repr(C)]
@@ -480,6 +485,22 @@ struct SbxToneSpec {
   iso_edge_mode: c_int,
 }
 
+// Mirrors the C layout; the live preview reads only the tone and mix level.
+#[repr(C)]
+#[derive(Clone, Copy)]
+#[allow(dead_code)]
+struct SbxRuntimeTelemetry {
+  time_sec: f64,
+  source_mode: c_int,
+  primary_tone: SbxToneSpec,
+  program_beat_hz: f64,
+  program_carrier_hz: f64,
+  mix_amp_pct: f64,
+  voice_count: usize,
+  aux_tone_count: usize,
+  mix_effect_count: usize,
+}
+
 type SbxDefaultEngineConfig = unsafe extern "C" fn(*mut SbxEngineConfig);
 type SbxDefaultToneSpec = unsafe extern "C" fn(*mut SbxToneSpec);
 type SbxDefaultIsoEnvelopeSpec = unsafe extern "C" fn(*mut SbxIsoEnvelopeSpec);
@@ -569,9 +590,13 @@ type SbxContextSampleIsochronicCycle = unsafe extern "C" fn(
   *mut f64,
   *mut f64,
 ) -> c_int;
-type SbxContextSetLiveControl = unsafe extern "C" fn(*mut SbxContext, c_int, f64) -> c_int;
-type SbxContextRampLiveControl = unsafe extern "C" fn(*mut SbxContext, c_int, f64, f64) -> c_int;
-type SbxContextClearLiveControls = unsafe extern "C" fn(*mut SbxContext);
+type SbxContextPostLiveControl = unsafe extern "C" fn(*mut SbxContext, c_int, f64, f64) -> c_int;
+type SbxContextPostClearLiveControls = unsafe extern "C" fn(*mut SbxContext) -> c_int;
+type SbxContextGetRuntimeTelemetry =
+  unsafe extern "C" fn(*mut SbxContext, *mut SbxRuntimeTelemetry) -> c_int;
+type SbxContextSetTelemetryStream = unsafe extern "C" fn(*mut SbxContext, f64, usize) -> c_int;
+type SbxContextReadTelemetry =
+  unsafe extern "C" fn(*mut SbxContext, *mut SbxRuntimeTelemetry, usize) -> usize;
 type SbxVersion = unsafe extern "C" fn() -> *const c_char;
 type SbxApiVersion = unsafe extern "C" fn() -> c_int;
 type SbxFillAbiLayoutInfo = unsafe extern "C" fn(*mut SbxAbiLayoutInfo);
@@ -625,7 +650,7 @@ type SbxRuntimeContextCreateFromCurveProgram = unsafe extern "C" fn(
   *mut *mut SbxContext,
 ) -> c_int;
 
-const EXPECTED_SBX_API_VERSION: i32 = 47;
+const EXPECTED_SBX_API_VERSION: i32 = 64;
 
 fn rust_abi_layout_info() -> SbxAbiLayoutInfo {
   SbxAbiLayoutInfo {
@@ -978,9 +1003,11 @@ struct Api {
   sbx_context_sample_program_beat_voice: SbxContextSampleProgramBeatVoice,
   sbx_context_sample_tones_voice: SbxContextSampleTonesVoice,
   sbx_context_sample_isochronic_cycle: SbxContextSampleIsochronicCycle,
-  sbx_context_set_live_control: SbxContextSetLiveControl,
-  sbx_context_ramp_live_control: SbxContextRampLiveControl,
-  sbx_context_clear_live_controls: SbxContextClearLiveControls,
+  sbx_context_post_live_control: SbxContextPostLiveControl,
+  sbx_context_post_clear_live_controls: SbxContextPostClearLiveControls,
+  sbx_context_get_runtime_telemetry: SbxContextGetRuntimeTelemetry,
+  sbx_context_set_telemetry_stream: SbxContextSetTelemetryStream,
+  sbx_context_read_telemetry: SbxContextReadTelemetry,
   sbx_audio_writer_create_path: SbxAudioWriterCreatePath,
   sbx_audio_writer_close: SbxAudioWriterClose,
   sbx_audio_writer_destroy: SbxAudioWriterDestroy,
@@ -1087,8 +1114,23 @@ impl LiveLoadedContext {
   }
 }
 
-pub(crate) struct LivePlaybackContext {
+/// Context shared by a live preview's audio callback, which renders, and its
+/// control handle, which posts live controls and reads telemetry. Both sides
+/// only use the library's lock-free queue and telemetry ring, so neither
+/// waits on the other; the context goes when the last of them is dropped.
+struct LiveShared {
   loaded: LiveLoadedContext,
+}
+
+unsafe impl Send for LiveShared {}
+unsafe impl Sync for LiveShared {}
+
+const LIVE_TELEMETRY_RATE_HZ: f64 = 30.0;
+const LIVE_TELEMETRY_CAPACITY: usize = 16;
+
+pub(crate) struct LivePlaybackContext {
+  shared: Arc<LiveShared>,
+  mix_input: Option<MixInputResource>,
   volume_mul: f32,
   remaining_frames: Option<usize>,
   finished: bool,
@@ -1099,13 +1141,51 @@ pub(crate) struct LivePlaybackContext {
 
 unsafe impl Send for LivePlaybackContext {}
 
+impl Drop for LivePlaybackContext {
+  fn drop(&mut self) {
+    if let Some(mix_input) = self.mix_input.take() {
+      unsafe { (self.shared.loaded.api().sbx_mix_input_destroy)(mix_input.handle) };
+    }
+  }
+}
+
 impl LivePlaybackContext {
+  fn new(
+    loaded: LiveLoadedContext,
+    mix_input: Option<MixInputResource>,
+    volume_mul: f32,
+    remaining_frames: Option<usize>,
+    duration_sec: f64,
+  ) -> Result<Self, String> {
+    let rc = unsafe {
+      (loaded.api().sbx_context_set_telemetry_stream)(
+        loaded.ctx(),
+        LIVE_TELEMETRY_RATE_HZ,
+        LIVE_TELEMETRY_CAPACITY,
+      )
+    };
+    let live = LivePlaybackContext {
+      shared: Arc::new(LiveShared { loaded }),
+      mix_input,
+      volume_mul,
+      remaining_frames,
+      finished: false,
+      duration_sec,
+      limited: false,
+      mix_buf: Vec::new(),
+    };
+    if rc != SBX_OK {
+      return Err("failed to enable live preview telemetry".to_string());
+    }
+    Ok(live)
+  }
+
   pub(crate) fn channel_count(&self) -> usize {
-    self.loaded.engine_cfg().channels.max(1) as usize
+    self.shared.loaded.engine_cfg().channels.max(1) as usize
   }
 
   pub(crate) fn engine_version(&self) -> String {
-    self.loaded.api().version_string()
+    self.shared.loaded.api().version_string()
   }
 
   pub(crate) fn duration_sec(&self) -> f64 {
@@ -1120,31 +1200,12 @@ impl LivePlaybackContext {
     self.finished
   }
 
-  pub(crate) fn snapshot_live_controls(&mut self) -> Result<LiveControlSnapshotOutcome, String> {
-    let api = self.loaded.api();
-    let ctx = self.loaded.ctx();
-    let t_sec = unsafe { (api.sbx_context_time_sec)(ctx) };
-    let mut tone = SbxToneSpec {
-      mode: SBX_TONE_BINAURAL,
-      carrier_hz: 0.0,
-      beat_hz: 0.0,
-      orbit_hz: 0.0,
-      orbit_distance_m: 1.0,
-      orbit_envelope_mode: 0,
-      amplitude: 0.0,
-      waveform: SBX_WAVE_SINE,
-      envelope_waveform: SBX_WAVE_SINE,
-      noise_waveform: SBX_WAVE_SINE,
-      duty_cycle: 0.0,
-      iso_start: 0.0,
-      iso_attack: 0.0,
-      iso_release: 0.0,
-      iso_edge_mode: 0,
-    };
-    unsafe { (api.sbx_default_tone_spec)(&mut tone) };
-    let rc = unsafe {
-      (api.sbx_context_sample_tones_voice)(ctx, 0, t_sec, t_sec, 1, std::ptr::null_mut(), &mut tone)
-    };
+  /// Control handle for the UI thread; take it before rendering starts.
+  pub(crate) fn control_handle(&self) -> Result<LiveControlHandle, String> {
+    let api = self.shared.loaded.api();
+    let ctx = self.shared.loaded.ctx();
+    let mut telemetry = unsafe { std::mem::zeroed::<SbxRuntimeTelemetry>() };
+    let rc = unsafe { (api.sbx_context_get_runtime_telemetry)(ctx, &mut telemetry) };
     if rc != SBX_OK {
       let msg = unsafe { cstr_to_string((api.sbx_context_last_error)(ctx)) };
       return Err(if msg.is_empty() {
@@ -1153,74 +1214,13 @@ impl LivePlaybackContext {
         msg
       });
     }
-
-    Ok(LiveControlSnapshotOutcome {
-      time_sec: t_sec,
-      carrier_hz: tone.carrier_hz,
-      beat_hz: tone.beat_hz,
-      amplitude_pct: tone.amplitude,
-      mix_amp_pct: unsafe { (api.sbx_context_mix_amp_effective_at)(ctx, t_sec) },
-      engine_version: api.version_string(),
+    Ok(LiveControlHandle {
+      shared: self.shared.clone(),
+      last: telemetry,
+      read_buf: vec![telemetry; LIVE_TELEMETRY_CAPACITY],
     })
   }
 
-  pub(crate) fn apply_live_controls(
-    &mut self,
-    carrier_hz: Option<f64>,
-    beat_hz: Option<f64>,
-    amplitude_pct: Option<f64>,
-    mix_amp_pct: Option<f64>,
-    ramp_sec: Option<f64>,
-  ) -> Result<LiveControlSnapshotOutcome, String> {
-    let api = self.loaded.api();
-    let ctx = self.loaded.ctx();
-    let ramp_sec = ramp_sec.unwrap_or(0.0);
-    if !ramp_sec.is_finite() || ramp_sec < 0.0 {
-      return Err("live control ramp duration must be finite and >= 0".to_string());
-    }
-
-    let apply = |kind: c_int, value: f64| -> Result<(), String> {
-      let rc = unsafe {
-        if ramp_sec > 0.0 {
-          (api.sbx_context_ramp_live_control)(ctx, kind, value, ramp_sec)
-        } else {
-          (api.sbx_context_set_live_control)(ctx, kind, value)
-        }
-      };
-      if rc != SBX_OK {
-        let msg = unsafe { cstr_to_string((api.sbx_context_last_error)(ctx)) };
-        return Err(if msg.is_empty() {
-          "failed to apply live control".to_string()
-        } else {
-          msg
-        });
-      }
-      Ok(())
-    };
-
-    if let Some(value) = carrier_hz {
-      apply(SBX_LIVE_CONTROL_CARRIER_HZ, value)?;
-    }
-    if let Some(value) = beat_hz {
-      apply(SBX_LIVE_CONTROL_BEAT_HZ, value)?;
-    }
-    if let Some(value) = amplitude_pct {
-      apply(SBX_LIVE_CONTROL_AMPLITUDE, value)?;
-    }
-    if let Some(value) = mix_amp_pct {
-      apply(SBX_LIVE_CONTROL_MIX_AMP_PCT, value)?;
-    }
-
-    self.snapshot_live_controls()
-  }
-
-  pub(crate) fn clear_live_controls(&mut self) -> Result<LiveControlSnapshotOutcome, String> {
-    let api = self.loaded.api();
-    let ctx = self.loaded.ctx();
-    unsafe { (api.sbx_context_clear_live_controls)(ctx) };
-    self.snapshot_live_controls()
-  }
-
   pub(crate) fn render_interleaved_f32(&mut self, out: &mut [f32]) -> Result<usize, String> {
     if self.finished {
       out.fill(0.0);
@@ -1248,28 +1248,17 @@ impl LivePlaybackContext {
     }
 
     let sample_count = frames * channels;
-    let rendered_frames = match &mut self.loaded {
-      LiveLoadedContext::Sequence(loaded) => render_frames_with_mix(
-        &loaded.api,
-        loaded.ctx,
-        &loaded.engine_cfg,
-        &mut loaded.mix_input,
-        &mut self.mix_buf,
-        &mut out[..sample_count],
-        frames,
-        self.volume_mul,
-      )?,
-      LiveLoadedContext::Program(loaded) => render_frames_with_mix(
-        &loaded.api,
-        loaded.ctx,
-        &loaded.engine_cfg,
-        &mut loaded.mix_input,
-        &mut self.mix_buf,
-        &mut out[..sample_count],
-        frames,
-        self.volume_mul,
-      )?,
-    };
+    let loaded = &self.shared.loaded;
+    let rendered_frames = render_frames_with_mix(
+      loaded.api(),
+      loaded.ctx(),
+      loaded.engine_cfg(),
+      &mut self.mix_input,
+      &mut self.mix_buf,
+      &mut out[..sample_count],
+      frames,
+      self.volume_mul,
+    )?;
     if rendered_frames == 0 {
       self.finished = true;
       out.fill(0.0);
@@ -1292,6 +1281,111 @@ impl LivePlaybackContext {
   }
 }
 
+/// UI-thread side of a live preview. Live controls go through the context's
+/// posted-command queue and take effect at the next rendered block; the tone
+/// and mix level reported back come from the decimated telemetry stream. One
+/// thread at a time may use a handle.
+pub(crate) struct LiveControlHandle {
+  shared: Arc<LiveShared>,
+  last: SbxRuntimeTelemetry,
+  read_buf: Vec<SbxRuntimeTelemetry>,
+}
+
+unsafe impl Send for LiveControlHandle {}
+
+impl LiveControlHandle {
+  fn poll_telemetry(&mut self) {
+    let api = self.shared.loaded.api();
+    let ctx = self.shared.loaded.ctx();
+    loop {
+      let count = unsafe {
+        (api.sbx_context_read_telemetry)(ctx, self.read_buf.as_mut_ptr(), self.read_buf.len())
+      };
+      if count > 0 {
+        self.last = self.read_buf[count - 1];
+      }
+      if count < self.read_buf.len() {
+        break;
+      }
+    }
+  }
+
+  fn outcome(&self) -> LiveControlSnapshotOutcome {
+    LiveControlSnapshotOutcome {
+      time_sec: self.last.time_sec,
+      carrier_hz: self.last.primary_tone.carrier_hz,
+      beat_hz: self.last.primary_tone.beat_hz,
+      amplitude_pct: self.last.primary_tone.amplitude,
+      mix_amp_pct: self.last.mix_amp_pct,
+      engine_version: self.shared.loaded.api().version_string(),
+    }
+  }
+
+  pub(crate) fn snapshot_live_controls(&mut self) -> Result<LiveControlSnapshotOutcome, String> {
+    self.poll_telemetry();
+    Ok(self.outcome())
+  }
+
+  pub(crate) fn apply_live_controls(
+    &mut self,
+    carrier_hz: Option<f64>,
+    beat_hz: Option<f64>,
+    amplitude_pct: Option<f64>,
+    mix_amp_pct: Option<f64>,
+    ramp_sec: Option<f64>,
+  ) -> Result<LiveControlSnapshotOutcome, String> {
+    let api = self.shared.loaded.api();
+    let ctx = self.shared.loaded.ctx();
+    let ramp_sec = ramp_sec.unwrap_or(0.0);
+    if !ramp_sec.is_finite() || ramp_sec < 0.0 {
+      return Err("live control ramp duration must be finite and >= 0".to_string());
+    }
+
+    let post = |kind: c_int, value: f64| -> Result<(), String> {
+      let rc = unsafe { (api.sbx_context_post_live_control)(ctx, kind, value, ramp_sec) };
+      match rc {
+        SBX_OK => Ok(()),
+        SBX_EBUSY => Err("live control queue is full; try again".to_string()),
+        _ => Err("live control value must be finite".to_string()),
+      }
+    };
+
+    if let Some(value) = carrier_hz {
+      post(SBX_LIVE_CONTROL_CARRIER_HZ, value)?;
+    }
+    if let Some(value) = beat_hz {
+      post(SBX_LIVE_CONTROL_BEAT_HZ, value)?;
+    }
+    if let Some(value) = amplitude_pct {
+      post(SBX_LIVE_CONTROL_AMPLITUDE, value)?;
+    }
+    if let Some(value) = mix_amp_pct {
+      post(SBX_LIVE_CONTROL_MIX_AMP_PCT, value)?;
+    }
+
+    self.poll_telemetry();
+    let mut outcome = self.outcome();
+    // Immediate sets land with the next block; report them as applied.
+    if ramp_sec == 0.0 {
+      outcome.carrier_hz = carrier_hz.unwrap_or(outcome.carrier_hz);
+      outcome.beat_hz = beat_hz.unwrap_or(outcome.beat_hz);
+      outcome.amplitude_pct = amplitude_pct.unwrap_or(outcome.amplitude_pct);
+      outcome.mix_amp_pct = mix_amp_pct.unwrap_or(outcome.mix_amp_pct);
+    }
+    Ok(outcome)
+  }
+
+  pub(crate) fn clear_live_controls(&mut self) -> Result<LiveControlSnapshotOutcome, String> {
+    let api = self.shared.loaded.api();
+    let ctx = self.shared.loaded.ctx();
+    let rc = unsafe { (api.sbx_context_post_clear_live_controls)(ctx) };
+    if rc == SBX_EBUSY {
+      return Err("live control queue is full; try again".to_string());
+    }
+    self.snapshot_live_controls()
+  }
+}
+
 fn render_frames_with_mix(
   api: &Api,
   ctx: *mut SbxContext,
@@ -1491,12 +1585,16 @@ impl Api {
           Self::load_symbol(&lib, b"sbx_context_sample_tones_voice\0")?,
         sbx_context_sample_isochronic_cycle:
           Self::load_symbol(&lib, b"sbx_context_sample_isochronic_cycle\0")?,
-        sbx_context_set_live_control:
-          Self::load_symbol(&lib, b"sbx_context_set_live_control\0")?,
-        sbx_context_ramp_live_control:
-          Self::load_symbol(&lib, b"sbx_context_ramp_live_control\0")?,
-        sbx_context_clear_live_controls:
-          Self::load_symbol(&lib, b"sbx_context_clear_live_controls\0")?,
+        sbx_context_post_live_control:
+          Self::load_symbol(&lib, b"sbx_context_post_live_control\0")?,
+        sbx_context_post_clear_live_controls:
+          Self::load_symbol(&lib, b"sbx_context_post_clear_live_controls\0")?,
+        sbx_context_get_runtime_telemetry:
+          Self::load_symbol(&lib, b"sbx_context_get_runtime_telemetry\0")?,
+        sbx_context_set_telemetry_stream:
+          Self::load_symbol(&lib, b"sbx_context_set_telemetry_stream\0")?,
+        sbx_context_read_telemetry:
+          Self::load_symbol(&lib, b"sbx_context_read_telemetry\0")?,
         sbx_audio_writer_create_path:
           Self::load_symbol(&lib, b"sbx_audio_writer_create_path\0")?,
         sbx_audio_writer_close: Self::load_symbol(&lib, b"sbx_audio_writer_close\0")?,
@@ -1806,10 +1904,16 @@ fn curve_info_from_loaded_curve(api: &Api, curve: *mut SbxCurveProgram) -> Resul
   })
 }
 
-fn prepare_curve_for_program_request(
+struct ProgramCurveSetup<'a> {
+  curve_text: &'a str,
+  overrides: Vec<CurveParameterOverride>,
+  eval_cfg: SbxCurveEvalConfig,
+}
+
+fn program_curve_setup<'a>(
   api: &Api,
-  request: &ProgramRuntimeRequest,
-) -> Result<*mut SbxCurveProgram, String> {
+  request: &'a ProgramRuntimeRequest,
+) -> Result<ProgramCurveSetup<'a>, String> {
   if request.kind != ProgramKind::Curve {
     return Err("curve inspection requires the built-in curve program".to_string());
   }
@@ -1844,41 +1948,6 @@ fn prepare_curve_for_program_request(
     return Err("the curve program requires .sbgf source text".to_string());
   }
 
-  let curve = unsafe { (api.sbx_curve_create)() };
-  if curve.is_null() {
-    return Err("failed to create sbagenxlib curve program".to_string());
-  }
-
-  let c_curve_text =
-    CString::new(curve_text).map_err(|_| "curve text contains embedded NUL byte".to_string())?;
-  let c_source = CString::new(request.source_name.as_str())
-    .map_err(|_| "curve source name contains embedded NUL byte".to_string())?;
-  let load_rc = unsafe { (api.sbx_curve_load_text)(curve, c_curve_text.as_ptr(), c_source.as_ptr()) };
-  if load_rc != SBX_OK {
-    let msg = unsafe { cstr_to_string((api.sbx_curve_last_error)(curve)) };
-    unsafe { (api.sbx_curve_destroy)(curve) };
-    return Err(if msg.is_empty() {
-      "failed to load .sbgf curve text".to_string()
-    } else {
-      msg
-    });
-  }
-
-  for override_value in &parsed.curve_overrides {
-    let c_name = CString::new(override_value.name.as_str())
-      .map_err(|_| "curve parameter name contains embedded NUL byte".to_string())?;
-    let rc = unsafe { (api.sbx_curve_set_param)(curve, c_name.as_ptr(), override_value.value) };
-    if rc != SBX_OK {
-      let msg = unsafe { cstr_to_string((api.sbx_curve_last_error)(curve)) };
-      unsafe { (api.sbx_curve_destroy)(curve) };
-      return Err(if msg.is_empty() {
-        "failed to apply a curve parameter override".to_string()
-      } else {
-        msg
-      });
-    }
-  }
-
   let mut eval_cfg = SbxCurveEvalConfig {
     carrier_start_hz: 0.0,
     carrier_end_hz: 0.0,
@@ -1905,20 +1974,233 @@ fn prepare_curve_for_program_request(
   eval_cfg.beat_amp0_pct = parsed.amp_pct;
   eval_cfg.mix_amp0_pct = 100.0;
 
-  let prepare_rc = unsafe { (api.sbx_curve_prepare)(curve, &eval_cfg) };
-  if prepare_rc != SBX_OK {
-    let msg = unsafe { cstr_to_string((api.sbx_curve_last_error)(curve)) };
+  Ok(ProgramCurveSetup {
+    curve_text,
+    overrides: parsed.curve_overrides,
+    eval_cfg,
+  })
+}
+
+fn curve_error(api: &Api, curve: *mut SbxCurveProgram, fallback: &str) -> String {
+  let msg = unsafe { cstr_to_string((api.sbx_curve_last_error)(curve)) };
+  if msg.is_empty() {
+    fallback.to_string()
+  } else {
+    msg
+  }
+}
+
+fn load_program_curve(
+  api: &Api,
+  curve_text: &str,
+  source_name: &str,
+) -> Result<*mut SbxCurveProgram, String> {
+  let curve = unsafe { (api.sbx_curve_create)() };
+  if curve.is_null() {
+    return Err("failed to create sbagenxlib curve program".to_string());
+  }
+
+  let c_curve_text = CString::new(curve_text);
+  let c_source = CString::new(source_name);
+  let (c_curve_text, c_source) = match (c_curve_text, c_source) {
+    (Ok(text), Ok(source)) => (text, source),
+    (Err(_), _) => {
+      unsafe { (api.sbx_curve_destroy)(curve) };
+      return Err("curve text contains embedded NUL byte".to_string());
+    }
+    (_, Err(_)) => {
+      unsafe { (api.sbx_curve_destroy)(curve) };
+      return Err("curve source name contains embedded NUL byte".to_string());
+    }
+  };
+  let load_rc = unsafe { (api.sbx_curve_load_text)(curve, c_curve_text.as_ptr(), c_source.as_ptr()) };
+  if load_rc != SBX_OK {
+    let msg = curve_error(api, curve, "failed to load .sbgf curve text");
     unsafe { (api.sbx_curve_destroy)(curve) };
-    return Err(if msg.is_empty() {
-      "failed to prepare the .sbgf curve".to_string()
-    } else {
-      msg
-    });
+    return Err(msg);
+  }
+  Ok(curve)
+}
+
+fn set_program_curve_param(
+  api: &Api,
+  curve: *mut SbxCurveProgram,
+  name: &str,
+  value: f64,
+) -> Result<(), String> {
+  let c_name = CString::new(name)
+    .map_err(|_| "curve parameter name contains embedded NUL byte".to_string())?;
+  let rc = unsafe { (api.sbx_curve_set_param)(curve, c_name.as_ptr(), value) };
+  if rc != SBX_OK {
+    return Err(curve_error(
+      api,
+      curve,
+      "failed to apply a curve parameter override",
+    ));
+  }
+  Ok(())
+}
+
+fn prepare_program_curve(
+  api: &Api,
+  curve: *mut SbxCurveProgram,
+  eval_cfg: &SbxCurveEvalConfig,
+) -> Result<(), String> {
+  let prepare_rc = unsafe { (api.sbx_curve_prepare)(curve, eval_cfg) };
+  if prepare_rc != SBX_OK {
+    return Err(curve_error(api, curve, "failed to prepare the .sbgf curve"));
   }
+  Ok(())
+}
 
+fn prepare_curve_for_program_request(
+  api: &Api,
+  request: &ProgramRuntimeRequest,
+) -> Result<*mut SbxCurveProgram, String> {
+  let setup = program_curve_setup(api, request)?;
+  let curve = load_program_curve(api, setup.curve_text, &request.source_name)?;
+  let prepared = setup
+    .overrides
+    .iter()
+    .try_for_each(|override_value| {
+      set_program_curve_param(api, curve, &override_value.name, override_value.value)
+    })
+    .and_then(|_| prepare_program_curve(api, curve, &setup.eval_cfg));
+  if let Err(msg) = prepared {
+    unsafe { (api.sbx_curve_destroy)(curve) };
+    return Err(msg);
+  }
   Ok(curve)
 }
 
+// Curves kept prepared between requests, one per open `.sbgf` document
+// (keyed by source name), most recently used first. Moving a parameter
+// slider then only sets the changed values and re-prepares, which redoes
+// just the solve and program parts that read them.
+const PREPARED_PROGRAM_CURVE_LIMIT: usize = 8;
+static PREPARED_PROGRAM_CURVES: Mutex<Vec<PreparedProgramCurve>> = Mutex::new(Vec::new());
+
+struct PreparedProgramCurve {
+  api: Api,
+  curve: *mut SbxCurveProgram,
+  source_name: String,
+  curve_text: String,
+  // Parameter values as loaded, before any override.
+  loaded_params: Vec<(String, f64)>,
+  // Values the curve currently holds: loaded_params plus overrides.
+  params: Vec<(String, f64)>,
+}
+
+// The curve is only ever touched with PREPARED_PROGRAM_CURVES locked.
+unsafe impl Send for PreparedProgramCurve {}
+
+impl PreparedProgramCurve {
+  fn load(request: &ProgramRuntimeRequest, curve_text: &str) -> Result<Self, String> {
+    let api = Api::load()?;
+    let curve = load_program_curve(&api, curve_text, &request.source_name)?;
+    let mut loaded_params = Vec::new();
+    let param_count = unsafe { (api.sbx_curve_param_count)(curve) };
+    for index in 0..param_count {
+      let mut name_ptr: *const c_char = std::ptr::null();
+      let mut value = 0.0;
+      let rc = unsafe { (api.sbx_curve_get_param)(curve, index, &mut name_ptr, &mut value) };
+      if rc == SBX_OK {
+        loaded_params.push((cstr_to_string(name_ptr), value));
+      }
+    }
+    Ok(Self {
+      api,
+      curve,
+      source_name: request.source_name.clone(),
+      curve_text: curve_text.to_string(),
+      params: loaded_params.clone(),
+      loaded_params,
+    })
+  }
+
+  // Values the curve should hold for these overrides.
+  fn wanted_params(&self, overrides: &[CurveParameterOverride]) -> Vec<(String, f64)> {
+    let mut wanted = self.loaded_params.clone();
+    for override_value in overrides {
+      match wanted
+        .iter_mut()
+        .find(|(name, _)| *name == override_value.name)
+      {
+        Some(param) => param.1 = override_value.value,
+        None => wanted.push((override_value.name.clone(), override_value.value)),
+      }
+    }
+    wanted
+  }
+
+  // A parameter added by an earlier override cannot be taken away again;
+  // the document has to be loaded afresh when it is dropped.
+  fn can_reach(&self, wanted: &[(String, f64)]) -> bool {
+    self
+      .params
+      .iter()
+      .all(|(name, _)| wanted.iter().any(|(wanted_name, _)| wanted_name == name))
+  }
+
+  fn apply(
+    &mut self,
+    wanted: Vec<(String, f64)>,
+    eval_cfg: &SbxCurveEvalConfig,
+  ) -> Result<(), String> {
+    for (name, value) in &wanted {
+      let held = self.params.iter().find(|(held_name, _)| held_name == name);
+      if held.map(|(_, held_value)| held_value.to_bits() == value.to_bits()) == Some(true) {
+        continue;
+      }
+      set_program_curve_param(&self.api, self.curve, name, *value)?;
+    }
+    self.params = wanted;
+    prepare_program_curve(&self.api, self.curve, eval_cfg)
+  }
+}
+
+impl Drop for PreparedProgramCurve {
+  fn drop(&mut self) {
+    unsafe { (self.api.sbx_curve_destroy)(self.curve) };
+  }
+}
+
+// Runs f on the request's curve, prepared for its overrides and timing.
+// The curve stays owned by the cache; f must not keep or destroy it.
+fn with_prepared_program_curve<T>(
+  request: &ProgramRuntimeRequest,
+  f: impl FnOnce(&Api, *mut SbxCurveProgram) -> Result<T, String>,
+) -> Result<T, String> {
+  let curve_text = request
+    .curve_text
+    .as_deref()
+    .ok_or_else(|| "the curve program requires .sbgf source text".to_string())?;
+  let mut cache = PREPARED_PROGRAM_CURVES
+    .lock()
+    .unwrap_or_else(|poisoned| poisoned.into_inner());
+  let cached = cache
+    .iter()
+    .position(|entry| entry.source_name == request.source_name)
+    .map(|index| cache.remove(index));
+  let mut entry = match cached {
+    Some(entry) if entry.curve_text == curve_text => entry,
+    _ => PreparedProgramCurve::load(request, curve_text)?,
+  };
+
+  let setup = program_curve_setup(&entry.api, request)?;
+  let wanted = entry.wanted_params(&setup.overrides);
+  if !entry.can_reach(&wanted) {
+    entry = PreparedProgramCurve::load(request, curve_text)?;
+  }
+  // On failure the entry is dropped, so the next request starts clean.
+  entry.apply(wanted, &setup.eval_cfg)?;
+
+  let result = f(&entry.api, entry.curve);
+  cache.insert(0, entry);
+  cache.truncate(PREPARED_PROGRAM_CURVE_LIMIT);
+  result
+}
+
 fn program_default_source_name(kind: ProgramKind) -> String {
   format!("program:{}", kind.as_str())
 }
@@ -3159,9 +3441,9 @@ fn load_program_context_with_rate(
           result?
         }
         ProgramKind::Curve => {
-          let curve = prepare_curve_for_program_request(&api, request)?;
-
           if parsed.slide {
+            // The runtime context takes ownership of this curve.
+            let curve = prepare_curve_for_program_request(&api, request)?;
             let mut source_cfg = SbxCurveSourceConfig {
               mode: 0,
               waveform: 0,
@@ -3202,6 +3484,8 @@ fn load_program_context_with_rate(
               slide: 0,
               mute_program_tone: 0,
               fade_sec: 0.0,
+              adaptive_tolerance: 0.0,
+              adaptive_max_gap_sec: 0.0,
             };
             unsafe { (api.sbx_default_curve_timeline_config)(&mut timeline_cfg) };
             fill_program_tone_spec(
@@ -3225,13 +3509,17 @@ fn load_program_context_with_rate(
               program_frame_count: 0,
               mix_frames: std::ptr::null_mut(),
               mix_frame_count: 0,
+              max_error: 0.0,
             };
-            let timeline_rc =
-              unsafe { (api.sbx_build_curve_timeline)(curve, &timeline_cfg, &mut timeline) };
-            unsafe { (api.sbx_curve_destroy)(curve) };
-            if timeline_rc != SBX_OK {
-              return Err("failed to build the stepped curve runtime".to_string());
-            }
+            with_prepared_program_curve(request, |curve_api, curve| {
+              let timeline_rc = unsafe {
+                (curve_api.sbx_build_curve_timeline)(curve, &timeline_cfg, &mut timeline)
+              };
+              if timeline_rc != SBX_OK {
+                return Err("failed to build the stepped curve runtime".to_string());
+              }
+              Ok(())
+            })?;
 
             let result = create_runtime_context_from_keyframes(
               &api,
@@ -4136,7 +4424,7 @@ pub fn create_live_preview(
     return Err("live playback requires a valid output sample rate".to_string());
   }
 
-  let loaded = load_sbg_context_for_audio(
+  let mut loaded = load_sbg_context_for_audio(
     text,
     source_name,
     mix_path_override,
@@ -4164,15 +4452,14 @@ pub fn create_live_preview(
     0.0
   };
 
-  Ok(LivePlaybackContext {
-    loaded: LiveLoadedContext::Sequence(loaded),
+  let mix_input = loaded.mix_input.take();
+  LivePlaybackContext::new(
+    LiveLoadedContext::Sequence(loaded),
+    mix_input,
     volume_mul,
     remaining_frames,
-    finished: false,
-    duration_sec: reported_duration_sec,
-    limited: false,
-    mix_buf: Vec::new(),
-  })
+    reported_duration_sec,
+  )
 }
 
 pub fn create_live_program_preview(
@@ -4183,7 +4470,7 @@ pub fn create_live_program_preview(
     return Err("live playback requires a valid output sample rate".to_string());
   }
 
-  let loaded = load_program_context_with_rate(request, Some(sample_rate_hz as f64), true)?;
+  let mut loaded = load_program_context_with_rate(request, Some(sample_rate_hz as f64), true)?;
   let duration_sec = unsafe { (loaded.api.sbx_context_duration_sec)(loaded.ctx) };
   let is_looping = unsafe { (loaded.api.sbx_context_is_looping)(loaded.ctx) } != 0;
 
@@ -4199,15 +4486,14 @@ pub fn create_live_program_preview(
     0.0
   };
 
-  Ok(LivePlaybackContext {
-    loaded: LiveLoadedContext::Program(loaded),
-    volume_mul: 1.0,
+  let mix_input = loaded.mix_input.take();
+  LivePlaybackContext::new(
+    LiveLoadedContext::Program(loaded),
+    mix_input,
+    1.0,
     remaining_frames,
-    finished: false,
-    duration_sec: reported_duration_sec,
-    limited: false,
-    mix_buf: Vec::new(),
-  })
+    reported_duration_sec,
+  )
 }
 
 pub fn render_preview(
@@ -4370,11 +4656,7 @@ pub fn inspect_curve_info(text: &str, source_name: &str) -> Result<CurveInfoOutc
 pub fn inspect_program_curve_info(
   request: &ProgramRuntimeRequest,
 ) -> Result<CurveInfoOutcome, String> {
-  let api = Api::load()?;
-  let curve = prepare_curve_for_program_request(&api, request)?;
-  let outcome = curve_info_from_loaded_curve(&api, curve);
-  unsafe { (api.sbx_curve_destroy)(curve) };
-  outcome
+  with_prepared_program_curve(request, curve_info_from_loaded_curve)
 }
 
 pub fn normalize_source_name(source_name: Option<String>, fallback_kind: &str) -> String {
@@ -4585,6 +4867,60 @@ mod tests {
     assert!((l - 0.3).abs() < 1e-9, "expected overridden l, got {}", l);
   }
 
+  #[test]
+  fn inspect_program_curve_info_reprepares_cached_curve() {
+    let path = PathBuf::from(env!("CARGO_MANIFEST_DIR"))
+      .join("../..")
+      .join("examples/basics/curve-expfit-solve-demo.sbgf");
+    let text = fs::read_to_string(&path).expect("read solve example");
+    let request = |main_arg: &str| ProgramRuntimeRequest {
+      kind: ProgramKind::Curve,
+      main_arg: main_arg.to_string(),
+      drop_time_sec: 30 * 60,
+      hold_time_sec: 30 * 60,
+      wake_time_sec: 3 * 60,
+      iso_params_spec: None,
+      curve_text: Some(text.clone()),
+      source_name: "<reprepare-test.sbgf>".to_string(),
+      mix_path: None,
+      mix_looper_spec: None,
+    };
+    let params = |outcome: &CurveInfoOutcome| {
+      outcome
+        .parameters
+        .iter()
+        .map(|param| (param.name.clone(), param.value))
+        .collect::<Vec<_>>()
+    };
+    let fresh = |main_arg: &str| {
+      let api = Api::load().expect("load sbagenxlib api");
+      let curve = prepare_curve_for_program_request(&api, &request(main_arg)).expect("fresh curve");
+      let outcome = curve_info_from_loaded_curve(&api, curve);
+      unsafe { (api.sbx_curve_destroy)(curve) };
+      params(&outcome.expect("fresh curve info"))
+    };
+
+    // Slider moves on one document, then back to no override at all. The
+    // re-solve starts from the previous solution, so compare to tolerance.
+    for main_arg in ["00ls:l=0.3", "00ls:l=0.5", "00ls", "00ls:l=0.3"] {
+      let outcome = inspect_program_curve_info(&request(main_arg)).expect("inspect cached curve");
+      let cached = params(&outcome);
+      let want = fresh(main_arg);
+      assert_eq!(cached.len(), want.len(), "parameter count for {}", main_arg);
+      for ((name, value), (want_name, want_value)) in cached.iter().zip(want.iter()) {
+        assert_eq!(name, want_name);
+        assert!(
+          (value - want_value).abs() < 1e-9,
+          "{}: cached {} = {}, fresh {}",
+          main_arg,
+          name,
+          value,
+          want_value
+        );
+      }
+    }
+  }
+
   #[test]
   fn parse_slide_main_arg_accepts_canonical_tone_spec() {
     let parsed = parse_slide_main_arg("200+10/1").expect("parse slide main arg");
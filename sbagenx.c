@@ -257,6 +257,7 @@ void printSequenceDuration();
 void checkMixInSequence(); // Check if mix/<amp> is specified
 void emit_dry_run_report(int mode_flag, int ac, char **av);
 static void open_mix_input_stream_if_requested(void);
+static int run_validate_batch(int argc, char **argv);
 static int mix_input_bridge_read(int *dst, int dlen);
 static void mix_input_warn_bridge(void *user, const char *msg);
 void create_noise_spin_effect(
@@ -445,6 +446,26 @@ help() {
 	  NL "                      defaults m=cos:s=0:d=0.5:a=0.5:r=0.5:e=3:f=0.45"
 	  NL "                      if d/a/r/e are set without m=..., pulse mode is implied"
 	  NL "                      in m=cos mode, d/a/r/e are ignored; s/f apply"
+	  NL "          --sweep name=values"
+	  NL "                     With -p curve, evaluate the curve over a parameter grid"
+	  NL "                     and write a beat table instead of playing; values are"
+	  NL "                     v1,v2,... or start..end/count; repeat for more axes;"
+	  NL "                     name is a .sbgf param or D/H/U (minutes)"
+	  NL "          --sweep-out file"
+	  NL "                     Sweep table output (.bin = binary, else CSV; default stdout)"
+	  NL "          --sweep-samples n"
+	  NL "                     Beat samples per sweep point (default 61)"
+	  NL "          --sweep-jobs n"
+	  NL "                     Sweep worker threads (default one per CPU)"
+	  NL "          --validate-batch"
+	  NL "                     Validate the .sbg/.sbgf files given (or listed on stdin"
+	  NL "                     with -) in parallel and print JSON-lines diagnostics"
+	  NL "          --validate-jobs n"
+	  NL "                     Validation worker threads (default one per CPU)"
+	  NL "          --compile file"
+	  NL "                     Compile the sequence file to a .sbgc program and exit"
+	  NL "          --stream   Parse the sequence file (or - for stdin) while playing"
+	  NL "                     instead of loading it all first"
 	  NL "          --dry-run  Parse/build runtime plan only, then exit (no audio)"
 	  NL "          --explain  Like --dry-run, plus detailed keyframe/tone summary"
 	  NL
@@ -606,6 +627,16 @@ int opt_P_drop;		// Program graph requested for -p drop
 int opt_P_curve;		// Program graph requested for -p curve
 int opt_dry_run;		// Parse/build plan only; do not render audio/plots
 int opt_explain;		// Extended dry-run details
+#define SWEEP_MAX_AXES 16
+int opt_sweep;			// Number of --sweep axes (parameter sweep mode)
+char *opt_sweep_spec[SWEEP_MAX_AXES];	// --sweep name=values specs
+char *opt_sweep_out;		// --sweep-out file (.bin = binary, else CSV)
+int opt_sweep_samples= 61;	// Beat samples per sweep point
+int opt_sweep_jobs;		// Sweep worker threads (0 = one per CPU)
+char *opt_compile;		// --compile output file (.sbgc) for a sequence file
+int opt_stream;			// --stream: parse the sequence file lazily during playback
+int opt_validate_batch;		// --validate-batch: validate the file arguments and exit
+int opt_validate_jobs;		// Validation worker threads (0 = one per CPU)
 int opt_M, opt_S, opt_E;
 char *opt_o, *opt_m, *opt_looper;
 int opt_O;
@@ -3754,10 +3785,21 @@ main(int argc, char **argv) {
    rv= scanOptions(&argc, &argv);
 
    if (argc < 1) usage();
+
+   if (opt_validate_batch) {
+      if (rv)
+	 error("--validate-batch takes file names, not -i or -p");
+      return run_validate_batch(argc, argv);
+   }
    
-   if (!opt_dry_run)
+   if (!opt_dry_run && !opt_compile)
       open_mix_input_stream_if_requested();
 
+   if (opt_sweep && rv != 'p')
+      error("--sweep is only supported with -p curve");
+   if (opt_compile && rv)
+      error("--compile is only supported with a sequence file");
+
    if (rv == 'i') {
       // Immediate mode
       if (opt_G)
@@ -3767,7 +3809,8 @@ main(int argc, char **argv) {
       // Pre-programmed sequence
       readPreProg(argc, argv);
       if (!opt_dry_run &&
-	  (opt_G || opt_P_sigmoid || opt_P_drop || opt_P_curve || (opt_P && opt_H)))
+	  (opt_G || opt_P_sigmoid || opt_P_drop || opt_P_curve || (opt_P && opt_H) ||
+	   opt_sweep))
 	 return 0;
    } else {
       // Sequenced mode -- sequence may include options, so options
@@ -3776,6 +3819,8 @@ main(int argc, char **argv) {
 	 error("-G is only supported with -p drop/-p sigmoid/-p curve");
       if (argc < 1) usage();
       readSeq(argc, argv);
+      if (opt_compile)
+	 return 0;
    }
 
    if (opt_dry_run) {
@@ -3929,6 +3974,68 @@ scanOptions(int *acp, char ***avp) {
 	 argc--;
 	 continue;
       }
+      if (0 == strcmp(argv[0], "--sweep")) {
+	 if (argc-- < 2) error("--sweep expects name=values");
+	 argv++;
+	 if (opt_sweep >= SWEEP_MAX_AXES)
+	    error("Too many --sweep axes (max %d)", SWEEP_MAX_AXES);
+	 opt_sweep_spec[opt_sweep++]= *argv++;
+	 argc--;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--sweep-out")) {
+	 if (argc-- < 2) error("--sweep-out expects output filename");
+	 argv++;
+	 opt_sweep_out= *argv++;
+	 argc--;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--sweep-samples")) {
+	 if (argc-- < 2 || 1 != sscanf(argv[1], "%d %c", &val, &dmy) || val < 1)
+	    error("--sweep-samples expects a positive integer");
+	 argv++;
+	 opt_sweep_samples= val;
+	 argc--;
+	 argv++;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--sweep-jobs")) {
+	 if (argc-- < 2 || 1 != sscanf(argv[1], "%d %c", &val, &dmy) || val < 1)
+	    error("--sweep-jobs expects a positive integer");
+	 argv++;
+	 opt_sweep_jobs= val;
+	 argc--;
+	 argv++;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--validate-batch")) {
+	 opt_validate_batch= 1;
+	 argv++;
+	 argc--;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--validate-jobs")) {
+	 if (argc-- < 2 || 1 != sscanf(argv[1], "%d %c", &val, &dmy) || val < 1)
+	    error("--validate-jobs expects a positive integer");
+	 argv++;
+	 opt_validate_jobs= val;
+	 argc--;
+	 argv++;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--compile")) {
+	 if (argc-- < 2) error("--compile expects output filename");
+	 argv++;
+	 opt_compile= *argv++;
+	 argc--;
+	 continue;
+      }
+      if (0 == strcmp(argv[0], "--stream")) {
+	 opt_stream= 1;
+	 argv++;
+	 argc--;
+	 continue;
+      }
       if (0 == strcmp(argv[0], "--dry-run")) {
 	 opt_dry_run= 1;
 	 argv++;
@@ -4641,7 +4748,8 @@ statusSbx(char *err) {
 #endif
 
   tty_erase= p1-p0;
-  if (sbx_context_source_mode(sbx_runtime_ctx) == SBX_SOURCE_CURVE &&
+  if ((sbx_context_source_mode(sbx_runtime_ctx) == SBX_SOURCE_CURVE ||
+       sbx_context_source_mode(sbx_runtime_ctx) == SBX_SOURCE_BUILTIN) &&
       curve_bucket >= 1 &&
       curve_bucket > sbx_status_curve_history_bucket) {
     fprintf(stderr, "%s\n", buf);
@@ -4660,6 +4768,7 @@ sbx_source_mode_name(int mode) {
     case SBX_SOURCE_STATIC: return "static tone";
     case SBX_SOURCE_KEYFRAMES: return "keyframed sequence";
     case SBX_SOURCE_CURVE: return "curve-driven program";
+    case SBX_SOURCE_BUILTIN: return "built-in program";
     default: return "unknown";
    }
 }
@@ -6006,6 +6115,9 @@ outChunkSbx() {
       while (rv < out_blen) tmp_buf[rv++]= 0;
    }
 
+   // --stream: output is paced by the writer, so reading ahead inline is
+   // fine; a stream error comes back from the render that needs the keyframes
+   sbx_context_pump_sbg_stream(sbx_runtime_ctx, frames / sr);
    t0= sbx_context_time_sec(sbx_runtime_ctx);
    rc= sbx_context_render_f32(sbx_runtime_ctx, sbx_runtime_fbuf, frames);
    if (rc != SBX_OK)
@@ -7115,6 +7227,85 @@ readSeqImm(int ac, char **av) {
    correctPeriods();
 }
 
+//
+//	Compiled (.sbgc) programs are recognised by extension
+//
+
+static int
+sbx_is_compiled_program_path(const char *fnam) {
+   const char *dot= fnam ? strrchr(fnam, '.') : 0;
+   return dot && curve_name_ieq(dot, ".sbgc");
+}
+
+//
+//	Length of the leading option/comment block of a sequence file,
+//	i.e. the part stored verbatim in a compiled program.  Mirrors the
+//	preamble scan in sbx_prepare_safe_seq_text().
+//
+
+static int
+sbx_is_seq_preamble_line(const char *line) {
+   while (*line == ' ' || *line == '\t' || *line == '\r') line++;
+   return !*line || *line == '\n' || *line == '#' || *line == ';' || *line == '-' ||
+      (line[0] == '/' && line[1] == '/');
+}
+
+static size_t
+sbx_seq_preamble_len(const char *text) {
+   const char *p= text;
+   const char *end= text;
+
+   while (*p) {
+      const char *eol= strchr(p, '\n');
+      const char *next= eol ? eol + 1 : p + strlen(p);
+      if (!sbx_is_seq_preamble_line(p))
+	 break;
+      while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+      if (*p == '-') end= next;
+      p= next;
+   }
+   return (size_t)(end - text);
+}
+
+//
+//	For --stream: read just the leading option/comment block of the
+//	sequence, returning it as a string and leaving the first program
+//	line in *first_line (empty at end of input)
+//
+
+static char *
+sbx_read_stream_preamble(FILE *fp, char **first_line) {
+   char *pre= StrDup("");
+   char *line= 0;
+   size_t pre_len= 0, line_cap= 0;
+
+   while (1) {
+      size_t len= 0;
+      char *tmp;
+      while (1) {
+	 if (line_cap - len < 2) {
+	    line_cap= line_cap ? line_cap * 2 : 256;
+	    line= (char *)realloc(line, line_cap);
+	    if (!line) error("Out of memory");
+	 }
+	 if (!fgets(line + len, (int)(line_cap - len), fp)) break;
+	 len += strlen(line + len);
+	 if (line[len-1] == '\n') break;
+      }
+      if (len == 0 || !sbx_is_seq_preamble_line(line))
+	 break;
+      tmp= (char *)realloc(pre, pre_len + len + 1);
+      if (!tmp) error("Out of memory");
+      pre= tmp;
+      memcpy(pre + pre_len, line, len + 1);
+      pre_len += len;
+   }
+   if (!line) line= StrDup("");
+   else if (!line[0] || ferror(fp)) line[0]= 0;
+   *first_line= line;
+   return pre;
+}
+
 int
 sbx_try_readSeq_runtime(int ac, char **av) {
    const char *fnam;
@@ -7123,8 +7314,12 @@ sbx_try_readSeq_runtime(int ac, char **av) {
    int rc;
    char *seq_text= 0;
    char *stdin_text= 0;
+   char *src_text= 0;
+   FILE *stream_fp= 0;
+   char *stream_first= 0;
    char prep_err[256];
    SbxSafeSeqfilePreamble safe_cfg;
+   int compiled;
 
    sbx_clear_runtime_reject_reason();
    sbx_default_safe_seqfile_preamble(&safe_cfg);
@@ -7138,10 +7333,47 @@ sbx_try_readSeq_runtime(int ac, char **av) {
    if (!fnam)
       return 0;
 
-   if (0 != strcmp(fnam, "-") && sbx_try_run_option_only_seq_wrapper(fnam))
+   compiled= sbx_is_compiled_program_path(fnam);
+
+   if (0 != strcmp(fnam, "-") && !compiled && !opt_compile && !opt_stream &&
+       sbx_try_run_option_only_seq_wrapper(fnam))
       return 1;
 
-   if (0 == strcmp(fnam, "-")) {
+   if (opt_stream) {
+      // Only the preamble is read up front; the rest is parsed as it plays
+      char *pre;
+      if (compiled || opt_compile)
+	 error("--stream cannot be combined with --compile or a .sbgc program");
+      stream_fp= strcmp(fnam, "-") ? fopen(fnam, "rb") : stdin;
+      if (!stream_fp)
+	 error("Can't open sequence file \"%s\"", fnam);
+      pre= sbx_read_stream_preamble(stream_fp, &stream_first);
+      rc= sbx_prepare_safe_seq_text(pre, &seq_text, &safe_cfg,
+				    prep_err, sizeof(prep_err));
+      free(pre);
+   } else if (compiled) {
+      // Compiled program: only the stored option preamble is parsed as text
+      char *pre= 0;
+      rc= sbx_compiled_read_preamble(fnam, &pre, prep_err, sizeof(prep_err));
+      if (rc == SBX_OK) {
+	 rc= sbx_prepare_safe_seq_text(pre, &seq_text, &safe_cfg,
+				       prep_err, sizeof(prep_err));
+	 free(pre);
+      }
+   } else if (opt_compile) {
+      // Keep the raw text so that its option preamble can be stored
+      FILE *fp= strcmp(fnam, "-") ? fopen(fnam, "rb") : stdin;
+      if (!fp)
+	 error("Can't open sequence file \"%s\"", fnam);
+      rc= sbx_read_text_stream_alloc_cli(fp, &src_text);
+      if (fp != stdin) fclose(fp);
+      if (rc == SBX_ENOMEM)
+	 error("Out of memory reading sequence file \"%s\"", fnam);
+      if (rc != SBX_OK)
+	 error("Unable to read sequence file \"%s\"", fnam);
+      rc= sbx_prepare_safe_seq_text(src_text, &seq_text, &safe_cfg,
+				    prep_err, sizeof(prep_err));
+   } else if (0 == strcmp(fnam, "-")) {
       rc= sbx_read_text_stream_alloc_cli(stdin, &stdin_text);
       if (rc == SBX_ENOMEM)
 	 error("Out of memory reading stdin for sbagenxlib runtime");
@@ -7269,7 +7501,8 @@ sbx_try_readSeq_runtime(int ac, char **av) {
    }
    if (safe_cfg.mix_path && !opt_m)
       opt_m= StrDup(safe_cfg.mix_path);
-   open_mix_input_stream_if_requested();
+   if (!opt_compile)
+      open_mix_input_stream_if_requested();
 
    sbx_default_engine_config(&cfg);
    cfg.sample_rate= (double)out_rate;
@@ -7303,19 +7536,53 @@ sbx_try_readSeq_runtime(int ac, char **av) {
       goto fail;
    }
 
-   rc= sbx_context_load_sbg_timing_text(ctx, seq_text, 0);
+   if (opt_stream) {
+      SbxSbgStreamConfig scfg;
+      sbx_default_sbg_stream_config(&scfg);
+      scfg.initial_text= stream_first;
+      scfg.take_stream_ownership= (stream_fp != stdin);
+      rc= sbx_context_open_sbg_timing_stream(ctx, stream_fp, &scfg);
+      free(stream_first);
+      stream_first= 0;
+      if (rc == SBX_OK)
+	 stream_fp= 0;
+   } else if (compiled)
+      rc= sbx_context_load_compiled(ctx, fnam, 0);
+   else
+      rc= sbx_context_load_sbg_timing_text(ctx, seq_text, 0);
    if (rc != SBX_OK) {
       sbx_set_runtime_reject_reason("%s", sbx_context_last_error(ctx));
       sbx_context_destroy(ctx);
       goto fail;
    }
 
+   if (opt_compile) {
+      size_t pre_len= sbx_seq_preamble_len(src_text);
+      char *pre= (char *)Alloc(pre_len + 1);
+      memcpy(pre, src_text, pre_len);
+      pre[pre_len]= 0;
+      rc= sbx_context_save_compiled(ctx, opt_compile, pre);
+      free(pre);
+      if (rc != SBX_OK)
+	 error("--compile: %s", sbx_context_last_error(ctx));
+      if (!opt_Q)
+	 warn("Compiled %s to %s (%lu keyframes)", fnam, opt_compile,
+	      (unsigned long)sbx_context_keyframe_count(ctx));
+      sbx_context_destroy(ctx);
+      free(src_text);
+      free(seq_text);
+      sbx_free_safe_seqfile_preamble(&safe_cfg);
+      return 1;
+   }
+
    if (safe_cfg.opt_S) {
       opt_S= 1;
       if (!fast_mult) fast_mult= 1;
    }
    if (safe_cfg.opt_E)
       opt_E= 1;
+   if (opt_stream && opt_E)
+      error("-E is not supported with --stream (the sequence length is not known up front)");
 
    if (safe_cfg.have_T && opt_T == -1) {
       opt_T= safe_cfg.T_ms;
@@ -7357,7 +7624,7 @@ sbx_try_readSeq_runtime(int ac, char **av) {
    sbx_runtime_clear();
    sbx_runtime_ctx= ctx;
    sbx_runtime_active= 1;
-   sbx_runtime_total_sec= sbx_context_duration_sec(ctx);
+   sbx_runtime_total_sec= opt_stream ? 0.0 : sbx_context_duration_sec(ctx);
    if (!opt_Q)
       warn("Using sbagenxlib runtime for sequence file subset: %s", fnam);
    free(seq_text);
@@ -7366,6 +7633,9 @@ sbx_try_readSeq_runtime(int ac, char **av) {
 
 fail:
    if (stdin_text) free(stdin_text);
+   if (src_text) free(src_text);
+   if (stream_first) free(stream_first);
+   if (stream_fp && stream_fp != stdin) fclose(stream_fp);
    if (seq_text) free(seq_text);
    sbx_free_safe_seqfile_preamble(&safe_cfg);
    if (!sbx_runtime_reject_reason[0])
@@ -7398,6 +7668,12 @@ readSeq(int ac, char **av) {
 	 return;
       if (sbx_runtime_reject_is_fatal())
 	 error("%s", sbx_get_runtime_reject_reason());
+      if (opt_compile)
+	 error("--compile: %s", sbx_get_runtime_reject_reason());
+      if (opt_stream)
+	 error("--stream: %s", sbx_get_runtime_reject_reason());
+      if (ac == 1 && sbx_is_compiled_program_path(av[0]))
+	 error("%s: %s", av[0], sbx_get_runtime_reject_reason());
       if (seq_backend == 0 && !opt_Q)
 	 warn("Falling back to legacy sequence parser/runtime: %s",
 	      sbx_get_runtime_reject_reason());
@@ -8224,6 +8500,9 @@ readPreProg(int ac, char **av) {
       return;
    }
 
+   if (opt_sweep && strcmp(av[0], "curve") != 0)
+      error("--sweep is only supported with -p curve");
+
    if (opt_G &&
        strcmp(av[0], "drop") != 0 &&
        strcmp(av[0], "sigmoid") != 0 &&
@@ -8578,6 +8857,50 @@ sbx_runtime_activate_from_curve_program(SbxCurveProgram **curvep,
    sbx_runtime_total_sec= total_sec;
 }
 
+static void
+sbx_runtime_activate_from_builtin(const SbxBuiltinDropConfig *drop_cfg,
+				  const SbxBuiltinSigmoidConfig *sigmoid_cfg,
+				  const SbxBuiltinSlideConfig *slide_cfg,
+				  double mix_amp_pct,
+				  const SbxToneSpec *aux_tones, size_t aux_count,
+				  const SbxMixFxSpec *mix_fx, size_t mix_fx_count) {
+   SbxRuntimeContextConfig cfg;
+   SbxContext *ctx= 0;
+   int rc;
+
+   sbx_runtime_clear();
+   sbx_fill_runtime_context_cfg(&cfg);
+   ctx= sbx_context_create(&cfg.engine);
+   if (!ctx)
+      error("Failed to create sbagenxlib built-in program runtime");
+
+   if (drop_cfg)
+      rc= sbx_context_load_builtin_drop(ctx, drop_cfg);
+   else if (sigmoid_cfg)
+      rc= sbx_context_load_builtin_sigmoid(ctx, sigmoid_cfg);
+   else
+      rc= sbx_context_load_builtin_slide(ctx, slide_cfg);
+   if (rc == SBX_OK)
+      rc= sbx_context_configure_runtime(ctx, 0, 0, mix_amp_pct,
+					mix_fx, mix_fx_count,
+					aux_tones, aux_count);
+   if (rc == SBX_OK)
+      rc= sbx_context_set_mix_mod(ctx, cfg.mix_mod);
+   if (rc == SBX_OK)
+      rc= sbx_context_set_amp_adjust(ctx, cfg.amp_adjust);
+   if (rc != SBX_OK) {
+      const char *msg= sbx_context_last_error(ctx);
+      char buf[256];
+      snprintf(buf, sizeof(buf), "%s", (msg && *msg) ? msg : "unknown error");
+      sbx_context_destroy(ctx);
+      error("Failed to activate sbagenxlib built-in program runtime: %s", buf);
+   }
+
+   sbx_runtime_ctx= ctx;
+   sbx_runtime_active= 1;
+   sbx_runtime_total_sec= sbx_context_duration_sec(ctx);
+}
+
 int
 sbx_try_readSeqImm_runtime(int ac, char **av) {
    SbxImmediateParseConfig parse_cfg;
@@ -8967,7 +9290,6 @@ create_drop(int ac, char **av) {
       SbxProgramKeyframe *frames= 0;
       size_t frame_count= 0;
       SbxBuiltinDropConfig prog_cfg;
-      int end_sec;
 
       if (extra_spec.have_mix && !mix_in && !opt_m && !opt_M)
 	 warn("mix/<amp> was specified in -p drop extras but no mix input stream is active");
@@ -9022,38 +9344,17 @@ create_drop(int ac, char **av) {
       if (sbx_have_native_fade_override())
 	 prog_cfg.fade_sec= sbx_native_fade_sec();
 
-      if (slide && !opt_D) {
-	 SbxCurveProgram *curve= 0;
-	 if (sbx_build_drop_curve_program(&prog_cfg, &curve) != SBX_OK)
-	    error("Failed to prepare built-in drop curve");
-	 end_sec= len + (wakeup ? len2 : 0);
-	 sbx_handle_runtime_unsupported_extra("-p drop", &extra_spec);
-	 sbx_runtime_activate_from_curve_program(&curve,
-						 isisochronic, ismono,
-						 (double)end_sec + prog_cfg.fade_sec,
-						 extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
-						 extra_spec.aux_tones, extra_spec.aux_count,
-						 extra_spec.mix_fx, extra_spec.mix_fx_count,
-						 0, 0);
-      } else {
+      sbx_handle_runtime_unsupported_extra("-p drop", &extra_spec);
+
+      if (opt_D) {
 	 if (sbx_build_drop_keyframes(&prog_cfg, &frames, &frame_count) != SBX_OK)
 	    error("Failed to build built-in drop keyframes");
-	 end_sec= len + (wakeup ? len2 : 0);
-      }
-
-      if (!slide || opt_D)
-	 sbx_handle_runtime_unsupported_extra("-p drop", &extra_spec);
-
-      if (slide && !opt_D) {
-	 /* exact runtime already activated above */
-      } else if (opt_D) {
 	 sbx_emit_periods_from_keyframes_with_extra(frames, frame_count, 0, extra);
       } else {
-	 sbx_runtime_activate_from_keyframes(frames, frame_count, 0,
-					     extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
-					     extra_spec.aux_tones, extra_spec.aux_count,
-					     extra_spec.mix_fx, extra_spec.mix_fx_count,
-					     0, 0);
+	 sbx_runtime_activate_from_builtin(&prog_cfg, 0, 0,
+					   extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
+					   extra_spec.aux_tones, extra_spec.aux_count,
+					   extra_spec.mix_fx, extra_spec.mix_fx_count);
       }
 
       if (frames) free(frames);
@@ -9261,7 +9562,6 @@ create_sigmoid(int ac, char **av) {
       SbxProgramKeyframe *frames= 0;
       size_t frame_count= 0;
       SbxBuiltinSigmoidConfig prog_cfg;
-      int end_sec;
 
       if (extra_spec.have_mix && !mix_in && !opt_m && !opt_M)
 	 warn("mix/<amp> was specified in -p sigmoid extras but no mix input stream is active");
@@ -9319,44 +9619,294 @@ create_sigmoid(int ac, char **av) {
       prog_cfg.sig_l= sig_l;
       prog_cfg.sig_h= sig_h;
 
-      if (slide && !opt_D) {
-	 SbxCurveProgram *curve= 0;
-	 if (sbx_build_sigmoid_curve_program(&prog_cfg, &curve) != SBX_OK)
-	    error("Failed to prepare built-in sigmoid curve");
-	 end_sec= len + (wakeup ? len2 : 0);
-	 sbx_handle_runtime_unsupported_extra("-p sigmoid", &extra_spec);
-	 sbx_runtime_activate_from_curve_program(&curve,
-						 isisochronic, ismono,
-						 (double)end_sec + prog_cfg.fade_sec,
-						 extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
-						 extra_spec.aux_tones, extra_spec.aux_count,
-						 extra_spec.mix_fx, extra_spec.mix_fx_count,
-						 0, 0);
-      } else {
+      sbx_handle_runtime_unsupported_extra("-p sigmoid", &extra_spec);
+
+      if (opt_D) {
 	 if (sbx_build_sigmoid_keyframes(&prog_cfg, &frames, &frame_count) != SBX_OK)
 	    error("Failed to build built-in sigmoid keyframes");
-	 end_sec= len + (wakeup ? len2 : 0);
-      }
-
-      if (!slide || opt_D)
-	 sbx_handle_runtime_unsupported_extra("-p sigmoid", &extra_spec);
-
-      if (slide && !opt_D) {
-	 /* exact runtime already activated above */
-      } else if (opt_D) {
 	 sbx_emit_periods_from_keyframes_with_extra(frames, frame_count, 0, extra);
       } else {
-	 sbx_runtime_activate_from_keyframes(frames, frame_count, 0,
-					     extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
-					     extra_spec.aux_tones, extra_spec.aux_count,
-					     extra_spec.mix_fx, extra_spec.mix_fx_count,
-					     0, 0);
+	 sbx_runtime_activate_from_builtin(0, &prog_cfg, 0,
+					   extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
+					   extra_spec.aux_tones, extra_spec.aux_count,
+					   extra_spec.mix_fx, extra_spec.mix_fx_count);
       }
 
       if (frames) free(frames);
    }
 }
 
+//
+//	Parameter sweep for -p curve (--sweep).  Each axis is
+//	name=v1,v2,... or name=start..end/count; the curve-spec settings
+//	are the base for every grid point.
+//
+
+static int
+parse_sweep_axis(const char *spec, char *name, int name_sz, double **vals_out) {
+   const char *eq= strchr(spec, '=');
+   const char *p, *dd;
+   char *q;
+   double *vals;
+   int n, a;
+
+   if (!eq || eq == spec || eq - spec >= name_sz) return 0;
+   memcpy(name, spec, eq - spec);
+   name[eq - spec]= 0;
+   p= eq + 1;
+
+   if ((dd= strstr(p, ".."))) {
+      double v0, v1;
+      // strtod() may take the first dot of ".." as a decimal point
+      v0= strtod(p, &q);
+      if (q == p || (q != dd && q != dd + 1)) return 0;
+      p= dd + 2;
+      v1= strtod(p, &q);
+      if (q == p || *q != '/') return 0;
+      p= q + 1;
+      n= (int)strtol(p, &q, 10);
+      if (q == p || *q || n < 1) return 0;
+      vals= ALLOC_ARR(n, double);
+      for (a= 0; a<n; a++)
+	 vals[a]= n == 1 ? v0 : v0 + (v1 - v0) * a / (n - 1);
+   } else {
+      n= 1;
+      for (q= (char *)p; *q; q++) if (*q == ',') n++;
+      vals= ALLOC_ARR(n, double);
+      for (a= 0; a<n; a++) {
+	 vals[a]= strtod(p, &q);
+	 if (q == p || (*q && *q != ',')) return 0;
+	 p= *q ? q + 1 : q;
+      }
+   }
+   *vals_out= vals;
+   return n;
+}
+
+static int
+sweep_cpu_count() {
+#ifdef UNIX_MISC
+   long n= sysconf(_SC_NPROCESSORS_ONLN);
+   return n > 0 ? (int)n : 1;
+#elif defined(WIN_MISC)
+   SYSTEM_INFO si;
+   GetSystemInfo(&si);
+   return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+   return 1;
+#endif
+}
+
+//
+//	Run work(arg) on 'jobs' threads at once (the calling thread being
+//	one of them) and wait for all to finish.  Returns the calling
+//	thread's result.
+//
+
+typedef int (*WorkerFn)(void *arg);
+typedef struct { WorkerFn work; void *arg; } WorkerJob;
+
+#ifdef UNIX_MISC
+static void *
+worker_thread(void *vp) {
+   WorkerJob *job= (WorkerJob *)vp;
+   job->work(job->arg);
+   return NULL;
+}
+#endif
+#ifdef WIN_MISC
+static DWORD WINAPI
+worker_thread(LPVOID vp) {
+   WorkerJob *job= (WorkerJob *)vp;
+   job->work(job->arg);
+   return 0;
+}
+#endif
+
+static int
+run_workers(int jobs, WorkerFn work, void *arg) {
+#if defined(UNIX_MISC) || defined(WIN_MISC)
+   WorkerJob job;
+#endif
+   int a, rc;
+
+#if defined(UNIX_MISC) || defined(WIN_MISC)
+   job.work= work;
+   job.arg= arg;
+#endif
+   if (jobs > 64) jobs= 64;
+#ifdef UNIX_MISC
+   {
+      pthread_t th[64];
+      int started= 0;
+      for (a= 1; a<jobs; a++) {
+	 if (0 != pthread_create(&th[started], NULL, worker_thread, &job)) break;
+	 started++;
+      }
+      rc= work(arg);
+      for (a= 0; a<started; a++) pthread_join(th[a], NULL);
+   }
+#elif defined(WIN_MISC)
+   {
+      HANDLE th[64];
+      int started= 0;
+      for (a= 1; a<jobs; a++) {
+	 if (!(th[started]= CreateThread(NULL, 0, worker_thread, &job, 0, NULL))) break;
+	 started++;
+      }
+      rc= work(arg);
+      for (a= 0; a<started; a++) {
+	 WaitForSingleObject(th[a], INFINITE);
+	 CloseHandle(th[a]);
+      }
+   }
+#else
+   (void)a;
+   rc= work(arg);
+#endif
+   return rc;
+}
+
+static int
+sweep_work(void *vp) {
+   return sbx_curve_sweep_work((SbxCurveSweep *)vp);
+}
+
+static void
+run_curve_sweep(SbxCurveProgram *curve, const SbxCurveEvalConfig *eval_cfg) {
+   SbxCurveSweepAxis axes[SWEEP_MAX_AXES];
+   char names[SWEEP_MAX_AXES][CURVE_NAME_MAX];
+   double *vals[SWEEP_MAX_AXES];
+   SbxCurveSweepConfig cfg;
+   SbxCurveSweep *sweep;
+   SbxCurveSweepPoint pt;
+   char err[256];
+   size_t n_point, n_fail= 0, n_unrun= 0, i;
+   int a, jobs, fmt;
+   FILE *fp;
+
+   for (a= 0; a<opt_sweep; a++) {
+      int n= parse_sweep_axis(opt_sweep_spec[a], names[a], sizeof(names[a]), &vals[a]);
+      if (!n)
+	 error("Bad --sweep spec \"%s\"; expecting name=v1,v2,... or name=start..end/count",
+	       opt_sweep_spec[a]);
+      axes[a].name= names[a];
+      axes[a].values= vals[a];
+      axes[a].value_count= (size_t)n;
+   }
+
+   sbx_default_curve_sweep_config(&cfg);
+   cfg.eval_config= *eval_cfg;
+   cfg.sample_count= (size_t)opt_sweep_samples;
+   sweep= sbx_curve_sweep_create(curve, axes, (size_t)opt_sweep, &cfg, err, sizeof(err));
+   if (!sweep) error("--sweep: %s", err);
+   for (a= 0; a<opt_sweep; a++) free(vals[a]);
+
+   n_point= sbx_curve_sweep_point_count(sweep);
+   jobs= opt_sweep_jobs ? opt_sweep_jobs : sweep_cpu_count();
+   if ((size_t)jobs > n_point) jobs= (int)n_point;
+   if (jobs > 64) jobs= 64;
+   if (!opt_Q) warn("Sweeping %lu points on %d thread%s", (unsigned long)n_point,
+		    jobs, jobs == 1 ? "" : "s");
+
+   // A worker that can't set up just leaves its share to the others, so
+   // only points nobody got to run mean the sweep is out of memory
+   run_workers(jobs, sweep_work, sweep);
+
+   for (i= 0; i<n_point; i++) {
+      sbx_curve_sweep_get_point(sweep, i, NULL, &pt, NULL);
+      if (pt.status < 0) n_unrun++;
+      else if (pt.status != SBX_OK) n_fail++;
+   }
+   if (n_unrun)
+      error("--sweep: out of memory (%lu of %lu points not run)",
+	    (unsigned long)n_unrun, (unsigned long)n_point);
+   if (n_fail)
+      warn("--sweep: %lu of %lu points failed; first: %s", (unsigned long)n_fail,
+	   (unsigned long)n_point, sbx_curve_sweep_first_error(sweep));
+
+   fmt= SBX_CURVE_SWEEP_CSV;
+   if (opt_sweep_out) {
+      const char *dot= strrchr(opt_sweep_out, '.');
+      if (dot && curve_name_ieq(dot, ".bin")) fmt= SBX_CURVE_SWEEP_BINARY;
+      fp= fopen(opt_sweep_out, fmt == SBX_CURVE_SWEEP_BINARY ? "wb" : "w");
+      if (!fp) error("Can't open \"%s\" for writing", opt_sweep_out);
+   } else {
+      fp= stdout;
+   }
+   if (sbx_curve_sweep_write(sweep, fp, fmt) != SBX_OK)
+      error("--sweep: failed to write results");
+   if (fp != stdout && fclose(fp) != 0)
+      error("--sweep: failed to write \"%s\"", opt_sweep_out);
+   sbx_curve_sweep_destroy(sweep);
+}
+
+//
+//	--validate-batch: validate every file argument on a worker pool and
+//	write one JSON line per file plus a summary line to stdout.  A lone
+//	"-" reads the file list from stdin, one path per line.  Returns the
+//	exit status: 1 if any file has errors.
+//
+
+static int
+validate_work(void *vp) {
+   return sbx_validate_batch_work((SbxValidateBatch *)vp);
+}
+
+static int
+run_validate_batch(int argc, char **argv) {
+   SbxValidateBatch *batch;
+   SbxValidateBatchStats st;
+   char **list= argv;
+   int n_list= argc;
+   char err[256];
+   int jobs, a;
+
+   if (argc == 1 && 0 == strcmp(argv[0], "-")) {
+      char buf[4096];
+      int cap= 64;
+      list= ALLOC_ARR(cap, char *);
+      n_list= 0;
+      while (fgets(buf, sizeof(buf), stdin)) {
+	 char *p= buf + strlen(buf);
+	 while (p > buf && (p[-1] == '\n' || p[-1] == '\r')) *--p= 0;
+	 if (!buf[0]) continue;
+	 if (n_list == cap) {
+	    cap *= 2;
+	    list= (char **)realloc(list, cap * sizeof(char *));
+	    if (!list) error("Out of memory");
+	 }
+	 list[n_list++]= StrDup(buf);
+      }
+   }
+
+   batch= sbx_validate_batch_create((const char *const *)list, (size_t)n_list,
+				    err, sizeof(err));
+   if (!batch) error("--validate-batch: %s", err);
+   if (list != argv) {
+      for (a= 0; a<n_list; a++) free(list[a]);
+      free(list);
+   }
+
+   jobs= opt_validate_jobs ? opt_validate_jobs : sweep_cpu_count();
+   if (jobs > n_list) jobs= n_list > 0 ? n_list : 1;
+   if (jobs > 64) jobs= 64;
+   run_workers(jobs, validate_work, batch);
+
+   if (sbx_validate_batch_write_jsonl(batch, stdout) != SBX_OK)
+      error("--validate-batch: failed to write results");
+   fflush(stdout);
+   sbx_validate_batch_get_stats(batch, &st);
+   if (!opt_Q)
+      warn("Validated %lu files (%.1f MB) in %.3fs on %d thread%s: %.0f files/s, %lu with errors",
+	   (unsigned long)st.file_count, st.byte_count / 1048576.0, st.wall_sec,
+	   jobs, jobs == 1 ? "" : "s",
+	   st.wall_sec > 0 ? st.file_count / st.wall_sec : 0.0,
+	   (unsigned long)st.failed_count);
+   sbx_validate_batch_destroy(batch);
+   return st.failed_count ? 1 : 0;
+}
+
 //
 //	Error for bad p-curve args
 //
@@ -9584,6 +10134,11 @@ create_curve(int ac, char **av) {
    if (sbx_prepare_curve_file_program(&curve_prog_cfg, &curve) != SBX_OK) {
       curve_report_error(curve, "Unable to setup custom curve program");
    }
+   if (opt_sweep) {
+      run_curve_sweep(curve, &curve_cfg);
+      sbx_curve_destroy(curve);
+      return;
+   }
    if (sbx_curve_get_info(curve, &curve_info) != SBX_OK)
       curve_report_error(curve, "Unable to inspect prepared .sbgf curve");
    have_amp_curve= curve_info.has_amp_expr || curve_info.amp_piece_count > 0;
@@ -9821,19 +10376,17 @@ create_slide(int ac, char **av) {
       prog_cfg.slide_sec= len;
       if (sbx_have_native_fade_override())
 	 prog_cfg.fade_sec= sbx_native_fade_sec();
-      if (sbx_build_slide_keyframes(&prog_cfg, &frames, &frame_count) != SBX_OK)
-	 error("Failed to build built-in slide keyframes");
-
       sbx_handle_runtime_unsupported_extra("-p slide", &extra_spec);
 
       if (opt_D) {
+	 if (sbx_build_slide_keyframes(&prog_cfg, &frames, &frame_count) != SBX_OK)
+	    error("Failed to build built-in slide keyframes");
 	 sbx_emit_periods_from_keyframes_with_extra(frames, frame_count, 0, extra);
       } else {
-	 sbx_runtime_activate_from_keyframes(frames, frame_count, 0,
-					     extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
-					     extra_spec.aux_tones, extra_spec.aux_count,
-					     extra_spec.mix_fx, extra_spec.mix_fx_count,
-					     0, 0);
+	 sbx_runtime_activate_from_builtin(0, 0, &prog_cfg,
+					   extra_spec.have_mix ? extra_spec.mix_amp_pct : sbx_builtin_default_mix_amp_pct(amp),
+					   extra_spec.aux_tones, extra_spec.aux_count,
+					   extra_spec.mix_fx, extra_spec.mix_fx_count);
       }
 
       if (frames) free(frames);
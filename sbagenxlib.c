@@ -29,6 +29,10 @@
 #endif
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 #if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
@@ -72,10 +76,49 @@ extern int lame_close(lame_t gfp);
 #endif
 
 #define SBX_TAU (2.0 * M_PI)
+
+/* Acquire/release index access for the single-producer/single-consumer
+ * live-control queue, telemetry ring and sbg stream windows, plus the
+ * exchange behind sbx_spin_lock. Windows builds use MinGW, so GCC builtins
+ * cover every supported toolchain. The MSVC fallback uses Interlocked operations,
+ * which are full barriers on every target; plain volatile access only
+ * orders under /volatile:ms, which ARM64 does not default to. */
+#if defined(__GNUC__) || defined(__clang__)
+#define SBX_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SBX_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define SBX_XCHG_ACQUIRE(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQUIRE)
+#define SBX_LOAD_ACQUIRE64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SBX_STORE_RELEASE64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define SBX_LOAD_ACQUIRE(p) \
+  ((unsigned int)InterlockedCompareExchange((volatile LONG *)(p), 0, 0))
+#define SBX_STORE_RELEASE(p, v) ((void)InterlockedExchange((volatile LONG *)(p), (LONG)(v)))
+#define SBX_XCHG_ACQUIRE(p, v) ((unsigned int)InterlockedExchange((volatile LONG *)(p), (LONG)(v)))
+#define SBX_LOAD_ACQUIRE64(p) \
+  ((uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(p), 0, 0))
+#define SBX_STORE_RELEASE64(p, v) \
+  ((void)InterlockedExchange64((volatile LONG64 *)(p), (LONG64)(v)))
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SBX_CPU_PAUSE() __builtin_ia32_pause()
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define SBX_CPU_PAUSE() __asm__ __volatile__("yield")
+#elif defined(_WIN32)
+#define SBX_CPU_PAUSE() YieldProcessor()
+#else
+#define SBX_CPU_PAUSE() ((void)0)
+#endif
+#if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
+#define SBX_THREAD_YIELD() ((void)SwitchToThread())
+#else
+#define SBX_THREAD_YIELD() ((void)sched_yield())
+#endif
+#define SBX_SPIN_PAUSES 64
 #define SBX_CTX_SRC_NONE SBX_SOURCE_NONE
 #define SBX_CTX_SRC_STATIC SBX_SOURCE_STATIC
 #define SBX_CTX_SRC_KEYFRAMES SBX_SOURCE_KEYFRAMES
 #define SBX_CTX_SRC_CURVE SBX_SOURCE_CURVE
+#define SBX_CTX_SRC_BUILTIN SBX_SOURCE_BUILTIN
 #define SBX_MAX_SBG_VOICES 16
 #define SBX_MAX_SBG_MIXFX 8
 #define SBX_CUSTOM_WAVE_COUNT 100
@@ -96,19 +139,108 @@ extern int lame_close(lame_t gfp);
 #define SBX_CURVE_NAME_MAX 64
 #define SBX_CURVE_EXPR_MAX 1024
 #define SBX_CURVE_FILE_MAX 1024
-#define SBX_CURVE_MAX_SOLVE_UNK 8
+#define SBX_CURVE_MAX_SOLVE_UNK 32
 #define SBX_CURVE_MAX_SOLVE_EQ SBX_CURVE_MAX_SOLVE_UNK
 #define SBX_CURVE_MIXFX_PARAM_COUNT 8
+#define SBX_CURVE_VM_MAX_REGS 0xffff
+#define SBX_CURVE_VM_TARGETS (4 + SBX_CURVE_MIXFX_PARAM_COUNT)
+#define SBX_CURVE_SWEEP_MAX_AXES (SBX_CURVE_MAX_PARAMS + 3)
+
+/*
+ * Flat register bytecode compiled from all prepared curve targets. The
+ * register file holds t/m, folded constants, subexpressions shared between
+ * targets (computed once per time point by the prelude at code[0]), then
+ * per-target temporaries.
+ */
+typedef struct {
+  unsigned short op;
+  unsigned short dst;
+  unsigned short a[5];
+  const void *fn;
+} SbxCurveVmInsn;
+
+/*
+ * Interval dispatch for a piecewise target whose conditions all compare one
+ * time variable against constants: k[0..n-1] are the sorted breakpoints and
+ * pc[] the piece entry for each region (below k[0], at k[0], between k[0]
+ * and k[1], ..., above k[n-1]), with pc[2n+1] for a NaN time.
+ */
+typedef struct {
+  double *k;
+  unsigned short *pc;
+  int n;
+} SbxCurveVmTable;
+
+typedef struct {
+  SbxCurveVmInsn *code;
+  int code_len;
+  SbxCurveVmTable *tables;
+  int table_count;
+  int entry[SBX_CURVE_VM_TARGETS];  /* first instruction, -1 if absent */
+  double *regs;
+  int reg_count;
+  int const_count;
+  int shared_count;
+  int tree_op_count;                /* operator nodes before folding */
+  int frame_ok;                     /* prelude has run for regs[0] */
+  int point_const;                  /* point targets all folded to constants */
+  double point_value[4];            /* finished point values; carrier NaN = ramp */
+} SbxCurveVm;
+
+/*
+ * Baked curve target: count cubic segments over knot[0..count]. Segment i
+ * holds coef[4*i..4*i+3] in powers of (t - knot[i]); a NaN constant term
+ * marks a segment left on exact evaluation.
+ */
+typedef struct {
+  double *knot;
+  double *coef;
+  int count;
+  int cursor;                       /* last segment hit, for monotonic t */
+} SbxCurveBakeLane;
+
+typedef struct {
+  SbxCurveBakeLane lane[SBX_CURVE_VM_TARGETS];
+} SbxCurveBake;
+
+/*
+ * Caller-owned evaluation frame for sbx_curve_eval_batch: a private copy
+ * of the VM register file and bake cursors, so one prepared program can
+ * be evaluated from several threads.
+ */
+struct SbxCurveEvalState {
+  double *regs;
+  int reg_cap;
+  int frame_ok;
+  int cursor[SBX_CURVE_VM_TARGETS];
+  double t, m;
+  char last_error[256];
+};
+
+/*
+ * Per-curve bump allocator for loaded sources and piece arrays; everything
+ * in it is released together when the curve is reset or destroyed.
+ */
+typedef struct SbxCurveArenaBlock SbxCurveArenaBlock;
+struct SbxCurveArenaBlock {
+  SbxCurveArenaBlock *next;
+  size_t used;
+  size_t cap;
+};
 
+/*
+ * Sources live in the curve arena. The four piece arrays are allocated
+ * together and sized by curve_pieces_reserve from piece_count alone.
+ */
 typedef struct {
-  char expr_src[SBX_CURVE_EXPR_MAX];
+  char *expr_src;
   int has_expr;
   int piece_count;
-  char piece_cond_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char piece_expr_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
+  char **piece_cond_src;
+  char **piece_expr_src;
   te_expr *expr;
-  te_expr *piece_cond[SBX_CURVE_MAX_PIECES];
-  te_expr *piece_expr[SBX_CURVE_MAX_PIECES];
+  te_expr **piece_cond;
+  te_expr **piece_expr;
 } SbxCurveExprTarget;
 
 enum {
@@ -138,12 +270,20 @@ typedef struct {
   double phase;
   double mixbeat_hist[SBX_MIXBEAT_HILBERT_TAPS];
   int mixbeat_hist_pos;
+  int bypass;           /* toggled by SBX_EVENT_MIX_EFFECT_ENABLE */
+  int bypass_has_prev;  /* bypass_prev holds until the next render call */
+  int bypass_prev;      /* state before bypass_since_sec */
+  double bypass_since_sec;
 } SbxMixFxState;
 
 typedef struct SbxVoiceSetKeyframe SbxVoiceSetKeyframe;
 typedef struct SbxMixFxKeyframe SbxMixFxKeyframe;
 typedef struct SbxNoiseProfile SbxNoiseProfile;
 typedef struct SbxLiveControlSlot SbxLiveControlSlot;
+typedef struct SbxLiveControlCmd SbxLiveControlCmd;
+typedef struct SbxScheduledEventEntry SbxScheduledEventEntry;
+typedef struct SbxKeyframeSegment SbxKeyframeSegment;
+typedef struct SbxSbgStream SbxSbgStream;
 
 struct SbxNoiseProfile {
   double fir[SBX_NOISE_FIR_TAPS];
@@ -157,8 +297,111 @@ struct SbxLiveControlSlot {
   double target_value;
   double start_time_sec;
   double end_time_sec;
+  /* Set by scheduled events so host mix-stream sampling of frames rendered
+   * before the event (same block) still sees the earlier state. since_sec
+   * is on the block's unwrapped time axis (block start time plus frames),
+   * as hosts sample it; the record is dropped by the next render or seek. */
+  int has_prev;
+  int prev_active;
+  double prev_value;
+  double since_sec;
+};
+
+#define SBX_LIVE_QUEUE_CAP 64 /* power of two */
+
+enum {
+  SBX_LIVE_CMD_SET = 0,
+  SBX_LIVE_CMD_RAMP = 1,
+  SBX_LIVE_CMD_CLEAR = 2,
+  SBX_LIVE_CMD_CLEAR_ALL = 3
+};
+
+struct SbxLiveControlCmd {
+  int op;
+  int kind;
+  double value;
+  double duration_sec;
+};
+
+struct SbxScheduledEventEntry {
+  uint64_t frame;
+  SbxScheduledEvent ev;
+};
+
+enum {
+  SBX_KFSEG_HOLD = 0,   /* constant tone over the whole segment */
+  SBX_KFSEG_LINEAR = 1, /* lanes follow start + dv * (t - t0) */
+  SBX_KFSEG_FADE = 2    /* fade out the start tone, then fade in the end tone */
+};
+
+/* Per-keyframe lanes; every other tone field lives in an interned shape. */
+enum {
+  SBX_KFSEG_LANE_CARRIER = 0,
+  SBX_KFSEG_LANE_BEAT,
+  SBX_KFSEG_LANE_AMPLITUDE,
+  SBX_KFSEG_LANE_COUNT
+};
+
+/*
+ * Compact keyframe storage. Times and interpolation are shared by every voice
+ * lane. Each voice/keyframe tone is split into the carrier/beat/amplitude
+ * lanes that usually change from frame to frame and an index into a table of
+ * interned tone "shapes" (mode, waveforms, orbit, duty and ISO fields, with
+ * the per-frame lanes zeroed), so repeated tone definitions are stored once.
+ */
+typedef struct {
+  double *time_sec;        /* [kf] */
+  unsigned char *interp;   /* [kf], SBX_INTERP_* */
+  double *lanes;           /* [voice][kf][SBX_KFSEG_LANE_COUNT] */
+  unsigned int *shape;     /* [voice][kf], index into shapes */
+  SbxToneSpec *shapes;
+  size_t shape_count;
+} SbxKeyframeStore;
+
+/*
+ * Load-time compiled form of one keyframe segment [i, i + 1) of one voice.
+ * Bell, step, mode-change and `.sbg` transition rules are resolved once when
+ * keyframes are activated, so per-sample evaluation only rebuilds the start
+ * tone and applies one multiply-add per interpolating lane.
+ */
+struct SbxKeyframeSegment {
+  unsigned char kind;       /* SBX_KFSEG_* */
+  unsigned char from_next;  /* start tone is frame i + 1 at zero amplitude */
+  unsigned char to_prev;    /* SBX_KFSEG_FADE: end tone is frame i */
+  unsigned char lerp_shape; /* orbit/duty/ISO shape fields also interpolate */
+  double dv[SBX_KFSEG_LANE_COUNT]; /* per-second slopes */
+  double amp2_dv;           /* SBX_KFSEG_FADE: fade-in slope after midpoint */
 };
 
+enum {
+  SBX_BUILTIN_SRC_DROP = 1,
+  SBX_BUILTIN_SRC_SIGMOID = 2,
+  SBX_BUILTIN_SRC_SLIDE = 3
+};
+
+/*
+ * Native closed-form state for the built-in drop/sigmoid/slide programs.
+ * Timeline: main phase [0, main_sec) (drop then hold), optional linear wake
+ * back to the start values, then an optional linear amplitude fade.
+ */
+typedef struct {
+  int kind;            /* SBX_BUILTIN_SRC_* */
+  int slide;           /* 1: continuous main phase, 0: stepped */
+  SbxToneSpec tone;    /* normalized start tone (mode/waveform/ISO fields) */
+  double c0, c1;       /* carrier start/end Hz */
+  double b0, b1;       /* beat start/target Hz */
+  double a0;           /* program amplitude */
+  int drop_sec;
+  double main_sec;
+  double wake_sec;
+  double fade_sec;
+  double step_sec;
+  int n_step;          /* stepped drop: beat levels */
+  int step_count;      /* stepped drop: steps inside main_sec */
+  double drop_k;       /* ln(b1 / b0) */
+  double sig_l, sig_h, sig_a, sig_b;
+} SbxBuiltinSource;
+
 struct SbxEngine {
   SbxEngineConfig cfg;
   SbxToneSpec tone;
@@ -212,19 +455,21 @@ struct SbxContext {
   SbxMixFxSpec seq_mixam_env;
   int source_mode;
   SbxToneSpec static_tone;
-  SbxProgramKeyframe *kfs;
+  SbxKeyframeStore kf_store;   /* compact keyframes for all voice lanes */
   unsigned char *kf_styles;
+  SbxKeyframeSegment *kf_segs; /* compiled segments: [voice][kf_count - 1] */
   size_t kf_count;
   int kf_loop;
   size_t kf_seg;
   double kf_duration_sec;
-  SbxProgramKeyframe *mv_kfs; /* optional multivoice keyframes: [voice][kf] */
   SbxEngine **mv_eng;         /* engines for voices 1..mv_voice_count-1 */
-  size_t mv_voice_count;      /* number of active voice lanes in mv_kfs */
+  size_t mv_voice_count;      /* number of active voice lanes in kf_store */
+  SbxSbgStream *sbg_stream;   /* keyframes are a window onto this stream */
   SbxCurveProgram *curve_prog;
   SbxToneSpec curve_tone;
   double curve_duration_sec;
   int curve_loop;
+  SbxBuiltinSource builtin_src;
   double t_sec;
   SbxToneSpec *aux_tones;
   SbxEngine **aux_eng;
@@ -256,7 +501,25 @@ struct SbxContext {
   void *telemetry_user;
   SbxRuntimeTelemetry telemetry_last;
   int telemetry_valid;
+  SbxRuntimeTelemetry *telem_ring; /* decimated snapshot ring, power-of-two size */
+  unsigned int telem_cap;
+  unsigned int telem_head;         /* next entry to read; written by the reader */
+  unsigned int telem_tail;         /* next entry to fill; written by the render thread */
+  unsigned int telem_dropped;      /* snapshots lost to a full ring */
+  uint64_t telem_interval_frames;
+  uint64_t telem_next_frame;
   SbxLiveControlSlot live_ctrl[4];
+  SbxLiveControlCmd live_q[SBX_LIVE_QUEUE_CAP];
+  unsigned int live_q_head; /* next slot to drain; written by the render thread */
+  unsigned int live_q_tail; /* next slot to fill; written by the posting thread */
+  uint64_t frame_pos;       /* transport frame counter for scheduled events */
+  SbxScheduledEventEntry *ev;
+  size_t ev_count;
+  size_t ev_next;           /* first event not yet applied */
+  size_t ev_cap;
+  double ev_block_t0;       /* t_sec and frame_pos at the current render call */
+  uint64_t ev_block_frame0;
+  int ev_prev_held;         /* some slot or mix effect holds a pre-event state */
 };
 
 struct SbxCurveProgram {
@@ -264,10 +527,10 @@ struct SbxCurveProgram {
   int loaded;
   int prepared;
   char src_file[SBX_CURVE_FILE_MAX];
-  char beat_expr_src[SBX_CURVE_EXPR_MAX];
-  char carrier_expr_src[SBX_CURVE_EXPR_MAX];
-  char amp_expr_src[SBX_CURVE_EXPR_MAX];
-  char mixamp_expr_src[SBX_CURVE_EXPR_MAX];
+  char *beat_expr_src;
+  char *carrier_expr_src;
+  char *amp_expr_src;
+  char *mixamp_expr_src;
   int has_carrier_expr;
   int has_amp_expr;
   int has_mixamp_expr;
@@ -275,21 +538,23 @@ struct SbxCurveProgram {
   int carrier_piece_count;
   int amp_piece_count;
   int mixamp_piece_count;
-  char beat_piece_cond_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char beat_piece_expr_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char carrier_piece_cond_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char carrier_piece_expr_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char amp_piece_cond_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char amp_piece_expr_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char mixamp_piece_cond_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
-  char mixamp_piece_expr_src[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX];
+  char **beat_piece_cond_src;
+  char **beat_piece_expr_src;
+  char **carrier_piece_cond_src;
+  char **carrier_piece_expr_src;
+  char **amp_piece_cond_src;
+  char **amp_piece_expr_src;
+  char **mixamp_piece_cond_src;
+  char **mixamp_piece_expr_src;
   int has_solve;
   int solve_unknown_count;
   int solve_eq_count;
   char solve_unknown_names[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_NAME_MAX];
   int solve_unknown_param_idx[SBX_CURVE_MAX_SOLVE_UNK];
-  char solve_eq_lhs_src[SBX_CURVE_MAX_SOLVE_EQ][SBX_CURVE_EXPR_MAX];
-  char solve_eq_rhs_src[SBX_CURVE_MAX_SOLVE_EQ][SBX_CURVE_EXPR_MAX];
+  char *solve_eq_lhs_src[SBX_CURVE_MAX_SOLVE_EQ];
+  char *solve_eq_rhs_src[SBX_CURVE_MAX_SOLVE_EQ];
+  te_expr *solve_lhs[SBX_CURVE_MAX_SOLVE_EQ];
+  te_expr *solve_rhs[SBX_CURVE_MAX_SOLVE_EQ];
   int param_count;
   char param_names[SBX_CURVE_MAX_PARAMS][SBX_CURVE_NAME_MAX];
   double param_values[SBX_CURVE_MAX_PARAMS];
@@ -297,14 +562,28 @@ struct SbxCurveProgram {
   te_expr *carrier_expr;
   te_expr *amp_expr;
   te_expr *mixamp_expr;
-  te_expr *beat_piece_cond[SBX_CURVE_MAX_PIECES];
-  te_expr *beat_piece_expr[SBX_CURVE_MAX_PIECES];
-  te_expr *carrier_piece_cond[SBX_CURVE_MAX_PIECES];
-  te_expr *carrier_piece_expr[SBX_CURVE_MAX_PIECES];
-  te_expr *amp_piece_cond[SBX_CURVE_MAX_PIECES];
-  te_expr *amp_piece_expr[SBX_CURVE_MAX_PIECES];
-  te_expr *mixamp_piece_cond[SBX_CURVE_MAX_PIECES];
-  te_expr *mixamp_piece_expr[SBX_CURVE_MAX_PIECES];
+  te_expr **beat_piece_cond;
+  te_expr **beat_piece_expr;
+  te_expr **carrier_piece_cond;
+  te_expr **carrier_piece_expr;
+  te_expr **amp_piece_cond;
+  te_expr **amp_piece_expr;
+  te_expr **mixamp_piece_cond;
+  te_expr **mixamp_piece_expr;
+  SbxCurveArenaBlock *arena;
+  /*
+   * Incremental re-prepare: trees bind parameters by address, so after a
+   * value change only the solve (if it reads a changed parameter) and the
+   * VM (which folds parameter values) need redoing. Bit i is param i.
+   */
+  int trees_ok;                     /* te trees valid for cfg and param names */
+  uint32_t param_dirty;
+  uint32_t target_deps;
+  uint32_t solve_deps;
+  int solve_dirty;                  /* solve_cfg changed since the last solve */
+  SbxCurveSolveConfig solve_cfg;
+  SbxCurveVm *vm;
+  SbxCurveBake *bake;
   double ev_t, ev_m;
   double ev_D, ev_H, ev_T, ev_U;
   double ev_b0, ev_b1, ev_c0, ev_c1;
@@ -313,6 +592,101 @@ struct SbxCurveProgram {
   SbxCurveEvalConfig cfg;
 };
 
+/*
+ * Prepared-curve cache. Entries sit in a chained hash table and on an LRU
+ * list (most recent first); an entry evicted while acquired is detached
+ * and freed on its last release. The spin lock only guards table and list
+ * updates, so loading and preparing run unlocked.
+ */
+struct SbxCurveCacheEntry {
+  SbxCurveCacheEntry *hnext;
+  SbxCurveCacheEntry *prev, *next;
+  uint64_t hash;
+  unsigned char *key;
+  size_t key_len;
+  size_t bytes;
+  int refs;
+  int cached;                       /* still owned by the table */
+  SbxCurveProgram *curve;
+  int has_timeline;
+  SbxCurveTimeline timeline;
+};
+
+struct SbxCurveCache {
+  SbxCurveCacheConfig cfg;
+  unsigned int lock;
+  SbxCurveCacheEntry **buckets;
+  size_t bucket_count;
+  SbxCurveCacheEntry *head, *tail;
+  size_t entry_count;
+  size_t bytes;
+  uint64_t hits, misses, evictions;
+};
+
+/*
+ * Parameter sweep. src holds the loaded form that every worker clones;
+ * axis_param is a parameter index or one of SBX_SWEEP_AXIS_*. The lock
+ * guards next and the first-error fields only; each point's results are
+ * written by the one worker that claimed it.
+ */
+#define SBX_SWEEP_AXIS_D (-1)
+#define SBX_SWEEP_AXIS_H (-2)
+#define SBX_SWEEP_AXIS_U (-3)
+
+struct SbxCurveSweep {
+  SbxCurveProgram *src;
+  SbxCurveSweepConfig cfg;
+  size_t axis_count;
+  char axis_names[SBX_CURVE_SWEEP_MAX_AXES][SBX_CURVE_NAME_MAX];
+  int axis_param[SBX_CURVE_SWEEP_MAX_AXES];
+  size_t axis_len[SBX_CURVE_SWEEP_MAX_AXES];
+  double *axis_values[SBX_CURVE_SWEEP_MAX_AXES];
+  int solve_param[SBX_CURVE_MAX_SOLVE_UNK]; /* -1 if not a parameter */
+  double solve_guess[SBX_CURVE_MAX_SOLVE_UNK];
+  size_t point_count;
+  SbxCurveSweepPoint *points;
+  double *beat;                     /* point_count * sample_count */
+  unsigned int lock;
+  size_t next;
+  size_t error_index;
+  char first_error[320];
+};
+
+struct SbxValidateBatch {
+  size_t count;
+  char **paths;
+  SbxValidateBatchResult *results;  /* diags owned here */
+  unsigned int lock;
+  size_t next;
+  double t_first;                   /* earliest file start, < 0 until set */
+  double t_last;                    /* latest file end */
+};
+
+/*
+ * Lock for the short critical sections of the curve cache, sweeps and
+ * validation batches. Waiters pause the CPU between polls and yield their
+ * time slice every SBX_SPIN_PAUSES polls, so a preempted holder can run.
+ */
+static void
+sbx_spin_lock(unsigned int *lock) {
+  unsigned int polls = 0;
+  while (SBX_XCHG_ACQUIRE(lock, 1u)) {
+    while (SBX_LOAD_ACQUIRE(lock)) {
+      if (++polls < SBX_SPIN_PAUSES) {
+        SBX_CPU_PAUSE();
+      } else {
+        SBX_THREAD_YIELD();
+        polls = 0;
+      }
+    }
+  }
+}
+
+static void
+sbx_spin_unlock(unsigned int *lock) {
+  SBX_STORE_RELEASE(lock, 0u);
+}
+
 #if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
 typedef HMODULE SbxDLibHandle;
 #else
@@ -396,7 +770,8 @@ static char *sbx_strdup_local(const char *s);
 #pragma GCC diagnostic pop
 #endif
 
-#define SBX_MV_KF(ctx, voice_idx) ((ctx)->mv_kfs + ((voice_idx) * (ctx)->kf_count))
+#define SBX_KF_SEGS(ctx, voice_idx) \
+  ((ctx)->kf_segs ? (ctx)->kf_segs + ((voice_idx) * ((ctx)->kf_count - 1)) : 0)
 
 static void engine_wave_sample(int waveform, double phase, double *out_sample);
 static double sbx_lerp(double a, double b, double u);
@@ -409,6 +784,24 @@ static int ctx_set_sbg_mix_effect_keyframes_internal(SbxContext *ctx,
                                                      const SbxMixFxKeyframe *kfs,
                                                      size_t kf_count,
                                                      size_t slot_count);
+static void sbx_kf_store_free(SbxKeyframeStore *ks);
+static void sbx_sbg_stream_free(SbxSbgStream *st);
+static int sbx_kf_store_build(SbxKeyframeStore *ks,
+                              const SbxProgramKeyframe *primary,
+                              const SbxProgramKeyframe *mv,
+                              size_t voice_count,
+                              size_t n);
+static void sbx_kf_store_tone(const SbxKeyframeStore *ks,
+                              size_t n,
+                              size_t voice,
+                              size_t i,
+                              SbxToneSpec *out);
+static void sbx_compile_keyframe_segments(const SbxKeyframeStore *ks,
+                                          size_t n,
+                                          size_t voice_count,
+                                          const unsigned char *styles,
+                                          SbxKeyframeSegment *out_segs);
+static void ctx_eval_builtin_tone(const SbxContext *ctx, double t_sec, SbxToneSpec *out);
 static int curve_expr_target_active(const SbxCurveExprTarget *target);
 static void curve_set_eval_time(SbxCurveProgram *curve, double t_sec);
 static int curve_eval_expr_target(SbxCurveProgram *curve,
@@ -475,7 +868,8 @@ static int sbx_audio_writer_init_mp3(SbxAudioWriter *writer, const char *path);
 static int sbx_audio_writer_ensure_mp3_buf(SbxAudioWriter *writer, int frames);
 static double ctx_mix_amp_effective_base_at(SbxContext *ctx, double t_sec);
 static int ctx_eval_voice_tone_base_at(SbxContext *ctx, size_t voice_index, double t_sec, SbxToneSpec *out);
-static int ctx_apply_live_controls_to_tone(SbxContext *ctx, double t_sec, SbxToneSpec *tone);
+static int ctx_apply_live_controls_to_tone(SbxContext *ctx, double t_sec, int pre_event,
+                                           SbxToneSpec *tone);
 static int ctx_eval_primary_tone_effective_at(SbxContext *ctx, double t_sec, SbxToneSpec *out);
 
 static void
@@ -585,14 +979,61 @@ sbx_live_control_slot_value_at(const SbxLiveControlSlot *slot, double t_sec, int
   return sbx_lerp(slot->start_value, slot->target_value, u);
 }
 
+/* Forget the pre-event states scheduled events recorded for the last block. */
 static void
-ctx_clear_live_controls_internal(SbxContext *ctx) {
+ctx_drop_event_prev_states(SbxContext *ctx) {
+  size_t i;
+  for (i = 0; i < sizeof(ctx->live_ctrl) / sizeof(ctx->live_ctrl[0]); i++)
+    ctx->live_ctrl[i].has_prev = 0;
+  for (i = 0; i < ctx->mix_fx_count; i++)
+    ctx->mix_fx[i].bypass_has_prev = 0;
+  ctx->ev_prev_held = 0;
+}
+
+static void
+ctx_clear_live_slots(SbxContext *ctx) {
   size_t i;
-  if (!ctx) return;
   for (i = 0; i < sizeof(ctx->live_ctrl) / sizeof(ctx->live_ctrl[0]); i++)
     memset(&ctx->live_ctrl[i], 0, sizeof(ctx->live_ctrl[i]));
 }
 
+/* Source (re)load: drop overrides plus anything posted or scheduled against
+ * the previous program, and restart the transport frame counter. */
+static void
+ctx_clear_live_controls_internal(SbxContext *ctx) {
+  if (!ctx) return;
+  ctx_clear_live_slots(ctx);
+  ctx_drop_event_prev_states(ctx);
+  SBX_STORE_RELEASE(&ctx->live_q_head, SBX_LOAD_ACQUIRE(&ctx->live_q_tail));
+  ctx->ev_count = 0;
+  ctx->ev_next = 0;
+  ctx->frame_pos = 0;
+  ctx->telem_next_frame = 0;
+}
+
+/* Live-control lookup. With pre_event set it honours the pre-event state a
+ * scheduled event recorded for host sampling of the block it landed in;
+ * the render path itself passes 0, since it only runs after the event. */
+static int
+sbx_live_control_slot_lookup(const SbxLiveControlSlot *slot, double t_sec, int pre_event,
+                             double *out_value) {
+  if (pre_event && slot->has_prev && t_sec < slot->since_sec) {
+    if (!slot->prev_active) return 0;
+    *out_value = slot->prev_value;
+    return 1;
+  }
+  if (!slot->active) return 0;
+  *out_value = sbx_live_control_slot_value_at(slot, t_sec, 0);
+  return 1;
+}
+
+static int
+sbx_mix_fx_bypassed_at(const SbxMixFxState *st, double t_sec) {
+  if (st->bypass_has_prev && t_sec < st->bypass_since_sec)
+    return st->bypass_prev;
+  return st->bypass;
+}
+
 static int
 ctx_has_live_tone_controls(const SbxContext *ctx) {
   if (!ctx) return 0;
@@ -1080,22 +1521,21 @@ sbx_diag_line_bounds(const char *text,
   return 1;
 }
 
+/* Narrows a span-less diagnostic to its quoted token within its line. */
 static void
-sbx_diag_refine_span_from_source(SbxDiagnostic *diag, const char *text) {
-  const char *line_start;
-  const char *line_end;
+sbx_diag_refine_span_in_line(SbxDiagnostic *diag,
+                             const char *line_start,
+                             const char *line_end) {
   char token[SBX_DIAG_MESSAGE_MAX];
   const char *p;
   size_t token_len;
 
-  if (!diag || !text || diag->line == 0)
+  if (!diag || !line_start || diag->line == 0)
     return;
   if (diag->column != 0 && diag->end_column > diag->column)
     return;
   if (!sbx_diag_extract_quoted_token(diag->message, token, sizeof(token)))
     return;
-  if (!sbx_diag_line_bounds(text, diag->line, &line_start, &line_end))
-    return;
 
   token_len = strlen(token);
   if (token_len == 0)
@@ -1112,6 +1552,18 @@ sbx_diag_refine_span_from_source(SbxDiagnostic *diag, const char *text) {
   }
 }
 
+static void
+sbx_diag_refine_span_from_source(SbxDiagnostic *diag, const char *text) {
+  const char *line_start;
+  const char *line_end;
+
+  if (!diag || !text || diag->line == 0)
+    return;
+  if (!sbx_diag_line_bounds(text, diag->line, &line_start, &line_end))
+    return;
+  sbx_diag_refine_span_in_line(diag, line_start, line_end);
+}
+
 static int
 sbx_diag_alloc_one_from_text(SbxDiagnostic **out_diags,
                              size_t *out_count,
@@ -2279,9 +2731,12 @@ parse_interp_mode_token(const char *tok, int *out_interp) {
   return SBX_EINVAL;
 }
 
+/*
+ * tones comes last so a queued frame body (SbxSbgQueuedFrame) can be
+ * stored with only its first tone_len voices.
+ */
 struct SbxVoiceSetKeyframe {
   double time_sec;
-  SbxToneSpec tones[SBX_MAX_SBG_VOICES];
   size_t tone_len;
   int interp;
   int transition_style;
@@ -2289,8 +2744,70 @@ struct SbxVoiceSetKeyframe {
   double mix_amp_pct;
   SbxMixFxSpec mix_fx[SBX_MAX_SBG_MIXFX];
   size_t mix_fx_count;
+  SbxToneSpec tones[SBX_MAX_SBG_VOICES];
 };
 
+#define SBX_VOICE_SET_BODY_SIZE(n) \
+  (offsetof(SbxVoiceSetKeyframe, tones) + (n) * sizeof(SbxToneSpec))
+
+/*
+ * Field-wise equality of parsed tone sets; the structs carry padding, so
+ * memcmp would see uninitialised bytes. Doubles compare by bit pattern so
+ * a match is an exact copy. Unused tone and effect slots past the counts
+ * and time_sec are ignored.
+ */
+static int
+sbx_same_double(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static int
+sbx_tone_spec_same(const SbxToneSpec *a, const SbxToneSpec *b) {
+  return a->mode == b->mode && sbx_same_double(a->carrier_hz, b->carrier_hz) &&
+         sbx_same_double(a->beat_hz, b->beat_hz) && sbx_same_double(a->orbit_hz, b->orbit_hz) &&
+         sbx_same_double(a->orbit_distance_m, b->orbit_distance_m) &&
+         a->orbit_envelope_mode == b->orbit_envelope_mode &&
+         sbx_same_double(a->amplitude, b->amplitude) && a->waveform == b->waveform &&
+         a->envelope_waveform == b->envelope_waveform &&
+         a->noise_waveform == b->noise_waveform &&
+         sbx_same_double(a->duty_cycle, b->duty_cycle) &&
+         sbx_same_double(a->iso_start, b->iso_start) &&
+         sbx_same_double(a->iso_attack, b->iso_attack) &&
+         sbx_same_double(a->iso_release, b->iso_release) &&
+         a->iso_edge_mode == b->iso_edge_mode;
+}
+
+static int
+sbx_mix_fx_spec_same(const SbxMixFxSpec *a, const SbxMixFxSpec *b) {
+  return a->type == b->type && a->waveform == b->waveform &&
+         a->envelope_waveform == b->envelope_waveform &&
+         a->motion_waveform == b->motion_waveform && sbx_same_double(a->carr, b->carr) &&
+         sbx_same_double(a->res, b->res) && sbx_same_double(a->amp, b->amp) &&
+         a->mixam_mode == b->mixam_mode &&
+         sbx_same_double(a->mixam_start, b->mixam_start) &&
+         sbx_same_double(a->mixam_duty, b->mixam_duty) &&
+         sbx_same_double(a->mixam_attack, b->mixam_attack) &&
+         sbx_same_double(a->mixam_release, b->mixam_release) &&
+         a->mixam_edge_mode == b->mixam_edge_mode &&
+         sbx_same_double(a->mixam_floor, b->mixam_floor) &&
+         a->mixam_bind_program_beat == b->mixam_bind_program_beat;
+}
+
+static int
+sbx_voice_set_frame_same(const SbxVoiceSetKeyframe *a, const SbxVoiceSetKeyframe *b) {
+  size_t i;
+  if (a->tone_len != b->tone_len || a->interp != b->interp ||
+      a->transition_style != b->transition_style ||
+      a->mix_amp_present != b->mix_amp_present ||
+      !sbx_same_double(a->mix_amp_pct, b->mix_amp_pct) || a->mix_fx_count != b->mix_fx_count)
+    return 0;
+  for (i = 0; i < a->tone_len; i++)
+    if (!sbx_tone_spec_same(&a->tones[i], &b->tones[i])) return 0;
+  for (i = 0; i < a->mix_fx_count; i++)
+    if (!sbx_mix_fx_spec_same(&a->mix_fx[i], &b->mix_fx[i])) return 0;
+  return 1;
+}
+
 typedef struct {
   char *name;
   SbxVoiceSetKeyframe frame;
@@ -2336,10 +2853,54 @@ sbg_transition_token_to_style(const char *tok) {
   return SBX_SEG_STYLE_SBG_DEFAULT;
 }
 
+/*
+ * Open-addressing hash index over the names of one definition table
+ * (tone-sets or blocks). Slots point at the stored names, which never
+ * move, and carry the definition index; names are unique per table, so a
+ * hit is the same entry the in-order scan would return. Comparison is
+ * exact (case-sensitive), as before.
+ */
+typedef struct {
+  const char *name; /* NULL = empty slot */
+  unsigned hash;
+  int idx;
+} SbxNameIndexSlot;
+
+typedef struct {
+  SbxNameIndexSlot *slots;
+  size_t mask;      /* slot count - 1 (power of two) */
+  size_t used;
+} SbxNameIndex;
+
+static unsigned
+sbx_name_hash(const char *name) {
+  unsigned h = 2166136261u;
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int
+sbx_name_index_find(const SbxNameIndex *ix, const char *name) {
+  unsigned h;
+  size_t i;
+  if (!ix || !ix->slots || !name) return -1;
+  h = sbx_name_hash(name);
+  for (i = h & ix->mask; ix->slots[i].name; i = (i + 1) & ix->mask) {
+    if (ix->slots[i].hash == h && strcmp(ix->slots[i].name, name) == 0)
+      return ix->slots[i].idx;
+  }
+  return -1;
+}
+
 static int
-named_tone_find(const SbxNamedToneDef *defs, size_t ndefs, const char *name) {
+named_tone_find(const SbxNamedToneDef *defs, size_t ndefs,
+                const SbxNameIndex *index, const char *name) {
   size_t i;
   if (!defs || !name) return -1;
+  if (index && index->slots) return sbx_name_index_find(index, name);
   for (i = 0; i < ndefs; i++) {
     if (defs[i].name && strcmp(defs[i].name, name) == 0)
       return (int)i;
@@ -2348,9 +2909,11 @@ named_tone_find(const SbxNamedToneDef *defs, size_t ndefs, const char *name) {
 }
 
 static int
-named_block_find(const SbxNamedBlockDef *defs, size_t ndefs, const char *name) {
+named_block_find(const SbxNamedBlockDef *defs, size_t ndefs,
+                 const SbxNameIndex *index, const char *name) {
   size_t i;
   if (!defs || !name) return -1;
+  if (index && index->slots) return sbx_name_index_find(index, name);
   for (i = 0; i < ndefs; i++) {
     if (defs[i].name && strcmp(defs[i].name, name) == 0)
       return (int)i;
@@ -2364,9 +2927,11 @@ sbx_frame_apply_token(SbxVoiceSetKeyframe *frame,
                       const SbxContext *ctx,
                       const SbxNamedToneDef *defs,
                       size_t ndefs,
+                      const SbxNameIndex *def_index,
                       int *out_block_idx,
                       const SbxNamedBlockDef *blocks,
-                      size_t nblocks) {
+                      size_t nblocks,
+                      const SbxNameIndex *block_index) {
   int extra_type = SBX_EXTRA_INVALID;
   SbxToneSpec tone;
   SbxMixFxSpec fx;
@@ -2381,11 +2946,11 @@ sbx_frame_apply_token(SbxVoiceSetKeyframe *frame,
   if (strcmp(tok, "-") == 0)
     return sbx_voice_set_frame_append_gap(frame);
 
-  didx = named_tone_find(defs, ndefs, tok);
+  didx = named_tone_find(defs, ndefs, def_index, tok);
   if (didx >= 0)
     return sbx_voice_set_frame_merge(frame, &defs[didx].frame);
 
-  bidx = named_block_find(blocks, nblocks, tok);
+  bidx = named_block_find(blocks, nblocks, block_index, tok);
   if (bidx >= 0) {
     if (out_block_idx) {
       *out_block_idx = bidx;
@@ -2439,8 +3004,154 @@ parse_sbg_relative_offset_token(const char *tok, double *out_sec) {
   return SBX_OK;
 }
 
+/*
+ * Transient allocations of one .sbg timing load (token vectors, names,
+ * definitions, block entries and the keyframe arrays handed to the
+ * context, which copies them) come from this arena and are released
+ * together. Small requests are bump-allocated from shared
+ * chunks; large ones get their own block so growing them can realloc
+ * instead of copying into a new chunk.
+ */
+#define SBX_PARSE_ARENA_CHUNK (64 * 1024)
+#define SBX_PARSE_ARENA_ALIGN 16
+
+typedef struct SbxParseArenaBlock SbxParseArenaBlock;
+struct SbxParseArenaBlock {
+  SbxParseArenaBlock *next;
+  size_t used;
+  size_t cap;
+  double pad_; /* keeps the data after the header aligned */
+};
+
+typedef struct {
+  SbxParseArenaBlock *chunks; /* newest first; bump allocation from the head */
+  SbxParseArenaBlock *big;    /* one allocation per block */
+} SbxParseArena;
+
+#define SBX_PARSE_ARENA_DATA(b) ((char *)((b) + 1))
+
+static size_t
+sbx_parse_arena_round(size_t size) {
+  return (size + SBX_PARSE_ARENA_ALIGN - 1) & ~(size_t)(SBX_PARSE_ARENA_ALIGN - 1);
+}
+
+/* Zeroed storage that lives until sbx_parse_arena_free. */
+static void *
+sbx_parse_arena_alloc(SbxParseArena *a, size_t size) {
+  SbxParseArenaBlock *b;
+  void *p;
+
+  size = sbx_parse_arena_round(size ? size : 1);
+  if (size > SBX_PARSE_ARENA_CHUNK / 4) {
+    b = (SbxParseArenaBlock *)calloc(1, sizeof(*b) + size);
+    if (!b) return 0;
+    b->used = b->cap = size;
+    b->next = a->big;
+    a->big = b;
+    return SBX_PARSE_ARENA_DATA(b);
+  }
+  b = a->chunks;
+  if (!b || b->cap - b->used < size) {
+    b = (SbxParseArenaBlock *)malloc(sizeof(*b) + SBX_PARSE_ARENA_CHUNK);
+    if (!b) return 0;
+    b->used = 0;
+    b->cap = SBX_PARSE_ARENA_CHUNK;
+    b->next = a->chunks;
+    a->chunks = b;
+  }
+  p = SBX_PARSE_ARENA_DATA(b) + b->used;
+  b->used += size;
+  memset(p, 0, size);
+  return p;
+}
+
+/*
+ * Resizes p (old_size bytes, NULL for none) to new_size, keeping its
+ * contents. Bytes past old_size are not zeroed. The newest chunk
+ * allocation grows in place; large blocks are realloc'd.
+ */
+static void *
+sbx_parse_arena_grow(SbxParseArena *a, void *p, size_t old_size, size_t new_size) {
+  SbxParseArenaBlock *b, **link;
+  void *np;
+
+  if (!p) return sbx_parse_arena_alloc(a, new_size);
+  for (link = &a->big; (b = *link) != 0; link = &b->next) {
+    if (SBX_PARSE_ARENA_DATA(b) == (char *)p) {
+      size_t cap = sbx_parse_arena_round(new_size);
+      SbxParseArenaBlock *nb = (SbxParseArenaBlock *)realloc(b, sizeof(*b) + cap);
+      if (!nb) return 0;
+      nb->used = nb->cap = cap;
+      *link = nb;
+      return SBX_PARSE_ARENA_DATA(nb);
+    }
+  }
+  b = a->chunks;
+  if (b && (char *)p + sbx_parse_arena_round(old_size) == SBX_PARSE_ARENA_DATA(b) + b->used &&
+      (size_t)((char *)p - SBX_PARSE_ARENA_DATA(b)) + sbx_parse_arena_round(new_size) <= b->cap &&
+      new_size <= SBX_PARSE_ARENA_CHUNK / 4) {
+    b->used = (size_t)((char *)p - SBX_PARSE_ARENA_DATA(b)) + sbx_parse_arena_round(new_size);
+    return p;
+  }
+  np = sbx_parse_arena_alloc(a, new_size);
+  if (np) memcpy(np, p, old_size < new_size ? old_size : new_size);
+  return np;
+}
+
+static char *
+sbx_parse_arena_strdup(SbxParseArena *a, const char *s) {
+  size_t n = strlen(s) + 1;
+  char *d = (char *)sbx_parse_arena_alloc(a, n);
+  if (d) memcpy(d, s, n);
+  return d;
+}
+
+static void
+sbx_parse_arena_free(SbxParseArena *a) {
+  SbxParseArenaBlock *b;
+  while ((b = a->chunks) != 0) {
+    a->chunks = b->next;
+    free(b);
+  }
+  while ((b = a->big) != 0) {
+    a->big = b->next;
+    free(b);
+  }
+}
+
+/* Releases everything but the newest chunk, which is kept for reuse. */
+static void
+sbx_parse_arena_reset(SbxParseArena *a) {
+  SbxParseArenaBlock *b;
+  while ((b = a->big) != 0) {
+    a->big = b->next;
+    free(b);
+  }
+  if (!a->chunks) return;
+  while ((b = a->chunks->next) != 0) {
+    a->chunks->next = b->next;
+    free(b);
+  }
+  a->chunks->used = 0;
+}
+
+/* Doubles *cap (from 8) until index count fits; elem-sized slots. */
+static int
+sbx_parse_arena_reserve(SbxParseArena *a, void **arr, size_t *cap, size_t count, size_t elem) {
+  size_t ncap;
+  void *tmp;
+  if (count < *cap) return SBX_OK;
+  ncap = *cap ? (*cap * 2) : 8;
+  if (ncap > ((size_t)-1) / elem) return SBX_ENOMEM;
+  tmp = sbx_parse_arena_grow(a, *arr, *cap * elem, ncap * elem);
+  if (!tmp) return SBX_ENOMEM;
+  *arr = tmp;
+  *cap = ncap;
+  return SBX_OK;
+}
+
 static int
-split_ws_tokens_inplace(char *text, char ***out_tokv, size_t *out_count) {
+split_ws_tokens_inplace(SbxParseArena *arena, char *text, char ***out_tokv, size_t *out_count) {
   char **tokv = 0;
   size_t count = 0, cap = 0;
   char *p;
@@ -2449,18 +3160,9 @@ split_ws_tokens_inplace(char *text, char ***out_tokv, size_t *out_count) {
 
   p = (char *)skip_ws(text);
   while (*p) {
-    char **tmp;
     char *q = p;
-    if (count == cap) {
-      size_t ncap = cap ? (cap * 2) : 8;
-      tmp = (char **)realloc(tokv, ncap * sizeof(*tokv));
-      if (!tmp) {
-        if (tokv) free(tokv);
-        return SBX_ENOMEM;
-      }
-      tokv = tmp;
-      cap = ncap;
-    }
+    if (sbx_parse_arena_reserve(arena, (void **)&tokv, &cap, count, sizeof(*tokv)) != SBX_OK)
+      return SBX_ENOMEM;
     tokv[count++] = p;
     while (*q && !isspace((unsigned char)*q)) q++;
     if (*q) {
@@ -2476,19 +3178,46 @@ split_ws_tokens_inplace(char *text, char ***out_tokv, size_t *out_count) {
   return SBX_OK;
 }
 
+/* Adds name -> idx; the slot table doubles past half full. */
+static int
+sbx_name_index_add(SbxParseArena *arena, SbxNameIndex *ix, const char *name, int idx) {
+  size_t i;
+  unsigned h;
+
+  if (!ix || !name) return SBX_EINVAL;
+  if (!ix->slots || (ix->used + 1) * 2 > ix->mask + 1) {
+    size_t ncount = ix->slots ? (ix->mask + 1) * 2 : 64;
+    SbxNameIndexSlot *ns;
+    size_t j;
+    if (ncount > ((size_t)-1) / sizeof(*ns)) return SBX_ENOMEM;
+    ns = (SbxNameIndexSlot *)sbx_parse_arena_alloc(arena, ncount * sizeof(*ns));
+    if (!ns) return SBX_ENOMEM;
+    for (j = 0; ix->slots && j <= ix->mask; j++) {
+      const SbxNameIndexSlot *sl = &ix->slots[j];
+      if (!sl->name) continue;
+      for (i = sl->hash & (ncount - 1); ns[i].name; i = (i + 1) & (ncount - 1)) {}
+      ns[i] = *sl;
+    }
+    ix->slots = ns;
+    ix->mask = ncount - 1;
+  }
+  h = sbx_name_hash(name);
+  for (i = h & ix->mask; ix->slots[i].name; i = (i + 1) & ix->mask) {}
+  ix->slots[i].name = name;
+  ix->slots[i].hash = h;
+  ix->slots[i].idx = idx;
+  ix->used++;
+  return SBX_OK;
+}
+
 static int
-block_append_entry(SbxNamedBlockDef *blk,
+block_append_entry(SbxParseArena *arena,
+                   SbxNamedBlockDef *blk,
                    const SbxVoiceSetKeyframe *entry) {
-  SbxVoiceSetKeyframe *tmp;
-  size_t ncap;
   if (!blk || !entry) return SBX_EINVAL;
-  if (blk->count == blk->cap) {
-    ncap = blk->cap ? (blk->cap * 2) : 8;
-    tmp = (SbxVoiceSetKeyframe *)realloc(blk->entries, ncap * sizeof(*blk->entries));
-    if (!tmp) return SBX_ENOMEM;
-    blk->entries = tmp;
-    blk->cap = ncap;
-  }
+  if (sbx_parse_arena_reserve(arena, (void **)&blk->entries, &blk->cap, blk->count,
+                              sizeof(*blk->entries)) != SBX_OK)
+    return SBX_ENOMEM;
   blk->entries[blk->count] = *entry;
   blk->count++;
   return SBX_OK;
@@ -2632,7 +3361,7 @@ sbx_monotonic_day_wrap(double t_sec, double last_t_sec) {
 }
 
 static int
-read_text_file_alloc(const char *path, char **out_text) {
+read_text_file_alloc(const char *path, char **out_text, size_t *out_len) {
   FILE *fp = 0;
   char chunk[4096];
   char *text = 0;
@@ -2683,27 +3412,155 @@ read_text_file_alloc(const char *path, char **out_text) {
   }
 
   *out_text = text;
+  if (out_len) *out_len = len;
   return SBX_OK;
 }
 
+/*
+ * Read-only view of a whole file. Text views are NUL-terminated: files are
+ * mapped when the size leaves slack in the last page (the kernel zero-fills
+ * it, which provides the terminator). Binary views map any non-empty file.
+ * Otherwise (page-multiple text, empty or unmappable files) the view is a
+ * heap copy from read_text_file_alloc.
+ */
+typedef struct {
+  const char *text;
+  size_t len;
+  char *heap;       /* fallback copy, else NULL */
+  void *map;
+  size_t map_len;
+#if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
+  HANDLE file;
+  HANDLE mapping;
+#endif
+} SbxTextFile;
+
 static int
-sbx_parse_safe_seqfile_option_line_lib(const char *line,
-                                       SbxSafeSeqfilePreamble *out_cfg,
-                                       char *errbuf,
-                                       size_t errbuf_sz) {
-  char *dup, *argv[64], *p;
-  int argc = 0, i;
+sbx_file_view_open(const char *path, SbxTextFile *tf, int binary) {
+  int rc;
 
-  if (!line || !out_cfg) {
-    sbx_set_api_error(errbuf, errbuf_sz,
-                      "internal error while parsing safe sequence-file preamble");
-    return 0;
+  if (!path || !tf) return SBX_EINVAL;
+  memset(tf, 0, sizeof(*tf));
+#if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
+  {
+    SYSTEM_INFO si;
+    LARGE_INTEGER size;
+    HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, 0);
+    if (fh == INVALID_HANDLE_VALUE) return SBX_EINVAL;
+    GetSystemInfo(&si);
+    if (GetFileSizeEx(fh, &size) && size.QuadPart > 0 &&
+        (unsigned long long)size.QuadPart < (size_t)-1 &&
+        (binary || (size.QuadPart % si.dwPageSize) != 0)) {
+      HANDLE mh = CreateFileMappingA(fh, 0, PAGE_READONLY, 0, 0, 0);
+      void *view = mh ? MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0) : 0;
+      if (view) {
+        tf->file = fh;
+        tf->mapping = mh;
+        tf->map = view;
+        tf->map_len = (size_t)size.QuadPart;
+        tf->text = (const char *)view;
+        tf->len = tf->map_len;
+        return SBX_OK;
+      }
+      if (mh) CloseHandle(mh);
+    }
+    CloseHandle(fh);
   }
-
-  dup = strdup(line);
-  if (!dup) {
-    sbx_set_api_error(errbuf, errbuf_sz, "out of memory parsing safe sequence-file preamble");
-    return 0;
+#else
+  {
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return SBX_EINVAL;
+    if (page > 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        (unsigned long long)st.st_size < (size_t)-1 &&
+        (binary || (st.st_size % page) != 0)) {
+      void *m = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m != MAP_FAILED) {
+        close(fd);
+        tf->map = m;
+        tf->map_len = (size_t)st.st_size;
+        tf->text = (const char *)m;
+        tf->len = tf->map_len;
+        return SBX_OK;
+      }
+    }
+    close(fd);
+  }
+#endif
+  rc = read_text_file_alloc(path, &tf->heap, &tf->len);
+  if (rc != SBX_OK) return rc;
+  tf->text = tf->heap;
+  if (!binary) tf->len = strlen(tf->heap);
+  return SBX_OK;
+}
+
+static int
+sbx_text_file_open(const char *path, SbxTextFile *tf) {
+  return sbx_file_view_open(path, tf, 0);
+}
+
+static void
+sbx_text_file_close(SbxTextFile *tf) {
+  if (!tf) return;
+#if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
+  if (tf->map) UnmapViewOfFile(tf->map);
+  if (tf->mapping) CloseHandle(tf->mapping);
+  if (tf->file) CloseHandle(tf->file);
+#else
+  if (tf->map) munmap(tf->map, tf->map_len);
+#endif
+  if (tf->heap) free(tf->heap);
+  memset(tf, 0, sizeof(*tf));
+}
+
+/*
+ * Copies the line at *cursor (without its '\n') into the reusable *buf,
+ * NUL-terminated, and advances *cursor to the next line. Line parsers
+ * tokenize the copy in place, so the source text is never duplicated as a
+ * whole or modified.
+ */
+static int
+sbx_text_next_line(const char **cursor, char **buf, size_t *cap, size_t *out_len) {
+  const char *src = *cursor;
+  const char *eol = strchr(src, '\n');
+  size_t n = eol ? (size_t)(eol - src) : strlen(src);
+
+  if (n + 1 > *cap) {
+    size_t ncap = *cap ? *cap : 256;
+    char *tmp;
+    while (ncap < n + 1) ncap *= 2;
+    tmp = (char *)realloc(*buf, ncap);
+    if (!tmp) return SBX_ENOMEM;
+    *buf = tmp;
+    *cap = ncap;
+  }
+  memcpy(*buf, src, n);
+  (*buf)[n] = 0;
+  *cursor = eol ? eol + 1 : src + n;
+  if (out_len) *out_len = n;
+  return SBX_OK;
+}
+
+static int
+sbx_parse_safe_seqfile_option_line_lib(const char *line,
+                                       SbxSafeSeqfilePreamble *out_cfg,
+                                       char *errbuf,
+                                       size_t errbuf_sz) {
+  char *dup, *argv[64], *p;
+  int argc = 0, i;
+
+  if (!line || !out_cfg) {
+    sbx_set_api_error(errbuf, errbuf_sz,
+                      "internal error while parsing safe sequence-file preamble");
+    return 0;
+  }
+
+  dup = strdup(line);
+  if (!dup) {
+    sbx_set_api_error(errbuf, errbuf_sz, "out of memory parsing safe sequence-file preamble");
+    return 0;
   }
   p = dup;
   while (*p) {
@@ -3267,7 +4124,7 @@ sbx_prepare_safe_seqfile_text(const char *path,
                               SbxSafeSeqfilePreamble *out_cfg,
                               char *errbuf,
                               size_t errbuf_sz) {
-  char *text = 0;
+  SbxTextFile tf;
   int rc;
 
   if (errbuf && errbuf_sz) errbuf[0] = 0;
@@ -3277,97 +4134,110 @@ sbx_prepare_safe_seqfile_text(const char *path,
     return SBX_EINVAL;
   }
 
-  rc = read_text_file_alloc(path, &text);
+  rc = sbx_text_file_open(path, &tf);
   if (rc != SBX_OK) {
     sbx_set_api_error(errbuf, errbuf_sz,
                       "unable to read sequence file: %s", path ? path : "(null)");
     return rc;
   }
 
-  rc = sbx_prepare_safe_seq_text(text, out_text, out_cfg, errbuf, errbuf_sz);
-  free(text);
+  rc = sbx_prepare_safe_seq_text(tf.text, out_text, out_cfg, errbuf, errbuf_sz);
+  sbx_text_file_close(&tf);
   return rc;
 }
 
-int
-sbx_validate_sbg_text(const char *text,
-                      const char *source_name,
+void
+sbx_default_sbg_load_config(SbxSbgLoadConfig *cfg) {
+  if (!cfg) return;
+  memset(cfg, 0, sizeof(*cfg));
+  sbx_default_engine_config(&cfg->engine);
+  cfg->rate_from_preamble = 1;
+}
+
+/* Swaps a lone load error for the list a validation session reports,
+ * provided the session leads with the same error. */
+static void
+sbx_diag_expand_with_session(const char *text, SbxDiagnostic **diags, size_t *count) {
+  SbxValidateSession *s;
+  const SbxDiagnostic *all;
+  SbxDiagnostic *copy;
+  size_t n;
+
+  if (!*diags || *count != 1) return;
+  s = sbx_validate_session_create(text, 0, 0);
+  if (!s) return;
+  if (sbx_validate_session_diagnostics(s, &all, &n) == SBX_OK && n > 1 &&
+      all[0].line == (*diags)->line && all[0].column == (*diags)->column &&
+      strcmp(all[0].message, (*diags)->message) == 0) {
+    copy = (SbxDiagnostic *)malloc(n * sizeof(*copy));
+    if (copy) {
+      memcpy(copy, all, n * sizeof(*copy));
+      free(*diags);
+      *diags = copy;
+      *count = n;
+    }
+  }
+  sbx_validate_session_destroy(s);
+}
+
+/* Prepares, configures, loads and checks -A once; the context is kept on
+ * success when out_ctx is given. full_list widens a failure to every error. */
+static int
+sbx_validate_load_sbg(const char *text,
+                      const SbxSbgLoadConfig *load_cfg,
+                      int full_list,
+                      SbxContext **out_ctx,
+                      SbxSafeSeqfilePreamble *out_preamble,
                       SbxDiagnostic **out_diags,
                       size_t *out_count) {
   char *prepared = 0;
   char errbuf[512];
   SbxSafeSeqfilePreamble cfg;
+  SbxSbgLoadConfig defaults;
   SbxEngineConfig eng_cfg;
   SbxContext *ctx = 0;
-  int rc;
+  int rc, failed = 1;
 
-  if (out_diags) *out_diags = 0;
-  if (out_count) *out_count = 0;
-  if (!text || !out_diags || !out_count)
-    return SBX_EINVAL;
-  (void)source_name;
+  if (!load_cfg) {
+    sbx_default_sbg_load_config(&defaults);
+    load_cfg = &defaults;
+  }
 
   errbuf[0] = 0;
   sbx_default_safe_seqfile_preamble(&cfg);
   rc = sbx_prepare_safe_seq_text(text, &prepared, &cfg, errbuf, sizeof(errbuf));
   if (rc != SBX_OK) {
-    sbx_free_safe_seqfile_preamble(&cfg);
     if (rc == SBX_EINVAL)
-      return sbx_diag_alloc_one_from_text(out_diags, out_count, SBX_DIAG_ERROR,
-                                          "sbg-parse",
-                                          errbuf[0] ? errbuf : "SBaGenX validation failed",
-                                          text);
-    return rc;
+      rc = sbx_diag_alloc_one_from_text(out_diags, out_count, SBX_DIAG_ERROR,
+                                        "sbg-parse",
+                                        errbuf[0] ? errbuf : "SBaGenX validation failed",
+                                        text);
+    goto done;
   }
 
-  sbx_default_engine_config(&eng_cfg);
-  if (cfg.have_r)
+  eng_cfg = load_cfg->engine;
+  if (cfg.have_r && load_cfg->rate_from_preamble)
     eng_cfg.sample_rate = (double)cfg.rate;
   ctx = sbx_context_create(&eng_cfg);
   if (!ctx) {
-    sbx_free_safe_seqfile_preamble(&cfg);
-    free(prepared);
-    return SBX_ENOMEM;
+    rc = SBX_ENOMEM;
+    goto done;
   }
 
-  if (cfg.have_w &&
-      SBX_OK != sbx_context_set_default_waveform(ctx, cfg.waveform)) {
-    rc = sbx_diag_alloc_one_from_ctx_error(out_diags, out_count, SBX_DIAG_ERROR,
-                                           "sbg-parse", ctx, sbx_context_last_error(ctx), text);
-    sbx_context_destroy(ctx);
-    sbx_free_safe_seqfile_preamble(&cfg);
-    free(prepared);
-    return rc;
-  }
-  if (cfg.have_I &&
-      SBX_OK != sbx_context_set_sequence_iso_override(ctx, &cfg.iso_env)) {
-    rc = sbx_diag_alloc_one_from_ctx_error(out_diags, out_count, SBX_DIAG_ERROR,
-                                           "sbg-parse", ctx, sbx_context_last_error(ctx), text);
-    sbx_context_destroy(ctx);
-    sbx_free_safe_seqfile_preamble(&cfg);
-    free(prepared);
-    return rc;
-  }
-  if (cfg.have_H &&
-      SBX_OK != sbx_context_set_sequence_mixam_override(ctx, &cfg.mixam_env)) {
-    rc = sbx_diag_alloc_one_from_ctx_error(out_diags, out_count, SBX_DIAG_ERROR,
-                                           "sbg-parse", ctx, sbx_context_last_error(ctx), text);
-    sbx_context_destroy(ctx);
-    sbx_free_safe_seqfile_preamble(&cfg);
-    free(prepared);
-    return rc;
-  }
-  if (cfg.have_c &&
-      SBX_OK != sbx_context_set_amp_adjust(ctx, &cfg.amp_adjust)) {
+  if ((cfg.have_w &&
+       SBX_OK != sbx_context_set_default_waveform(ctx, cfg.waveform)) ||
+      (cfg.have_I &&
+       SBX_OK != sbx_context_set_sequence_iso_override(ctx, &cfg.iso_env)) ||
+      (cfg.have_H &&
+       SBX_OK != sbx_context_set_sequence_mixam_override(ctx, &cfg.mixam_env)) ||
+      (cfg.have_c &&
+       SBX_OK != sbx_context_set_amp_adjust(ctx, &cfg.amp_adjust))) {
     rc = sbx_diag_alloc_one_from_ctx_error(out_diags, out_count, SBX_DIAG_ERROR,
                                            "sbg-parse", ctx, sbx_context_last_error(ctx), text);
-    sbx_context_destroy(ctx);
-    sbx_free_safe_seqfile_preamble(&cfg);
-    free(prepared);
-    return rc;
+    goto done;
   }
 
-  rc = sbx_context_load_sbg_timing_text(ctx, prepared, 0);
+  rc = sbx_context_load_sbg_timing_text(ctx, prepared, load_cfg->loop);
   if (rc != SBX_OK) {
     rc = sbx_diag_alloc_one_from_ctx_error(out_diags, out_count, SBX_DIAG_ERROR,
                                            "sbg-parse",
@@ -3376,10 +4246,7 @@ sbx_validate_sbg_text(const char *text,
                                              sbx_context_last_error(ctx) :
                                              "SBaGenX validation failed",
                                            text);
-    sbx_context_destroy(ctx);
-    sbx_free_safe_seqfile_preamble(&cfg);
-    free(prepared);
-    return rc;
+    goto done;
   }
 
   if (cfg.have_A) {
@@ -3393,17 +4260,54 @@ sbx_validate_sbg_text(const char *text,
     if (SBX_OK != sbx_context_set_mix_mod(ctx, &mix_mod)) {
       rc = sbx_diag_alloc_one_from_ctx_error(out_diags, out_count, SBX_DIAG_ERROR,
                                              "sbg-parse", ctx, sbx_context_last_error(ctx), text);
-      sbx_context_destroy(ctx);
-      sbx_free_safe_seqfile_preamble(&cfg);
-      free(prepared);
-      return rc;
+      goto done;
     }
   }
+  failed = 0;
 
+done:
+  if (failed && rc == SBX_OK && full_list)
+    sbx_diag_expand_with_session(text, out_diags, out_count);
+  if (!failed && out_ctx) {
+    *out_ctx = ctx;
+    ctx = 0;
+  }
   sbx_context_destroy(ctx);
-  sbx_free_safe_seqfile_preamble(&cfg);
+  if (out_preamble)
+    *out_preamble = cfg;
+  else
+    sbx_free_safe_seqfile_preamble(&cfg);
   free(prepared);
-  return SBX_OK;
+  return rc;
+}
+
+int
+sbx_validate_sbg_text(const char *text,
+                      const char *source_name,
+                      SbxDiagnostic **out_diags,
+                      size_t *out_count) {
+  if (out_diags) *out_diags = 0;
+  if (out_count) *out_count = 0;
+  if (!text || !out_diags || !out_count)
+    return SBX_EINVAL;
+  (void)source_name;
+  return sbx_validate_load_sbg(text, 0, 0, 0, 0, out_diags, out_count);
+}
+
+int
+sbx_validate_and_load_sbg_text(const char *text,
+                               const SbxSbgLoadConfig *cfg,
+                               SbxContext **out_ctx,
+                               SbxSafeSeqfilePreamble *out_preamble,
+                               SbxDiagnostic **out_diags,
+                               size_t *out_count) {
+  if (out_ctx) *out_ctx = 0;
+  if (out_preamble) sbx_default_safe_seqfile_preamble(out_preamble);
+  if (out_diags) *out_diags = 0;
+  if (out_count) *out_count = 0;
+  if (!text || !out_diags || !out_count)
+    return SBX_EINVAL;
+  return sbx_validate_load_sbg(text, cfg, 1, out_ctx, out_preamble, out_diags, out_count);
 }
 
 int
@@ -3664,7 +4568,7 @@ sbx_run_option_only_seq_wrapper_file(const char *path,
                                      void *user,
                                      char *errbuf,
                                      size_t errbuf_sz) {
-  char *text = 0;
+  SbxTextFile tf;
   int rc;
 
   if (errbuf && errbuf_sz) errbuf[0] = 0;
@@ -3674,14 +4578,14 @@ sbx_run_option_only_seq_wrapper_file(const char *path,
     return SBX_EINVAL;
   }
 
-  rc = read_text_file_alloc(path, &text);
+  rc = sbx_text_file_open(path, &tf);
   if (rc != SBX_OK) {
     sbx_set_api_error(errbuf, errbuf_sz,
                       "unable to read sequence wrapper file: %s", path);
     return rc;
   }
-  rc = sbx_run_option_only_seq_wrapper_text(text, cb, user, errbuf, errbuf_sz);
-  free(text);
+  rc = sbx_run_option_only_seq_wrapper_text(tf.text, cb, user, errbuf, errbuf_sz);
+  sbx_text_file_close(&tf);
   return rc;
 }
 
@@ -3944,6 +4848,28 @@ normalize_tone(SbxToneSpec *tone, char *err, size_t err_sz) {
   return SBX_OK;
 }
 
+/* Why tone cannot play with these wave tables, or NULL if it can. */
+static const char *
+sbx_tone_missing_table(const SbxToneSpec *tone,
+                       const double *const *legacy_env_waves,
+                       const double *const *custom_env_waves,
+                       const double *const *spin_waves,
+                       const SbxNoiseProfile *const *noise_profiles) {
+  int legacy_env_idx = sbx_envelope_wave_legacy_index(tone->envelope_waveform);
+  int custom_env_idx = sbx_envelope_wave_custom_index(tone->envelope_waveform);
+  int spin_wave_idx = sbx_spin_wave_index(tone->waveform);
+  int noise_wave_idx = sbx_noise_wave_index(tone->noise_waveform);
+  if (legacy_env_idx >= 0 && !legacy_env_waves[legacy_env_idx])
+    return "legacy waveNN envelope is not defined in this context";
+  if (custom_env_idx >= 0 && !custom_env_waves[custom_env_idx])
+    return "customNN envelope is not defined in this context";
+  if (spin_wave_idx >= 0 && !spin_waves[spin_wave_idx])
+    return "spinNN waveform is not defined in this context";
+  if (noise_wave_idx >= 0 && !noise_profiles[noise_wave_idx])
+    return "noiseNN spectrum is not defined in this context";
+  return 0;
+}
+
 static int
 engine_apply_tone(SbxEngine *eng, const SbxToneSpec *tone_in, int reset_phase) {
   SbxToneSpec tone;
@@ -3960,24 +4886,10 @@ engine_apply_tone(SbxEngine *eng, const SbxToneSpec *tone_in, int reset_phase) {
     return rc;
   }
   {
-    int legacy_env_idx = sbx_envelope_wave_legacy_index(tone.envelope_waveform);
-    int custom_env_idx = sbx_envelope_wave_custom_index(tone.envelope_waveform);
-    int spin_wave_idx = sbx_spin_wave_index(tone.waveform);
-    int noise_wave_idx = sbx_noise_wave_index(tone.noise_waveform);
-    if (legacy_env_idx >= 0 && !eng->legacy_env_waves[legacy_env_idx]) {
-      set_last_error(eng, "legacy waveNN envelope is not defined in this context");
-      return SBX_EINVAL;
-    }
-    if (custom_env_idx >= 0 && !eng->custom_env_waves[custom_env_idx]) {
-      set_last_error(eng, "customNN envelope is not defined in this context");
-      return SBX_EINVAL;
-    }
-    if (spin_wave_idx >= 0 && !eng->spin_waves[spin_wave_idx]) {
-      set_last_error(eng, "spinNN waveform is not defined in this context");
-      return SBX_EINVAL;
-    }
-    if (noise_wave_idx >= 0 && !eng->noise_profiles[noise_wave_idx]) {
-      set_last_error(eng, "noiseNN spectrum is not defined in this context");
+    const char *missing = sbx_tone_missing_table(&tone, eng->legacy_env_waves, eng->custom_env_waves,
+                                                 eng->spin_waves, eng->noise_profiles);
+    if (missing) {
+      set_last_error(eng, missing);
       return SBX_EINVAL;
     }
   }
@@ -4519,18 +5431,19 @@ static void
 ctx_clear_keyframes(SbxContext *ctx) {
   size_t i;
   if (!ctx) return;
-  if (ctx->kfs) free(ctx->kfs);
+  sbx_kf_store_free(&ctx->kf_store);
   if (ctx->kf_styles) free(ctx->kf_styles);
-  if (ctx->mv_kfs) free(ctx->mv_kfs);
+  if (ctx->kf_segs) free(ctx->kf_segs);
+  if (ctx->sbg_stream) sbx_sbg_stream_free(ctx->sbg_stream);
+  ctx->sbg_stream = 0;
   if (ctx->mv_eng) {
     for (i = 0; i + 1 < ctx->mv_voice_count; i++) {
       if (ctx->mv_eng[i]) sbx_engine_destroy(ctx->mv_eng[i]);
     }
     free(ctx->mv_eng);
   }
-  ctx->kfs = 0;
   ctx->kf_styles = 0;
-  ctx->mv_kfs = 0;
+  ctx->kf_segs = 0;
   ctx->mv_eng = 0;
   ctx->kf_count = 0;
   ctx->mv_voice_count = 0;
@@ -4618,6 +5531,8 @@ ctx_reset_runtime(SbxContext *ctx) {
   ctx->sbg_mix_fx_seg = 0;
   ctx->mix_kf_seg = 0;
   ctx->t_sec = 0.0;
+  ctx->frame_pos = 0;
+  ctx->telem_next_frame = 0;
   ctx->kf_seg = 0;
   ctx->telemetry_valid = 0;
 }
@@ -4633,6 +5548,8 @@ ctx_activate_keyframes_internal(SbxContext *ctx,
   SbxProgramKeyframe *copy = 0;
   SbxProgramKeyframe *mv_copy = 0;
   unsigned char *style_copy = 0;
+  SbxKeyframeSegment *seg_copy = 0;
+  SbxKeyframeStore store;
   SbxEngine **mv_eng = 0;
   size_t i, vi;
   char err[160];
@@ -4767,37 +5684,66 @@ ctx_activate_keyframes_internal(SbxContext *ctx,
     return SBX_EINVAL;
   }
 
+  /*
+   * Keep only the compact form: shared times plus per-voice lanes and
+   * interned shapes. Segment styles and per-second slopes are resolved once
+   * here, off the render path.
+   */
+  if (sbx_kf_store_build(&store, copy, mv_copy, mv_voice_count, frame_count) != SBX_OK)
+    goto oom;
+  if (frame_count > 1) {
+    seg_copy = (SbxKeyframeSegment *)calloc(mv_voice_count * (frame_count - 1),
+                                            sizeof(*seg_copy));
+    if (!seg_copy) goto oom;
+    sbx_compile_keyframe_segments(&store, frame_count, mv_voice_count, style_copy, seg_copy);
+  }
+  if (mv_copy) free(mv_copy);
+  free(copy);
+
   ctx_clear_keyframes(ctx);
   ctx_clear_curve_source(ctx);
-  ctx->kfs = copy;
+  ctx->kf_store = store;
   ctx->kf_styles = style_copy;
-  ctx->mv_kfs = mv_copy;
+  ctx->kf_segs = seg_copy;
   ctx->mv_eng = mv_eng;
   ctx->kf_count = frame_count;
   ctx->mv_voice_count = mv_voice_count;
   ctx->kf_loop = loop ? 1 : 0;
   ctx->kf_seg = 0;
-  ctx->kf_duration_sec = copy[frame_count - 1].time_sec;
+  ctx->kf_duration_sec = store.time_sec[frame_count - 1];
   ctx->source_mode = SBX_CTX_SRC_KEYFRAMES;
   ctx->loaded = 1;
   ctx->t_sec = 0.0;
   ctx_clear_live_controls_internal(ctx);
 
-  rc = engine_apply_tone(ctx->eng, &ctx->kfs[0].tone, 1);
-  if (rc != SBX_OK) {
-    set_ctx_error(ctx, sbx_engine_last_error(ctx->eng));
-    return rc;
-  }
-  for (vi = 1; vi < mv_voice_count; vi++) {
-    rc = engine_apply_tone(ctx->mv_eng[vi - 1], &SBX_MV_KF(ctx, vi)[0].tone, 1);
+  for (vi = 0; vi < mv_voice_count; vi++) {
+    SbxEngine *eng = (vi == 0) ? ctx->eng : ctx->mv_eng[vi - 1];
+    SbxToneSpec tone0;
+    sbx_kf_store_tone(&ctx->kf_store, frame_count, vi, 0, &tone0);
+    rc = engine_apply_tone(eng, &tone0, 1);
     if (rc != SBX_OK) {
-      set_ctx_error(ctx, sbx_engine_last_error(ctx->mv_eng[vi - 1]));
+      set_ctx_error(ctx, sbx_engine_last_error(eng));
       return rc;
     }
   }
 
   set_ctx_error(ctx, NULL);
   return SBX_OK;
+
+oom:
+  sbx_kf_store_free(&store);
+  if (seg_copy) free(seg_copy);
+  if (mv_eng) {
+    for (vi = 1; vi < mv_voice_count; vi++) {
+      if (mv_eng[vi - 1]) sbx_engine_destroy(mv_eng[vi - 1]);
+    }
+    free(mv_eng);
+  }
+  if (mv_copy) free(mv_copy);
+  free(style_copy);
+  free(copy);
+  set_ctx_error(ctx, "out of memory");
+  return SBX_ENOMEM;
 }
 
 static int
@@ -4932,25 +5878,156 @@ eval_fail:
 }
 
 static void
-sbx_interp_direct_tone(const SbxToneSpec *a,
-                       const SbxToneSpec *b,
-                       double u,
-                       SbxToneSpec *out) {
-  out->mode = a->mode;
-  out->carrier_hz = sbx_lerp(a->carrier_hz, b->carrier_hz, u);
-  out->beat_hz = sbx_lerp(a->beat_hz, b->beat_hz, u);
-  out->orbit_hz = sbx_lerp(a->orbit_hz, b->orbit_hz, u);
-  out->orbit_distance_m = sbx_lerp(a->orbit_distance_m, b->orbit_distance_m, u);
-  out->orbit_envelope_mode = a->orbit_envelope_mode;
-  out->amplitude = sbx_lerp(a->amplitude, b->amplitude, u);
-  out->waveform = a->waveform;
-  out->envelope_waveform = a->envelope_waveform;
-  out->noise_waveform = a->noise_waveform;
-  out->duty_cycle = sbx_lerp(a->duty_cycle, b->duty_cycle, u);
-  out->iso_start = sbx_lerp(a->iso_start, b->iso_start, u);
-  out->iso_attack = sbx_lerp(a->iso_attack, b->iso_attack, u);
-  out->iso_release = sbx_lerp(a->iso_release, b->iso_release, u);
-  out->iso_edge_mode = a->iso_edge_mode;
+sbx_kf_store_free(SbxKeyframeStore *ks) {
+  if (!ks) return;
+  if (ks->time_sec) free(ks->time_sec);
+  if (ks->interp) free(ks->interp);
+  if (ks->lanes) free(ks->lanes);
+  if (ks->shape) free(ks->shape);
+  if (ks->shapes) free(ks->shapes);
+  memset(ks, 0, sizeof(*ks));
+}
+
+static unsigned long long
+sbx_kf_shape_hash_mix(unsigned long long h, const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  size_t i;
+  for (i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static unsigned long long
+sbx_kf_shape_hash(const SbxToneSpec *t) {
+  unsigned long long h = 1469598103934665603ULL;
+  h = sbx_kf_shape_hash_mix(h, &t->mode, sizeof(t->mode));
+  h = sbx_kf_shape_hash_mix(h, &t->orbit_hz, sizeof(t->orbit_hz));
+  h = sbx_kf_shape_hash_mix(h, &t->orbit_distance_m, sizeof(t->orbit_distance_m));
+  h = sbx_kf_shape_hash_mix(h, &t->orbit_envelope_mode, sizeof(t->orbit_envelope_mode));
+  h = sbx_kf_shape_hash_mix(h, &t->waveform, sizeof(t->waveform));
+  h = sbx_kf_shape_hash_mix(h, &t->envelope_waveform, sizeof(t->envelope_waveform));
+  h = sbx_kf_shape_hash_mix(h, &t->noise_waveform, sizeof(t->noise_waveform));
+  h = sbx_kf_shape_hash_mix(h, &t->duty_cycle, sizeof(t->duty_cycle));
+  h = sbx_kf_shape_hash_mix(h, &t->iso_start, sizeof(t->iso_start));
+  h = sbx_kf_shape_hash_mix(h, &t->iso_attack, sizeof(t->iso_attack));
+  h = sbx_kf_shape_hash_mix(h, &t->iso_release, sizeof(t->iso_release));
+  h = sbx_kf_shape_hash_mix(h, &t->iso_edge_mode, sizeof(t->iso_edge_mode));
+  return h;
+}
+
+static int
+sbx_kf_shape_equal(const SbxToneSpec *a, const SbxToneSpec *b) {
+  return a->mode == b->mode &&
+         a->orbit_hz == b->orbit_hz &&
+         a->orbit_distance_m == b->orbit_distance_m &&
+         a->orbit_envelope_mode == b->orbit_envelope_mode &&
+         a->waveform == b->waveform &&
+         a->envelope_waveform == b->envelope_waveform &&
+         a->noise_waveform == b->noise_waveform &&
+         a->duty_cycle == b->duty_cycle &&
+         a->iso_start == b->iso_start &&
+         a->iso_attack == b->iso_attack &&
+         a->iso_release == b->iso_release &&
+         a->iso_edge_mode == b->iso_edge_mode;
+}
+
+/*
+ * Build compact storage for `voice_count` lanes of `n` keyframes. Lane 0 comes
+ * from `primary`; lanes 1.. come from `mv` laid out as [voice][kf].
+ */
+static int
+sbx_kf_store_build(SbxKeyframeStore *ks,
+                   const SbxProgramKeyframe *primary,
+                   const SbxProgramKeyframe *mv,
+                   size_t voice_count,
+                   size_t n) {
+  unsigned int *slots = 0;
+  size_t total = voice_count * n;
+  size_t slot_cap = 16, shape_cap = 0;
+  size_t vi, i;
+
+  memset(ks, 0, sizeof(*ks));
+  while (slot_cap < total * 2) slot_cap <<= 1;
+  ks->time_sec = (double *)calloc(n, sizeof(*ks->time_sec));
+  ks->interp = (unsigned char *)calloc(n, sizeof(*ks->interp));
+  ks->lanes = (double *)calloc(total * SBX_KFSEG_LANE_COUNT, sizeof(*ks->lanes));
+  ks->shape = (unsigned int *)calloc(total, sizeof(*ks->shape));
+  slots = (unsigned int *)calloc(slot_cap, sizeof(*slots));
+  if (!ks->time_sec || !ks->interp || !ks->lanes || !ks->shape || !slots)
+    goto oom;
+
+  for (i = 0; i < n; i++) {
+    ks->time_sec[i] = primary[i].time_sec;
+    ks->interp[i] = (unsigned char)primary[i].interp;
+  }
+  for (vi = 0; vi < voice_count; vi++) {
+    const SbxProgramKeyframe *lane = (vi == 0) ? primary : mv + vi * n;
+    for (i = 0; i < n; i++) {
+      SbxToneSpec shape = lane[i].tone;
+      double *lv = ks->lanes + (vi * n + i) * SBX_KFSEG_LANE_COUNT;
+      size_t slot;
+
+      lv[SBX_KFSEG_LANE_CARRIER] = shape.carrier_hz;
+      lv[SBX_KFSEG_LANE_BEAT] = shape.beat_hz;
+      lv[SBX_KFSEG_LANE_AMPLITUDE] = shape.amplitude;
+      shape.carrier_hz = 0.0;
+      shape.beat_hz = 0.0;
+      shape.amplitude = 0.0;
+
+      slot = (size_t)sbx_kf_shape_hash(&shape) & (slot_cap - 1);
+      while (slots[slot] &&
+             !sbx_kf_shape_equal(&ks->shapes[slots[slot] - 1], &shape))
+        slot = (slot + 1) & (slot_cap - 1);
+      if (!slots[slot]) {
+        if (ks->shape_count == shape_cap) {
+          size_t new_cap = shape_cap ? shape_cap * 2 : 16;
+          SbxToneSpec *grown =
+              (SbxToneSpec *)realloc(ks->shapes, new_cap * sizeof(*grown));
+          if (!grown) goto oom;
+          ks->shapes = grown;
+          shape_cap = new_cap;
+        }
+        ks->shapes[ks->shape_count++] = shape;
+        slots[slot] = (unsigned int)ks->shape_count;
+      }
+      ks->shape[vi * n + i] = slots[slot] - 1;
+    }
+  }
+  free(slots);
+  return SBX_OK;
+
+oom:
+  if (slots) free(slots);
+  sbx_kf_store_free(ks);
+  return SBX_ENOMEM;
+}
+
+static void
+sbx_kf_store_tone(const SbxKeyframeStore *ks,
+                  size_t n,
+                  size_t voice,
+                  size_t i,
+                  SbxToneSpec *out) {
+  size_t k = voice * n + i;
+  const double *lv = ks->lanes + k * SBX_KFSEG_LANE_COUNT;
+  *out = ks->shapes[ks->shape[k]];
+  out->carrier_hz = lv[SBX_KFSEG_LANE_CARRIER];
+  out->beat_hz = lv[SBX_KFSEG_LANE_BEAT];
+  out->amplitude = lv[SBX_KFSEG_LANE_AMPLITUDE];
+}
+
+static void
+sbx_kf_store_frame(const SbxKeyframeStore *ks,
+                   size_t n,
+                   size_t voice,
+                   size_t i,
+                   SbxProgramKeyframe *out) {
+  memset(out, 0, sizeof(*out));
+  out->time_sec = ks->time_sec[i];
+  out->interp = ks->interp[i];
+  sbx_kf_store_tone(ks, n, voice, i, &out->tone);
 }
 
 static int
@@ -4972,121 +6049,153 @@ sbx_tone_needs_default_fade_through(const SbxToneSpec *a,
 }
 
 static void
-sbx_eval_sbg_transition_tone(const SbxToneSpec *a_in,
-                             const SbxToneSpec *b_in,
-                             int seg_style,
-                             double u,
-                             SbxToneSpec *out) {
-  SbxToneSpec a = *a_in;
-  SbxToneSpec b = *b_in;
+sbx_compile_keyframe_segment(const SbxKeyframeStore *ks,
+                             size_t n,
+                             size_t voice,
+                             const unsigned char *styles,
+                             size_t i0,
+                             SbxKeyframeSegment *sg) {
+  SbxToneSpec a, b;
+  double span = ks->time_sec[i0 + 1] - ks->time_sec[i0];
+  int style = styles ? styles[i0] : SBX_SEG_STYLE_DIRECT;
   int fade_through;
 
-  if (seg_style == SBX_SEG_STYLE_SBG_SLIDE) {
-    if (a.mode == SBX_TONE_NONE && b.mode != SBX_TONE_NONE && b.mode != SBX_TONE_BELL) {
-      a = b;
-      a.amplitude = 0.0;
-    } else if (a.mode != SBX_TONE_NONE && b.mode == SBX_TONE_NONE) {
-      b = a;
-      b.amplitude = 0.0;
+  memset(sg, 0, sizeof(*sg));
+  sg->kind = SBX_KFSEG_HOLD;
+  if (!(span > 0.0)) return;
+  sbx_kf_store_tone(ks, n, voice, i0, &a);
+  sbx_kf_store_tone(ks, n, voice, i0 + 1, &b);
+  /*
+   * Bells are edge-triggered events in sequence files. They should not fade
+   * into existence during the lead-in segment before their scheduled time.
+   */
+  if (a.mode == SBX_TONE_BELL || b.mode == SBX_TONE_BELL)
+    return;
+
+  if (style == SBX_SEG_STYLE_DIRECT) {
+    if (ks->interp[i0] == SBX_INTERP_STEP ||
+        a.mode != b.mode || a.waveform != b.waveform)
+      return;
+  } else {
+    if (style == SBX_SEG_STYLE_SBG_SLIDE) {
+      if (a.mode == SBX_TONE_NONE && b.mode != SBX_TONE_NONE && b.mode != SBX_TONE_BELL) {
+        a = b;
+        a.amplitude = 0.0;
+        sg->from_next = 1;
+      } else if (a.mode != SBX_TONE_NONE && b.mode == SBX_TONE_NONE) {
+        b = a;
+        b.amplitude = 0.0;
+        sg->to_prev = 1;
+      }
+    }
+    if (ks->interp[i0] == SBX_INTERP_STEP) return;
+    fade_through =
+        (a.mode != b.mode) ||
+        (a.waveform != b.waveform) ||
+        (style == SBX_SEG_STYLE_SBG_DEFAULT &&
+         sbx_tone_needs_default_fade_through(&a, &b));
+    if (fade_through) {
+      sg->kind = SBX_KFSEG_FADE;
+      sg->dv[SBX_KFSEG_LANE_AMPLITUDE] = -a.amplitude / (0.5 * span);
+      sg->amp2_dv = b.amplitude / (0.5 * span);
+      return;
     }
   }
 
-  fade_through =
-      (a.mode != b.mode) ||
-      (a.waveform != b.waveform) ||
-      (seg_style == SBX_SEG_STYLE_SBG_DEFAULT &&
-       sbx_tone_needs_default_fade_through(&a, &b));
+  sg->kind = SBX_KFSEG_LINEAR;
+  sg->dv[SBX_KFSEG_LANE_CARRIER] = (b.carrier_hz - a.carrier_hz) / span;
+  sg->dv[SBX_KFSEG_LANE_BEAT] = (b.beat_hz - a.beat_hz) / span;
+  sg->dv[SBX_KFSEG_LANE_AMPLITUDE] = (b.amplitude - a.amplitude) / span;
+  sg->lerp_shape = !sg->from_next && !sg->to_prev &&
+                   ks->shape[voice * n + i0] != ks->shape[voice * n + i0 + 1];
+}
 
-  if (fade_through) {
-    if (u <= 0.5) {
-      *out = a;
-      out->amplitude = sbx_lerp(a.amplitude, 0.0, u * 2.0);
-    } else {
-      *out = b;
-      out->amplitude = sbx_lerp(0.0, b.amplitude, (u - 0.5) * 2.0);
-    }
-    return;
+static void
+sbx_compile_keyframe_segments(const SbxKeyframeStore *ks,
+                              size_t n,
+                              size_t voice_count,
+                              const unsigned char *styles,
+                              SbxKeyframeSegment *out_segs) {
+  size_t vi, i;
+  for (vi = 0; vi < voice_count; vi++) {
+    for (i = 0; i + 1 < n; i++)
+      sbx_compile_keyframe_segment(ks, n, vi, styles, i, &out_segs[vi * (n - 1) + i]);
   }
-
-  sbx_interp_direct_tone(&a, &b, u, out);
 }
 
 static void
-ctx_eval_keyframed_tone_at(const SbxProgramKeyframe *kfs,
-                           const unsigned char *styles,
-                           size_t n,
+ctx_eval_keyframed_tone_at(const SbxContext *ctx,
+                           size_t voice,
                            double t_sec,
                            size_t *inout_seg,
                            SbxToneSpec *out) {
-  size_t i0, i1;
-  double t0, t1, u;
-  const SbxProgramKeyframe *k0, *k1;
+  const SbxKeyframeStore *ks = &ctx->kf_store;
+  const SbxKeyframeSegment *sg;
+  size_t n = ctx->kf_count;
   size_t seg = inout_seg ? *inout_seg : 0;
+  double t0, t1, dt;
 
   if (n == 0) {
     sbx_default_tone_spec(out);
     out->mode = SBX_TONE_NONE;
     return;
   }
-  if (n == 1 || t_sec <= kfs[0].time_sec) {
-    *out = kfs[0].tone;
+  if (n == 1 || t_sec <= ks->time_sec[0]) {
+    sbx_kf_store_tone(ks, n, voice, 0, out);
     return;
   }
-  if (t_sec >= kfs[n - 1].time_sec) {
-    *out = kfs[n - 1].tone;
+  if (t_sec >= ks->time_sec[n - 1]) {
+    sbx_kf_store_tone(ks, n, voice, n - 1, out);
     return;
   }
 
   if (seg >= n - 1) seg = n - 2;
-  while (seg + 1 < n && t_sec > kfs[seg + 1].time_sec)
+  while (seg + 1 < n && t_sec > ks->time_sec[seg + 1])
     seg++;
-  while (seg > 0 && t_sec < kfs[seg].time_sec)
+  while (seg > 0 && t_sec < ks->time_sec[seg])
     seg--;
 
-  i0 = seg;
-  i1 = i0 + 1;
-  if (i1 >= n) i1 = n - 1;
-  k0 = &kfs[i0];
-  k1 = &kfs[i1];
-
-  t0 = k0->time_sec;
-  t1 = k1->time_sec;
+  t0 = ks->time_sec[seg];
+  t1 = ks->time_sec[seg + 1];
   if (t1 <= t0) {
-    *out = k0->tone;
+    sbx_kf_store_tone(ks, n, voice, seg, out);
     return;
   }
   if (t_sec >= t1) {
-    *out = k1->tone;
+    sbx_kf_store_tone(ks, n, voice, seg + 1, out);
     return;
   }
-  u = (t_sec - t0) / (t1 - t0);
-  if (u < 0.0) u = 0.0;
-  if (u > 1.0) u = 1.0;
-  if (k0->interp == SBX_INTERP_STEP)
-    u = 0.0;
-  /*
-   * Bells are edge-triggered events in sequence files. They should not fade
-   * into existence during the lead-in segment before their scheduled time.
-   */
-  if (k0->tone.mode == SBX_TONE_BELL || k1->tone.mode == SBX_TONE_BELL) {
-    *out = k0->tone;
-    if (inout_seg) *inout_seg = seg;
-    return;
+  sg = SBX_KF_SEGS(ctx, voice) + seg;
+  dt = t_sec - t0;
+  if (sg->kind == SBX_KFSEG_FADE && dt > 0.5 * (t1 - t0)) {
+    sbx_kf_store_tone(ks, n, voice, sg->to_prev ? seg : seg + 1, out);
+    out->amplitude = sg->amp2_dv * (dt - 0.5 * (t1 - t0));
+  } else {
+    sbx_kf_store_tone(ks, n, voice, sg->from_next ? seg + 1 : seg, out);
+    if (sg->from_next) out->amplitude = 0.0;
+    if (sg->kind != SBX_KFSEG_HOLD) {
+      out->carrier_hz += sg->dv[SBX_KFSEG_LANE_CARRIER] * dt;
+      out->beat_hz += sg->dv[SBX_KFSEG_LANE_BEAT] * dt;
+      out->amplitude += sg->dv[SBX_KFSEG_LANE_AMPLITUDE] * dt;
+    }
+    if (sg->lerp_shape) {
+      const SbxToneSpec *sa = &ks->shapes[ks->shape[voice * n + seg]];
+      const SbxToneSpec *sb = &ks->shapes[ks->shape[voice * n + seg + 1]];
+      double u = dt / (t1 - t0);
+      out->orbit_hz = sbx_lerp(sa->orbit_hz, sb->orbit_hz, u);
+      out->orbit_distance_m = sbx_lerp(sa->orbit_distance_m, sb->orbit_distance_m, u);
+      out->duty_cycle = sbx_lerp(sa->duty_cycle, sb->duty_cycle, u);
+      out->iso_start = sbx_lerp(sa->iso_start, sb->iso_start, u);
+      out->iso_attack = sbx_lerp(sa->iso_attack, sb->iso_attack, u);
+      out->iso_release = sbx_lerp(sa->iso_release, sb->iso_release, u);
+    }
   }
-  if (styles && styles[i0] != SBX_SEG_STYLE_DIRECT)
-    sbx_eval_sbg_transition_tone(&k0->tone, &k1->tone, styles[i0], u, out);
-  else if (k0->tone.mode != k1->tone.mode ||
-           k0->tone.waveform != k1->tone.waveform)
-    *out = k0->tone;
-  else
-    sbx_interp_direct_tone(&k0->tone, &k1->tone, u, out);
   if (inout_seg) *inout_seg = seg;
 }
 
 static void
 ctx_eval_keyframed_tone(SbxContext *ctx, double t_sec, SbxToneSpec *out) {
-  ctx_eval_keyframed_tone_at(ctx->kfs, ctx->kf_styles, ctx->kf_count,
-                             t_sec, &ctx->kf_seg, out);
+  ctx_eval_keyframed_tone_at(ctx, 0, t_sec, &ctx->kf_seg, out);
 }
 
 static double
@@ -5109,7 +6218,7 @@ ctx_eval_program_beat_hz_voice(SbxContext *ctx, size_t voice_index, double t_sec
   if (ctx_eval_voice_tone_base_at(ctx, voice_index, t_sec, &tone) != SBX_OK)
     return 0.0;
   if (voice_index == 0 &&
-      ctx_apply_live_controls_to_tone(ctx, t_sec, &tone) != SBX_OK)
+      ctx_apply_live_controls_to_tone(ctx, t_sec, 1, &tone) != SBX_OK)
     return 0.0;
 
   if (!isfinite(tone.beat_hz)) return 0.0;
@@ -5129,14 +6238,16 @@ ctx_eval_primary_tone_base_at(SbxContext *ctx, double t_sec, SbxToneSpec *out) {
       return SBX_OK;
     case SBX_CTX_SRC_CURVE:
       return ctx_eval_curve_tone(ctx, t_sec, out);
+    case SBX_CTX_SRC_BUILTIN:
+      ctx_eval_builtin_tone(ctx, t_sec, out);
+      return SBX_OK;
     case SBX_CTX_SRC_KEYFRAMES:
       seg = ctx->kf_seg;
       if (ctx->kf_loop && ctx->kf_duration_sec > 0.0) {
         t_sec = fmod(t_sec, ctx->kf_duration_sec);
         if (t_sec < 0.0) t_sec += ctx->kf_duration_sec;
       }
-      ctx_eval_keyframed_tone_at(ctx->kfs, ctx->kf_styles, ctx->kf_count,
-                                 t_sec, &seg, out);
+      ctx_eval_keyframed_tone_at(ctx, 0, t_sec, &seg, out);
       return SBX_OK;
     default:
       return SBX_ENOTREADY;
@@ -5146,7 +6257,6 @@ ctx_eval_primary_tone_base_at(SbxContext *ctx, double t_sec, SbxToneSpec *out) {
 static int
 ctx_eval_voice_tone_base_at(SbxContext *ctx, size_t voice_index, double t_sec, SbxToneSpec *out) {
   size_t seg = 0;
-  const SbxProgramKeyframe *kfs = 0;
   if (!ctx || !out) return SBX_EINVAL;
   if (!ctx->loaded) return SBX_ENOTREADY;
   if (voice_index == 0)
@@ -5159,9 +6269,7 @@ ctx_eval_voice_tone_base_at(SbxContext *ctx, size_t voice_index, double t_sec, S
     t_sec = fmod(t_sec, ctx->kf_duration_sec);
     if (t_sec < 0.0) t_sec += ctx->kf_duration_sec;
   }
-  kfs = (voice_index == 0 || !ctx->mv_kfs) ? ctx->kfs : SBX_MV_KF(ctx, voice_index);
-  ctx_eval_keyframed_tone_at(kfs, ctx->kf_styles, ctx->kf_count,
-                             t_sec, &seg, out);
+  ctx_eval_keyframed_tone_at(ctx, voice_index, t_sec, &seg, out);
   return SBX_OK;
 }
 
@@ -5251,19 +6359,16 @@ ctx_eval_live_control_value(SbxContext *ctx, int kind, double t_sec, double *out
 }
 
 static int
-ctx_apply_live_controls_to_tone(SbxContext *ctx, double t_sec, SbxToneSpec *tone) {
+ctx_apply_live_controls_to_tone(SbxContext *ctx, double t_sec, int pre_event, SbxToneSpec *tone) {
   char err[160];
   int idx;
   if (!ctx || !tone) return SBX_EINVAL;
   idx = sbx_live_control_kind_index(SBX_LIVE_CONTROL_CARRIER_HZ);
-  if (ctx->live_ctrl[idx].active)
-    tone->carrier_hz = sbx_live_control_slot_value_at(&ctx->live_ctrl[idx], t_sec, 0);
+  sbx_live_control_slot_lookup(&ctx->live_ctrl[idx], t_sec, pre_event, &tone->carrier_hz);
   idx = sbx_live_control_kind_index(SBX_LIVE_CONTROL_BEAT_HZ);
-  if (ctx->live_ctrl[idx].active)
-    tone->beat_hz = sbx_live_control_slot_value_at(&ctx->live_ctrl[idx], t_sec, 0);
+  sbx_live_control_slot_lookup(&ctx->live_ctrl[idx], t_sec, pre_event, &tone->beat_hz);
   idx = sbx_live_control_kind_index(SBX_LIVE_CONTROL_AMPLITUDE);
-  if (ctx->live_ctrl[idx].active)
-    tone->amplitude = sbx_live_control_slot_value_at(&ctx->live_ctrl[idx], t_sec, 0);
+  sbx_live_control_slot_lookup(&ctx->live_ctrl[idx], t_sec, pre_event, &tone->amplitude);
   if (normalize_tone(tone, err, sizeof(err)) != SBX_OK) {
     set_ctx_error(ctx, err);
     return SBX_EINVAL;
@@ -5277,7 +6382,7 @@ ctx_eval_primary_tone_effective_at(SbxContext *ctx, double t_sec, SbxToneSpec *o
   if (!ctx || !out) return SBX_EINVAL;
   rc = ctx_eval_primary_tone_base_at(ctx, t_sec, out);
   if (rc != SBX_OK) return rc;
-  return ctx_apply_live_controls_to_tone(ctx, t_sec, out);
+  return ctx_apply_live_controls_to_tone(ctx, t_sec, 1, out);
 }
 
 static double
@@ -5316,16 +6421,35 @@ ctx_collect_runtime_telemetry(SbxContext *ctx,
   return SBX_OK;
 }
 
+/* Called once per rendered block with ctx->frame_pos at the block start.
+ * Snapshots are only evaluated when a callback is registered or the
+ * decimated stream is due; each one is a full collection, not an
+ * incremental update of the last. */
 static void
 ctx_emit_telemetry(SbxContext *ctx, double t_sec, const SbxToneSpec *tone_hint) {
   SbxRuntimeTelemetry telem;
+  int stream_due;
   if (!ctx) return;
+  stream_due = ctx->telem_ring && ctx->frame_pos >= ctx->telem_next_frame;
+  if (!ctx->telemetry_cb && !stream_due) return;
   if (ctx_collect_runtime_telemetry(ctx, t_sec, tone_hint, &telem) != SBX_OK)
     return;
   ctx->telemetry_last = telem;
   ctx->telemetry_valid = 1;
   if (ctx->telemetry_cb)
     ctx->telemetry_cb(&ctx->telemetry_last, ctx->telemetry_user);
+  if (stream_due) {
+    unsigned int tail = ctx->telem_tail;
+    if (tail - SBX_LOAD_ACQUIRE(&ctx->telem_head) >= ctx->telem_cap) {
+      SBX_STORE_RELEASE(&ctx->telem_dropped, ctx->telem_dropped + 1U);
+    } else {
+      ctx->telem_ring[tail & (ctx->telem_cap - 1U)] = telem;
+      SBX_STORE_RELEASE(&ctx->telem_tail, tail + 1U);
+    }
+    /* Stay on the rate grid rather than drifting with block boundaries. */
+    ctx->telem_next_frame = ctx->frame_pos - ctx->frame_pos % ctx->telem_interval_frames +
+                            ctx->telem_interval_frames;
+  }
 }
 
 const char *
@@ -5441,6 +6565,7 @@ sbx_status_string(int status) {
     case SBX_EINVAL: return "invalid argument";
     case SBX_ENOMEM: return "out of memory";
     case SBX_ENOTREADY: return "engine not ready";
+    case SBX_EBUSY: return "queue full";
     default: return "unknown status";
   }
 }
@@ -7299,6 +8424,8 @@ sbx_default_curve_timeline_config(SbxCurveTimelineConfig *cfg) {
   cfg->step_len_sec = 180;
   cfg->slide = 1;
   cfg->fade_sec = 10.0;
+  cfg->adaptive_tolerance = 0.0;
+  cfg->adaptive_max_gap_sec = 300.0;
 }
 
 double
@@ -7853,42 +8980,217 @@ done:
   return SBX_OK;
 }
 
-typedef struct {
-  SbxMixAmpKeyframe *v;
-  size_t n;
-  size_t cap;
-} SbxCurveMixKfBuilder;
+static double
+sbx_bsrc_step_carrier(const SbxBuiltinSource *src, int a) {
+  return src->c0 + (src->c1 - src->c0) * ((a + 1) * src->step_sec) / src->main_sec;
+}
 
-static int
-sbx_curve_mixkfb_add(SbxCurveMixKfBuilder *b,
-                     double t_sec,
-                     double amp_pct,
-                     int interp) {
-  SbxMixAmpKeyframe *tmp;
-  size_t ncap;
-  if (!b) return SBX_EINVAL;
-  if (b->n == b->cap) {
-    ncap = b->cap ? b->cap * 2 : 32;
-    tmp = (SbxMixAmpKeyframe *)realloc(b->v, ncap * sizeof(*tmp));
-    if (!tmp) return SBX_ENOMEM;
-    b->v = tmp;
-    b->cap = ncap;
+static double
+sbx_bsrc_step_beat(const SbxBuiltinSource *src, int a) {
+  if (src->kind == SBX_BUILTIN_SRC_SIGMOID)
+    return sbx_builtin_sigmoid_beat(src->drop_sec, src->b1,
+                                    src->sig_l, src->sig_h, src->sig_a, src->sig_b,
+                                    (a >= src->n_step) ? (double)src->drop_sec
+                                                       : a * src->step_sec);
+  return sbx_builtin_drop_beat(src->b0, src->b1,
+                               (a >= src->n_step) ? (src->n_step - 1) : a,
+                               src->n_step);
+}
+
+/* Closed-form carrier/beat/amplitude of a native built-in source at t_sec. */
+static void
+sbx_bsrc_eval(const SbxBuiltinSource *src,
+              double t_sec,
+              double *out_carrier,
+              double *out_beat,
+              double *out_amp) {
+  double carrier, beat, amp = src->a0;
+  double end_sec = src->main_sec + src->wake_sec;
+
+  if (t_sec < 0.0) t_sec = 0.0;
+  if (t_sec < src->main_sec) {
+    if (src->kind == SBX_BUILTIN_SRC_SLIDE || src->slide) {
+      carrier = src->c0 + (src->c1 - src->c0) * t_sec / src->main_sec;
+      if (src->kind == SBX_BUILTIN_SRC_SLIDE || t_sec >= src->drop_sec)
+        beat = src->b1;
+      else if (src->kind == SBX_BUILTIN_SRC_DROP)
+        beat = src->b0 * exp(src->drop_k * t_sec / src->drop_sec);
+      else
+        beat = sbx_builtin_sigmoid_beat(src->drop_sec, src->b1,
+                                        src->sig_l, src->sig_h, src->sig_a, src->sig_b,
+                                        t_sec);
+    } else if (src->step_count == 0) {
+      carrier = src->c1;
+      beat = src->b1;
+    } else {
+      int a = (int)floor(t_sec / src->step_sec);
+      if (a > src->step_count - 1) a = src->step_count - 1;
+      carrier = sbx_bsrc_step_carrier(src, a);
+      beat = sbx_bsrc_step_beat(src, a);
+    }
+  } else if (t_sec < end_sec) {
+    double u = (t_sec - src->main_sec) / src->wake_sec;
+    carrier = sbx_lerp(src->c1, src->c0, u);
+    beat = sbx_lerp(src->b1, src->b0, u);
+  } else {
+    carrier = src->wake_sec > 0.0 ? src->c0 : src->c1;
+    beat = src->wake_sec > 0.0 ? src->b0 : src->b1;
+    if (src->fade_sec > 0.0)
+      amp = (t_sec < end_sec + src->fade_sec)
+                ? src->a0 * (1.0 - (t_sec - end_sec) / src->fade_sec)
+                : 0.0;
   }
-  b->v[b->n].time_sec = t_sec;
-  b->v[b->n].amp_pct = amp_pct;
-  b->v[b->n].interp = interp;
-  b->n++;
-  return SBX_OK;
+  *out_carrier = carrier;
+  *out_beat = beat;
+  *out_amp = amp;
 }
 
-static int
-sbx_curve_timeline_supported_mode(int mode) {
-  return mode == SBX_TONE_BINAURAL ||
-         mode == SBX_TONE_MONAURAL ||
-         mode == SBX_TONE_ISOCHRONIC;
+static double
+sbx_log_cosh(double x) {
+  x = fabs(x);
+  return x + log1p(exp(-2.0 * x)) - log(2.0);
 }
 
-static void
+/*
+ * Integrate carrier and beat frequency over [0, t_sec] in cycles. Continuous
+ * sections use their antiderivatives; stepped sections sum constant pieces.
+ */
+static void
+sbx_bsrc_integrate(const SbxBuiltinSource *src,
+                   double t_sec,
+                   double *out_carrier_cycles,
+                   double *out_beat_cycles) {
+  double cc = 0.0, bc = 0.0;
+  double tm = t_sec < src->main_sec ? t_sec : src->main_sec;
+
+  if (tm > 0.0) {
+    if (src->kind == SBX_BUILTIN_SRC_SLIDE || src->slide) {
+      cc += src->c0 * tm + (src->c1 - src->c0) * tm * tm / (2.0 * src->main_sec);
+      if (src->kind == SBX_BUILTIN_SRC_SLIDE) {
+        bc += src->b1 * tm;
+      } else {
+        double td = tm < src->drop_sec ? tm : (double)src->drop_sec;
+        if (src->kind == SBX_BUILTIN_SRC_DROP) {
+          if (fabs(src->drop_k) < 1e-12)
+            bc += src->b0 * td;
+          else
+            bc += src->b0 * src->drop_sec / src->drop_k * expm1(src->drop_k * td / src->drop_sec);
+        } else {
+          double ctr = src->drop_sec / 60.0 / 2.0 + src->sig_h;
+          bc += src->sig_a * 60.0 / src->sig_l *
+                    (sbx_log_cosh(src->sig_l * (td / 60.0 - ctr)) -
+                     sbx_log_cosh(src->sig_l * -ctr)) +
+                src->sig_b * td;
+        }
+        if (tm > td) bc += src->b1 * (tm - td);
+      }
+    } else if (src->step_count == 0) {
+      cc += src->c1 * tm;
+      bc += src->b1 * tm;
+    } else {
+      int a;
+      for (a = 0; a < src->step_count; a++) {
+        double s0 = a * src->step_sec;
+        double s1 = (a == src->step_count - 1) ? src->main_sec : (a + 1) * src->step_sec;
+        if (s0 >= tm) break;
+        if (s1 > tm) s1 = tm;
+        cc += sbx_bsrc_step_carrier(src, a) * (s1 - s0);
+        bc += sbx_bsrc_step_beat(src, a) * (s1 - s0);
+      }
+    }
+  }
+  if (t_sec > src->main_sec) {
+    double w = t_sec - src->main_sec;
+    if (src->wake_sec > 0.0) {
+      double tw = w < src->wake_sec ? w : src->wake_sec;
+      double u = tw / src->wake_sec;
+      cc += tw * (src->c1 + (src->c0 - src->c1) * u * 0.5);
+      bc += tw * (src->b1 + (src->b0 - src->b1) * u * 0.5);
+      cc += src->c0 * (w - tw);
+      bc += src->b0 * (w - tw);
+    } else {
+      cc += src->c1 * w;
+      bc += src->b1 * w;
+    }
+  }
+  *out_carrier_cycles = cc;
+  *out_beat_cycles = bc;
+}
+
+static void
+ctx_eval_builtin_tone(const SbxContext *ctx, double t_sec, SbxToneSpec *out) {
+  const SbxBuiltinSource *src = &ctx->builtin_src;
+  *out = src->tone;
+  sbx_bsrc_eval(src, t_sec, &out->carrier_hz, &out->beat_hz, &out->amplitude);
+}
+
+static double
+sbx_cycle_frac(double cycles) {
+  return cycles - floor(cycles);
+}
+
+/* Place engine oscillators where continuous playback from t=0 would be. */
+static void
+ctx_sync_builtin_phase(SbxContext *ctx, double t_sec) {
+  SbxEngine *eng = ctx->eng;
+  double cc, bc;
+
+  sbx_bsrc_integrate(&ctx->builtin_src, t_sec, &cc, &bc);
+  switch (ctx->builtin_src.tone.mode) {
+    case SBX_TONE_BINAURAL:
+      eng->phase_l = SBX_TAU * sbx_cycle_frac(cc + 0.5 * bc);
+      eng->phase_r = SBX_TAU * sbx_cycle_frac(cc - 0.5 * bc);
+      eng->pulse_phase = sbx_cycle_frac(fabs(bc));
+      break;
+    case SBX_TONE_MONAURAL:
+      eng->phase_l = SBX_TAU * sbx_cycle_frac(cc - 0.5 * bc);
+      eng->phase_r = SBX_TAU * sbx_cycle_frac(cc + 0.5 * bc);
+      break;
+    case SBX_TONE_ISOCHRONIC:
+      eng->phase_l = SBX_TAU * sbx_cycle_frac(cc);
+      eng->pulse_phase = sbx_cycle_frac(bc);
+      break;
+    default:
+      break;
+  }
+}
+
+typedef struct {
+  SbxMixAmpKeyframe *v;
+  size_t n;
+  size_t cap;
+} SbxCurveMixKfBuilder;
+
+static int
+sbx_curve_mixkfb_add(SbxCurveMixKfBuilder *b,
+                     double t_sec,
+                     double amp_pct,
+                     int interp) {
+  SbxMixAmpKeyframe *tmp;
+  size_t ncap;
+  if (!b) return SBX_EINVAL;
+  if (b->n == b->cap) {
+    ncap = b->cap ? b->cap * 2 : 32;
+    tmp = (SbxMixAmpKeyframe *)realloc(b->v, ncap * sizeof(*tmp));
+    if (!tmp) return SBX_ENOMEM;
+    b->v = tmp;
+    b->cap = ncap;
+  }
+  b->v[b->n].time_sec = t_sec;
+  b->v[b->n].amp_pct = amp_pct;
+  b->v[b->n].interp = interp;
+  b->n++;
+  return SBX_OK;
+}
+
+static int
+sbx_curve_timeline_supported_mode(int mode) {
+  return mode == SBX_TONE_BINAURAL ||
+         mode == SBX_TONE_MONAURAL ||
+         mode == SBX_TONE_ISOCHRONIC;
+}
+
+static void
 sbx_curve_timeline_fill_tone(SbxToneSpec *out,
                              const SbxToneSpec *base,
                              const SbxCurveEvalPoint *pt,
@@ -7902,6 +9204,113 @@ sbx_curve_timeline_fill_tone(SbxToneSpec *out,
   out->amplitude = mute_program_tone ? 0.0 : amplitude;
 }
 
+/*
+ * Adaptive slide sampling: each span between keyframes is probed at its
+ * quarter points and split at the middle while linear interpolation misses
+ * a probe by more than the tolerance (Hz for beat/carrier, percent for the
+ * amp and mix-amp lanes), down to SBX_TIMELINE_MIN_GAP_SEC.
+ */
+#define SBX_TIMELINE_MIN_GAP_SEC 1e-3
+#define SBX_TIMELINE_MAX_DEPTH 48
+
+typedef struct {
+  SbxCurveProgram *curve;
+  const SbxCurveTimelineConfig *cfg;
+  SbxBuiltinKfBuilder *kb;
+  SbxCurveMixKfBuilder *mb;
+  int have_amp_curve;
+  int have_mixamp_curve;
+  double max_error;
+} SbxCurveTimelineAdapt;
+
+static int
+sbx_curve_timeline_emit(SbxCurveTimelineAdapt *ad, double tim, const SbxCurveEvalPoint *pt) {
+  SbxToneSpec tone;
+  double amp = ad->cfg->start_tone.amplitude;
+  int rc;
+  if (ad->have_amp_curve) amp = pt->beat_amp_pct / 100.0;
+  sbx_curve_timeline_fill_tone(&tone, &ad->cfg->start_tone, pt, amp, ad->cfg->mute_program_tone);
+  rc = sbx_builtin_kfb_add(ad->kb, tim, &tone, SBX_INTERP_LINEAR);
+  if (rc == SBX_OK && ad->have_mixamp_curve)
+    rc = sbx_curve_mixkfb_add(ad->mb, tim, pt->mix_amp_pct, SBX_INTERP_LINEAR);
+  return rc;
+}
+
+/* Largest lane deviation of pt from the chord p0..p1 at fraction u. */
+static double
+sbx_curve_timeline_chord_error(const SbxCurveTimelineAdapt *ad,
+                               const SbxCurveEvalPoint *p0,
+                               const SbxCurveEvalPoint *p1,
+                               const SbxCurveEvalPoint *pt,
+                               double u) {
+  double err = fabs(pt->beat_hz - sbx_lerp(p0->beat_hz, p1->beat_hz, u));
+  double e = fabs(pt->carrier_hz - sbx_lerp(p0->carrier_hz, p1->carrier_hz, u));
+  if (e > err) err = e;
+  if (ad->have_amp_curve) {
+    e = fabs(pt->beat_amp_pct - sbx_lerp(p0->beat_amp_pct, p1->beat_amp_pct, u));
+    if (e > err) err = e;
+  }
+  if (ad->have_mixamp_curve) {
+    e = fabs(pt->mix_amp_pct - sbx_lerp(p0->mix_amp_pct, p1->mix_amp_pct, u));
+    if (e > err) err = e;
+  }
+  return err;
+}
+
+/* Emits keyframes for [t0, t1), splitting until the chord fits. */
+static int
+sbx_curve_timeline_refine(SbxCurveTimelineAdapt *ad,
+                          double t0, const SbxCurveEvalPoint *p0,
+                          double t1, const SbxCurveEvalPoint *p1,
+                          int depth) {
+  static const double probe_u[3] = { 0.25, 0.5, 0.75 };
+  SbxCurveEvalPoint probe[3];
+  double err = 0.0;
+  int i, rc;
+
+  for (i = 0; i < 3; i++) {
+    double e;
+    rc = sbx_curve_eval(ad->curve, sbx_lerp(t0, t1, probe_u[i]), &probe[i]);
+    if (rc != SBX_OK) return rc;
+    e = sbx_curve_timeline_chord_error(ad, p0, p1, &probe[i], probe_u[i]);
+    if (!(e <= err)) err = e;
+  }
+  if (!(err <= ad->cfg->adaptive_tolerance) &&
+      t1 - t0 > 2.0 * SBX_TIMELINE_MIN_GAP_SEC && depth < SBX_TIMELINE_MAX_DEPTH) {
+    double tm = 0.5 * (t0 + t1);
+    rc = sbx_curve_timeline_refine(ad, t0, p0, tm, &probe[1], depth + 1);
+    if (rc != SBX_OK) return rc;
+    return sbx_curve_timeline_refine(ad, tm, &probe[1], t1, p1, depth + 1);
+  }
+  if (err > ad->max_error) ad->max_error = err;
+  return sbx_curve_timeline_emit(ad, t0, p0);
+}
+
+/* Adaptive replacement for the fixed slide samples over [0, sample_span]. */
+static int
+sbx_curve_timeline_adaptive(SbxCurveTimelineAdapt *ad) {
+  double span = (double)ad->cfg->sample_span_sec;
+  double gap = ad->cfg->adaptive_max_gap_sec;
+  SbxCurveEvalPoint p0, p1;
+  double t0 = 0.0;
+  size_t n, i;
+  int rc;
+
+  n = (gap > 0.0 && gap < span) ? (size_t)ceil(span / gap) : 1;
+  rc = sbx_curve_eval(ad->curve, 0.0, &p0);
+  if (rc != SBX_OK) return rc;
+  for (i = 1; i <= n; i++) {
+    double t1 = i == n ? span : span * (double)i / (double)n;
+    rc = sbx_curve_eval(ad->curve, t1, &p1);
+    if (rc != SBX_OK) return rc;
+    rc = sbx_curve_timeline_refine(ad, t0, &p0, t1, &p1, 0);
+    if (rc != SBX_OK) return rc;
+    t0 = t1;
+    p0 = p1;
+  }
+  return sbx_curve_timeline_emit(ad, span, &p0);
+}
+
 int
 sbx_prepare_curve_file_program(const SbxCurveFileProgramConfig *cfg,
                                SbxCurveProgram **out_curve) {
@@ -7958,6 +9367,7 @@ sbx_build_curve_timeline(SbxCurveProgram *curve,
   int rc = SBX_OK;
   int n_step, a, lim, end_sec;
   int have_amp_curve, have_mixamp_curve;
+  double max_error = 0.0;
 
   if (!curve || !cfg || !out_timeline) return SBX_EINVAL;
   memset(out_timeline, 0, sizeof(*out_timeline));
@@ -7972,7 +9382,9 @@ sbx_build_curve_timeline(SbxCurveProgram *curve,
       cfg->main_span_sec < cfg->sample_span_sec ||
       cfg->wake_sec < 0 ||
       cfg->step_len_sec <= 0 ||
-      cfg->fade_sec < 0) {
+      cfg->fade_sec < 0 ||
+      !(cfg->adaptive_tolerance >= 0.0) || !isfinite(cfg->adaptive_tolerance) ||
+      !(cfg->adaptive_max_gap_sec >= 0.0) || !isfinite(cfg->adaptive_max_gap_sec)) {
     return SBX_EINVAL;
   }
 
@@ -7985,18 +9397,32 @@ sbx_build_curve_timeline(SbxCurveProgram *curve,
   if (n_step < 2) n_step = 2;
 
   if (cfg->slide) {
-    for (a = 0; a < n_step; a++) {
-      double tim = a * cfg->sample_span_sec / (double)(n_step - 1);
-      double amp = cfg->start_tone.amplitude;
-      rc = sbx_curve_eval(curve, tim, &pt);
-      if (rc != SBX_OK) goto done;
-      if (have_amp_curve) amp = pt.beat_amp_pct / 100.0;
-      sbx_curve_timeline_fill_tone(&tone, &cfg->start_tone, &pt, amp, cfg->mute_program_tone);
-      rc = sbx_builtin_kfb_add(&kb, tim, &tone, SBX_INTERP_LINEAR);
+    if (cfg->adaptive_tolerance > 0.0) {
+      SbxCurveTimelineAdapt ad;
+      memset(&ad, 0, sizeof(ad));
+      ad.curve = curve;
+      ad.cfg = cfg;
+      ad.kb = &kb;
+      ad.mb = &mb;
+      ad.have_amp_curve = have_amp_curve;
+      ad.have_mixamp_curve = have_mixamp_curve;
+      rc = sbx_curve_timeline_adaptive(&ad);
       if (rc != SBX_OK) goto done;
-      if (have_mixamp_curve) {
-        rc = sbx_curve_mixkfb_add(&mb, tim, pt.mix_amp_pct, SBX_INTERP_LINEAR);
+      max_error = ad.max_error;
+    } else {
+      for (a = 0; a < n_step; a++) {
+        double tim = a * cfg->sample_span_sec / (double)(n_step - 1);
+        double amp = cfg->start_tone.amplitude;
+        rc = sbx_curve_eval(curve, tim, &pt);
         if (rc != SBX_OK) goto done;
+        if (have_amp_curve) amp = pt.beat_amp_pct / 100.0;
+        sbx_curve_timeline_fill_tone(&tone, &cfg->start_tone, &pt, amp, cfg->mute_program_tone);
+        rc = sbx_builtin_kfb_add(&kb, tim, &tone, SBX_INTERP_LINEAR);
+        if (rc != SBX_OK) goto done;
+        if (have_mixamp_curve) {
+          rc = sbx_curve_mixkfb_add(&mb, tim, pt.mix_amp_pct, SBX_INTERP_LINEAR);
+          if (rc != SBX_OK) goto done;
+        }
       }
     }
     if (cfg->main_span_sec > cfg->sample_span_sec) {
@@ -8087,893 +9513,1944 @@ done:
   out_timeline->program_frame_count = kb.n;
   out_timeline->mix_frames = mb.v;
   out_timeline->mix_frame_count = mb.n;
+  out_timeline->max_error = max_error;
   return SBX_OK;
 }
 
-SbxEngine *
-sbx_engine_create(const SbxEngineConfig *cfg_in) {
-  SbxEngine *eng;
-  SbxEngineConfig cfg;
-
-  sbx_default_engine_config(&cfg);
-  if (cfg_in) cfg = *cfg_in;
-
-  if (cfg.sample_rate <= 0.0 || cfg.channels != 2)
-    return NULL;
-
-  eng = (SbxEngine *)calloc(1, sizeof(*eng));
-  if (!eng) return NULL;
-
-  eng->cfg = cfg;
-  sbx_default_tone_spec(&eng->tone);
-  eng->out_gain_l = 1.0;
-  eng->out_gain_r = 1.0;
-  eng->rng_state = 0x12345678u;
-  set_last_error(eng, NULL);
-  return eng;
+void
+sbx_default_curve_cache_config(SbxCurveCacheConfig *cfg) {
+  if (!cfg) return;
+  cfg->max_bytes = (size_t)32 * 1024 * 1024;
+  cfg->max_entries = 0;
 }
 
 void
-sbx_engine_destroy(SbxEngine *eng) {
-  if (!eng) return;
-  free(eng);
+sbx_default_curve_sweep_config(SbxCurveSweepConfig *cfg) {
+  if (!cfg) return;
+  memset(cfg, 0, sizeof(*cfg));
+  sbx_default_curve_eval_config(&cfg->eval_config);
+  cfg->t0_sec = 0.0;
+  cfg->t1_sec = 0.0;
+  cfg->sample_count = 61;
 }
 
-void
-sbx_engine_reset(SbxEngine *eng) {
-  if (!eng) return;
-  eng->out_gain_l = 1.0;
-  eng->out_gain_r = 1.0;
-  eng->phase_l = 0.0;
-  eng->phase_r = 0.0;
-  eng->pulse_phase = 0.0;
-  memset(eng->pink_l, 0, sizeof(eng->pink_l));
-  memset(eng->pink_r, 0, sizeof(eng->pink_r));
-  eng->brown_l = 0.0;
-  eng->brown_r = 0.0;
-  memset(eng->noise_hist_l, 0, sizeof(eng->noise_hist_l));
-  memset(eng->noise_hist_r, 0, sizeof(eng->noise_hist_r));
-  memset(eng->noise_hist_m, 0, sizeof(eng->noise_hist_m));
-  eng->noise_hist_pos_l = 0;
-  eng->noise_hist_pos_r = 0;
-  eng->noise_hist_pos_m = 0;
-  memset(eng->noisebeat_hist, 0, sizeof(eng->noisebeat_hist));
-  eng->noisebeat_hist_pos = 0;
-  memset(eng->orbit_delay, 0, sizeof(eng->orbit_delay));
-  eng->orbit_delay_pos = 0;
-  eng->orbit_lpf_l = 0.0;
-  eng->orbit_lpf_r = 0.0;
-  eng->bell_env = 0.0;
-  eng->bell_tick = 0;
-  eng->bell_tick_period = (int)(eng->cfg.sample_rate / 20.0);
-  if (eng->bell_tick_period < 1) eng->bell_tick_period = 1;
+typedef struct {
+  unsigned char *p;
+  size_t len, cap;
+  int oom;
+} SbxCacheKey;
+
+static void
+sbx_cache_key_put(SbxCacheKey *k, const void *data, size_t n) {
+  if (k->oom) return;
+  if (k->len + n > k->cap) {
+    size_t cap = k->cap ? k->cap : 256;
+    unsigned char *p;
+    while (cap < k->len + n) cap *= 2;
+    p = (unsigned char *)realloc(k->p, cap);
+    if (!p) {
+      k->oom = 1;
+      return;
+    }
+    k->p = p;
+    k->cap = cap;
+  }
+  memcpy(k->p + k->len, data, n);
+  k->len += n;
 }
 
-int
-sbx_engine_set_tone(SbxEngine *eng, const SbxToneSpec *tone_in) {
-  return engine_apply_tone(eng, tone_in, 1);
+static void
+sbx_cache_key_str(SbxCacheKey *k, const char *s) {
+  size_t n = s ? strlen(s) : 0;
+  sbx_cache_key_put(k, &n, sizeof(n));
+  if (n) sbx_cache_key_put(k, s, n);
 }
 
-int
-sbx_engine_render_f32(SbxEngine *eng, float *out, size_t frames) {
-  size_t i;
+#define SBX_CACHE_KEY_FIELD(k, v) sbx_cache_key_put((k), &(v), sizeof(v))
 
-  if (!eng || !out) return SBX_EINVAL;
-  if (eng->cfg.channels != 2 || eng->cfg.sample_rate <= 0.0) {
-    set_last_error(eng, "engine configuration is invalid");
-    return SBX_ENOTREADY;
-  }
+/* Fields are added one by one so struct padding never reaches the key. */
+static void
+sbx_cache_key_tone(SbxCacheKey *k, const SbxToneSpec *t) {
+  int mode = (int)t->mode;
+  SBX_CACHE_KEY_FIELD(k, mode);
+  SBX_CACHE_KEY_FIELD(k, t->carrier_hz);
+  SBX_CACHE_KEY_FIELD(k, t->beat_hz);
+  SBX_CACHE_KEY_FIELD(k, t->orbit_hz);
+  SBX_CACHE_KEY_FIELD(k, t->orbit_distance_m);
+  SBX_CACHE_KEY_FIELD(k, t->orbit_envelope_mode);
+  SBX_CACHE_KEY_FIELD(k, t->amplitude);
+  SBX_CACHE_KEY_FIELD(k, t->waveform);
+  SBX_CACHE_KEY_FIELD(k, t->envelope_waveform);
+  SBX_CACHE_KEY_FIELD(k, t->noise_waveform);
+  SBX_CACHE_KEY_FIELD(k, t->duty_cycle);
+  SBX_CACHE_KEY_FIELD(k, t->iso_start);
+  SBX_CACHE_KEY_FIELD(k, t->iso_attack);
+  SBX_CACHE_KEY_FIELD(k, t->iso_release);
+  SBX_CACHE_KEY_FIELD(k, t->iso_edge_mode);
+}
 
-  if (eng->tone.mode == SBX_TONE_NONE) {
-    memset(out, 0, frames * eng->cfg.channels * sizeof(float));
-    return SBX_OK;
+static void
+sbx_cache_key_build(SbxCacheKey *k,
+                    const char *text,
+                    const char *source_name,
+                    const SbxCurveParamOverride *overrides,
+                    size_t override_count,
+                    const SbxCurveEvalConfig *ec,
+                    const SbxCurveTimelineConfig *tc) {
+  size_t i;
+  int has_timeline = tc != 0;
+
+  sbx_cache_key_str(k, text);
+  sbx_cache_key_str(k, source_name);
+  SBX_CACHE_KEY_FIELD(k, override_count);
+  for (i = 0; i < override_count; i++) {
+    sbx_cache_key_str(k, overrides[i].name);
+    SBX_CACHE_KEY_FIELD(k, overrides[i].value);
+  }
+  SBX_CACHE_KEY_FIELD(k, ec->carrier_start_hz);
+  SBX_CACHE_KEY_FIELD(k, ec->carrier_end_hz);
+  SBX_CACHE_KEY_FIELD(k, ec->carrier_span_sec);
+  SBX_CACHE_KEY_FIELD(k, ec->beat_start_hz);
+  SBX_CACHE_KEY_FIELD(k, ec->beat_target_hz);
+  SBX_CACHE_KEY_FIELD(k, ec->beat_span_sec);
+  SBX_CACHE_KEY_FIELD(k, ec->hold_min);
+  SBX_CACHE_KEY_FIELD(k, ec->total_min);
+  SBX_CACHE_KEY_FIELD(k, ec->wake_min);
+  SBX_CACHE_KEY_FIELD(k, ec->beat_amp0_pct);
+  SBX_CACHE_KEY_FIELD(k, ec->mix_amp0_pct);
+  SBX_CACHE_KEY_FIELD(k, has_timeline);
+  if (tc) {
+    sbx_cache_key_tone(k, &tc->start_tone);
+    SBX_CACHE_KEY_FIELD(k, tc->sample_span_sec);
+    SBX_CACHE_KEY_FIELD(k, tc->main_span_sec);
+    SBX_CACHE_KEY_FIELD(k, tc->wake_sec);
+    SBX_CACHE_KEY_FIELD(k, tc->step_len_sec);
+    SBX_CACHE_KEY_FIELD(k, tc->slide);
+    SBX_CACHE_KEY_FIELD(k, tc->mute_program_tone);
+    SBX_CACHE_KEY_FIELD(k, tc->fade_sec);
+    SBX_CACHE_KEY_FIELD(k, tc->adaptive_tolerance);
+    SBX_CACHE_KEY_FIELD(k, tc->adaptive_max_gap_sec);
+  }
+}
+
+static uint64_t
+sbx_cache_hash(const unsigned char *p, size_t n) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
   }
+  return h;
+}
 
-  for (i = 0; i < frames; i++) {
-    float left = 0.0f, right = 0.0f;
-    engine_render_sample(eng, &left, &right);
-    out[i * 2] = left;
-    out[i * 2 + 1] = right;
-  }
+static void
+sbx_cache_entry_free(SbxCurveCacheEntry *e) {
+  if (!e) return;
+  sbx_curve_destroy(e->curve);
+  sbx_free_curve_timeline(&e->timeline);
+  free(e->key);
+  free(e);
+}
+
+/* Caller holds the lock. */
+static SbxCurveCacheEntry *
+sbx_cache_find(SbxCurveCache *cache, uint64_t hash, const unsigned char *key, size_t key_len) {
+  SbxCurveCacheEntry *e = cache->buckets[hash & (cache->bucket_count - 1)];
+  for (; e; e = e->hnext)
+    if (e->hash == hash && e->key_len == key_len && !memcmp(e->key, key, key_len))
+      return e;
+  return 0;
+}
 
-  return SBX_OK;
+static void
+sbx_cache_lru_unlink(SbxCurveCache *cache, SbxCurveCacheEntry *e) {
+  if (e->prev) e->prev->next = e->next;
+  else cache->head = e->next;
+  if (e->next) e->next->prev = e->prev;
+  else cache->tail = e->prev;
+  e->prev = e->next = 0;
 }
 
-const char *
-sbx_engine_last_error(const SbxEngine *eng) {
-  if (!eng) return "null engine";
-  if (!eng->last_error[0]) return "";
-  return eng->last_error;
+static void
+sbx_cache_lru_push(SbxCurveCache *cache, SbxCurveCacheEntry *e) {
+  e->prev = 0;
+  e->next = cache->head;
+  if (cache->head) cache->head->prev = e;
+  cache->head = e;
+  if (!cache->tail) cache->tail = e;
+}
+
+/* Removes e from the table; returns it if nobody holds it any more. */
+static SbxCurveCacheEntry *
+sbx_cache_detach(SbxCurveCache *cache, SbxCurveCacheEntry *e) {
+  SbxCurveCacheEntry **pp = &cache->buckets[e->hash & (cache->bucket_count - 1)];
+  while (*pp != e) pp = &(*pp)->hnext;
+  *pp = e->hnext;
+  e->hnext = 0;
+  sbx_cache_lru_unlink(cache, e);
+  e->cached = 0;
+  cache->entry_count--;
+  cache->bytes -= e->bytes;
+  return e->refs == 0 ? e : 0;
 }
 
-int
-sbx_convert_f32_to_s16(const float *in,
-                       short *out,
-                       size_t sample_count,
-                       SbxPcm16DitherState *dither_state) {
-  SbxPcmConvertState state;
-  SbxPcmConvertState *sp = 0;
-  if (dither_state) {
-    state.rng_state = dither_state->rng_state;
-    state.dither_mode = SBX_PCM_DITHER_TPDF;
-    sp = &state;
-  }
-  {
-    int rc = sbx_convert_f32_to_s16_ex(in, (int16_t *)out, sample_count, sp);
-    if (dither_state) dither_state->rng_state = state.rng_state;
-    return rc;
+static void
+sbx_cache_grow(SbxCurveCache *cache) {
+  size_t n = cache->bucket_count * 2, i;
+  SbxCurveCacheEntry **b = (SbxCurveCacheEntry **)calloc(n, sizeof(*b));
+  if (!b) return;
+  for (i = 0; i < cache->bucket_count; i++) {
+    SbxCurveCacheEntry *e = cache->buckets[i];
+    while (e) {
+      SbxCurveCacheEntry *next = e->hnext;
+      e->hnext = b[e->hash & (n - 1)];
+      b[e->hash & (n - 1)] = e;
+      e = next;
+    }
+  }
+  free(cache->buckets);
+  cache->buckets = b;
+  cache->bucket_count = n;
+}
+
+SbxCurveCache *
+sbx_curve_cache_create(const SbxCurveCacheConfig *cfg) {
+  SbxCurveCache *cache = (SbxCurveCache *)calloc(1, sizeof(*cache));
+  if (!cache) return NULL;
+  if (cfg) cache->cfg = *cfg;
+  else sbx_default_curve_cache_config(&cache->cfg);
+  cache->bucket_count = 16;
+  cache->buckets = (SbxCurveCacheEntry **)calloc(cache->bucket_count, sizeof(*cache->buckets));
+  if (!cache->buckets) {
+    free(cache);
+    return NULL;
   }
+  return cache;
 }
 
-int
-sbx_convert_f32_to_s16_ex(const float *in,
-                          int16_t *out,
-                          size_t sample_count,
-                          SbxPcmConvertState *state) {
-  size_t i;
-
-  if (!in || !out) return SBX_EINVAL;
-  for (i = 0; i < sample_count; i++) {
-    double pcm = (double)in[i] * 32767.0;
-    out[i] = (int16_t)sbx_pcm_quantize_sample_ll(pcm, -32768.0, 32767.0, state);
+void
+sbx_curve_cache_destroy(SbxCurveCache *cache) {
+  SbxCurveCacheEntry *e;
+  if (!cache) return;
+  e = cache->head;
+  while (e) {
+    SbxCurveCacheEntry *next = e->next;
+    sbx_cache_entry_free(e);
+    e = next;
   }
-  return SBX_OK;
+  free(cache->buckets);
+  free(cache);
 }
 
-int
-sbx_convert_f32_to_s24_32(const float *in,
-                          int32_t *out,
-                          size_t sample_count,
-                          SbxPcmConvertState *state) {
+static void
+sbx_cache_set_error(char *errbuf, size_t errbuf_sz, const char *msg) {
+  if (!errbuf || errbuf_sz == 0) return;
+  snprintf(errbuf, errbuf_sz, "%s", msg);
+}
+
+/* Load, override, prepare and optionally build the timeline for a miss. */
+static int
+sbx_cache_build_entry(SbxCurveCacheEntry *e,
+                      const char *text,
+                      const char *source_name,
+                      const SbxCurveParamOverride *overrides,
+                      size_t override_count,
+                      const SbxCurveEvalConfig *eval_config,
+                      const SbxCurveTimelineConfig *timeline_config,
+                      char *errbuf,
+                      size_t errbuf_sz) {
   size_t i;
+  int rc;
 
-  if (!in || !out) return SBX_EINVAL;
-  for (i = 0; i < sample_count; i++) {
-    double pcm = (double)in[i] * 8388607.0;
-    out[i] = (int32_t)sbx_pcm_quantize_sample_ll(pcm, -8388608.0, 8388607.0, state);
+  e->curve = sbx_curve_create();
+  if (!e->curve) return SBX_ENOMEM;
+  rc = sbx_curve_load_text(e->curve, text, source_name);
+  for (i = 0; rc == SBX_OK && i < override_count; i++) {
+    if (!overrides[i].name || !overrides[i].name[0]) {
+      sbx_cache_set_error(errbuf, errbuf_sz, "curve parameter override has no name");
+      return SBX_EINVAL;
+    }
+    rc = sbx_curve_set_param(e->curve, overrides[i].name, overrides[i].value);
+  }
+  if (rc == SBX_OK)
+    rc = sbx_curve_prepare(e->curve, eval_config);
+  if (rc != SBX_OK) {
+    sbx_cache_set_error(errbuf, errbuf_sz, sbx_curve_last_error(e->curve));
+    return rc;
+  }
+  if (timeline_config) {
+    rc = sbx_build_curve_timeline(e->curve, timeline_config, &e->timeline);
+    if (rc != SBX_OK) {
+      sbx_cache_set_error(errbuf, errbuf_sz, "curve timeline build failed");
+      return rc;
+    }
+    e->has_timeline = 1;
   }
+  e->bytes = sizeof(*e) + e->key_len + curve_memory_bytes(e->curve) +
+             e->timeline.program_frame_count * sizeof(SbxProgramKeyframe) +
+             e->timeline.mix_frame_count * sizeof(SbxMixAmpKeyframe);
   return SBX_OK;
 }
 
 int
-sbx_convert_f32_to_s32(const float *in,
-                       int32_t *out,
-                       size_t sample_count,
-                       SbxPcmConvertState *state) {
-  size_t i;
+sbx_curve_cache_acquire(SbxCurveCache *cache,
+                        const char *text,
+                        const char *source_name,
+                        const SbxCurveParamOverride *overrides,
+                        size_t override_count,
+                        const SbxCurveEvalConfig *eval_config,
+                        const SbxCurveTimelineConfig *timeline_config,
+                        SbxCurveCacheEntry **out_entry,
+                        char *errbuf,
+                        size_t errbuf_sz) {
+  SbxCacheKey key = {0};
+  SbxCurveCacheEntry *e, *found, *victims = 0;
+  uint64_t hash;
+  int rc;
 
-  if (!in || !out) return SBX_EINVAL;
-  for (i = 0; i < sample_count; i++) {
-    double pcm = (double)in[i] * 2147483647.0;
-    out[i] = (int32_t)sbx_pcm_quantize_sample_ll(pcm, -2147483648.0, 2147483647.0, state);
+  if (out_entry) *out_entry = 0;
+  if (errbuf && errbuf_sz) errbuf[0] = 0;
+  if (!cache || !text || !eval_config || !out_entry || (override_count && !overrides))
+    return SBX_EINVAL;
+
+  sbx_cache_key_build(&key, text, source_name, overrides, override_count,
+                      eval_config, timeline_config);
+  if (key.oom) {
+    free(key.p);
+    return SBX_ENOMEM;
+  }
+  hash = sbx_cache_hash(key.p, key.len);
+
+  sbx_spin_lock(&cache->lock);
+  found = sbx_cache_find(cache, hash, key.p, key.len);
+  if (found) {
+    found->refs++;
+    sbx_cache_lru_unlink(cache, found);
+    sbx_cache_lru_push(cache, found);
+    cache->hits++;
+  } else {
+    cache->misses++;
+  }
+  sbx_spin_unlock(&cache->lock);
+  if (found) {
+    free(key.p);
+    *out_entry = found;
+    return SBX_OK;
+  }
+
+  e = (SbxCurveCacheEntry *)calloc(1, sizeof(*e));
+  if (!e) {
+    free(key.p);
+    return SBX_ENOMEM;
+  }
+  e->hash = hash;
+  e->key = key.p;
+  e->key_len = key.len;
+  rc = sbx_cache_build_entry(e, text, source_name, overrides, override_count,
+                             eval_config, timeline_config, errbuf, errbuf_sz);
+  if (rc != SBX_OK) {
+    sbx_cache_entry_free(e);
+    return rc;
+  }
+
+  sbx_spin_lock(&cache->lock);
+  /* Another thread may have built the same entry meanwhile. */
+  found = sbx_cache_find(cache, hash, e->key, e->key_len);
+  if (found) {
+    found->refs++;
+    sbx_cache_lru_unlink(cache, found);
+    sbx_cache_lru_push(cache, found);
+  } else {
+    SbxCurveCacheEntry *v;
+    e->refs = 1;
+    e->cached = 1;
+    e->hnext = cache->buckets[hash & (cache->bucket_count - 1)];
+    cache->buckets[hash & (cache->bucket_count - 1)] = e;
+    sbx_cache_lru_push(cache, e);
+    cache->entry_count++;
+    cache->bytes += e->bytes;
+    if (cache->entry_count > cache->bucket_count) sbx_cache_grow(cache);
+    while (cache->tail &&
+           (cache->bytes > cache->cfg.max_bytes ||
+            (cache->cfg.max_entries && cache->entry_count > cache->cfg.max_entries))) {
+      v = sbx_cache_detach(cache, cache->tail);
+      cache->evictions++;
+      if (v) {
+        v->hnext = victims;
+        victims = v;
+      }
+    }
+  }
+  sbx_spin_unlock(&cache->lock);
+
+  if (found) {
+    sbx_cache_entry_free(e);
+    e = found;
+  }
+  while (victims) {
+    SbxCurveCacheEntry *next = victims->hnext;
+    sbx_cache_entry_free(victims);
+    victims = next;
   }
+  *out_entry = e;
   return SBX_OK;
 }
 
-static const char *
-sbx_audio_file_format_name(int format) {
-  switch (format) {
-    case SBX_AUDIO_FILE_RAW: return "raw";
-    case SBX_AUDIO_FILE_WAV: return "WAV";
-    case SBX_AUDIO_FILE_OGG: return "OGG/Vorbis";
-    case SBX_AUDIO_FILE_FLAC: return "FLAC";
-    case SBX_AUDIO_FILE_MP3: return "MP3";
-    default: return "unknown";
-  }
+void
+sbx_curve_cache_release(SbxCurveCache *cache, SbxCurveCacheEntry *entry) {
+  int drop;
+  if (!cache || !entry) return;
+  sbx_spin_lock(&cache->lock);
+  entry->refs--;
+  drop = entry->refs == 0 && !entry->cached;
+  sbx_spin_unlock(&cache->lock);
+  if (drop) sbx_cache_entry_free(entry);
 }
 
-static int
-sbx_audio_writer_init_sndfile(SbxAudioWriter *writer, const char *path, int format) {
-#ifndef STATIC_OUTPUT_ENCODERS
-  const char *names[] = {
-#if defined(T_MINGW) || defined(T_MSVC)
-    "libsndfile-1.dll",
-    "sndfile.dll",
-#elif defined(T_MACOSX)
-    "libsndfile.1.dylib",
-    "libsndfile.dylib",
-#else
-    "libsndfile.so.1",
-    "libsndfile.so",
-#endif
-    0
-  };
-#endif
-  SF_INFO info;
+const SbxCurveProgram *
+sbx_curve_cache_entry_curve(const SbxCurveCacheEntry *entry) {
+  return entry ? entry->curve : NULL;
+}
 
-#ifdef STATIC_OUTPUT_ENCODERS
-  writer->sf_open_fn = sf_open;
-  writer->sf_writef_short_fn = sf_writef_short;
-  writer->sf_writef_float_fn = sf_writef_float;
-  writer->sf_writef_int_fn = sf_writef_int;
-  writer->sf_close_fn = sf_close;
-  writer->sf_strerror_fn = sf_strerror;
-  writer->sf_command_fn = sf_command;
-#else
-  writer->lib = sbx_dlib_open_best(names);
-  if (!writer->lib) {
-    writer_set_error(writer,
-                     "%s output requested, but libsndfile runtime library is not available",
-                     sbx_audio_file_format_name(writer->cfg.format));
-    return SBX_ENOTREADY;
+const SbxCurveTimeline *
+sbx_curve_cache_entry_timeline(const SbxCurveCacheEntry *entry) {
+  return entry && entry->has_timeline ? &entry->timeline : NULL;
+}
+
+void
+sbx_curve_cache_clear(SbxCurveCache *cache) {
+  SbxCurveCacheEntry *victims = 0;
+  if (!cache) return;
+  sbx_spin_lock(&cache->lock);
+  while (cache->tail) {
+    SbxCurveCacheEntry *v = sbx_cache_detach(cache, cache->tail);
+    if (v) {
+      v->hnext = victims;
+      victims = v;
+    }
   }
-  writer->sf_open_fn =
-    (SNDFILE *(*)(const char*, int, SF_INFO*))sbx_dlib_sym(writer->lib, "sf_open");
-  writer->sf_writef_short_fn =
-    (sf_count_t(*)(SNDFILE*, const short*, sf_count_t))sbx_dlib_sym(writer->lib, "sf_writef_short");
-  writer->sf_writef_float_fn =
-    (sf_count_t(*)(SNDFILE*, const float*, sf_count_t))sbx_dlib_sym(writer->lib, "sf_writef_float");
-  writer->sf_writef_int_fn =
-    (sf_count_t(*)(SNDFILE*, const int*, sf_count_t))sbx_dlib_sym(writer->lib, "sf_writef_int");
-  writer->sf_close_fn =
-    (int(*)(SNDFILE*))sbx_dlib_sym(writer->lib, "sf_close");
-  writer->sf_strerror_fn =
-    (const char *(*)(SNDFILE*))sbx_dlib_sym(writer->lib, "sf_strerror");
-  writer->sf_command_fn =
-    (int(*)(SNDFILE*, int, void*, int))sbx_dlib_sym(writer->lib, "sf_command");
-  if (!writer->sf_open_fn || !writer->sf_writef_short_fn || !writer->sf_close_fn ||
-      !writer->sf_strerror_fn || !writer->sf_command_fn) {
-    writer_set_error(writer,
-                     "Failed to load required libsndfile symbols for %s output",
-                     sbx_audio_file_format_name(writer->cfg.format));
-    return SBX_ENOTREADY;
+  sbx_spin_unlock(&cache->lock);
+  while (victims) {
+    SbxCurveCacheEntry *next = victims->hnext;
+    sbx_cache_entry_free(victims);
+    victims = next;
   }
-#endif
+}
 
-  memset(&info, 0, sizeof(info));
-  info.channels = writer->cfg.channels;
-  info.samplerate = (int)(writer->cfg.sample_rate + 0.5);
-  info.format = format;
-  writer->snd = writer->sf_open_fn(path, SFM_WRITE, &info);
-  if (!writer->snd) {
-    writer_set_error(writer,
-                     "Failed to open output file for %s encoding: %s",
-                     sbx_audio_file_format_name(writer->cfg.format),
-                     writer->sf_strerror_fn ? writer->sf_strerror_fn(0) : "unknown error");
-    return SBX_ENOTREADY;
+void
+sbx_curve_cache_get_stats(SbxCurveCache *cache, SbxCurveCacheStats *out_stats) {
+  if (!out_stats) return;
+  memset(out_stats, 0, sizeof(*out_stats));
+  if (!cache) return;
+  sbx_spin_lock(&cache->lock);
+  out_stats->hits = cache->hits;
+  out_stats->misses = cache->misses;
+  out_stats->evictions = cache->evictions;
+  out_stats->entry_count = cache->entry_count;
+  out_stats->bytes = cache->bytes;
+  sbx_spin_unlock(&cache->lock);
+}
+
+static SbxCurveSweep *
+sbx_sweep_fail(SbxCurveSweep *sweep, char *errbuf, size_t errbuf_sz, const char *fmt, ...) {
+  va_list ap;
+  if (errbuf && errbuf_sz) {
+    va_start(ap, fmt);
+    vsnprintf(errbuf, errbuf_sz, fmt, ap);
+    va_end(ap);
   }
+  sbx_curve_sweep_destroy(sweep);
+  return NULL;
+}
 
-  if (writer->cfg.format == SBX_AUDIO_FILE_OGG && writer->cfg.ogg_quality_set) {
-    double q = writer->cfg.ogg_quality / 10.0;
-    if (writer->sf_command_fn(writer->snd,
-                              SFC_SET_VBR_ENCODING_QUALITY,
-                              &q,
-                              (int)sizeof(q)) <= 0) {
-      writer_set_error(writer,
-                       "Failed to set OGG Vorbis quality to %.2f (range 0..10)",
-                       writer->cfg.ogg_quality);
-      return SBX_EINVAL;
+/* Axis values of point index; the last axis varies fastest. */
+static void
+sbx_sweep_decode(const SbxCurveSweep *sweep, size_t index, double *out) {
+  size_t i = sweep->axis_count;
+  while (i-- > 0) {
+    out[i] = sweep->axis_values[i][index % sweep->axis_len[i]];
+    index /= sweep->axis_len[i];
+  }
+}
+
+static void
+sbx_sweep_point_config(const SbxCurveSweep *sweep, const double *v, SbxCurveEvalConfig *cfg) {
+  double d_min = sweep->cfg.eval_config.beat_span_sec / 60.0;
+  double h_min = sweep->cfg.eval_config.hold_min;
+  int spans = 0;
+  size_t i;
+
+  *cfg = sweep->cfg.eval_config;
+  for (i = 0; i < sweep->axis_count; i++) {
+    switch (sweep->axis_param[i]) {
+    case SBX_SWEEP_AXIS_D: d_min = v[i]; spans = 1; break;
+    case SBX_SWEEP_AXIS_H: h_min = v[i]; spans = 1; break;
+    case SBX_SWEEP_AXIS_U: cfg->wake_min = v[i]; break;
+    default: break;
     }
   }
-  if (writer->cfg.format == SBX_AUDIO_FILE_FLAC &&
-      writer->cfg.flac_compression_set) {
-    double c = writer->cfg.flac_compression / 12.0;
-    if (writer->sf_command_fn(writer->snd,
-                              SFC_SET_COMPRESSION_LEVEL,
-                              &c,
-                              (int)sizeof(c)) <= 0) {
-      writer_set_error(writer,
-                       "Failed to set FLAC compression level to %.2f (range 0..12)",
-                       writer->cfg.flac_compression);
-      return SBX_EINVAL;
+  if (spans) {
+    cfg->beat_span_sec = d_min * 60.0;
+    cfg->hold_min = h_min;
+    cfg->total_min = d_min + h_min;
+    cfg->carrier_span_sec = cfg->total_min * 60.0;
+  }
+}
+
+static void
+sbx_sweep_run_point(SbxCurveSweep *sweep, SbxCurveProgram *curve, size_t index) {
+  SbxCurveSweepPoint pt;
+  SbxCurveEvalConfig cfg;
+  double v[SBX_CURVE_SWEEP_MAX_AXES];
+  size_t n = sweep->cfg.sample_count;
+  double *out = sweep->beat + index * n;
+  size_t i;
+  int rc = SBX_OK;
+
+  sbx_sweep_decode(sweep, index, v);
+  sbx_sweep_point_config(sweep, v, &cfg);
+  for (i = 0; i < sweep->axis_count && rc == SBX_OK; i++) {
+    if (sweep->axis_param[i] >= 0)
+      rc = sbx_curve_set_param(curve, sweep->axis_names[i], v[i]);
+  }
+  /*
+   * Solve every point from the same guesses, so results do not depend on
+   * which worker ran the previous point. A solve that will not re-run
+   * keeps the unknowns it found for the same inputs.
+   */
+  if (rc == SBX_OK && curve->has_solve &&
+      (!curve->trees_ok || memcmp(&cfg, &curve->cfg, sizeof(cfg)) ||
+       (curve->param_dirty & curve->solve_deps) || curve->solve_dirty)) {
+    for (i = 0; i < (size_t)curve->solve_unknown_count; i++) {
+      if (sweep->solve_param[i] >= 0)
+        curve->param_values[sweep->solve_param[i]] = sweep->solve_guess[i];
     }
   }
 
-  return SBX_OK;
+  memset(&pt, 0, sizeof(pt));
+  pt.duration_sec = (cfg.total_min + (cfg.wake_min > 0.0 ? cfg.wake_min : 0.0)) * 60.0;
+  if (sweep->cfg.t1_sec > sweep->cfg.t0_sec) {
+    pt.t0_sec = sweep->cfg.t0_sec;
+    pt.t1_sec = sweep->cfg.t1_sec;
+  } else {
+    pt.t0_sec = 0.0;
+    pt.t1_sec = pt.duration_sec;
+  }
+  if (rc == SBX_OK)
+    rc = sbx_curve_prepare(curve, &cfg);
+  if (rc == SBX_OK)
+    rc = sbx_curve_sample_program_beat(curve, pt.t0_sec, pt.t1_sec, n, NULL, out);
+  if (rc != SBX_OK) {
+    for (i = 0; i < n; i++) out[i] = NAN;
+    sbx_spin_lock(&sweep->lock);
+    if (index < sweep->error_index) {
+      sweep->error_index = index;
+      snprintf(sweep->first_error, sizeof(sweep->first_error), "point %lu: %s",
+               (unsigned long)index, sbx_curve_last_error(curve));
+    }
+    sbx_spin_unlock(&sweep->lock);
+  }
+  pt.status = rc;
+  sweep->points[index] = pt;
 }
 
-static int
-sbx_audio_writer_ensure_mp3_buf(SbxAudioWriter *writer, int frames) {
-  int need;
-  unsigned char *buf;
+SbxCurveSweep *
+sbx_curve_sweep_create(const SbxCurveProgram *curve,
+                       const SbxCurveSweepAxis *axes,
+                       size_t axis_count,
+                       const SbxCurveSweepConfig *cfg,
+                       char *errbuf,
+                       size_t errbuf_sz) {
+  SbxCurveSweep *sweep;
+  size_t total = 1, i, j;
 
-  if (!writer || frames < 0) return SBX_EINVAL;
-  need = 7200 + (int)(1.25 * frames + 0.5);
-  if (need <= writer->mp3_buflen) return SBX_OK;
+  if (errbuf && errbuf_sz) errbuf[0] = 0;
+  if (!curve || !curve->loaded || !cfg || (axis_count && !axes))
+    return sbx_sweep_fail(NULL, errbuf, errbuf_sz, "invalid sweep arguments");
+  if (axis_count > SBX_CURVE_SWEEP_MAX_AXES)
+    return sbx_sweep_fail(NULL, errbuf, errbuf_sz, "too many sweep axes (max %d)",
+                          SBX_CURVE_SWEEP_MAX_AXES);
+  if (cfg->sample_count == 0 || !isfinite(cfg->t0_sec) || !isfinite(cfg->t1_sec))
+    return sbx_sweep_fail(NULL, errbuf, errbuf_sz, "invalid sweep sampling range");
+
+  sweep = (SbxCurveSweep *)calloc(1, sizeof(*sweep));
+  if (!sweep) return sbx_sweep_fail(NULL, errbuf, errbuf_sz, "out of memory");
+  sweep->cfg = *cfg;
+  sweep->error_index = (size_t)-1;
+
+  for (i = 0; i < axis_count; i++) {
+    const SbxCurveSweepAxis *ax = &axes[i];
+    size_t nlen;
+    int idx;
+
+    if (!ax->name || !ax->name[0] || !ax->values || ax->value_count == 0)
+      return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "sweep axis %lu has no name or values",
+                            (unsigned long)i);
+    nlen = strlen(ax->name);
+    if (nlen >= SBX_CURVE_NAME_MAX)
+      return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "sweep axis name '%s' is too long", ax->name);
+    for (j = 0; j < i; j++) {
+      if (curve_name_eq(ax->name, sweep->axis_names[j]))
+        return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "sweep axis '%s' given twice", ax->name);
+    }
+    if (!strcmp(ax->name, "D")) idx = SBX_SWEEP_AXIS_D;
+    else if (!strcmp(ax->name, "H")) idx = SBX_SWEEP_AXIS_H;
+    else if (!strcmp(ax->name, "U")) idx = SBX_SWEEP_AXIS_U;
+    else {
+      idx = curve_param_index(curve, ax->name);
+      if (idx < 0)
+        return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "Unknown .sbgf parameter in sweep: %s",
+                              ax->name);
+      for (j = 0; j < (size_t)curve->solve_unknown_count; j++) {
+        if (curve_name_eq(ax->name, curve->solve_unknown_names[j]))
+          return sbx_sweep_fail(sweep, errbuf, errbuf_sz,
+                                "'%s' is solved by the curve and cannot be swept", ax->name);
+      }
+    }
+    for (j = 0; j < ax->value_count; j++) {
+      double x = ax->values[j];
+      if (!isfinite(x) ||
+          (idx == SBX_SWEEP_AXIS_D && !(x > 0.0)) ||
+          ((idx == SBX_SWEEP_AXIS_H || idx == SBX_SWEEP_AXIS_U) && x < 0.0))
+        return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "invalid sweep value %g for '%s'",
+                              x, ax->name);
+    }
+    if (total > (size_t)-1 / ax->value_count)
+      return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "sweep grid is too large");
+    total *= ax->value_count;
+    memcpy(sweep->axis_names[i], ax->name, nlen + 1);
+    sweep->axis_param[i] = idx;
+    sweep->axis_len[i] = ax->value_count;
+    sweep->axis_values[i] = (double *)malloc(ax->value_count * sizeof(double));
+    if (!sweep->axis_values[i])
+      return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "out of memory");
+    memcpy(sweep->axis_values[i], ax->values, ax->value_count * sizeof(double));
+    sweep->axis_count = i + 1;
+  }
+  if (total > (size_t)-1 / sizeof(double) / cfg->sample_count)
+    return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "sweep grid is too large");
+  sweep->point_count = total;
+
+  sweep->points = (SbxCurveSweepPoint *)malloc(total * sizeof(*sweep->points));
+  sweep->beat = (double *)malloc(total * cfg->sample_count * sizeof(double));
+  sweep->src = sbx_curve_create();
+  if (!sweep->points || !sweep->beat || !sweep->src ||
+      curve_clone_loaded(sweep->src, curve) != SBX_OK)
+    return sbx_sweep_fail(sweep, errbuf, errbuf_sz, "out of memory");
+  for (i = 0; i < total; i++) {
+    memset(&sweep->points[i], 0, sizeof(sweep->points[i]));
+    sweep->points[i].status = -1;
+  }
+  for (i = 0; i < (size_t)curve->solve_unknown_count; i++) {
+    int idx = curve_param_index(curve, curve->solve_unknown_names[i]);
+    sweep->solve_param[i] = idx;
+    sweep->solve_guess[i] = idx >= 0 ? curve->param_values[idx] : 0.0;
+  }
+  return sweep;
+}
 
-  buf = writer->mp3_buf
-    ? (unsigned char *)realloc(writer->mp3_buf, (size_t)need)
-    : (unsigned char *)malloc((size_t)need);
-  if (!buf) {
-    writer_set_error(writer, "Out of memory allocating MP3 buffer");
+void
+sbx_curve_sweep_destroy(SbxCurveSweep *sweep) {
+  size_t i;
+  if (!sweep) return;
+  for (i = 0; i < sweep->axis_count; i++)
+    free(sweep->axis_values[i]);
+  free(sweep->points);
+  free(sweep->beat);
+  sbx_curve_destroy(sweep->src);
+  free(sweep);
+}
+
+size_t
+sbx_curve_sweep_point_count(const SbxCurveSweep *sweep) {
+  return sweep ? sweep->point_count : 0;
+}
+
+int
+sbx_curve_sweep_work(SbxCurveSweep *sweep) {
+  SbxCurveProgram *curve;
+  size_t index;
+
+  if (!sweep) return SBX_EINVAL;
+  curve = sbx_curve_create();
+  if (!curve) return SBX_ENOMEM;
+  if (curve_clone_loaded(curve, sweep->src) != SBX_OK) {
+    sbx_curve_destroy(curve);
     return SBX_ENOMEM;
   }
-  writer->mp3_buf = buf;
-  writer->mp3_buflen = need;
+  for (;;) {
+    sbx_spin_lock(&sweep->lock);
+    index = sweep->next;
+    if (index < sweep->point_count) sweep->next++;
+    sbx_spin_unlock(&sweep->lock);
+    if (index >= sweep->point_count) break;
+    sbx_sweep_run_point(sweep, curve, index);
+  }
+  sbx_curve_destroy(curve);
+  return SBX_OK;
+}
+
+int
+sbx_curve_sweep_get_point(const SbxCurveSweep *sweep,
+                          size_t index,
+                          double *out_axis_values,
+                          SbxCurveSweepPoint *out_point,
+                          const double **out_beat_hz) {
+  if (!sweep || index >= sweep->point_count) return SBX_EINVAL;
+  if (out_axis_values) sbx_sweep_decode(sweep, index, out_axis_values);
+  if (out_point) *out_point = sweep->points[index];
+  if (out_beat_hz) *out_beat_hz = sweep->beat + index * sweep->cfg.sample_count;
   return SBX_OK;
 }
 
+const char *
+sbx_curve_sweep_first_error(const SbxCurveSweep *sweep) {
+  return sweep ? sweep->first_error : "";
+}
+
 static int
-sbx_audio_writer_init_mp3(SbxAudioWriter *writer, const char *path) {
-#ifndef STATIC_OUTPUT_ENCODERS
-  const char *names[] = {
-#if defined(T_MINGW) || defined(T_MSVC)
-    "libmp3lame-0.dll",
-    "libmp3lame.dll",
-#elif defined(T_MACOSX)
-    "libmp3lame.0.dylib",
-    "libmp3lame.dylib",
-#else
-    "libmp3lame.so.0",
-    "libmp3lame.so",
-#endif
-    0
-  };
-#endif
-  int bitrate = writer->cfg.mp3_bitrate_set ? writer->cfg.mp3_bitrate : 192;
-  int quality = writer->cfg.mp3_quality_set ? writer->cfg.mp3_quality : 2;
-  double vbr_quality = writer->cfg.mp3_vbr_quality_set ? writer->cfg.mp3_vbr_quality : 0.0;
+sbx_sweep_write_csv(const SbxCurveSweep *sweep, FILE *fp) {
+  double v[SBX_CURVE_SWEEP_MAX_AXES];
+  size_t n = sweep->cfg.sample_count;
+  size_t p, i;
+
+  fprintf(fp, "point");
+  for (i = 0; i < sweep->axis_count; i++)
+    fprintf(fp, ",%s", sweep->axis_names[i]);
+  fprintf(fp, ",status,duration_sec,t0_sec,t1_sec");
+  for (i = 0; i < n; i++)
+    fprintf(fp, ",beat_%lu", (unsigned long)i);
+  fputc('\n', fp);
+  for (p = 0; p < sweep->point_count; p++) {
+    const SbxCurveSweepPoint *pt = &sweep->points[p];
+    const double *beat = sweep->beat + p * n;
+    sbx_sweep_decode(sweep, p, v);
+    fprintf(fp, "%lu", (unsigned long)p);
+    for (i = 0; i < sweep->axis_count; i++)
+      fprintf(fp, ",%.12g", v[i]);
+    fprintf(fp, ",%d,%.12g,%.12g,%.12g", pt->status, pt->duration_sec, pt->t0_sec, pt->t1_sec);
+    for (i = 0; i < n; i++) {
+      if (pt->status == SBX_OK) fprintf(fp, ",%.12g", beat[i]);
+      else fputc(',', fp);
+    }
+    fputc('\n', fp);
+  }
+  return SBX_OK;
+}
 
-#ifdef STATIC_OUTPUT_ENCODERS
-  writer->lame_init_fn = lame_init;
-  writer->lame_set_in_samplerate_fn = lame_set_in_samplerate;
-  writer->lame_set_num_channels_fn = lame_set_num_channels;
-  writer->lame_set_quality_fn = lame_set_quality;
-  writer->lame_set_VBR_fn = lame_set_VBR;
-  writer->lame_set_VBR_q_fn = lame_set_VBR_q;
-  writer->lame_set_VBR_quality_fn = lame_set_VBR_quality;
-  writer->lame_set_brate_fn = lame_set_brate;
-  writer->lame_init_params_fn = lame_init_params;
-  writer->lame_encode_buffer_interleaved_fn = lame_encode_buffer_interleaved;
-  writer->lame_encode_buffer_interleaved_ieee_float_fn = lame_encode_buffer_interleaved_ieee_float;
-  writer->lame_encode_flush_fn = lame_encode_flush;
-  writer->lame_close_fn = lame_close;
-#else
-  writer->lib = sbx_dlib_open_best(names);
-  if (!writer->lib) {
-    writer_set_error(writer,
-                     "MP3 output requested, but libmp3lame runtime library is not available");
+/*
+ * Binary layout, native byte order: "SBXSWEEP", u32 version (1), u32
+ * 0x01020304 byte-order mark, u32 axis_count, u32 sample_count, u64
+ * point_count, the NUL-terminated axis names, then per point i32 status,
+ * u32 zero, then doubles: axis values, duration, t0, t1, beat samples.
+ */
+static int
+sbx_sweep_write_binary(const SbxCurveSweep *sweep, FILE *fp) {
+  double v[SBX_CURVE_SWEEP_MAX_AXES + 3];
+  size_t n = sweep->cfg.sample_count;
+  uint32_t hdr[4];
+  uint64_t count = (uint64_t)sweep->point_count;
+  size_t p, i;
+
+  hdr[0] = 1;
+  hdr[1] = 0x01020304u;
+  hdr[2] = (uint32_t)sweep->axis_count;
+  hdr[3] = (uint32_t)n;
+  if (fwrite("SBXSWEEP", 1, 8, fp) != 8 ||
+      fwrite(hdr, sizeof(hdr), 1, fp) != 1 ||
+      fwrite(&count, sizeof(count), 1, fp) != 1)
     return SBX_ENOTREADY;
+  for (i = 0; i < sweep->axis_count; i++) {
+    size_t len = strlen(sweep->axis_names[i]) + 1;
+    if (fwrite(sweep->axis_names[i], 1, len, fp) != len) return SBX_ENOTREADY;
+  }
+  for (p = 0; p < sweep->point_count; p++) {
+    const SbxCurveSweepPoint *pt = &sweep->points[p];
+    int32_t st[2];
+    st[0] = (int32_t)pt->status;
+    st[1] = 0;
+    sbx_sweep_decode(sweep, p, v);
+    v[sweep->axis_count] = pt->duration_sec;
+    v[sweep->axis_count + 1] = pt->t0_sec;
+    v[sweep->axis_count + 2] = pt->t1_sec;
+    if (fwrite(st, sizeof(st), 1, fp) != 1 ||
+        fwrite(v, sizeof(double), sweep->axis_count + 3, fp) != sweep->axis_count + 3 ||
+        fwrite(sweep->beat + p * n, sizeof(double), n, fp) != n)
+      return SBX_ENOTREADY;
   }
-  writer->lame_init_fn = (lame_t(*)(void))sbx_dlib_sym(writer->lib, "lame_init");
-  writer->lame_set_in_samplerate_fn =
-    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_in_samplerate");
-  writer->lame_set_num_channels_fn =
-    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_num_channels");
-  writer->lame_set_quality_fn =
-    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_quality");
-  writer->lame_set_VBR_fn =
-    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_VBR");
-  writer->lame_set_VBR_q_fn =
-    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_VBR_q");
-  writer->lame_set_VBR_quality_fn =
-    (int(*)(lame_t, float))sbx_dlib_sym(writer->lib, "lame_set_VBR_quality");
-  writer->lame_set_brate_fn =
-    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_brate");
-  writer->lame_init_params_fn =
-    (int(*)(lame_t))sbx_dlib_sym(writer->lib, "lame_init_params");
-  writer->lame_encode_buffer_interleaved_fn =
-    (int(*)(lame_t, short int*, int, unsigned char*, int))
-      sbx_dlib_sym(writer->lib, "lame_encode_buffer_interleaved");
-  writer->lame_encode_buffer_interleaved_ieee_float_fn =
-    (int(*)(lame_t, float*, int, unsigned char*, int))
-      sbx_dlib_sym(writer->lib, "lame_encode_buffer_interleaved_ieee_float");
-  writer->lame_encode_flush_fn =
-    (int(*)(lame_t, unsigned char*, int))sbx_dlib_sym(writer->lib, "lame_encode_flush");
-  writer->lame_close_fn =
-    (int(*)(lame_t))sbx_dlib_sym(writer->lib, "lame_close");
-#endif
+  return SBX_OK;
+}
 
-  if (!writer->lame_init_fn ||
-      !writer->lame_set_in_samplerate_fn ||
-      !writer->lame_set_num_channels_fn ||
-      !writer->lame_set_quality_fn ||
-      !(writer->cfg.mp3_vbr_quality_set
-          ? (writer->lame_set_VBR_fn &&
-             (writer->lame_set_VBR_quality_fn || writer->lame_set_VBR_q_fn))
-          : (writer->lame_set_brate_fn != 0)) ||
-      !writer->lame_init_params_fn ||
-      !writer->lame_encode_buffer_interleaved_fn ||
-      !writer->lame_encode_flush_fn ||
-      !writer->lame_close_fn) {
-    writer_set_error(writer, "Failed to load required libmp3lame symbols");
-    return SBX_ENOTREADY;
-  }
+int
+sbx_curve_sweep_write(const SbxCurveSweep *sweep, FILE *fp, int format) {
+  int rc;
+  if (!sweep || !fp || sweep->cfg.sample_count > 0xffffffffu) return SBX_EINVAL;
+  if (format == SBX_CURVE_SWEEP_CSV) rc = sbx_sweep_write_csv(sweep, fp);
+  else if (format == SBX_CURVE_SWEEP_BINARY) rc = sbx_sweep_write_binary(sweep, fp);
+  else return SBX_EINVAL;
+  if (rc == SBX_OK && ferror(fp)) rc = SBX_ENOTREADY;
+  return rc;
+}
 
-  writer->fp = fopen(path, "wb");
-  if (!writer->fp) {
-    writer_set_error(writer, "Failed to open \"%s\" for writing: errno %d", path, errno);
-    return SBX_ENOTREADY;
-  }
+static double
+sbx_monotonic_sec(void) {
+#if defined(_WIN32) || defined(T_MINGW) || defined(T_MSVC)
+  LARGE_INTEGER f, c;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&c);
+  return (double)c.QuadPart / (double)f.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
 
-  writer->mp3_gfp = writer->lame_init_fn();
-  if (!writer->mp3_gfp) {
-    writer_set_error(writer, "lame_init() failed");
-    return SBX_ENOTREADY;
-  }
+static int
+sbx_vbatch_wrapper_line(const char *line, void *user) {
+  (void)line;
+  (void)user;
+  return SBX_OK;
+}
 
-  if (writer->lame_set_num_channels_fn(writer->mp3_gfp, writer->cfg.channels) < 0 ||
-      writer->lame_set_in_samplerate_fn(writer->mp3_gfp, (int)(writer->cfg.sample_rate + 0.5)) < 0 ||
-      writer->lame_set_quality_fn(writer->mp3_gfp, quality) < 0) {
-    writer_set_error(writer, "Failed to configure MP3 encoder");
-    return SBX_EINVAL;
-  }
+static void
+sbx_vbatch_run_file(SbxValidateBatch *batch, size_t index) {
+  SbxValidateBatchResult *res = &batch->results[index];
+  const char *path = batch->paths[index];
+  SbxDiagnostic *diags = 0;
+  size_t count = 0, i;
+  SbxTextFile tf;
+  double t0 = sbx_monotonic_sec(), t1;
+  int rc;
 
-  if (writer->cfg.mp3_vbr_quality_set) {
-    int q_i;
-    if (writer->lame_set_VBR_fn(writer->mp3_gfp, 4) < 0) {
-      writer_set_error(writer, "Failed to configure MP3 VBR mode");
-      return SBX_EINVAL;
-    }
-    if (writer->lame_set_VBR_quality_fn) {
-      if (writer->lame_set_VBR_quality_fn(writer->mp3_gfp, (float)vbr_quality) < 0) {
-        writer_set_error(writer,
-                         "Failed to configure MP3 VBR quality %.2f (range 0..9)",
-                         vbr_quality);
-        return SBX_EINVAL;
-      }
-    } else {
-      q_i = (int)(vbr_quality + 0.5);
-      if (q_i < 0) q_i = 0;
-      if (q_i > 9) q_i = 9;
-      if (writer->lame_set_VBR_q_fn(writer->mp3_gfp, q_i) < 0) {
-        writer_set_error(writer,
-                         "Failed to configure MP3 VBR quality %d (range 0..9)",
-                         q_i);
-        return SBX_EINVAL;
-      }
-    }
+  rc = sbx_text_file_open(path, &tf);
+  if (rc != SBX_OK) {
+    char msg[SBX_DIAG_MESSAGE_MAX];
+    snprintf(msg, sizeof(msg), "unable to read file: %s", path);
+    rc = sbx_diag_alloc_one(&diags, &count, SBX_DIAG_ERROR, "file-read", msg);
   } else {
-    if (writer->lame_set_brate_fn(writer->mp3_gfp, bitrate) < 0) {
-      writer_set_error(writer, "Failed to configure MP3 bitrate %d kbps", bitrate);
-      return SBX_EINVAL;
-    }
-  }
-
-  if (writer->lame_init_params_fn(writer->mp3_gfp) < 0) {
-    writer_set_error(writer, "Failed to initialize MP3 encoder parameters");
-    return SBX_EINVAL;
+    res->byte_count = tf.len;
+    if (curve_has_sbgf_ext(path))
+      rc = sbx_validate_sbgf_text(tf.text, path, &diags, &count);
+    else if (sbx_run_option_only_seq_wrapper_text(tf.text, sbx_vbatch_wrapper_line,
+                                                  0, 0, 0) == SBX_OK)
+      rc = sbx_diag_alloc_one(&diags, &count, SBX_DIAG_WARNING, "sbg-wrapper",
+                              "option-only wrapper: its -p/-i program is not validated");
+    else
+      rc = sbx_validate_sbg_text(tf.text, path, &diags, &count);
+    sbx_text_file_close(&tf);
+  }
+  t1 = sbx_monotonic_sec();
+
+  res->status = rc;
+  res->diags = diags;
+  res->diag_count = count;
+  res->elapsed_sec = t1 - t0;
+  for (i = 0; i < count; i++) {
+    if (diags[i].severity == SBX_DIAG_ERROR) res->error_count++;
+    else res->warning_count++;
   }
-
-  writer->input_mode =
-    (writer->cfg.prefer_float_input && writer->lame_encode_buffer_interleaved_ieee_float_fn)
-      ? SBX_AUDIO_WRITER_INPUT_F32
-      : SBX_AUDIO_WRITER_INPUT_S16;
-  return SBX_OK;
+  sbx_spin_lock(&batch->lock);
+  if (batch->t_first < 0.0 || t0 < batch->t_first) batch->t_first = t0;
+  if (t1 > batch->t_last) batch->t_last = t1;
+  sbx_spin_unlock(&batch->lock);
 }
 
-SbxAudioWriter *
-sbx_audio_writer_create_path(const char *path, const SbxAudioWriterConfig *cfg_in) {
-  SbxAudioWriter *writer;
-  SbxAudioWriterConfig cfg;
-  int rc = SBX_OK;
+SbxValidateBatch *
+sbx_validate_batch_create(const char *const *paths,
+                          size_t path_count,
+                          char *errbuf,
+                          size_t errbuf_sz) {
+  SbxValidateBatch *batch;
+  size_t i;
 
-  if (!path || !path[0]) return NULL;
-  sbx_default_audio_writer_config(&cfg);
-  if (cfg_in) cfg = *cfg_in;
-  if (cfg.sample_rate <= 0.0 || cfg.channels != 2)
-    return NULL;
-  if (cfg.format < SBX_AUDIO_FILE_RAW || cfg.format > SBX_AUDIO_FILE_MP3)
+  if (errbuf && errbuf_sz) errbuf[0] = 0;
+  if (path_count && !paths) {
+    sbx_set_api_error(errbuf, errbuf_sz, "invalid validation batch arguments");
     return NULL;
-  if (cfg.pcm_bits != 8 && cfg.pcm_bits != 16 && cfg.pcm_bits != 24)
+  }
+  batch = (SbxValidateBatch *)calloc(1, sizeof(*batch));
+  if (!batch) {
+    sbx_set_api_error(errbuf, errbuf_sz, "out of memory");
     return NULL;
-  if ((cfg.format == SBX_AUDIO_FILE_OGG || cfg.format == SBX_AUDIO_FILE_FLAC) &&
-      cfg.pcm_bits != 16 && cfg.pcm_bits != 24)
+  }
+  batch->t_first = -1.0;
+  batch->paths = (char **)calloc(path_count ? path_count : 1, sizeof(char *));
+  batch->results = (SbxValidateBatchResult *)calloc(path_count ? path_count : 1,
+                                                    sizeof(SbxValidateBatchResult));
+  if (!batch->paths || !batch->results) {
+    sbx_validate_batch_destroy(batch);
+    sbx_set_api_error(errbuf, errbuf_sz, "out of memory");
     return NULL;
-  if (cfg.format == SBX_AUDIO_FILE_OGG && cfg.pcm_bits != 16)
-    cfg.pcm_bits = 16;
-  if (cfg.format == SBX_AUDIO_FILE_MP3)
-    cfg.pcm_bits = 16;
-
-  writer = (SbxAudioWriter *)calloc(1, sizeof(*writer));
-  if (!writer) return NULL;
-  writer->cfg = cfg;
-  writer->input_mode = SBX_AUDIO_WRITER_INPUT_BYTES;
-
-  if (cfg.format == SBX_AUDIO_FILE_RAW || cfg.format == SBX_AUDIO_FILE_WAV) {
-    writer->fp = fopen(path, "wb");
-    if (!writer->fp) {
-      writer_set_error(writer, "Failed to open \"%s\" for writing: errno %d", path, errno);
-      sbx_audio_writer_destroy(writer);
+  }
+  for (i = 0; i < path_count; i++) {
+    if (!paths[i]) {
+      sbx_validate_batch_destroy(batch);
+      sbx_set_api_error(errbuf, errbuf_sz, "validation batch path %lu is NULL",
+                        (unsigned long)i);
       return NULL;
     }
-    if (cfg.format == SBX_AUDIO_FILE_WAV) {
-      rc = sbx_audio_writer_write_wav_header(writer->fp,
-                                             (uint32_t)(cfg.sample_rate + 0.5),
-                                             cfg.channels,
-                                             cfg.pcm_bits,
-                                             0u);
-      if (rc != SBX_OK) {
-        writer_set_error(writer, "Failed to write initial WAV header");
-        sbx_audio_writer_destroy(writer);
-        return NULL;
-      }
+    batch->paths[i] = strdup(paths[i]);
+    if (!batch->paths[i]) {
+      sbx_validate_batch_destroy(batch);
+      sbx_set_api_error(errbuf, errbuf_sz, "out of memory");
+      return NULL;
     }
-    return writer;
+    batch->count = i + 1;
+    batch->results[i].status = -1;
   }
+  /* Shared tables are filled here, before any worker can race on them. */
+  sbx_mixbeat_hilbert_init_once();
+  return batch;
+}
 
-  if (cfg.format == SBX_AUDIO_FILE_OGG) {
-    writer->input_mode = SBX_AUDIO_WRITER_INPUT_F32;
-    rc = sbx_audio_writer_init_sndfile(writer, path, SF_FORMAT_OGG | SF_FORMAT_VORBIS);
-  } else if (cfg.format == SBX_AUDIO_FILE_FLAC) {
-    writer->input_mode =
-      (cfg.pcm_bits == 24) ? SBX_AUDIO_WRITER_INPUT_I32 : SBX_AUDIO_WRITER_INPUT_S16;
-    rc = sbx_audio_writer_init_sndfile(writer, path,
-                                       SF_FORMAT_FLAC |
-                                       (cfg.pcm_bits == 24 ? SF_FORMAT_PCM_24 : SF_FORMAT_PCM_16));
-  } else {
-    rc = sbx_audio_writer_init_mp3(writer, path);
-  }
-  if (rc != SBX_OK) {
-    writer->closed = 1;
-    sbx_audio_writer_destroy(writer);
-    return NULL;
+void
+sbx_validate_batch_destroy(SbxValidateBatch *batch) {
+  size_t i;
+  if (!batch) return;
+  for (i = 0; i < batch->count; i++) {
+    free(batch->paths[i]);
+    sbx_free_diagnostics((SbxDiagnostic *)batch->results[i].diags);
   }
-  return writer;
+  free(batch->paths);
+  free(batch->results);
+  free(batch);
 }
 
-int
-sbx_audio_writer_close(SbxAudioWriter *writer) {
-  if (!writer || writer->closed) return SBX_OK;
-  writer->closed = 1;
-
-  if (writer->mp3_gfp) {
-    int rv;
-    if (sbx_audio_writer_ensure_mp3_buf(writer, 4096) != SBX_OK)
-      return SBX_ENOMEM;
-    rv = writer->lame_encode_flush_fn(writer->mp3_gfp, writer->mp3_buf, writer->mp3_buflen);
-    if (rv < 0) {
-      writer_set_error(writer, "MP3 encoder flush failed with error code %d", rv);
-      return SBX_ENOTREADY;
-    }
-    if (rv > 0 &&
-        (!writer->fp ||
-         fwrite(writer->mp3_buf, 1, (size_t)rv, writer->fp) != (size_t)rv)) {
-      writer_set_error(writer, "Failed to write MP3 output bytes");
-      return SBX_ENOTREADY;
-    }
-    writer->bytes_written += (uint64_t)(rv > 0 ? rv : 0);
-    writer->lame_close_fn(writer->mp3_gfp);
-    writer->mp3_gfp = 0;
-  }
+size_t
+sbx_validate_batch_count(const SbxValidateBatch *batch) {
+  return batch ? batch->count : 0;
+}
 
-  if (writer->snd) {
-    if (writer->sf_close_fn(writer->snd) != 0) {
-      writer_set_error(writer, "%s close failed", sbx_audio_file_format_name(writer->cfg.format));
-      writer->snd = 0;
-      sbx_dlib_close(writer->lib);
-      writer->lib = 0;
-      return SBX_ENOTREADY;
-    }
-    writer->snd = 0;
-  }
-  sbx_dlib_close(writer->lib);
-  writer->lib = 0;
+int
+sbx_validate_batch_work(SbxValidateBatch *batch) {
+  size_t index;
 
-  if (writer->fp) {
-    if (writer->cfg.format == SBX_AUDIO_FILE_WAV) {
-      uint32_t data_bytes = writer->bytes_written > 0xFFFFFFD7ULL
-        ? 0xFFFFFFD7u : (uint32_t)writer->bytes_written;
-      if (sbx_audio_writer_write_wav_header(writer->fp,
-                                            (uint32_t)(writer->cfg.sample_rate + 0.5),
-                                            writer->cfg.channels,
-                                            writer->cfg.pcm_bits,
-                                            data_bytes) != SBX_OK) {
-        writer_set_error(writer, "Failed to finalize WAV header");
-        fclose(writer->fp);
-        writer->fp = 0;
-        return SBX_ENOTREADY;
-      }
-    }
-    if (fclose(writer->fp) != 0) {
-      writer_set_error(writer, "Failed to close output file");
-      writer->fp = 0;
-      return SBX_ENOTREADY;
-    }
-    writer->fp = 0;
+  if (!batch) return SBX_EINVAL;
+  for (;;) {
+    sbx_spin_lock(&batch->lock);
+    index = batch->next;
+    if (index < batch->count) batch->next++;
+    sbx_spin_unlock(&batch->lock);
+    if (index >= batch->count) break;
+    sbx_vbatch_run_file(batch, index);
   }
+  return SBX_OK;
+}
 
+int
+sbx_validate_batch_get_result(const SbxValidateBatch *batch,
+                              size_t index,
+                              const char **out_path,
+                              SbxValidateBatchResult *out_result) {
+  if (!batch || index >= batch->count) return SBX_EINVAL;
+  if (out_path) *out_path = batch->paths[index];
+  if (out_result) *out_result = batch->results[index];
   return SBX_OK;
 }
 
 void
-sbx_audio_writer_destroy(SbxAudioWriter *writer) {
-  if (!writer) return;
-  sbx_audio_writer_close(writer);
-  if (writer->mp3_gfp && writer->lame_close_fn)
-    writer->lame_close_fn(writer->mp3_gfp);
-  free(writer->mp3_buf);
-  if (writer->snd && writer->sf_close_fn)
-    writer->sf_close_fn(writer->snd);
-  if (writer->fp)
-    fclose(writer->fp);
-  sbx_dlib_close(writer->lib);
-  free(writer);
+sbx_validate_batch_get_stats(const SbxValidateBatch *batch, SbxValidateBatchStats *out_stats) {
+  size_t i;
+  if (!out_stats) return;
+  memset(out_stats, 0, sizeof(*out_stats));
+  if (!batch) return;
+  for (i = 0; i < batch->count; i++) {
+    const SbxValidateBatchResult *res = &batch->results[i];
+    if (res->status == -1) continue;
+    out_stats->file_count++;
+    if (res->status != SBX_OK || res->error_count) out_stats->failed_count++;
+    out_stats->diag_count += res->diag_count;
+    out_stats->byte_count += res->byte_count;
+    out_stats->busy_sec += res->elapsed_sec;
+  }
+  if (batch->t_first >= 0.0)
+    out_stats->wall_sec = batch->t_last - batch->t_first;
 }
 
-const char *
-sbx_audio_writer_last_error(const SbxAudioWriter *writer) {
-  if (!writer) return "null writer";
-  if (!writer->last_error[0]) return "";
-  return writer->last_error;
+/*
+ * Length of the well-formed UTF-8 sequence starting at s, or 0 if s does
+ * not start one (stray continuation, overlong form, surrogate, beyond
+ * U+10FFFF, or cut short by the terminating NUL).
+ */
+static int
+sbx_utf8_seq_len(const unsigned char *s) {
+  unsigned char c = s[0], lo, hi;
+  if (c < 0x80) return 1;
+  if (c >= 0xc2 && c <= 0xdf) return (s[1] & 0xc0) == 0x80 ? 2 : 0;
+  if (c >= 0xe0 && c <= 0xef) {
+    lo = c == 0xe0 ? 0xa0 : 0x80;
+    hi = c == 0xed ? 0x9f : 0xbf;
+    return (s[1] >= lo && s[1] <= hi && (s[2] & 0xc0) == 0x80) ? 3 : 0;
+  }
+  if (c >= 0xf0 && c <= 0xf4) {
+    lo = c == 0xf0 ? 0x90 : 0x80;
+    hi = c == 0xf4 ? 0x8f : 0xbf;
+    return (s[1] >= lo && s[1] <= hi && (s[2] & 0xc0) == 0x80 &&
+            (s[3] & 0xc0) == 0x80) ? 4 : 0;
+  }
+  return 0;
+}
+
+/*
+ * Writes s as a JSON string. Paths and messages come from the file system
+ * and need not be UTF-8; each byte that does not start a well-formed
+ * sequence is written as U+FFFD so the output stays valid JSON.
+ */
+static void
+sbx_json_write_string(FILE *fp, const char *s) {
+  const unsigned char *p = (const unsigned char *)s;
+  int n;
+
+  fputc('"', fp);
+  while (*p) {
+    unsigned char c = *p;
+    if (c >= 0x80) {
+      n = sbx_utf8_seq_len(p);
+      if (n) fwrite(p, 1, (size_t)n, fp);
+      else fputs("\xef\xbf\xbd", fp);
+      p += n ? n : 1;
+      continue;
+    }
+    if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+    else if (c == '\n') fputs("\\n", fp);
+    else if (c == '\r') fputs("\\r", fp);
+    else if (c == '\t') fputs("\\t", fp);
+    else if (c < 0x20) fprintf(fp, "\\u%04x", c);
+    else fputc(c, fp);
+    p++;
+  }
+  fputc('"', fp);
 }
 
 int
-sbx_audio_writer_frame_bytes(const SbxAudioWriter *writer) {
-  if (!writer) return 0;
-  if (writer->input_mode == SBX_AUDIO_WRITER_INPUT_F32) return 8;
-  if (writer->cfg.format == SBX_AUDIO_FILE_FLAC && writer->cfg.pcm_bits == 24) return 6;
-  return writer->cfg.channels * (writer->cfg.pcm_bits / 8);
+sbx_validate_batch_write_jsonl(const SbxValidateBatch *batch, FILE *fp) {
+  SbxValidateBatchStats st;
+  size_t i, j;
+
+  if (!batch || !fp) return SBX_EINVAL;
+  for (i = 0; i < batch->count; i++) {
+    const SbxValidateBatchResult *res = &batch->results[i];
+    const char *status;
+    if (res->status == -1) status = "pending";
+    else if (res->status != SBX_OK) status = "failed";
+    else if (res->error_count) status = "error";
+    else if (res->warning_count) status = "warning";
+    else status = "ok";
+    fputs("{\"path\":", fp);
+    sbx_json_write_string(fp, batch->paths[i]);
+    fprintf(fp, ",\"status\":\"%s\",\"bytes\":%lu,\"ms\":%.3f,\"diagnostics\":[",
+            status, (unsigned long)res->byte_count, res->elapsed_sec * 1000.0);
+    for (j = 0; j < res->diag_count; j++) {
+      const SbxDiagnostic *d = &res->diags[j];
+      fprintf(fp, "%s{\"severity\":\"%s\",\"code\":", j ? "," : "",
+              d->severity == SBX_DIAG_ERROR ? "error" : "warning");
+      sbx_json_write_string(fp, d->code);
+      fprintf(fp, ",\"line\":%lu,\"column\":%lu,\"end_line\":%lu,\"end_column\":%lu,\"message\":",
+              (unsigned long)d->line, (unsigned long)d->column,
+              (unsigned long)d->end_line, (unsigned long)d->end_column);
+      sbx_json_write_string(fp, d->message);
+      fputc('}', fp);
+    }
+    fputs("]}\n", fp);
+  }
+  sbx_validate_batch_get_stats(batch, &st);
+  fprintf(fp, "{\"summary\":{\"files\":%lu,\"failed\":%lu,\"diagnostics\":%lu,"
+          "\"bytes\":%lu,\"wall_sec\":%.6f,\"busy_sec\":%.6f,"
+          "\"files_per_sec\":%.1f,\"mb_per_sec\":%.3f}}\n",
+          (unsigned long)st.file_count, (unsigned long)st.failed_count,
+          (unsigned long)st.diag_count, (unsigned long)st.byte_count,
+          st.wall_sec, st.busy_sec,
+          st.wall_sec > 0.0 ? (double)st.file_count / st.wall_sec : 0.0,
+          st.wall_sec > 0.0 ? (double)st.byte_count / 1048576.0 / st.wall_sec : 0.0);
+  return ferror(fp) ? SBX_ENOTREADY : SBX_OK;
+}
+
+SbxEngine *
+sbx_engine_create(const SbxEngineConfig *cfg_in) {
+  SbxEngine *eng;
+  SbxEngineConfig cfg;
+
+  sbx_default_engine_config(&cfg);
+  if (cfg_in) cfg = *cfg_in;
+
+  if (cfg.sample_rate <= 0.0 || cfg.channels != 2)
+    return NULL;
+
+  eng = (SbxEngine *)calloc(1, sizeof(*eng));
+  if (!eng) return NULL;
+
+  eng->cfg = cfg;
+  sbx_default_tone_spec(&eng->tone);
+  eng->out_gain_l = 1.0;
+  eng->out_gain_r = 1.0;
+  eng->rng_state = 0x12345678u;
+  set_last_error(eng, NULL);
+  return eng;
+}
+
+void
+sbx_engine_destroy(SbxEngine *eng) {
+  if (!eng) return;
+  free(eng);
+}
+
+void
+sbx_engine_reset(SbxEngine *eng) {
+  if (!eng) return;
+  eng->out_gain_l = 1.0;
+  eng->out_gain_r = 1.0;
+  eng->phase_l = 0.0;
+  eng->phase_r = 0.0;
+  eng->pulse_phase = 0.0;
+  memset(eng->pink_l, 0, sizeof(eng->pink_l));
+  memset(eng->pink_r, 0, sizeof(eng->pink_r));
+  eng->brown_l = 0.0;
+  eng->brown_r = 0.0;
+  memset(eng->noise_hist_l, 0, sizeof(eng->noise_hist_l));
+  memset(eng->noise_hist_r, 0, sizeof(eng->noise_hist_r));
+  memset(eng->noise_hist_m, 0, sizeof(eng->noise_hist_m));
+  eng->noise_hist_pos_l = 0;
+  eng->noise_hist_pos_r = 0;
+  eng->noise_hist_pos_m = 0;
+  memset(eng->noisebeat_hist, 0, sizeof(eng->noisebeat_hist));
+  eng->noisebeat_hist_pos = 0;
+  memset(eng->orbit_delay, 0, sizeof(eng->orbit_delay));
+  eng->orbit_delay_pos = 0;
+  eng->orbit_lpf_l = 0.0;
+  eng->orbit_lpf_r = 0.0;
+  eng->bell_env = 0.0;
+  eng->bell_tick = 0;
+  eng->bell_tick_period = (int)(eng->cfg.sample_rate / 20.0);
+  if (eng->bell_tick_period < 1) eng->bell_tick_period = 1;
 }
 
 int
-sbx_audio_writer_input_mode(const SbxAudioWriter *writer) {
-  if (!writer) return SBX_AUDIO_WRITER_INPUT_BYTES;
-  return writer->input_mode;
+sbx_engine_set_tone(SbxEngine *eng, const SbxToneSpec *tone_in) {
+  return engine_apply_tone(eng, tone_in, 1);
 }
 
 int
-sbx_audio_writer_write_bytes(SbxAudioWriter *writer, const void *buf, size_t byte_count) {
-  if (!writer || !buf) return SBX_EINVAL;
-  if (writer->cfg.format != SBX_AUDIO_FILE_RAW && writer->cfg.format != SBX_AUDIO_FILE_WAV) {
-    writer_set_error(writer, "byte writes are only valid for raw/WAV outputs");
-    return SBX_EINVAL;
-  }
-  if (!writer->fp) {
-    writer_set_error(writer, "output file is not open");
-    return SBX_ENOTREADY;
-  }
-  if (byte_count && fwrite(buf, 1, byte_count, writer->fp) != byte_count) {
-    writer_set_error(writer, "Failed to write output bytes");
+sbx_engine_render_f32(SbxEngine *eng, float *out, size_t frames) {
+  size_t i;
+
+  if (!eng || !out) return SBX_EINVAL;
+  if (eng->cfg.channels != 2 || eng->cfg.sample_rate <= 0.0) {
+    set_last_error(eng, "engine configuration is invalid");
     return SBX_ENOTREADY;
   }
-  writer->bytes_written += byte_count;
-  return SBX_OK;
-}
 
-int
-sbx_audio_writer_write_s16(SbxAudioWriter *writer,
-                           const int16_t *pcm,
-                           size_t frame_count) {
-  sf_count_t wr;
-  if (!writer || !pcm) return SBX_EINVAL;
-  if (writer->cfg.format == SBX_AUDIO_FILE_MP3) {
-    int rv;
-    if (!writer->mp3_gfp || !writer->lame_encode_buffer_interleaved_fn) {
-      writer_set_error(writer, "PCM16 MP3 writer is not ready");
-      return SBX_ENOTREADY;
-    }
-    if (sbx_audio_writer_ensure_mp3_buf(writer, (int)frame_count) != SBX_OK)
-      return SBX_ENOMEM;
-    rv = writer->lame_encode_buffer_interleaved_fn(writer->mp3_gfp,
-                                                   (short int *)pcm,
-                                                   (int)frame_count,
-                                                   writer->mp3_buf,
-                                                   writer->mp3_buflen);
-    if (rv < 0) {
-      writer_set_error(writer, "MP3 encoding failed with error code %d", rv);
-      return SBX_ENOTREADY;
-    }
-    if (rv > 0 &&
-        (!writer->fp ||
-         fwrite(writer->mp3_buf, 1, (size_t)rv, writer->fp) != (size_t)rv)) {
-      writer_set_error(writer, "Failed to write MP3 output bytes");
-      return SBX_ENOTREADY;
-    }
-    writer->bytes_written += (uint64_t)(rv > 0 ? rv : 0);
+  if (eng->tone.mode == SBX_TONE_NONE) {
+    memset(out, 0, frames * eng->cfg.channels * sizeof(float));
     return SBX_OK;
   }
-  if (!writer->snd || !writer->sf_writef_short_fn) {
-    writer_set_error(writer, "PCM16 writer is not ready");
-    return SBX_ENOTREADY;
-  }
-  wr = writer->sf_writef_short_fn(writer->snd, (const short *)pcm, (sf_count_t)frame_count);
-  if (wr != (sf_count_t)frame_count) {
-    writer_set_error(writer, "%s encoding failed while writing PCM16 frames",
-                     sbx_audio_file_format_name(writer->cfg.format));
-    return SBX_ENOTREADY;
+
+  for (i = 0; i < frames; i++) {
+    float left = 0.0f, right = 0.0f;
+    engine_render_sample(eng, &left, &right);
+    out[i * 2] = left;
+    out[i * 2 + 1] = right;
   }
+
   return SBX_OK;
 }
 
+const char *
+sbx_engine_last_error(const SbxEngine *eng) {
+  if (!eng) return "null engine";
+  if (!eng->last_error[0]) return "";
+  return eng->last_error;
+}
+
 int
-sbx_audio_writer_write_f32(SbxAudioWriter *writer,
-                           const float *pcm,
-                           size_t frame_count) {
-  sf_count_t wr;
-  if (!writer || !pcm) return SBX_EINVAL;
-  if (writer->cfg.format == SBX_AUDIO_FILE_MP3) {
-    int rv;
-    if (!writer->mp3_gfp || !writer->lame_encode_buffer_interleaved_ieee_float_fn) {
-      writer_set_error(writer, "float MP3 writer is not ready");
-      return SBX_ENOTREADY;
-    }
-    if (sbx_audio_writer_ensure_mp3_buf(writer, (int)frame_count) != SBX_OK)
-      return SBX_ENOMEM;
-    rv = writer->lame_encode_buffer_interleaved_ieee_float_fn(writer->mp3_gfp,
-                                                              (float *)pcm,
-                                                              (int)frame_count,
-                                                              writer->mp3_buf,
-                                                              writer->mp3_buflen);
-    if (rv < 0) {
-      writer_set_error(writer, "MP3 float encoding failed with error code %d", rv);
-      return SBX_ENOTREADY;
-    }
-    if (rv > 0 &&
-        (!writer->fp ||
-         fwrite(writer->mp3_buf, 1, (size_t)rv, writer->fp) != (size_t)rv)) {
-      writer_set_error(writer, "Failed to write MP3 output bytes");
-      return SBX_ENOTREADY;
-    }
-    writer->bytes_written += (uint64_t)(rv > 0 ? rv : 0);
-    return SBX_OK;
-  }
-  if (!writer->snd || !writer->sf_writef_float_fn) {
-    writer_set_error(writer, "float writer is not ready");
-    return SBX_ENOTREADY;
+sbx_convert_f32_to_s16(const float *in,
+                       short *out,
+                       size_t sample_count,
+                       SbxPcm16DitherState *dither_state) {
+  SbxPcmConvertState state;
+  SbxPcmConvertState *sp = 0;
+  if (dither_state) {
+    state.rng_state = dither_state->rng_state;
+    state.dither_mode = SBX_PCM_DITHER_TPDF;
+    sp = &state;
   }
-  wr = writer->sf_writef_float_fn(writer->snd, pcm, (sf_count_t)frame_count);
-  if (wr != (sf_count_t)frame_count) {
-    writer_set_error(writer, "%s encoding failed while writing float frames",
-                     sbx_audio_file_format_name(writer->cfg.format));
-    return SBX_ENOTREADY;
+  {
+    int rc = sbx_convert_f32_to_s16_ex(in, (int16_t *)out, sample_count, sp);
+    if (dither_state) dither_state->rng_state = state.rng_state;
+    return rc;
   }
-  return SBX_OK;
 }
 
 int
-sbx_audio_writer_write_i32(SbxAudioWriter *writer,
-                           const int32_t *pcm,
-                           size_t frame_count) {
-  sf_count_t wr;
-  if (!writer || !pcm) return SBX_EINVAL;
-  if (!writer->snd || !writer->sf_writef_int_fn) {
-    writer_set_error(writer, "PCM32 writer is not ready");
-    return SBX_ENOTREADY;
-  }
-  wr = writer->sf_writef_int_fn(writer->snd, (const int *)pcm, (sf_count_t)frame_count);
-  if (wr != (sf_count_t)frame_count) {
-    writer_set_error(writer, "%s encoding failed while writing PCM32 frames",
-                     sbx_audio_file_format_name(writer->cfg.format));
-    return SBX_ENOTREADY;
+sbx_convert_f32_to_s16_ex(const float *in,
+                          int16_t *out,
+                          size_t sample_count,
+                          SbxPcmConvertState *state) {
+  size_t i;
+
+  if (!in || !out) return SBX_EINVAL;
+  for (i = 0; i < sample_count; i++) {
+    double pcm = (double)in[i] * 32767.0;
+    out[i] = (int16_t)sbx_pcm_quantize_sample_ll(pcm, -32768.0, 32767.0, state);
   }
   return SBX_OK;
 }
 
-SbxMixInput *
-sbx_mix_input_create_stdio(FILE *stream,
-                           const char *path_hint,
-                           const SbxMixInputConfig *cfg_in) {
-  SbxMixInput *input;
-  SbxMixInputConfig cfg;
-  const char *ext = 0;
-  const char *dot = 0;
-  const char *slash = 0;
-  const char *bslash = 0;
-  jmp_buf env;
-  int a;
-  char lower[8];
-
-  if (!stream) return 0;
-  sbx_default_mix_input_config(&cfg);
-  if (cfg_in) cfg = *cfg_in;
-
-  input = (SbxMixInput *)calloc(1, sizeof(*input));
-  if (!input) return 0;
-  input->fp = stream;
-  input->mix_section = cfg.mix_section;
-  input->output_rate_hz = cfg.output_rate_hz;
-  input->output_rate_is_default = cfg.output_rate_is_default ? 1 : 0;
-  input->take_stream_ownership = cfg.take_stream_ownership ? 1 : 0;
-  input->warn_cb = cfg.warn_cb;
-  input->warn_user = cfg.warn_user;
-  input->format = SBX_MIX_INPUT_RAW;
-  if (path_hint && *path_hint) {
-    input->path_hint = strdup(path_hint);
-    if (!input->path_hint) {
-      free(input);
-      return 0;
-    }
-  }
-  if (cfg.looper_spec_override && cfg.looper_spec_override[0]) {
-    input->looper_spec_override = strdup(cfg.looper_spec_override);
-    if (!input->looper_spec_override) {
-      if (input->path_hint) free(input->path_hint);
-      free(input);
-      return 0;
-    }
-  }
+int
+sbx_convert_f32_to_s24_32(const float *in,
+                          int32_t *out,
+                          size_t sample_count,
+                          SbxPcmConvertState *state) {
+  size_t i;
 
-  if (path_hint && *path_hint) {
-    dot = strrchr(path_hint, '.');
-    slash = strrchr(path_hint, '/');
-    bslash = strrchr(path_hint, '\\');
-    if (dot && (!slash || dot > slash) && (!bslash || dot > bslash) && dot[1])
-      ext = dot + 1;
+  if (!in || !out) return SBX_EINVAL;
+  for (i = 0; i < sample_count; i++) {
+    double pcm = (double)in[i] * 8388607.0;
+    out[i] = (int32_t)sbx_pcm_quantize_sample_ll(pcm, -8388608.0, 8388607.0, state);
   }
+  return SBX_OK;
+}
 
-  sbx_mix_input_activate(input);
-  sbx_mix_registered_read = 0;
-  sbx_mix_jmp_env = &env;
+int
+sbx_convert_f32_to_s32(const float *in,
+                       int32_t *out,
+                       size_t sample_count,
+                       SbxPcmConvertState *state) {
+  size_t i;
 
-  if (setjmp(env) != 0) {
-    sbx_mix_jmp_env = 0;
-    sbx_mix_registered_read = 0;
-    sbx_mix_input_sync_back(input);
-    return input;
+  if (!in || !out) return SBX_EINVAL;
+  for (i = 0; i < sample_count; i++) {
+    double pcm = (double)in[i] * 2147483647.0;
+    out[i] = (int32_t)sbx_pcm_quantize_sample_ll(pcm, -2147483648.0, 2147483647.0, state);
   }
+  return SBX_OK;
+}
 
-  if (ext) {
-    int len = (int)strlen(ext);
-    if (len >= (int)sizeof(lower))
-      len = (int)sizeof(lower) - 1;
-    for (a = 0; a < len; a++)
-      lower[a] = (char)tolower((unsigned char)ext[a]);
-    lower[len] = 0;
-    ext = lower;
+static const char *
+sbx_audio_file_format_name(int format) {
+  switch (format) {
+    case SBX_AUDIO_FILE_RAW: return "raw";
+    case SBX_AUDIO_FILE_WAV: return "WAV";
+    case SBX_AUDIO_FILE_OGG: return "OGG/Vorbis";
+    case SBX_AUDIO_FILE_FLAC: return "FLAC";
+    case SBX_AUDIO_FILE_MP3: return "MP3";
+    default: return "unknown";
   }
+}
 
-  if (ext && strcmp(ext, "wav") == 0) {
-    input->format = sbx_mix_input_find_wav_data_start(input)
-      ? SBX_MIX_INPUT_WAV : SBX_MIX_INPUT_RAW;
-    input->read_fn = sbx_mix_input_raw_read;
-    sbx_mix_input_activate(input);
-  } else if (ext && strcmp(ext, "ogg") == 0) {
-#ifdef OGG_DECODE
-    ogg_init();
-    input->format = SBX_MIX_INPUT_OGG;
-    input->read_fn = sbx_mix_registered_read;
-    input->term_fn = ogg_term;
+static int
+sbx_audio_writer_init_sndfile(SbxAudioWriter *writer, const char *path, int format) {
+#ifndef STATIC_OUTPUT_ENCODERS
+  const char *names[] = {
+#if defined(T_MINGW) || defined(T_MSVC)
+    "libsndfile-1.dll",
+    "sndfile.dll",
+#elif defined(T_MACOSX)
+    "libsndfile.1.dylib",
+    "libsndfile.dylib",
 #else
-    mix_input_set_error(input, "Ogg mix-input support was not compiled into this sbagenxlib build");
+    "libsndfile.so.1",
+    "libsndfile.so",
 #endif
-  } else if (ext && strcmp(ext, "mp3") == 0) {
-#ifdef MP3_DECODE
-    mp3_init();
-    input->format = SBX_MIX_INPUT_MP3;
-    input->read_fn = sbx_mix_registered_read;
-    input->term_fn = mp3_term;
-#else
-    mix_input_set_error(input, "MP3 mix-input support was not compiled into this sbagenxlib build");
+    0
+  };
 #endif
-  } else if (ext && strcmp(ext, "flac") == 0) {
-#ifdef FLAC_DECODE
-    flac_init();
-    input->format = SBX_MIX_INPUT_FLAC;
-    input->read_fn = sbx_mix_registered_read;
-    input->term_fn = sbx_flac_term;
+  SF_INFO info;
+
+#ifdef STATIC_OUTPUT_ENCODERS
+  writer->sf_open_fn = sf_open;
+  writer->sf_writef_short_fn = sf_writef_short;
+  writer->sf_writef_float_fn = sf_writef_float;
+  writer->sf_writef_int_fn = sf_writef_int;
+  writer->sf_close_fn = sf_close;
+  writer->sf_strerror_fn = sf_strerror;
+  writer->sf_command_fn = sf_command;
 #else
-    mix_input_set_error(input, "FLAC mix-input support was not compiled into this sbagenxlib build");
-#endif
-  } else {
-    input->format = SBX_MIX_INPUT_RAW;
-    input->read_fn = sbx_mix_input_raw_read;
-    sbx_mix_input_activate(input);
+  writer->lib = sbx_dlib_open_best(names);
+  if (!writer->lib) {
+    writer_set_error(writer,
+                     "%s output requested, but libsndfile runtime library is not available",
+                     sbx_audio_file_format_name(writer->cfg.format));
+    return SBX_ENOTREADY;
+  }
+  writer->sf_open_fn =
+    (SNDFILE *(*)(const char*, int, SF_INFO*))sbx_dlib_sym(writer->lib, "sf_open");
+  writer->sf_writef_short_fn =
+    (sf_count_t(*)(SNDFILE*, const short*, sf_count_t))sbx_dlib_sym(writer->lib, "sf_writef_short");
+  writer->sf_writef_float_fn =
+    (sf_count_t(*)(SNDFILE*, const float*, sf_count_t))sbx_dlib_sym(writer->lib, "sf_writef_float");
+  writer->sf_writef_int_fn =
+    (sf_count_t(*)(SNDFILE*, const int*, sf_count_t))sbx_dlib_sym(writer->lib, "sf_writef_int");
+  writer->sf_close_fn =
+    (int(*)(SNDFILE*))sbx_dlib_sym(writer->lib, "sf_close");
+  writer->sf_strerror_fn =
+    (const char *(*)(SNDFILE*))sbx_dlib_sym(writer->lib, "sf_strerror");
+  writer->sf_command_fn =
+    (int(*)(SNDFILE*, int, void*, int))sbx_dlib_sym(writer->lib, "sf_command");
+  if (!writer->sf_open_fn || !writer->sf_writef_short_fn || !writer->sf_close_fn ||
+      !writer->sf_strerror_fn || !writer->sf_command_fn) {
+    writer_set_error(writer,
+                     "Failed to load required libsndfile symbols for %s output",
+                     sbx_audio_file_format_name(writer->cfg.format));
+    return SBX_ENOTREADY;
   }
+#endif
 
-  if (input->looper_spec_override && input->looper_spec_override[0] &&
-      input->format != SBX_MIX_INPUT_OGG &&
-      input->format != SBX_MIX_INPUT_MP3 &&
-      input->format != SBX_MIX_INPUT_FLAC &&
-      !input->last_error[0]) {
-    mix_input_set_error(
-      input,
-      "SBAGEN_LOOPER override is currently supported only for OGG, MP3 and FLAC mix inputs"
-    );
+  memset(&info, 0, sizeof(info));
+  info.channels = writer->cfg.channels;
+  info.samplerate = (int)(writer->cfg.sample_rate + 0.5);
+  info.format = format;
+  writer->snd = writer->sf_open_fn(path, SFM_WRITE, &info);
+  if (!writer->snd) {
+    writer_set_error(writer,
+                     "Failed to open output file for %s encoding: %s",
+                     sbx_audio_file_format_name(writer->cfg.format),
+                     writer->sf_strerror_fn ? writer->sf_strerror_fn(0) : "unknown error");
+    return SBX_ENOTREADY;
   }
 
-  if (!input->read_fn && !input->last_error[0])
-    mix_input_set_error(input, "Unsupported or unavailable mix input format");
+  if (writer->cfg.format == SBX_AUDIO_FILE_OGG && writer->cfg.ogg_quality_set) {
+    double q = writer->cfg.ogg_quality / 10.0;
+    if (writer->sf_command_fn(writer->snd,
+                              SFC_SET_VBR_ENCODING_QUALITY,
+                              &q,
+                              (int)sizeof(q)) <= 0) {
+      writer_set_error(writer,
+                       "Failed to set OGG Vorbis quality to %.2f (range 0..10)",
+                       writer->cfg.ogg_quality);
+      return SBX_EINVAL;
+    }
+  }
+  if (writer->cfg.format == SBX_AUDIO_FILE_FLAC &&
+      writer->cfg.flac_compression_set) {
+    double c = writer->cfg.flac_compression / 12.0;
+    if (writer->sf_command_fn(writer->snd,
+                              SFC_SET_COMPRESSION_LEVEL,
+                              &c,
+                              (int)sizeof(c)) <= 0) {
+      writer_set_error(writer,
+                       "Failed to set FLAC compression level to %.2f (range 0..12)",
+                       writer->cfg.flac_compression);
+      return SBX_EINVAL;
+    }
+  }
 
-  sbx_mix_input_sync_back(input);
-  sbx_mix_jmp_env = 0;
-  sbx_mix_registered_read = 0;
-  return input;
+  return SBX_OK;
 }
 
-int
-sbx_mix_input_read(SbxMixInput *input, int *dst, int sample_count) {
-  jmp_buf env;
-  int rv;
+static int
+sbx_audio_writer_ensure_mp3_buf(SbxAudioWriter *writer, int frames) {
+  int need;
+  unsigned char *buf;
 
-  if (!input || !dst || sample_count < 0) return -1;
-  if (!input->read_fn) {
-    if (!input->last_error[0])
-      mix_input_set_error(input, "mix input is not initialized");
-    return -1;
+  if (!writer || frames < 0) return SBX_EINVAL;
+  need = 7200 + (int)(1.25 * frames + 0.5);
+  if (need <= writer->mp3_buflen) return SBX_OK;
+
+  buf = writer->mp3_buf
+    ? (unsigned char *)realloc(writer->mp3_buf, (size_t)need)
+    : (unsigned char *)malloc((size_t)need);
+  if (!buf) {
+    writer_set_error(writer, "Out of memory allocating MP3 buffer");
+    return SBX_ENOMEM;
   }
+  writer->mp3_buf = buf;
+  writer->mp3_buflen = need;
+  return SBX_OK;
+}
 
-  input->last_error[0] = 0;
+static int
+sbx_audio_writer_init_mp3(SbxAudioWriter *writer, const char *path) {
+#ifndef STATIC_OUTPUT_ENCODERS
+  const char *names[] = {
+#if defined(T_MINGW) || defined(T_MSVC)
+    "libmp3lame-0.dll",
+    "libmp3lame.dll",
+#elif defined(T_MACOSX)
+    "libmp3lame.0.dylib",
+    "libmp3lame.dylib",
+#else
+    "libmp3lame.so.0",
+    "libmp3lame.so",
+#endif
+    0
+  };
+#endif
+  int bitrate = writer->cfg.mp3_bitrate_set ? writer->cfg.mp3_bitrate : 192;
+  int quality = writer->cfg.mp3_quality_set ? writer->cfg.mp3_quality : 2;
+  double vbr_quality = writer->cfg.mp3_vbr_quality_set ? writer->cfg.mp3_vbr_quality : 0.0;
+
+#ifdef STATIC_OUTPUT_ENCODERS
+  writer->lame_init_fn = lame_init;
+  writer->lame_set_in_samplerate_fn = lame_set_in_samplerate;
+  writer->lame_set_num_channels_fn = lame_set_num_channels;
+  writer->lame_set_quality_fn = lame_set_quality;
+  writer->lame_set_VBR_fn = lame_set_VBR;
+  writer->lame_set_VBR_q_fn = lame_set_VBR_q;
+  writer->lame_set_VBR_quality_fn = lame_set_VBR_quality;
+  writer->lame_set_brate_fn = lame_set_brate;
+  writer->lame_init_params_fn = lame_init_params;
+  writer->lame_encode_buffer_interleaved_fn = lame_encode_buffer_interleaved;
+  writer->lame_encode_buffer_interleaved_ieee_float_fn = lame_encode_buffer_interleaved_ieee_float;
+  writer->lame_encode_flush_fn = lame_encode_flush;
+  writer->lame_close_fn = lame_close;
+#else
+  writer->lib = sbx_dlib_open_best(names);
+  if (!writer->lib) {
+    writer_set_error(writer,
+                     "MP3 output requested, but libmp3lame runtime library is not available");
+    return SBX_ENOTREADY;
+  }
+  writer->lame_init_fn = (lame_t(*)(void))sbx_dlib_sym(writer->lib, "lame_init");
+  writer->lame_set_in_samplerate_fn =
+    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_in_samplerate");
+  writer->lame_set_num_channels_fn =
+    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_num_channels");
+  writer->lame_set_quality_fn =
+    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_quality");
+  writer->lame_set_VBR_fn =
+    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_VBR");
+  writer->lame_set_VBR_q_fn =
+    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_VBR_q");
+  writer->lame_set_VBR_quality_fn =
+    (int(*)(lame_t, float))sbx_dlib_sym(writer->lib, "lame_set_VBR_quality");
+  writer->lame_set_brate_fn =
+    (int(*)(lame_t, int))sbx_dlib_sym(writer->lib, "lame_set_brate");
+  writer->lame_init_params_fn =
+    (int(*)(lame_t))sbx_dlib_sym(writer->lib, "lame_init_params");
+  writer->lame_encode_buffer_interleaved_fn =
+    (int(*)(lame_t, short int*, int, unsigned char*, int))
+      sbx_dlib_sym(writer->lib, "lame_encode_buffer_interleaved");
+  writer->lame_encode_buffer_interleaved_ieee_float_fn =
+    (int(*)(lame_t, float*, int, unsigned char*, int))
+      sbx_dlib_sym(writer->lib, "lame_encode_buffer_interleaved_ieee_float");
+  writer->lame_encode_flush_fn =
+    (int(*)(lame_t, unsigned char*, int))sbx_dlib_sym(writer->lib, "lame_encode_flush");
+  writer->lame_close_fn =
+    (int(*)(lame_t))sbx_dlib_sym(writer->lib, "lame_close");
+#endif
+
+  if (!writer->lame_init_fn ||
+      !writer->lame_set_in_samplerate_fn ||
+      !writer->lame_set_num_channels_fn ||
+      !writer->lame_set_quality_fn ||
+      !(writer->cfg.mp3_vbr_quality_set
+          ? (writer->lame_set_VBR_fn &&
+             (writer->lame_set_VBR_quality_fn || writer->lame_set_VBR_q_fn))
+          : (writer->lame_set_brate_fn != 0)) ||
+      !writer->lame_init_params_fn ||
+      !writer->lame_encode_buffer_interleaved_fn ||
+      !writer->lame_encode_flush_fn ||
+      !writer->lame_close_fn) {
+    writer_set_error(writer, "Failed to load required libmp3lame symbols");
+    return SBX_ENOTREADY;
+  }
+
+  writer->fp = fopen(path, "wb");
+  if (!writer->fp) {
+    writer_set_error(writer, "Failed to open \"%s\" for writing: errno %d", path, errno);
+    return SBX_ENOTREADY;
+  }
+
+  writer->mp3_gfp = writer->lame_init_fn();
+  if (!writer->mp3_gfp) {
+    writer_set_error(writer, "lame_init() failed");
+    return SBX_ENOTREADY;
+  }
+
+  if (writer->lame_set_num_channels_fn(writer->mp3_gfp, writer->cfg.channels) < 0 ||
+      writer->lame_set_in_samplerate_fn(writer->mp3_gfp, (int)(writer->cfg.sample_rate + 0.5)) < 0 ||
+      writer->lame_set_quality_fn(writer->mp3_gfp, quality) < 0) {
+    writer_set_error(writer, "Failed to configure MP3 encoder");
+    return SBX_EINVAL;
+  }
+
+  if (writer->cfg.mp3_vbr_quality_set) {
+    int q_i;
+    if (writer->lame_set_VBR_fn(writer->mp3_gfp, 4) < 0) {
+      writer_set_error(writer, "Failed to configure MP3 VBR mode");
+      return SBX_EINVAL;
+    }
+    if (writer->lame_set_VBR_quality_fn) {
+      if (writer->lame_set_VBR_quality_fn(writer->mp3_gfp, (float)vbr_quality) < 0) {
+        writer_set_error(writer,
+                         "Failed to configure MP3 VBR quality %.2f (range 0..9)",
+                         vbr_quality);
+        return SBX_EINVAL;
+      }
+    } else {
+      q_i = (int)(vbr_quality + 0.5);
+      if (q_i < 0) q_i = 0;
+      if (q_i > 9) q_i = 9;
+      if (writer->lame_set_VBR_q_fn(writer->mp3_gfp, q_i) < 0) {
+        writer_set_error(writer,
+                         "Failed to configure MP3 VBR quality %d (range 0..9)",
+                         q_i);
+        return SBX_EINVAL;
+      }
+    }
+  } else {
+    if (writer->lame_set_brate_fn(writer->mp3_gfp, bitrate) < 0) {
+      writer_set_error(writer, "Failed to configure MP3 bitrate %d kbps", bitrate);
+      return SBX_EINVAL;
+    }
+  }
+
+  if (writer->lame_init_params_fn(writer->mp3_gfp) < 0) {
+    writer_set_error(writer, "Failed to initialize MP3 encoder parameters");
+    return SBX_EINVAL;
+  }
+
+  writer->input_mode =
+    (writer->cfg.prefer_float_input && writer->lame_encode_buffer_interleaved_ieee_float_fn)
+      ? SBX_AUDIO_WRITER_INPUT_F32
+      : SBX_AUDIO_WRITER_INPUT_S16;
+  return SBX_OK;
+}
+
+SbxAudioWriter *
+sbx_audio_writer_create_path(const char *path, const SbxAudioWriterConfig *cfg_in) {
+  SbxAudioWriter *writer;
+  SbxAudioWriterConfig cfg;
+  int rc = SBX_OK;
+
+  if (!path || !path[0]) return NULL;
+  sbx_default_audio_writer_config(&cfg);
+  if (cfg_in) cfg = *cfg_in;
+  if (cfg.sample_rate <= 0.0 || cfg.channels != 2)
+    return NULL;
+  if (cfg.format < SBX_AUDIO_FILE_RAW || cfg.format > SBX_AUDIO_FILE_MP3)
+    return NULL;
+  if (cfg.pcm_bits != 8 && cfg.pcm_bits != 16 && cfg.pcm_bits != 24)
+    return NULL;
+  if ((cfg.format == SBX_AUDIO_FILE_OGG || cfg.format == SBX_AUDIO_FILE_FLAC) &&
+      cfg.pcm_bits != 16 && cfg.pcm_bits != 24)
+    return NULL;
+  if (cfg.format == SBX_AUDIO_FILE_OGG && cfg.pcm_bits != 16)
+    cfg.pcm_bits = 16;
+  if (cfg.format == SBX_AUDIO_FILE_MP3)
+    cfg.pcm_bits = 16;
+
+  writer = (SbxAudioWriter *)calloc(1, sizeof(*writer));
+  if (!writer) return NULL;
+  writer->cfg = cfg;
+  writer->input_mode = SBX_AUDIO_WRITER_INPUT_BYTES;
+
+  if (cfg.format == SBX_AUDIO_FILE_RAW || cfg.format == SBX_AUDIO_FILE_WAV) {
+    writer->fp = fopen(path, "wb");
+    if (!writer->fp) {
+      writer_set_error(writer, "Failed to open \"%s\" for writing: errno %d", path, errno);
+      sbx_audio_writer_destroy(writer);
+      return NULL;
+    }
+    if (cfg.format == SBX_AUDIO_FILE_WAV) {
+      rc = sbx_audio_writer_write_wav_header(writer->fp,
+                                             (uint32_t)(cfg.sample_rate + 0.5),
+                                             cfg.channels,
+                                             cfg.pcm_bits,
+                                             0u);
+      if (rc != SBX_OK) {
+        writer_set_error(writer, "Failed to write initial WAV header");
+        sbx_audio_writer_destroy(writer);
+        return NULL;
+      }
+    }
+    return writer;
+  }
+
+  if (cfg.format == SBX_AUDIO_FILE_OGG) {
+    writer->input_mode = SBX_AUDIO_WRITER_INPUT_F32;
+    rc = sbx_audio_writer_init_sndfile(writer, path, SF_FORMAT_OGG | SF_FORMAT_VORBIS);
+  } else if (cfg.format == SBX_AUDIO_FILE_FLAC) {
+    writer->input_mode =
+      (cfg.pcm_bits == 24) ? SBX_AUDIO_WRITER_INPUT_I32 : SBX_AUDIO_WRITER_INPUT_S16;
+    rc = sbx_audio_writer_init_sndfile(writer, path,
+                                       SF_FORMAT_FLAC |
+                                       (cfg.pcm_bits == 24 ? SF_FORMAT_PCM_24 : SF_FORMAT_PCM_16));
+  } else {
+    rc = sbx_audio_writer_init_mp3(writer, path);
+  }
+  if (rc != SBX_OK) {
+    writer->closed = 1;
+    sbx_audio_writer_destroy(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+int
+sbx_audio_writer_close(SbxAudioWriter *writer) {
+  if (!writer || writer->closed) return SBX_OK;
+  writer->closed = 1;
+
+  if (writer->mp3_gfp) {
+    int rv;
+    if (sbx_audio_writer_ensure_mp3_buf(writer, 4096) != SBX_OK)
+      return SBX_ENOMEM;
+    rv = writer->lame_encode_flush_fn(writer->mp3_gfp, writer->mp3_buf, writer->mp3_buflen);
+    if (rv < 0) {
+      writer_set_error(writer, "MP3 encoder flush failed with error code %d", rv);
+      return SBX_ENOTREADY;
+    }
+    if (rv > 0 &&
+        (!writer->fp ||
+         fwrite(writer->mp3_buf, 1, (size_t)rv, writer->fp) != (size_t)rv)) {
+      writer_set_error(writer, "Failed to write MP3 output bytes");
+      return SBX_ENOTREADY;
+    }
+    writer->bytes_written += (uint64_t)(rv > 0 ? rv : 0);
+    writer->lame_close_fn(writer->mp3_gfp);
+    writer->mp3_gfp = 0;
+  }
+
+  if (writer->snd) {
+    if (writer->sf_close_fn(writer->snd) != 0) {
+      writer_set_error(writer, "%s close failed", sbx_audio_file_format_name(writer->cfg.format));
+      writer->snd = 0;
+      sbx_dlib_close(writer->lib);
+      writer->lib = 0;
+      return SBX_ENOTREADY;
+    }
+    writer->snd = 0;
+  }
+  sbx_dlib_close(writer->lib);
+  writer->lib = 0;
+
+  if (writer->fp) {
+    if (writer->cfg.format == SBX_AUDIO_FILE_WAV) {
+      uint32_t data_bytes = writer->bytes_written > 0xFFFFFFD7ULL
+        ? 0xFFFFFFD7u : (uint32_t)writer->bytes_written;
+      if (sbx_audio_writer_write_wav_header(writer->fp,
+                                            (uint32_t)(writer->cfg.sample_rate + 0.5),
+                                            writer->cfg.channels,
+                                            writer->cfg.pcm_bits,
+                                            data_bytes) != SBX_OK) {
+        writer_set_error(writer, "Failed to finalize WAV header");
+        fclose(writer->fp);
+        writer->fp = 0;
+        return SBX_ENOTREADY;
+      }
+    }
+    if (fclose(writer->fp) != 0) {
+      writer_set_error(writer, "Failed to close output file");
+      writer->fp = 0;
+      return SBX_ENOTREADY;
+    }
+    writer->fp = 0;
+  }
+
+  return SBX_OK;
+}
+
+void
+sbx_audio_writer_destroy(SbxAudioWriter *writer) {
+  if (!writer) return;
+  sbx_audio_writer_close(writer);
+  if (writer->mp3_gfp && writer->lame_close_fn)
+    writer->lame_close_fn(writer->mp3_gfp);
+  free(writer->mp3_buf);
+  if (writer->snd && writer->sf_close_fn)
+    writer->sf_close_fn(writer->snd);
+  if (writer->fp)
+    fclose(writer->fp);
+  sbx_dlib_close(writer->lib);
+  free(writer);
+}
+
+const char *
+sbx_audio_writer_last_error(const SbxAudioWriter *writer) {
+  if (!writer) return "null writer";
+  if (!writer->last_error[0]) return "";
+  return writer->last_error;
+}
+
+int
+sbx_audio_writer_frame_bytes(const SbxAudioWriter *writer) {
+  if (!writer) return 0;
+  if (writer->input_mode == SBX_AUDIO_WRITER_INPUT_F32) return 8;
+  if (writer->cfg.format == SBX_AUDIO_FILE_FLAC && writer->cfg.pcm_bits == 24) return 6;
+  return writer->cfg.channels * (writer->cfg.pcm_bits / 8);
+}
+
+int
+sbx_audio_writer_input_mode(const SbxAudioWriter *writer) {
+  if (!writer) return SBX_AUDIO_WRITER_INPUT_BYTES;
+  return writer->input_mode;
+}
+
+int
+sbx_audio_writer_write_bytes(SbxAudioWriter *writer, const void *buf, size_t byte_count) {
+  if (!writer || !buf) return SBX_EINVAL;
+  if (writer->cfg.format != SBX_AUDIO_FILE_RAW && writer->cfg.format != SBX_AUDIO_FILE_WAV) {
+    writer_set_error(writer, "byte writes are only valid for raw/WAV outputs");
+    return SBX_EINVAL;
+  }
+  if (!writer->fp) {
+    writer_set_error(writer, "output file is not open");
+    return SBX_ENOTREADY;
+  }
+  if (byte_count && fwrite(buf, 1, byte_count, writer->fp) != byte_count) {
+    writer_set_error(writer, "Failed to write output bytes");
+    return SBX_ENOTREADY;
+  }
+  writer->bytes_written += byte_count;
+  return SBX_OK;
+}
+
+int
+sbx_audio_writer_write_s16(SbxAudioWriter *writer,
+                           const int16_t *pcm,
+                           size_t frame_count) {
+  sf_count_t wr;
+  if (!writer || !pcm) return SBX_EINVAL;
+  if (writer->cfg.format == SBX_AUDIO_FILE_MP3) {
+    int rv;
+    if (!writer->mp3_gfp || !writer->lame_encode_buffer_interleaved_fn) {
+      writer_set_error(writer, "PCM16 MP3 writer is not ready");
+      return SBX_ENOTREADY;
+    }
+    if (sbx_audio_writer_ensure_mp3_buf(writer, (int)frame_count) != SBX_OK)
+      return SBX_ENOMEM;
+    rv = writer->lame_encode_buffer_interleaved_fn(writer->mp3_gfp,
+                                                   (short int *)pcm,
+                                                   (int)frame_count,
+                                                   writer->mp3_buf,
+                                                   writer->mp3_buflen);
+    if (rv < 0) {
+      writer_set_error(writer, "MP3 encoding failed with error code %d", rv);
+      return SBX_ENOTREADY;
+    }
+    if (rv > 0 &&
+        (!writer->fp ||
+         fwrite(writer->mp3_buf, 1, (size_t)rv, writer->fp) != (size_t)rv)) {
+      writer_set_error(writer, "Failed to write MP3 output bytes");
+      return SBX_ENOTREADY;
+    }
+    writer->bytes_written += (uint64_t)(rv > 0 ? rv : 0);
+    return SBX_OK;
+  }
+  if (!writer->snd || !writer->sf_writef_short_fn) {
+    writer_set_error(writer, "PCM16 writer is not ready");
+    return SBX_ENOTREADY;
+  }
+  wr = writer->sf_writef_short_fn(writer->snd, (const short *)pcm, (sf_count_t)frame_count);
+  if (wr != (sf_count_t)frame_count) {
+    writer_set_error(writer, "%s encoding failed while writing PCM16 frames",
+                     sbx_audio_file_format_name(writer->cfg.format));
+    return SBX_ENOTREADY;
+  }
+  return SBX_OK;
+}
+
+int
+sbx_audio_writer_write_f32(SbxAudioWriter *writer,
+                           const float *pcm,
+                           size_t frame_count) {
+  sf_count_t wr;
+  if (!writer || !pcm) return SBX_EINVAL;
+  if (writer->cfg.format == SBX_AUDIO_FILE_MP3) {
+    int rv;
+    if (!writer->mp3_gfp || !writer->lame_encode_buffer_interleaved_ieee_float_fn) {
+      writer_set_error(writer, "float MP3 writer is not ready");
+      return SBX_ENOTREADY;
+    }
+    if (sbx_audio_writer_ensure_mp3_buf(writer, (int)frame_count) != SBX_OK)
+      return SBX_ENOMEM;
+    rv = writer->lame_encode_buffer_interleaved_ieee_float_fn(writer->mp3_gfp,
+                                                              (float *)pcm,
+                                                              (int)frame_count,
+                                                              writer->mp3_buf,
+                                                              writer->mp3_buflen);
+    if (rv < 0) {
+      writer_set_error(writer, "MP3 float encoding failed with error code %d", rv);
+      return SBX_ENOTREADY;
+    }
+    if (rv > 0 &&
+        (!writer->fp ||
+         fwrite(writer->mp3_buf, 1, (size_t)rv, writer->fp) != (size_t)rv)) {
+      writer_set_error(writer, "Failed to write MP3 output bytes");
+      return SBX_ENOTREADY;
+    }
+    writer->bytes_written += (uint64_t)(rv > 0 ? rv : 0);
+    return SBX_OK;
+  }
+  if (!writer->snd || !writer->sf_writef_float_fn) {
+    writer_set_error(writer, "float writer is not ready");
+    return SBX_ENOTREADY;
+  }
+  wr = writer->sf_writef_float_fn(writer->snd, pcm, (sf_count_t)frame_count);
+  if (wr != (sf_count_t)frame_count) {
+    writer_set_error(writer, "%s encoding failed while writing float frames",
+                     sbx_audio_file_format_name(writer->cfg.format));
+    return SBX_ENOTREADY;
+  }
+  return SBX_OK;
+}
+
+int
+sbx_audio_writer_write_i32(SbxAudioWriter *writer,
+                           const int32_t *pcm,
+                           size_t frame_count) {
+  sf_count_t wr;
+  if (!writer || !pcm) return SBX_EINVAL;
+  if (!writer->snd || !writer->sf_writef_int_fn) {
+    writer_set_error(writer, "PCM32 writer is not ready");
+    return SBX_ENOTREADY;
+  }
+  wr = writer->sf_writef_int_fn(writer->snd, (const int *)pcm, (sf_count_t)frame_count);
+  if (wr != (sf_count_t)frame_count) {
+    writer_set_error(writer, "%s encoding failed while writing PCM32 frames",
+                     sbx_audio_file_format_name(writer->cfg.format));
+    return SBX_ENOTREADY;
+  }
+  return SBX_OK;
+}
+
+SbxMixInput *
+sbx_mix_input_create_stdio(FILE *stream,
+                           const char *path_hint,
+                           const SbxMixInputConfig *cfg_in) {
+  SbxMixInput *input;
+  SbxMixInputConfig cfg;
+  const char *ext = 0;
+  const char *dot = 0;
+  const char *slash = 0;
+  const char *bslash = 0;
+  jmp_buf env;
+  int a;
+  char lower[8];
+
+  if (!stream) return 0;
+  sbx_default_mix_input_config(&cfg);
+  if (cfg_in) cfg = *cfg_in;
+
+  input = (SbxMixInput *)calloc(1, sizeof(*input));
+  if (!input) return 0;
+  input->fp = stream;
+  input->mix_section = cfg.mix_section;
+  input->output_rate_hz = cfg.output_rate_hz;
+  input->output_rate_is_default = cfg.output_rate_is_default ? 1 : 0;
+  input->take_stream_ownership = cfg.take_stream_ownership ? 1 : 0;
+  input->warn_cb = cfg.warn_cb;
+  input->warn_user = cfg.warn_user;
+  input->format = SBX_MIX_INPUT_RAW;
+  if (path_hint && *path_hint) {
+    input->path_hint = strdup(path_hint);
+    if (!input->path_hint) {
+      free(input);
+      return 0;
+    }
+  }
+  if (cfg.looper_spec_override && cfg.looper_spec_override[0]) {
+    input->looper_spec_override = strdup(cfg.looper_spec_override);
+    if (!input->looper_spec_override) {
+      if (input->path_hint) free(input->path_hint);
+      free(input);
+      return 0;
+    }
+  }
+
+  if (path_hint && *path_hint) {
+    dot = strrchr(path_hint, '.');
+    slash = strrchr(path_hint, '/');
+    bslash = strrchr(path_hint, '\\');
+    if (dot && (!slash || dot > slash) && (!bslash || dot > bslash) && dot[1])
+      ext = dot + 1;
+  }
+
+  sbx_mix_input_activate(input);
+  sbx_mix_registered_read = 0;
+  sbx_mix_jmp_env = &env;
+
+  if (setjmp(env) != 0) {
+    sbx_mix_jmp_env = 0;
+    sbx_mix_registered_read = 0;
+    sbx_mix_input_sync_back(input);
+    return input;
+  }
+
+  if (ext) {
+    int len = (int)strlen(ext);
+    if (len >= (int)sizeof(lower))
+      len = (int)sizeof(lower) - 1;
+    for (a = 0; a < len; a++)
+      lower[a] = (char)tolower((unsigned char)ext[a]);
+    lower[len] = 0;
+    ext = lower;
+  }
+
+  if (ext && strcmp(ext, "wav") == 0) {
+    input->format = sbx_mix_input_find_wav_data_start(input)
+      ? SBX_MIX_INPUT_WAV : SBX_MIX_INPUT_RAW;
+    input->read_fn = sbx_mix_input_raw_read;
+    sbx_mix_input_activate(input);
+  } else if (ext && strcmp(ext, "ogg") == 0) {
+#ifdef OGG_DECODE
+    ogg_init();
+    input->format = SBX_MIX_INPUT_OGG;
+    input->read_fn = sbx_mix_registered_read;
+    input->term_fn = ogg_term;
+#else
+    mix_input_set_error(input, "Ogg mix-input support was not compiled into this sbagenxlib build");
+#endif
+  } else if (ext && strcmp(ext, "mp3") == 0) {
+#ifdef MP3_DECODE
+    mp3_init();
+    input->format = SBX_MIX_INPUT_MP3;
+    input->read_fn = sbx_mix_registered_read;
+    input->term_fn = mp3_term;
+#else
+    mix_input_set_error(input, "MP3 mix-input support was not compiled into this sbagenxlib build");
+#endif
+  } else if (ext && strcmp(ext, "flac") == 0) {
+#ifdef FLAC_DECODE
+    flac_init();
+    input->format = SBX_MIX_INPUT_FLAC;
+    input->read_fn = sbx_mix_registered_read;
+    input->term_fn = sbx_flac_term;
+#else
+    mix_input_set_error(input, "FLAC mix-input support was not compiled into this sbagenxlib build");
+#endif
+  } else {
+    input->format = SBX_MIX_INPUT_RAW;
+    input->read_fn = sbx_mix_input_raw_read;
+    sbx_mix_input_activate(input);
+  }
+
+  if (input->looper_spec_override && input->looper_spec_override[0] &&
+      input->format != SBX_MIX_INPUT_OGG &&
+      input->format != SBX_MIX_INPUT_MP3 &&
+      input->format != SBX_MIX_INPUT_FLAC &&
+      !input->last_error[0]) {
+    mix_input_set_error(
+      input,
+      "SBAGEN_LOOPER override is currently supported only for OGG, MP3 and FLAC mix inputs"
+    );
+  }
+
+  if (!input->read_fn && !input->last_error[0])
+    mix_input_set_error(input, "Unsupported or unavailable mix input format");
+
+  sbx_mix_input_sync_back(input);
+  sbx_mix_jmp_env = 0;
+  sbx_mix_registered_read = 0;
+  return input;
+}
+
+int
+sbx_mix_input_read(SbxMixInput *input, int *dst, int sample_count) {
+  jmp_buf env;
+  int rv;
+
+  if (!input || !dst || sample_count < 0) return -1;
+  if (!input->read_fn) {
+    if (!input->last_error[0])
+      mix_input_set_error(input, "mix input is not initialized");
+    return -1;
+  }
+
+  input->last_error[0] = 0;
   sbx_mix_input_activate(input);
   sbx_mix_jmp_env = &env;
   if (setjmp(env) != 0) {
@@ -8981,1531 +11458,4143 @@ sbx_mix_input_read(SbxMixInput *input, int *dst, int sample_count) {
     sbx_mix_input_sync_back(input);
     return -1;
   }
-  rv = input->read_fn(dst, sample_count);
-  sbx_mix_input_sync_back(input);
-  sbx_mix_jmp_env = 0;
-  return rv;
+  rv = input->read_fn(dst, sample_count);
+  sbx_mix_input_sync_back(input);
+  sbx_mix_jmp_env = 0;
+  return rv;
+}
+
+void
+sbx_mix_input_destroy(SbxMixInput *input) {
+  if (!input) return;
+  sbx_mix_input_activate(input);
+  if (input->term_fn)
+    input->term_fn();
+  sbx_mix_input_sync_back(input);
+  if (input->take_stream_ownership && input->fp)
+    fclose(input->fp);
+  input->fp = 0;
+  if (input->path_hint) {
+    free(input->path_hint);
+    input->path_hint = 0;
+  }
+  if (input->looper_spec_override) {
+    free(input->looper_spec_override);
+    input->looper_spec_override = 0;
+  }
+  if (input->embedded_looper_spec) {
+    free(input->embedded_looper_spec);
+    input->embedded_looper_spec = 0;
+  }
+  if (sbx_mix_active_input == input)
+    sbx_mix_active_input = 0;
+  free(input);
+}
+
+const char *
+sbx_mix_input_last_error(const SbxMixInput *input) {
+  if (!input) return "null mix input";
+  return input->last_error;
+}
+
+int
+sbx_mix_input_output_rate(const SbxMixInput *input) {
+  if (!input) return 0;
+  return input->output_rate_hz;
+}
+
+int
+sbx_mix_input_output_rate_is_default(const SbxMixInput *input) {
+  if (!input) return 0;
+  return input->output_rate_is_default ? 1 : 0;
+}
+
+int
+sbx_mix_input_format(const SbxMixInput *input) {
+  if (!input) return SBX_MIX_INPUT_RAW;
+  return input->format;
+}
+
+const char *
+sbx_mix_input_embedded_looper(const SbxMixInput *input) {
+  if (!input || !input->embedded_looper_spec || !input->embedded_looper_spec[0]) return 0;
+  return input->embedded_looper_spec;
+}
+
+SbxContext *
+sbx_context_create(const SbxEngineConfig *cfg) {
+  SbxContext *ctx = (SbxContext *)calloc(1, sizeof(*ctx));
+  if (!ctx) return NULL;
+
+  ctx->eng = sbx_engine_create(cfg);
+  if (!ctx->eng) {
+    free(ctx);
+    return NULL;
+  }
+  ctx->loaded = 0;
+  ctx->default_waveform = SBX_WAVE_SINE;
+  sbx_default_iso_envelope_spec(&ctx->seq_iso_env);
+  sbx_default_mixam_envelope_spec(&ctx->seq_mixam_env);
+  ctx->source_mode = SBX_CTX_SRC_NONE;
+  memset(&ctx->kf_store, 0, sizeof(ctx->kf_store));
+  ctx->kf_segs = 0;
+  ctx->kf_count = 0;
+  ctx->kf_loop = 0;
+  ctx->kf_seg = 0;
+  ctx->kf_duration_sec = 0.0;
+  ctx->mv_eng = 0;
+  ctx->mv_voice_count = 0;
+  ctx->sbg_stream = 0;
+  sbx_default_tone_spec(&ctx->static_tone);
+  memset(&ctx->curve_tone, 0, sizeof(ctx->curve_tone));
+  ctx->curve_prog = 0;
+  ctx->curve_duration_sec = 0.0;
+  ctx->curve_loop = 0;
+  ctx->t_sec = 0.0;
+  ctx->aux_tones = 0;
+  ctx->aux_eng = 0;
+  ctx->aux_count = 0;
+  ctx->aux_buf = 0;
+  ctx->aux_buf_cap = 0;
+  ctx->mix_fx = 0;
+  ctx->mix_fx_count = 0;
+  ctx->sbg_mix_fx_kf = 0;
+  ctx->sbg_mix_fx_kf_count = 0;
+  ctx->sbg_mix_fx_slots = 0;
+  ctx->sbg_mix_fx_seg = 0;
+  ctx->sbg_mix_fx_state = 0;
+  ctx->mix_kf = 0;
+  ctx->mix_kf_count = 0;
+  ctx->mix_kf_seg = 0;
+  ctx->mix_default_amp_pct = 100.0;
+  sbx_default_mix_mod_spec(&ctx->mix_mod);
+  sbx_default_amp_adjust_spec(&ctx->amp_adjust);
+  ctx->have_amp_adjust = 0;
+  ctx->telemetry_cb = 0;
+  ctx->telemetry_user = 0;
+  memset(&ctx->telemetry_last, 0, sizeof(ctx->telemetry_last));
+  ctx->telemetry_valid = 0;
+  ctx_clear_live_controls_internal(ctx);
+  ctx_sync_custom_waves(ctx);
+  set_ctx_error(ctx, NULL);
+  return ctx;
+}
+
+void
+sbx_context_destroy(SbxContext *ctx) {
+  if (!ctx) return;
+  ctx_clear_mix_keyframes(ctx);
+  ctx_clear_sbg_mix_effect_keyframes(ctx);
+  ctx_clear_mix_effects(ctx);
+  ctx_clear_aux_tones(ctx);
+  ctx_clear_keyframes(ctx);
+  ctx_clear_curve_source(ctx);
+  ctx_clear_custom_waves(ctx);
+  sbx_engine_destroy(ctx->eng);
+  free(ctx->ev);
+  free(ctx->telem_ring);
+  free(ctx);
+}
+
+void
+sbx_context_reset(SbxContext *ctx) {
+  if (!ctx || !ctx->eng) return;
+  ctx_reset_runtime(ctx);
+  set_ctx_error(ctx, NULL);
+}
+
+int
+sbx_context_set_tone(SbxContext *ctx, const SbxToneSpec *tone) {
+  int rc;
+  if (!ctx || !ctx->eng || !tone) return SBX_EINVAL;
+
+  rc = engine_apply_tone(ctx->eng, tone, 1);
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, sbx_engine_last_error(ctx->eng));
+    return rc;
+  }
+  ctx_clear_keyframes(ctx);
+  ctx_clear_curve_source(ctx);
+  ctx->static_tone = ctx->eng->tone;
+  ctx->source_mode = SBX_CTX_SRC_STATIC;
+  ctx->loaded = 1;
+  ctx->t_sec = 0.0;
+  ctx_clear_live_controls_internal(ctx);
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+int
+sbx_context_set_default_waveform(SbxContext *ctx, int waveform) {
+  if (!ctx || !ctx->eng) return SBX_EINVAL;
+  if (waveform < SBX_WAVE_SINE || waveform > SBX_WAVE_SAWTOOTH) {
+    set_ctx_error(ctx, "default waveform must be SBX_WAVE_*");
+    return SBX_EINVAL;
+  }
+  ctx->default_waveform = waveform;
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+int
+sbx_context_set_sequence_iso_override(SbxContext *ctx, const SbxIsoEnvelopeSpec *spec) {
+  if (!ctx || !ctx->eng) return SBX_EINVAL;
+  if (!spec) {
+    ctx->have_seq_iso_override = 0;
+    set_ctx_error(ctx, NULL);
+    return SBX_OK;
+  }
+  if (!isfinite(spec->start) || spec->start < 0.0 || spec->start > 1.0 ||
+      !isfinite(spec->duty) || spec->duty < 0.0 || spec->duty > 1.0 ||
+      !isfinite(spec->attack) || spec->attack < 0.0 || spec->attack > 1.0 ||
+      !isfinite(spec->release) || spec->release < 0.0 || spec->release > 1.0 ||
+      (spec->attack + spec->release) > (1.0 + 1e-12) ||
+      spec->edge_mode < 0 || spec->edge_mode > 3) {
+    set_ctx_error(ctx, "sequence iso override is invalid");
+    return SBX_EINVAL;
+  }
+  ctx->seq_iso_env = *spec;
+  ctx->have_seq_iso_override = 1;
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+int
+sbx_context_set_sequence_mixam_override(SbxContext *ctx, const SbxMixFxSpec *spec) {
+  if (!ctx || !ctx->eng) return SBX_EINVAL;
+  if (!spec) {
+    ctx->have_seq_mixam_override = 0;
+    set_ctx_error(ctx, NULL);
+    return SBX_OK;
+  }
+  if (spec->type != SBX_MIXFX_AM || sbx_validate_mixam_fields(spec) != SBX_OK) {
+    set_ctx_error(ctx, "sequence mixam override is invalid");
+    return SBX_EINVAL;
+  }
+  ctx->seq_mixam_env = *spec;
+  ctx->have_seq_mixam_override = 1;
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+int
+sbx_context_load_tone_spec(SbxContext *ctx, const char *tone_spec) {
+  SbxToneSpec tone;
+  int rc;
+
+  if (!ctx || !ctx->eng || !tone_spec) return SBX_EINVAL;
+
+  rc = parse_tone_spec_with_default_waveform(tone_spec, ctx->default_waveform, &tone);
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, "invalid tone spec");
+    return rc;
+  }
+  return sbx_context_set_tone(ctx, &tone);
+}
+
+int
+sbx_context_load_curve_program(SbxContext *ctx,
+                               SbxCurveProgram *curve,
+                               const SbxCurveSourceConfig *cfg) {
+  SbxCurveSourceConfig local_cfg;
+  SbxToneSpec tone;
+  SbxCurveEvalPoint pt;
+  char err[160];
+  int rc;
+
+  if (!ctx || !ctx->eng || !curve) return SBX_EINVAL;
+
+  sbx_default_curve_source_config(&local_cfg);
+  if (cfg) local_cfg = *cfg;
+  if (!curve->prepared) {
+    set_ctx_error(ctx, "curve program must be prepared before loading into context");
+    return SBX_EINVAL;
+  }
+  if (!(local_cfg.duration_sec > 0.0) || !isfinite(local_cfg.duration_sec)) {
+    set_ctx_error(ctx, "curve source duration_sec must be finite and > 0");
+    return SBX_EINVAL;
+  }
+  if (local_cfg.waveform < SBX_WAVE_SINE || local_cfg.waveform > SBX_WAVE_SAWTOOTH) {
+    set_ctx_error(ctx, "curve source waveform must be SBX_WAVE_*");
+    return SBX_EINVAL;
+  }
+  if (local_cfg.mode != SBX_TONE_BINAURAL &&
+      local_cfg.mode != SBX_TONE_MONAURAL &&
+      local_cfg.mode != SBX_TONE_ISOCHRONIC) {
+    set_ctx_error(ctx, "curve source mode must be binaural, monaural, or isochronic");
+    return SBX_EINVAL;
+  }
+  if (!isfinite(local_cfg.amplitude) || local_cfg.amplitude < 0.0) {
+    set_ctx_error(ctx, "curve source amplitude must be finite and >= 0");
+    return SBX_EINVAL;
+  }
+  if (local_cfg.mode == SBX_TONE_ISOCHRONIC) {
+    if (!isfinite(local_cfg.duty_cycle) || local_cfg.duty_cycle < 0.0 || local_cfg.duty_cycle > 1.0) {
+      set_ctx_error(ctx, "curve source duty_cycle must be in [0,1]");
+      return SBX_EINVAL;
+    }
+    if (!isfinite(local_cfg.iso_start) || local_cfg.iso_start < 0.0 || local_cfg.iso_start > 1.0) {
+      set_ctx_error(ctx, "curve source iso_start must be in [0,1]");
+      return SBX_EINVAL;
+    }
+    if (!isfinite(local_cfg.iso_attack) || local_cfg.iso_attack < 0.0 || local_cfg.iso_attack > 1.0) {
+      set_ctx_error(ctx, "curve source iso_attack must be in [0,1]");
+      return SBX_EINVAL;
+    }
+    if (!isfinite(local_cfg.iso_release) || local_cfg.iso_release < 0.0 || local_cfg.iso_release > 1.0) {
+      set_ctx_error(ctx, "curve source iso_release must be in [0,1]");
+      return SBX_EINVAL;
+    }
+    if ((local_cfg.iso_attack + local_cfg.iso_release) > (1.0 + 1e-12)) {
+      set_ctx_error(ctx, "curve source iso_attack + iso_release must be <= 1");
+      return SBX_EINVAL;
+    }
+    if (local_cfg.iso_edge_mode < 0 || local_cfg.iso_edge_mode > 3) {
+      set_ctx_error(ctx, "curve source iso_edge_mode must be 0..3");
+      return SBX_EINVAL;
+    }
+  }
+
+  sbx_default_tone_spec(&tone);
+  tone.mode = local_cfg.mode;
+  tone.waveform = local_cfg.waveform;
+  tone.duty_cycle = local_cfg.duty_cycle;
+  tone.iso_start = local_cfg.iso_start;
+  tone.iso_attack = local_cfg.iso_attack;
+  tone.iso_release = local_cfg.iso_release;
+  tone.iso_edge_mode = local_cfg.iso_edge_mode;
+  tone.amplitude = local_cfg.amplitude;
+
+  rc = sbx_curve_eval(curve, 0.0, &pt);
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, sbx_curve_last_error(curve));
+    return rc;
+  }
+  tone.carrier_hz = pt.carrier_hz;
+  tone.beat_hz = pt.beat_hz;
+  tone.amplitude = tone.amplitude * (pt.beat_amp_pct / 100.0);
+  if (tone.mode == SBX_TONE_MONAURAL || tone.mode == SBX_TONE_ISOCHRONIC)
+    tone.beat_hz = fabs(tone.beat_hz);
+
+  rc = normalize_tone(&tone, err, sizeof(err));
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, err);
+    return rc;
+  }
+  rc = engine_apply_tone(ctx->eng, &tone, 1);
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, sbx_engine_last_error(ctx->eng));
+    return rc;
+  }
+
+  ctx_clear_keyframes(ctx);
+  ctx_clear_curve_source(ctx);
+  ctx->curve_prog = curve;
+  tone.amplitude = local_cfg.amplitude;
+  ctx->curve_tone = tone;
+  ctx->curve_duration_sec = local_cfg.duration_sec;
+  ctx->curve_loop = local_cfg.loop ? 1 : 0;
+  ctx->source_mode = SBX_CTX_SRC_CURVE;
+  ctx->loaded = 1;
+  ctx->t_sec = 0.0;
+  ctx_clear_live_controls_internal(ctx);
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+static int
+ctx_activate_builtin_source(SbxContext *ctx, SbxBuiltinSource *src) {
+  SbxToneSpec tone;
+  char err[160];
+  int rc;
+
+  src->tone.carrier_hz = src->c0;
+  src->tone.beat_hz = src->b0;
+  src->tone.amplitude = src->a0;
+  rc = normalize_tone(&src->tone, err, sizeof(err));
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, err);
+    return rc;
+  }
+  tone = src->tone;
+  rc = engine_apply_tone(ctx->eng, &tone, 1);
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, sbx_engine_last_error(ctx->eng));
+    return rc;
+  }
+
+  ctx_clear_keyframes(ctx);
+  ctx_clear_curve_source(ctx);
+  ctx->builtin_src = *src;
+  ctx->source_mode = SBX_CTX_SRC_BUILTIN;
+  ctx->loaded = 1;
+  ctx->t_sec = 0.0;
+  ctx_clear_live_controls_internal(ctx);
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+static void
+sbx_bsrc_init_drop_like(SbxBuiltinSource *src,
+                        int kind,
+                        const SbxToneSpec *start_tone,
+                        double carrier_end_hz,
+                        double beat_target_hz,
+                        int drop_sec,
+                        int hold_sec,
+                        int wake_sec,
+                        int slide,
+                        int step_len_sec,
+                        double fade_sec) {
+  memset(src, 0, sizeof(*src));
+  src->kind = kind;
+  src->slide = slide ? 1 : 0;
+  src->tone = *start_tone;
+  src->c0 = start_tone->carrier_hz;
+  src->c1 = carrier_end_hz;
+  src->b0 = start_tone->beat_hz;
+  src->b1 = beat_target_hz;
+  src->a0 = start_tone->amplitude;
+  src->drop_sec = drop_sec;
+  src->main_sec = (double)(drop_sec + hold_sec);
+  src->wake_sec = (double)wake_sec;
+  src->fade_sec = fade_sec;
+  src->step_sec = (double)step_len_sec;
+  src->n_step = 1 + (drop_sec - 1) / step_len_sec;
+  if (src->n_step < 2) src->n_step = 2;
+  src->step_count = (drop_sec + hold_sec) / step_len_sec;
+  src->drop_k = log(beat_target_hz / src->b0);
+}
+
+int
+sbx_context_load_builtin_drop(SbxContext *ctx, const SbxBuiltinDropConfig *cfg) {
+  SbxBuiltinSource src;
+
+  if (!ctx || !ctx->eng || !cfg) return SBX_EINVAL;
+  if (sbx_validate_builtin_drop_like(&cfg->start_tone,
+                                     cfg->carrier_end_hz,
+                                     cfg->beat_target_hz,
+                                     cfg->drop_sec,
+                                     cfg->hold_sec,
+                                     cfg->wake_sec,
+                                     cfg->step_len_sec,
+                                     cfg->fade_sec) != SBX_OK) {
+    set_ctx_error(ctx, "invalid built-in drop configuration");
+    return SBX_EINVAL;
+  }
+  sbx_bsrc_init_drop_like(&src, SBX_BUILTIN_SRC_DROP, &cfg->start_tone,
+                          cfg->carrier_end_hz, cfg->beat_target_hz,
+                          cfg->drop_sec, cfg->hold_sec, cfg->wake_sec,
+                          cfg->slide, cfg->step_len_sec, cfg->fade_sec);
+  return ctx_activate_builtin_source(ctx, &src);
+}
+
+int
+sbx_context_load_builtin_sigmoid(SbxContext *ctx, const SbxBuiltinSigmoidConfig *cfg) {
+  SbxBuiltinSource src;
+  double sig_a, sig_b;
+
+  if (!ctx || !ctx->eng || !cfg) return SBX_EINVAL;
+  if (sbx_validate_builtin_drop_like(&cfg->start_tone,
+                                     cfg->carrier_end_hz,
+                                     cfg->beat_target_hz,
+                                     cfg->drop_sec,
+                                     cfg->hold_sec,
+                                     cfg->wake_sec,
+                                     cfg->step_len_sec,
+                                     cfg->fade_sec) != SBX_OK ||
+      sbx_compute_sigmoid_coefficients(cfg->drop_sec,
+                                       cfg->start_tone.beat_hz,
+                                       cfg->beat_target_hz,
+                                       cfg->sig_l,
+                                       cfg->sig_h,
+                                       &sig_a,
+                                       &sig_b) != SBX_OK) {
+    set_ctx_error(ctx, "invalid built-in sigmoid configuration");
+    return SBX_EINVAL;
+  }
+  sbx_bsrc_init_drop_like(&src, SBX_BUILTIN_SRC_SIGMOID, &cfg->start_tone,
+                          cfg->carrier_end_hz, cfg->beat_target_hz,
+                          cfg->drop_sec, cfg->hold_sec, cfg->wake_sec,
+                          cfg->slide, cfg->step_len_sec, cfg->fade_sec);
+  src.sig_l = cfg->sig_l;
+  src.sig_h = cfg->sig_h;
+  src.sig_a = sig_a;
+  src.sig_b = sig_b;
+  return ctx_activate_builtin_source(ctx, &src);
+}
+
+int
+sbx_context_load_builtin_slide(SbxContext *ctx, const SbxBuiltinSlideConfig *cfg) {
+  SbxBuiltinSource src;
+
+  if (!ctx || !ctx->eng || !cfg) return SBX_EINVAL;
+  if (!sbx_builtin_supported_mode(cfg->start_tone.mode) ||
+      !(cfg->start_tone.carrier_hz >= 0.0) || !isfinite(cfg->start_tone.carrier_hz) ||
+      !(cfg->carrier_end_hz >= 0.0) || !isfinite(cfg->carrier_end_hz) ||
+      cfg->slide_sec <= 0 || cfg->fade_sec < 0 ||
+      !isfinite(cfg->start_tone.beat_hz) || cfg->start_tone.beat_hz == 0.0 ||
+      !(cfg->start_tone.amplitude >= 0.0) || !isfinite(cfg->start_tone.amplitude)) {
+    set_ctx_error(ctx, "invalid built-in slide configuration");
+    return SBX_EINVAL;
+  }
+  memset(&src, 0, sizeof(src));
+  src.kind = SBX_BUILTIN_SRC_SLIDE;
+  src.slide = 1;
+  src.tone = cfg->start_tone;
+  src.c0 = cfg->start_tone.carrier_hz;
+  src.c1 = cfg->carrier_end_hz;
+  src.b0 = src.b1 = cfg->start_tone.beat_hz;
+  src.a0 = cfg->start_tone.amplitude;
+  src.main_sec = (double)cfg->slide_sec;
+  src.fade_sec = cfg->fade_sec;
+  return ctx_activate_builtin_source(ctx, &src);
+}
+
+int
+sbx_context_load_keyframes(SbxContext *ctx,
+                           const SbxProgramKeyframe *frames,
+                           size_t frame_count,
+                           int loop) {
+  return ctx_activate_keyframes_internal(ctx, frames, frame_count, frames, 1, 0, loop);
+}
+
+int
+sbx_context_load_sequence_text(SbxContext *ctx, const char *text, int loop) {
+  char *buf = 0, *line = 0;
+  const char *cursor = text;
+  size_t buf_cap = 0;
+  size_t line_no = 0;
+  SbxProgramKeyframe *frames = 0;
+  size_t count = 0, cap = 0;
+  int rc = SBX_OK;
+
+  if (!ctx || !ctx->eng || !text) return SBX_EINVAL;
+
+  while (*cursor) {
+    char *p, *q;
+    char *time_tok;
+    char *tone_tok;
+    char *interp_tok = 0;
+    int interp = SBX_INTERP_LINEAR;
+    double tsec;
+    SbxToneSpec tone;
+
+    line_no++;
+    if (sbx_text_next_line(&cursor, &buf, &buf_cap, 0) != SBX_OK) {
+      set_ctx_error(ctx, "out of memory");
+      rc = SBX_ENOMEM;
+      goto done;
+    }
+    line = buf;
+
+    if (line[0] && line[strlen(line) - 1] == '\r')
+      line[strlen(line) - 1] = 0;
+
+    strip_inline_comment(line);
+    rstrip_inplace(line);
+    p = (char *)skip_ws(line);
+    if (*p == 0) {
+      continue;
+    }
+
+    q = p;
+    while (*q && !isspace((unsigned char)*q)) q++;
+    if (*q == 0) {
+      char emsg[192];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: expected '<time> <tone-spec>'",
+               (unsigned long)line_no);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      goto done;
+    }
+    *q++ = 0;
+    q = (char *)skip_ws(q);
+    if (*q == 0) {
+      char emsg[192];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: missing tone-spec",
+               (unsigned long)line_no);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      goto done;
+    }
+
+    time_tok = p;
+    tone_tok = q;
+
+    {
+      char *r = q;
+      while (*r && !isspace((unsigned char)*r)) r++;
+      if (*r) {
+        *r++ = 0;
+        r = (char *)skip_ws(r);
+        if (*r) {
+          interp_tok = r;
+          while (*r && !isspace((unsigned char)*r)) r++;
+          if (*r) {
+            *r++ = 0;
+            r = (char *)skip_ws(r);
+            if (*r) {
+              char emsg[224];
+              snprintf(emsg, sizeof(emsg),
+                       "line %lu: unexpected trailing token '%s'",
+                       (unsigned long)line_no, r);
+              set_ctx_error_range_span(ctx, emsg, line_no, line, r, strlen(r));
+              rc = SBX_EINVAL;
+              goto done;
+            }
+          }
+        }
+      }
+    }
+
+    rc = parse_time_seconds_token(time_tok, &tsec);
+    if (rc != SBX_OK) {
+      char emsg[224];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: invalid time token '%s' (use s/m/h suffix or seconds default)",
+               (unsigned long)line_no, time_tok);
+      set_ctx_error_token_span(ctx, emsg, line_no, line, time_tok);
+      rc = SBX_EINVAL;
+      goto done;
+    }
+
+    rc = parse_tone_spec_with_default_waveform(tone_tok, ctx->default_waveform, &tone);
+    if (rc != SBX_OK) {
+      char emsg[224];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: invalid tone-spec '%s'",
+               (unsigned long)line_no, tone_tok);
+      set_ctx_error_token_span(ctx, emsg, line_no, line, tone_tok);
+      rc = SBX_EINVAL;
+      goto done;
+    }
+    sbx_apply_sequence_iso_override(&tone, ctx);
+
+    if (interp_tok) {
+      rc = parse_interp_mode_token(interp_tok, &interp);
+      if (rc != SBX_OK) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: invalid interpolation token '%s' (use linear|ramp|step|hold)",
+                 (unsigned long)line_no, interp_tok);
+        set_ctx_error_token_span(ctx, emsg, line_no, line, interp_tok);
+        rc = SBX_EINVAL;
+        goto done;
+      }
+    }
+
+    if (count == cap) {
+      size_t ncap = cap ? (cap * 2) : 8;
+      SbxProgramKeyframe *tmp;
+      tmp = (SbxProgramKeyframe *)realloc(frames, ncap * sizeof(*frames));
+      if (!tmp) {
+        set_ctx_error(ctx, "out of memory");
+        rc = SBX_ENOMEM;
+        goto done;
+      }
+      frames = tmp;
+      cap = ncap;
+    }
+
+    frames[count].time_sec = tsec;
+    frames[count].tone = tone;
+    frames[count].interp = interp;
+    count++;
+  }
+
+  if (count == 0) {
+    set_ctx_error(ctx, "sequence text contains no keyframes");
+    rc = SBX_EINVAL;
+    goto done;
+  }
+
+  rc = sbx_context_load_keyframes(ctx, frames, count, loop);
+
+done:
+  if (frames) free(frames);
+  if (buf) free(buf);
+  return rc;
+}
+
+int
+sbx_context_load_sequence_file(SbxContext *ctx, const char *path, int loop) {
+  SbxTextFile tf;
+  int rc = SBX_OK;
+
+  if (!ctx || !ctx->eng || !path) return SBX_EINVAL;
+
+  rc = sbx_text_file_open(path, &tf);
+  if (rc == SBX_EINVAL) {
+    char emsg[256];
+    snprintf(emsg, sizeof(emsg), "cannot open sequence file: %s", path);
+    set_ctx_error(ctx, emsg);
+    return rc;
+  } else if (rc == SBX_ENOMEM) {
+    set_ctx_error(ctx, "out of memory");
+    return rc;
+  } else if (rc != SBX_OK) {
+    set_ctx_error(ctx, "failed reading sequence file");
+    return rc;
+  }
+
+  rc = sbx_context_load_sequence_text(ctx, tf.text, loop);
+
+  sbx_text_file_close(&tf);
+  return rc;
+}
+
+/*
+ * Parse state of one .sbg timing program. The text loader runs it over the
+ * whole document; the streaming loader feeds it a line at a time and
+ * consumes frames from the front of the queue as playback advances.
+ * Definitions live in arena; per-line token vectors and wave samples come
+ * from scratch, which is reset after every line. The wave-table arrays
+ * are the caller's staging tables.
+ */
+/*
+ * A queued keyframe: its time and an interned body. Identical voice sets
+ * (a named tone-set used many times, repeated block entries) share one
+ * body, and each body holds only its first tone_len tones.
+ */
+typedef struct {
+  double time_sec;
+  const SbxVoiceSetKeyframe *body;
+} SbxSbgQueuedFrame;
+
+typedef struct {
+  SbxContext *ctx;
+  SbxParseArena arena;
+  SbxParseArena scratch;
+  SbxParseArena bodies;             /* queued frame bodies and their hash */
+  const SbxVoiceSetKeyframe **body_hash;
+  size_t body_count, body_hash_cap;
+  SbxSbgQueuedFrame *frames;
+  size_t count, cap;
+  SbxNamedToneDef *defs;
+  size_t ndefs, defs_cap;
+  SbxNamedBlockDef *blocks;
+  size_t nblocks, blocks_cap;
+  SbxNameIndex def_index;
+  SbxNameIndex block_index;
+  double **legacy_env_waves;
+  double **custom_env_waves;
+  double **spin_waves;
+  SbxNoiseProfile **noise_profiles;
+  int *legacy_env_edge_modes;
+  int *custom_env_edge_modes;
+  int *spin_edge_modes;
+  int active_block_idx;
+  double active_block_last_off;
+  double last_abs_sec;
+  double last_emit_sec;
+  size_t max_voice_count;
+  size_t max_mix_fx_slots;
+  int have_mix;
+  size_t line_no;
+} SbxSbgParser;
+
+static void
+sbx_sbg_parser_init(SbxSbgParser *ps,
+                    SbxContext *ctx,
+                    double **legacy_env_waves,
+                    double **custom_env_waves,
+                    double **spin_waves,
+                    SbxNoiseProfile **noise_profiles,
+                    int *legacy_env_edge_modes,
+                    int *custom_env_edge_modes,
+                    int *spin_edge_modes) {
+  size_t i;
+  memset(ps, 0, sizeof(*ps));
+  ps->ctx = ctx;
+  ps->legacy_env_waves = legacy_env_waves;
+  ps->custom_env_waves = custom_env_waves;
+  ps->spin_waves = spin_waves;
+  ps->noise_profiles = noise_profiles;
+  ps->legacy_env_edge_modes = legacy_env_edge_modes;
+  ps->custom_env_edge_modes = custom_env_edge_modes;
+  ps->spin_edge_modes = spin_edge_modes;
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    legacy_env_edge_modes[i] = 1;
+    custom_env_edge_modes[i] = 1;
+    spin_edge_modes[i] = 1;
+  }
+  ps->active_block_idx = -1;
+  ps->active_block_last_off = -1.0;
+  ps->last_abs_sec = -1.0;
+  ps->last_emit_sec = -1.0;
+  ps->max_voice_count = 1;
+}
+
+static void
+sbx_sbg_parser_free(SbxSbgParser *ps) {
+  sbx_parse_arena_free(&ps->scratch);
+  sbx_parse_arena_free(&ps->arena);
+  sbx_parse_arena_free(&ps->bodies);
+}
+
+static unsigned
+sbx_voice_set_frame_hash(const SbxVoiceSetKeyframe *f) {
+  unsigned h = 2166136261u;
+  size_t i;
+  h = (h ^ (unsigned)f->tone_len) * 16777619u;
+  h = (h ^ (unsigned)f->mix_fx_count) * 16777619u;
+  h = (h ^ (unsigned)f->interp) * 16777619u;
+  for (i = 0; i < f->tone_len; i++) {
+    const unsigned char *p = (const unsigned char *)&f->tones[i].carrier_hz;
+    size_t j;
+    h = (h ^ (unsigned)f->tones[i].mode) * 16777619u;
+    for (j = 0; j < sizeof(double); j++) h = (h ^ p[j]) * 16777619u;
+    p = (const unsigned char *)&f->tones[i].beat_hz;
+    for (j = 0; j < sizeof(double); j++) h = (h ^ p[j]) * 16777619u;
+  }
+  return h;
+}
+
+/* Returns the shared body equal to frame, storing a trimmed copy if new. */
+static const SbxVoiceSetKeyframe *
+sbx_sbg_parser_intern(SbxSbgParser *ps, const SbxVoiceSetKeyframe *frame) {
+  const SbxVoiceSetKeyframe *b;
+  SbxVoiceSetKeyframe *nb;
+  size_t mask, slot, size;
+
+  if ((ps->body_count + 1) * 2 > ps->body_hash_cap) {
+    size_t ncap = ps->body_hash_cap ? ps->body_hash_cap * 2 : 64;
+    const SbxVoiceSetKeyframe **nh;
+    size_t i;
+    if (ncap > ((size_t)-1) / sizeof(*nh)) return 0;
+    nh = (const SbxVoiceSetKeyframe **)sbx_parse_arena_alloc(&ps->bodies, ncap * sizeof(*nh));
+    if (!nh) return 0;
+    for (i = 0; i < ps->body_hash_cap; i++) {
+      if (!(b = ps->body_hash[i])) continue;
+      slot = sbx_voice_set_frame_hash(b) & (ncap - 1);
+      while (nh[slot]) slot = (slot + 1) & (ncap - 1);
+      nh[slot] = b;
+    }
+    ps->body_hash = nh;
+    ps->body_hash_cap = ncap;
+  }
+  mask = ps->body_hash_cap - 1;
+  slot = sbx_voice_set_frame_hash(frame) & mask;
+  while ((b = ps->body_hash[slot]) != 0) {
+    if (sbx_voice_set_frame_same(b, frame)) return b;
+    slot = (slot + 1) & mask;
+  }
+  size = SBX_VOICE_SET_BODY_SIZE(frame->tone_len);
+  nb = (SbxVoiceSetKeyframe *)sbx_parse_arena_alloc(&ps->bodies, size);
+  if (!nb) return 0;
+  memcpy(nb, frame, size);
+  nb->time_sec = 0.0;
+  ps->body_hash[slot] = nb;
+  ps->body_count++;
+  return nb;
+}
+
+/* Empties the body store; the queue must be empty or re-interned. */
+static void
+sbx_sbg_parser_reset_bodies(SbxSbgParser *ps) {
+  sbx_parse_arena_reset(&ps->bodies);
+  ps->body_hash = 0;
+  ps->body_count = ps->body_hash_cap = 0;
+}
+
+/*
+ * Rebuilds the body store from the frames still queued, so a streaming
+ * load does not keep every distinct voice set it has ever parsed.
+ */
+static int
+sbx_sbg_parser_compact_bodies(SbxSbgParser *ps) {
+  SbxSbgParser old = *ps;
+  size_t i;
+
+  memset(&ps->bodies, 0, sizeof(ps->bodies));
+  ps->body_hash = 0;
+  ps->body_count = ps->body_hash_cap = 0;
+  /* Build the new store first so the queue is untouched on failure. */
+  for (i = 0; i < ps->count; i++) {
+    if (!sbx_sbg_parser_intern(ps, ps->frames[i].body)) {
+      sbx_parse_arena_free(&ps->bodies);
+      ps->bodies = old.bodies;
+      ps->body_hash = old.body_hash;
+      ps->body_count = old.body_count;
+      ps->body_hash_cap = old.body_hash_cap;
+      return SBX_ENOMEM;
+    }
+  }
+  /* Every body is present now, so these are lookups only. */
+  for (i = 0; i < ps->count; i++)
+    ps->frames[i].body = sbx_sbg_parser_intern(ps, ps->frames[i].body);
+  sbx_parse_arena_free(&old.bodies);
+  return SBX_OK;
+}
+
+/* Queues frame at time tsec (before day-wrap), tracking lane/slot maxima. */
+static int
+sbx_sbg_parser_emit(SbxSbgParser *ps, const SbxVoiceSetKeyframe *frame, double tsec) {
+  SbxSbgQueuedFrame *f;
+  const SbxVoiceSetKeyframe *body = sbx_sbg_parser_intern(ps, frame);
+  if (!body) return SBX_ENOMEM;
+  if (sbx_parse_arena_reserve(&ps->arena, (void **)&ps->frames, &ps->cap, ps->count,
+                              sizeof(*ps->frames)) != SBX_OK)
+    return SBX_ENOMEM;
+  f = &ps->frames[ps->count++];
+  f->body = body;
+  f->time_sec = sbx_monotonic_day_wrap(tsec, ps->last_emit_sec);
+  ps->last_emit_sec = f->time_sec;
+  if (body->tone_len > ps->max_voice_count) ps->max_voice_count = body->tone_len;
+  if (body->mix_fx_count > ps->max_mix_fx_slots) ps->max_mix_fx_slots = body->mix_fx_count;
+  if (body->mix_amp_present) ps->have_mix = 1;
+  return SBX_OK;
+}
+
+/* Parses one line (modified in place; ps->line_no already advanced). */
+static int
+sbx_sbg_parse_line(SbxSbgParser *ps, char *line) {
+  SbxContext *ctx = ps->ctx;
+  char *p, *q, *rest;
+  char *time_tok;
+  int interp = SBX_INTERP_LINEAR;
+  int expanded_block = 0;
+  int is_definition = 0;
+  double tsec;
+  int rc = SBX_OK;
+  SbxVoiceSetKeyframe frame;
+
+  sbx_voice_set_frame_init(&frame);
+
+
+  if (line[0] && line[strlen(line) - 1] == '\r')
+    line[strlen(line) - 1] = 0;
+
+  strip_inline_comment(line);
+  rstrip_inplace(line);
+  p = (char *)skip_ws(line);
+  if (*p == 0) {
+    return SBX_OK;
+  }
+
+  q = p;
+  while (*q && !isspace((unsigned char)*q)) q++;
+  if (*q) {
+    *q++ = 0;
+    rest = (char *)skip_ws(q);
+  } else {
+    rest = q;
+  }
+
+  if (ps->active_block_idx >= 0) {
+    char *time_tok = p;
+    int interp = SBX_INTERP_LINEAR;
+    int transition_style = SBX_SEG_STYLE_SBG_DEFAULT;
+    double off_sec = 0.0;
+    SbxVoiceSetKeyframe blk_frame;
+    SbxNamedBlockDef *blk = &ps->blocks[ps->active_block_idx];
+
+    sbx_voice_set_frame_init(&blk_frame);
+
+    if (strcmp(time_tok, "}") == 0) {
+      if (rest && *rest) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: unexpected trailing token(s) after block close",
+                 (unsigned long)ps->line_no);
+        set_ctx_error_range_span(ctx, emsg, ps->line_no, line, rest, strlen(rest));
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      ps->active_block_idx = -1;
+      ps->active_block_last_off = -1.0;
+      return SBX_OK;
+    }
+
+    if (*rest == 0) {
+      char emsg[224];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: missing tone-spec or named tone-set in block '%s'",
+               (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    rc = parse_sbg_relative_offset_token(time_tok, &off_sec);
+    if (rc != SBX_OK) {
+      char emsg[256];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: invalid block-relative timing token '%s' (use +HH:MM[:SS][+...])",
+               (unsigned long)ps->line_no, time_tok);
+      set_ctx_error_token_span(ctx, emsg, ps->line_no, line, time_tok);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+    if (ps->active_block_last_off >= 0.0 && off_sec < ps->active_block_last_off) {
+      char emsg[256];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: block '%s' timings must be non-decreasing",
+               (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    {
+      char **tokv = 0;
+      size_t nt = 0;
+      size_t idx = 0;
+      int had_leading_transition = 0;
+      int nested_block_idx = -1;
+      rc = split_ws_tokens_inplace(&ps->scratch, rest, &tokv, &nt);
+      if (rc == SBX_ENOMEM) {
+        set_ctx_error(ctx, "out of memory");
+        return rc;
+      }
+      if (rc != SBX_OK) {
+        set_ctx_error(ctx, "failed tokenizing block entry");
+        rc = SBX_EINVAL;
+        return rc;
+      }
+
+      if (nt <= 0) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: missing tone-spec or named tone-set token in block '%s'",
+                 (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+
+      if (is_sbg_transition_token(tokv[idx])) {
+        interp = sbg_transition_token_to_interp(tokv[idx]);
+        transition_style = sbg_transition_token_to_style(tokv[idx]);
+        had_leading_transition = 1;
+        idx++;
+      }
+      if (idx >= nt) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: missing tone-spec or named tone-set after transition token in block '%s'",
+                 (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+
+      while (idx < nt) {
+        int bidx = -1;
+        const char *tok = tokv[idx];
+        int interp_tmp;
+        if (parse_interp_mode_token(tok, &interp_tmp) == SBX_OK) {
+          interp = interp_tmp;
+          idx++;
+          continue;
+        }
+        if (is_sbg_transition_token(tok)) {
+          interp = sbg_transition_token_to_interp(tok);
+          transition_style = sbg_transition_token_to_style(tok);
+          idx++;
+          continue;
+        }
+        rc = sbx_frame_apply_token(&blk_frame, tok, ctx,
+                                   ps->defs, ps->ndefs, &ps->def_index, &bidx, ps->blocks, ps->nblocks,
+                                   &ps->block_index);
+        if (rc != SBX_OK) {
+          char emsg[256];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: invalid block tone-spec, unknown named tone-set, or unknown nested block '%s'",
+                   (unsigned long)ps->line_no, tok);
+          set_ctx_error_token_span(ctx, emsg, ps->line_no, line, tok);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+        if (bidx >= 0) {
+          if (bidx == ps->active_block_idx) {
+            char emsg[256];
+            snprintf(emsg, sizeof(emsg),
+                     "line %lu: block '%s' cannot reference itself",
+                     (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+            set_ctx_error(ctx, emsg);
+            rc = SBX_EINVAL;
+            return rc;
+          }
+          if (had_leading_transition || idx + 1 < nt ||
+              blk_frame.tone_len > 0 || blk_frame.mix_amp_present || blk_frame.mix_fx_count > 0) {
+            char emsg[256];
+            snprintf(emsg, sizeof(emsg),
+                     "line %lu: nested block '%s' must appear alone in block '%s'",
+                     (unsigned long)ps->line_no, tok, blk->name ? blk->name : "?");
+            set_ctx_error_token_span(ctx, emsg, ps->line_no, line, tok);
+            rc = SBX_EINVAL;
+            return rc;
+          }
+          nested_block_idx = bidx;
+          idx++;
+          break;
+        }
+        idx++;
+      }
+
+      if (nested_block_idx >= 0) {
+        size_t bi;
+        if (ps->blocks[nested_block_idx].count == 0) {
+          char emsg[256];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: nested block '%s' has no entries",
+                   (unsigned long)ps->line_no, tokv[idx - 1]);
+          set_ctx_error(ctx, emsg);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+        for (bi = 0; bi < ps->blocks[nested_block_idx].count; bi++) {
+          SbxVoiceSetKeyframe nested_entry = ps->blocks[nested_block_idx].entries[bi];
+          double nested_off = off_sec + nested_entry.time_sec;
+          if (ps->active_block_last_off >= 0.0 && nested_off < ps->active_block_last_off) {
+            char emsg[256];
+            snprintf(emsg, sizeof(emsg),
+                     "line %lu: nested expansion in block '%s' is not time-ordered",
+                     (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+            set_ctx_error(ctx, emsg);
+            rc = SBX_EINVAL;
+            return rc;
+          }
+          nested_entry.time_sec = nested_off;
+          rc = block_append_entry(&ps->arena, blk, &nested_entry);
+          if (rc != SBX_OK) {
+            set_ctx_error(ctx, "out of memory");
+            rc = SBX_ENOMEM;
+            return rc;
+          }
+          if (nested_entry.tone_len > ps->max_voice_count) ps->max_voice_count = nested_entry.tone_len;
+          if (nested_entry.mix_fx_count > ps->max_mix_fx_slots) ps->max_mix_fx_slots = nested_entry.mix_fx_count;
+          ps->active_block_last_off = nested_off;
+        }
+      } else {
+        if (blk_frame.tone_len == 0 && !blk_frame.mix_amp_present && blk_frame.mix_fx_count == 0) {
+          char emsg[256];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: missing tone-spec or named tone-set token in block '%s'",
+                   (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+          set_ctx_error(ctx, emsg);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+        if (blk_frame.mix_fx_count > 0 && !blk_frame.mix_amp_present) {
+          char emsg[256];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: mix effects in block '%s' require mix/<amp> on the same line or in the referenced named tone-set",
+                   (unsigned long)ps->line_no, blk->name ? blk->name : "?");
+          set_ctx_error(ctx, emsg);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+        blk_frame.time_sec = off_sec;
+        blk_frame.interp = interp;
+        blk_frame.transition_style = transition_style;
+        rc = block_append_entry(&ps->arena, blk, &blk_frame);
+        if (rc != SBX_OK) {
+          set_ctx_error(ctx, "out of memory");
+          rc = SBX_ENOMEM;
+          return rc;
+        }
+        if (blk_frame.tone_len > ps->max_voice_count) ps->max_voice_count = blk_frame.tone_len;
+        if (blk_frame.mix_fx_count > ps->max_mix_fx_slots) ps->max_mix_fx_slots = blk_frame.mix_fx_count;
+        ps->active_block_last_off = off_sec;
+      }
+    }
+
+    return SBX_OK;
+  }
+
+  /* Accept named tone-set definitions: name: <tone-spec> */
+  {
+    size_t l0 = strlen(p);
+    if (l0 > 1 && p[l0 - 1] == ':') {
+      double ttmp;
+      p[l0 - 1] = 0;
+      if (parse_hhmmss_token(p, &ttmp) != SBX_OK)
+        is_definition = 1;
+      else
+        p[l0 - 1] = ':';
+    }
+  }
+
+  if (is_definition) {
+    char *r = rest;
+    char *name = p;
+    int didx;
+    int bidx;
+
+    if (*name == 0) {
+      char emsg[208];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: empty named tone-set definition",
+               (unsigned long)ps->line_no);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+    if (!r || *r == 0) {
+      char emsg[208];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: named tone-set '%s' is missing tone-spec",
+               (unsigned long)ps->line_no, name);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    if (((strncmp(name, "wave", 4) == 0 &&
+          isdigit((unsigned char)name[4]) &&
+          isdigit((unsigned char)name[5]) &&
+          name[6] == 0)) ||
+        ((strncmp(name, "custom", 6) == 0 &&
+          isdigit((unsigned char)name[6]) &&
+          isdigit((unsigned char)name[7]) &&
+          name[8] == 0)) ||
+        ((strncmp(name, "noise", 5) == 0 &&
+          isdigit((unsigned char)name[5]) &&
+          isdigit((unsigned char)name[6]) &&
+          name[7] == 0)) ||
+        ((strncmp(name, "spin", 4) == 0 &&
+          isdigit((unsigned char)name[4]) &&
+          isdigit((unsigned char)name[5]) &&
+          name[6] == 0))) {
+      int is_custom = (strncmp(name, "custom", 6) == 0);
+      int is_noise = (!is_custom && strncmp(name, "noise", 5) == 0);
+      int is_spin = (!is_custom && !is_noise && strncmp(name, "spin", 4) == 0);
+      int wave_idx = is_custom ? ((name[6] - '0') * 10 + (name[7] - '0'))
+                               : (is_noise ? ((name[5] - '0') * 10 + (name[6] - '0'))
+                                           : ((name[4] - '0') * 10 + (name[5] - '0')));
+      double *raw = 0;
+      size_t raw_count = 0, raw_cap = 0;
+      char *wr = r;
+      int custom_edge_mode = 1;
+      int custom_edge_seen = 0;
+      if ((is_custom ? ps->custom_env_waves[wave_idx]
+                     : (is_noise ? (ps->noise_profiles[wave_idx] ? (double *)1 : 0)
+                                 : (is_spin ? ps->spin_waves[wave_idx] : ps->legacy_env_waves[wave_idx])))) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: %s %02d already defined",
+                 (unsigned long)ps->line_no,
+                 is_custom ? "customNN" : (is_noise ? "noiseNN" : (is_spin ? "spinNN" : "waveNN")),
+                 wave_idx);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      wr = (char *)skip_ws(wr);
+      if (is_custom || is_spin) {
+        while ((*wr == 'e' || *wr == 'E') && wr[1] == '=') {
+          char *end = 0;
+          long edge = strtol(wr + 2, &end, 10);
+          if (end == wr + 2 || !(*end == 0 || isspace((unsigned char)*end) || *end == ':')) {
+            char emsg[224];
+            snprintf(emsg, sizeof(emsg),
+                     "line %lu: %s %02d expects optional e=<0..3> before samples",
+                     (unsigned long)ps->line_no, is_custom ? "customNN" : "spinNN", wave_idx);
+            set_ctx_error_token_span(ctx, emsg, ps->line_no, line, wr);
+            rc = SBX_EINVAL;
+            return rc;
+          }
+          if (custom_edge_seen || edge < 0 || edge > 3) {
+            char emsg[224];
+            snprintf(emsg, sizeof(emsg),
+                     "line %lu: %s %02d optional e=<0..3> may appear at most once",
+                     (unsigned long)ps->line_no, is_custom ? "customNN" : "spinNN", wave_idx);
+            set_ctx_error_token_span(ctx, emsg, ps->line_no, line, wr);
+            rc = SBX_EINVAL;
+            return rc;
+          }
+          custom_edge_mode = (int)edge;
+          custom_edge_seen = 1;
+          wr = (char *)skip_ws((*end == ':') ? end + 1 : end);
+        }
+      }
+      while (*wr) {
+        char *end = 0;
+        double v = strtod(wr, &end);
+        if (end == wr || !isfinite(v)) {
+          char emsg[224];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: %s %02d expects floating-point samples",
+                   (unsigned long)ps->line_no,
+                   is_custom ? "customNN" : (is_noise ? "noiseNN" : (is_spin ? "spinNN" : "waveNN")),
+                   wave_idx);
+          set_ctx_error_token_span(ctx, emsg, ps->line_no, line, wr);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+        if (raw_count == raw_cap) {
+          size_t ncap = raw_cap ? raw_cap * 2 : 16;
+          double *tmp = (double *)sbx_parse_arena_grow(&ps->scratch, raw, raw_cap * sizeof(*raw),
+                                                       ncap * sizeof(*raw));
+          if (!tmp) {
+            set_ctx_error(ctx, "out of memory");
+            rc = SBX_ENOMEM;
+            return rc;
+          }
+          raw = tmp;
+          raw_cap = ncap;
+        }
+        raw[raw_count++] = v;
+        wr = (char *)skip_ws(end);
+      }
+      if (is_custom) {
+        rc = sbx_build_literal_custom_env_table_from_samples(raw, raw_count, custom_edge_mode,
+                                                             &ps->custom_env_waves[wave_idx]);
+        ps->custom_env_edge_modes[wave_idx] = custom_edge_mode;
+      } else if (is_noise) {
+        rc = sbx_build_noise_profile_from_db_bands(raw, raw_count, ctx->eng->cfg.sample_rate,
+                                                   &ps->noise_profiles[wave_idx]);
+      } else if (is_spin) {
+        rc = sbx_build_literal_spin_wave_table_from_samples(raw, raw_count, custom_edge_mode,
+                                                            &ps->spin_waves[wave_idx]);
+        ps->spin_edge_modes[wave_idx] = custom_edge_mode;
+      } else {
+        rc = sbx_build_legacy_custom_wave_table_from_samples(raw, raw_count, &ps->legacy_env_waves[wave_idx]);
+      }
+      if (rc != SBX_OK) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: invalid %s %02d definition",
+                 (unsigned long)ps->line_no,
+                 is_custom ? "customNN" : (is_noise ? "noiseNN" : (is_spin ? "spinNN" : "waveNN")),
+                 wave_idx);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      return SBX_OK;
+    }
+
+    bidx = named_block_find(ps->blocks, ps->nblocks, &ps->block_index, name);
+    if (strcmp(r, "{") == 0) {
+      if (bidx < 0 && named_tone_find(ps->defs, ps->ndefs, &ps->def_index, name) >= 0) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: '%s' is already defined as a named tone-set",
+                 (unsigned long)ps->line_no, name);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+
+      if (bidx >= 0) {
+        /* Redefinition reuses the previous entry storage. */
+        ps->blocks[bidx].count = 0;
+      } else {
+        if (ps->nblocks == ps->blocks_cap) {
+          size_t ncap = ps->blocks_cap ? (ps->blocks_cap * 2) : 8;
+          SbxNamedBlockDef *tmp =
+              (SbxNamedBlockDef *)sbx_parse_arena_grow(&ps->arena, ps->blocks,
+                                                       ps->blocks_cap * sizeof(*ps->blocks),
+                                                       ncap * sizeof(*ps->blocks));
+          if (!tmp) {
+            set_ctx_error(ctx, "out of memory");
+            rc = SBX_ENOMEM;
+            return rc;
+          }
+          ps->blocks = tmp;
+          ps->blocks_cap = ncap;
+        }
+        bidx = (int)ps->nblocks;
+        ps->blocks[ps->nblocks].name = sbx_parse_arena_strdup(&ps->arena, name);
+        ps->blocks[ps->nblocks].entries = 0;
+        ps->blocks[ps->nblocks].count = 0;
+        ps->blocks[ps->nblocks].cap = 0;
+        if (!ps->blocks[ps->nblocks].name ||
+            sbx_name_index_add(&ps->arena, &ps->block_index, ps->blocks[ps->nblocks].name,
+                               (int)ps->nblocks) != SBX_OK) {
+          set_ctx_error(ctx, "out of memory");
+          rc = SBX_ENOMEM;
+          return rc;
+        }
+        ps->nblocks++;
+      }
+      ps->active_block_idx = bidx;
+      ps->active_block_last_off = -1.0;
+      return SBX_OK;
+    }
+    if (bidx >= 0) {
+      char emsg[224];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: '%s' is already defined as a block name",
+               (unsigned long)ps->line_no, name);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    {
+      while (*r) {
+        int bdef = -1;
+        char *v_tok = r;
+        while (*r && !isspace((unsigned char)*r)) r++;
+        if (*r) {
+          *r++ = 0;
+          r = (char *)skip_ws(r);
+        }
+        rc = sbx_frame_apply_token(&frame, v_tok, ctx,
+                                   ps->defs, ps->ndefs, &ps->def_index, &bdef, ps->blocks, ps->nblocks,
+                                   &ps->block_index);
+        if (rc != SBX_OK || bdef >= 0) {
+          char emsg[224];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: invalid named tone-set token '%s'",
+                   (unsigned long)ps->line_no, v_tok);
+          set_ctx_error_token_span(ctx, emsg, ps->line_no, line, v_tok);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+      }
+      if (frame.tone_len == 0 && !frame.mix_amp_present && frame.mix_fx_count == 0) {
+        char emsg[208];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: named tone-set '%s' is missing content",
+                 (unsigned long)ps->line_no, name);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      if (frame.mix_fx_count > 0 && !frame.mix_amp_present) {
+        char emsg[256];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: mix effects in named tone-set '%s' require mix/<amp> on the same line or in a referenced named tone-set",
+                 (unsigned long)ps->line_no, name);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      if (frame.tone_len > ps->max_voice_count) ps->max_voice_count = frame.tone_len;
+      if (frame.mix_fx_count > ps->max_mix_fx_slots) ps->max_mix_fx_slots = frame.mix_fx_count;
+    }
+
+    didx = named_tone_find(ps->defs, ps->ndefs, &ps->def_index, name);
+    if (didx >= 0) {
+      ps->defs[didx].frame = frame;
+    } else {
+      if (ps->ndefs == ps->defs_cap) {
+        size_t ncap = ps->defs_cap ? (ps->defs_cap * 2) : 8;
+        SbxNamedToneDef *tmp =
+            (SbxNamedToneDef *)sbx_parse_arena_grow(&ps->arena, ps->defs, ps->defs_cap * sizeof(*ps->defs),
+                                                    ncap * sizeof(*ps->defs));
+        if (!tmp) {
+          set_ctx_error(ctx, "out of memory");
+          rc = SBX_ENOMEM;
+          return rc;
+        }
+        ps->defs = tmp;
+        ps->defs_cap = ncap;
+      }
+      ps->defs[ps->ndefs].name = sbx_parse_arena_strdup(&ps->arena, name);
+      if (!ps->defs[ps->ndefs].name ||
+          sbx_name_index_add(&ps->arena, &ps->def_index, ps->defs[ps->ndefs].name, (int)ps->ndefs) != SBX_OK) {
+        set_ctx_error(ctx, "out of memory");
+        rc = SBX_ENOMEM;
+        return rc;
+      }
+      ps->defs[ps->ndefs].frame = frame;
+      ps->ndefs++;
+    }
+    return SBX_OK;
+  }
+
+  time_tok = p;
+  if (*rest == 0) {
+    char emsg[192];
+    snprintf(emsg, sizeof(emsg),
+             "line %lu: missing tone-spec or named tone-set",
+             (unsigned long)ps->line_no);
+    set_ctx_error(ctx, emsg);
+    rc = SBX_EINVAL;
+    return rc;
+  }
+
+  rc = parse_sbg_timeline_time_token(time_tok, &ps->last_abs_sec, &tsec);
+  if (rc != SBX_OK) {
+    char emsg[224];
+    snprintf(emsg, sizeof(emsg),
+             "line %lu: invalid SBG timing token '%s' (use HH:MM[:SS], NOW, and optional +relative parts)",
+             (unsigned long)ps->line_no, time_tok);
+    set_ctx_error_token_span(ctx, emsg, ps->line_no, line, time_tok);
+    rc = SBX_EINVAL;
+    return rc;
+  }
+
+  {
+    char **tokv = 0;
+    size_t nt = 0;
+    size_t idx = 0;
+    int had_leading_transition = 0;
+    int block_idx = -1;
+    rc = split_ws_tokens_inplace(&ps->scratch, rest, &tokv, &nt);
+    if (rc == SBX_ENOMEM) {
+      set_ctx_error(ctx, "out of memory");
+      return rc;
+    }
+    if (rc != SBX_OK) {
+      set_ctx_error(ctx, "failed tokenizing SBG timing entry");
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    if (nt <= 0) {
+      char emsg[224];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: missing tone-spec or named tone-set token",
+               (unsigned long)ps->line_no);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    if (is_sbg_transition_token(tokv[idx])) {
+      interp = sbg_transition_token_to_interp(tokv[idx]);
+      frame.transition_style = sbg_transition_token_to_style(tokv[idx]);
+      had_leading_transition = 1;
+      idx++;
+    }
+    if (idx >= nt) {
+      char emsg[224];
+      snprintf(emsg, sizeof(emsg),
+               "line %lu: missing tone-spec or named tone-set after transition token",
+               (unsigned long)ps->line_no);
+      set_ctx_error(ctx, emsg);
+      rc = SBX_EINVAL;
+      return rc;
+    }
+
+    while (idx < nt) {
+      int interp_tmp;
+      int bidx = -1;
+      const char *tok = tokv[idx];
+      if (parse_interp_mode_token(tok, &interp_tmp) == SBX_OK) {
+        interp = interp_tmp;
+        idx++;
+        continue;
+      }
+      if (is_sbg_transition_token(tok)) {
+        interp = sbg_transition_token_to_interp(tok);
+        frame.transition_style = sbg_transition_token_to_style(tok);
+        idx++;
+        continue;
+      }
+      rc = sbx_frame_apply_token(&frame, tok, ctx,
+                                 ps->defs, ps->ndefs, &ps->def_index, &bidx, ps->blocks, ps->nblocks,
+                                 &ps->block_index);
+      if (rc != SBX_OK) {
+        char emsg[224];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: invalid tone-spec or unknown named tone-set '%s'",
+                 (unsigned long)ps->line_no, tok);
+        set_ctx_error_token_span(ctx, emsg, ps->line_no, line, tok);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      if (bidx >= 0) {
+        if (had_leading_transition || idx + 1 < nt ||
+            frame.tone_len > 0 || frame.mix_amp_present || frame.mix_fx_count > 0) {
+          char emsg[256];
+          snprintf(emsg, sizeof(emsg),
+                   "line %lu: block invocation '%s' must appear alone",
+                   (unsigned long)ps->line_no, tok);
+          set_ctx_error_token_span(ctx, emsg, ps->line_no, line, tok);
+          rc = SBX_EINVAL;
+          return rc;
+        }
+        block_idx = bidx;
+        idx++;
+        break;
+      }
+      idx++;
+    }
+
+    if (block_idx >= 0) {
+      size_t bi;
+      if (ps->blocks[block_idx].count == 0) {
+        char emsg[256];
+        snprintf(emsg, sizeof(emsg),
+                 "line %lu: block '%s' has no entries",
+                 (unsigned long)ps->line_no, tokv[idx - 1]);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
+        return rc;
+      }
+      for (bi = 0; bi < ps->blocks[block_idx].count; bi++) {
+        const SbxVoiceSetKeyframe *entry = &ps->blocks[block_idx].entries[bi];
+        rc = sbx_sbg_parser_emit(ps, entry, tsec + entry->time_sec);
+        if (rc != SBX_OK) {
+          set_ctx_error(ctx, "out of memory");
+          return rc;
+        }
+      }
+      expanded_block = 1;
+    }
+  }
+
+  if (expanded_block) {
+    return SBX_OK;
+  }
+
+  if (frame.tone_len == 0 && !frame.mix_amp_present && frame.mix_fx_count == 0) {
+    char emsg[192];
+    snprintf(emsg, sizeof(emsg),
+             "line %lu: missing tone-spec or named tone-set",
+             (unsigned long)ps->line_no);
+    set_ctx_error(ctx, emsg);
+    rc = SBX_EINVAL;
+    return rc;
+  }
+  if (frame.mix_fx_count > 0 && !frame.mix_amp_present) {
+    char emsg[256];
+    snprintf(emsg, sizeof(emsg),
+             "line %lu: mix effects require mix/<amp> on the same line or in the referenced named tone-set",
+             (unsigned long)ps->line_no);
+    set_ctx_error(ctx, emsg);
+    rc = SBX_EINVAL;
+    return rc;
+  }
+  frame.interp = interp;
+  rc = sbx_sbg_parser_emit(ps, &frame, tsec);
+  if (rc != SBX_OK)
+    set_ctx_error(ctx, "out of memory");
+  return rc;
+}
+
+static int
+sbx_sbg_parser_finish(SbxSbgParser *ps) {
+  if (ps->active_block_idx >= 0) {
+    char emsg[256];
+    snprintf(emsg, sizeof(emsg),
+             "unterminated block definition '%s' (missing closing '}')",
+             ps->blocks[ps->active_block_idx].name ? ps->blocks[ps->active_block_idx].name : "?");
+    set_ctx_error(ps->ctx, emsg);
+    return SBX_EINVAL;
+  }
+  return SBX_OK;
+}
+
+/* Per-lane keyframe arrays split out of a run of voice-set frames. */
+typedef struct {
+  SbxProgramKeyframe *primary;
+  SbxProgramKeyframe *mv_frames;  /* [voice][count]; NULL for one voice */
+  unsigned char *styles;
+  SbxMixAmpKeyframe *mix_kfs;     /* NULL unless have_mix */
+  SbxMixFxKeyframe *mix_fx_kfs;   /* NULL unless mix-effect slots exist */
+} SbxFrameLanes;
+
+/* Tone of lane vi in body; lanes past the body's tone_len are silent. */
+static SbxToneSpec
+sbx_queued_frame_tone(const SbxVoiceSetKeyframe *body, size_t vi) {
+  SbxToneSpec tone;
+  if (vi < body->tone_len) return body->tones[vi];
+  sbx_default_tone_spec(&tone);
+  tone.mode = SBX_TONE_NONE;
+  tone.amplitude = 0.0;
+  return tone;
+}
+
+static int
+sbx_split_voice_set_frames(SbxParseArena *arena,
+                           const SbxSbgQueuedFrame *frames,
+                           size_t count,
+                           size_t voice_count,
+                           size_t mix_fx_slots,
+                           int have_mix,
+                           SbxFrameLanes *out) {
+  size_t ki, vi;
+
+  memset(out, 0, sizeof(*out));
+  out->styles = (unsigned char *)sbx_parse_arena_alloc(arena, count * sizeof(*out->styles));
+  out->primary = (SbxProgramKeyframe *)sbx_parse_arena_alloc(arena, count * sizeof(*out->primary));
+  if (!out->styles || !out->primary) return SBX_ENOMEM;
+  if (have_mix) {
+    out->mix_kfs = (SbxMixAmpKeyframe *)sbx_parse_arena_alloc(arena, count * sizeof(*out->mix_kfs));
+    if (!out->mix_kfs) return SBX_ENOMEM;
+    for (ki = 0; ki < count; ki++) {
+      const SbxVoiceSetKeyframe *f = frames[ki].body;
+      out->mix_kfs[ki].time_sec = frames[ki].time_sec;
+      out->mix_kfs[ki].interp = f->interp;
+      out->mix_kfs[ki].amp_pct = f->mix_amp_present ? f->mix_amp_pct : 0.0;
+    }
+  }
+  if (mix_fx_slots > 0) {
+    out->mix_fx_kfs = (SbxMixFxKeyframe *)sbx_parse_arena_alloc(arena, count * sizeof(*out->mix_fx_kfs));
+    if (!out->mix_fx_kfs) return SBX_ENOMEM;
+    for (ki = 0; ki < count; ki++) {
+      const SbxVoiceSetKeyframe *f = frames[ki].body;
+      memset(&out->mix_fx_kfs[ki], 0, sizeof(out->mix_fx_kfs[ki]));
+      out->mix_fx_kfs[ki].time_sec = frames[ki].time_sec;
+      out->mix_fx_kfs[ki].interp = f->interp;
+      out->mix_fx_kfs[ki].mix_fx_count = f->mix_fx_count;
+      memcpy(out->mix_fx_kfs[ki].mix_fx, f->mix_fx, f->mix_fx_count * sizeof(f->mix_fx[0]));
+    }
+  }
+  if (voice_count > 1) {
+    if (voice_count > ((size_t)-1) / sizeof(*out->mv_frames) / count) return SBX_ENOMEM;
+    out->mv_frames = (SbxProgramKeyframe *)sbx_parse_arena_alloc(arena,
+                                                                 voice_count * count * sizeof(*out->mv_frames));
+    if (!out->mv_frames) return SBX_ENOMEM;
+    for (vi = 0; vi < voice_count; vi++) {
+      for (ki = 0; ki < count; ki++) {
+        out->mv_frames[vi * count + ki].time_sec = frames[ki].time_sec;
+        out->mv_frames[vi * count + ki].tone = sbx_queued_frame_tone(frames[ki].body, vi);
+        out->mv_frames[vi * count + ki].interp = frames[ki].body->interp;
+      }
+    }
+  }
+  for (ki = 0; ki < count; ki++) {
+    out->styles[ki] = (unsigned char)frames[ki].body->transition_style;
+    out->primary[ki].time_sec = frames[ki].time_sec;
+    out->primary[ki].tone = sbx_queued_frame_tone(frames[ki].body, 0);
+    out->primary[ki].interp = frames[ki].body->interp;
+  }
+  return SBX_OK;
+}
+
+/* Activates the frames queued in ps as the context's keyframe program. */
+static int
+ctx_activate_sbg_frames(SbxContext *ctx, SbxSbgParser *ps, int loop) {
+  SbxFrameLanes lanes;
+  size_t count = ps->count;
+  int rc;
+
+  if (sbx_split_voice_set_frames(&ps->scratch, ps->frames, count, ps->max_voice_count,
+                                 ps->max_mix_fx_slots, ps->have_mix, &lanes) != SBX_OK) {
+    set_ctx_error(ctx, "out of memory");
+    return SBX_ENOMEM;
+  }
+  rc = ctx_activate_keyframes_internal(ctx, lanes.primary, count,
+                                       lanes.mv_frames ? lanes.mv_frames : lanes.primary,
+                                       ps->max_voice_count, lanes.styles, loop);
+  if (rc != SBX_OK) return rc;
+  rc = sbx_context_set_mix_amp_keyframes(ctx, lanes.mix_kfs, lanes.mix_kfs ? count : 0,
+                                         lanes.mix_kfs ? 0.0 : 100.0);
+  if (rc != SBX_OK) return rc;
+  return ctx_set_sbg_mix_effect_keyframes_internal(ctx, lanes.mix_fx_kfs,
+                                                   lanes.mix_fx_kfs ? count : 0,
+                                                   ps->max_mix_fx_slots);
+}
+
+int
+sbx_context_load_sbg_timing_text(SbxContext *ctx, const char *text, int loop) {
+  char *buf = 0;
+  const char *cursor = text;
+  size_t buf_cap = 0;
+  SbxSbgParser ps;
+  double *legacy_env_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
+  double *custom_env_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
+  double *spin_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
+  SbxNoiseProfile *noise_profiles[SBX_CUSTOM_WAVE_COUNT] = {0};
+  int legacy_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int custom_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int spin_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int rc = SBX_OK;
+
+  if (!ctx || !ctx->eng || !text) return SBX_EINVAL;
+
+  sbx_sbg_parser_init(&ps, ctx, legacy_env_waves, custom_env_waves, spin_waves, noise_profiles,
+                      legacy_env_edge_modes, custom_env_edge_modes, spin_edge_modes);
+  while (*cursor) {
+    ps.line_no++;
+    if (sbx_text_next_line(&cursor, &buf, &buf_cap, 0) != SBX_OK) {
+      set_ctx_error(ctx, "out of memory");
+      rc = SBX_ENOMEM;
+      goto done;
+    }
+    rc = sbx_sbg_parse_line(&ps, buf);
+    sbx_parse_arena_reset(&ps.scratch);
+    if (rc != SBX_OK) goto done;
+  }
+  rc = sbx_sbg_parser_finish(&ps);
+  if (rc != SBX_OK) goto done;
+
+  if (ps.count == 0) {
+    set_ctx_error(ctx, "sbg timing text contains no keyframes");
+    rc = SBX_EINVAL;
+    goto done;
+  }
+
+  ctx_replace_custom_waves(ctx, legacy_env_waves, custom_env_waves, spin_waves, noise_profiles,
+                           legacy_env_edge_modes, custom_env_edge_modes, spin_edge_modes);
+  rc = ctx_activate_sbg_frames(ctx, &ps, loop);
+
+done:
+  /* Everything but the line buffer and custom wave tables came from the arenas. */
+  {
+    size_t i;
+    for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+      if (legacy_env_waves[i]) free(legacy_env_waves[i]);
+      if (custom_env_waves[i]) free(custom_env_waves[i]);
+      if (spin_waves[i]) free(spin_waves[i]);
+      if (noise_profiles[i]) free(noise_profiles[i]);
+    }
+  }
+  if (buf) free(buf);
+  sbx_sbg_parser_free(&ps);
+  return rc;
+}
+
+int
+sbx_context_load_sbg_timing_file(SbxContext *ctx, const char *path, int loop) {
+  SbxTextFile tf;
+  int rc;
+  if (!ctx || !ctx->eng || !path) return SBX_EINVAL;
+
+  rc = sbx_text_file_open(path, &tf);
+  if (rc == SBX_EINVAL) {
+    char emsg[256];
+    snprintf(emsg, sizeof(emsg), "cannot open sbg timing file: %s", path);
+    set_ctx_error(ctx, emsg);
+    return rc;
+  } else if (rc == SBX_ENOMEM) {
+    set_ctx_error(ctx, "out of memory");
+    return rc;
+  } else if (rc != SBX_OK) {
+    set_ctx_error(ctx, "failed reading sbg timing file");
+    return rc;
+  }
+
+  rc = sbx_context_load_sbg_timing_text(ctx, tf.text, loop);
+  sbx_text_file_close(&tf);
+  return rc;
 }
 
-void
-sbx_mix_input_destroy(SbxMixInput *input) {
-  if (!input) return;
-  sbx_mix_input_activate(input);
-  if (input->term_fn)
-    input->term_fn();
-  sbx_mix_input_sync_back(input);
-  if (input->take_stream_ownership && input->fp)
-    fclose(input->fp);
-  input->fp = 0;
-  if (input->path_hint) {
-    free(input->path_hint);
-    input->path_hint = 0;
-  }
-  if (input->looper_spec_override) {
-    free(input->looper_spec_override);
-    input->looper_spec_override = 0;
+/*
+ * Streaming .sbg timing programs. The pump reads and parses ahead of the
+ * play position until window_frames keyframes, the last of them past the
+ * lead it was asked for, are queued, drops the frames playback has passed
+ * and builds keyframe arrays for the queue in a private context. Each build
+ * goes to the render thread as a window through a single-producer/single-
+ * consumer ring; render swaps the newest in without reading, parsing or
+ * allocating, and sends the arrays it replaced back on a second ring for
+ * the pump to free. Memory stays bounded by the window and the definitions
+ * however long the program is.
+ */
+#define SBX_SBG_READY_CAP 2U    /* built windows waiting for render */
+#define SBX_SBG_RETIRED_CAP 4U  /* swapped-out windows waiting for the pump */
+
+typedef struct {
+  SbxKeyframeStore kf_store;
+  unsigned char *kf_styles;
+  SbxKeyframeSegment *kf_segs;
+  size_t kf_count;
+  SbxMixAmpKeyframe *mix_kf;
+  size_t mix_kf_count;
+  double mix_default_amp_pct;
+  SbxMixFxKeyframe *sbg_mix_fx_kf;
+  size_t sbg_mix_fx_kf_count;
+  size_t sbg_mix_fx_slots;
+  SbxMixFxState *sbg_mix_fx_state;
+  size_t voice_count;                          /* voices once installed */
+  SbxEngine *mv_eng[SBX_MAX_SBG_VOICES - 1];   /* engines for voices it adds */
+  /* Tables first defined since the previous window. */
+  double *legacy_env_waves[SBX_CUSTOM_WAVE_COUNT];
+  double *custom_env_waves[SBX_CUSTOM_WAVE_COUNT];
+  double *spin_waves[SBX_CUSTOM_WAVE_COUNT];
+  SbxNoiseProfile *noise_profiles[SBX_CUSTOM_WAVE_COUNT];
+  int legacy_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int custom_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int spin_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int new_waves;
+  int eof;                                     /* input ended with this window */
+} SbxSbgWindow;
+
+/* waves_sent bits: which of a slot's tables have gone out in a window. */
+#define SBX_SBG_SENT_LEGACY 1
+#define SBX_SBG_SENT_CUSTOM 2
+#define SBX_SBG_SENT_SPIN 4
+#define SBX_SBG_SENT_NOISE 8
+
+struct SbxSbgStream {
+  /* Pump side. */
+  SbxSbgParser ps;
+  SbxContext *pctx;         /* parse errors, wave tables, window builds */
+  FILE *fp;
+  int own_fp;
+  char *init_text;          /* caller's initial_text, parsed before fp */
+  const char *init_cursor;
+  char *line;
+  size_t line_cap;
+  size_t window_frames;
+  int eof;
+  unsigned char waves_sent[SBX_CUSTOM_WAVE_COUNT];
+  /* Shared: render pops ready at head, the pump pushes at tail; the
+   * retired ring runs the other way. */
+  SbxSbgWindow *ready[SBX_SBG_READY_CAP];
+  unsigned int ready_head, ready_tail;
+  SbxSbgWindow *retired[SBX_SBG_RETIRED_CAP];
+  unsigned int retired_head, retired_tail;
+  uint64_t play_bits;       /* render's play position, bits of a double */
+  unsigned int failed;      /* error code that stopped the pump */
+  unsigned int done;        /* render installed the window input ended in */
+  unsigned int underruns;   /* renders that ran past the parsed window */
+};
+
+static void
+sbx_sbg_window_free(SbxSbgWindow *w) {
+  size_t i;
+  if (!w) return;
+  sbx_kf_store_free(&w->kf_store);
+  if (w->kf_styles) free(w->kf_styles);
+  if (w->kf_segs) free(w->kf_segs);
+  if (w->mix_kf) free(w->mix_kf);
+  if (w->sbg_mix_fx_kf) free(w->sbg_mix_fx_kf);
+  if (w->sbg_mix_fx_state) free(w->sbg_mix_fx_state);
+  for (i = 0; i + 1 < SBX_MAX_SBG_VOICES; i++) {
+    if (w->mv_eng[i]) sbx_engine_destroy(w->mv_eng[i]);
   }
-  if (input->embedded_looper_spec) {
-    free(input->embedded_looper_spec);
-    input->embedded_looper_spec = 0;
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    if (w->legacy_env_waves[i]) free(w->legacy_env_waves[i]);
+    if (w->custom_env_waves[i]) free(w->custom_env_waves[i]);
+    if (w->spin_waves[i]) free(w->spin_waves[i]);
+    if (w->noise_profiles[i]) free(w->noise_profiles[i]);
   }
-  if (sbx_mix_active_input == input)
-    sbx_mix_active_input = 0;
-  free(input);
+  free(w);
 }
 
-const char *
-sbx_mix_input_last_error(const SbxMixInput *input) {
-  if (!input) return "null mix input";
-  return input->last_error;
+static void
+sbx_sbg_stream_free(SbxSbgStream *st) {
+  size_t i;
+  if (!st) return;
+  while (st->ready_head != st->ready_tail)
+    sbx_sbg_window_free(st->ready[st->ready_head++ % SBX_SBG_READY_CAP]);
+  while (st->retired_head != st->retired_tail)
+    sbx_sbg_window_free(st->retired[st->retired_head++ % SBX_SBG_RETIRED_CAP]);
+  if (st->own_fp && st->fp) fclose(st->fp);
+  if (st->init_text) free(st->init_text);
+  if (st->line) free(st->line);
+  sbx_sbg_parser_free(&st->ps);
+  if (st->pctx) {
+    /* Tables sent out belong to the context now; the rest go with pctx. */
+    for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+      if (st->waves_sent[i] & SBX_SBG_SENT_LEGACY) st->pctx->legacy_env_waves[i] = 0;
+      if (st->waves_sent[i] & SBX_SBG_SENT_CUSTOM) st->pctx->custom_env_waves[i] = 0;
+      if (st->waves_sent[i] & SBX_SBG_SENT_SPIN) st->pctx->spin_waves[i] = 0;
+      if (st->waves_sent[i] & SBX_SBG_SENT_NOISE) st->pctx->noise_profiles[i] = 0;
+    }
+    sbx_context_destroy(st->pctx);
+  }
+  free(st);
 }
 
-int
-sbx_mix_input_output_rate(const SbxMixInput *input) {
-  if (!input) return 0;
-  return input->output_rate_hz;
-}
+/* Next input line into st->line without its newline; *got = 0 at end of input. */
+static int
+sbx_sbg_stream_next_line(SbxSbgStream *st, int *got) {
+  size_t len = 0;
 
-int
-sbx_mix_input_output_rate_is_default(const SbxMixInput *input) {
-  if (!input) return 0;
-  return input->output_rate_is_default ? 1 : 0;
+  *got = 0;
+  if (st->init_cursor && *st->init_cursor) {
+    *got = 1;
+    return sbx_text_next_line(&st->init_cursor, &st->line, &st->line_cap, 0);
+  }
+  for (;;) {
+    size_t room;
+    if (st->line_cap - len < 2) {
+      size_t ncap = st->line_cap ? st->line_cap * 2 : 256;
+      char *tmp = (char *)realloc(st->line, ncap);
+      if (!tmp) return SBX_ENOMEM;
+      st->line = tmp;
+      st->line_cap = ncap;
+    }
+    room = st->line_cap - len;
+    if (room > INT_MAX) room = INT_MAX;
+    if (!fgets(st->line + len, (int)room, st->fp)) break;
+    len += strlen(st->line + len);
+    if (len > 0 && st->line[len - 1] == '\n') {
+      st->line[len - 1] = 0;
+      *got = 1;
+      return SBX_OK;
+    }
+  }
+  if (ferror(st->fp)) return SBX_ENOTREADY;
+  st->line[len] = 0;
+  *got = len > 0;
+  return SBX_OK;
 }
 
-int
-sbx_mix_input_format(const SbxMixInput *input) {
-  if (!input) return SBX_MIX_INPUT_RAW;
-  return input->format;
-}
+/* Parses until the window is full and reaches past horizon_sec, or input ends. */
+static int
+sbx_sbg_stream_parse_ahead(SbxSbgStream *st, double horizon_sec) {
+  SbxSbgParser *ps = &st->ps;
+  int rc, got;
 
-const char *
-sbx_mix_input_embedded_looper(const SbxMixInput *input) {
-  if (!input || !input->embedded_looper_spec || !input->embedded_looper_spec[0]) return 0;
-  return input->embedded_looper_spec;
+  while (!st->eof &&
+         (ps->count < st->window_frames || ps->frames[ps->count - 1].time_sec <= horizon_sec)) {
+    rc = sbx_sbg_stream_next_line(st, &got);
+    if (rc != SBX_OK) {
+      set_ctx_error(ps->ctx, rc == SBX_ENOMEM ? "out of memory" : "error reading sbg timing stream");
+      return rc;
+    }
+    if (!got) {
+      st->eof = 1;
+      return sbx_sbg_parser_finish(ps);
+    }
+    ps->line_no++;
+    rc = sbx_sbg_parse_line(ps, st->line);
+    sbx_parse_arena_reset(&ps->scratch);
+    if (rc != SBX_OK) return rc;
+  }
+  return SBX_OK;
 }
 
-SbxContext *
-sbx_context_create(const SbxEngineConfig *cfg) {
-  SbxContext *ctx = (SbxContext *)calloc(1, sizeof(*ctx));
-  if (!ctx) return NULL;
+/*
+ * Builds the stream's queue as keyframes of the pump's private context;
+ * engines are only added when a wider voice set shows up.
+ */
+static int
+ctx_build_sbg_window(SbxContext *ctx, SbxSbgParser *ps) {
+  SbxFrameLanes lanes;
+  SbxKeyframeStore store;
+  SbxKeyframeSegment *segs = 0;
+  unsigned char *styles = 0;
+  size_t n = ps->count;
+  size_t voices = ps->max_voice_count;
+  size_t i;
+  char err[160];
+  int rc;
 
-  ctx->eng = sbx_engine_create(cfg);
-  if (!ctx->eng) {
-    free(ctx);
-    return NULL;
+  if (sbx_split_voice_set_frames(&ps->scratch, ps->frames, n, voices, ps->max_mix_fx_slots,
+                                 ps->have_mix, &lanes) != SBX_OK)
+    goto oom;
+  for (i = 0; i < n + (lanes.mv_frames ? n * voices : 0); i++) {
+    SbxToneSpec *tone = (i < n) ? &lanes.primary[i].tone : &lanes.mv_frames[i - n].tone;
+    rc = normalize_tone(tone, err, sizeof(err));
+    if (rc != SBX_OK) {
+      set_ctx_error(ctx, err);
+      return rc;
+    }
   }
-  ctx->loaded = 0;
-  ctx->default_waveform = SBX_WAVE_SINE;
-  sbx_default_iso_envelope_spec(&ctx->seq_iso_env);
-  sbx_default_mixam_envelope_spec(&ctx->seq_mixam_env);
-  ctx->source_mode = SBX_CTX_SRC_NONE;
-  ctx->kfs = 0;
-  ctx->kf_count = 0;
-  ctx->kf_loop = 0;
-  ctx->kf_seg = 0;
-  ctx->kf_duration_sec = 0.0;
-  ctx->mv_kfs = 0;
-  ctx->mv_eng = 0;
-  ctx->mv_voice_count = 0;
-  sbx_default_tone_spec(&ctx->static_tone);
-  memset(&ctx->curve_tone, 0, sizeof(ctx->curve_tone));
-  ctx->curve_prog = 0;
-  ctx->curve_duration_sec = 0.0;
-  ctx->curve_loop = 0;
-  ctx->t_sec = 0.0;
-  ctx->aux_tones = 0;
-  ctx->aux_eng = 0;
-  ctx->aux_count = 0;
-  ctx->aux_buf = 0;
-  ctx->aux_buf_cap = 0;
-  ctx->mix_fx = 0;
-  ctx->mix_fx_count = 0;
-  ctx->sbg_mix_fx_kf = 0;
-  ctx->sbg_mix_fx_kf_count = 0;
-  ctx->sbg_mix_fx_slots = 0;
-  ctx->sbg_mix_fx_seg = 0;
-  ctx->sbg_mix_fx_state = 0;
-  ctx->mix_kf = 0;
-  ctx->mix_kf_count = 0;
-  ctx->mix_kf_seg = 0;
-  ctx->mix_default_amp_pct = 100.0;
-  sbx_default_mix_mod_spec(&ctx->mix_mod);
-  sbx_default_amp_adjust_spec(&ctx->amp_adjust);
-  ctx->have_amp_adjust = 0;
-  ctx->telemetry_cb = 0;
-  ctx->telemetry_user = 0;
-  memset(&ctx->telemetry_last, 0, sizeof(ctx->telemetry_last));
-  ctx->telemetry_valid = 0;
-  ctx_clear_live_controls_internal(ctx);
-  ctx_sync_custom_waves(ctx);
-  set_ctx_error(ctx, NULL);
-  return ctx;
-}
-
-void
-sbx_context_destroy(SbxContext *ctx) {
-  if (!ctx) return;
-  ctx_clear_mix_keyframes(ctx);
-  ctx_clear_sbg_mix_effect_keyframes(ctx);
-  ctx_clear_mix_effects(ctx);
-  ctx_clear_aux_tones(ctx);
-  ctx_clear_keyframes(ctx);
-  ctx_clear_curve_source(ctx);
-  ctx_clear_custom_waves(ctx);
-  sbx_engine_destroy(ctx->eng);
-  free(ctx);
-}
 
-void
-sbx_context_reset(SbxContext *ctx) {
-  if (!ctx || !ctx->eng) return;
-  ctx_reset_runtime(ctx);
-  set_ctx_error(ctx, NULL);
-}
+  if (voices > ctx->mv_voice_count) {
+    SbxEngine **eng = (SbxEngine **)realloc(ctx->mv_eng, (voices - 1) * sizeof(*eng));
+    if (!eng) goto oom;
+    ctx->mv_eng = eng;
+    while (ctx->mv_voice_count < voices) {
+      size_t vi = ctx->mv_voice_count;
+      SbxEngine *e = sbx_engine_create(&ctx->eng->cfg);
+      if (!e) goto oom;
+      engine_set_custom_waves(e, ctx->legacy_env_waves, ctx->custom_env_waves,
+                              ctx->spin_waves, ctx->noise_profiles,
+                              ctx->legacy_env_edge_modes, ctx->custom_env_edge_modes,
+                              ctx->spin_edge_modes);
+      rc = engine_apply_tone(e, &lanes.mv_frames[vi * n].tone, 1);
+      if (rc != SBX_OK) {
+        set_ctx_error(ctx, sbx_engine_last_error(e));
+        sbx_engine_destroy(e);
+        return rc;
+      }
+      ctx->mv_eng[vi - 1] = e;
+      ctx->mv_voice_count++;
+    }
+  }
 
-int
-sbx_context_set_tone(SbxContext *ctx, const SbxToneSpec *tone) {
+  styles = (unsigned char *)malloc(n);
+  if (!styles) goto oom;
+  memcpy(styles, lanes.styles, n);
+  if (sbx_kf_store_build(&store, lanes.primary, lanes.mv_frames, voices, n) != SBX_OK) {
+    free(styles);
+    goto oom;
+  }
+  if (n > 1) {
+    segs = (SbxKeyframeSegment *)calloc(voices * (n - 1), sizeof(*segs));
+    if (!segs) {
+      sbx_kf_store_free(&store);
+      free(styles);
+      goto oom;
+    }
+    sbx_compile_keyframe_segments(&store, n, voices, styles, segs);
+  }
+  sbx_kf_store_free(&ctx->kf_store);
+  if (ctx->kf_styles) free(ctx->kf_styles);
+  if (ctx->kf_segs) free(ctx->kf_segs);
+  ctx->kf_store = store;
+  ctx->kf_styles = styles;
+  ctx->kf_segs = segs;
+  ctx->kf_count = n;
+
+  rc = sbx_context_set_mix_amp_keyframes(ctx, lanes.mix_kfs, lanes.mix_kfs ? n : 0,
+                                         lanes.mix_kfs ? 0.0 : 100.0);
+  if (rc != SBX_OK) return rc;
+  return ctx_set_sbg_mix_effect_keyframes_internal(ctx, lanes.mix_fx_kfs,
+                                                   lanes.mix_fx_kfs ? n : 0,
+                                                   ps->max_mix_fx_slots);
+
+oom:
+  set_ctx_error(ctx, "out of memory");
+  return SBX_ENOMEM;
+}
+
+/* Moves a table pc defined since the last window into w. */
+#define SBX_SBG_SEND_WAVE(field, bit)                                   \
+  do {                                                                  \
+    if (pc->field[i] && !(st->waves_sent[i] & (bit))) {                 \
+      w->field[i] = pc->field[i];                                       \
+      st->waves_sent[i] |= (bit);                                       \
+      w->new_waves = 1;                                                 \
+    }                                                                   \
+  } while (0)
+
+/* Pump side: builds the current queue and detaches it as a window. */
+static int
+sbx_sbg_stream_build_window(SbxSbgStream *st, SbxSbgWindow **out) {
+  SbxContext *pc = st->pctx;
+  size_t voices0 = pc->mv_voice_count;
+  size_t i;
+  SbxSbgWindow *w;
   int rc;
-  if (!ctx || !ctx->eng || !tone) return SBX_EINVAL;
 
-  rc = engine_apply_tone(ctx->eng, tone, 1);
+  *out = 0;
+  w = (SbxSbgWindow *)calloc(1, sizeof(*w));
+  if (!w) {
+    set_ctx_error(pc, "out of memory");
+    return SBX_ENOMEM;
+  }
+  rc = ctx_build_sbg_window(pc, &st->ps);
   if (rc != SBX_OK) {
-    set_ctx_error(ctx, sbx_engine_last_error(ctx->eng));
+    free(w);
     return rc;
   }
-  ctx_clear_keyframes(ctx);
-  ctx_clear_curve_source(ctx);
-  ctx->static_tone = ctx->eng->tone;
-  ctx->source_mode = SBX_CTX_SRC_STATIC;
-  ctx->loaded = 1;
-  ctx->t_sec = 0.0;
-  ctx_clear_live_controls_internal(ctx);
-  set_ctx_error(ctx, NULL);
-  return SBX_OK;
-}
-
-int
-sbx_context_set_default_waveform(SbxContext *ctx, int waveform) {
-  if (!ctx || !ctx->eng) return SBX_EINVAL;
-  if (waveform < SBX_WAVE_SINE || waveform > SBX_WAVE_SAWTOOTH) {
-    set_ctx_error(ctx, "default waveform must be SBX_WAVE_*");
-    return SBX_EINVAL;
+  w->kf_store = pc->kf_store;
+  w->kf_styles = pc->kf_styles;
+  w->kf_segs = pc->kf_segs;
+  w->kf_count = pc->kf_count;
+  memset(&pc->kf_store, 0, sizeof(pc->kf_store));
+  pc->kf_styles = 0;
+  pc->kf_segs = 0;
+  pc->kf_count = 0;
+  w->mix_kf = pc->mix_kf;
+  w->mix_kf_count = pc->mix_kf_count;
+  w->mix_default_amp_pct = pc->mix_default_amp_pct;
+  pc->mix_kf = 0;
+  pc->mix_kf_count = 0;
+  w->sbg_mix_fx_kf = pc->sbg_mix_fx_kf;
+  w->sbg_mix_fx_kf_count = pc->sbg_mix_fx_kf_count;
+  w->sbg_mix_fx_slots = pc->sbg_mix_fx_slots;
+  w->sbg_mix_fx_state = pc->sbg_mix_fx_state;
+  pc->sbg_mix_fx_kf = 0;
+  pc->sbg_mix_fx_kf_count = 0;
+  pc->sbg_mix_fx_slots = 0;
+  pc->sbg_mix_fx_state = 0;
+  w->voice_count = pc->mv_voice_count;
+  for (i = voices0; i < pc->mv_voice_count; i++) {
+    w->mv_eng[i - 1] = pc->mv_eng[i - 1];
+    pc->mv_eng[i - 1] = 0;
   }
-  ctx->default_waveform = waveform;
-  set_ctx_error(ctx, NULL);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    SBX_SBG_SEND_WAVE(legacy_env_waves, SBX_SBG_SENT_LEGACY);
+    SBX_SBG_SEND_WAVE(custom_env_waves, SBX_SBG_SENT_CUSTOM);
+    SBX_SBG_SEND_WAVE(spin_waves, SBX_SBG_SENT_SPIN);
+    SBX_SBG_SEND_WAVE(noise_profiles, SBX_SBG_SENT_NOISE);
+    w->legacy_env_edge_modes[i] = pc->legacy_env_edge_modes[i];
+    w->custom_env_edge_modes[i] = pc->custom_env_edge_modes[i];
+    w->spin_edge_modes[i] = pc->spin_edge_modes[i];
+  }
+  w->eof = st->eof;
+  *out = w;
   return SBX_OK;
 }
 
-int
-sbx_context_set_sequence_iso_override(SbxContext *ctx, const SbxIsoEnvelopeSpec *spec) {
-  if (!ctx || !ctx->eng) return SBX_EINVAL;
-  if (!spec) {
-    ctx->have_seq_iso_override = 0;
-    set_ctx_error(ctx, NULL);
-    return SBX_OK;
+#undef SBX_SBG_SEND_WAVE
+
+#define SBX_SBG_SWAP(type, field) \
+  do {                            \
+    type tmp_ = ctx->field;       \
+    ctx->field = w->field;        \
+    w->field = tmp_;              \
+  } while (0)
+
+/*
+ * Render side: swaps a built window in, keeping playback state (time,
+ * engine phases, mix-effect filters). What it replaces is left in w.
+ */
+static void
+ctx_install_sbg_window(SbxContext *ctx, SbxSbgWindow *w) {
+  size_t i;
+  int resync = w->new_waves;
+
+  for (i = 0; ctx->sbg_mix_fx_state && w->sbg_mix_fx_state &&
+              i < ctx->sbg_mix_fx_slots && i < w->sbg_mix_fx_slots; i++)
+    w->sbg_mix_fx_state[i] = ctx->sbg_mix_fx_state[i];
+  SBX_SBG_SWAP(SbxKeyframeStore, kf_store);
+  SBX_SBG_SWAP(unsigned char *, kf_styles);
+  SBX_SBG_SWAP(SbxKeyframeSegment *, kf_segs);
+  SBX_SBG_SWAP(size_t, kf_count);
+  SBX_SBG_SWAP(SbxMixAmpKeyframe *, mix_kf);
+  SBX_SBG_SWAP(size_t, mix_kf_count);
+  SBX_SBG_SWAP(double, mix_default_amp_pct);
+  SBX_SBG_SWAP(SbxMixFxKeyframe *, sbg_mix_fx_kf);
+  SBX_SBG_SWAP(size_t, sbg_mix_fx_kf_count);
+  SBX_SBG_SWAP(size_t, sbg_mix_fx_slots);
+  SBX_SBG_SWAP(SbxMixFxState *, sbg_mix_fx_state);
+  ctx->kf_seg = 0;
+  ctx->mix_kf_seg = 0;
+  ctx->sbg_mix_fx_seg = 0;
+  ctx->kf_duration_sec = ctx->kf_store.time_sec[ctx->kf_count - 1];
+
+  for (i = 0; w->new_waves && i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    if (w->legacy_env_waves[i]) SBX_SBG_SWAP(double *, legacy_env_waves[i]);
+    if (w->custom_env_waves[i]) SBX_SBG_SWAP(double *, custom_env_waves[i]);
+    if (w->spin_waves[i]) SBX_SBG_SWAP(double *, spin_waves[i]);
+    if (w->noise_profiles[i]) SBX_SBG_SWAP(SbxNoiseProfile *, noise_profiles[i]);
+    ctx->legacy_env_edge_modes[i] = w->legacy_env_edge_modes[i];
+    ctx->custom_env_edge_modes[i] = w->custom_env_edge_modes[i];
+    ctx->spin_edge_modes[i] = w->spin_edge_modes[i];
   }
-  if (!isfinite(spec->start) || spec->start < 0.0 || spec->start > 1.0 ||
-      !isfinite(spec->duty) || spec->duty < 0.0 || spec->duty > 1.0 ||
-      !isfinite(spec->attack) || spec->attack < 0.0 || spec->attack > 1.0 ||
-      !isfinite(spec->release) || spec->release < 0.0 || spec->release > 1.0 ||
-      (spec->attack + spec->release) > (1.0 + 1e-12) ||
-      spec->edge_mode < 0 || spec->edge_mode > 3) {
-    set_ctx_error(ctx, "sequence iso override is invalid");
-    return SBX_EINVAL;
+  /* ctx->mv_eng was sized for every voice when the stream opened. */
+  while (ctx->mv_voice_count < w->voice_count) {
+    size_t vi = ctx->mv_voice_count++;
+    ctx->mv_eng[vi - 1] = w->mv_eng[vi - 1];
+    w->mv_eng[vi - 1] = 0;
+    resync = 1;
   }
-  ctx->seq_iso_env = *spec;
-  ctx->have_seq_iso_override = 1;
-  set_ctx_error(ctx, NULL);
-  return SBX_OK;
+  if (resync) ctx_sync_custom_waves(ctx);
+}
+
+#undef SBX_SBG_SWAP
+
+static void
+ctx_sbg_stream_note_play(SbxContext *ctx) {
+  uint64_t bits;
+  memcpy(&bits, &ctx->t_sec, sizeof(bits));
+  SBX_STORE_RELEASE64(&ctx->sbg_stream->play_bits, bits);
 }
 
-int
-sbx_context_set_sequence_mixam_override(SbxContext *ctx, const SbxMixFxSpec *spec) {
-  if (!ctx || !ctx->eng) return SBX_EINVAL;
-  if (!spec) {
-    ctx->have_seq_mixam_override = 0;
-    set_ctx_error(ctx, NULL);
-    return SBX_OK;
+/*
+ * Installs whatever the pump has finished and checks that the window
+ * reaches past horizon_sec. Never reads or blocks: a window that falls
+ * short is counted as an underrun and playback holds its last keyframe.
+ */
+static int
+ctx_sbg_stream_take(SbxContext *ctx, double horizon_sec) {
+  SbxSbgStream *st = ctx->sbg_stream;
+  int rc;
+
+  while (st->ready_head != SBX_LOAD_ACQUIRE(&st->ready_tail) &&
+         st->retired_tail - SBX_LOAD_ACQUIRE(&st->retired_head) < SBX_SBG_RETIRED_CAP) {
+    SbxSbgWindow *w = st->ready[st->ready_head % SBX_SBG_READY_CAP];
+    SBX_STORE_RELEASE(&st->ready_head, st->ready_head + 1U);
+    ctx_install_sbg_window(ctx, w);
+    if (w->eof) SBX_STORE_RELEASE(&st->done, 1U);
+    st->retired[st->retired_tail % SBX_SBG_RETIRED_CAP] = w;
+    SBX_STORE_RELEASE(&st->retired_tail, st->retired_tail + 1U);
   }
-  if (spec->type != SBX_MIXFX_AM || sbx_validate_mixam_fields(spec) != SBX_OK) {
-    set_ctx_error(ctx, "sequence mixam override is invalid");
-    return SBX_EINVAL;
+  if (st->done || ctx->kf_store.time_sec[ctx->kf_count - 1] > horizon_sec)
+    return SBX_OK;
+  rc = (int)SBX_LOAD_ACQUIRE(&st->failed);
+  if (rc != SBX_OK && st->ready_head == SBX_LOAD_ACQUIRE(&st->ready_tail)) {
+    /* The pump no longer touches pctx once it has failed. */
+    set_ctx_error(ctx, st->pctx->last_error);
+    return rc;
   }
-  ctx->seq_mixam_env = *spec;
-  ctx->have_seq_mixam_override = 1;
-  set_ctx_error(ctx, NULL);
+  SBX_STORE_RELEASE(&st->underruns, st->underruns + 1U);
   return SBX_OK;
 }
 
 int
-sbx_context_load_tone_spec(SbxContext *ctx, const char *tone_spec) {
-  SbxToneSpec tone;
+sbx_context_pump_sbg_stream(SbxContext *ctx, double ahead_sec) {
+  SbxSbgStream *st;
+  SbxSbgParser *ps;
+  SbxSbgWindow *w = 0;
+  uint64_t bits;
+  double play_sec;
+  size_t drop = 0;
   int rc;
 
-  if (!ctx || !ctx->eng || !tone_spec) return SBX_EINVAL;
+  if (!ctx || !isfinite(ahead_sec) || ahead_sec < 0.0) return SBX_EINVAL;
+  st = ctx->sbg_stream;
+  if (!st) return SBX_OK;
+  ps = &st->ps;
 
-  rc = parse_tone_spec_with_default_waveform(tone_spec, ctx->default_waveform, &tone);
+  while (st->retired_head != SBX_LOAD_ACQUIRE(&st->retired_tail)) {
+    sbx_sbg_window_free(st->retired[st->retired_head % SBX_SBG_RETIRED_CAP]);
+    SBX_STORE_RELEASE(&st->retired_head, st->retired_head + 1U);
+  }
+  if (st->failed) return (int)st->failed;
+  if (st->eof || st->ready_tail - SBX_LOAD_ACQUIRE(&st->ready_head) >= SBX_SBG_READY_CAP)
+    return SBX_OK;
+  bits = SBX_LOAD_ACQUIRE64(&st->play_bits);
+  memcpy(&play_sec, &bits, sizeof(play_sec));
+  if (ps->frames[ps->count - 1].time_sec > play_sec + ahead_sec)
+    return SBX_OK;
+
+  /* Keep the frame that opens the segment playback is in. */
+  while (drop + 1 < ps->count && ps->frames[drop + 1].time_sec <= play_sec)
+    drop++;
+  if (drop > 0) {
+    memmove(ps->frames, ps->frames + drop, (ps->count - drop) * sizeof(*ps->frames));
+    ps->count -= drop;
+  }
+  /* Dropped frames may have been the last users of their bodies. */
+  rc = SBX_OK;
+  if (ps->body_count > 2 * ps->count + 64)
+    rc = sbx_sbg_parser_compact_bodies(ps);
+  if (rc == SBX_OK)
+    rc = sbx_sbg_stream_parse_ahead(st, play_sec + ahead_sec);
+  if (rc == SBX_OK)
+    rc = sbx_sbg_stream_build_window(st, &w);
+  sbx_parse_arena_reset(&ps->scratch);
   if (rc != SBX_OK) {
-    set_ctx_error(ctx, "invalid tone spec");
+    SBX_STORE_RELEASE(&st->failed, (unsigned int)rc);
     return rc;
   }
-  return sbx_context_set_tone(ctx, &tone);
+  st->ready[st->ready_tail % SBX_SBG_READY_CAP] = w;
+  SBX_STORE_RELEASE(&st->ready_tail, st->ready_tail + 1U);
+  return SBX_OK;
+}
+
+void
+sbx_default_sbg_stream_config(SbxSbgStreamConfig *cfg) {
+  if (!cfg) return;
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->window_frames = 64;
 }
 
 int
-sbx_context_load_curve_program(SbxContext *ctx,
-                               SbxCurveProgram *curve,
-                               const SbxCurveSourceConfig *cfg) {
-  SbxCurveSourceConfig local_cfg;
-  SbxToneSpec tone;
-  SbxCurveEvalPoint pt;
-  char err[160];
+sbx_context_open_sbg_timing_stream(SbxContext *ctx, FILE *stream, const SbxSbgStreamConfig *cfg_in) {
+  SbxSbgStreamConfig cfg;
+  SbxSbgStream *st;
+  SbxContext *pc;
+  SbxEngine **eng;
+  size_t i;
   int rc;
 
-  if (!ctx || !ctx->eng || !curve) return SBX_EINVAL;
-
-  sbx_default_curve_source_config(&local_cfg);
-  if (cfg) local_cfg = *cfg;
-  if (!curve->prepared) {
-    set_ctx_error(ctx, "curve program must be prepared before loading into context");
-    return SBX_EINVAL;
-  }
-  if (!(local_cfg.duration_sec > 0.0) || !isfinite(local_cfg.duration_sec)) {
-    set_ctx_error(ctx, "curve source duration_sec must be finite and > 0");
-    return SBX_EINVAL;
-  }
-  if (local_cfg.waveform < SBX_WAVE_SINE || local_cfg.waveform > SBX_WAVE_SAWTOOTH) {
-    set_ctx_error(ctx, "curve source waveform must be SBX_WAVE_*");
-    return SBX_EINVAL;
-  }
-  if (local_cfg.mode != SBX_TONE_BINAURAL &&
-      local_cfg.mode != SBX_TONE_MONAURAL &&
-      local_cfg.mode != SBX_TONE_ISOCHRONIC) {
-    set_ctx_error(ctx, "curve source mode must be binaural, monaural, or isochronic");
-    return SBX_EINVAL;
-  }
-  if (!isfinite(local_cfg.amplitude) || local_cfg.amplitude < 0.0) {
-    set_ctx_error(ctx, "curve source amplitude must be finite and >= 0");
+  if (!ctx || !ctx->eng || !stream) return SBX_EINVAL;
+  if (cfg_in)
+    cfg = *cfg_in;
+  else
+    sbx_default_sbg_stream_config(&cfg);
+  if (cfg.window_frames == 0) {
+    set_ctx_error(ctx, "sbg stream window must hold at least one keyframe");
     return SBX_EINVAL;
   }
-  if (local_cfg.mode == SBX_TONE_ISOCHRONIC) {
-    if (!isfinite(local_cfg.duty_cycle) || local_cfg.duty_cycle < 0.0 || local_cfg.duty_cycle > 1.0) {
-      set_ctx_error(ctx, "curve source duty_cycle must be in [0,1]");
-      return SBX_EINVAL;
-    }
-    if (!isfinite(local_cfg.iso_start) || local_cfg.iso_start < 0.0 || local_cfg.iso_start > 1.0) {
-      set_ctx_error(ctx, "curve source iso_start must be in [0,1]");
-      return SBX_EINVAL;
-    }
-    if (!isfinite(local_cfg.iso_attack) || local_cfg.iso_attack < 0.0 || local_cfg.iso_attack > 1.0) {
-      set_ctx_error(ctx, "curve source iso_attack must be in [0,1]");
-      return SBX_EINVAL;
-    }
-    if (!isfinite(local_cfg.iso_release) || local_cfg.iso_release < 0.0 || local_cfg.iso_release > 1.0) {
-      set_ctx_error(ctx, "curve source iso_release must be in [0,1]");
-      return SBX_EINVAL;
-    }
-    if ((local_cfg.iso_attack + local_cfg.iso_release) > (1.0 + 1e-12)) {
-      set_ctx_error(ctx, "curve source iso_attack + iso_release must be <= 1");
-      return SBX_EINVAL;
-    }
-    if (local_cfg.iso_edge_mode < 0 || local_cfg.iso_edge_mode > 3) {
-      set_ctx_error(ctx, "curve source iso_edge_mode must be 0..3");
-      return SBX_EINVAL;
+
+  st = (SbxSbgStream *)calloc(1, sizeof(*st));
+  if (!st || (cfg.initial_text && !(st->init_text = strdup(cfg.initial_text))) ||
+      !(st->pctx = sbx_context_create(&ctx->eng->cfg))) {
+    if (st) {
+      if (st->init_text) free(st->init_text);
+      free(st);
     }
+    set_ctx_error(ctx, "out of memory");
+    return SBX_ENOMEM;
   }
+  pc = st->pctx;
+  st->init_cursor = st->init_text;
+  st->fp = stream;
+  st->own_fp = cfg.take_stream_ownership ? 1 : 0;
+  st->window_frames = cfg.window_frames;
 
-  sbx_default_tone_spec(&tone);
-  tone.mode = local_cfg.mode;
-  tone.waveform = local_cfg.waveform;
-  tone.duty_cycle = local_cfg.duty_cycle;
-  tone.iso_start = local_cfg.iso_start;
-  tone.iso_attack = local_cfg.iso_attack;
-  tone.iso_release = local_cfg.iso_release;
-  tone.iso_edge_mode = local_cfg.iso_edge_mode;
-  tone.amplitude = local_cfg.amplitude;
+  /* Tables the stream defines stay in pc until a window hands them on. */
+  ctx_clear_custom_waves(ctx);
+  sbx_sbg_parser_init(&st->ps, pc, pc->legacy_env_waves, pc->custom_env_waves,
+                      pc->spin_waves, pc->noise_profiles, pc->legacy_env_edge_modes,
+                      pc->custom_env_edge_modes, pc->spin_edge_modes);
 
-  rc = sbx_curve_eval(curve, 0.0, &pt);
+  rc = sbx_sbg_stream_parse_ahead(st, 0.0);
   if (rc != SBX_OK) {
-    set_ctx_error(ctx, sbx_curve_last_error(curve));
-    return rc;
+    set_ctx_error(ctx, pc->last_error);
+  } else if (st->ps.count == 0) {
+    set_ctx_error(ctx, "sbg timing stream contains no keyframes");
+    rc = SBX_EINVAL;
   }
-  tone.carrier_hz = pt.carrier_hz;
-  tone.beat_hz = pt.beat_hz;
-  tone.amplitude = tone.amplitude * (pt.beat_amp_pct / 100.0);
-  if (tone.mode == SBX_TONE_MONAURAL || tone.mode == SBX_TONE_ISOCHRONIC)
-    tone.beat_hz = fabs(tone.beat_hz);
-
-  rc = normalize_tone(&tone, err, sizeof(err));
-  if (rc != SBX_OK) {
-    set_ctx_error(ctx, err);
-    return rc;
+  if (rc == SBX_OK) {
+    for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+      ctx->legacy_env_waves[i] = pc->legacy_env_waves[i];
+      ctx->custom_env_waves[i] = pc->custom_env_waves[i];
+      ctx->spin_waves[i] = pc->spin_waves[i];
+      ctx->noise_profiles[i] = pc->noise_profiles[i];
+      ctx->legacy_env_edge_modes[i] = pc->legacy_env_edge_modes[i];
+      ctx->custom_env_edge_modes[i] = pc->custom_env_edge_modes[i];
+      ctx->spin_edge_modes[i] = pc->spin_edge_modes[i];
+      st->waves_sent[i] = SBX_SBG_SENT_LEGACY | SBX_SBG_SENT_CUSTOM |
+                          SBX_SBG_SENT_SPIN | SBX_SBG_SENT_NOISE;
+    }
+    ctx_sync_custom_waves(ctx);
+    rc = ctx_activate_sbg_frames(ctx, &st->ps, 0);
+  }
+  sbx_parse_arena_reset(&st->ps.scratch);
+  /* Room for every voice now, so installing a window never allocates. */
+  if (rc == SBX_OK) {
+    eng = (SbxEngine **)realloc(ctx->mv_eng, (SBX_MAX_SBG_VOICES - 1) * sizeof(*eng));
+    if (eng) {
+      ctx->mv_eng = eng;
+      for (i = ctx->mv_voice_count; i < SBX_MAX_SBG_VOICES; i++)
+        eng[i - 1] = 0;
+    }
+    pc->mv_eng = (SbxEngine **)calloc(SBX_MAX_SBG_VOICES - 1, sizeof(*pc->mv_eng));
+    if (!eng || !pc->mv_eng) {
+      set_ctx_error(ctx, "out of memory");
+      rc = SBX_ENOMEM;
+    }
+    pc->mv_voice_count = ctx->mv_voice_count;
   }
-  rc = engine_apply_tone(ctx->eng, &tone, 1);
   if (rc != SBX_OK) {
-    set_ctx_error(ctx, sbx_engine_last_error(ctx->eng));
+    /* The caller still owns the FILE * on failure. */
+    st->own_fp = 0;
+    sbx_sbg_stream_free(st);
     return rc;
   }
-
-  ctx_clear_keyframes(ctx);
-  ctx_clear_curve_source(ctx);
-  ctx->curve_prog = curve;
-  tone.amplitude = local_cfg.amplitude;
-  ctx->curve_tone = tone;
-  ctx->curve_duration_sec = local_cfg.duration_sec;
-  ctx->curve_loop = local_cfg.loop ? 1 : 0;
-  ctx->source_mode = SBX_CTX_SRC_CURVE;
-  ctx->loaded = 1;
-  ctx->t_sec = 0.0;
-  ctx_clear_live_controls_internal(ctx);
-  set_ctx_error(ctx, NULL);
+  ctx->sbg_stream = st;
+  st->done = (unsigned int)st->eof;
+  ctx_sbg_stream_note_play(ctx);
   return SBX_OK;
 }
 
 int
-sbx_context_load_keyframes(SbxContext *ctx,
-                           const SbxProgramKeyframe *frames,
-                           size_t frame_count,
-                           int loop) {
-  return ctx_activate_keyframes_internal(ctx, frames, frame_count, frames, 1, 0, loop);
+sbx_context_is_streaming(const SbxContext *ctx) {
+  return ctx && ctx->sbg_stream && !SBX_LOAD_ACQUIRE(&ctx->sbg_stream->done);
 }
 
-int
-sbx_context_load_sequence_text(SbxContext *ctx, const char *text, int loop) {
-  char *buf = 0, *line = 0, *next = 0;
-  size_t line_no = 0;
-  SbxProgramKeyframe *frames = 0;
-  size_t count = 0, cap = 0;
-  int rc = SBX_OK;
+unsigned int
+sbx_context_sbg_stream_underruns(const SbxContext *ctx) {
+  if (!ctx || !ctx->sbg_stream) return 0;
+  return SBX_LOAD_ACQUIRE(&ctx->sbg_stream->underruns);
+}
+
+/*
+ * Incremental validation sessions. The document is an array of line
+ * records. Each record caches what the line is on its own (shape, the name
+ * it defines, the names its tokens may refer to) and what its last parse
+ * gave (diagnostic, tone-set frame or block entries). Names map to the
+ * lines that define them and the lines that use them, so a definition
+ * whose value changes marks just its later users for re-parsing.
+ *
+ * After an edit a structure pass over the cached records recomputes what
+ * each line is in context (preamble, inside which block, anchored by an
+ * earlier absolute time), then a sweep re-parses the marked lines in order
+ * with a parser whose tables hold only the definitions that line needs,
+ * taken from the cache. A block is always re-parsed whole, since entry
+ * offsets must be non-decreasing. Each line is parsed as if every earlier
+ * line had succeeded, except that failed definitions are left out.
+ */
+enum {
+  SBX_VS_BLANK = 0,
+  SBX_VS_OPTION,
+  SBX_VS_WAVE,   /* waveNN/customNN/noiseNN/spinNN definition */
+  SBX_VS_OPEN,   /* name: { */
+  SBX_VS_DEF,    /* named tone-set */
+  SBX_VS_TIMING,
+  SBX_VS_ENTRY,  /* inside a block */
+  SBX_VS_CLOSE
+};
+
+typedef struct SbxVsLine SbxVsLine;
+typedef struct SbxVsName SbxVsName;
+
+typedef struct {
+  SbxVsName *name;
+  size_t slot;     /* index in name->refs */
+} SbxVsRef;
+
+typedef struct {
+  SbxVsLine *line;
+  size_t k;        /* index in line->refs */
+} SbxVsUse;
+
+struct SbxVsName {
+  char *name;
+  SbxVsLine **defs; /* lines currently in a defining position */
+  size_t ndefs, defs_cap;
+  SbxVsUse *refs;
+  size_t nrefs, refs_cap;
+};
+
+struct SbxVsLine {
+  char *text;              /* without the '\n' */
+  size_t pos;
+  unsigned char shape;     /* SBX_VS_* as a top-level line */
+  unsigned char kind;      /* SBX_VS_* in context */
+  unsigned char skip;      /* blank or comment for the preamble scan */
+  unsigned char option;    /* starts with '-' */
+  unsigned char anchors;   /* time token parses without an earlier time */
+  unsigned char anchored;  /* parsed after an anchoring line */
+  unsigned char dirty;
+  unsigned char ok;
+  unsigned char has_diag;
+  unsigned char has_tail;  /* OPEN: unterminated block */
+  SbxVsLine *owner;        /* OPEN line of the enclosing block */
+  size_t block_end;        /* OPEN: closing line, or the last line */
+  SbxVsName *def_name;     /* name defined by the shape, if any */
+  size_t def_slot;         /* index in def_name->defs; -1 if not listed */
+  SbxVsRef *refs;
+  size_t nrefs;
+  SbxVoiceSetKeyframe *frame;   /* DEF value */
+  SbxVoiceSetKeyframe *entries; /* OPEN value */
+  size_t nentries;
+  size_t emits;            /* TIMING: keyframes queued */
+  SbxDiagnostic diag;
+  SbxDiagnostic tail_diag;
+};
+
+/* Preamble settings that change how lines parse. */
+typedef struct {
+  int have_r, rate;
+  int have_w, waveform;
+  int have_I;
+  SbxIsoEnvelopeSpec iso_env;
+  int have_H;
+  SbxMixFxSpec mixam_env;
+  int have_c;
+  SbxAmpAdjustSpec amp_adjust;
+} SbxVsConfig;
+
+/* Field-wise, like sbx_voice_set_frame_same; see there for why. */
+static int
+sbx_vs_config_same(const SbxVsConfig *a, const SbxVsConfig *b) {
+  size_t i;
+  if (a->have_r != b->have_r || a->rate != b->rate || a->have_w != b->have_w ||
+      a->waveform != b->waveform || a->have_I != b->have_I ||
+      !sbx_same_double(a->iso_env.start, b->iso_env.start) ||
+      !sbx_same_double(a->iso_env.duty, b->iso_env.duty) ||
+      !sbx_same_double(a->iso_env.attack, b->iso_env.attack) ||
+      !sbx_same_double(a->iso_env.release, b->iso_env.release) ||
+      a->iso_env.edge_mode != b->iso_env.edge_mode || a->have_H != b->have_H ||
+      !sbx_mix_fx_spec_same(&a->mixam_env, &b->mixam_env) || a->have_c != b->have_c ||
+      a->amp_adjust.point_count != b->amp_adjust.point_count)
+    return 0;
+  for (i = 0; i < a->amp_adjust.point_count; i++)
+    if (!sbx_same_double(a->amp_adjust.points[i].freq_hz, b->amp_adjust.points[i].freq_hz) ||
+        !sbx_same_double(a->amp_adjust.points[i].adj, b->amp_adjust.points[i].adj))
+      return 0;
+  return 1;
+}
+
+struct SbxValidateSession {
+  SbxVsLine **lines;
+  size_t count, cap;
+  size_t region;           /* leading preamble lines */
+  SbxVsLine *tail_block;   /* unterminated block, if any */
+  SbxParseArena name_arena;
+  SbxNameIndex name_index;
+  SbxVsName **names;
+  size_t nnames, names_cap;
+  SbxVsName **pending;     /* definitions removed by the current edit */
+  size_t npending, pending_cap;
+  SbxContext *ctx;
+  SbxVsConfig cfg;
+  int have_A;
+  SbxMixModSpec mix_mod;
+  int have_pre_diag, have_cfg_diag;
+  SbxDiagnostic pre_diag, cfg_diag;
+  SbxSbgParser ps;
+  double *legacy_env_waves[SBX_CUSTOM_WAVE_COUNT];
+  double *custom_env_waves[SBX_CUSTOM_WAVE_COUNT];
+  double *spin_waves[SBX_CUSTOM_WAVE_COUNT];
+  SbxNoiseProfile *noise_profiles[SBX_CUSTOM_WAVE_COUNT];
+  int legacy_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int custom_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int spin_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  double wave_taken;       /* placeholder table for "already defined" */
+  char *buf;
+  size_t buf_cap;
+  SbxDiagnostic *diags;
+  size_t ndiags, diags_cap;
+  size_t revalidated;
+};
+
+static int
+sbx_vs_grow(void **arr, size_t *cap, size_t need, size_t elem) {
+  size_t ncap;
+  void *tmp;
+  if (need <= *cap) return SBX_OK;
+  ncap = *cap ? *cap : 8;
+  while (ncap < need) ncap *= 2;
+  if (ncap > ((size_t)-1) / elem) return SBX_ENOMEM;
+  tmp = realloc(*arr, ncap * elem);
+  if (!tmp) return SBX_ENOMEM;
+  *arr = tmp;
+  *cap = ncap;
+  return SBX_OK;
+}
+
+static SbxVsName *
+sbx_vs_name(SbxValidateSession *s, const char *name, size_t len) {
+  SbxVsName *nm;
+  char *key;
+  int idx;
+
+  if (sbx_vs_grow((void **)&s->buf, &s->buf_cap, len + 1, 1) != SBX_OK) return 0;
+  memcpy(s->buf, name, len);
+  s->buf[len] = 0;
+  idx = sbx_name_index_find(&s->name_index, s->buf);
+  if (idx >= 0) return s->names[idx];
+  if (sbx_vs_grow((void **)&s->names, &s->names_cap, s->nnames + 1, sizeof(*s->names)) != SBX_OK)
+    return 0;
+  nm = (SbxVsName *)sbx_parse_arena_alloc(&s->name_arena, sizeof(*nm));
+  key = sbx_parse_arena_strdup(&s->name_arena, s->buf);
+  if (!nm || !key ||
+      sbx_name_index_add(&s->name_arena, &s->name_index, key, (int)s->nnames) != SBX_OK)
+    return 0;
+  nm->name = key;
+  s->names[s->nnames++] = nm;
+  return nm;
+}
+
+/* Marks the users and definitions of nm at from or later for re-parsing. */
+static void
+sbx_vs_touch(SbxVsName *nm, size_t from) {
+  size_t i;
+  if (!nm) return;
+  for (i = 0; i < nm->nrefs; i++)
+    if (nm->refs[i].line->pos >= from) nm->refs[i].line->dirty = 1;
+  for (i = 0; i < nm->ndefs; i++)
+    if (nm->defs[i]->pos >= from) nm->defs[i]->dirty = 1;
+}
+
+static int
+sbx_vs_list_def(SbxVsLine *ln) {
+  SbxVsName *nm = ln->def_name;
+  if (sbx_vs_grow((void **)&nm->defs, &nm->defs_cap, nm->ndefs + 1, sizeof(*nm->defs)) != SBX_OK)
+    return SBX_ENOMEM;
+  ln->def_slot = nm->ndefs;
+  nm->defs[nm->ndefs++] = ln;
+  return SBX_OK;
+}
+
+static void
+sbx_vs_unlist_def(SbxVsLine *ln) {
+  SbxVsName *nm = ln->def_name;
+  SbxVsLine *last;
+  if (!nm || ln->def_slot == (size_t)-1) return;
+  last = nm->defs[--nm->ndefs];
+  nm->defs[ln->def_slot] = last;
+  last->def_slot = ln->def_slot;
+  ln->def_slot = (size_t)-1;
+}
+
+static void
+sbx_vs_line_free(SbxVsLine *ln) {
+  size_t k;
+  if (!ln) return;
+  for (k = 0; k < ln->nrefs; k++) {
+    SbxVsName *nm = ln->refs[k].name;
+    SbxVsUse last = nm->refs[--nm->nrefs];
+    nm->refs[ln->refs[k].slot] = last;
+    last.line->refs[last.k].slot = ln->refs[k].slot;
+  }
+  sbx_vs_unlist_def(ln);
+  free(ln->refs);
+  free(ln->frame);
+  free(ln->entries);
+  free(ln->text);
+  free(ln);
+}
+
+static int
+sbx_vs_is_wave_name(const char *name) {
+  int n;
+  if (strncmp(name, "wave", 4) == 0 || strncmp(name, "spin", 4) == 0) n = 4;
+  else if (strncmp(name, "custom", 6) == 0) n = 6;
+  else if (strncmp(name, "noise", 5) == 0) n = 5;
+  else return 0;
+  return isdigit((unsigned char)name[n]) && isdigit((unsigned char)name[n + 1]) && !name[n + 2];
+}
+
+/*
+ * Builds the record for len bytes of text: the same prefix handling as
+ * sbx_sbg_parse_line, the preamble tests of sbx_prepare_safe_seq_text, and
+ * the name graph links for the defined name and the remaining tokens.
+ */
+static SbxVsLine *
+sbx_vs_line_new(SbxValidateSession *s, const char *text, size_t len) {
+  SbxVsLine *ln = (SbxVsLine *)calloc(1, sizeof(*ln));
+  char *p, *q, *rest;
+  size_t l0, k;
+
+  if (!ln) return 0;
+  ln->def_slot = (size_t)-1;
+  ln->dirty = 1;
+  ln->text = (char *)malloc(len + 1);
+  if (!ln->text) goto fail;
+  memcpy(ln->text, text, len);
+  ln->text[len] = 0;
+
+  p = ln->text;
+  while (*p && isspace((unsigned char)*p)) p++;
+  ln->skip = (!*p || *p == '#' || *p == ';' || (*p == '/' && p[1] == '/'));
+  ln->option = (*p == '-');
+
+  if (sbx_vs_grow((void **)&s->buf, &s->buf_cap, len + 1, 1) != SBX_OK) goto fail;
+  memcpy(s->buf, ln->text, len + 1);
+  if (len && s->buf[len - 1] == '\r') s->buf[len - 1] = 0;
+  strip_inline_comment(s->buf);
+  rstrip_inplace(s->buf);
+  p = (char *)skip_ws(s->buf);
+  if (*p == 0) {
+    ln->shape = SBX_VS_BLANK;
+    return ln;
+  }
+  q = p;
+  while (*q && !isspace((unsigned char)*q)) q++;
+  if (*q) {
+    *q++ = 0;
+    rest = (char *)skip_ws(q);
+  } else {
+    rest = q;
+  }
+
+  ln->shape = SBX_VS_TIMING;
+  l0 = strlen(p);
+  if (strcmp(p, "}") == 0) {
+    ln->shape = SBX_VS_CLOSE;
+  } else if (l0 > 1 && p[l0 - 1] == ':') {
+    double ttmp;
+    p[l0 - 1] = 0;
+    if (parse_hhmmss_token(p, &ttmp) != SBX_OK) {
+      if (sbx_vs_is_wave_name(p)) ln->shape = SBX_VS_WAVE;
+      else if (strcmp(rest, "{") == 0) ln->shape = SBX_VS_OPEN;
+      else ln->shape = SBX_VS_DEF;
+    } else {
+      p[l0 - 1] = ':';
+    }
+  }
+  if (ln->shape == SBX_VS_TIMING && *rest) {
+    double last_abs = -1.0, tsec;
+    ln->anchors = (parse_sbg_timeline_time_token(p, &last_abs, &tsec) == SBX_OK);
+  }
+
+  /* sbx_vs_name reuses s->buf, so take the tokens' offsets first. */
+  {
+    size_t name_off = (size_t)(p - s->buf), name_len = strlen(p);
+    size_t rest_off = (size_t)(rest - s->buf), rest_len = strlen(rest);
+    size_t ntok = 0, i;
+    char *work;
+    int is_def = (ln->shape == SBX_VS_WAVE || ln->shape == SBX_VS_OPEN || ln->shape == SBX_VS_DEF);
+
+    work = (char *)malloc(rest_len + name_len + 2);
+    if (!work) goto fail;
+    memcpy(work, s->buf + name_off, name_len + 1);
+    memcpy(work + name_len + 1, s->buf + rest_off, rest_len + 1);
+    if (is_def) {
+      ln->def_name = sbx_vs_name(s, work, name_len);
+      if (!ln->def_name) {
+        free(work);
+        goto fail;
+      }
+    }
+    /* Wave samples are numbers, never names. */
+    if (ln->shape != SBX_VS_WAVE) {
+      char *r = work + name_len + 1;
+      for (i = 0; r[i]; ) {
+        while (r[i] && isspace((unsigned char)r[i])) i++;
+        if (r[i]) ntok++;
+        while (r[i] && !isspace((unsigned char)r[i])) i++;
+      }
+      if (ntok) {
+        ln->refs = (SbxVsRef *)calloc(ntok, sizeof(*ln->refs));
+        if (!ln->refs) {
+          free(work);
+          goto fail;
+        }
+      }
+      for (i = 0; r[i]; ) {
+        size_t start;
+        SbxVsName *nm;
+        while (r[i] && isspace((unsigned char)r[i])) i++;
+        if (!r[i]) break;
+        start = i;
+        while (r[i] && !isspace((unsigned char)r[i])) i++;
+        nm = sbx_vs_name(s, r + start, i - start);
+        if (!nm || sbx_vs_grow((void **)&nm->refs, &nm->refs_cap, nm->nrefs + 1,
+                               sizeof(*nm->refs)) != SBX_OK) {
+          free(work);
+          goto fail;
+        }
+        k = ln->nrefs++;
+        ln->refs[k].name = nm;
+        ln->refs[k].slot = nm->nrefs;
+        nm->refs[nm->nrefs].line = ln;
+        nm->refs[nm->nrefs].k = k;
+        nm->nrefs++;
+      }
+    }
+    free(work);
+  }
+  return ln;
+
+fail:
+  sbx_vs_line_free(ln);
+  return 0;
+}
+
+/* Appends the records for text (split on '\n') to out. */
+static int
+sbx_vs_split(SbxValidateSession *s, const char *text, SbxVsLine ***out, size_t *out_count) {
+  const char *p = text;
+  size_t n = 1, i = 0;
+  SbxVsLine **v;
+
+  *out = 0;
+  *out_count = 0;
+  for (; *p; p++)
+    if (*p == '\n') n++;
+  v = (SbxVsLine **)calloc(n, sizeof(*v));
+  if (!v) return SBX_ENOMEM;
+  p = text;
+  for (i = 0; i < n; i++) {
+    const char *eol = strchr(p, '\n');
+    size_t len = eol ? (size_t)(eol - p) : strlen(p);
+    v[i] = sbx_vs_line_new(s, p, len);
+    if (!v[i]) {
+      while (i > 0) sbx_vs_line_free(v[--i]);
+      free(v);
+      return SBX_ENOMEM;
+    }
+    p += len + (eol ? 1 : 0);
+  }
+  *out = v;
+  *out_count = n;
+  return SBX_OK;
+}
 
-  if (!ctx || !ctx->eng || !text) return SBX_EINVAL;
+static void
+sbx_vs_refine(const SbxValidateSession *s, SbxDiagnostic *diag) {
+  const char *start, *end;
+  if (diag->line == 0 || diag->line > s->count) return;
+  start = s->lines[diag->line - 1]->text;
+  for (end = start; *end && *end != '\r'; end++) {}
+  sbx_diag_refine_span_in_line(diag, start, end);
+}
 
-  buf = sbx_strdup_local(text);
-  if (!buf) {
-    set_ctx_error(ctx, "out of memory");
-    return SBX_ENOMEM;
+/* The context's error as a diagnostic, spanned as sbx_validate_sbg_text does. */
+static void
+sbx_vs_ctx_diag(const SbxValidateSession *s, SbxDiagnostic *diag) {
+  const SbxContext *ctx = s->ctx;
+  sbx_diag_fill(diag, SBX_DIAG_ERROR, "sbg-parse",
+                ctx->last_error[0] ? ctx->last_error : "SBaGenX validation failed");
+  if (ctx->last_error_line) {
+    diag->line = ctx->last_error_line;
+    diag->column = ctx->last_error_column;
+    diag->end_line = ctx->last_error_end_line;
+    diag->end_column = ctx->last_error_end_column;
+  } else {
+    sbx_vs_refine(s, diag);
   }
+}
 
-  line = buf;
-  while (line && *line) {
-    char *p, *q;
-    char *time_tok;
-    char *tone_tok;
-    char *interp_tok = 0;
-    int interp = SBX_INTERP_LINEAR;
-    double tsec;
-    SbxToneSpec tone;
+/*
+ * Re-reads the preamble region. A change to the settings that affect
+ * parsing rebuilds the context and marks every line for re-parsing.
+ */
+static int
+sbx_vs_update_preamble(SbxValidateSession *s) {
+  SbxSafeSeqfilePreamble cfg;
+  SbxVsConfig key;
+  SbxEngineConfig eng_cfg;
+  char errbuf[512];
+  char *region = 0, *prepared = 0;
+  size_t len = 0, i;
+  int rc;
 
-    line_no++;
-    next = strchr(line, '\n');
-    if (next) {
-      *next = 0;
-      next++;
-    }
+  for (i = 0; i < s->region; i++)
+    len += strlen(s->lines[i]->text) + 1;
+  region = (char *)malloc(len + 1);
+  if (!region) return SBX_ENOMEM;
+  len = 0;
+  for (i = 0; i < s->region; i++) {
+    size_t n = strlen(s->lines[i]->text);
+    memcpy(region + len, s->lines[i]->text, n);
+    region[len + n] = '\n';
+    len += n + 1;
+  }
+  region[len] = 0;
 
-    if (line[0] && line[strlen(line) - 1] == '\r')
-      line[strlen(line) - 1] = 0;
+  errbuf[0] = 0;
+  sbx_default_safe_seqfile_preamble(&cfg);
+  rc = sbx_prepare_safe_seq_text(region, &prepared, &cfg, errbuf, sizeof(errbuf));
+  free(prepared);
+  s->have_pre_diag = 0;
+  if (rc == SBX_EINVAL) {
+    sbx_diag_fill(&s->pre_diag, SBX_DIAG_ERROR, "sbg-parse",
+                  errbuf[0] ? errbuf : "SBaGenX validation failed");
+    sbx_diag_refine_span_from_source(&s->pre_diag, region);
+    s->have_pre_diag = 1;
+  } else if (rc != SBX_OK) {
+    free(region);
+    sbx_free_safe_seqfile_preamble(&cfg);
+    return rc;
+  }
+  free(region);
+
+  memset(&key, 0, sizeof(key));
+  key.have_r = cfg.have_r;
+  key.rate = cfg.rate;
+  key.have_w = cfg.have_w;
+  key.waveform = cfg.waveform;
+  key.have_I = cfg.have_I;
+  key.iso_env = cfg.iso_env;
+  key.have_H = cfg.have_H;
+  key.mixam_env = cfg.mixam_env;
+  key.have_c = cfg.have_c;
+  key.amp_adjust = cfg.amp_adjust;
+  s->have_A = cfg.have_A;
+  s->mix_mod = cfg.mix_mod;
+  sbx_free_safe_seqfile_preamble(&cfg);
 
-    strip_inline_comment(line);
-    rstrip_inplace(line);
-    p = (char *)skip_ws(line);
-    if (*p == 0) {
-      line = next;
-      continue;
-    }
+  if (s->ctx && sbx_vs_config_same(&key, &s->cfg))
+    return SBX_OK;
 
-    q = p;
-    while (*q && !isspace((unsigned char)*q)) q++;
-    if (*q == 0) {
-      char emsg[192];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: expected '<time> <tone-spec>'",
-               (unsigned long)line_no);
-      set_ctx_error(ctx, emsg);
-      rc = SBX_EINVAL;
-      goto done;
-    }
-    *q++ = 0;
-    q = (char *)skip_ws(q);
-    if (*q == 0) {
-      char emsg[192];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: missing tone-spec",
-               (unsigned long)line_no);
-      set_ctx_error(ctx, emsg);
-      rc = SBX_EINVAL;
-      goto done;
-    }
+  sbx_default_engine_config(&eng_cfg);
+  if (key.have_r)
+    eng_cfg.sample_rate = (double)key.rate;
+  if (s->ctx) sbx_context_destroy(s->ctx);
+  s->ctx = sbx_context_create(&eng_cfg);
+  if (!s->ctx) return SBX_ENOMEM;
+  s->ps.ctx = s->ctx;
+  s->cfg = key;
+  s->have_cfg_diag = 0;
+  if ((key.have_w && sbx_context_set_default_waveform(s->ctx, key.waveform) != SBX_OK) ||
+      (key.have_I && sbx_context_set_sequence_iso_override(s->ctx, &key.iso_env) != SBX_OK) ||
+      (key.have_H && sbx_context_set_sequence_mixam_override(s->ctx, &key.mixam_env) != SBX_OK) ||
+      (key.have_c && sbx_context_set_amp_adjust(s->ctx, &key.amp_adjust) != SBX_OK)) {
+    sbx_vs_ctx_diag(s, &s->cfg_diag);
+    s->have_cfg_diag = 1;
+  }
+  for (i = 0; i < s->count; i++)
+    s->lines[i]->dirty = 1;
+  return SBX_OK;
+}
 
-    time_tok = p;
-    tone_tok = q;
+/*
+ * Recomputes each line's kind in context, its block and whether an
+ * earlier line anchors relative times; lines whose answer changed are
+ * marked, and definition lists follow the kinds.
+ */
+static int
+sbx_vs_restructure(SbxValidateSession *s) {
+  SbxVsLine *blk = 0;
+  int in_region = 1, anchored = 0;
+  size_t i;
 
-    {
-      char *r = q;
-      while (*r && !isspace((unsigned char)*r)) r++;
-      if (*r) {
-        *r++ = 0;
-        r = (char *)skip_ws(r);
-        if (*r) {
-          interp_tok = r;
-          while (*r && !isspace((unsigned char)*r)) r++;
-          if (*r) {
-            *r++ = 0;
-            r = (char *)skip_ws(r);
-            if (*r) {
-              char emsg[224];
-              snprintf(emsg, sizeof(emsg),
-                       "line %lu: unexpected trailing token '%s'",
-                       (unsigned long)line_no, r);
-              set_ctx_error_range_span(ctx, emsg, line_no, line, r, strlen(r));
-              rc = SBX_EINVAL;
-              goto done;
-            }
-          }
-        }
+  s->region = 0;
+  for (i = 0; i < s->count; i++) {
+    SbxVsLine *ln = s->lines[i];
+    SbxVsLine *owner = 0;
+    int kind;
+    int listed;
+
+    if (in_region && (ln->skip || ln->option)) {
+      s->region = i + 1;
+      kind = ln->option ? SBX_VS_OPTION : SBX_VS_BLANK;
+    } else if (blk) {
+      in_region = 0;
+      owner = blk;
+      kind = ln->shape == SBX_VS_BLANK ? SBX_VS_BLANK
+           : (ln->shape == SBX_VS_CLOSE ? SBX_VS_CLOSE : SBX_VS_ENTRY);
+      if (kind == SBX_VS_CLOSE) {
+        blk->block_end = i;
+        blk = 0;
+      }
+    } else {
+      in_region = 0;
+      kind = ln->shape == SBX_VS_CLOSE ? SBX_VS_TIMING : ln->shape;
+      if (kind == SBX_VS_OPEN) {
+        blk = ln;
+        ln->block_end = s->count - 1;
       }
     }
 
-    rc = parse_time_seconds_token(time_tok, &tsec);
-    if (rc != SBX_OK) {
-      char emsg[224];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: invalid time token '%s' (use s/m/h suffix or seconds default)",
-               (unsigned long)line_no, time_tok);
-      set_ctx_error_token_span(ctx, emsg, line_no, line, time_tok);
-      rc = SBX_EINVAL;
-      goto done;
-    }
-
-    rc = parse_tone_spec_with_default_waveform(tone_tok, ctx->default_waveform, &tone);
-    if (rc != SBX_OK) {
-      char emsg[224];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: invalid tone-spec '%s'",
-               (unsigned long)line_no, tone_tok);
-      set_ctx_error_token_span(ctx, emsg, line_no, line, tone_tok);
-      rc = SBX_EINVAL;
-      goto done;
-    }
-    sbx_apply_sequence_iso_override(&tone, ctx);
-
-    if (interp_tok) {
-      rc = parse_interp_mode_token(interp_tok, &interp);
-      if (rc != SBX_OK) {
-        char emsg[224];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: invalid interpolation token '%s' (use linear|ramp|step|hold)",
-                 (unsigned long)line_no, interp_tok);
-        set_ctx_error_token_span(ctx, emsg, line_no, line, interp_tok);
-        rc = SBX_EINVAL;
-        goto done;
+    if (kind != ln->kind || owner != ln->owner) {
+      ln->dirty = 1;
+      if (ln->kind == SBX_VS_ENTRY || ln->kind == SBX_VS_CLOSE) {
+        if (ln->owner && ln->owner != owner) ln->owner->dirty = 1;
       }
     }
+    ln->kind = (unsigned char)kind;
+    ln->owner = owner;
 
-    if (count == cap) {
-      size_t ncap = cap ? (cap * 2) : 8;
-      SbxProgramKeyframe *tmp;
-      tmp = (SbxProgramKeyframe *)realloc(frames, ncap * sizeof(*frames));
-      if (!tmp) {
-        set_ctx_error(ctx, "out of memory");
-        rc = SBX_ENOMEM;
-        goto done;
+    listed = (kind == SBX_VS_WAVE || kind == SBX_VS_OPEN || kind == SBX_VS_DEF);
+    if (listed != (ln->def_slot != (size_t)-1)) {
+      if (listed) {
+        if (sbx_vs_list_def(ln) != SBX_OK) return SBX_ENOMEM;
+      } else {
+        sbx_vs_unlist_def(ln);
       }
-      frames = tmp;
-      cap = ncap;
+      sbx_vs_touch(ln->def_name, i + 1);
     }
 
-    frames[count].time_sec = tsec;
-    frames[count].tone = tone;
-    frames[count].interp = interp;
-    count++;
-    line = next;
+    if (kind == SBX_VS_TIMING) {
+      if (ln->anchored != anchored) ln->dirty = 1;
+      ln->anchored = (unsigned char)anchored;
+      if (ln->anchors) anchored = 1;
+    }
   }
+  s->tail_block = blk;
+  return SBX_OK;
+}
 
-  if (count == 0) {
-    set_ctx_error(ctx, "sequence text contains no keyframes");
-    rc = SBX_EINVAL;
-    goto done;
+/* Empties the mini parser; last_abs seeds relative timing. */
+static void
+sbx_vs_rewind(SbxValidateSession *s, double last_abs) {
+  SbxSbgParser *ps = &s->ps;
+  sbx_parse_arena_reset(&ps->arena);
+  sbx_parse_arena_reset(&ps->scratch);
+  sbx_sbg_parser_reset_bodies(ps);
+  ps->frames = 0;
+  ps->count = ps->cap = 0;
+  ps->defs = 0;
+  ps->ndefs = ps->defs_cap = 0;
+  ps->blocks = 0;
+  ps->nblocks = ps->blocks_cap = 0;
+  memset(&ps->def_index, 0, sizeof(ps->def_index));
+  memset(&ps->block_index, 0, sizeof(ps->block_index));
+  ps->active_block_idx = -1;
+  ps->active_block_last_off = -1.0;
+  ps->last_abs_sec = last_abs;
+  ps->last_emit_sec = -1.0;
+}
+
+/* Loads the latest good tone-set and block named nm before line limit. */
+static int
+sbx_vs_resolve(SbxValidateSession *s, SbxVsName *nm, size_t limit) {
+  SbxSbgParser *ps = &s->ps;
+  SbxVsLine *tone = 0, *blk = 0;
+  size_t i;
+
+  if (!nm || nm->ndefs == 0) return SBX_OK;
+  if (named_tone_find(ps->defs, ps->ndefs, &ps->def_index, nm->name) >= 0 ||
+      named_block_find(ps->blocks, ps->nblocks, &ps->block_index, nm->name) >= 0)
+    return SBX_OK;
+  for (i = 0; i < nm->ndefs; i++) {
+    SbxVsLine *d = nm->defs[i];
+    if (!d->ok || d->pos >= limit) continue;
+    if (d->kind == SBX_VS_DEF && (!tone || d->pos > tone->pos)) tone = d;
+    if (d->kind == SBX_VS_OPEN && (!blk || d->pos > blk->pos)) blk = d;
+  }
+  if (tone) {
+    SbxNamedToneDef *def;
+    if (sbx_parse_arena_reserve(&ps->arena, (void **)&ps->defs, &ps->defs_cap, ps->ndefs,
+                                sizeof(*ps->defs)) != SBX_OK)
+      return SBX_ENOMEM;
+    def = &ps->defs[ps->ndefs];
+    def->name = nm->name;
+    def->frame = *tone->frame;
+    if (sbx_name_index_add(&ps->arena, &ps->def_index, nm->name, (int)ps->ndefs) != SBX_OK)
+      return SBX_ENOMEM;
+    ps->ndefs++;
   }
+  if (blk) {
+    SbxNamedBlockDef *def;
+    if (sbx_parse_arena_reserve(&ps->arena, (void **)&ps->blocks, &ps->blocks_cap, ps->nblocks,
+                                sizeof(*ps->blocks)) != SBX_OK)
+      return SBX_ENOMEM;
+    def = &ps->blocks[ps->nblocks];
+    def->name = nm->name;
+    def->count = def->cap = blk->nentries;
+    def->entries = 0;
+    if (blk->nentries) {
+      def->entries = (SbxVoiceSetKeyframe *)sbx_parse_arena_alloc(
+          &ps->arena, blk->nentries * sizeof(*def->entries));
+      if (!def->entries) return SBX_ENOMEM;
+      memcpy(def->entries, blk->entries, blk->nentries * sizeof(*def->entries));
+    }
+    if (sbx_name_index_add(&ps->arena, &ps->block_index, nm->name, (int)ps->nblocks) != SBX_OK)
+      return SBX_ENOMEM;
+    ps->nblocks++;
+  }
+  return SBX_OK;
+}
 
-  rc = sbx_context_load_keyframes(ctx, frames, count, loop);
+/* Runs ln through the parser with the definitions it may use from before line limit. */
+static int
+sbx_vs_run_line(SbxValidateSession *s, const SbxVsLine *ln, size_t limit) {
+  size_t len = strlen(ln->text), k;
+  int rc = sbx_vs_resolve(s, ln->def_name, limit);
 
-done:
-  if (frames) free(frames);
-  if (buf) free(buf);
+  for (k = 0; rc == SBX_OK && k < ln->nrefs; k++)
+    rc = sbx_vs_resolve(s, ln->refs[k].name, limit);
+  if (rc == SBX_OK)
+    rc = sbx_vs_grow((void **)&s->buf, &s->buf_cap, len + 1, 1);
+  if (rc != SBX_OK) {
+    set_ctx_error(s->ctx, "out of memory");
+    return rc;
+  }
+  memcpy(s->buf, ln->text, len + 1);
+  s->ps.line_no = ln->pos + 1;
+  rc = sbx_sbg_parse_line(&s->ps, s->buf);
+  sbx_parse_arena_reset(&s->ps.scratch);
   return rc;
 }
 
-int
-sbx_context_load_sequence_file(SbxContext *ctx, const char *path, int loop) {
-  char *text = 0;
-  int rc = SBX_OK;
+static int
+sbx_vs_parse_line(SbxValidateSession *s, SbxVsLine *ln, size_t limit) {
+  int rc = sbx_vs_run_line(s, ln, limit);
+  s->revalidated++;
+  ln->dirty = 0;
+  ln->ok = (rc == SBX_OK);
+  ln->has_diag = !ln->ok;
+  if (!ln->ok) sbx_vs_ctx_diag(s, &ln->diag);
+  return rc;
+}
 
-  if (!ctx || !ctx->eng || !path) return SBX_EINVAL;
+/* Slot of the waveNN-style table ln defines in the parser's tables. */
+static void **
+sbx_vs_wave_slot(SbxValidateSession *s, const char *name) {
+  if (strncmp(name, "custom", 6) == 0)
+    return (void **)&s->custom_env_waves[(name[6] - '0') * 10 + (name[7] - '0')];
+  if (strncmp(name, "noise", 5) == 0)
+    return (void **)&s->noise_profiles[(name[5] - '0') * 10 + (name[6] - '0')];
+  if (strncmp(name, "spin", 4) == 0)
+    return (void **)&s->spin_waves[(name[4] - '0') * 10 + (name[5] - '0')];
+  return (void **)&s->legacy_env_waves[(name[4] - '0') * 10 + (name[5] - '0')];
+}
 
-  rc = read_text_file_alloc(path, &text);
-  if (rc == SBX_EINVAL) {
-    char emsg[256];
-    snprintf(emsg, sizeof(emsg), "cannot open sequence file: %s", path);
-    set_ctx_error(ctx, emsg);
-    return rc;
-  } else if (rc == SBX_ENOMEM) {
-    set_ctx_error(ctx, "out of memory");
-    return rc;
-  } else if (rc != SBX_OK) {
-    set_ctx_error(ctx, "failed reading sequence file");
-    return rc;
+static void
+sbx_vs_parse_wave(SbxValidateSession *s, SbxVsLine *ln) {
+  SbxVsName *nm = ln->def_name;
+  void **slot = sbx_vs_wave_slot(s, nm->name);
+  int old_ok = ln->ok;
+  size_t i;
+
+  sbx_vs_rewind(s, -1.0);
+  for (i = 0; i < nm->ndefs; i++) {
+    SbxVsLine *d = nm->defs[i];
+    if (d->kind == SBX_VS_WAVE && d->ok && d->pos < ln->pos) *slot = &s->wave_taken;
+  }
+  sbx_vs_parse_line(s, ln, ln->pos);
+  if (*slot && *slot != (void *)&s->wave_taken) free(*slot);
+  *slot = 0;
+  if (ln->ok != old_ok) sbx_vs_touch(nm, ln->pos + 1);
+}
+
+static int
+sbx_vs_parse_def(SbxValidateSession *s, SbxVsLine *ln) {
+  SbxSbgParser *ps = &s->ps;
+  int changed;
+
+  sbx_vs_rewind(s, -1.0);
+  if (sbx_vs_parse_line(s, ln, ln->pos) == SBX_OK) {
+    int didx = named_tone_find(ps->defs, ps->ndefs, &ps->def_index, ln->def_name->name);
+    changed = !ln->frame || !sbx_voice_set_frame_same(ln->frame, &ps->defs[didx].frame);
+    if (changed) {
+      if (!ln->frame) ln->frame = (SbxVoiceSetKeyframe *)malloc(sizeof(*ln->frame));
+      if (!ln->frame) return SBX_ENOMEM;
+      *ln->frame = ps->defs[didx].frame;
+    }
+  } else {
+    changed = (ln->frame != 0);
+    free(ln->frame);
+    ln->frame = 0;
   }
+  if (changed) sbx_vs_touch(ln->def_name, ln->pos + 1);
+  return SBX_OK;
+}
 
-  rc = sbx_context_load_sequence_text(ctx, text, loop);
+static int
+sbx_vs_parse_block(SbxValidateSession *s, SbxVsLine *open) {
+  SbxSbgParser *ps = &s->ps;
+  size_t i, n = 0;
+  int blk = -1;
+  int old_ok = open->ok;
+  int changed;
+  const SbxVoiceSetKeyframe *entries = 0;
+
+  sbx_vs_rewind(s, -1.0);
+  if (sbx_vs_parse_line(s, open, open->pos) == SBX_OK)
+    blk = ps->active_block_idx;
+  for (i = open->pos + 1; i <= open->block_end; i++) {
+    SbxVsLine *ln = s->lines[i];
+    if (blk < 0 || ln->kind == SBX_VS_BLANK) {
+      ln->dirty = 0;
+      ln->ok = 1;
+      ln->has_diag = 0;
+      continue;
+    }
+    sbx_vs_parse_line(s, ln, open->pos);
+  }
+  open->has_tail = 0;
+  if (blk >= 0) {
+    entries = ps->blocks[blk].entries;
+    n = ps->blocks[blk].count;
+    if (s->lines[open->block_end]->kind != SBX_VS_CLOSE &&
+        sbx_sbg_parser_finish(ps) != SBX_OK) {
+      sbx_vs_ctx_diag(s, &open->tail_diag);
+      open->has_tail = 1;
+    }
+  }
 
-  if (text) free(text);
-  return rc;
+  changed = (n != open->nentries);
+  for (i = 0; i < n && !changed; i++)
+    changed = !sbx_same_double(entries[i].time_sec, open->entries[i].time_sec) ||
+              !sbx_voice_set_frame_same(&entries[i], &open->entries[i]);
+  if (changed) {
+    free(open->entries);
+    open->entries = 0;
+    open->nentries = 0;
+    if (n) {
+      open->entries = (SbxVoiceSetKeyframe *)malloc(n * sizeof(*entries));
+      if (!open->entries) return SBX_ENOMEM;
+      memcpy(open->entries, entries, n * sizeof(*entries));
+      open->nentries = n;
+    }
+  }
+  if (changed || open->ok != old_ok) sbx_vs_touch(open->def_name, open->block_end + 1);
+  return SBX_OK;
 }
 
-int
-sbx_context_load_sbg_timing_text(SbxContext *ctx, const char *text, int loop) {
-  char *buf = 0, *line = 0, *next = 0;
-  size_t line_no = 0;
-  SbxVoiceSetKeyframe *frames = 0;
-  SbxProgramKeyframe *primary = 0;
-  SbxProgramKeyframe *mv_frames = 0;
-  unsigned char *styles = 0;
-  SbxMixAmpKeyframe *mix_kfs = 0;
-  SbxMixFxKeyframe *mix_fx_kfs = 0;
-  size_t count = 0, cap = 0;
-  SbxNamedToneDef *defs = 0;
-  size_t ndefs = 0, defs_cap = 0;
-  SbxNamedBlockDef *blocks = 0;
-  size_t nblocks = 0, blocks_cap = 0;
-  double *legacy_env_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
-  double *custom_env_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
-  double *spin_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
-  SbxNoiseProfile *noise_profiles[SBX_CUSTOM_WAVE_COUNT] = {0};
-  int legacy_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
-  int custom_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
-  int spin_edge_modes[SBX_CUSTOM_WAVE_COUNT];
-  int active_block_idx = -1;
-  double active_block_last_off = -1.0;
-  double last_abs_sec = -1.0;
-  size_t max_voice_count = 1;
-  size_t max_mix_fx_slots = 0;
-  double last_emit_sec = -1.0;
+/* Re-parses the marked lines in document order. */
+static int
+sbx_vs_sweep(SbxValidateSession *s) {
+  size_t i = 0;
   int rc = SBX_OK;
 
-  if (!ctx || !ctx->eng || !text) return SBX_EINVAL;
+  while (i < s->count && !s->lines[i]->dirty) i++;
+  if (i < s->count && s->lines[i]->owner) i = s->lines[i]->owner->pos;
+  for (; i < s->count && rc == SBX_OK; i++) {
+    SbxVsLine *ln = s->lines[i];
+    if (ln->kind == SBX_VS_OPEN) {
+      size_t j;
+      int dirty = ln->dirty;
+      for (j = i + 1; !dirty && j <= ln->block_end; j++)
+        dirty = s->lines[j]->dirty;
+      if (dirty) rc = sbx_vs_parse_block(s, ln);
+      i = ln->block_end;
+      continue;
+    }
+    if (!ln->dirty) continue;
+    switch (ln->kind) {
+    case SBX_VS_WAVE:
+      sbx_vs_parse_wave(s, ln);
+      break;
+    case SBX_VS_DEF:
+      rc = sbx_vs_parse_def(s, ln);
+      break;
+    case SBX_VS_TIMING:
+      sbx_vs_rewind(s, ln->anchored ? 0.0 : -1.0);
+      ln->emits = (sbx_vs_parse_line(s, ln, ln->pos) == SBX_OK) ? s->ps.count : 0;
+      break;
+    default:
+      ln->dirty = 0;
+      ln->ok = 1;
+      ln->has_diag = 0;
+      break;
+    }
+  }
+  return rc;
+}
+
+/*
+ * Loading plays the first keyframe straight away, so its tones must find
+ * their wave tables among all those the document defines. The first
+ * emitting line is parsed again for its frame; it is one line, and the
+ * answer changes with any wave definition anywhere.
+ */
+static int
+sbx_vs_check_start(SbxValidateSession *s, SbxDiagnostic *diag) {
+  SbxVsLine *start = 0;
+  const char *missing = 0;
+  char err[160];
+  size_t i, vi, nvoices;
 
-  {
-    size_t i;
-    for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
-      legacy_env_edge_modes[i] = 1;
-      custom_env_edge_modes[i] = 1;
-      spin_edge_modes[i] = 1;
-    }
+  for (i = 0; i < s->count && !start; i++) {
+    SbxVsLine *ln = s->lines[i];
+    if (ln->kind == SBX_VS_TIMING && ln->ok && ln->emits) start = ln;
   }
+  if (!start) return 0;
+  sbx_vs_rewind(s, start->anchored ? 0.0 : -1.0);
+  if (sbx_vs_run_line(s, start, start->pos) != SBX_OK || s->ps.count == 0)
+    return 0;
 
-  buf = sbx_strdup_local(text);
-  if (!buf) {
-    set_ctx_error(ctx, "out of memory");
-    return SBX_ENOMEM;
+  for (i = 0; i < s->count; i++) {
+    SbxVsLine *ln = s->lines[i];
+    if (ln->kind == SBX_VS_WAVE && ln->ok)
+      *sbx_vs_wave_slot(s, ln->def_name->name) = &s->wave_taken;
+  }
+  nvoices = s->ps.frames[0].body->tone_len ? s->ps.frames[0].body->tone_len : 1;
+  for (vi = 0; vi < nvoices && !missing; vi++) {
+    SbxToneSpec tone = sbx_queued_frame_tone(s->ps.frames[0].body, vi);
+    if (normalize_tone(&tone, err, sizeof(err)) != SBX_OK)
+      missing = err;
+    else
+      missing = sbx_tone_missing_table(&tone, (const double *const *)s->legacy_env_waves,
+                                       (const double *const *)s->custom_env_waves,
+                                       (const double *const *)s->spin_waves,
+                                       (const SbxNoiseProfile *const *)s->noise_profiles);
+  }
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    s->legacy_env_waves[i] = s->custom_env_waves[i] = s->spin_waves[i] = 0;
+    s->noise_profiles[i] = 0;
   }
+  if (!missing) return 0;
+  set_ctx_error(s->ctx, missing);
+  sbx_vs_ctx_diag(s, diag);
+  return 1;
+}
 
-  line = buf;
-  while (line && *line) {
-    char *p, *q, *rest;
-    char *time_tok;
-    int interp = SBX_INTERP_LINEAR;
-    int expanded_block = 0;
-    int is_definition = 0;
-    double tsec;
-    SbxVoiceSetKeyframe frame;
+static int
+sbx_vs_push_diag(SbxValidateSession *s, const SbxDiagnostic *diag) {
+  if (sbx_vs_grow((void **)&s->diags, &s->diags_cap, s->ndiags + 1, sizeof(*s->diags)) != SBX_OK)
+    return SBX_ENOMEM;
+  s->diags[s->ndiags++] = *diag;
+  return SBX_OK;
+}
 
-    sbx_voice_set_frame_init(&frame);
+/* Gathers the diagnostics in the order sbx_validate_sbg_text meets them. */
+static int
+sbx_vs_collect(SbxValidateSession *s) {
+  SbxDiagnostic diag;
+  size_t i, emits = 0;
+  int rc = SBX_OK;
 
-    line_no++;
-    next = strchr(line, '\n');
-    if (next) {
-      *next = 0;
-      next++;
+  s->ndiags = 0;
+  if (s->have_pre_diag) rc = sbx_vs_push_diag(s, &s->pre_diag);
+  if (rc == SBX_OK && s->have_cfg_diag) rc = sbx_vs_push_diag(s, &s->cfg_diag);
+  for (i = 0; rc == SBX_OK && i < s->count; i++) {
+    SbxVsLine *ln = s->lines[i];
+    if (ln->has_diag) rc = sbx_vs_push_diag(s, &ln->diag);
+    if (ln->kind == SBX_VS_TIMING && ln->ok) emits += ln->emits;
+  }
+  if (rc == SBX_OK && s->tail_block && s->tail_block->has_tail)
+    rc = sbx_vs_push_diag(s, &s->tail_block->tail_diag);
+  if (rc == SBX_OK && emits == 0) {
+    sbx_diag_fill(&diag, SBX_DIAG_ERROR, "sbg-parse", "sbg timing text contains no keyframes");
+    rc = sbx_vs_push_diag(s, &diag);
+  }
+  if (rc == SBX_OK && emits && sbx_vs_check_start(s, &diag))
+    rc = sbx_vs_push_diag(s, &diag);
+  if (rc == SBX_OK && s->have_A) {
+    /* Any positive program length validates the same way. */
+    SbxMixModSpec mix_mod = s->mix_mod;
+    mix_mod.active = 1;
+    if (mix_mod.main_len_sec <= 0.0)
+      mix_mod.main_len_sec = 1.0;
+    if (mix_mod.wake_len_sec < 0.0)
+      mix_mod.wake_len_sec = 0.0;
+    if (sbx_context_set_mix_mod(s->ctx, &mix_mod) != SBX_OK) {
+      sbx_vs_ctx_diag(s, &diag);
+      rc = sbx_vs_push_diag(s, &diag);
     }
+  }
+  return rc;
+}
 
-    if (line[0] && line[strlen(line) - 1] == '\r')
-      line[strlen(line) - 1] = 0;
+static int
+sbx_vs_update(SbxValidateSession *s, size_t first_line, size_t old_region, int new_session) {
+  size_t i;
+  int rc;
 
-    strip_inline_comment(line);
-    rstrip_inplace(line);
-    p = (char *)skip_ws(line);
-    if (*p == 0) {
-      line = next;
-      continue;
-    }
+  for (i = 0; i < s->count; i++) {
+    SbxVsLine *ln = s->lines[i];
+    /* Messages carry the line number. */
+    if (ln->pos != i && ln->has_diag) ln->dirty = 1;
+    ln->pos = i;
+  }
+  for (i = 0; i < s->npending; i++)
+    sbx_vs_touch(s->pending[i], first_line);
+  s->npending = 0;
+  rc = sbx_vs_restructure(s);
+  if (rc == SBX_OK && (new_session || first_line < old_region || s->region != old_region))
+    rc = sbx_vs_update_preamble(s);
+  s->revalidated = 0;
+  if (rc == SBX_OK) rc = sbx_vs_sweep(s);
+  if (rc == SBX_OK) rc = sbx_vs_collect(s);
+  return rc;
+}
 
-    q = p;
-    while (*q && !isspace((unsigned char)*q)) q++;
-    if (*q) {
-      *q++ = 0;
-      rest = (char *)skip_ws(q);
-    } else {
-      rest = q;
-    }
+SbxValidateSession *
+sbx_validate_session_create(const char *text, char *errbuf, size_t errbuf_sz) {
+  SbxValidateSession *s;
+  int rc;
 
-    if (active_block_idx >= 0) {
-      char *time_tok = p;
-      int interp = SBX_INTERP_LINEAR;
-      int transition_style = SBX_SEG_STYLE_SBG_DEFAULT;
-      double off_sec = 0.0;
-      SbxVoiceSetKeyframe blk_frame;
-      SbxNamedBlockDef *blk = &blocks[active_block_idx];
+  if (errbuf && errbuf_sz) errbuf[0] = 0;
+  if (!text) {
+    sbx_set_api_error(errbuf, errbuf_sz, "validation session needs document text");
+    return 0;
+  }
+  s = (SbxValidateSession *)calloc(1, sizeof(*s));
+  if (!s) {
+    sbx_set_api_error(errbuf, errbuf_sz, "out of memory");
+    return 0;
+  }
+  sbx_sbg_parser_init(&s->ps, 0, s->legacy_env_waves, s->custom_env_waves, s->spin_waves,
+                      s->noise_profiles, s->legacy_env_edge_modes, s->custom_env_edge_modes,
+                      s->spin_edge_modes);
+  rc = sbx_vs_split(s, text, &s->lines, &s->count);
+  if (rc == SBX_OK) {
+    s->cap = s->count;
+    rc = sbx_vs_update(s, 0, 0, 1);
+  }
+  if (rc != SBX_OK) {
+    sbx_set_api_error(errbuf, errbuf_sz, "out of memory");
+    sbx_validate_session_destroy(s);
+    return 0;
+  }
+  return s;
+}
 
-      sbx_voice_set_frame_init(&blk_frame);
+void
+sbx_validate_session_destroy(SbxValidateSession *s) {
+  size_t i;
+  if (!s) return;
+  for (i = 0; i < s->count; i++)
+    sbx_vs_line_free(s->lines[i]);
+  free(s->lines);
+  for (i = 0; i < s->nnames; i++) {
+    free(s->names[i]->defs);
+    free(s->names[i]->refs);
+  }
+  free(s->names);
+  free(s->pending);
+  sbx_parse_arena_free(&s->name_arena);
+  sbx_sbg_parser_free(&s->ps);
+  if (s->ctx) sbx_context_destroy(s->ctx);
+  free(s->buf);
+  free(s->diags);
+  free(s);
+}
 
-      if (strcmp(time_tok, "}") == 0) {
-        if (rest && *rest) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: unexpected trailing token(s) after block close",
-                   (unsigned long)line_no);
-          set_ctx_error_range_span(ctx, emsg, line_no, line, rest, strlen(rest));
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        active_block_idx = -1;
-        active_block_last_off = -1.0;
-        line = next;
-        continue;
-      }
+int
+sbx_validate_session_edit(SbxValidateSession *s,
+                          size_t first_line,
+                          size_t removed_lines,
+                          const char *new_text) {
+  SbxVsLine **added = 0;
+  size_t nadded = 0, old_region, i;
+  int rc;
 
-      if (*rest == 0) {
-        char emsg[224];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: missing tone-spec or named tone-set in block '%s'",
-                 (unsigned long)line_no, blk->name ? blk->name : "?");
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
-      }
+  if (!s || first_line > s->count || removed_lines > s->count - first_line)
+    return SBX_EINVAL;
+  if (new_text) {
+    rc = sbx_vs_split(s, new_text, &added, &nadded);
+    if (rc != SBX_OK) return rc;
+  }
+  if (sbx_vs_grow((void **)&s->lines, &s->cap, s->count - removed_lines + nadded,
+                  sizeof(*s->lines)) != SBX_OK ||
+      sbx_vs_grow((void **)&s->pending, &s->pending_cap, removed_lines,
+                  sizeof(*s->pending)) != SBX_OK) {
+    for (i = 0; i < nadded; i++) sbx_vs_line_free(added[i]);
+    free(added);
+    return SBX_ENOMEM;
+  }
 
-      rc = parse_sbg_relative_offset_token(time_tok, &off_sec);
-      if (rc != SBX_OK) {
-        char emsg[256];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: invalid block-relative timing token '%s' (use +HH:MM[:SS][+...])",
-                 (unsigned long)line_no, time_tok);
-        set_ctx_error_token_span(ctx, emsg, line_no, line, time_tok);
-        rc = SBX_EINVAL;
-        goto done;
-      }
-      if (active_block_last_off >= 0.0 && off_sec < active_block_last_off) {
-        char emsg[256];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: block '%s' timings must be non-decreasing",
-                 (unsigned long)line_no, blk->name ? blk->name : "?");
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
+  old_region = s->region;
+  for (i = first_line; i < first_line + removed_lines; i++) {
+    SbxVsLine *ln = s->lines[i];
+    if (ln->owner && (ln->owner->pos < first_line || ln->owner->pos >= first_line + removed_lines))
+      ln->owner->dirty = 1;
+    if (ln->def_slot != (size_t)-1) s->pending[s->npending++] = ln->def_name;
+    if (ln->kind == SBX_VS_OPEN) {
+      size_t j;
+      for (j = i + 1; j <= ln->block_end; j++) {
+        if (s->lines[j]->owner == ln) s->lines[j]->owner = 0;
       }
+    }
+    if (s->tail_block == ln) s->tail_block = 0;
+    sbx_vs_line_free(ln);
+  }
+  memmove(s->lines + first_line + nadded, s->lines + first_line + removed_lines,
+          (s->count - first_line - removed_lines) * sizeof(*s->lines));
+  for (i = 0; i < nadded; i++)
+    s->lines[first_line + i] = added[i];
+  s->count = s->count - removed_lines + nadded;
+  free(added);
+  return sbx_vs_update(s, first_line, old_region, 0);
+}
 
-      {
-        char **tokv = 0;
-        size_t nt = 0;
-        size_t idx = 0;
-        int had_leading_transition = 0;
-        int nested_block_idx = -1;
-        rc = split_ws_tokens_inplace(rest, &tokv, &nt);
-        if (rc == SBX_ENOMEM) {
-          set_ctx_error(ctx, "out of memory");
-          goto done;
-        }
-        if (rc != SBX_OK) {
-          set_ctx_error(ctx, "failed tokenizing block entry");
-          rc = SBX_EINVAL;
-          goto done;
-        }
+size_t
+sbx_validate_session_line_count(const SbxValidateSession *s) {
+  return s ? s->count : 0;
+}
 
-        if (nt <= 0) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: missing tone-spec or named tone-set token in block '%s'",
-                   (unsigned long)line_no, blk->name ? blk->name : "?");
-          if (tokv) free(tokv);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
+int
+sbx_validate_session_diagnostics(const SbxValidateSession *s,
+                                 const SbxDiagnostic **out_diags,
+                                 size_t *out_count) {
+  if (out_diags) *out_diags = 0;
+  if (out_count) *out_count = 0;
+  if (!s || !out_diags || !out_count) return SBX_EINVAL;
+  *out_diags = s->diags;
+  *out_count = s->ndiags;
+  return SBX_OK;
+}
 
-        if (is_sbg_transition_token(tokv[idx])) {
-          interp = sbg_transition_token_to_interp(tokv[idx]);
-          transition_style = sbg_transition_token_to_style(tokv[idx]);
-          had_leading_transition = 1;
-          idx++;
-        }
-        if (idx >= nt) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: missing tone-spec or named tone-set after transition token in block '%s'",
-                   (unsigned long)line_no, blk->name ? blk->name : "?");
-          if (tokv) free(tokv);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
+size_t
+sbx_validate_session_revalidated_lines(const SbxValidateSession *s) {
+  return s ? s->revalidated : 0;
+}
 
-        while (idx < nt) {
-          int bidx = -1;
-          const char *tok = tokv[idx];
-          int interp_tmp;
-          if (parse_interp_mode_token(tok, &interp_tmp) == SBX_OK) {
-            interp = interp_tmp;
-            idx++;
-            continue;
-          }
-          if (is_sbg_transition_token(tok)) {
-            interp = sbg_transition_token_to_interp(tok);
-            transition_style = sbg_transition_token_to_style(tok);
-            idx++;
-            continue;
-          }
-          rc = sbx_frame_apply_token(&blk_frame, tok, ctx,
-                                     defs, ndefs, &bidx, blocks, nblocks);
-          if (rc != SBX_OK) {
-            char emsg[256];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: invalid block tone-spec, unknown named tone-set, or unknown nested block '%s'",
-                     (unsigned long)line_no, tok);
-            if (tokv) free(tokv);
-            set_ctx_error_token_span(ctx, emsg, line_no, line, tok);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-          if (bidx >= 0) {
-            if (bidx == active_block_idx) {
-              char emsg[256];
-              snprintf(emsg, sizeof(emsg),
-                       "line %lu: block '%s' cannot reference itself",
-                       (unsigned long)line_no, blk->name ? blk->name : "?");
-              if (tokv) free(tokv);
-              set_ctx_error(ctx, emsg);
-              rc = SBX_EINVAL;
-              goto done;
-            }
-            if (had_leading_transition || idx + 1 < nt ||
-                blk_frame.tone_len > 0 || blk_frame.mix_amp_present || blk_frame.mix_fx_count > 0) {
-              char emsg[256];
-              snprintf(emsg, sizeof(emsg),
-                       "line %lu: nested block '%s' must appear alone in block '%s'",
-                       (unsigned long)line_no, tok, blk->name ? blk->name : "?");
-              if (tokv) free(tokv);
-              set_ctx_error_token_span(ctx, emsg, line_no, line, tok);
-              rc = SBX_EINVAL;
-              goto done;
-            }
-            nested_block_idx = bidx;
-            idx++;
-            break;
-          }
-          idx++;
-        }
+/*
+ * Compiled programs (.sbgc). All integers and doubles are little-endian
+ * (doubles as their IEEE-754 bit patterns), independent of the host:
+ *
+ *   "SBXCPRG\0", u32 version, u32 flags (0), f64 sample_rate,
+ *   u32 voice_count, u32 mix_fx_slots, u64 kf_count, u64 mix_kf_count,
+ *   u64 mix_fx_kf_count, u32 preamble_len, u32 table_count,
+ *   preamble bytes,
+ *   per keyframe: f64 time_sec, u8 interp, u8 style,
+ *   per voice, per keyframe: tone record,
+ *   f64 mix default amp, per mix keyframe: f64 time, f64 amp_pct, i32 interp,
+ *   per mix-effect keyframe: f64 time, i32 interp, u32 n, n mix-effect records,
+ *   3 x SBX_CUSTOM_WAVE_COUNT i32 edge modes (legacy, custom, spin),
+ *   per table: u8 kind, u8 index, u16 0, u32 n, n f64.
+ *
+ * Wave tables and noise FIRs are stored baked, so loading does no parsing
+ * or table/FIR design; the keyframe lanes are re-activated as loaded.
+ */
+#define SBX_COMPILED_MAGIC "SBXCPRG"
+/* Loaded frequencies beyond this are damage, not a program; the
+ * oscillators could not wrap their phase in bounded time. */
+#define SBX_COMPILED_MAX_HZ 1e6
 
-        if (nested_block_idx >= 0) {
-          size_t bi;
-          if (blocks[nested_block_idx].count == 0) {
-            char emsg[256];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: nested block '%s' has no entries",
-                     (unsigned long)line_no, tokv[idx - 1]);
-            if (tokv) free(tokv);
-            set_ctx_error(ctx, emsg);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-          for (bi = 0; bi < blocks[nested_block_idx].count; bi++) {
-            SbxVoiceSetKeyframe nested_entry = blocks[nested_block_idx].entries[bi];
-            double nested_off = off_sec + nested_entry.time_sec;
-            if (active_block_last_off >= 0.0 && nested_off < active_block_last_off) {
-              char emsg[256];
-              snprintf(emsg, sizeof(emsg),
-                       "line %lu: nested expansion in block '%s' is not time-ordered",
-                       (unsigned long)line_no, blk->name ? blk->name : "?");
-              if (tokv) free(tokv);
-              set_ctx_error(ctx, emsg);
-              rc = SBX_EINVAL;
-              goto done;
-            }
-            nested_entry.time_sec = nested_off;
-            rc = block_append_entry(blk, &nested_entry);
-            if (rc != SBX_OK) {
-              set_ctx_error(ctx, "out of memory");
-              rc = SBX_ENOMEM;
-              goto done;
-            }
-            if (nested_entry.tone_len > max_voice_count) max_voice_count = nested_entry.tone_len;
-            if (nested_entry.mix_fx_count > max_mix_fx_slots) max_mix_fx_slots = nested_entry.mix_fx_count;
-            active_block_last_off = nested_off;
-          }
-        } else {
-          if (blk_frame.tone_len == 0 && !blk_frame.mix_amp_present && blk_frame.mix_fx_count == 0) {
-            char emsg[256];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: missing tone-spec or named tone-set token in block '%s'",
-                     (unsigned long)line_no, blk->name ? blk->name : "?");
-            if (tokv) free(tokv);
-            set_ctx_error(ctx, emsg);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-          if (blk_frame.mix_fx_count > 0 && !blk_frame.mix_amp_present) {
-            char emsg[256];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: mix effects in block '%s' require mix/<amp> on the same line or in the referenced named tone-set",
-                     (unsigned long)line_no, blk->name ? blk->name : "?");
-            if (tokv) free(tokv);
-            set_ctx_error(ctx, emsg);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-          blk_frame.time_sec = off_sec;
-          blk_frame.interp = interp;
-          blk_frame.transition_style = transition_style;
-          rc = block_append_entry(blk, &blk_frame);
-          if (rc != SBX_OK) {
-            set_ctx_error(ctx, "out of memory");
-            rc = SBX_ENOMEM;
-            goto done;
-          }
-          if (blk_frame.tone_len > max_voice_count) max_voice_count = blk_frame.tone_len;
-          if (blk_frame.mix_fx_count > max_mix_fx_slots) max_mix_fx_slots = blk_frame.mix_fx_count;
-          active_block_last_off = off_sec;
-        }
-        if (tokv) free(tokv);
-      }
+enum {
+  SBX_COMPILED_TABLE_LEGACY = 0,
+  SBX_COMPILED_TABLE_CUSTOM = 1,
+  SBX_COMPILED_TABLE_SPIN = 2,
+  SBX_COMPILED_TABLE_NOISE = 3
+};
 
-      line = next;
-      continue;
-    }
+typedef struct {
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+  int oom;
+} SbxByteBuf;
 
-    /* Accept named tone-set definitions: name: <tone-spec> */
-    {
-      size_t l0 = strlen(p);
-      if (l0 > 1 && p[l0 - 1] == ':') {
-        double ttmp;
-        p[l0 - 1] = 0;
-        if (parse_hhmmss_token(p, &ttmp) != SBX_OK)
-          is_definition = 1;
-        else
-          p[l0 - 1] = ':';
-      }
+static void
+sbx_bb_put(SbxByteBuf *b, const void *p, size_t n) {
+  if (b->oom) return;
+  if (b->len + n > b->cap) {
+    size_t ncap = b->cap ? b->cap : 4096;
+    unsigned char *tmp;
+    while (ncap < b->len + n) ncap *= 2;
+    tmp = (unsigned char *)realloc(b->data, ncap);
+    if (!tmp) {
+      b->oom = 1;
+      return;
     }
+    b->data = tmp;
+    b->cap = ncap;
+  }
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+}
 
-    if (is_definition) {
-      char *r = rest;
-      char *name = p;
-      int didx;
-      int bidx;
+static void
+sbx_bb_u8(SbxByteBuf *b, unsigned v) {
+  unsigned char c = (unsigned char)v;
+  sbx_bb_put(b, &c, 1);
+}
 
-      if (*name == 0) {
-        char emsg[208];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: empty named tone-set definition",
-                 (unsigned long)line_no);
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
-      }
-      if (!r || *r == 0) {
-        char emsg[208];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: named tone-set '%s' is missing tone-spec",
-                 (unsigned long)line_no, name);
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
-      }
+static void
+sbx_bb_u32(SbxByteBuf *b, uint32_t v) {
+  unsigned char c[4];
+  c[0] = (unsigned char)v;
+  c[1] = (unsigned char)(v >> 8);
+  c[2] = (unsigned char)(v >> 16);
+  c[3] = (unsigned char)(v >> 24);
+  sbx_bb_put(b, c, 4);
+}
 
-      if (((strncmp(name, "wave", 4) == 0 &&
-            isdigit((unsigned char)name[4]) &&
-            isdigit((unsigned char)name[5]) &&
-            name[6] == 0)) ||
-          ((strncmp(name, "custom", 6) == 0 &&
-            isdigit((unsigned char)name[6]) &&
-            isdigit((unsigned char)name[7]) &&
-            name[8] == 0)) ||
-          ((strncmp(name, "noise", 5) == 0 &&
-            isdigit((unsigned char)name[5]) &&
-            isdigit((unsigned char)name[6]) &&
-            name[7] == 0)) ||
-          ((strncmp(name, "spin", 4) == 0 &&
-            isdigit((unsigned char)name[4]) &&
-            isdigit((unsigned char)name[5]) &&
-            name[6] == 0))) {
-        int is_custom = (strncmp(name, "custom", 6) == 0);
-        int is_noise = (!is_custom && strncmp(name, "noise", 5) == 0);
-        int is_spin = (!is_custom && !is_noise && strncmp(name, "spin", 4) == 0);
-        int wave_idx = is_custom ? ((name[6] - '0') * 10 + (name[7] - '0'))
-                                 : (is_noise ? ((name[5] - '0') * 10 + (name[6] - '0'))
-                                             : ((name[4] - '0') * 10 + (name[5] - '0')));
-        double *raw = 0;
-        size_t raw_count = 0, raw_cap = 0;
-        char *wr = r;
-        int custom_edge_mode = 1;
-        int custom_edge_seen = 0;
-        if ((is_custom ? custom_env_waves[wave_idx]
-                       : (is_noise ? (noise_profiles[wave_idx] ? (double *)1 : 0)
-                                   : (is_spin ? spin_waves[wave_idx] : legacy_env_waves[wave_idx])))) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: %s %02d already defined",
-                   (unsigned long)line_no,
-                   is_custom ? "customNN" : (is_noise ? "noiseNN" : (is_spin ? "spinNN" : "waveNN")),
-                   wave_idx);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        wr = (char *)skip_ws(wr);
-        if (is_custom || is_spin) {
-          while ((*wr == 'e' || *wr == 'E') && wr[1] == '=') {
-            char *end = 0;
-            long edge = strtol(wr + 2, &end, 10);
-            if (end == wr + 2 || !(*end == 0 || isspace((unsigned char)*end) || *end == ':')) {
-              char emsg[224];
-              snprintf(emsg, sizeof(emsg),
-                       "line %lu: %s %02d expects optional e=<0..3> before samples",
-                       (unsigned long)line_no, is_custom ? "customNN" : "spinNN", wave_idx);
-              if (raw) free(raw);
-              set_ctx_error_token_span(ctx, emsg, line_no, line, wr);
-              rc = SBX_EINVAL;
-              goto done;
-            }
-            if (custom_edge_seen || edge < 0 || edge > 3) {
-              char emsg[224];
-              snprintf(emsg, sizeof(emsg),
-                       "line %lu: %s %02d optional e=<0..3> may appear at most once",
-                       (unsigned long)line_no, is_custom ? "customNN" : "spinNN", wave_idx);
-              if (raw) free(raw);
-              set_ctx_error_token_span(ctx, emsg, line_no, line, wr);
-              rc = SBX_EINVAL;
-              goto done;
-            }
-            custom_edge_mode = (int)edge;
-            custom_edge_seen = 1;
-            wr = (char *)skip_ws((*end == ':') ? end + 1 : end);
-          }
-        }
-        while (*wr) {
-          char *end = 0;
-          double v = strtod(wr, &end);
-          if (end == wr || !isfinite(v)) {
-            char emsg[224];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: %s %02d expects floating-point samples",
-                     (unsigned long)line_no,
-                     is_custom ? "customNN" : (is_noise ? "noiseNN" : (is_spin ? "spinNN" : "waveNN")),
-                     wave_idx);
-            if (raw) free(raw);
-            set_ctx_error_token_span(ctx, emsg, line_no, line, wr);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-          if (raw_count == raw_cap) {
-            size_t ncap = raw_cap ? raw_cap * 2 : 16;
-            double *tmp = (double *)realloc(raw, ncap * sizeof(*raw));
-            if (!tmp) {
-              if (raw) free(raw);
-              set_ctx_error(ctx, "out of memory");
-              rc = SBX_ENOMEM;
-              goto done;
-            }
-            raw = tmp;
-            raw_cap = ncap;
-          }
-          raw[raw_count++] = v;
-          wr = (char *)skip_ws(end);
-        }
-        if (is_custom) {
-          rc = sbx_build_literal_custom_env_table_from_samples(raw, raw_count, custom_edge_mode,
-                                                               &custom_env_waves[wave_idx]);
-          custom_env_edge_modes[wave_idx] = custom_edge_mode;
-        } else if (is_noise) {
-          rc = sbx_build_noise_profile_from_db_bands(raw, raw_count, ctx->eng->cfg.sample_rate,
-                                                     &noise_profiles[wave_idx]);
-        } else if (is_spin) {
-          rc = sbx_build_literal_spin_wave_table_from_samples(raw, raw_count, custom_edge_mode,
-                                                              &spin_waves[wave_idx]);
-          spin_edge_modes[wave_idx] = custom_edge_mode;
-        } else {
-          rc = sbx_build_legacy_custom_wave_table_from_samples(raw, raw_count, &legacy_env_waves[wave_idx]);
-        }
-        if (raw) free(raw);
-        if (rc != SBX_OK) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: invalid %s %02d definition",
-                   (unsigned long)line_no,
-                   is_custom ? "customNN" : (is_noise ? "noiseNN" : (is_spin ? "spinNN" : "waveNN")),
-                   wave_idx);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        line = next;
-        continue;
-      }
+static void
+sbx_bb_u64(SbxByteBuf *b, uint64_t v) {
+  sbx_bb_u32(b, (uint32_t)v);
+  sbx_bb_u32(b, (uint32_t)(v >> 32));
+}
+
+static void
+sbx_bb_f64(SbxByteBuf *b, double v) {
+  uint64_t u;
+  memcpy(&u, &v, sizeof(u));
+  sbx_bb_u64(b, u);
+}
+
+static void
+sbx_bb_i32(SbxByteBuf *b, int v) {
+  sbx_bb_u32(b, (uint32_t)(int32_t)v);
+}
 
-      bidx = named_block_find(blocks, nblocks, name);
-      if (strcmp(r, "{") == 0) {
-        if (bidx < 0 && named_tone_find(defs, ndefs, name) >= 0) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: '%s' is already defined as a named tone-set",
-                   (unsigned long)line_no, name);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
+typedef struct {
+  const unsigned char *p;
+  const unsigned char *end;
+  int bad;
+} SbxByteReader;
+
+static const unsigned char *
+sbx_br_take(SbxByteReader *r, size_t n) {
+  const unsigned char *p = r->p;
+  if (r->bad || (size_t)(r->end - r->p) < n) {
+    r->bad = 1;
+    return 0;
+  }
+  r->p += n;
+  return p;
+}
 
-        if (bidx >= 0) {
-          if (blocks[bidx].entries) free(blocks[bidx].entries);
-          blocks[bidx].entries = 0;
-          blocks[bidx].count = 0;
-          blocks[bidx].cap = 0;
-        } else {
-          if (nblocks == blocks_cap) {
-            size_t ncap = blocks_cap ? (blocks_cap * 2) : 8;
-            SbxNamedBlockDef *tmp =
-                (SbxNamedBlockDef *)realloc(blocks, ncap * sizeof(*blocks));
-            if (!tmp) {
-              set_ctx_error(ctx, "out of memory");
-              rc = SBX_ENOMEM;
-              goto done;
-            }
-            blocks = tmp;
-            blocks_cap = ncap;
-          }
-          bidx = (int)nblocks;
-          blocks[nblocks].name = sbx_strdup_local(name);
-          blocks[nblocks].entries = 0;
-          blocks[nblocks].count = 0;
-          blocks[nblocks].cap = 0;
-          if (!blocks[nblocks].name) {
-            set_ctx_error(ctx, "out of memory");
-            rc = SBX_ENOMEM;
-            goto done;
-          }
-          nblocks++;
-        }
-        active_block_idx = bidx;
-        active_block_last_off = -1.0;
-        line = next;
-        continue;
-      }
-      if (bidx >= 0) {
-        char emsg[224];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: '%s' is already defined as a block name",
-                 (unsigned long)line_no, name);
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
-      }
+static unsigned
+sbx_br_u8(SbxByteReader *r) {
+  const unsigned char *c = sbx_br_take(r, 1);
+  return c ? c[0] : 0;
+}
 
-      {
-        while (*r) {
-          int bdef = -1;
-          char *v_tok = r;
-          while (*r && !isspace((unsigned char)*r)) r++;
-          if (*r) {
-            *r++ = 0;
-            r = (char *)skip_ws(r);
-          }
-          rc = sbx_frame_apply_token(&frame, v_tok, ctx,
-                                     defs, ndefs, &bdef, blocks, nblocks);
-          if (rc != SBX_OK || bdef >= 0) {
-            char emsg[224];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: invalid named tone-set token '%s'",
-                     (unsigned long)line_no, v_tok);
-            set_ctx_error_token_span(ctx, emsg, line_no, line, v_tok);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-        }
-        if (frame.tone_len == 0 && !frame.mix_amp_present && frame.mix_fx_count == 0) {
-          char emsg[208];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: named tone-set '%s' is missing content",
-                   (unsigned long)line_no, name);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        if (frame.mix_fx_count > 0 && !frame.mix_amp_present) {
-          char emsg[256];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: mix effects in named tone-set '%s' require mix/<amp> on the same line or in a referenced named tone-set",
-                   (unsigned long)line_no, name);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        if (frame.tone_len > max_voice_count) max_voice_count = frame.tone_len;
-        if (frame.mix_fx_count > max_mix_fx_slots) max_mix_fx_slots = frame.mix_fx_count;
-      }
+static uint32_t
+sbx_br_u32(SbxByteReader *r) {
+  const unsigned char *c = sbx_br_take(r, 4);
+  if (!c) return 0;
+  return (uint32_t)c[0] | ((uint32_t)c[1] << 8) | ((uint32_t)c[2] << 16) | ((uint32_t)c[3] << 24);
+}
 
-      didx = named_tone_find(defs, ndefs, name);
-      if (didx >= 0) {
-        defs[didx].frame = frame;
-      } else {
-        if (ndefs == defs_cap) {
-          size_t ncap = defs_cap ? (defs_cap * 2) : 8;
-          SbxNamedToneDef *tmp =
-              (SbxNamedToneDef *)realloc(defs, ncap * sizeof(*defs));
-          if (!tmp) {
-            set_ctx_error(ctx, "out of memory");
-            rc = SBX_ENOMEM;
-            goto done;
-          }
-          defs = tmp;
-          defs_cap = ncap;
-        }
-        defs[ndefs].name = sbx_strdup_local(name);
-        if (!defs[ndefs].name) {
-          set_ctx_error(ctx, "out of memory");
-          rc = SBX_ENOMEM;
-          goto done;
-        }
-        defs[ndefs].frame = frame;
-        ndefs++;
-      }
-      line = next;
-      continue;
-    }
+static uint64_t
+sbx_br_u64(SbxByteReader *r) {
+  uint64_t lo = sbx_br_u32(r);
+  return lo | ((uint64_t)sbx_br_u32(r) << 32);
+}
 
-    time_tok = p;
-    if (*rest == 0) {
-      char emsg[192];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: missing tone-spec or named tone-set",
-               (unsigned long)line_no);
-      set_ctx_error(ctx, emsg);
-      rc = SBX_EINVAL;
-      goto done;
-    }
+static double
+sbx_br_f64(SbxByteReader *r) {
+  uint64_t u = sbx_br_u64(r);
+  double v;
+  memcpy(&v, &u, sizeof(v));
+  return v;
+}
 
-    rc = parse_sbg_timeline_time_token(time_tok, &last_abs_sec, &tsec);
-    if (rc != SBX_OK) {
-      char emsg[224];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: invalid SBG timing token '%s' (use HH:MM[:SS], NOW, and optional +relative parts)",
-               (unsigned long)line_no, time_tok);
-      set_ctx_error_token_span(ctx, emsg, line_no, line, time_tok);
-      rc = SBX_EINVAL;
-      goto done;
-    }
+static int
+sbx_br_i32(SbxByteReader *r) {
+  return (int)(int32_t)sbx_br_u32(r);
+}
 
-    {
-      char **tokv = 0;
-      size_t nt = 0;
-      size_t idx = 0;
-      int had_leading_transition = 0;
-      int block_idx = -1;
-      rc = split_ws_tokens_inplace(rest, &tokv, &nt);
-      if (rc == SBX_ENOMEM) {
-        set_ctx_error(ctx, "out of memory");
-        goto done;
-      }
-      if (rc != SBX_OK) {
-        set_ctx_error(ctx, "failed tokenizing SBG timing entry");
-        rc = SBX_EINVAL;
-        goto done;
-      }
+static void
+sbx_bb_tone(SbxByteBuf *b, const SbxToneSpec *t) {
+  sbx_bb_i32(b, (int)t->mode);
+  sbx_bb_f64(b, t->carrier_hz);
+  sbx_bb_f64(b, t->beat_hz);
+  sbx_bb_f64(b, t->orbit_hz);
+  sbx_bb_f64(b, t->orbit_distance_m);
+  sbx_bb_i32(b, t->orbit_envelope_mode);
+  sbx_bb_f64(b, t->amplitude);
+  sbx_bb_i32(b, t->waveform);
+  sbx_bb_i32(b, t->envelope_waveform);
+  sbx_bb_i32(b, t->noise_waveform);
+  sbx_bb_f64(b, t->duty_cycle);
+  sbx_bb_f64(b, t->iso_start);
+  sbx_bb_f64(b, t->iso_attack);
+  sbx_bb_f64(b, t->iso_release);
+  sbx_bb_i32(b, t->iso_edge_mode);
+}
 
-      if (nt <= 0) {
-        char emsg[224];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: missing tone-spec or named tone-set token",
-                 (unsigned long)line_no);
-        if (tokv) free(tokv);
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
-      }
+static void
+sbx_br_tone(SbxByteReader *r, SbxToneSpec *t) {
+  memset(t, 0, sizeof(*t));
+  t->mode = (SbxToneMode)sbx_br_i32(r);
+  t->carrier_hz = sbx_br_f64(r);
+  t->beat_hz = sbx_br_f64(r);
+  t->orbit_hz = sbx_br_f64(r);
+  t->orbit_distance_m = sbx_br_f64(r);
+  t->orbit_envelope_mode = sbx_br_i32(r);
+  t->amplitude = sbx_br_f64(r);
+  t->waveform = sbx_br_i32(r);
+  t->envelope_waveform = sbx_br_i32(r);
+  t->noise_waveform = sbx_br_i32(r);
+  t->duty_cycle = sbx_br_f64(r);
+  t->iso_start = sbx_br_f64(r);
+  t->iso_attack = sbx_br_f64(r);
+  t->iso_release = sbx_br_f64(r);
+  t->iso_edge_mode = sbx_br_i32(r);
+}
 
-      if (is_sbg_transition_token(tokv[idx])) {
-        interp = sbg_transition_token_to_interp(tokv[idx]);
-        frame.transition_style = sbg_transition_token_to_style(tokv[idx]);
-        had_leading_transition = 1;
-        idx++;
-      }
-      if (idx >= nt) {
-        char emsg[224];
-        snprintf(emsg, sizeof(emsg),
-                 "line %lu: missing tone-spec or named tone-set after transition token",
-                 (unsigned long)line_no);
-        if (tokv) free(tokv);
-        set_ctx_error(ctx, emsg);
-        rc = SBX_EINVAL;
-        goto done;
-      }
+static int
+sbx_compiled_hz_ok(double v) {
+  return isfinite(v) && fabs(v) <= SBX_COMPILED_MAX_HZ;
+}
 
-      while (idx < nt) {
-        int interp_tmp;
-        int bidx = -1;
-        const char *tok = tokv[idx];
-        if (parse_interp_mode_token(tok, &interp_tmp) == SBX_OK) {
-          interp = interp_tmp;
-          idx++;
-          continue;
-        }
-        if (is_sbg_transition_token(tok)) {
-          interp = sbg_transition_token_to_interp(tok);
-          frame.transition_style = sbg_transition_token_to_style(tok);
-          idx++;
-          continue;
-        }
-        rc = sbx_frame_apply_token(&frame, tok, ctx,
-                                   defs, ndefs, &bidx, blocks, nblocks);
-        if (rc != SBX_OK) {
-          char emsg[224];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: invalid tone-spec or unknown named tone-set '%s'",
-                   (unsigned long)line_no, tok);
-          if (tokv) free(tokv);
-          set_ctx_error_token_span(ctx, emsg, line_no, line, tok);
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        if (bidx >= 0) {
-          if (had_leading_transition || idx + 1 < nt ||
-              frame.tone_len > 0 || frame.mix_amp_present || frame.mix_fx_count > 0) {
-            char emsg[256];
-            snprintf(emsg, sizeof(emsg),
-                     "line %lu: block invocation '%s' must appear alone",
-                     (unsigned long)line_no, tok);
-            if (tokv) free(tokv);
-            set_ctx_error_token_span(ctx, emsg, line_no, line, tok);
-            rc = SBX_EINVAL;
-            goto done;
-          }
-          block_idx = bidx;
-          idx++;
-          break;
-        }
-        idx++;
-      }
+static int
+sbx_compiled_unit_ok(double v) {
+  return isfinite(v) && v >= 0.0 && v <= 1.0;
+}
 
-      if (block_idx >= 0) {
-        size_t bi;
-        if (blocks[block_idx].count == 0) {
-          char emsg[256];
-          snprintf(emsg, sizeof(emsg),
-                   "line %lu: block '%s' has no entries",
-                   (unsigned long)line_no, tokv[idx - 1]);
-          if (tokv) free(tokv);
-          set_ctx_error(ctx, emsg);
-          rc = SBX_EINVAL;
-          goto done;
-        }
-        for (bi = 0; bi < blocks[block_idx].count; bi++) {
-          SbxVoiceSetKeyframe expanded = blocks[block_idx].entries[bi];
-          if (count == cap) {
-            size_t ncap = cap ? (cap * 2) : 8;
-            SbxVoiceSetKeyframe *tmp;
-            tmp = (SbxVoiceSetKeyframe *)realloc(frames, ncap * sizeof(*frames));
-            if (!tmp) {
-              set_ctx_error(ctx, "out of memory");
-              rc = SBX_ENOMEM;
-              goto done;
-            }
-            frames = tmp;
-            cap = ncap;
-          }
-          expanded.time_sec = sbx_monotonic_day_wrap(tsec + expanded.time_sec,
-                                                     last_emit_sec);
-          frames[count++] = expanded;
-          last_emit_sec = expanded.time_sec;
-          if (expanded.tone_len > max_voice_count) max_voice_count = expanded.tone_len;
-          if (expanded.mix_fx_count > max_mix_fx_slots) max_mix_fx_slots = expanded.mix_fx_count;
-        }
-        expanded_block = 1;
-      }
-      if (tokv) free(tokv);
-    }
+/* Loaded tones are the normalized ones sbx_context_save_compiled wrote. */
+static int
+sbx_compiled_tone_ok(const SbxToneSpec *t) {
+  if (t->mode < SBX_TONE_NONE || t->mode > SBX_TONE_ORBIT_BEAT) return 0;
+  if (!sbx_compiled_hz_ok(t->carrier_hz) || !sbx_compiled_hz_ok(t->beat_hz) ||
+      !sbx_compiled_hz_ok(t->orbit_hz))
+    return 0;
+  if (!isfinite(t->orbit_distance_m) || t->orbit_distance_m < 0.0 ||
+      t->orbit_distance_m > SBX_ORBIT_MAX_DISTANCE_M)
+    return 0;
+  if (!isfinite(t->amplitude) || (t->mode != SBX_TONE_NONE && !sbx_compiled_unit_ok(t->amplitude)))
+    return 0;
+  if (!sbx_compiled_unit_ok(t->duty_cycle) || !sbx_compiled_unit_ok(t->iso_start) ||
+      !sbx_compiled_unit_ok(t->iso_attack) || !sbx_compiled_unit_ok(t->iso_release) ||
+      t->iso_edge_mode < 0 || t->iso_edge_mode > 3)
+    return 0;
+  if (t->orbit_envelope_mode != SBX_ORBIT_ENV_SINE && t->orbit_envelope_mode != SBX_ORBIT_ENV_ISO)
+    return 0;
+  if (!(t->waveform >= SBX_WAVE_SINE && t->waveform <= SBX_WAVE_SAWTOOTH) &&
+      sbx_spin_wave_index(t->waveform) < 0)
+    return 0;
+  if (t->envelope_waveform != SBX_ENV_WAVE_NONE &&
+      sbx_envelope_wave_legacy_index(t->envelope_waveform) < 0 &&
+      sbx_envelope_wave_custom_index(t->envelope_waveform) < 0)
+    return 0;
+  if (t->noise_waveform != SBX_NOISE_WAVE_NONE && sbx_noise_wave_index(t->noise_waveform) < 0)
+    return 0;
+  return 1;
+}
 
-    if (expanded_block) {
-      line = next;
-      continue;
-    }
+static int
+sbx_compiled_time_ok(double t, double prev, int interp) {
+  return isfinite(t) && t >= 0.0 && t >= prev &&
+         (interp == SBX_INTERP_LINEAR || interp == SBX_INTERP_STEP);
+}
 
-    if (count == cap) {
-      size_t ncap = cap ? (cap * 2) : 8;
-      SbxVoiceSetKeyframe *tmp;
-      tmp = (SbxVoiceSetKeyframe *)realloc(frames, ncap * sizeof(*frames));
-      if (!tmp) {
-        set_ctx_error(ctx, "out of memory");
-        rc = SBX_ENOMEM;
-        goto done;
-      }
-      frames = tmp;
-      cap = ncap;
-    }
+static void
+sbx_bb_mix_fx(SbxByteBuf *b, const SbxMixFxSpec *fx) {
+  sbx_bb_i32(b, fx->type);
+  sbx_bb_i32(b, fx->waveform);
+  sbx_bb_i32(b, fx->envelope_waveform);
+  sbx_bb_i32(b, fx->motion_waveform);
+  sbx_bb_f64(b, fx->carr);
+  sbx_bb_f64(b, fx->res);
+  sbx_bb_f64(b, fx->amp);
+  sbx_bb_i32(b, fx->mixam_mode);
+  sbx_bb_f64(b, fx->mixam_start);
+  sbx_bb_f64(b, fx->mixam_duty);
+  sbx_bb_f64(b, fx->mixam_attack);
+  sbx_bb_f64(b, fx->mixam_release);
+  sbx_bb_i32(b, fx->mixam_edge_mode);
+  sbx_bb_f64(b, fx->mixam_floor);
+  sbx_bb_i32(b, fx->mixam_bind_program_beat);
+}
 
-    if (frame.tone_len == 0 && !frame.mix_amp_present && frame.mix_fx_count == 0) {
-      char emsg[192];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: missing tone-spec or named tone-set",
-               (unsigned long)line_no);
-      set_ctx_error(ctx, emsg);
-      rc = SBX_EINVAL;
-      goto done;
-    }
-    if (frame.mix_fx_count > 0 && !frame.mix_amp_present) {
-      char emsg[256];
-      snprintf(emsg, sizeof(emsg),
-               "line %lu: mix effects require mix/<amp> on the same line or in the referenced named tone-set",
-               (unsigned long)line_no);
-      set_ctx_error(ctx, emsg);
-      rc = SBX_EINVAL;
-      goto done;
+static void
+sbx_br_mix_fx(SbxByteReader *r, SbxMixFxSpec *fx) {
+  memset(fx, 0, sizeof(*fx));
+  fx->type = sbx_br_i32(r);
+  fx->waveform = sbx_br_i32(r);
+  fx->envelope_waveform = sbx_br_i32(r);
+  fx->motion_waveform = sbx_br_i32(r);
+  fx->carr = sbx_br_f64(r);
+  fx->res = sbx_br_f64(r);
+  fx->amp = sbx_br_f64(r);
+  fx->mixam_mode = sbx_br_i32(r);
+  fx->mixam_start = sbx_br_f64(r);
+  fx->mixam_duty = sbx_br_f64(r);
+  fx->mixam_attack = sbx_br_f64(r);
+  fx->mixam_release = sbx_br_f64(r);
+  fx->mixam_edge_mode = sbx_br_i32(r);
+  fx->mixam_floor = sbx_br_f64(r);
+  fx->mixam_bind_program_beat = sbx_br_i32(r);
+}
+
+static void
+sbx_bb_table(SbxByteBuf *b, unsigned kind, size_t idx, const double *v, size_t n) {
+  size_t i;
+  sbx_bb_u8(b, kind);
+  sbx_bb_u8(b, (unsigned)idx);
+  sbx_bb_u8(b, 0);
+  sbx_bb_u8(b, 0);
+  sbx_bb_u32(b, (uint32_t)n);
+  for (i = 0; i < n; i++) sbx_bb_f64(b, v[i]);
+}
+
+int
+sbx_context_save_compiled(SbxContext *ctx, const char *path, const char *preamble_text) {
+  SbxByteBuf b;
+  size_t n, voices, i, vi, pre_len;
+  uint32_t tables = 0;
+  FILE *fp;
+  int rc = SBX_OK;
+
+  if (!ctx || !path) return SBX_EINVAL;
+  if (!ctx->loaded || ctx->source_mode != SBX_CTX_SRC_KEYFRAMES ||
+      !ctx->kf_store.time_sec || ctx->kf_count == 0) {
+    set_ctx_error(ctx, "only keyframe programs can be compiled");
+    return SBX_EINVAL;
+  }
+  n = ctx->kf_count;
+  voices = ctx->mv_voice_count ? ctx->mv_voice_count : 1;
+  pre_len = preamble_text ? strlen(preamble_text) : 0;
+  if (pre_len > 0xffffffffu) {
+    set_ctx_error(ctx, "compiled program preamble is too long");
+    return SBX_EINVAL;
+  }
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    tables += !!ctx->legacy_env_waves[i] + !!ctx->custom_env_waves[i] +
+              !!ctx->spin_waves[i] + !!ctx->noise_profiles[i];
+  }
+
+  memset(&b, 0, sizeof(b));
+  sbx_bb_put(&b, SBX_COMPILED_MAGIC, 8);
+  sbx_bb_u32(&b, SBX_COMPILED_FORMAT_VERSION);
+  sbx_bb_u32(&b, 0);
+  sbx_bb_f64(&b, ctx->eng->cfg.sample_rate);
+  sbx_bb_u32(&b, (uint32_t)voices);
+  sbx_bb_u32(&b, (uint32_t)ctx->sbg_mix_fx_slots);
+  sbx_bb_u64(&b, (uint64_t)n);
+  sbx_bb_u64(&b, (uint64_t)ctx->mix_kf_count);
+  sbx_bb_u64(&b, (uint64_t)ctx->sbg_mix_fx_kf_count);
+  sbx_bb_u32(&b, (uint32_t)pre_len);
+  sbx_bb_u32(&b, tables);
+  if (pre_len) sbx_bb_put(&b, preamble_text, pre_len);
+
+  for (i = 0; i < n; i++) {
+    sbx_bb_f64(&b, ctx->kf_store.time_sec[i]);
+    sbx_bb_u8(&b, ctx->kf_store.interp[i]);
+    sbx_bb_u8(&b, ctx->kf_styles ? ctx->kf_styles[i] : SBX_SEG_STYLE_DIRECT);
+  }
+  for (vi = 0; vi < voices; vi++) {
+    for (i = 0; i < n; i++) {
+      SbxToneSpec tone;
+      sbx_kf_store_tone(&ctx->kf_store, n, vi, i, &tone);
+      sbx_bb_tone(&b, &tone);
     }
-    frame.time_sec = sbx_monotonic_day_wrap(tsec, last_emit_sec);
-    frame.interp = interp;
-    frames[count] = frame;
-    last_emit_sec = frame.time_sec;
-    if (frame.tone_len > max_voice_count) max_voice_count = frame.tone_len;
-    if (frame.mix_fx_count > max_mix_fx_slots) max_mix_fx_slots = frame.mix_fx_count;
-    count++;
-    line = next;
   }
-
-  if (active_block_idx >= 0) {
-    char emsg[256];
-    snprintf(emsg, sizeof(emsg),
-             "unterminated block definition '%s' (missing closing '}')",
-             blocks[active_block_idx].name ? blocks[active_block_idx].name : "?");
-    set_ctx_error(ctx, emsg);
-    rc = SBX_EINVAL;
-    goto done;
+
+  sbx_bb_f64(&b, ctx->mix_default_amp_pct);
+  for (i = 0; i < ctx->mix_kf_count; i++) {
+    sbx_bb_f64(&b, ctx->mix_kf[i].time_sec);
+    sbx_bb_f64(&b, ctx->mix_kf[i].amp_pct);
+    sbx_bb_i32(&b, ctx->mix_kf[i].interp);
+  }
+  for (i = 0; i < ctx->sbg_mix_fx_kf_count; i++) {
+    const SbxMixFxKeyframe *kf = &ctx->sbg_mix_fx_kf[i];
+    size_t j;
+    sbx_bb_f64(&b, kf->time_sec);
+    sbx_bb_i32(&b, kf->interp);
+    sbx_bb_u32(&b, (uint32_t)kf->mix_fx_count);
+    for (j = 0; j < kf->mix_fx_count; j++) sbx_bb_mix_fx(&b, &kf->mix_fx[j]);
+  }
+
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) sbx_bb_i32(&b, ctx->legacy_env_edge_modes[i]);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) sbx_bb_i32(&b, ctx->custom_env_edge_modes[i]);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) sbx_bb_i32(&b, ctx->spin_edge_modes[i]);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    if (ctx->legacy_env_waves[i])
+      sbx_bb_table(&b, SBX_COMPILED_TABLE_LEGACY, i, ctx->legacy_env_waves[i], SBX_CUSTOM_WAVE_SAMPLES);
+    if (ctx->custom_env_waves[i])
+      sbx_bb_table(&b, SBX_COMPILED_TABLE_CUSTOM, i, ctx->custom_env_waves[i], SBX_CUSTOM_WAVE_SAMPLES);
+    if (ctx->spin_waves[i])
+      sbx_bb_table(&b, SBX_COMPILED_TABLE_SPIN, i, ctx->spin_waves[i], SBX_CUSTOM_WAVE_SAMPLES);
+    if (ctx->noise_profiles[i])
+      sbx_bb_table(&b, SBX_COMPILED_TABLE_NOISE, i, ctx->noise_profiles[i]->fir, SBX_NOISE_FIR_TAPS);
+  }
+
+  if (b.oom) {
+    free(b.data);
+    set_ctx_error(ctx, "out of memory");
+    return SBX_ENOMEM;
+  }
+  fp = fopen(path, "wb");
+  if (!fp) {
+    char emsg[256];
+    free(b.data);
+    snprintf(emsg, sizeof(emsg), "cannot create compiled program: %s", path);
+    set_ctx_error(ctx, emsg);
+    return SBX_EINVAL;
+  }
+  if (fwrite(b.data, 1, b.len, fp) != b.len) rc = SBX_ENOTREADY;
+  if (fclose(fp) != 0) rc = SBX_ENOTREADY;
+  free(b.data);
+  if (rc != SBX_OK) {
+    char emsg[256];
+    snprintf(emsg, sizeof(emsg), "failed writing compiled program: %s", path);
+    set_ctx_error(ctx, emsg);
+  }
+  return rc;
+}
+
+typedef struct {
+  uint32_t version;
+  double sample_rate;
+  size_t voices;
+  size_t mix_fx_slots;
+  size_t kf_count;
+  size_t mix_kf_count;
+  size_t mix_fx_kf_count;
+  size_t preamble_len;
+  size_t table_count;
+  const char *preamble;
+} SbxCompiledHeader;
+
+static int
+sbx_compiled_read_header(SbxByteReader *r, SbxCompiledHeader *h, const char **err) {
+  const unsigned char *magic = sbx_br_take(r, 8);
+  uint64_t kf, mk, fk;
+  if (!magic || memcmp(magic, SBX_COMPILED_MAGIC, 8) != 0) {
+    *err = "not a compiled sbagenx program";
+    return SBX_EINVAL;
+  }
+  h->version = sbx_br_u32(r);
+  if (h->version != SBX_COMPILED_FORMAT_VERSION) {
+    *err = "unsupported compiled program version";
+    return SBX_EINVAL;
+  }
+  (void)sbx_br_u32(r);
+  h->sample_rate = sbx_br_f64(r);
+  h->voices = sbx_br_u32(r);
+  h->mix_fx_slots = sbx_br_u32(r);
+  kf = sbx_br_u64(r);
+  mk = sbx_br_u64(r);
+  fk = sbx_br_u64(r);
+  h->preamble_len = sbx_br_u32(r);
+  h->table_count = sbx_br_u32(r);
+  h->preamble = (const char *)sbx_br_take(r, h->preamble_len);
+  /* Counts are bounded by the bytes that would have to follow them. */
+  if (r->bad || kf == 0 || kf > (uint64_t)(r->end - r->p) / 10 ||
+      mk > (uint64_t)(r->end - r->p) / 20 || fk > (uint64_t)(r->end - r->p) / 16 ||
+      h->voices == 0 || h->voices > SBX_MAX_SBG_VOICES ||
+      h->mix_fx_slots > SBX_MAX_SBG_MIXFX || !isfinite(h->sample_rate) ||
+      h->sample_rate <= 0.0) {
+    *err = "corrupt compiled program header";
+    return SBX_EINVAL;
   }
+  h->kf_count = (size_t)kf;
+  h->mix_kf_count = (size_t)mk;
+  h->mix_fx_kf_count = (size_t)fk;
+  return SBX_OK;
+}
 
-  if (count == 0) {
-    set_ctx_error(ctx, "sbg timing text contains no keyframes");
-    rc = SBX_EINVAL;
-    goto done;
+int
+sbx_context_load_compiled_memory(SbxContext *ctx, const void *data, size_t size, int loop) {
+  SbxByteReader r;
+  SbxCompiledHeader h;
+  SbxProgramKeyframe *frames = 0;
+  unsigned char *styles = 0;
+  SbxMixAmpKeyframe *mix_kfs = 0;
+  SbxMixFxKeyframe *mix_fx_kfs = 0;
+  double *legacy_env_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
+  double *custom_env_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
+  double *spin_waves[SBX_CUSTOM_WAVE_COUNT] = {0};
+  SbxNoiseProfile *noise_profiles[SBX_CUSTOM_WAVE_COUNT] = {0};
+  int legacy_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int custom_env_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  int spin_edge_modes[SBX_CUSTOM_WAVE_COUNT];
+  double mix_default;
+  const char *err = 0;
+  size_t i, vi, n;
+  int rc, invalid = 0;
+
+  if (!ctx || !ctx->eng || (!data && size)) return SBX_EINVAL;
+  r.p = (const unsigned char *)data;
+  r.end = r.p + size;
+  r.bad = 0;
+  rc = sbx_compiled_read_header(&r, &h, &err);
+  if (rc != SBX_OK) {
+    set_ctx_error(ctx, err);
+    return rc;
+  }
+  n = h.kf_count;
+  if (h.voices > ((size_t)-1) / sizeof(*frames) / n) {
+    set_ctx_error(ctx, "corrupt compiled program header");
+    return SBX_EINVAL;
   }
 
-  styles = (unsigned char *)calloc(count, sizeof(*styles));
-  if (!styles) {
+  frames = (SbxProgramKeyframe *)calloc(h.voices * n, sizeof(*frames));
+  styles = (unsigned char *)calloc(n, sizeof(*styles));
+  if (h.mix_kf_count)
+    mix_kfs = (SbxMixAmpKeyframe *)calloc(h.mix_kf_count, sizeof(*mix_kfs));
+  if (h.mix_fx_kf_count)
+    mix_fx_kfs = (SbxMixFxKeyframe *)calloc(h.mix_fx_kf_count, sizeof(*mix_fx_kfs));
+  if (!frames || !styles || (h.mix_kf_count && !mix_kfs) ||
+      (h.mix_fx_kf_count && !mix_fx_kfs)) {
     set_ctx_error(ctx, "out of memory");
     rc = SBX_ENOMEM;
     goto done;
   }
 
-  {
-    size_t ki;
-    int have_mix = 0;
-    for (ki = 0; ki < count; ki++) {
-      if (frames[ki].mix_amp_present) {
-        have_mix = 1;
-        break;
-      }
-    }
-    if (have_mix) {
-      mix_kfs = (SbxMixAmpKeyframe *)calloc(count, sizeof(*mix_kfs));
-      if (!mix_kfs) {
-        set_ctx_error(ctx, "out of memory");
-        rc = SBX_ENOMEM;
-        goto done;
-      }
-      for (ki = 0; ki < count; ki++) {
-        mix_kfs[ki].time_sec = frames[ki].time_sec;
-        mix_kfs[ki].interp = frames[ki].interp;
-        mix_kfs[ki].amp_pct = frames[ki].mix_amp_present ? frames[ki].mix_amp_pct : 0.0;
-      }
+  for (i = 0; i < n; i++) {
+    frames[i].time_sec = sbx_br_f64(&r);
+    frames[i].interp = (int)sbx_br_u8(&r);
+    styles[i] = (unsigned char)sbx_br_u8(&r);
+    if (styles[i] > SBX_SEG_STYLE_SBG_SLIDE) r.bad = 1;
+    if (!sbx_compiled_time_ok(frames[i].time_sec, i ? frames[i - 1].time_sec : 0.0,
+                              frames[i].interp))
+      invalid = 1;
+  }
+  for (vi = 0; vi < h.voices; vi++) {
+    for (i = 0; i < n; i++) {
+      SbxProgramKeyframe *kf = &frames[vi * n + i];
+      kf->time_sec = frames[i].time_sec;
+      kf->interp = frames[i].interp;
+      sbx_br_tone(&r, &kf->tone);
+      if (!sbx_compiled_tone_ok(&kf->tone)) invalid = 1;
+    }
+  }
+  mix_default = sbx_br_f64(&r);
+  if (!isfinite(mix_default)) invalid = 1;
+  for (i = 0; i < h.mix_kf_count; i++) {
+    mix_kfs[i].time_sec = sbx_br_f64(&r);
+    mix_kfs[i].amp_pct = sbx_br_f64(&r);
+    mix_kfs[i].interp = sbx_br_i32(&r);
+    if (!sbx_compiled_time_ok(mix_kfs[i].time_sec, i ? mix_kfs[i - 1].time_sec : 0.0,
+                              mix_kfs[i].interp) ||
+        !isfinite(mix_kfs[i].amp_pct))
+      invalid = 1;
+  }
+  for (i = 0; i < h.mix_fx_kf_count && !r.bad; i++) {
+    size_t j, cnt;
+    mix_fx_kfs[i].time_sec = sbx_br_f64(&r);
+    mix_fx_kfs[i].interp = sbx_br_i32(&r);
+    cnt = sbx_br_u32(&r);
+    if (cnt > h.mix_fx_slots) r.bad = 1;
+    mix_fx_kfs[i].mix_fx_count = r.bad ? 0 : cnt;
+    if (!sbx_compiled_time_ok(mix_fx_kfs[i].time_sec, i ? mix_fx_kfs[i - 1].time_sec : 0.0,
+                              mix_fx_kfs[i].interp))
+      invalid = 1;
+    for (j = 0; j < mix_fx_kfs[i].mix_fx_count; j++) {
+      SbxMixFxSpec *fx = &mix_fx_kfs[i].mix_fx[j];
+      sbx_br_mix_fx(&r, fx);
+      if (sbx_validate_mix_fx_spec_fields(fx) != SBX_OK || !sbx_compiled_hz_ok(fx->carr) ||
+          !sbx_compiled_hz_ok(fx->res))
+        invalid = 1;
+    }
+  }
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) legacy_env_edge_modes[i] = sbx_br_i32(&r);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) custom_env_edge_modes[i] = sbx_br_i32(&r);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) spin_edge_modes[i] = sbx_br_i32(&r);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    if (legacy_env_edge_modes[i] < 0 || legacy_env_edge_modes[i] > 3 ||
+        custom_env_edge_modes[i] < 0 || custom_env_edge_modes[i] > 3 ||
+        spin_edge_modes[i] < 0 || spin_edge_modes[i] > 3)
+      invalid = 1;
+  }
+  for (i = 0; i < h.table_count && !r.bad; i++) {
+    unsigned kind = sbx_br_u8(&r);
+    unsigned idx = sbx_br_u8(&r);
+    size_t want, j, cnt;
+    double *dst;
+    (void)sbx_br_u8(&r);
+    (void)sbx_br_u8(&r);
+    cnt = sbx_br_u32(&r);
+    want = (kind == SBX_COMPILED_TABLE_NOISE) ? SBX_NOISE_FIR_TAPS : SBX_CUSTOM_WAVE_SAMPLES;
+    if (r.bad || kind > SBX_COMPILED_TABLE_NOISE || idx >= SBX_CUSTOM_WAVE_COUNT || cnt != want ||
+        (size_t)(r.end - r.p) / 8 < cnt) {
+      r.bad = 1;
+      break;
     }
-    if (max_mix_fx_slots > 0) {
-      mix_fx_kfs = (SbxMixFxKeyframe *)calloc(count, sizeof(*mix_fx_kfs));
-      if (!mix_fx_kfs) {
-        set_ctx_error(ctx, "out of memory");
-        rc = SBX_ENOMEM;
+    if (kind == SBX_COMPILED_TABLE_NOISE) {
+      if (h.sample_rate != ctx->eng->cfg.sample_rate) {
+        char emsg[160];
+        snprintf(emsg, sizeof(emsg),
+                 "compiled program noise profiles were designed for %.0f Hz (context is %.0f Hz)",
+                 h.sample_rate, ctx->eng->cfg.sample_rate);
+        set_ctx_error(ctx, emsg);
+        rc = SBX_EINVAL;
         goto done;
       }
-      for (ki = 0; ki < count; ki++) {
-        mix_fx_kfs[ki].time_sec = frames[ki].time_sec;
-        mix_fx_kfs[ki].interp = frames[ki].interp;
-        mix_fx_kfs[ki].mix_fx_count = frames[ki].mix_fx_count;
-        memcpy(mix_fx_kfs[ki].mix_fx, frames[ki].mix_fx, sizeof(mix_fx_kfs[ki].mix_fx));
-      }
-    }
-  }
-
-  primary = (SbxProgramKeyframe *)calloc(count, sizeof(*primary));
-  if (!primary) {
-    set_ctx_error(ctx, "out of memory");
-    rc = SBX_ENOMEM;
-    goto done;
-  }
-  if (max_voice_count > 1) {
-    size_t vi;
-    mv_frames = (SbxProgramKeyframe *)calloc(max_voice_count * count, sizeof(*mv_frames));
-    if (!mv_frames) {
+      if (noise_profiles[idx]) { r.bad = 1; break; }
+      noise_profiles[idx] = (SbxNoiseProfile *)calloc(1, sizeof(SbxNoiseProfile));
+      dst = noise_profiles[idx] ? noise_profiles[idx]->fir : 0;
+    } else {
+      double **slot = (kind == SBX_COMPILED_TABLE_LEGACY) ? &legacy_env_waves[idx] :
+                      (kind == SBX_COMPILED_TABLE_CUSTOM) ? &custom_env_waves[idx] :
+                      &spin_waves[idx];
+      if (*slot) { r.bad = 1; break; }
+      *slot = (double *)malloc(cnt * sizeof(double));
+      dst = *slot;
+    }
+    if (!dst) {
       set_ctx_error(ctx, "out of memory");
       rc = SBX_ENOMEM;
       goto done;
     }
-    for (vi = 0; vi < max_voice_count; vi++) {
-      size_t ki;
-      for (ki = 0; ki < count; ki++) {
-        mv_frames[vi * count + ki].time_sec = frames[ki].time_sec;
-        mv_frames[vi * count + ki].tone = frames[ki].tones[vi];
-        mv_frames[vi * count + ki].interp = frames[ki].interp;
-      }
+    for (j = 0; j < cnt; j++) {
+      dst[j] = sbx_br_f64(&r);
+      if (!isfinite(dst[j])) invalid = 1;
     }
   }
-  {
-    size_t ki;
-    for (ki = 0; ki < count; ki++) {
-      styles[ki] = (unsigned char)frames[ki].transition_style;
-      primary[ki].time_sec = frames[ki].time_sec;
-      primary[ki].tone = frames[ki].tones[0];
-      primary[ki].interp = frames[ki].interp;
-    }
+  if (r.bad) {
+    set_ctx_error(ctx, "corrupt or truncated compiled program");
+    rc = SBX_EINVAL;
+    goto done;
+  }
+  if (invalid) {
+    set_ctx_error(ctx, "corrupt compiled program: values out of range");
+    rc = SBX_EINVAL;
+    goto done;
   }
 
   ctx_replace_custom_waves(ctx, legacy_env_waves, custom_env_waves, spin_waves, noise_profiles,
                            legacy_env_edge_modes, custom_env_edge_modes, spin_edge_modes);
-  rc = ctx_activate_keyframes_internal(ctx, primary, count,
-                                       mv_frames ? mv_frames : primary,
-                                       max_voice_count ? max_voice_count : 1,
-                                       styles,
-                                       loop);
+  rc = ctx_activate_keyframes_internal(ctx, frames, n, frames, h.voices, styles, loop);
   if (rc != SBX_OK) goto done;
-  rc = sbx_context_set_mix_amp_keyframes(ctx, mix_kfs, mix_kfs ? count : 0,
-                                         mix_kfs ? 0.0 : 100.0);
+  rc = sbx_context_set_mix_amp_keyframes(ctx, mix_kfs, h.mix_kf_count, mix_default);
   if (rc != SBX_OK) goto done;
-  rc = ctx_set_sbg_mix_effect_keyframes_internal(ctx, mix_fx_kfs,
-                                                 mix_fx_kfs ? count : 0,
-                                                 max_mix_fx_slots);
+  rc = ctx_set_sbg_mix_effect_keyframes_internal(ctx, mix_fx_kfs, h.mix_fx_kf_count,
+                                                 h.mix_fx_slots);
 
 done:
-  if (defs) {
-    size_t i;
-    for (i = 0; i < ndefs; i++) {
-      if (defs[i].name) free(defs[i].name);
-    }
-    free(defs);
-  }
-  if (blocks) {
-    size_t i;
-    for (i = 0; i < nblocks; i++) {
-      if (blocks[i].name) free(blocks[i].name);
-      if (blocks[i].entries) free(blocks[i].entries);
-    }
-    free(blocks);
+  for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
+    if (legacy_env_waves[i]) free(legacy_env_waves[i]);
+    if (custom_env_waves[i]) free(custom_env_waves[i]);
+    if (spin_waves[i]) free(spin_waves[i]);
+    if (noise_profiles[i]) free(noise_profiles[i]);
   }
   if (frames) free(frames);
-  if (primary) free(primary);
-  if (mv_frames) free(mv_frames);
   if (styles) free(styles);
   if (mix_kfs) free(mix_kfs);
   if (mix_fx_kfs) free(mix_fx_kfs);
-  {
-    size_t i;
-    for (i = 0; i < SBX_CUSTOM_WAVE_COUNT; i++) {
-      if (legacy_env_waves[i]) free(legacy_env_waves[i]);
-      if (custom_env_waves[i]) free(custom_env_waves[i]);
-      if (spin_waves[i]) free(spin_waves[i]);
-      if (noise_profiles[i]) free(noise_profiles[i]);
-    }
-  }
-  if (buf) free(buf);
   return rc;
 }
 
 int
-sbx_context_load_sbg_timing_file(SbxContext *ctx, const char *path, int loop) {
-  char *text = 0;
+sbx_context_load_compiled(SbxContext *ctx, const char *path, int loop) {
+  SbxTextFile tf;
   int rc;
   if (!ctx || !ctx->eng || !path) return SBX_EINVAL;
 
-  rc = read_text_file_alloc(path, &text);
+  rc = sbx_file_view_open(path, &tf, 1);
   if (rc == SBX_EINVAL) {
     char emsg[256];
-    snprintf(emsg, sizeof(emsg), "cannot open sbg timing file: %s", path);
+    snprintf(emsg, sizeof(emsg), "cannot open compiled program: %s", path);
     set_ctx_error(ctx, emsg);
     return rc;
   } else if (rc == SBX_ENOMEM) {
     set_ctx_error(ctx, "out of memory");
     return rc;
   } else if (rc != SBX_OK) {
-    set_ctx_error(ctx, "failed reading sbg timing file");
+    set_ctx_error(ctx, "failed reading compiled program");
     return rc;
   }
 
-  rc = sbx_context_load_sbg_timing_text(ctx, text, loop);
-  free(text);
+  rc = sbx_context_load_compiled_memory(ctx, tf.text, tf.len, loop);
+  sbx_text_file_close(&tf);
   return rc;
 }
 
+int
+sbx_compiled_read_preamble(const char *path, char **out_text, char *errbuf, size_t errbuf_sz) {
+  SbxTextFile tf;
+  SbxByteReader r;
+  SbxCompiledHeader h;
+  const char *err = 0;
+  char *text;
+  int rc;
+
+  if (errbuf && errbuf_sz) errbuf[0] = 0;
+  if (!path || !out_text) return SBX_EINVAL;
+  *out_text = 0;
+  rc = sbx_file_view_open(path, &tf, 1);
+  if (rc != SBX_OK) {
+    sbx_set_api_error(errbuf, errbuf_sz, "unable to read compiled program: %s", path);
+    return rc;
+  }
+  r.p = (const unsigned char *)tf.text;
+  r.end = r.p + tf.len;
+  r.bad = 0;
+  rc = sbx_compiled_read_header(&r, &h, &err);
+  if (rc != SBX_OK) {
+    sbx_set_api_error(errbuf, errbuf_sz, "%s: %s", path, err);
+    sbx_text_file_close(&tf);
+    return rc;
+  }
+  text = (char *)malloc(h.preamble_len + 1);
+  if (!text) {
+    sbx_text_file_close(&tf);
+    sbx_set_api_error(errbuf, errbuf_sz, "out of memory reading compiled program");
+    return SBX_ENOMEM;
+  }
+  if (h.preamble_len) memcpy(text, h.preamble, h.preamble_len);
+  text[h.preamble_len] = 0;
+  sbx_text_file_close(&tf);
+  *out_text = text;
+  return SBX_OK;
+}
+
 int
 sbx_context_set_aux_tones(SbxContext *ctx, const SbxToneSpec *tones, size_t tone_count) {
   SbxToneSpec *copy = 0;
@@ -11193,6 +16282,8 @@ sbx_context_apply_mix_effects_at(SbxContext *ctx,
   }
 
   for (i = 0; i < ctx->mix_fx_count; i++) {
+    if (sbx_mix_fx_bypassed_at(&ctx->mix_fx[i], t_sec))
+      continue;
     if (ctx_eval_curve_mix_effect_spec(ctx, t_sec, &ctx->mix_fx[i].spec, &spec) != SBX_OK)
       return SBX_EINVAL;
     if (spec.type == SBX_MIXFX_AM)
@@ -11266,6 +16357,8 @@ sbx_context_mix_stream_sample(SbxContext *ctx,
       return SBX_ENOTREADY;
     }
     for (i = 0; i < ctx->mix_fx_count; i++) {
+      if (sbx_mix_fx_bypassed_at(&ctx->mix_fx[i], t_sec))
+        continue;
       if (ctx_eval_curve_mix_effect_spec(ctx, t_sec, &ctx->mix_fx[i].spec, &curve_fx) != SBX_OK)
         return SBX_EINVAL;
       if (curve_fx.type == SBX_MIXFX_AM && curve_fx.mixam_bind_program_beat) {
@@ -11276,6 +16369,8 @@ sbx_context_mix_stream_sample(SbxContext *ctx,
     if (need_program_beat)
       program_beat_hz = ctx_eval_program_beat_hz(ctx, t_sec);
     for (i = 0; i < ctx->mix_fx_count; i++) {
+      if (sbx_mix_fx_bypassed_at(&ctx->mix_fx[i], t_sec))
+        continue;
       if (ctx_eval_curve_mix_effect_spec(ctx, t_sec, &ctx->mix_fx[i].spec, &curve_fx) != SBX_OK)
         return SBX_EINVAL;
       if (curve_fx.type == SBX_MIXFX_AM) {
@@ -11700,10 +16795,11 @@ sbx_context_mix_mod_mul_at(SbxContext *ctx, double t_sec) {
 double
 sbx_context_mix_amp_effective_at(SbxContext *ctx, double t_sec) {
   int idx;
+  double value;
   if (!ctx) return 100.0;
   idx = sbx_live_control_kind_index(SBX_LIVE_CONTROL_MIX_AMP_PCT);
-  if (idx >= 0 && ctx->live_ctrl[idx].active)
-    return sbx_live_control_slot_value_at(&ctx->live_ctrl[idx], t_sec, 0);
+  if (idx >= 0 && sbx_live_control_slot_lookup(&ctx->live_ctrl[idx], t_sec, 1, &value))
+    return value;
   return ctx_mix_amp_effective_base_at(ctx, t_sec);
 }
 
@@ -11928,6 +17024,67 @@ sbx_context_set_telemetry_callback(SbxContext *ctx,
   return SBX_OK;
 }
 
+int
+sbx_context_set_telemetry_stream(SbxContext *ctx, double rate_hz, size_t capacity) {
+  SbxRuntimeTelemetry *ring;
+  double sr;
+  unsigned int cap = 1;
+  if (!ctx || !ctx->eng) return SBX_EINVAL;
+  if (!isfinite(rate_hz) || rate_hz <= 0.0 || capacity == 0) {
+    free(ctx->telem_ring);
+    ctx->telem_ring = 0;
+    ctx->telem_cap = 0;
+    ctx->telem_head = ctx->telem_tail = ctx->telem_dropped = 0;
+    set_ctx_error(ctx, NULL);
+    return SBX_OK;
+  }
+  sr = ctx->eng->cfg.sample_rate;
+  if (!(isfinite(sr) && sr > 0.0)) {
+    set_ctx_error(ctx, "engine configuration is invalid");
+    return SBX_ENOTREADY;
+  }
+  if (capacity > 65536) {
+    set_ctx_error(ctx, "telemetry stream capacity must be <= 65536");
+    return SBX_EINVAL;
+  }
+  while (cap < capacity) cap <<= 1;
+  ring = (SbxRuntimeTelemetry *)calloc(cap, sizeof(*ring));
+  if (!ring) {
+    set_ctx_error(ctx, "out of memory");
+    return SBX_ENOMEM;
+  }
+  free(ctx->telem_ring);
+  ctx->telem_ring = ring;
+  ctx->telem_cap = cap;
+  ctx->telem_head = ctx->telem_tail = ctx->telem_dropped = 0;
+  ctx->telem_interval_frames = (uint64_t)llround(sr / rate_hz);
+  if (ctx->telem_interval_frames == 0) ctx->telem_interval_frames = 1;
+  ctx->telem_next_frame = ctx->frame_pos;
+  set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+size_t
+sbx_context_read_telemetry(SbxContext *ctx, SbxRuntimeTelemetry *out, size_t max_count) {
+  unsigned int head, tail;
+  size_t n = 0;
+  if (!ctx || !ctx->telem_ring || !out) return 0;
+  head = ctx->telem_head;
+  tail = SBX_LOAD_ACQUIRE(&ctx->telem_tail);
+  while (head != tail && n < max_count) {
+    out[n++] = ctx->telem_ring[head & (ctx->telem_cap - 1U)];
+    head++;
+  }
+  SBX_STORE_RELEASE(&ctx->telem_head, head);
+  return n;
+}
+
+size_t
+sbx_context_telemetry_dropped(const SbxContext *ctx) {
+  if (!ctx) return 0;
+  return SBX_LOAD_ACQUIRE(&ctx->telem_dropped);
+}
+
 int
 sbx_context_get_runtime_telemetry(SbxContext *ctx, SbxRuntimeTelemetry *out) {
   int rc;
@@ -11960,6 +17117,7 @@ sbx_context_set_live_control(SbxContext *ctx, int kind, double value) {
   slot = &ctx->live_ctrl[idx];
   slot->active = 1;
   slot->ramp_active = 0;
+  slot->has_prev = 0;
   slot->immediate_value = value;
   slot->start_value = value;
   slot->target_value = value;
@@ -12002,6 +17160,7 @@ sbx_context_ramp_live_control(SbxContext *ctx,
   slot = &ctx->live_ctrl[idx];
   slot->active = 1;
   slot->ramp_active = 1;
+  slot->has_prev = 0;
   slot->immediate_value = start_value;
   slot->start_value = start_value;
   slot->target_value = target_value;
@@ -12051,13 +17210,224 @@ sbx_context_clear_live_control(SbxContext *ctx, int kind) {
 void
 sbx_context_clear_live_controls(SbxContext *ctx) {
   if (!ctx) return;
-  ctx_clear_live_controls_internal(ctx);
+  ctx_clear_live_slots(ctx);
+  set_ctx_error(ctx, NULL);
+}
+
+/*
+ * Producer side of the live-control queue. Only the posting thread writes
+ * live_q_tail and only the render thread writes live_q_head, so one acquire
+ * load plus one release store is enough; nothing here touches context state
+ * the render thread owns, including last_error.
+ */
+static int
+ctx_post_live_command(SbxContext *ctx, int op, int kind, double value, double duration_sec) {
+  unsigned int head, tail;
+  SbxLiveControlCmd *cmd;
+  if (!ctx) return SBX_EINVAL;
+  if (op != SBX_LIVE_CMD_CLEAR_ALL && sbx_live_control_kind_index(kind) < 0)
+    return SBX_EINVAL;
+  if (!isfinite(value) || !isfinite(duration_sec) || duration_sec < 0.0)
+    return SBX_EINVAL;
+  tail = ctx->live_q_tail;
+  head = SBX_LOAD_ACQUIRE(&ctx->live_q_head);
+  if (tail - head >= SBX_LIVE_QUEUE_CAP)
+    return SBX_EBUSY;
+  cmd = &ctx->live_q[tail & (SBX_LIVE_QUEUE_CAP - 1)];
+  cmd->op = op;
+  cmd->kind = kind;
+  cmd->value = value;
+  cmd->duration_sec = duration_sec;
+  SBX_STORE_RELEASE(&ctx->live_q_tail, tail + 1U);
+  return SBX_OK;
+}
+
+/* Consumer side: apply every posted command in order at the current time. */
+static void
+ctx_drain_live_control_queue(SbxContext *ctx) {
+  unsigned int head, tail;
+  head = ctx->live_q_head;
+  tail = SBX_LOAD_ACQUIRE(&ctx->live_q_tail);
+  while (head != tail) {
+    SbxLiveControlCmd cmd = ctx->live_q[head & (SBX_LIVE_QUEUE_CAP - 1)];
+    head++;
+    SBX_STORE_RELEASE(&ctx->live_q_head, head);
+    /* Rejected commands leave their reason in sbx_context_last_error(). */
+    switch (cmd.op) {
+      case SBX_LIVE_CMD_SET:
+        sbx_context_set_live_control(ctx, cmd.kind, cmd.value);
+        break;
+      case SBX_LIVE_CMD_RAMP:
+        sbx_context_ramp_live_control(ctx, cmd.kind, cmd.value, cmd.duration_sec);
+        break;
+      case SBX_LIVE_CMD_CLEAR:
+        sbx_context_clear_live_control(ctx, cmd.kind);
+        break;
+      default:
+        ctx_clear_live_slots(ctx);
+        break;
+    }
+  }
+}
+
+int
+sbx_context_post_live_control(SbxContext *ctx,
+                              int kind,
+                              double target_value,
+                              double duration_sec) {
+  return ctx_post_live_command(ctx,
+                               duration_sec > 0.0 ? SBX_LIVE_CMD_RAMP : SBX_LIVE_CMD_SET,
+                               kind, target_value, duration_sec);
+}
+
+int
+sbx_context_post_clear_live_control(SbxContext *ctx, int kind) {
+  return ctx_post_live_command(ctx, SBX_LIVE_CMD_CLEAR, kind, 0.0, 0.0);
+}
+
+int
+sbx_context_post_clear_live_controls(SbxContext *ctx) {
+  return ctx_post_live_command(ctx, SBX_LIVE_CMD_CLEAR_ALL, 0, 0.0, 0.0);
+}
+
+void
+sbx_context_apply_posted_live_controls(SbxContext *ctx) {
+  if (!ctx || !ctx->eng) return;
+  ctx_drain_live_control_queue(ctx);
+}
+
+void
+sbx_default_scheduled_event(SbxScheduledEvent *event) {
+  if (!event) return;
+  memset(event, 0, sizeof(*event));
+  event->type = SBX_EVENT_SET_CONTROL;
+}
+
+int
+sbx_context_schedule_event(SbxContext *ctx,
+                           uint64_t frame,
+                           const SbxScheduledEvent *event) {
+  size_t pos;
+  if (!ctx || !ctx->eng || !event) return SBX_EINVAL;
+  switch (event->type) {
+    case SBX_EVENT_SET_CONTROL:
+    case SBX_EVENT_RAMP_CONTROL:
+    case SBX_EVENT_CLEAR_CONTROL:
+      if (sbx_live_control_kind_index(event->kind) < 0) {
+        set_ctx_error(ctx, "unsupported live control kind");
+        return SBX_EINVAL;
+      }
+      break;
+    case SBX_EVENT_MIX_EFFECT_ENABLE:
+      break;
+    default:
+      set_ctx_error(ctx, "unsupported scheduled event type");
+      return SBX_EINVAL;
+  }
+  if (!isfinite(event->value) || !isfinite(event->duration_sec) ||
+      event->duration_sec < 0.0) {
+    set_ctx_error(ctx, "scheduled event value and duration must be finite, duration >= 0");
+    return SBX_EINVAL;
+  }
+
+  if (ctx->ev_next > 0) {
+    memmove(ctx->ev, ctx->ev + ctx->ev_next,
+            (ctx->ev_count - ctx->ev_next) * sizeof(*ctx->ev));
+    ctx->ev_count -= ctx->ev_next;
+    ctx->ev_next = 0;
+  }
+  if (ctx->ev_count == ctx->ev_cap) {
+    size_t cap = ctx->ev_cap ? ctx->ev_cap * 2 : 16;
+    SbxScheduledEventEntry *tmp =
+      (SbxScheduledEventEntry *)realloc(ctx->ev, cap * sizeof(*tmp));
+    if (!tmp) {
+      set_ctx_error(ctx, "out of memory");
+      return SBX_ENOMEM;
+    }
+    ctx->ev = tmp;
+    ctx->ev_cap = cap;
+  }
+  /* Keep the list sorted by frame; equal frames stay in scheduling order. */
+  pos = ctx->ev_count;
+  while (pos > 0 && ctx->ev[pos - 1].frame > frame)
+    pos--;
+  memmove(ctx->ev + pos + 1, ctx->ev + pos, (ctx->ev_count - pos) * sizeof(*ctx->ev));
+  ctx->ev[pos].frame = frame;
+  ctx->ev[pos].ev = *event;
+  ctx->ev_count++;
   set_ctx_error(ctx, NULL);
+  return SBX_OK;
+}
+
+void
+sbx_context_clear_scheduled_events(SbxContext *ctx) {
+  if (!ctx) return;
+  ctx->ev_count = 0;
+  ctx->ev_next = 0;
+}
+
+size_t
+sbx_context_scheduled_event_count(const SbxContext *ctx) {
+  if (!ctx) return 0;
+  return ctx->ev_count - ctx->ev_next;
+}
+
+uint64_t
+sbx_context_frame_position(const SbxContext *ctx) {
+  if (!ctx) return 0;
+  return ctx->frame_pos;
+}
+
+/* Apply one due event at ctx->frame_pos, recording the pre-event state so
+ * host mix sampling of earlier frames in the same block is unaffected. */
+static int
+ctx_apply_scheduled_event(SbxContext *ctx, const SbxScheduledEvent *ev) {
+  SbxLiveControlSlot *slot;
+  SbxMixFxState *fx;
+  double prev_value = 0.0;
+  double since_sec;
+  int prev_active;
+  int rc;
+
+  /* Hosts sample a block at t0 + frame / sr without wrapping, so do the same. */
+  since_sec = ctx->ev_block_t0 +
+              (double)(ctx->frame_pos - ctx->ev_block_frame0) / ctx->eng->cfg.sample_rate;
+  if (ev->type == SBX_EVENT_MIX_EFFECT_ENABLE) {
+    if (ev->index >= ctx->mix_fx_count) {
+      set_ctx_error(ctx, "scheduled mix effect index is out of range");
+      return SBX_EINVAL;
+    }
+    fx = &ctx->mix_fx[ev->index];
+    fx->bypass_prev = sbx_mix_fx_bypassed_at(fx, since_sec);
+    fx->bypass = (ev->value == 0.0);
+    fx->bypass_has_prev = 1;
+    fx->bypass_since_sec = since_sec;
+    ctx->ev_prev_held = 1;
+    return SBX_OK;
+  }
+
+  slot = &ctx->live_ctrl[sbx_live_control_kind_index(ev->kind)];
+  prev_active = sbx_live_control_slot_lookup(slot, since_sec, 1, &prev_value);
+  if (ev->type == SBX_EVENT_SET_CONTROL) {
+    rc = sbx_context_set_live_control(ctx, ev->kind, ev->value);
+  } else if (ev->type == SBX_EVENT_RAMP_CONTROL) {
+    rc = sbx_context_ramp_live_control(ctx, ev->kind, ev->value, ev->duration_sec);
+  } else {
+    memset(slot, 0, sizeof(*slot));
+    rc = SBX_OK;
+  }
+  if (rc != SBX_OK) return rc;
+  slot->has_prev = 1;
+  slot->prev_active = prev_active;
+  slot->prev_value = prev_value;
+  slot->since_sec = since_sec;
+  ctx->ev_prev_held = 1;
+  return SBX_OK;
 }
 
 size_t
 sbx_context_keyframe_count(const SbxContext *ctx) {
-  if (!ctx || !ctx->kfs) return 0;
+  if (!ctx || !ctx->kf_store.time_sec) return 0;
   return ctx->kf_count;
 }
 
@@ -12065,7 +17435,7 @@ size_t
 sbx_context_voice_count(const SbxContext *ctx) {
   if (!ctx || !ctx->loaded) return 0;
   if (ctx->source_mode != SBX_CTX_SRC_KEYFRAMES ||
-      !ctx->kfs || ctx->kf_count == 0)
+      !ctx->kf_store.time_sec || ctx->kf_count == 0)
     return 1;
   if (ctx->mv_voice_count == 0) return 1;
   return ctx->mv_voice_count;
@@ -12087,9 +17457,9 @@ sbx_context_is_looping(const SbxContext *ctx) {
 
 int
 sbx_context_get_keyframe(const SbxContext *ctx, size_t index, SbxProgramKeyframe *out) {
-  if (!ctx || !out || !ctx->kfs) return SBX_EINVAL;
+  if (!ctx || !out || !ctx->kf_store.time_sec) return SBX_EINVAL;
   if (index >= ctx->kf_count) return SBX_EINVAL;
-  *out = ctx->kfs[index];
+  sbx_kf_store_frame(&ctx->kf_store, ctx->kf_count, 0, index, out);
   return SBX_OK;
 }
 
@@ -12098,14 +17468,10 @@ sbx_context_get_keyframe_voice(const SbxContext *ctx,
                                size_t index,
                                size_t voice_index,
                                SbxProgramKeyframe *out) {
-  if (!ctx || !out || !ctx->kfs) return SBX_EINVAL;
+  if (!ctx || !out || !ctx->kf_store.time_sec) return SBX_EINVAL;
   if (index >= ctx->kf_count) return SBX_EINVAL;
   if (voice_index >= sbx_context_voice_count(ctx)) return SBX_EINVAL;
-  if (voice_index == 0 || !ctx->mv_kfs) {
-    *out = ctx->kfs[index];
-    return SBX_OK;
-  }
-  *out = SBX_MV_KF(ctx, voice_index)[index];
+  sbx_kf_store_frame(&ctx->kf_store, ctx->kf_count, voice_index, index, out);
   return SBX_OK;
 }
 
@@ -12113,10 +17479,12 @@ double
 sbx_context_duration_sec(const SbxContext *ctx) {
   if (!ctx) return 0.0;
   if (ctx->source_mode == SBX_CTX_SRC_KEYFRAMES &&
-      ctx->kfs && ctx->kf_count > 0)
+      ctx->kf_store.time_sec && ctx->kf_count > 0)
     return ctx->kf_duration_sec;
   if (ctx->source_mode == SBX_CTX_SRC_CURVE && ctx->curve_prog)
     return ctx->curve_duration_sec;
+  if (ctx->source_mode == SBX_CTX_SRC_BUILTIN)
+    return ctx->builtin_src.main_sec + ctx->builtin_src.wake_sec + ctx->builtin_src.fade_sec;
   return 0.0;
 }
 
@@ -12131,8 +17499,17 @@ sbx_context_set_time_sec(SbxContext *ctx, double t_sec) {
     set_ctx_error(ctx, "no tone/program loaded");
     return SBX_ENOTREADY;
   }
+  if (ctx->sbg_stream && ctx->kf_count > 0 && t_sec < ctx->kf_store.time_sec[0]) {
+    set_ctx_error(ctx, "cannot seek before the buffered window of a streamed program");
+    return SBX_EINVAL;
+  }
   ctx_reset_runtime(ctx);
+  ctx_drop_event_prev_states(ctx);
   ctx->t_sec = t_sec;
+  ctx->frame_pos = (uint64_t)llround(t_sec * ctx->eng->cfg.sample_rate);
+  if (ctx->sbg_stream) ctx_sbg_stream_note_play(ctx);
+  if (ctx->source_mode == SBX_CTX_SRC_BUILTIN)
+    ctx_sync_builtin_phase(ctx, t_sec);
   set_ctx_error(ctx, NULL);
   return SBX_OK;
 }
@@ -12204,7 +17581,6 @@ sbx_context_sample_tones_voice(SbxContext *ctx,
                                SbxToneSpec *out_tones) {
   size_t i;
   size_t seg_saved;
-  const SbxProgramKeyframe *kfs = 0;
   if (!ctx || !ctx->eng || !out_tones || sample_count == 0)
     return SBX_EINVAL;
   if (!ctx->loaded) {
@@ -12229,7 +17605,7 @@ sbx_context_sample_tones_voice(SbxContext *ctx,
       double u = (sample_count <= 1) ? 0.0 : (double)i / (double)(sample_count - 1);
       double ts = sbx_lerp(t0_sec, t1_sec, u);
       out_tones[i] = ctx->static_tone;
-      if (ctx_apply_live_controls_to_tone(ctx, ts, &out_tones[i]) != SBX_OK)
+      if (ctx_apply_live_controls_to_tone(ctx, ts, 1, &out_tones[i]) != SBX_OK)
         return SBX_EINVAL;
       if (out_t_sec) out_t_sec[i] = ts;
     }
@@ -12237,7 +17613,8 @@ sbx_context_sample_tones_voice(SbxContext *ctx,
     return SBX_OK;
   }
 
-  if (ctx->source_mode == SBX_CTX_SRC_CURVE) {
+  if (ctx->source_mode == SBX_CTX_SRC_CURVE ||
+      ctx->source_mode == SBX_CTX_SRC_BUILTIN) {
     if (voice_index != 0) {
       set_ctx_error(ctx, "voice index is out of range");
       return SBX_EINVAL;
@@ -12245,9 +17622,11 @@ sbx_context_sample_tones_voice(SbxContext *ctx,
     for (i = 0; i < sample_count; i++) {
       double u = (sample_count <= 1) ? 0.0 : (double)i / (double)(sample_count - 1);
       double ts = sbx_lerp(t0_sec, t1_sec, u);
-      if (ctx_eval_curve_tone(ctx, ts, &out_tones[i]) != SBX_OK)
+      if (ctx->source_mode == SBX_CTX_SRC_BUILTIN)
+        ctx_eval_builtin_tone(ctx, ts, &out_tones[i]);
+      else if (ctx_eval_curve_tone(ctx, ts, &out_tones[i]) != SBX_OK)
         return SBX_EINVAL;
-      if (ctx_apply_live_controls_to_tone(ctx, ts, &out_tones[i]) != SBX_OK)
+      if (ctx_apply_live_controls_to_tone(ctx, ts, 1, &out_tones[i]) != SBX_OK)
         return SBX_EINVAL;
       if (out_t_sec) out_t_sec[i] = ts;
     }
@@ -12255,12 +17634,11 @@ sbx_context_sample_tones_voice(SbxContext *ctx,
     return SBX_OK;
   }
 
-  if (!ctx->kfs || ctx->kf_count == 0) {
+  if (!ctx->kf_store.time_sec || ctx->kf_count == 0) {
     set_ctx_error(ctx, "no keyframes loaded");
     return SBX_ENOTREADY;
   }
 
-  kfs = (voice_index == 0 || !ctx->mv_kfs) ? ctx->kfs : SBX_MV_KF(ctx, voice_index);
   seg_saved = (voice_index == 0) ? ctx->kf_seg : 0;
   for (i = 0; i < sample_count; i++) {
     double u = (sample_count <= 1) ? 0.0 : (double)i / (double)(sample_count - 1);
@@ -12270,10 +17648,9 @@ sbx_context_sample_tones_voice(SbxContext *ctx,
       eval_t = fmod(eval_t, ctx->kf_duration_sec);
       if (eval_t < 0.0) eval_t += ctx->kf_duration_sec;
     }
-    ctx_eval_keyframed_tone_at(kfs, ctx->kf_styles, ctx->kf_count,
-                               eval_t, &seg_saved, &out_tones[i]);
+    ctx_eval_keyframed_tone_at(ctx, voice_index, eval_t, &seg_saved, &out_tones[i]);
     if (voice_index == 0 &&
-        ctx_apply_live_controls_to_tone(ctx, ts, &out_tones[i]) != SBX_OK)
+        ctx_apply_live_controls_to_tone(ctx, ts, 1, &out_tones[i]) != SBX_OK)
       return SBX_EINVAL;
     if (out_t_sec) out_t_sec[i] = ts;
   }
@@ -12721,8 +18098,8 @@ sbx_context_sample_isochronic_cycle(const SbxContext *ctx,
   return SBX_OK;
 }
 
-int
-sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
+static int
+ctx_render_block(SbxContext *ctx, float *out, size_t frames) {
   int rc;
   size_t i;
   double sr;
@@ -12733,11 +18110,6 @@ sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
   double gain_l[SBX_MAX_SBG_VOICES + SBX_MAX_AUX_TONES];
   double gain_r[SBX_MAX_SBG_VOICES + SBX_MAX_AUX_TONES];
   memset(&first_tone, 0, sizeof(first_tone));
-  if (!ctx || !ctx->eng || !out) return SBX_EINVAL;
-  if (!ctx->loaded) {
-    set_ctx_error(ctx, "no tone/program loaded");
-    return SBX_ENOTREADY;
-  }
 
   if (ctx->source_mode == SBX_CTX_SRC_STATIC && !ctx_has_live_tone_controls(ctx)) {
     size_t tone_count = 0;
@@ -12789,7 +18161,7 @@ sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
   }
 
   if (ctx->source_mode == SBX_CTX_SRC_KEYFRAMES &&
-      (!ctx->kfs || ctx->kf_count == 0)) {
+      (!ctx->kf_store.time_sec || ctx->kf_count == 0)) {
     set_ctx_error(ctx, "no keyframes loaded");
     return SBX_ENOTREADY;
   }
@@ -12820,13 +18192,15 @@ sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
     if (ctx->source_mode == SBX_CTX_SRC_CURVE) {
       rc = ctx_eval_curve_tone(ctx, ctx->t_sec, &tone);
       if (rc != SBX_OK) return rc;
+    } else if (ctx->source_mode == SBX_CTX_SRC_BUILTIN) {
+      ctx_eval_builtin_tone(ctx, ctx->t_sec, &tone);
     } else {
       if (ctx->source_mode == SBX_CTX_SRC_STATIC)
         tone = ctx->static_tone;
       else
         ctx_eval_keyframed_tone(ctx, ctx->t_sec, &tone);
     }
-    if (ctx_apply_live_controls_to_tone(ctx, ctx->t_sec, &tone) != SBX_OK)
+    if (ctx_apply_live_controls_to_tone(ctx, ctx->t_sec, 0, &tone) != SBX_OK)
       return SBX_EINVAL;
     if (ctx->source_mode == SBX_CTX_SRC_STATIC) {
       ctx->eng->tone = tone;
@@ -12837,8 +18211,7 @@ sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
       have_first_tone = 1;
     }
     for (vi = 1; vi < ctx->mv_voice_count; vi++) {
-      ctx_eval_keyframed_tone_at(SBX_MV_KF(ctx, vi), ctx->kf_styles, ctx->kf_count,
-                                 ctx->t_sec, &ctx->kf_seg, &tonev[tone_count]);
+      ctx_eval_keyframed_tone_at(ctx, vi, ctx->t_sec, &ctx->kf_seg, &tonev[tone_count]);
       tone_count++;
     }
     for (vi = 0; vi < ctx->aux_count; vi++) {
@@ -12898,6 +18271,55 @@ sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
   return SBX_OK;
 }
 
+int
+sbx_context_render_f32(SbxContext *ctx, float *out, size_t frames) {
+  int rc;
+  size_t done = 0;
+  size_t n;
+  if (!ctx || !ctx->eng || !out) return SBX_EINVAL;
+  if (!ctx->loaded) {
+    set_ctx_error(ctx, "no tone/program loaded");
+    return SBX_ENOTREADY;
+  }
+  /* Pre-event states only cover the block an event landed in. */
+  if (ctx->ev_prev_held)
+    ctx_drop_event_prev_states(ctx);
+  ctx->ev_block_t0 = ctx->t_sec;
+  ctx->ev_block_frame0 = ctx->frame_pos;
+  if (ctx->live_q_head != SBX_LOAD_ACQUIRE(&ctx->live_q_tail))
+    ctx_drain_live_control_queue(ctx);
+  if (ctx->sbg_stream) {
+    rc = ctx_sbg_stream_take(ctx, ctx->t_sec + (double)frames / ctx->eng->cfg.sample_rate);
+    if (rc != SBX_OK) return rc;
+  }
+
+  /* Split the block at each due event so it lands on its exact frame. */
+  while (ctx->ev_next < ctx->ev_count) {
+    uint64_t at = ctx->ev[ctx->ev_next].frame;
+    if (at > ctx->frame_pos) {
+      if (at - ctx->frame_pos >= (uint64_t)(frames - done))
+        break;
+      n = (size_t)(at - ctx->frame_pos);
+      rc = ctx_render_block(ctx, out + done * 2, n);
+      if (rc != SBX_OK) return rc;
+      ctx->frame_pos += n;
+      done += n;
+    }
+    /* A rejected event leaves its reason in last_error and is skipped. */
+    ctx_apply_scheduled_event(ctx, &ctx->ev[ctx->ev_next].ev);
+    ctx->ev_next++;
+  }
+  if (ctx->ev_next == ctx->ev_count)
+    ctx->ev_count = ctx->ev_next = 0;
+
+  n = frames - done;
+  rc = ctx_render_block(ctx, out + done * 2, n);
+  if (rc != SBX_OK) return rc;
+  ctx->frame_pos += n;
+  if (ctx->sbg_stream) ctx_sbg_stream_note_play(ctx);
+  return SBX_OK;
+}
+
 double
 sbx_context_time_sec(const SbxContext *ctx) {
   if (!ctx) return 0.0;
@@ -17,7 +17,7 @@
 extern "C" {
 #endif
 
-#define SBX_API_VERSION 47  /* public API contract revision */
+#define SBX_API_VERSION 64  /* public API contract revision */
 #define SBX_MAX_AUX_TONES 16 /* max auxiliary overlay tones */
 #define SBX_MAX_AMP_ADJUST_POINTS 16 /* max -c frequency/gain breakpoints */
 #define SBX_PLOT_MAX_TICKS 64
@@ -30,7 +30,8 @@ enum {
   SBX_OK = 0,
   SBX_EINVAL = 1,
   SBX_ENOMEM = 2,
-  SBX_ENOTREADY = 3
+  SBX_ENOTREADY = 3,
+  SBX_EBUSY = 4  /* bounded queue is full; retry later */
 };
 
 typedef enum {
@@ -84,7 +85,8 @@ typedef enum {
   SBX_SOURCE_NONE = 0,
   SBX_SOURCE_STATIC = 1,
   SBX_SOURCE_KEYFRAMES = 2,
-  SBX_SOURCE_CURVE = 3
+  SBX_SOURCE_CURVE = 3,
+  SBX_SOURCE_BUILTIN = 4
 } SbxSourceMode;
 
 typedef enum {
@@ -198,8 +200,14 @@ typedef struct {
 typedef struct SbxEngine SbxEngine;
 typedef struct SbxContext SbxContext;
 typedef struct SbxCurveProgram SbxCurveProgram;
+typedef struct SbxCurveEvalState SbxCurveEvalState;
+typedef struct SbxCurveCache SbxCurveCache;
+typedef struct SbxCurveCacheEntry SbxCurveCacheEntry;
+typedef struct SbxCurveSweep SbxCurveSweep;
 typedef struct SbxAudioWriter SbxAudioWriter;
 typedef struct SbxMixInput SbxMixInput;
+typedef struct SbxValidateBatch SbxValidateBatch;
+typedef struct SbxValidateSession SbxValidateSession;
 
 typedef enum {
   SBX_DIAG_ERROR = 1,
@@ -216,6 +224,26 @@ typedef struct {
   char message[SBX_DIAG_MESSAGE_MAX];
 } SbxDiagnostic;
 
+/* One file of a validation batch (sbx_validate_batch_create). */
+typedef struct {
+  int status;                 /* SBX_OK, an SBX_E* code, or -1 if not run yet */
+  size_t byte_count;
+  double elapsed_sec;         /* time spent validating this file */
+  size_t error_count;
+  size_t warning_count;
+  const SbxDiagnostic *diags; /* owned by the batch */
+  size_t diag_count;
+} SbxValidateBatchResult;
+
+typedef struct {
+  size_t file_count;   /* files validated so far */
+  size_t failed_count; /* files with an error diagnostic or a non-OK status */
+  size_t diag_count;
+  size_t byte_count;
+  double busy_sec;     /* per-file times summed over all workers */
+  double wall_sec;     /* first file started to last file finished */
+} SbxValidateBatchStats;
+
 typedef struct {
   double carrier_start_hz;
   double carrier_end_hz;
@@ -249,6 +277,55 @@ typedef struct {
   size_t mixamp_piece_count;
 } SbxCurveInfo;
 
+/*
+ * Size of a prepared curve's VM program (sbx_curve_get_vm_stats).
+ * tree_op_count is the number of operator nodes in the parsed expressions,
+ * what an unfolded evaluation of every target and piece would execute;
+ * vm_op_count is the arithmetic and call instructions left after constant
+ * folding and subexpression sharing, prelude included.
+ */
+typedef struct {
+  size_t tree_op_count;
+  size_t vm_op_count;
+  size_t const_count;
+  size_t shared_count;
+} SbxCurveVmStats;
+
+/*
+ * Optional piecewise-cubic bake of a prepared curve (sbx_curve_bake).
+ * tolerance is the allowed absolute error in each target's own units
+ * (Hz for beat/carrier, percent for amp/mixamp). t1_sec <= t0_sec bakes
+ * up to the end of the prepared program (T + U minutes, at least the
+ * beat/carrier spans).
+ */
+typedef struct {
+  double t0_sec;
+  double t1_sec;
+  double tolerance;
+  double min_segment_sec;
+  double max_segment_sec;
+} SbxCurveBakeConfig;
+
+typedef struct {
+  size_t segment_count;          /* cubic segments over all targets */
+  size_t fallback_segment_count; /* segments left on exact evaluation */
+  double max_error;              /* largest deviation seen at check points (not a bound) */
+} SbxCurveBakeInfo;
+
+/*
+ * Options for the `solve` block of a curve (sbx_curve_set_solve_config).
+ * Each start runs damped Newton with exact Jacobians, falling back to
+ * Levenberg-Marquardt steps where Newton stalls. multistart > 0 retries a
+ * failed solve from that many deterministic perturbations of the initial
+ * guesses, each unknown moved by up to multistart_spread * (|x0| + 1).
+ */
+typedef struct {
+  int max_iterations;        /* per start */
+  double tolerance;          /* max |lhs - rhs| accepted as solved */
+  int multistart;            /* extra starts after a failure (0 = off) */
+  double multistart_spread;
+} SbxCurveSolveConfig;
+
 typedef struct {
   SbxToneMode mode;
   int waveform;
@@ -316,6 +393,15 @@ typedef struct {
   int slide;
   int mute_program_tone;
   double fade_sec;
+  /*
+   * Slide mode only: > 0 places keyframes adaptively instead of every
+   * step_len_sec, splitting spans until linear interpolation stays within
+   * this error (Hz for beat/carrier, percent for amp/mixamp) at probe
+   * points. No two keyframes are further apart than adaptive_max_gap_sec
+   * (0 = no limit).
+   */
+  double adaptive_tolerance;
+  double adaptive_max_gap_sec;
 } SbxCurveTimelineConfig;
 
 typedef struct {
@@ -323,8 +409,62 @@ typedef struct {
   size_t program_frame_count;
   SbxMixAmpKeyframe *mix_frames;
   size_t mix_frame_count;
+  double max_error; /* largest probe error in adaptive mode, else 0 */
 } SbxCurveTimeline;
 
+/*
+ * Prepared-curve cache limits (sbx_curve_cache_create). max_bytes caps the
+ * approximate memory of cached programs and timelines; max_entries = 0
+ * means no count limit.
+ */
+typedef struct {
+  size_t max_bytes;
+  size_t max_entries;
+} SbxCurveCacheConfig;
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  size_t entry_count;
+  size_t bytes;
+} SbxCurveCacheStats;
+
+/*
+ * One axis of a parameter sweep (sbx_curve_sweep_create). name is a
+ * declared .sbgf parameter, or D, H or U to sweep the drop, hold or wake
+ * time in minutes (D and H also set T = D + H and the carrier span).
+ */
+typedef struct {
+  const char *name;
+  const double *values;
+  size_t value_count;
+} SbxCurveSweepAxis;
+
+/*
+ * Base eval config and beat sampling for every sweep point. t1_sec <=
+ * t0_sec samples each point over its own program length, 0 to T + U
+ * minutes.
+ */
+typedef struct {
+  SbxCurveEvalConfig eval_config;
+  double t0_sec;
+  double t1_sec;
+  size_t sample_count;
+} SbxCurveSweepConfig;
+
+typedef struct {
+  int status;          /* SBX_OK, an SBX_E* code, or -1 if not run yet */
+  double duration_sec; /* (T + U) * 60 for this point */
+  double t0_sec;       /* sampled range */
+  double t1_sec;
+} SbxCurveSweepPoint;
+
+typedef enum {
+  SBX_CURVE_SWEEP_CSV = 0,
+  SBX_CURVE_SWEEP_BINARY = 1
+} SbxCurveSweepFormat;
+
 typedef struct {
   unsigned int rng_state; /* caller-owned RNG state for TPDF dithering */
 } SbxPcm16DitherState;
@@ -510,6 +650,21 @@ typedef struct {
   double end_time_sec;     /* ramp end time on the context timeline */
 } SbxLiveControlState;
 
+typedef enum {
+  SBX_EVENT_SET_CONTROL = 1,      /* kind + value: immediate live-control override */
+  SBX_EVENT_RAMP_CONTROL = 2,     /* kind + value + duration_sec: live-control ramp */
+  SBX_EVENT_CLEAR_CONTROL = 3,    /* kind: disable one live-control override */
+  SBX_EVENT_MIX_EFFECT_ENABLE = 4 /* index + value: 0 bypasses a runtime mix effect, nonzero restores it */
+} SbxScheduledEventType;
+
+typedef struct {
+  int type;            /* SBX_EVENT_* */
+  int kind;            /* SBX_LIVE_CONTROL_* for control events */
+  size_t index;        /* runtime mix-effect index for SBX_EVENT_MIX_EFFECT_ENABLE */
+  double value;        /* control value/target, or enable flag */
+  double duration_sec; /* ramp length for SBX_EVENT_RAMP_CONTROL */
+} SbxScheduledEvent;
+
 typedef void (*SbxTelemetryCallback)(const SbxRuntimeTelemetry *telem, void *user);
 
 typedef struct {
@@ -651,6 +806,10 @@ void sbx_default_builtin_sigmoid_config(SbxBuiltinSigmoidConfig *cfg);
 void sbx_default_builtin_slide_config(SbxBuiltinSlideConfig *cfg);
 void sbx_default_curve_file_program_config(SbxCurveFileProgramConfig *cfg);
 void sbx_default_curve_timeline_config(SbxCurveTimelineConfig *cfg);
+void sbx_default_curve_bake_config(SbxCurveBakeConfig *cfg);
+void sbx_default_curve_solve_config(SbxCurveSolveConfig *cfg);
+void sbx_default_curve_cache_config(SbxCurveCacheConfig *cfg);
+void sbx_default_curve_sweep_config(SbxCurveSweepConfig *cfg);
 void sbx_default_runtime_context_config(SbxRuntimeContextConfig *cfg);
 
 /* Built-in program helpers: default program amp is intentionally tiny. */
@@ -845,6 +1004,89 @@ int sbx_validate_sbgf_text(const char *text,
                            size_t *out_count);
 void sbx_free_diagnostics(SbxDiagnostic *diags);
 
+/*
+ * Single-pass validate-and-load for `.sbg` text: the preamble is applied,
+ * the timing text parsed and loaded, and -A checked exactly once, as
+ * sbx_validate_sbg_text does, but the context is kept. On success the
+ * diagnostics array is empty and *out_ctx (if requested) owns the loaded
+ * program, ready to render or to pass to sbx_context_save_compiled().
+ * On failure *out_ctx is NULL and the diagnostics hold every error a
+ * validation session would report, led by the one that stopped the load.
+ * out_preamble (optional) receives the parsed option preamble, defaults
+ * if it did not parse; free it with sbx_free_safe_seqfile_preamble().
+ * As with validation, the return code reports only API/allocation errors.
+ */
+typedef struct {
+  SbxEngineConfig engine;   /* context configuration (default engine config) */
+  int rate_from_preamble;   /* 1 => a -r option overrides engine.sample_rate (default 1) */
+  int loop;                 /* passed to sbx_context_load_sbg_timing_text (default 0) */
+} SbxSbgLoadConfig;
+
+void sbx_default_sbg_load_config(SbxSbgLoadConfig *cfg);
+int sbx_validate_and_load_sbg_text(const char *text,
+                                   const SbxSbgLoadConfig *cfg,
+                                   SbxContext **out_ctx,
+                                   SbxSafeSeqfilePreamble *out_preamble,
+                                   SbxDiagnostic **out_diags,
+                                   size_t *out_count);
+
+/*
+ * Batch validation of `.sbg` / `.sbgf` files (`.sbgf` by extension). The
+ * batch is a shared work queue: sbx_validate_batch_work may be called from
+ * any number of threads at once, each call claiming files until none are
+ * left. A file that cannot be read gets a `file-read` error diagnostic.
+ * Read results after every worker returned. The JSON-lines writer emits
+ * one object per file in input order (path, status, bytes, ms and the
+ * diagnostics with their spans), then one `summary` object with the
+ * throughput figures.
+ */
+SbxValidateBatch *sbx_validate_batch_create(const char *const *paths,
+                                            size_t path_count,
+                                            char *errbuf,
+                                            size_t errbuf_sz);
+void sbx_validate_batch_destroy(SbxValidateBatch *batch);
+size_t sbx_validate_batch_count(const SbxValidateBatch *batch);
+int sbx_validate_batch_work(SbxValidateBatch *batch);
+int sbx_validate_batch_get_result(const SbxValidateBatch *batch,
+                                  size_t index,
+                                  const char **out_path,
+                                  SbxValidateBatchResult *out_result);
+void sbx_validate_batch_get_stats(const SbxValidateBatch *batch,
+                                  SbxValidateBatchStats *out_stats);
+int sbx_validate_batch_write_jsonl(const SbxValidateBatch *batch, FILE *fp);
+
+/*
+ * Incremental `.sbg` validation for editors. The session keeps the document
+ * as lines, caches each line's parse and tracks which lines define and use
+ * each named tone-set, block and waveNN/customNN/noiseNN/spinNN table.
+ * sbx_validate_session_edit replaces `removed_lines` lines starting at
+ * 0-based `first_line` with `new_text` (split on '\n'; NULL inserts
+ * nothing, "" one empty line) and re-parses only the edited lines, the
+ * lines whose meaning depends on a definition that changed, and error
+ * lines whose number moved. Whole documents are split the same way, so
+ * text ending in '\n' has a final empty line.
+ *
+ * The diagnostics array is owned by the session and stays valid until the
+ * next edit. Where sbx_validate_sbg_text stops at the first error, the
+ * session reports one error per failing line (plus preamble, unterminated
+ * block, empty-program and -A errors); its first diagnostic is the one
+ * sbx_validate_sbg_text returns for the same text.
+ */
+SbxValidateSession *sbx_validate_session_create(const char *text,
+                                                char *errbuf,
+                                                size_t errbuf_sz);
+void sbx_validate_session_destroy(SbxValidateSession *session);
+int sbx_validate_session_edit(SbxValidateSession *session,
+                              size_t first_line,
+                              size_t removed_lines,
+                              const char *new_text);
+size_t sbx_validate_session_line_count(const SbxValidateSession *session);
+int sbx_validate_session_diagnostics(const SbxValidateSession *session,
+                                     const SbxDiagnostic **out_diags,
+                                     size_t *out_count);
+/* Lines parsed by the last create or edit call. */
+size_t sbx_validate_session_revalidated_lines(const SbxValidateSession *session);
+
 /*
  * Recognize/execute an option-only historical `.sbg` wrapper.
  * Success requires:
@@ -1010,12 +1252,60 @@ int sbx_curve_load_file(SbxCurveProgram *curve, const char *path);
 /* Override/add one parameter value before preparation. */
 int sbx_curve_set_param(SbxCurveProgram *curve, const char *name, double value);
 
-/* Compile/prepare loaded curve expressions for evaluation. */
+/*
+ * Set solver options used by later prepares (cfg NULL restores defaults).
+ * The setting survives sbx_curve_reset and reloads. A changed setting on a
+ * prepared curve needs a new sbx_curve_prepare, which re-runs the solve.
+ */
+int sbx_curve_set_solve_config(SbxCurveProgram *curve, const SbxCurveSolveConfig *cfg);
+
+/*
+ * Compile/prepare loaded curve expressions for evaluation. After
+ * sbx_curve_set_param on an existing parameter with the same cfg, only the
+ * solve and compiled program parts that read changed parameters are redone.
+ */
 int sbx_curve_prepare(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg);
 
 /* Evaluate prepared curve at timeline position t_sec. */
 int sbx_curve_eval(SbxCurveProgram *curve, double t_sec, SbxCurveEvalPoint *out_point);
 
+/*
+ * Bake a prepared curve into piecewise cubic segments per target. Segment
+ * lengths are chosen adaptively until every check point is within
+ * cfg->tolerance (or min_segment_sec is reached, e.g. at a jump). The
+ * bound is empirical: each segment is checked at eight interior points,
+ * so a feature narrower than the spacing between them can exceed the
+ * tolerance unseen. It is not an analytic error bound. Inside
+ * the baked range sbx_curve_eval then costs a segment lookup plus a Horner
+ * step; outside it, and on segments that could not be fitted, evaluation
+ * stays exact. A full prepare, or re-preparing after a parameter change
+ * that reaches a target, discards the bake.
+ * out_info is optional.
+ */
+int sbx_curve_bake(SbxCurveProgram *curve,
+                   const SbxCurveBakeConfig *cfg,
+                   SbxCurveBakeInfo *out_info);
+
+/* Drop any baked segments and return to exact evaluation. */
+void sbx_curve_clear_bake(SbxCurveProgram *curve);
+
+/*
+ * Reentrant evaluation. An eval state holds its own time, register file and
+ * bake cursors, so any number of threads may call sbx_curve_eval_batch on
+ * the same prepared program at once, each with its own state. The program
+ * must not be prepared, baked or have parameters changed meanwhile.
+ * Results are identical to sbx_curve_eval. Errors are reported through
+ * sbx_curve_eval_state_last_error, never through the program.
+ */
+SbxCurveEvalState *sbx_curve_eval_state_create(void);
+void sbx_curve_eval_state_destroy(SbxCurveEvalState *state);
+const char *sbx_curve_eval_state_last_error(const SbxCurveEvalState *state);
+int sbx_curve_eval_batch(const SbxCurveProgram *curve,
+                         SbxCurveEvalState *state,
+                         const double *t_sec,
+                         size_t count,
+                         SbxCurveEvalPoint *out_points);
+
 /*
  * Sample effective beat/pulse frequency from a prepared curve program over
  * a caller-specified time range. The curve must already be prepared.
@@ -1064,8 +1354,74 @@ int sbx_build_curve_timeline(SbxCurveProgram *curve,
                              SbxCurveTimeline *out_timeline);
 void sbx_free_curve_timeline(SbxCurveTimeline *timeline);
 
+/*
+ * Thread-safe LRU cache of prepared curves and their timelines, keyed by
+ * the source text and name, the parameter overrides (in order), the eval
+ * config and the timeline config. A hit skips parsing, solving and the
+ * timeline build. timeline_config may be NULL to cache the program only.
+ *
+ * Acquired entries are shared and read-only: evaluate them with
+ * sbx_curve_eval_batch and your own SbxCurveEvalState, never with
+ * sbx_curve_eval, sbx_curve_set_param or sbx_curve_prepare. An entry stays
+ * valid until released, even if the cache evicts it meanwhile. Every entry
+ * must be released before the cache is destroyed. errbuf receives the load
+ * or prepare error when provided; failures are not cached.
+ */
+SbxCurveCache *sbx_curve_cache_create(const SbxCurveCacheConfig *cfg);
+void sbx_curve_cache_destroy(SbxCurveCache *cache);
+int sbx_curve_cache_acquire(SbxCurveCache *cache,
+                            const char *text,
+                            const char *source_name,
+                            const SbxCurveParamOverride *overrides,
+                            size_t override_count,
+                            const SbxCurveEvalConfig *eval_config,
+                            const SbxCurveTimelineConfig *timeline_config,
+                            SbxCurveCacheEntry **out_entry,
+                            char *errbuf,
+                            size_t errbuf_sz);
+void sbx_curve_cache_release(SbxCurveCache *cache, SbxCurveCacheEntry *entry);
+const SbxCurveProgram *sbx_curve_cache_entry_curve(const SbxCurveCacheEntry *entry);
+/* NULL when the entry was acquired without a timeline config. */
+const SbxCurveTimeline *sbx_curve_cache_entry_timeline(const SbxCurveCacheEntry *entry);
+/* Drop every unreferenced entry; referenced ones go on release. */
+void sbx_curve_cache_clear(SbxCurveCache *cache);
+void sbx_curve_cache_get_stats(SbxCurveCache *cache, SbxCurveCacheStats *out_stats);
+
+/*
+ * Parameter sweep over the full grid of the given axes (last axis varies
+ * fastest). create copies the loaded form of curve, which need not be
+ * prepared and may be destroyed afterwards; its current parameter values
+ * are the base values and the solve starting guesses. sbx_curve_sweep_work
+ * may be called from any number of threads at once: each call clones the
+ * source once, then claims points until none are left, re-preparing
+ * incrementally where only parameters changed and sampling the beat.
+ * Failures of individual points are recorded per point; work itself only
+ * fails on allocation errors. Read results after every worker returned.
+ */
+SbxCurveSweep *sbx_curve_sweep_create(const SbxCurveProgram *curve,
+                                      const SbxCurveSweepAxis *axes,
+                                      size_t axis_count,
+                                      const SbxCurveSweepConfig *cfg,
+                                      char *errbuf,
+                                      size_t errbuf_sz);
+void sbx_curve_sweep_destroy(SbxCurveSweep *sweep);
+size_t sbx_curve_sweep_point_count(const SbxCurveSweep *sweep);
+int sbx_curve_sweep_work(SbxCurveSweep *sweep);
+/* out_axis_values holds axis_count values; out_beat_hz sample_count. */
+int sbx_curve_sweep_get_point(const SbxCurveSweep *sweep,
+                              size_t index,
+                              double *out_axis_values,
+                              SbxCurveSweepPoint *out_point,
+                              const double **out_beat_hz);
+/* Error text of the lowest-numbered failed point, "" if none failed. */
+const char *sbx_curve_sweep_first_error(const SbxCurveSweep *sweep);
+/* Write the result table as CSV or the binary layout in the API docs. */
+int sbx_curve_sweep_write(const SbxCurveSweep *sweep, FILE *fp, int format);
+
 /* Curve introspection. */
 int sbx_curve_get_info(const SbxCurveProgram *curve, SbxCurveInfo *out_info);
+/* VM program size of a prepared curve; SBX_EINVAL if it runs on te_eval. */
+int sbx_curve_get_vm_stats(const SbxCurveProgram *curve, SbxCurveVmStats *out_stats);
 size_t sbx_curve_param_count(const SbxCurveProgram *curve);
 int sbx_curve_get_param(const SbxCurveProgram *curve,
                         size_t index,
@@ -1106,6 +1462,16 @@ int sbx_context_load_curve_program(SbxContext *ctx,
                                    SbxCurveProgram *curve,
                                    const SbxCurveSourceConfig *cfg);
 
+/*
+ * Load a built-in drop / sigmoid / slide program as a native closed-form
+ * source. Beat, carrier, and amplitude are evaluated directly from the
+ * config (no keyframes, no expression engine), and seeking restores the
+ * oscillator phases from the analytic frequency integrals.
+ */
+int sbx_context_load_builtin_drop(SbxContext *ctx, const SbxBuiltinDropConfig *cfg);
+int sbx_context_load_builtin_sigmoid(SbxContext *ctx, const SbxBuiltinSigmoidConfig *cfg);
+int sbx_context_load_builtin_slide(SbxContext *ctx, const SbxBuiltinSlideConfig *cfg);
+
 /* Load keyframed program (strictly increasing time_sec). */
 int sbx_context_load_keyframes(SbxContext *ctx,
                                const SbxProgramKeyframe *frames,
@@ -1124,6 +1490,67 @@ int sbx_context_load_sbg_timing_text(SbxContext *ctx, const char *text, int loop
 /* Load SBG timing subset file. */
 int sbx_context_load_sbg_timing_file(SbxContext *ctx, const char *path, int loop);
 
+/*
+ * Stream an SBG timing program from a file or pipe. Opening parses the
+ * first window before it returns; after that sbx_context_pump_sbg_stream
+ * reads ahead until window_frames keyframes are queued and the last of
+ * them lies ahead_sec past the play position, drops keyframes playback has
+ * passed and hands the rebuilt window to sbx_context_render_f32, which only
+ * swaps in what the pump has finished and never reads the stream. Run the
+ * pump on a thread other than the audio callback (or before each render
+ * when blocking is acceptable), with ahead_sec at least one render block.
+ * A render that reaches the end of the window before the pump has refilled
+ * it holds the last keyframe and counts an underrun instead of waiting.
+ * Memory stays bounded by the window plus the named definitions.
+ * Definitions (tone-sets, blocks, waveNN/customNN/spinNN/noiseNN) must
+ * precede their first use. While streaming, keyframe queries, duration and
+ * sampling see only the current window, seeking cannot go back before it,
+ * mix/<amp> defaults apply from the window where a mix level first
+ * appears, and looping is not available. A parse or read error stops the
+ * pump, which returns it; the render call that reaches the missing
+ * keyframes then returns it too, with its message in last_error.
+ */
+typedef struct {
+  size_t window_frames;        /* upcoming keyframes kept parsed (default 64, >= 1) */
+  int take_stream_ownership;   /* 1 => the context closes the FILE * (not on open failure) */
+  const char *initial_text;    /* optional text parsed before the stream (copied) */
+} SbxSbgStreamConfig;
+
+void sbx_default_sbg_stream_config(SbxSbgStreamConfig *cfg);
+int sbx_context_open_sbg_timing_stream(SbxContext *ctx, FILE *stream,
+                                       const SbxSbgStreamConfig *cfg);
+/*
+ * Reads ahead of playback; may block on the stream. One pump thread and
+ * one render thread may run at once. Other context calls (load, seek,
+ * destroy) must not overlap the pump. Returns SBX_OK with nothing to do
+ * when no stream is open, input has ended or the window is far enough
+ * ahead.
+ */
+int sbx_context_pump_sbg_stream(SbxContext *ctx, double ahead_sec);
+/* 1 while an open stream may still deliver keyframes. */
+int sbx_context_is_streaming(const SbxContext *ctx);
+/* Renders that ran past the parsed window since the stream opened. */
+unsigned int sbx_context_sbg_stream_underruns(const SbxContext *ctx);
+
+/*
+ * Compiled programs (.sbgc): a versioned, little-endian binary snapshot of
+ * a loaded keyframe program -- resolved keyframes for every voice lane,
+ * transition styles, mix amp and mix-effect keyframes, and the baked custom
+ * wave / spin tables and noise FIRs. Loading one skips text parsing and
+ * table/FIR design. preamble_text (may be NULL) is stored verbatim so a
+ * host can keep the source's option lines; read it back with
+ * sbx_compiled_read_preamble (free() the result). Noise FIRs depend on the
+ * sample rate, so a program using noise profiles only loads into a context
+ * with the rate it was compiled at. Runtime overlays (aux tones, mix
+ * modulation, amp adjust) are not part of the program.
+ */
+#define SBX_COMPILED_FORMAT_VERSION 1
+int sbx_context_save_compiled(SbxContext *ctx, const char *path, const char *preamble_text);
+int sbx_context_load_compiled(SbxContext *ctx, const char *path, int loop);
+int sbx_context_load_compiled_memory(SbxContext *ctx, const void *data, size_t size, int loop);
+int sbx_compiled_read_preamble(const char *path, char **out_text,
+                               char *errbuf, size_t errbuf_sz);
+
 /* ----- Runtime overlays: aux tones ----- */
 
 /* Replace auxiliary overlay tone list (max SBX_MAX_AUX_TONES). */
@@ -1315,6 +1742,31 @@ int sbx_context_set_telemetry_callback(SbxContext *ctx,
 /* Retrieve a runtime telemetry snapshot at the current context time. */
 int sbx_context_get_runtime_telemetry(SbxContext *ctx, SbxRuntimeTelemetry *out);
 
+/*
+ * Decimated telemetry stream:
+ * - sbx_context_render_f32() publishes at most one snapshot per 1/rate_hz of
+ *   rendered audio (at the first block starting on or after each grid point)
+ *   into a lock-free single-producer/single-consumer ring of `capacity`
+ *   entries (rounded up to a power of two, max 65536).
+ * - One monitoring/UI thread polls it with sbx_context_read_telemetry();
+ *   no callback runs on the audio thread.
+ * - Each published snapshot is evaluated in full, as by
+ *   sbx_context_get_runtime_telemetry(); the stream lowers the cost by
+ *   evaluating less often, not by updating a snapshot incrementally.
+ * - When the ring is full new snapshots are dropped and counted.
+ * - rate_hz <= 0 or capacity == 0 disables the stream.
+ * Configure while not rendering or reading.
+ */
+int sbx_context_set_telemetry_stream(SbxContext *ctx, double rate_hz, size_t capacity);
+
+/* Copy up to max_count queued snapshots, oldest first; returns the count. */
+size_t sbx_context_read_telemetry(SbxContext *ctx,
+                                  SbxRuntimeTelemetry *out,
+                                  size_t max_count);
+
+/* Number of stream snapshots dropped because the ring was full. */
+size_t sbx_context_telemetry_dropped(const SbxContext *ctx);
+
 /* ----- Live control overlay ----- */
 
 /* Fill with an inactive/default live-control state. */
@@ -1357,6 +1809,86 @@ int sbx_context_clear_live_control(SbxContext *ctx, int kind);
 /* Disable all live control overrides. */
 void sbx_context_clear_live_controls(SbxContext *ctx);
 
+/*
+ * Lock-free live-control queue.
+ *
+ * The functions above mutate render state directly, so hosts must serialize
+ * them against sbx_context_render_f32(). The post functions below instead
+ * enqueue a command on a wait-free single-producer/single-consumer queue that
+ * sbx_context_render_f32() drains at the start of each block, so a UI thread
+ * can adjust playback while an audio callback renders without either side
+ * taking a lock.
+ *
+ * Rules:
+ * - at most one thread posts and one thread renders at a time;
+ * - a command takes effect at the start of the next rendered block, and ramps
+ *   start from the value evaluated at that block's timeline time;
+ * - post functions only check kind/finiteness; value checks against the loaded
+ *   tone happen when the command is applied, and a rejected command leaves its
+ *   reason in sbx_context_last_error();
+ * - posts return SBX_EBUSY when the queue (64 commands) is full;
+ * - loading a new source or resetting the context discards pending commands.
+ *
+ * duration_sec == 0 posts an immediate set; > 0 posts a ramp.
+ */
+int sbx_context_post_live_control(SbxContext *ctx,
+                                  int kind,
+                                  double target_value,
+                                  double duration_sec);
+
+/* Post a command disabling one live control override. */
+int sbx_context_post_clear_live_control(SbxContext *ctx, int kind);
+
+/* Post a command disabling all live control overrides. */
+int sbx_context_post_clear_live_controls(SbxContext *ctx);
+
+/*
+ * Apply posted live-control commands now, from the render thread, without
+ * rendering (e.g. before querying state while paused).
+ */
+void sbx_context_apply_posted_live_controls(SbxContext *ctx);
+
+/* ----- Sample-accurate scheduled events ----- */
+
+/* Fill with an empty SBX_EVENT_SET_CONTROL event. */
+void sbx_default_scheduled_event(SbxScheduledEvent *event);
+
+/*
+ * Schedule a live-control change or runtime mix-effect toggle to land exactly
+ * on transport frame `frame` (see sbx_context_frame_position()).
+ * sbx_context_render_f32() splits its block at each pending event frame, so
+ * the result does not depend on the host buffer size. Events sharing a frame
+ * apply in scheduling order; events whose frame has already passed apply at
+ * the start of the next rendered block.
+ *
+ * Host mix-stream sampling (sbx_context_mix_stream_sample) of frames rendered
+ * before an event still sees the pre-event mix amp and mix-effect state, so
+ * mix-side changes land on the same frame as tone changes. Sample the block
+ * at its start time plus frame / sample_rate (unwrapped, as for looping
+ * programs); the pre-event state is dropped by the next render call or seek.
+ *
+ * Value range checks run when the event is applied; a rejected event is
+ * skipped and its reason left in sbx_context_last_error(). Loading a new
+ * source discards pending events. Not thread-safe against rendering; use the
+ * post API above from other threads.
+ */
+int sbx_context_schedule_event(SbxContext *ctx,
+                               uint64_t frame,
+                               const SbxScheduledEvent *event);
+
+/* Drop all pending scheduled events. */
+void sbx_context_clear_scheduled_events(SbxContext *ctx);
+
+/* Number of scheduled events not yet applied. */
+size_t sbx_context_scheduled_event_count(const SbxContext *ctx);
+
+/*
+ * Transport frame counter used by scheduled events: frames rendered since the
+ * source was loaded, or the seek target frame after sbx_context_set_time_sec().
+ * Unlike sbx_context_time_sec() it does not wrap for looping programs.
+ */
+uint64_t sbx_context_frame_position(const SbxContext *ctx);
+
 /* ----- Introspection/render ----- */
 
 /* Number of currently loaded keyframes. */
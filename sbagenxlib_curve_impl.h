@@ -14,6 +14,25 @@ sbx_default_curve_eval_config(SbxCurveEvalConfig *cfg) {
   cfg->mix_amp0_pct = 100.0;
 }
 
+void
+sbx_default_curve_bake_config(SbxCurveBakeConfig *cfg) {
+  if (!cfg) return;
+  cfg->t0_sec = 0.0;
+  cfg->t1_sec = 0.0;
+  cfg->tolerance = 1e-4;
+  cfg->min_segment_sec = 1e-3;
+  cfg->max_segment_sec = 60.0;
+}
+
+void
+sbx_default_curve_solve_config(SbxCurveSolveConfig *cfg) {
+  if (!cfg) return;
+  cfg->max_iterations = 40;
+  cfg->tolerance = 1e-9;
+  cfg->multistart = 0;
+  cfg->multistart_spread = 1.0;
+}
+
 void
 sbx_default_curve_source_config(SbxCurveSourceConfig *cfg) {
   if (!cfg) return;
@@ -80,6 +99,20 @@ curve_fail(SbxCurveProgram *curve, const char *fmt, ...) {
   return SBX_EINVAL;
 }
 
+/* Like curve_fail, but reports into the eval state when one is in use. */
+static int
+curve_state_fail(SbxCurveProgram *curve, SbxCurveEvalState *st, const char *fmt, ...) {
+  va_list ap;
+  char *buf = st ? st->last_error : (curve ? curve->last_error : 0);
+  size_t len = st ? sizeof(st->last_error) : sizeof(curve->last_error);
+  if (!buf) return SBX_EINVAL;
+  va_start(ap, fmt);
+  vsnprintf(buf, len, fmt, ap);
+  buf[len - 1] = 0;
+  va_end(ap);
+  return SBX_EINVAL;
+}
+
 static int
 curve_name_reserved(const char *name) {
   static const char *reserved[] = {
@@ -112,28 +145,120 @@ curve_param_index(const SbxCurveProgram *curve, const char *name) {
 }
 
 static void
-curve_expr_target_clear_compiled(SbxCurveExprTarget *target) {
+curve_vm_free(SbxCurveVm *vm) {
   int i;
-  if (!target) return;
-  if (target->expr) te_free(target->expr);
-  target->expr = 0;
-  for (i = 0; i < SBX_CURVE_MAX_PIECES; i++) {
-    if (target->piece_cond[i]) te_free(target->piece_cond[i]);
-    if (target->piece_expr[i]) te_free(target->piece_expr[i]);
-    target->piece_cond[i] = 0;
-    target->piece_expr[i] = 0;
+  if (!vm) return;
+  for (i = 0; i < vm->table_count; i++) {
+    free(vm->tables[i].k);
+    free(vm->tables[i].pc);
+  }
+  free(vm->tables);
+  free(vm->code);
+  free(vm->regs);
+  free(vm);
+}
+
+static void
+curve_bake_free(SbxCurveBake *bake) {
+  int i;
+  if (!bake) return;
+  for (i = 0; i < SBX_CURVE_VM_TARGETS; i++) {
+    free(bake->lane[i].knot);
+    free(bake->lane[i].coef);
+  }
+  free(bake);
+}
+
+#define SBX_CURVE_ARENA_BLOCK 4096
+
+/* Zeroed, pointer-aligned storage owned by the curve until it is reset. */
+static void *
+curve_arena_alloc(SbxCurveProgram *curve, size_t size) {
+  SbxCurveArenaBlock *blk = curve->arena;
+  void *p;
+  size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  if (!blk || blk->cap - blk->used < size) {
+    size_t cap = SBX_CURVE_ARENA_BLOCK - sizeof(*blk);
+    if (cap < size) cap = size;
+    blk = (SbxCurveArenaBlock *)malloc(sizeof(*blk) + cap);
+    if (!blk) return 0;
+    blk->next = curve->arena;
+    blk->used = 0;
+    blk->cap = cap;
+    curve->arena = blk;
   }
+  p = (char *)(blk + 1) + blk->used;
+  blk->used += size;
+  memset(p, 0, size);
+  return p;
+}
+
+static char *
+curve_arena_strdup(SbxCurveProgram *curve, const char *src) {
+  size_t len = strlen(src);
+  char *dst = (char *)curve_arena_alloc(curve, len + 1);
+  if (dst) memcpy(dst, src, len + 1);
+  return dst;
 }
 
 static void
-curve_expr_target_clear_loaded(SbxCurveExprTarget *target) {
+curve_arena_free(SbxCurveProgram *curve) {
+  while (curve->arena) {
+    SbxCurveArenaBlock *next = curve->arena->next;
+    free(curve->arena);
+    curve->arena = next;
+  }
+}
+
+/*
+ * Makes room for piece index count in one target's parallel piece arrays.
+ * Capacity starts at 4 and doubles, so it follows from count and is not
+ * stored; outgrown arrays stay in the arena until reset.
+ */
+static int
+curve_pieces_reserve(SbxCurveProgram *curve,
+                     int count,
+                     char ***cond_src,
+                     char ***expr_src,
+                     te_expr ***cond,
+                     te_expr ***expr) {
+  void **blk;
+  int cap = 4;
+  while (cap < count) cap *= 2;
+  if (*cond_src && count < cap) return SBX_OK;
+  if (*cond_src) cap *= 2;
+  blk = (void **)curve_arena_alloc(curve, 4 * (size_t)cap * sizeof(void *));
+  if (!blk) return SBX_ENOMEM;
+  if (count > 0) {
+    memcpy(blk, *cond_src, (size_t)count * sizeof(void *));
+    memcpy(blk + cap, *expr_src, (size_t)count * sizeof(void *));
+    memcpy(blk + 2 * cap, *cond, (size_t)count * sizeof(void *));
+    memcpy(blk + 3 * cap, *expr, (size_t)count * sizeof(void *));
+  }
+  *cond_src = (char **)blk;
+  *expr_src = (char **)(blk + cap);
+  *cond = (te_expr **)(blk + 2 * cap);
+  *expr = (te_expr **)(blk + 3 * cap);
+  return SBX_OK;
+}
+
+static void
+curve_pieces_free_compiled(te_expr **cond, te_expr **expr, int count) {
+  int i;
+  for (i = 0; i < count; i++) {
+    if (cond[i]) te_free(cond[i]);
+    if (expr[i]) te_free(expr[i]);
+    cond[i] = 0;
+    expr[i] = 0;
+  }
+}
+
+static void
+curve_expr_target_clear_compiled(SbxCurveExprTarget *target) {
   if (!target) return;
-  curve_expr_target_clear_compiled(target);
-  memset(target->expr_src, 0, sizeof(target->expr_src));
-  target->has_expr = 0;
-  target->piece_count = 0;
-  memset(target->piece_cond_src, 0, sizeof(target->piece_cond_src));
-  memset(target->piece_expr_src, 0, sizeof(target->piece_expr_src));
+  if (target->expr) te_free(target->expr);
+  target->expr = 0;
+  curve_pieces_free_compiled(target->piece_cond, target->piece_expr, target->piece_count);
 }
 
 static int
@@ -141,6 +266,17 @@ curve_expr_target_active(const SbxCurveExprTarget *target) {
   return target && (target->has_expr || target->piece_count > 0);
 }
 
+static void
+curve_solve_free_trees(SbxCurveProgram *curve) {
+  int i;
+  for (i = 0; i < SBX_CURVE_MAX_SOLVE_EQ; i++) {
+    if (curve->solve_lhs[i]) te_free(curve->solve_lhs[i]);
+    if (curve->solve_rhs[i]) te_free(curve->solve_rhs[i]);
+    curve->solve_lhs[i] = 0;
+    curve->solve_rhs[i] = 0;
+  }
+}
+
 static void
 sbx_curve_clear_compiled(SbxCurveProgram *curve) {
   int i;
@@ -149,42 +285,102 @@ sbx_curve_clear_compiled(SbxCurveProgram *curve) {
   if (curve->carrier_expr) te_free(curve->carrier_expr);
   if (curve->amp_expr) te_free(curve->amp_expr);
   if (curve->mixamp_expr) te_free(curve->mixamp_expr);
+  curve_vm_free(curve->vm);
+  curve->vm = 0;
+  curve_bake_free(curve->bake);
+  curve->bake = 0;
   curve->beat_expr = 0;
   curve->carrier_expr = 0;
   curve->amp_expr = 0;
   curve->mixamp_expr = 0;
-  for (i = 0; i < SBX_CURVE_MAX_PIECES; i++) {
-    if (curve->beat_piece_cond[i]) te_free(curve->beat_piece_cond[i]);
-    if (curve->beat_piece_expr[i]) te_free(curve->beat_piece_expr[i]);
-    if (curve->carrier_piece_cond[i]) te_free(curve->carrier_piece_cond[i]);
-    if (curve->carrier_piece_expr[i]) te_free(curve->carrier_piece_expr[i]);
-    if (curve->amp_piece_cond[i]) te_free(curve->amp_piece_cond[i]);
-    if (curve->amp_piece_expr[i]) te_free(curve->amp_piece_expr[i]);
-    if (curve->mixamp_piece_cond[i]) te_free(curve->mixamp_piece_cond[i]);
-    if (curve->mixamp_piece_expr[i]) te_free(curve->mixamp_piece_expr[i]);
-    curve->beat_piece_cond[i] = 0;
-    curve->beat_piece_expr[i] = 0;
-    curve->carrier_piece_cond[i] = 0;
-    curve->carrier_piece_expr[i] = 0;
-    curve->amp_piece_cond[i] = 0;
-    curve->amp_piece_expr[i] = 0;
-    curve->mixamp_piece_cond[i] = 0;
-    curve->mixamp_piece_expr[i] = 0;
-  }
+  curve_pieces_free_compiled(curve->beat_piece_cond, curve->beat_piece_expr,
+                             curve->beat_piece_count);
+  curve_pieces_free_compiled(curve->carrier_piece_cond, curve->carrier_piece_expr,
+                             curve->carrier_piece_count);
+  curve_pieces_free_compiled(curve->amp_piece_cond, curve->amp_piece_expr,
+                             curve->amp_piece_count);
+  curve_pieces_free_compiled(curve->mixamp_piece_cond, curve->mixamp_piece_expr,
+                             curve->mixamp_piece_count);
   for (i = 0; i < SBX_CURVE_MIXFX_PARAM_COUNT; i++)
     curve_expr_target_clear_compiled(&curve->mixfx_targets[i]);
+  curve_solve_free_trees(curve);
+  curve->trees_ok = 0;
+  curve->param_dirty = 0;
+  curve->target_deps = 0;
+  curve->solve_deps = 0;
+  curve->solve_dirty = 0;
   curve->prepared = 0;
 }
 
+static size_t
+curve_tree_bytes(const te_expr *n) {
+  size_t bytes;
+  int i;
+  if (!n) return 0;
+  bytes = sizeof(te_expr) + (size_t)ARITY(n->type) * sizeof(void *);
+  for (i = 0; i < ARITY(n->type); i++)
+    bytes += curve_tree_bytes((const te_expr *)n->parameters[i]);
+  return bytes;
+}
+
+static size_t
+curve_pieces_bytes(te_expr **cond, te_expr **expr, int count) {
+  size_t bytes = 0;
+  int i;
+  for (i = 0; i < count; i++)
+    bytes += curve_tree_bytes(cond[i]) + curve_tree_bytes(expr[i]);
+  return bytes;
+}
+
+/* Approximate heap footprint of a curve, for cache accounting. */
+static size_t
+curve_memory_bytes(const SbxCurveProgram *curve) {
+  const SbxCurveArenaBlock *blk;
+  size_t bytes = sizeof(*curve);
+  int i;
+
+  for (blk = curve->arena; blk; blk = blk->next)
+    bytes += sizeof(*blk) + blk->cap;
+  bytes += curve_tree_bytes(curve->beat_expr) + curve_tree_bytes(curve->carrier_expr) +
+           curve_tree_bytes(curve->amp_expr) + curve_tree_bytes(curve->mixamp_expr);
+  bytes += curve_pieces_bytes(curve->beat_piece_cond, curve->beat_piece_expr, curve->beat_piece_count);
+  bytes += curve_pieces_bytes(curve->carrier_piece_cond, curve->carrier_piece_expr, curve->carrier_piece_count);
+  bytes += curve_pieces_bytes(curve->amp_piece_cond, curve->amp_piece_expr, curve->amp_piece_count);
+  bytes += curve_pieces_bytes(curve->mixamp_piece_cond, curve->mixamp_piece_expr, curve->mixamp_piece_count);
+  for (i = 0; i < SBX_CURVE_MIXFX_PARAM_COUNT; i++) {
+    const SbxCurveExprTarget *target = &curve->mixfx_targets[i];
+    bytes += curve_tree_bytes(target->expr);
+    bytes += curve_pieces_bytes(target->piece_cond, target->piece_expr, target->piece_count);
+  }
+  for (i = 0; i < SBX_CURVE_MAX_SOLVE_EQ; i++)
+    bytes += curve_tree_bytes(curve->solve_lhs[i]) + curve_tree_bytes(curve->solve_rhs[i]);
+  if (curve->vm) {
+    const SbxCurveVm *vm = curve->vm;
+    bytes += sizeof(*vm) + (size_t)vm->code_len * sizeof(SbxCurveVmInsn) +
+             (size_t)vm->reg_count * sizeof(double);
+    for (i = 0; i < vm->table_count; i++)
+      bytes += sizeof(vm->tables[i]) + (size_t)vm->tables[i].n * sizeof(double) +
+               (size_t)(2 * vm->tables[i].n + 2) * sizeof(unsigned short);
+  }
+  if (curve->bake) {
+    bytes += sizeof(*curve->bake);
+    for (i = 0; i < SBX_CURVE_VM_TARGETS; i++)
+      if (curve->bake->lane[i].knot)
+        bytes += (size_t)(5 * curve->bake->lane[i].count + 1) * sizeof(double);
+  }
+  return bytes;
+}
+
 static void
 sbx_curve_clear_loaded(SbxCurveProgram *curve) {
   if (!curve) return;
   sbx_curve_clear_compiled(curve);
+  curve_arena_free(curve);
   memset(curve->src_file, 0, sizeof(curve->src_file));
-  memset(curve->beat_expr_src, 0, sizeof(curve->beat_expr_src));
-  memset(curve->carrier_expr_src, 0, sizeof(curve->carrier_expr_src));
-  memset(curve->amp_expr_src, 0, sizeof(curve->amp_expr_src));
-  memset(curve->mixamp_expr_src, 0, sizeof(curve->mixamp_expr_src));
+  curve->beat_expr_src = 0;
+  curve->carrier_expr_src = 0;
+  curve->amp_expr_src = 0;
+  curve->mixamp_expr_src = 0;
   curve->has_carrier_expr = 0;
   curve->has_amp_expr = 0;
   curve->has_mixamp_expr = 0;
@@ -196,25 +392,22 @@ sbx_curve_clear_loaded(SbxCurveProgram *curve) {
   curve->solve_unknown_count = 0;
   curve->solve_eq_count = 0;
   curve->param_count = 0;
-  memset(curve->beat_piece_cond_src, 0, sizeof(curve->beat_piece_cond_src));
-  memset(curve->beat_piece_expr_src, 0, sizeof(curve->beat_piece_expr_src));
-  memset(curve->carrier_piece_cond_src, 0, sizeof(curve->carrier_piece_cond_src));
-  memset(curve->carrier_piece_expr_src, 0, sizeof(curve->carrier_piece_expr_src));
-  memset(curve->amp_piece_cond_src, 0, sizeof(curve->amp_piece_cond_src));
-  memset(curve->amp_piece_expr_src, 0, sizeof(curve->amp_piece_expr_src));
-  memset(curve->mixamp_piece_cond_src, 0, sizeof(curve->mixamp_piece_cond_src));
-  memset(curve->mixamp_piece_expr_src, 0, sizeof(curve->mixamp_piece_expr_src));
+  curve->beat_piece_cond_src = curve->beat_piece_expr_src = 0;
+  curve->carrier_piece_cond_src = curve->carrier_piece_expr_src = 0;
+  curve->amp_piece_cond_src = curve->amp_piece_expr_src = 0;
+  curve->mixamp_piece_cond_src = curve->mixamp_piece_expr_src = 0;
+  curve->beat_piece_cond = curve->beat_piece_expr = 0;
+  curve->carrier_piece_cond = curve->carrier_piece_expr = 0;
+  curve->amp_piece_cond = curve->amp_piece_expr = 0;
+  curve->mixamp_piece_cond = curve->mixamp_piece_expr = 0;
   memset(curve->solve_unknown_names, 0, sizeof(curve->solve_unknown_names));
   memset(curve->solve_unknown_param_idx, 0xff, sizeof(curve->solve_unknown_param_idx));
   memset(curve->solve_eq_lhs_src, 0, sizeof(curve->solve_eq_lhs_src));
   memset(curve->solve_eq_rhs_src, 0, sizeof(curve->solve_eq_rhs_src));
   memset(curve->param_names, 0, sizeof(curve->param_names));
   memset(curve->param_values, 0, sizeof(curve->param_values));
-  {
-    int i;
-    for (i = 0; i < SBX_CURVE_MIXFX_PARAM_COUNT; i++)
-      curve_expr_target_clear_loaded(&curve->mixfx_targets[i]);
-  }
+  /* Target sources and piece arrays went with the arena. */
+  memset(curve->mixfx_targets, 0, sizeof(curve->mixfx_targets));
   memset(&curve->cfg, 0, sizeof(curve->cfg));
   curve->loaded = 0;
 }
@@ -224,6 +417,7 @@ sbx_curve_create(void) {
   SbxCurveProgram *curve = (SbxCurveProgram *)calloc(1, sizeof(*curve));
   if (!curve) return NULL;
   memset(curve->solve_unknown_param_idx, 0xff, sizeof(curve->solve_unknown_param_idx));
+  sbx_default_curve_solve_config(&curve->solve_cfg);
   return curve;
 }
 
@@ -241,6 +435,109 @@ sbx_curve_reset(SbxCurveProgram *curve) {
   sbx_curve_clear_loaded(curve);
 }
 
+static int
+curve_clone_pieces(SbxCurveProgram *dst,
+                   int count,
+                   char **cond_src_in,
+                   char **expr_src_in,
+                   char ***cond_src,
+                   char ***expr_src,
+                   te_expr ***cond,
+                   te_expr ***expr) {
+  int i;
+  *cond_src = *expr_src = 0;
+  *cond = *expr = 0;
+  for (i = 0; i < count; i++) {
+    if (curve_pieces_reserve(dst, i, cond_src, expr_src, cond, expr) != SBX_OK ||
+        !((*cond_src)[i] = curve_arena_strdup(dst, cond_src_in[i])) ||
+        !((*expr_src)[i] = curve_arena_strdup(dst, expr_src_in[i])))
+      return SBX_ENOMEM;
+  }
+  return SBX_OK;
+}
+
+static char *
+curve_clone_str(SbxCurveProgram *dst, const char *src, int *oom) {
+  char *s;
+  if (!src) return 0;
+  s = curve_arena_strdup(dst, src);
+  if (!s) *oom = 1;
+  return s;
+}
+
+/*
+ * Copies the loaded (parsed, uncompiled) form of src into a freshly
+ * created dst: sources, parameters and solve setup, but no trees, VM or
+ * bake, so dst must still be prepared.
+ */
+static int
+curve_clone_loaded(SbxCurveProgram *dst, const SbxCurveProgram *src) {
+  int i, oom = 0;
+
+  memcpy(dst, src, sizeof(*dst));
+  dst->arena = 0;
+  dst->vm = 0;
+  dst->bake = 0;
+  dst->prepared = 0;
+  dst->trees_ok = 0;
+  dst->param_dirty = 0;
+  dst->target_deps = 0;
+  dst->solve_deps = 0;
+  dst->solve_dirty = 0;
+  dst->beat_expr = dst->carrier_expr = dst->amp_expr = dst->mixamp_expr = 0;
+  memset(dst->solve_lhs, 0, sizeof(dst->solve_lhs));
+  memset(dst->solve_rhs, 0, sizeof(dst->solve_rhs));
+  memset(&dst->cfg, 0, sizeof(dst->cfg));
+  dst->last_error[0] = 0;
+
+  dst->beat_expr_src = curve_clone_str(dst, src->beat_expr_src, &oom);
+  dst->carrier_expr_src = curve_clone_str(dst, src->carrier_expr_src, &oom);
+  dst->amp_expr_src = curve_clone_str(dst, src->amp_expr_src, &oom);
+  dst->mixamp_expr_src = curve_clone_str(dst, src->mixamp_expr_src, &oom);
+  for (i = 0; i < src->solve_eq_count; i++) {
+    dst->solve_eq_lhs_src[i] = curve_clone_str(dst, src->solve_eq_lhs_src[i], &oom);
+    dst->solve_eq_rhs_src[i] = curve_clone_str(dst, src->solve_eq_rhs_src[i], &oom);
+  }
+  if (oom ||
+      curve_clone_pieces(dst, src->beat_piece_count,
+                         src->beat_piece_cond_src, src->beat_piece_expr_src,
+                         &dst->beat_piece_cond_src, &dst->beat_piece_expr_src,
+                         &dst->beat_piece_cond, &dst->beat_piece_expr) != SBX_OK ||
+      curve_clone_pieces(dst, src->carrier_piece_count,
+                         src->carrier_piece_cond_src, src->carrier_piece_expr_src,
+                         &dst->carrier_piece_cond_src, &dst->carrier_piece_expr_src,
+                         &dst->carrier_piece_cond, &dst->carrier_piece_expr) != SBX_OK ||
+      curve_clone_pieces(dst, src->amp_piece_count,
+                         src->amp_piece_cond_src, src->amp_piece_expr_src,
+                         &dst->amp_piece_cond_src, &dst->amp_piece_expr_src,
+                         &dst->amp_piece_cond, &dst->amp_piece_expr) != SBX_OK ||
+      curve_clone_pieces(dst, src->mixamp_piece_count,
+                         src->mixamp_piece_cond_src, src->mixamp_piece_expr_src,
+                         &dst->mixamp_piece_cond_src, &dst->mixamp_piece_expr_src,
+                         &dst->mixamp_piece_cond, &dst->mixamp_piece_expr) != SBX_OK)
+    goto oom;
+  for (i = 0; i < SBX_CURVE_MIXFX_PARAM_COUNT; i++) {
+    const SbxCurveExprTarget *st = &src->mixfx_targets[i];
+    SbxCurveExprTarget *dt = &dst->mixfx_targets[i];
+    dt->expr = 0;
+    dt->expr_src = curve_clone_str(dst, st->expr_src, &oom);
+    if (oom ||
+        curve_clone_pieces(dst, st->piece_count, st->piece_cond_src, st->piece_expr_src,
+                           &dt->piece_cond_src, &dt->piece_expr_src,
+                           &dt->piece_cond, &dt->piece_expr) != SBX_OK)
+      goto oom;
+  }
+  return SBX_OK;
+
+oom:
+  /* Nothing compiled yet, so dropping the arena releases everything. */
+  curve_arena_free(dst);
+  memset(dst, 0, sizeof(*dst));
+  memset(dst->solve_unknown_param_idx, 0xff, sizeof(dst->solve_unknown_param_idx));
+  sbx_default_curve_solve_config(&dst->solve_cfg);
+  return SBX_ENOMEM;
+}
+
 const char *
 sbx_curve_last_error(const SbxCurveProgram *curve) {
   return curve ? curve->last_error : "";
@@ -304,6 +601,12 @@ curve_set_param_value(SbxCurveProgram *curve, const char *name, double value, in
     memcpy(curve->param_names[idx], name, nlen + 1);
   }
   curve->param_values[idx] = value;
+  if (curve->trees_ok) {
+    /* Existing name: keep the trees and let prepare redo only what reads it. */
+    curve->param_dirty |= (uint32_t)1 << idx;
+    curve->prepared = 0;
+    return SBX_OK;
+  }
   sbx_curve_clear_compiled(curve);
   return SBX_OK;
 }
@@ -313,6 +616,33 @@ sbx_curve_set_param(SbxCurveProgram *curve, const char *name, double value) {
   return curve_set_param_value(curve, name, value, 1);
 }
 
+int
+sbx_curve_set_solve_config(SbxCurveProgram *curve, const SbxCurveSolveConfig *cfg) {
+  SbxCurveSolveConfig sc;
+  if (!curve) return SBX_EINVAL;
+  if (!cfg) {
+    sbx_default_curve_solve_config(&sc);
+  } else {
+    sc = *cfg;
+    if (sc.max_iterations <= 0 || sc.multistart < 0 ||
+        !isfinite(sc.tolerance) || sc.tolerance <= 0.0 ||
+        !isfinite(sc.multistart_spread) || sc.multistart_spread < 0.0)
+      return curve_fail(curve, "invalid solve config");
+  }
+  if (sc.max_iterations == curve->solve_cfg.max_iterations &&
+      sc.tolerance == curve->solve_cfg.tolerance &&
+      sc.multistart == curve->solve_cfg.multistart &&
+      sc.multistart_spread == curve->solve_cfg.multistart_spread)
+    return SBX_OK;
+  curve->solve_cfg = sc;
+  if (curve->trees_ok) {
+    /* The solution found under the old settings no longer stands. */
+    curve->solve_dirty = 1;
+    curve->prepared = 0;
+  }
+  return SBX_OK;
+}
+
 static double curve_fn_ifelse(double cond, double a, double b) { return cond != 0.0 ? a : b; }
 static double curve_fn_step(double x) { return x >= 0.0 ? 1.0 : 0.0; }
 static double curve_fn_clamp(double x, double lo, double hi) {
@@ -350,6 +680,904 @@ static double curve_fn_seg(double x, double x0, double x1, double y0, double y1)
 static double curve_fn_min2(double a, double b) { return a < b ? a : b; }
 static double curve_fn_max2(double a, double b) { return a > b ? a : b; }
 
+/*
+ * Curve bytecode VM.
+ *
+ * sbx_curve_prepare lowers the tinyexpr trees of every target into one
+ * value-numbered DAG. Subtrees that do not depend on t/m (parameters, config
+ * variables, literals) are folded to constants, and identical subtrees are
+ * merged across all targets and pieces. Merged nodes referenced more than
+ * once are hoisted into a prelude that runs once per time point; each target
+ * then becomes a short register program entered at vm->entry[target].
+ * Piecewise targets become a chain of condition tests with forward jumps.
+ * Curve helpers with closed forms (ramp, smoothstep, seg, ...) run inline as
+ * fused opcodes; any other function is called through its original pointer,
+ * so results stay bitwise identical to te_eval.
+ */
+enum {
+  SBX_CURVE_VM_BEAT = 0,
+  SBX_CURVE_VM_CARRIER,
+  SBX_CURVE_VM_AMP,
+  SBX_CURVE_VM_MIXAMP,
+  SBX_CURVE_VM_MIXFX0
+};
+
+enum {
+  SBX_CVM_HALT = 0,       /* end of prelude */
+  SBX_CVM_RET,
+  SBX_CVM_JMP,
+  SBX_CVM_JF,             /* jump when a[0] is zero; stop if non-finite */
+  SBX_CVM_JNLT,           /* fused piece tests: jump to a[2] unless a[0] op a[1] */
+  SBX_CVM_JNLE,
+  SBX_CVM_JNGT,
+  SBX_CVM_JNGE,
+  SBX_CVM_SWITCH,         /* jump through tables[a[1]] on the value of a[0] */
+  SBX_CVM_ADD,
+  SBX_CVM_SUB,
+  SBX_CVM_MUL,
+  SBX_CVM_DIV,
+  SBX_CVM_NEG,
+  SBX_CVM_LT,
+  SBX_CVM_LE,
+  SBX_CVM_GT,
+  SBX_CVM_GE,
+  SBX_CVM_EQ,
+  SBX_CVM_NE,
+  SBX_CVM_STEP,
+  SBX_CVM_MIN2,
+  SBX_CVM_MAX2,
+  SBX_CVM_SEL,
+  SBX_CVM_CLAMP,
+  SBX_CVM_LERP,
+  SBX_CVM_RAMP,
+  SBX_CVM_SMOOTHSTEP,
+  SBX_CVM_SMOOTHERSTEP,
+  SBX_CVM_BETWEEN,
+  SBX_CVM_SEG,
+  SBX_CVM_EXP,            /* libm calls common in curves, made without CALLn */
+  SBX_CVM_TANH,
+  SBX_CVM_SQRT,
+  SBX_CVM_POW,
+  SBX_CVM_CALL0,
+  SBX_CVM_CALL1,
+  SBX_CVM_CALL2,
+  SBX_CVM_CALL3,
+  SBX_CVM_CALL4,
+  SBX_CVM_CALL5
+};
+
+/* DAG leaf kinds (negative so they never collide with opcodes). */
+enum {
+  SBX_CVM_NODE_CONST = -1,
+  SBX_CVM_NODE_T = -2,
+  SBX_CVM_NODE_M = -3
+};
+
+typedef struct {
+  int op;                 /* SBX_CVM_* opcode or SBX_CVM_NODE_* leaf */
+  const void *fn;
+  int nargs;
+  int args[5];
+  double k;
+  int uses;               /* DAG references reachable from target roots */
+  int reg;                /* fixed register (leaf or shared), else -1 */
+} SbxCurveVmNode;
+
+typedef struct {
+  const SbxCurveProgram *curve;
+  SbxCurveVm *vm;
+  SbxCurveVmNode *nodes;
+  int node_count;
+  int node_cap;
+  int *hash;              /* open addressing, node index + 1 */
+  int hash_cap;
+  int *roots;             /* per target: expr, or cond/expr pairs */
+  int root_count;
+  int root_off[SBX_CURVE_VM_TARGETS];
+  int root_pieces[SBX_CURVE_VM_TARGETS];
+  int code_cap;
+  int table_cap;
+  int tmp_base;
+  int tmp_next;
+  int status;             /* SBX_OK, SBX_ENOMEM, or SBX_EINVAL (unsupported) */
+  uint32_t param_deps;    /* parameters folded into the program */
+  int tree_ops;           /* operator nodes in the source trees */
+} SbxCurveVmBuild;
+
+static int
+curve_vm_grow(void **buf, int *cap, int need, size_t elem_size) {
+  int ncap;
+  void *p;
+  if (need <= *cap) return 1;
+  ncap = *cap ? *cap * 2 : 16;
+  while (ncap < need) ncap *= 2;
+  p = realloc(*buf, (size_t)ncap * elem_size);
+  if (!p) return 0;
+  *buf = p;
+  *cap = ncap;
+  return 1;
+}
+
+static unsigned
+curve_vm_node_hash(const SbxCurveVmNode *n) {
+  unsigned h = 2166136261u;
+  const unsigned char *p;
+  size_t i;
+  int j;
+  h = (h ^ (unsigned)(n->op + 8)) * 16777619u;
+  p = (const unsigned char *)&n->fn;
+  for (i = 0; i < sizeof(n->fn); i++) h = (h ^ p[i]) * 16777619u;
+  for (j = 0; j < n->nargs; j++) h = (h ^ (unsigned)n->args[j]) * 16777619u;
+  p = (const unsigned char *)&n->k;
+  for (i = 0; i < sizeof(n->k); i++) h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+static int
+curve_vm_node_same(const SbxCurveVmNode *a, const SbxCurveVmNode *b) {
+  int j;
+  if (a->op != b->op || a->fn != b->fn || a->nargs != b->nargs) return 0;
+  for (j = 0; j < a->nargs; j++)
+    if (a->args[j] != b->args[j]) return 0;
+  return !memcmp(&a->k, &b->k, sizeof(a->k));
+}
+
+/* Returns the value number of an equivalent node, adding it if new. */
+static int
+curve_vm_intern(SbxCurveVmBuild *b, const SbxCurveVmNode *key) {
+  unsigned slot;
+  int idx;
+  if (b->status != SBX_OK) return -1;
+  if ((b->node_count + 1) * 2 > b->hash_cap) {
+    int ncap = b->hash_cap ? b->hash_cap * 2 : 256;
+    int *nh = (int *)calloc((size_t)ncap, sizeof(int));
+    int i;
+    if (!nh) {
+      b->status = SBX_ENOMEM;
+      return -1;
+    }
+    for (i = 0; i < b->node_count; i++) {
+      slot = curve_vm_node_hash(&b->nodes[i]) & (unsigned)(ncap - 1);
+      while (nh[slot]) slot = (slot + 1) & (unsigned)(ncap - 1);
+      nh[slot] = i + 1;
+    }
+    free(b->hash);
+    b->hash = nh;
+    b->hash_cap = ncap;
+  }
+  slot = curve_vm_node_hash(key) & (unsigned)(b->hash_cap - 1);
+  while (b->hash[slot]) {
+    idx = b->hash[slot] - 1;
+    if (curve_vm_node_same(&b->nodes[idx], key)) return idx;
+    slot = (slot + 1) & (unsigned)(b->hash_cap - 1);
+  }
+  if (b->node_count >= SBX_CURVE_VM_MAX_REGS) {
+    b->status = SBX_EINVAL;
+    return -1;
+  }
+  if (!curve_vm_grow((void **)&b->nodes, &b->node_cap, b->node_count + 1, sizeof(*b->nodes))) {
+    b->status = SBX_ENOMEM;
+    return -1;
+  }
+  idx = b->node_count++;
+  b->nodes[idx] = *key;
+  b->nodes[idx].uses = 0;
+  b->nodes[idx].reg = -1;
+  b->hash[slot] = idx + 1;
+  return idx;
+}
+
+static int
+curve_vm_intern_const(SbxCurveVmBuild *b, double value) {
+  SbxCurveVmNode key;
+  memset(&key, 0, sizeof(key));
+  key.op = SBX_CVM_NODE_CONST;
+  key.k = value;
+  return curve_vm_intern(b, &key);
+}
+
+static int
+curve_vm_opcode(const void *fn, int arity) {
+  switch (arity) {
+    case 1:
+      if (fn == (const void *)negate) return SBX_CVM_NEG;
+      if (fn == (const void *)curve_fn_step) return SBX_CVM_STEP;
+      if (fn == (const void *)exp) return SBX_CVM_EXP;
+      if (fn == (const void *)tanh) return SBX_CVM_TANH;
+      if (fn == (const void *)sqrt) return SBX_CVM_SQRT;
+      return SBX_CVM_CALL1;
+    case 2:
+      if (fn == (const void *)add) return SBX_CVM_ADD;
+      if (fn == (const void *)sub) return SBX_CVM_SUB;
+      if (fn == (const void *)mul) return SBX_CVM_MUL;
+      if (fn == (const void *)divide) return SBX_CVM_DIV;
+      if (fn == (const void *)curve_fn_lt) return SBX_CVM_LT;
+      if (fn == (const void *)curve_fn_le) return SBX_CVM_LE;
+      if (fn == (const void *)curve_fn_gt) return SBX_CVM_GT;
+      if (fn == (const void *)curve_fn_ge) return SBX_CVM_GE;
+      if (fn == (const void *)curve_fn_eq) return SBX_CVM_EQ;
+      if (fn == (const void *)curve_fn_ne) return SBX_CVM_NE;
+      if (fn == (const void *)curve_fn_min2) return SBX_CVM_MIN2;
+      if (fn == (const void *)curve_fn_max2) return SBX_CVM_MAX2;
+      if (fn == (const void *)pow) return SBX_CVM_POW;
+      return SBX_CVM_CALL2;
+    case 3:
+      if (fn == (const void *)curve_fn_ifelse) return SBX_CVM_SEL;
+      if (fn == (const void *)curve_fn_clamp) return SBX_CVM_CLAMP;
+      if (fn == (const void *)curve_fn_lerp) return SBX_CVM_LERP;
+      if (fn == (const void *)curve_fn_ramp) return SBX_CVM_RAMP;
+      if (fn == (const void *)curve_fn_smoothstep) return SBX_CVM_SMOOTHSTEP;
+      if (fn == (const void *)curve_fn_smootherstep) return SBX_CVM_SMOOTHERSTEP;
+      if (fn == (const void *)curve_fn_between ||
+          fn == (const void *)curve_fn_pulse) return SBX_CVM_BETWEEN;
+      return SBX_CVM_CALL3;
+    case 5:
+      if (fn == (const void *)curve_fn_seg) return SBX_CVM_SEG;
+      return SBX_CVM_CALL5;
+    case 4:
+      return SBX_CVM_CALL4;
+    default:
+      return SBX_CVM_CALL0;
+  }
+}
+
+/* Calls a tinyexpr function node on constant arguments, exactly as te_eval. */
+static double
+curve_vm_call(const void *fn, int arity, const double *x) {
+  switch (arity) {
+    case 0: return ((double (*)(void))fn)();
+    case 1: return ((double (*)(double))fn)(x[0]);
+    case 2: return ((double (*)(double, double))fn)(x[0], x[1]);
+    case 3: return ((double (*)(double, double, double))fn)(x[0], x[1], x[2]);
+    case 4: return ((double (*)(double, double, double, double))fn)(x[0], x[1], x[2], x[3]);
+    default: return ((double (*)(double, double, double, double, double))fn)(x[0], x[1], x[2], x[3], x[4]);
+  }
+}
+
+/*
+ * Value-numbers a tinyexpr tree. Variables other than t/m are fixed once
+ * prepared, so they and every pure subtree over them fold to constants.
+ */
+static int
+curve_vm_number(SbxCurveVmBuild *b, const te_expr *n) {
+  SbxCurveVmNode key;
+  double x[5];
+  int i, type, arity, all_const;
+
+  if (b->status != SBX_OK) return -1;
+  if (!n) {
+    b->status = SBX_EINVAL;
+    return -1;
+  }
+  type = TYPE_MASK(n->type);
+  if (type == TE_CONSTANT)
+    return curve_vm_intern_const(b, n->value);
+  memset(&key, 0, sizeof(key));
+  if (type == TE_VARIABLE) {
+    if (n->bound == &b->curve->ev_t) key.op = SBX_CVM_NODE_T;
+    else if (n->bound == &b->curve->ev_m) key.op = SBX_CVM_NODE_M;
+    else {
+      const double *pv = b->curve->param_values;
+      if (n->bound >= pv && n->bound < pv + b->curve->param_count)
+        b->param_deps |= (uint32_t)1 << (n->bound - pv);
+      return curve_vm_intern_const(b, *n->bound);
+    }
+    return curve_vm_intern(b, &key);
+  }
+  arity = ARITY(n->type);
+  if (type < TE_FUNCTION0 || type > TE_FUNCTION7 || arity > 5) {
+    b->status = SBX_EINVAL;
+    return -1;
+  }
+  /* Comma discards its (pure) left operand. */
+  if (arity == 2 && n->function == (const void *)comma)
+    return curve_vm_number(b, (const te_expr *)n->parameters[1]);
+  key.op = curve_vm_opcode(n->function, arity);
+  key.fn = n->function;
+  key.nargs = arity;
+  all_const = IS_PURE(n->type);
+  for (i = 0; i < arity; i++) {
+    key.args[i] = curve_vm_number(b, (const te_expr *)n->parameters[i]);
+    if (key.args[i] < 0) return -1;
+    if (b->nodes[key.args[i]].op != SBX_CVM_NODE_CONST) all_const = 0;
+    else x[i] = b->nodes[key.args[i]].k;
+  }
+  if (all_const)
+    return curve_vm_intern_const(b, curve_vm_call(n->function, arity, x));
+  return curve_vm_intern(b, &key);
+}
+
+static void
+curve_vm_count_uses(SbxCurveVmBuild *b, int v) {
+  SbxCurveVmNode *n = &b->nodes[v];
+  int i;
+  if (n->uses++ > 0) return;
+  for (i = 0; i < n->nargs; i++)
+    curve_vm_count_uses(b, n->args[i]);
+}
+
+static int
+curve_vm_emit(SbxCurveVmBuild *b, int op, int dst, const int *args, int nargs, const void *fn) {
+  SbxCurveVm *vm = b->vm;
+  SbxCurveVmInsn *in;
+  int i;
+  if (b->status != SBX_OK) return -1;
+  if (vm->code_len >= 0xffff) {
+    b->status = SBX_EINVAL;
+    return -1;
+  }
+  if (!curve_vm_grow((void **)&vm->code, &b->code_cap, vm->code_len + 1, sizeof(*vm->code))) {
+    b->status = SBX_ENOMEM;
+    return -1;
+  }
+  in = &vm->code[vm->code_len];
+  memset(in, 0, sizeof(*in));
+  in->op = (unsigned short)op;
+  in->dst = (unsigned short)dst;
+  for (i = 0; i < nargs; i++) in->a[i] = (unsigned short)args[i];
+  in->fn = fn;
+  return vm->code_len++;
+}
+
+static int curve_vm_gen(SbxCurveVmBuild *b, int v);
+
+/* Emits node v (a function node) into register dst. */
+static int
+curve_vm_gen_into(SbxCurveVmBuild *b, int v, int dst) {
+  const SbxCurveVmNode *n = &b->nodes[v];
+  int args[5];
+  int i;
+  for (i = 0; i < n->nargs; i++) {
+    args[i] = curve_vm_gen(b, b->nodes[v].args[i]);
+    if (args[i] < 0) return -1;
+  }
+  n = &b->nodes[v];
+  return curve_vm_emit(b, n->op, dst, args, n->nargs, n->fn);
+}
+
+/* Returns the register holding node v, emitting code into a temporary. */
+static int
+curve_vm_gen(SbxCurveVmBuild *b, int v) {
+  int base, dst;
+  if (b->status != SBX_OK) return -1;
+  if (b->nodes[v].reg >= 0) return b->nodes[v].reg;
+  /* Operands are read before dst is written, so dst may reuse them. */
+  base = b->tmp_next;
+  dst = base;
+  if (curve_vm_gen_into(b, v, dst) < 0) return -1;
+  b->tmp_next = base + 1;
+  if (b->tmp_next > b->vm->reg_count) b->vm->reg_count = b->tmp_next;
+  if (b->vm->reg_count > SBX_CURVE_VM_MAX_REGS) {
+    b->status = SBX_EINVAL;
+    return -1;
+  }
+  return dst;
+}
+
+/*
+ * Emits a piece condition test and returns the index of its jump so the
+ * caller can patch the target. Comparisons (the form piecewise lines
+ * generate) fuse into one compare-and-branch; their 0/1 result is always
+ * finite, so the non-finite check of the generic JF is not needed.
+ */
+static int
+curve_vm_gen_test(SbxCurveVmBuild *b, int v) {
+  const SbxCurveVmNode *n = &b->nodes[v];
+  int args[3];
+  int op = -1;
+  b->tmp_next = b->tmp_base;
+  if (n->reg < 0) {
+    if (n->op == SBX_CVM_LT) op = SBX_CVM_JNLT;
+    else if (n->op == SBX_CVM_LE) op = SBX_CVM_JNLE;
+    else if (n->op == SBX_CVM_GT) op = SBX_CVM_JNGT;
+    else if (n->op == SBX_CVM_GE) op = SBX_CVM_JNGE;
+  }
+  if (op < 0) {
+    args[0] = curve_vm_gen(b, v);
+    if (args[0] < 0) return -1;
+    return curve_vm_emit(b, SBX_CVM_JF, 0, args, 1, 0);
+  }
+  args[0] = curve_vm_gen(b, n->args[0]);
+  if (args[0] < 0) return -1;
+  args[1] = curve_vm_gen(b, b->nodes[v].args[1]);
+  if (args[1] < 0) return -1;
+  args[2] = 0;
+  return curve_vm_emit(b, op, 0, args, 3, 0);
+}
+
+static int
+curve_vm_gen_ret(SbxCurveVmBuild *b, int v) {
+  int r;
+  b->tmp_next = b->tmp_base;
+  r = curve_vm_gen(b, v);
+  if (r < 0) return -1;
+  return curve_vm_emit(b, SBX_CVM_RET, 0, &r, 1, 0);
+}
+
+/*
+ * Piece condition as a comparison of t or m against a constant: sets *var
+ * to the t/m node (-1 for a finite constant condition). Returns 0 when the
+ * condition needs general evaluation.
+ */
+static int
+curve_vm_interval_cond(const SbxCurveVmBuild *b, int v, int *var) {
+  const SbxCurveVmNode *n = &b->nodes[v];
+  const SbxCurveVmNode *x, *y;
+  if (n->op == SBX_CVM_NODE_CONST) {
+    *var = -1;
+    return isfinite(n->k);
+  }
+  if (n->op < SBX_CVM_LT || n->op > SBX_CVM_NE) return 0;
+  x = &b->nodes[n->args[0]];
+  y = &b->nodes[n->args[1]];
+  if ((x->op == SBX_CVM_NODE_T || x->op == SBX_CVM_NODE_M) && y->op == SBX_CVM_NODE_CONST)
+    *var = n->args[0];
+  else if ((y->op == SBX_CVM_NODE_T || y->op == SBX_CVM_NODE_M) && x->op == SBX_CVM_NODE_CONST)
+    *var = n->args[1];
+  else
+    return 0;
+  return 1;
+}
+
+/* Value of an interval condition (see above) when its variable is x. */
+static int
+curve_vm_interval_test(const SbxCurveVmBuild *b, int v, double x) {
+  const SbxCurveVmNode *n = &b->nodes[v];
+  double l, r;
+  if (n->op == SBX_CVM_NODE_CONST) return n->k != 0.0;
+  l = b->nodes[n->args[0]].op == SBX_CVM_NODE_CONST ? b->nodes[n->args[0]].k : x;
+  r = b->nodes[n->args[1]].op == SBX_CVM_NODE_CONST ? b->nodes[n->args[1]].k : x;
+  switch (n->op) {
+    case SBX_CVM_LT: return l < r;
+    case SBX_CVM_LE: return l <= r;
+    case SBX_CVM_GT: return l > r;
+    case SBX_CVM_GE: return l >= r;
+    case SBX_CVM_EQ: return l == r;
+    default: return l != r;
+  }
+}
+
+static int
+curve_vm_cmp_double(const void *pa, const void *pb) {
+  double a = *(const double *)pa, c = *(const double *)pb;
+  return a < c ? -1 : (a > c ? 1 : 0);
+}
+
+/*
+ * Emits SWITCH dispatch for a piecewise target whose conditions all test
+ * the same time variable against constants. The piece selected in each
+ * region between breakpoints is decided here, so evaluation costs a binary
+ * search instead of a scan over the conditions. Returns 0 when the target
+ * does not qualify and the sequential tests must be used.
+ */
+static int
+curve_vm_gen_switch(SbxCurveVmBuild *b, int target) {
+  const int *roots = b->roots + b->root_off[target];
+  int pieces = b->root_pieces[target];
+  SbxCurveVmTable *tb;
+  int piece_pc[SBX_CURVE_MAX_PIECES];
+  int var = -1, cvar, i, j, n, regions, args[2];
+
+  if (pieces < 2) return 0;
+  for (i = 0; i < pieces; i++) {
+    if (!curve_vm_interval_cond(b, roots[2 * i], &cvar)) return 0;
+    if (cvar >= 0) {
+      if (var >= 0 && cvar != var) return 0;
+      var = cvar;
+    }
+  }
+  if (var < 0) return 0;
+  if (!curve_vm_grow((void **)&b->vm->tables, &b->table_cap,
+                     b->vm->table_count + 1, sizeof(*b->vm->tables))) {
+    b->status = SBX_ENOMEM;
+    return -1;
+  }
+  tb = &b->vm->tables[b->vm->table_count];
+  memset(tb, 0, sizeof(*tb));
+  tb->k = (double *)malloc((size_t)pieces * sizeof(double));
+  tb->pc = (unsigned short *)malloc((size_t)(2 * pieces + 2) * sizeof(unsigned short));
+  if (!tb->k || !tb->pc) {
+    free(tb->k);
+    free(tb->pc);
+    b->status = SBX_ENOMEM;
+    return -1;
+  }
+  b->vm->table_count++;
+
+  /* Sorted, distinct breakpoints (NaN constants compare false anyway). */
+  n = 0;
+  for (i = 0; i < pieces; i++) {
+    const SbxCurveVmNode *c = &b->nodes[roots[2 * i]];
+    double k;
+    if (c->op == SBX_CVM_NODE_CONST) continue;
+    k = b->nodes[c->args[0]].op == SBX_CVM_NODE_CONST ? b->nodes[c->args[0]].k
+                                                      : b->nodes[c->args[1]].k;
+    if (!isnan(k)) tb->k[n++] = k;
+  }
+  qsort(tb->k, (size_t)n, sizeof(double), curve_vm_cmp_double);
+  for (i = j = 0; i < n; i++)
+    if (j == 0 || tb->k[i] != tb->k[j - 1]) tb->k[j++] = tb->k[i];
+  tb->n = n = j;
+
+  args[0] = b->nodes[var].reg;
+  args[1] = b->vm->table_count - 1;
+  if (curve_vm_emit(b, SBX_CVM_SWITCH, 0, args, 2, 0) < 0) return -1;
+
+  /* Pick the first true piece at a representative of each region. */
+  for (i = 0; i < pieces; i++) piece_pc[i] = -1;
+  regions = 2 * n + 2;
+  for (i = 0; i < regions && b->status == SBX_OK; i++) {
+    double x;
+    int p;
+    if (i == regions - 1) x = NAN;
+    else if (i == 0) x = -INFINITY;
+    else if (i == regions - 2) x = INFINITY;
+    else if (i & 1) x = tb->k[i / 2];
+    else x = nextafter(tb->k[i / 2 - 1], INFINITY);
+    for (p = 0; p < pieces - 1; p++)
+      if (curve_vm_interval_test(b, roots[2 * p], x)) break;
+    if (piece_pc[p] < 0) {
+      piece_pc[p] = b->vm->code_len;
+      if (curve_vm_gen_ret(b, roots[2 * p + 1]) < 0) return -1;
+    }
+    tb->pc[i] = (unsigned short)piece_pc[p];
+  }
+  return b->status == SBX_OK ? 1 : -1;
+}
+
+static void
+curve_vm_gen_target(SbxCurveVmBuild *b, int target) {
+  const int *roots = b->roots + b->root_off[target];
+  int pieces = b->root_pieces[target];
+  int i, jf, last_start = 0;
+
+  b->vm->entry[target] = b->vm->code_len;
+  if (pieces == 0) {
+    curve_vm_gen_ret(b, roots[0]);
+    return;
+  }
+  if (curve_vm_gen_switch(b, target) != 0) return;
+  for (i = 0; i < pieces && b->status == SBX_OK; i++) {
+    jf = curve_vm_gen_test(b, roots[2 * i]);
+    if (jf < 0) return;
+    if (i == pieces - 1) last_start = b->vm->code_len;
+    if (curve_vm_gen_ret(b, roots[2 * i + 1]) < 0) return;
+    if (b->vm->code[jf].op == SBX_CVM_JF)
+      b->vm->code[jf].a[1] = (unsigned short)b->vm->code_len;
+    else
+      b->vm->code[jf].a[2] = (unsigned short)b->vm->code_len;
+  }
+  /* No piece matched: fall back to the last piece expression. */
+  curve_vm_emit(b, SBX_CVM_JMP, 0, &last_start, 1, 0);
+}
+
+/* Operator nodes a te_eval walk of n visits. */
+static int
+curve_vm_tree_ops(const te_expr *n) {
+  int i, type, count;
+  if (!n) return 0;
+  type = TYPE_MASK(n->type);
+  if (type < TE_FUNCTION0 || type > TE_FUNCTION7) return 0;
+  count = 1;
+  for (i = 0; i < ARITY(n->type); i++)
+    count += curve_vm_tree_ops((const te_expr *)n->parameters[i]);
+  return count;
+}
+
+/* Collects root value numbers for one target into b->roots. */
+static void
+curve_vm_add_target(SbxCurveVmBuild *b,
+                    int target,
+                    int *root_cap,
+                    te_expr *const *piece_cond,
+                    te_expr *const *piece_expr,
+                    int piece_count,
+                    const te_expr *expr) {
+  int i, n, off;
+  b->root_pieces[target] = -1;
+  if (b->status != SBX_OK || (piece_count <= 0 && !expr)) return;
+  off = b->root_count;
+  n = piece_count > 0 ? 2 * piece_count : 1;
+  if (!curve_vm_grow((void **)&b->roots, root_cap, off + n, sizeof(int))) {
+    b->status = SBX_ENOMEM;
+    return;
+  }
+  b->root_off[target] = off;
+  b->root_pieces[target] = piece_count > 0 ? piece_count : 0;
+  if (piece_count > 0) {
+    for (i = 0; i < piece_count; i++) {
+      b->roots[off + 2 * i] = curve_vm_number(b, piece_cond[i]);
+      b->roots[off + 2 * i + 1] = curve_vm_number(b, piece_expr[i]);
+      b->tree_ops += curve_vm_tree_ops(piece_cond[i]) + curve_vm_tree_ops(piece_expr[i]);
+    }
+  } else {
+    b->roots[off] = curve_vm_number(b, expr);
+    b->tree_ops += curve_vm_tree_ops(expr);
+  }
+  b->root_count = off + n;
+}
+
+/*
+ * Point targets that are each absent or a bare constant register never
+ * change with time. Their finished values (defaults and clamps applied, as
+ * curve_eval_point would) are kept here so evaluation skips the frame sync
+ * and the per-target dispatch; only a carrier falling back to the config
+ * ramp still depends on t. A non-finite beat keeps the normal path, which
+ * reports it.
+ */
+static void
+curve_vm_note_point_const(const SbxCurveProgram *curve, SbxCurveVm *vm) {
+  double *pv = vm->point_value;
+  int k;
+
+  vm->point_const = 0;
+  for (k = 0; k < 4; k++) {
+    const SbxCurveVmInsn *ip;
+    pv[k] = NAN;
+    if (vm->entry[k] < 0) continue;
+    ip = vm->code + vm->entry[k];
+    if (ip->op != SBX_CVM_RET || ip->a[0] < 2 || ip->a[0] >= 2 + vm->const_count) return;
+    pv[k] = vm->regs[ip->a[0]];
+  }
+  if (!isfinite(pv[0])) return;
+  if (!isfinite(pv[2])) pv[2] = curve->cfg.beat_amp0_pct;
+  if (!isfinite(pv[3])) pv[3] = curve->cfg.mix_amp0_pct;
+  if (pv[2] < 0.0) pv[2] = 0.0;
+  if (pv[3] < 0.0) pv[3] = 0.0;
+  vm->point_const = 1;
+}
+
+/*
+ * Compiles every prepared target into curve->vm. Returns SBX_ENOMEM only on
+ * allocation failure; trees the VM cannot express leave curve->vm NULL so
+ * evaluation stays on te_eval.
+ */
+static int
+curve_compile_vm(SbxCurveProgram *curve) {
+  SbxCurveVmBuild b;
+  SbxCurveExprTarget *target;
+  int root_cap = 0;
+  int i, v, reg, rc;
+
+  curve->vm = 0;
+  memset(&b, 0, sizeof(b));
+  b.curve = curve;
+  b.status = SBX_OK;
+  b.vm = (SbxCurveVm *)calloc(1, sizeof(*b.vm));
+  if (!b.vm) return SBX_ENOMEM;
+
+  /* t and m take value numbers 0 and 1, which are also their registers. */
+  {
+    SbxCurveVmNode key;
+    memset(&key, 0, sizeof(key));
+    key.op = SBX_CVM_NODE_T;
+    curve_vm_intern(&b, &key);
+    key.op = SBX_CVM_NODE_M;
+    curve_vm_intern(&b, &key);
+  }
+  curve_vm_add_target(&b, SBX_CURVE_VM_BEAT, &root_cap,
+                      curve->beat_piece_cond, curve->beat_piece_expr,
+                      curve->beat_piece_count, curve->beat_expr);
+  curve_vm_add_target(&b, SBX_CURVE_VM_CARRIER, &root_cap,
+                      curve->carrier_piece_cond, curve->carrier_piece_expr,
+                      curve->carrier_piece_count, curve->carrier_expr);
+  curve_vm_add_target(&b, SBX_CURVE_VM_AMP, &root_cap,
+                      curve->amp_piece_cond, curve->amp_piece_expr,
+                      curve->amp_piece_count, curve->amp_expr);
+  curve_vm_add_target(&b, SBX_CURVE_VM_MIXAMP, &root_cap,
+                      curve->mixamp_piece_cond, curve->mixamp_piece_expr,
+                      curve->mixamp_piece_count, curve->mixamp_expr);
+  for (i = 0; i < SBX_CURVE_MIXFX_PARAM_COUNT; i++) {
+    target = &curve->mixfx_targets[i];
+    curve_vm_add_target(&b, SBX_CURVE_VM_MIXFX0 + i, &root_cap,
+                        target->piece_cond, target->piece_expr,
+                        target->piece_count, target->expr);
+  }
+  if (b.status != SBX_OK) goto done;
+
+  /* Count DAG references reachable from the roots. */
+  for (i = 0; i < SBX_CURVE_VM_TARGETS; i++) {
+    int k, n;
+    if (b.root_pieces[i] < 0) continue;
+    n = b.root_pieces[i] > 0 ? 2 * b.root_pieces[i] : 1;
+    for (k = 0; k < n; k++)
+      curve_vm_count_uses(&b, b.roots[b.root_off[i] + k]);
+  }
+
+  /* Registers: t, m, constants, shared subexpressions, then temporaries. */
+  b.nodes[0].reg = 0;
+  b.nodes[1].reg = 1;
+  reg = 2;
+  for (v = 2; v < b.node_count; v++)
+    if (b.nodes[v].uses > 0 && b.nodes[v].op == SBX_CVM_NODE_CONST) b.nodes[v].reg = reg++;
+  b.vm->const_count = reg - 2;
+  for (v = 2; v < b.node_count; v++)
+    if (b.nodes[v].uses > 1 && b.nodes[v].op >= 0) b.nodes[v].reg = reg++;
+  b.vm->shared_count = reg - 2 - b.vm->const_count;
+  b.tmp_base = reg;
+  b.vm->reg_count = reg;
+
+  /* Prelude: shared nodes in value-number (topological) order. */
+  for (v = 2; v < b.node_count && b.status == SBX_OK; v++) {
+    if (b.nodes[v].uses > 1 && b.nodes[v].op >= 0) {
+      b.tmp_next = b.tmp_base;
+      curve_vm_gen_into(&b, v, b.nodes[v].reg);
+    }
+  }
+  curve_vm_emit(&b, SBX_CVM_HALT, 0, 0, 0, 0);
+  for (i = 0; i < SBX_CURVE_VM_TARGETS; i++) {
+    b.vm->entry[i] = -1;
+    if (b.root_pieces[i] >= 0 && b.status == SBX_OK) curve_vm_gen_target(&b, i);
+  }
+  if (b.status != SBX_OK) goto done;
+
+  b.vm->regs = (double *)calloc((size_t)b.vm->reg_count, sizeof(double));
+  if (!b.vm->regs) {
+    b.status = SBX_ENOMEM;
+    goto done;
+  }
+  for (v = 2; v < b.node_count; v++)
+    if (b.nodes[v].op == SBX_CVM_NODE_CONST && b.nodes[v].reg >= 0)
+      b.vm->regs[b.nodes[v].reg] = b.nodes[v].k;
+  curve_vm_note_point_const(curve, b.vm);
+
+done:
+  rc = b.status;
+  free(b.nodes);
+  free(b.hash);
+  free(b.roots);
+  if (rc != SBX_OK) {
+    curve_vm_free(b.vm);
+    /* te_eval reads parameters live; assume every one matters. */
+    curve->target_deps = ~(uint32_t)0;
+    return rc == SBX_ENOMEM ? SBX_ENOMEM : SBX_OK;
+  }
+  b.vm->tree_op_count = b.tree_ops;
+  curve->vm = b.vm;
+  curve->target_deps = b.param_deps;
+  return SBX_OK;
+}
+
+int
+sbx_curve_get_vm_stats(const SbxCurveProgram *curve, SbxCurveVmStats *out_stats) {
+  const SbxCurveVm *vm;
+  int i;
+  if (!curve || !out_stats) return SBX_EINVAL;
+  memset(out_stats, 0, sizeof(*out_stats));
+  vm = curve->vm;
+  if (!curve->prepared || !vm) return SBX_EINVAL;
+  out_stats->tree_op_count = (size_t)vm->tree_op_count;
+  for (i = 0; i < vm->code_len; i++)
+    if (vm->code[i].op >= SBX_CVM_ADD) out_stats->vm_op_count++;
+  out_stats->const_count = (size_t)vm->const_count;
+  out_stats->shared_count = (size_t)vm->shared_count;
+  return SBX_OK;
+}
+
+/*
+ * Runs VM code from pc over register file r (vm->regs or an eval state's
+ * copy). Returns SBX_EINVAL when a piece condition evaluates non-finite,
+ * matching the te_eval path.
+ */
+static int
+curve_vm_exec(const SbxCurveVm *vm, double *r, int pc, double *out_value) {
+  const SbxCurveVmInsn *code = vm->code;
+  const SbxCurveVmInsn *ip = code + pc;
+  double x;
+
+  for (;;) {
+    const unsigned short *a = ip->a;
+    switch (ip->op) {
+      case SBX_CVM_HALT:
+        return SBX_OK;
+      case SBX_CVM_RET:
+        *out_value = r[a[0]];
+        return SBX_OK;
+      case SBX_CVM_JMP:
+        ip = code + a[0];
+        continue;
+      case SBX_CVM_JF:
+        x = r[a[0]];
+        if (!isfinite(x)) return SBX_EINVAL;
+        if (x == 0.0) {
+          ip = code + a[1];
+          continue;
+        }
+        break;
+      case SBX_CVM_JNLT:
+        if (!(r[a[0]] < r[a[1]])) { ip = code + a[2]; continue; }
+        break;
+      case SBX_CVM_JNLE:
+        if (!(r[a[0]] <= r[a[1]])) { ip = code + a[2]; continue; }
+        break;
+      case SBX_CVM_JNGT:
+        if (!(r[a[0]] > r[a[1]])) { ip = code + a[2]; continue; }
+        break;
+      case SBX_CVM_JNGE:
+        if (!(r[a[0]] >= r[a[1]])) { ip = code + a[2]; continue; }
+        break;
+      case SBX_CVM_SWITCH: {
+        const SbxCurveVmTable *tb = &vm->tables[a[1]];
+        int lo = 0, hi = tb->n, mid;
+        x = r[a[0]];
+        if (x != x) {
+          ip = code + tb->pc[2 * tb->n + 1];
+          continue;
+        }
+        /* lo = number of breakpoints <= x */
+        while (lo < hi) {
+          mid = (lo + hi) / 2;
+          if (tb->k[mid] <= x) lo = mid + 1;
+          else hi = mid;
+        }
+        ip = code + tb->pc[(lo > 0 && tb->k[lo - 1] == x) ? 2 * lo - 1 : 2 * lo];
+        continue;
+      }
+      case SBX_CVM_ADD: r[ip->dst] = r[a[0]] + r[a[1]]; break;
+      case SBX_CVM_SUB: r[ip->dst] = r[a[0]] - r[a[1]]; break;
+      case SBX_CVM_MUL: r[ip->dst] = r[a[0]] * r[a[1]]; break;
+      case SBX_CVM_DIV: r[ip->dst] = r[a[0]] / r[a[1]]; break;
+      case SBX_CVM_NEG: r[ip->dst] = -r[a[0]]; break;
+      case SBX_CVM_LT: r[ip->dst] = r[a[0]] < r[a[1]] ? 1.0 : 0.0; break;
+      case SBX_CVM_LE: r[ip->dst] = r[a[0]] <= r[a[1]] ? 1.0 : 0.0; break;
+      case SBX_CVM_GT: r[ip->dst] = r[a[0]] > r[a[1]] ? 1.0 : 0.0; break;
+      case SBX_CVM_GE: r[ip->dst] = r[a[0]] >= r[a[1]] ? 1.0 : 0.0; break;
+      case SBX_CVM_EQ: r[ip->dst] = r[a[0]] == r[a[1]] ? 1.0 : 0.0; break;
+      case SBX_CVM_NE: r[ip->dst] = r[a[0]] != r[a[1]] ? 1.0 : 0.0; break;
+      case SBX_CVM_STEP: r[ip->dst] = r[a[0]] >= 0.0 ? 1.0 : 0.0; break;
+      case SBX_CVM_MIN2: r[ip->dst] = curve_fn_min2(r[a[0]], r[a[1]]); break;
+      case SBX_CVM_MAX2: r[ip->dst] = curve_fn_max2(r[a[0]], r[a[1]]); break;
+      case SBX_CVM_SEL: r[ip->dst] = r[a[0]] != 0.0 ? r[a[1]] : r[a[2]]; break;
+      case SBX_CVM_CLAMP: r[ip->dst] = curve_fn_clamp(r[a[0]], r[a[1]], r[a[2]]); break;
+      case SBX_CVM_LERP: r[ip->dst] = curve_fn_lerp(r[a[0]], r[a[1]], r[a[2]]); break;
+      case SBX_CVM_RAMP: r[ip->dst] = curve_fn_ramp(r[a[0]], r[a[1]], r[a[2]]); break;
+      case SBX_CVM_SMOOTHSTEP: r[ip->dst] = curve_fn_smoothstep(r[a[0]], r[a[1]], r[a[2]]); break;
+      case SBX_CVM_SMOOTHERSTEP: r[ip->dst] = curve_fn_smootherstep(r[a[0]], r[a[1]], r[a[2]]); break;
+      case SBX_CVM_BETWEEN: r[ip->dst] = curve_fn_between(r[a[0]], r[a[1]], r[a[2]]); break;
+      case SBX_CVM_SEG:
+        r[ip->dst] = curve_fn_seg(r[a[0]], r[a[1]], r[a[2]], r[a[3]], r[a[4]]);
+        break;
+      case SBX_CVM_EXP: r[ip->dst] = exp(r[a[0]]); break;
+      case SBX_CVM_TANH: r[ip->dst] = tanh(r[a[0]]); break;
+      case SBX_CVM_SQRT: r[ip->dst] = sqrt(r[a[0]]); break;
+      case SBX_CVM_POW: r[ip->dst] = pow(r[a[0]], r[a[1]]); break;
+      case SBX_CVM_CALL0:
+        r[ip->dst] = ((double (*)(void))ip->fn)();
+        break;
+      case SBX_CVM_CALL1:
+        r[ip->dst] = ((double (*)(double))ip->fn)(r[a[0]]);
+        break;
+      case SBX_CVM_CALL2:
+        r[ip->dst] = ((double (*)(double, double))ip->fn)(r[a[0]], r[a[1]]);
+        break;
+      case SBX_CVM_CALL3:
+        r[ip->dst] = ((double (*)(double, double, double))ip->fn)(r[a[0]], r[a[1]], r[a[2]]);
+        break;
+      case SBX_CVM_CALL4:
+        r[ip->dst] = ((double (*)(double, double, double, double))ip->fn)(
+          r[a[0]], r[a[1]], r[a[2]], r[a[3]]);
+        break;
+      case SBX_CVM_CALL5:
+        r[ip->dst] = ((double (*)(double, double, double, double, double))ip->fn)(
+          r[a[0]], r[a[1]], r[a[2]], r[a[3]], r[a[4]]);
+        break;
+      default:
+        return SBX_EINVAL;
+    }
+    ip++;
+  }
+}
+
+/* Loads t/m and runs the shared prelude once per distinct time point. */
+static void
+curve_vm_sync(const SbxCurveVm *vm, double *regs, int *frame_ok, double t, double m) {
+  if (*frame_ok && regs[0] == t) return;
+  regs[0] = t;
+  regs[1] = m;
+  if (vm->shared_count > 0) curve_vm_exec(vm, regs, 0, 0);
+  *frame_ok = 1;
+}
+
 static int
 curve_parse_param_line(SbxCurveProgram *curve, char *line, int lno, const char *path) {
   char name[SBX_CURVE_NAME_MAX];
@@ -392,7 +1620,7 @@ curve_parse_param_line(SbxCurveProgram *curve, char *line, int lno, const char *
 
 static int
 curve_parse_expr_line(SbxCurveProgram *curve, char *p, int lno, const char *path,
-                      const char *kind, char *dst, size_t dstsz) {
+                      const char *kind, char **dst) {
   char *eq = strchr(p, '=');
   char *expr;
   if (!eq)
@@ -400,18 +1628,23 @@ curve_parse_expr_line(SbxCurveProgram *curve, char *p, int lno, const char *path
   expr = curve_trim(eq + 1);
   if (!*expr)
     return curve_fail(curve, "%s:%d: empty expression for %s", path, lno, kind);
-  if (strlen(expr) >= dstsz)
+  if (strlen(expr) >= SBX_CURVE_EXPR_MAX)
     return curve_fail(curve, "%s:%d: %s expression is too long", path, lno, kind);
-  strcpy(dst, expr);
+  *dst = curve_arena_strdup(curve, expr);
+  if (!*dst)
+    return curve_fail(curve, "%s:%d: out of memory storing %s expression", path, lno, kind);
   return SBX_OK;
 }
 
 static int
 curve_parse_piece_line(SbxCurveProgram *curve, char *s, int lno, const char *path,
                        const char *kind, int kind_len,
-                       char cond_dst[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX],
-                       char expr_dst[SBX_CURVE_MAX_PIECES][SBX_CURVE_EXPR_MAX],
+                       char ***cond_src,
+                       char ***expr_src,
+                       te_expr ***cond_tree,
+                       te_expr ***expr_tree,
                        int *piece_count) {
+  char cond_buf[SBX_CURVE_EXPR_MAX];
   char *p = s + kind_len;
   char *eq;
   char *rhs;
@@ -455,8 +1688,14 @@ curve_parse_piece_line(SbxCurveProgram *curve, char *s, int lno, const char *pat
     curve_fail(curve, "%s:%d: %s piecewise expression is too long", path, lno, kind);
     return -1;
   }
-  snprintf(cond_dst[*piece_count], SBX_CURVE_EXPR_MAX, "%s(m,%s)", cmp_name, rhs);
-  strcpy(expr_dst[*piece_count], expr);
+  snprintf(cond_buf, sizeof(cond_buf), "%s(m,%s)", cmp_name, rhs);
+  if (curve_pieces_reserve(curve, *piece_count, cond_src, expr_src,
+                           cond_tree, expr_tree) != SBX_OK ||
+      !((*cond_src)[*piece_count] = curve_arena_strdup(curve, cond_buf)) ||
+      !((*expr_src)[*piece_count] = curve_arena_strdup(curve, expr))) {
+    curve_fail(curve, "%s:%d: out of memory storing %s piecewise line", path, lno, kind);
+    return -1;
+  }
   (*piece_count)++;
   return 1;
 }
@@ -472,8 +1711,10 @@ curve_parse_named_target_line(SbxCurveProgram *curve,
   int prc;
   if (!curve || !s || !kind || !target) return SBX_EINVAL;
   prc = curve_parse_piece_line(curve, s, lno, path, kind, kind_len,
-                               target->piece_cond_src,
-                               target->piece_expr_src,
+                               &target->piece_cond_src,
+                               &target->piece_expr_src,
+                               &target->piece_cond,
+                               &target->piece_expr,
                                &target->piece_count);
   if (prc < 0) return SBX_EINVAL;
   if (prc > 0) {
@@ -485,8 +1726,7 @@ curve_parse_named_target_line(SbxCurveProgram *curve,
   if (target->piece_count > 0)
     return curve_fail(curve, "%s:%d: cannot mix piecewise %s<... lines with '%s = ...'",
                       path, lno, kind, kind);
-  prc = curve_parse_expr_line(curve, s, lno, path, kind,
-                              target->expr_src, sizeof(target->expr_src));
+  prc = curve_parse_expr_line(curve, s, lno, path, kind, &target->expr_src);
   if (prc != SBX_OK) return prc;
   target->has_expr = 1;
   return SBX_OK;
@@ -571,8 +1811,10 @@ curve_parse_solve_line(SbxCurveProgram *curve, char *line, int lno, const char *
       return curve_fail(curve, "%s:%d: solve equation #%d must have both lhs and rhs expressions", path, lno, neq + 1);
     if (strlen(lhs) >= SBX_CURVE_EXPR_MAX || strlen(rhs) >= SBX_CURVE_EXPR_MAX)
       return curve_fail(curve, "%s:%d: solve equation #%d is too long", path, lno, neq + 1);
-    strcpy(curve->solve_eq_lhs_src[neq], lhs);
-    strcpy(curve->solve_eq_rhs_src[neq], rhs);
+    curve->solve_eq_lhs_src[neq] = curve_arena_strdup(curve, lhs);
+    curve->solve_eq_rhs_src[neq] = curve_arena_strdup(curve, rhs);
+    if (!curve->solve_eq_lhs_src[neq] || !curve->solve_eq_rhs_src[neq])
+      return curve_fail(curve, "%s:%d: out of memory storing solve equation", path, lno);
     neq++;
   }
 
@@ -659,93 +1901,426 @@ curve_set_unknown_vector(SbxCurveProgram *curve, int n, const double *x) {
 }
 
 static int
-curve_eval_solve_residuals(int n, te_expr **lhs, te_expr **rhs, double *resid) {
-  int i;
+curve_eval_solve_residuals(int n, te_expr **lhs, te_expr **rhs, double *resid) {
+  int i;
+  for (i = 0; i < n; i++) {
+    double lv = te_eval(lhs[i]);
+    double rv = te_eval(rhs[i]);
+    if (!isfinite(lv) || !isfinite(rv)) return 0;
+    resid[i] = lv - rv;
+  }
+  return 1;
+}
+
+/* Resolves the solve unknowns and compiles the equations into the curve. */
+static int
+curve_compile_solve(SbxCurveProgram *curve, te_variable *vars, int vcnt) {
+  int n, i;
+  int err_lhs = 0, err_rhs = 0;
+
+  if (!curve->has_solve) return SBX_OK;
+  n = curve->solve_unknown_count;
+  if (n <= 0 || n > SBX_CURVE_MAX_SOLVE_UNK)
+    return curve_fail(curve, "%s: internal solve setup error (unknown count=%d)", curve->src_file, n);
+  if (curve->solve_eq_count != n)
+    return curve_fail(curve, "%s: solve requires equal equation/unknown counts", curve->src_file);
+
+  for (i = 0; i < n; i++) {
+    int idx = curve_param_index(curve, curve->solve_unknown_names[i]);
+    if (idx < 0)
+      return curve_fail(curve, "%s: solve unknown '%s' is not a defined parameter", curve->src_file, curve->solve_unknown_names[i]);
+    curve->solve_unknown_param_idx[i] = idx;
+  }
+
+  for (i = 0; i < n; i++) {
+    err_lhs = 0;
+    curve->solve_lhs[i] = te_compile(curve->solve_eq_lhs_src[i], vars, vcnt, &err_lhs);
+    if (!curve->solve_lhs[i]) {
+      curve_solve_free_trees(curve);
+      return curve_fail(curve, "%s: solve equation #%d lhs failed near column %d", curve->src_file, i + 1, err_lhs);
+    }
+    err_rhs = 0;
+    curve->solve_rhs[i] = te_compile(curve->solve_eq_rhs_src[i], vars, vcnt, &err_rhs);
+    if (!curve->solve_rhs[i]) {
+      curve_solve_free_trees(curve);
+      return curve_fail(curve, "%s: solve equation #%d rhs failed near column %d", curve->src_file, i + 1, err_rhs);
+    }
+  }
+  return SBX_OK;
+}
+
+/* Parameters (bit i = param i) read anywhere in a compiled tree. */
+static uint32_t
+curve_tree_param_deps(const SbxCurveProgram *curve, const te_expr *n) {
+  uint32_t deps = 0;
+  int i;
+  if (!n) return 0;
+  switch (TYPE_MASK(n->type)) {
+    case TE_CONSTANT:
+      return 0;
+    case TE_VARIABLE: {
+      const double *pv = curve->param_values;
+      if (n->bound >= pv && n->bound < pv + curve->param_count)
+        return (uint32_t)1 << (n->bound - pv);
+      return 0;
+    }
+    default:
+      for (i = 0; i < ARITY(n->type); i++)
+        deps |= curve_tree_param_deps(curve, (const te_expr *)n->parameters[i]);
+      return deps;
+  }
+}
+
+/*
+ * Forward-mode differentiation of the compiled solve equations. One walk of
+ * a tree yields its value and its gradient with respect to every solve
+ * unknown, so a full Jacobian costs one pass per equation instead of 2n+1
+ * residual evaluations. Values come from the same function calls te_eval
+ * makes. Known functions use closed-form partials; anything else falls back
+ * to a central difference on that one node.
+ */
+typedef struct {
+  const SbxCurveProgram *curve;
+  int n;
+  int unk_of[SBX_CURVE_MAX_PARAMS]; /* param index -> unknown index or -1 */
+  double *buf;                      /* stack of argument gradients */
+  size_t top, cap;
+} SbxCurveAd;
+
+static size_t
+curve_tree_size(const te_expr *n) {
+  size_t count = 1;
+  int i;
+  if (!n) return 0;
+  if (TYPE_MASK(n->type) == TE_CONSTANT || TYPE_MASK(n->type) == TE_VARIABLE) return 1;
+  for (i = 0; i < ARITY(n->type); i++)
+    count += curve_tree_size((const te_expr *)n->parameters[i]);
+  return count;
+}
+
+static void
+curve_ad_partials(const void *fn, int arity, const double *x, double v, double *p) {
+  double a = arity > 0 ? x[0] : 0.0;
+  double b = arity > 1 ? x[1] : 0.0;
+  int i;
+
+  for (i = 0; i < arity; i++) p[i] = 0.0;
+  if (arity == 1) {
+    if (fn == (const void *)negate) { p[0] = -1.0; return; }
+    if (fn == (const void *)exp) { p[0] = v; return; }
+    if (fn == (const void *)log) { p[0] = 1.0 / a; return; }
+    if (fn == (const void *)log10) { p[0] = 1.0 / (a * 2.30258509299404568402); return; }
+    if (fn == (const void *)sqrt) { p[0] = 0.5 / v; return; }
+    if (fn == (const void *)sin) { p[0] = cos(a); return; }
+    if (fn == (const void *)cos) { p[0] = -sin(a); return; }
+    if (fn == (const void *)tan) { p[0] = 1.0 + v * v; return; }
+    if (fn == (const void *)asin) { p[0] = 1.0 / sqrt(1.0 - a * a); return; }
+    if (fn == (const void *)acos) { p[0] = -1.0 / sqrt(1.0 - a * a); return; }
+    if (fn == (const void *)atan) { p[0] = 1.0 / (1.0 + a * a); return; }
+    if (fn == (const void *)sinh) { p[0] = cosh(a); return; }
+    if (fn == (const void *)cosh) { p[0] = sinh(a); return; }
+    if (fn == (const void *)tanh) { p[0] = 1.0 - v * v; return; }
+    if (fn == (const void *)fabs) { p[0] = a > 0.0 ? 1.0 : (a < 0.0 ? -1.0 : 0.0); return; }
+    if (fn == (const void *)floor || fn == (const void *)ceil ||
+        fn == (const void *)curve_fn_step) return;
+  } else if (arity == 2) {
+    if (fn == (const void *)add) { p[0] = 1.0; p[1] = 1.0; return; }
+    if (fn == (const void *)sub) { p[0] = 1.0; p[1] = -1.0; return; }
+    if (fn == (const void *)mul) { p[0] = b; p[1] = a; return; }
+    if (fn == (const void *)divide) { p[0] = 1.0 / b; p[1] = -a / (b * b); return; }
+    if (fn == (const void *)comma) { p[1] = 1.0; return; }
+    if (fn == (const void *)pow) {
+      p[0] = b == 0.0 ? 0.0 : b * pow(a, b - 1.0);
+      p[1] = a > 0.0 ? v * log(a) : 0.0;
+      return;
+    }
+    if (fn == (const void *)fmod) { p[0] = 1.0; p[1] = -trunc(a / b); return; }
+    if (fn == (const void *)atan2) {
+      double d = a * a + b * b;
+      p[0] = b / d;
+      p[1] = -a / d;
+      return;
+    }
+    if (fn == (const void *)curve_fn_min2) { p[a < b ? 0 : 1] = 1.0; return; }
+    if (fn == (const void *)curve_fn_max2) { p[a > b ? 0 : 1] = 1.0; return; }
+    if (fn == (const void *)curve_fn_lt || fn == (const void *)curve_fn_le ||
+        fn == (const void *)curve_fn_gt || fn == (const void *)curve_fn_ge ||
+        fn == (const void *)curve_fn_eq || fn == (const void *)curve_fn_ne) return;
+  } else if (arity == 3) {
+    double c = x[2];
+    if (fn == (const void *)curve_fn_ifelse) { p[a != 0.0 ? 1 : 2] = 1.0; return; }
+    if (fn == (const void *)curve_fn_lerp) { p[0] = 1.0 - c; p[1] = c; p[2] = b - a; return; }
+    if (fn == (const void *)curve_fn_between || fn == (const void *)curve_fn_pulse) return;
+    if (fn == (const void *)curve_fn_clamp) {
+      int lo = 1, hi = 2;
+      if (b > c) { lo = 2; hi = 1; }
+      if (a < x[lo]) p[lo] = 1.0;
+      else if (a > x[hi]) p[hi] = 1.0;
+      else p[0] = 1.0;
+      return;
+    }
+    if (fn == (const void *)curve_fn_ramp || fn == (const void *)curve_fn_smoothstep ||
+        fn == (const void *)curve_fn_smootherstep) {
+      /* u = (x - x0) / (x1 - x0), clamped; then the smoothstep polynomial. */
+      int xi = 0, x0i = 1, x1i = 2;
+      double u, w, ds;
+      if (fn != (const void *)curve_fn_ramp) { xi = 2; x0i = 0; x1i = 1; }
+      w = x[x1i] - x[x0i];
+      if (w == 0.0) return;
+      u = (x[xi] - x[x0i]) / w;
+      if (u <= 0.0 || u >= 1.0) return;
+      if (fn == (const void *)curve_fn_ramp) ds = 1.0;
+      else if (fn == (const void *)curve_fn_smoothstep) ds = 6.0 * u * (1.0 - u);
+      else ds = 30.0 * u * u * (1.0 - u) * (1.0 - u);
+      p[xi] = ds / w;
+      p[x0i] = ds * (u - 1.0) / w;
+      p[x1i] = -ds * u / w;
+      return;
+    }
+  } else if (arity == 5 && fn == (const void *)curve_fn_seg) {
+    double w = x[2] - x[1], u;
+    if (a <= x[1]) { p[3] = 1.0; return; }
+    if (a >= x[2] || w == 0.0) { p[4] = 1.0; return; }
+    u = (a - x[1]) / w;
+    p[0] = (x[4] - x[3]) / w;
+    p[1] = (x[4] - x[3]) * (u - 1.0) / w;
+    p[2] = -(x[4] - x[3]) * u / w;
+    p[3] = 1.0 - u;
+    p[4] = u;
+    return;
+  }
+
+  for (i = 0; i < arity; i++) {
+    double xp[5], fp, fm, h = 1e-6 * (fabs(x[i]) + 1.0);
+    memcpy(xp, x, (size_t)arity * sizeof(double));
+    xp[i] = x[i] + h;
+    fp = curve_vm_call(fn, arity, xp);
+    xp[i] = x[i] - h;
+    fm = curve_vm_call(fn, arity, xp);
+    if (isfinite(fp) && isfinite(fm)) p[i] = (fp - fm) / (2.0 * h);
+    else if (isfinite(fp)) p[i] = (fp - v) / h;
+    else p[i] = (v - fm) / h;
+  }
+}
+
+/*
+ * Evaluates n into *val and grad[0..ad->n). Returns 1 if n depends on an
+ * unknown, 0 if its gradient is zero, -1 for nodes it cannot differentiate.
+ */
+static int
+curve_ad_eval(SbxCurveAd *ad, const te_expr *n, double *val, double *grad) {
+  double x[5] = {0.0}, p[5];
+  double *g;
+  int arity, i, j, live = 0, used;
+
+  for (j = 0; j < ad->n; j++) grad[j] = 0.0;
+  switch (TYPE_MASK(n->type)) {
+    case TE_CONSTANT:
+      *val = n->value;
+      return 0;
+    case TE_VARIABLE: {
+      const double *pv = ad->curve->param_values;
+      *val = *n->bound;
+      if (n->bound >= pv && n->bound < pv + ad->curve->param_count &&
+          ad->unk_of[n->bound - pv] >= 0) {
+        grad[ad->unk_of[n->bound - pv]] = 1.0;
+        return 1;
+      }
+      return 0;
+    }
+    case TE_FUNCTION0: case TE_FUNCTION1: case TE_FUNCTION2:
+    case TE_FUNCTION3: case TE_FUNCTION4: case TE_FUNCTION5:
+      break;
+    default:
+      return -1;
+  }
+
+  arity = ARITY(n->type);
+  used = 0;
+  g = ad->buf + ad->top;
+  if (ad->top + (size_t)arity * ad->n > ad->cap) return -1;
+  ad->top += (size_t)arity * ad->n;
+  for (i = 0; i < arity; i++) {
+    int rc = curve_ad_eval(ad, (const te_expr *)n->parameters[i], &x[i], g + i * ad->n);
+    if (rc < 0) {
+      ad->top -= (size_t)arity * ad->n;
+      return -1;
+    }
+    if (rc) used |= 1 << i;
+  }
+  *val = curve_vm_call(n->function, arity, x);
+  if (used) {
+    curve_ad_partials(n->function, arity, x, *val, p);
+    for (i = 0; i < arity; i++) {
+      const double *gi = g + i * ad->n;
+      if (!(used & (1 << i)) || p[i] == 0.0) continue;
+      for (j = 0; j < ad->n; j++) grad[j] += p[i] * gi[j];
+      live = 1;
+    }
+  }
+  ad->top -= (size_t)arity * ad->n;
+  return live;
+}
+
+/*
+ * Residuals and analytic Jacobian at the current unknown values. Returns 1
+ * on success, 0 for a non-finite residual and -1 if the trees cannot be
+ * differentiated (or gave a non-finite derivative).
+ */
+static int
+curve_ad_jacobian(SbxCurveAd *ad, int n, te_expr **lhs, te_expr **rhs,
+                  double *resid, double jac[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_MAX_SOLVE_UNK]) {
+  double gl[SBX_CURVE_MAX_SOLVE_UNK], gr[SBX_CURVE_MAX_SOLVE_UNK];
+  int i, j, bad = 0;
+  for (i = 0; i < n; i++) {
+    double lv, rv;
+    ad->top = 0;
+    if (curve_ad_eval(ad, lhs[i], &lv, gl) < 0 || curve_ad_eval(ad, rhs[i], &rv, gr) < 0)
+      return -1;
+    if (!isfinite(lv) || !isfinite(rv)) return 0;
+    resid[i] = lv - rv;
+    for (j = 0; j < n; j++) {
+      jac[i][j] = gl[j] - gr[j];
+      if (!isfinite(jac[i][j])) bad = 1;
+    }
+  }
+  return bad ? -1 : 1;
+}
+
+/* Central-difference Jacobian, used when the analytic one is unavailable. */
+static int
+curve_fd_jacobian(SbxCurveProgram *curve, int n, double *x, const double *r0,
+                  double jac[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_MAX_SOLVE_UNK]) {
+  double r1[SBX_CURVE_MAX_SOLVE_EQ];
+  double r2[SBX_CURVE_MAX_SOLVE_EQ];
+  int i, j;
+
+  for (j = 0; j < n; j++) {
+    double xj = x[j];
+    double h = 1e-6 * (fabs(xj) + 1.0);
+    int good_plus, good_minus;
+
+    x[j] = xj + h;
+    curve_set_unknown_vector(curve, n, x);
+    good_plus = curve_eval_solve_residuals(n, curve->solve_lhs, curve->solve_rhs, r1);
+
+    x[j] = xj - h;
+    curve_set_unknown_vector(curve, n, x);
+    good_minus = curve_eval_solve_residuals(n, curve->solve_lhs, curve->solve_rhs, r2);
+
+    x[j] = xj;
+    curve_set_unknown_vector(curve, n, x);
+
+    if (good_plus && good_minus) {
+      for (i = 0; i < n; i++) jac[i][j] = (r1[i] - r2[i]) / (2.0 * h);
+    } else if (good_plus) {
+      for (i = 0; i < n; i++) jac[i][j] = (r1[i] - r0[i]) / h;
+    } else {
+      return j;
+    }
+  }
+  return -1;
+}
+
+static double
+curve_vec_norm2sq(int n, const double *v) {
+  int i;
+  double s = 0.0;
+  for (i = 0; i < n; i++) s += v[i] * v[i];
+  return s;
+}
+
+/*
+ * One Levenberg-Marquardt step: solve (J'J + lambda*diag(J'J)) d = -J'r
+ * and accept the first d that lowers |r|^2, raising lambda until one does.
+ * On success x, resid and *best are updated and lambda is relaxed.
+ */
+static int
+curve_lm_step(SbxCurveProgram *curve, int n, double *x, double *resid,
+              double jac[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_MAX_SOLVE_UNK],
+              double *lambda, double *best, double *step_norm) {
+  double jtj[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_MAX_SOLVE_UNK];
+  double g[SBX_CURVE_MAX_SOLVE_UNK];
+  double cost = curve_vec_norm2sq(n, resid);
+  int i, j, k;
+
   for (i = 0; i < n; i++) {
-    double lv = te_eval(lhs[i]);
-    double rv = te_eval(rhs[i]);
-    if (!isfinite(lv) || !isfinite(rv)) return 0;
-    resid[i] = lv - rv;
+    g[i] = 0.0;
+    for (k = 0; k < n; k++) g[i] += jac[k][i] * resid[k];
+    for (j = 0; j < n; j++) {
+      double s = 0.0;
+      for (k = 0; k < n; k++) s += jac[k][i] * jac[k][j];
+      jtj[i][j] = s;
+    }
   }
-  return 1;
+
+  while (*lambda <= 1e16) {
+    double a[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_MAX_SOLVE_UNK];
+    double b[SBX_CURVE_MAX_SOLVE_UNK];
+    double d[SBX_CURVE_MAX_SOLVE_UNK];
+    double trial[SBX_CURVE_MAX_SOLVE_UNK];
+    double r1[SBX_CURVE_MAX_SOLVE_EQ];
+    for (i = 0; i < n; i++) {
+      for (j = 0; j < n; j++) a[i][j] = jtj[i][j];
+      a[i][i] += *lambda * (jtj[i][i] > 1e-12 ? jtj[i][i] : 1e-12);
+      b[i] = -g[i];
+    }
+    if (curve_linear_solve(n, a, b, d)) {
+      for (i = 0; i < n; i++) trial[i] = x[i] + d[i];
+      curve_set_unknown_vector(curve, n, trial);
+      if (curve_eval_solve_residuals(n, curve->solve_lhs, curve->solve_rhs, r1) &&
+          curve_vec_norm2sq(n, r1) < cost) {
+        for (i = 0; i < n; i++) {
+          x[i] = trial[i];
+          resid[i] = r1[i];
+        }
+        *best = curve_vec_norm_inf(n, r1);
+        *step_norm = curve_vec_norm_inf(n, d);
+        *lambda = *lambda * 0.1 > 1e-12 ? *lambda * 0.1 : 1e-12;
+        return 1;
+      }
+    }
+    *lambda *= 10.0;
+  }
+  curve_set_unknown_vector(curve, n, x);
+  return 0;
 }
 
+/*
+ * Damped Newton on the compiled solve equations from x, with analytic
+ * Jacobians. When the Jacobian is singular or the line search finds no
+ * descent, a Levenberg-Marquardt step is tried before giving up.
+ */
 static int
-curve_apply_solve(SbxCurveProgram *curve, te_variable *vars, int vcnt) {
-  te_expr *lhs[SBX_CURVE_MAX_SOLVE_EQ];
-  te_expr *rhs[SBX_CURVE_MAX_SOLVE_EQ];
-  double x[SBX_CURVE_MAX_SOLVE_UNK];
+curve_solve_from(SbxCurveProgram *curve, SbxCurveAd *ad, double *x) {
+  te_expr **lhs = curve->solve_lhs;
+  te_expr **rhs = curve->solve_rhs;
+  const SbxCurveSolveConfig *sc = &curve->solve_cfg;
   double r0[SBX_CURVE_MAX_SOLVE_EQ];
   double r1[SBX_CURVE_MAX_SOLVE_EQ];
-  double r2[SBX_CURVE_MAX_SOLVE_EQ];
   double jac[SBX_CURVE_MAX_SOLVE_UNK][SBX_CURVE_MAX_SOLVE_UNK];
-  int n, i, j, iter, ok = 0;
+  double lambda = 1e-3;
+  int n = curve->solve_unknown_count;
+  int i, j, iter;
   double best = 0.0;
-  int err_lhs = 0, err_rhs = 0;
-
-  if (!curve->has_solve) return SBX_OK;
-  n = curve->solve_unknown_count;
-  if (n <= 0 || n > SBX_CURVE_MAX_SOLVE_UNK)
-    return curve_fail(curve, "%s: internal solve setup error (unknown count=%d)", curve->src_file, n);
-  if (curve->solve_eq_count != n)
-    return curve_fail(curve, "%s: solve requires equal equation/unknown counts", curve->src_file);
 
-  memset(lhs, 0, sizeof(lhs));
-  memset(rhs, 0, sizeof(rhs));
-
-  for (i = 0; i < n; i++) {
-    int idx = curve_param_index(curve, curve->solve_unknown_names[i]);
-    if (idx < 0)
-      goto solve_unknown_fail;
-    curve->solve_unknown_param_idx[i] = idx;
-    x[i] = curve->param_values[idx];
-  }
-  curve_set_unknown_vector(curve, n, x);
-
-  for (i = 0; i < n; i++) {
-    err_lhs = 0;
-    lhs[i] = te_compile(curve->solve_eq_lhs_src[i], vars, vcnt, &err_lhs);
-    if (!lhs[i]) goto solve_compile_lhs_fail;
-    err_rhs = 0;
-    rhs[i] = te_compile(curve->solve_eq_rhs_src[i], vars, vcnt, &err_rhs);
-    if (!rhs[i]) goto solve_compile_rhs_fail;
-  }
-
-  for (iter = 0; iter < 40; iter++) {
+  for (iter = 0; iter < sc->max_iterations; iter++) {
     double step[SBX_CURVE_MAX_SOLVE_UNK];
-    double snorm;
-    int accepted = 0;
-    double alpha;
+    double snorm = 0.0;
+    int accepted = 0, newton_ok, rc;
+    double alpha = 1.0;
 
     curve_set_unknown_vector(curve, n, x);
-    if (!curve_eval_solve_residuals(n, lhs, rhs, r0))
-      goto solve_eval_fail;
+    rc = curve_ad_jacobian(ad, n, lhs, rhs, r0, jac);
+    if (rc < 0 && !curve_eval_solve_residuals(n, lhs, rhs, r0)) rc = 0;
+    if (rc == 0)
+      return curve_fail(curve, "%s: solve evaluation failed at iteration %d (non-finite residual)", curve->src_file, iter + 1);
     best = curve_vec_norm_inf(n, r0);
-    if (best < 1e-9) { ok = 1; break; }
-
-    for (j = 0; j < n; j++) {
-      double xj = x[j];
-      double h = 1e-6 * (fabs(xj) + 1.0);
-      int good_plus, good_minus;
-
-      x[j] = xj + h;
-      curve_set_unknown_vector(curve, n, x);
-      good_plus = curve_eval_solve_residuals(n, lhs, rhs, r1);
-
-      x[j] = xj - h;
-      curve_set_unknown_vector(curve, n, x);
-      good_minus = curve_eval_solve_residuals(n, lhs, rhs, r2);
-
-      x[j] = xj;
-      curve_set_unknown_vector(curve, n, x);
-
-      if (good_plus && good_minus) {
-        for (i = 0; i < n; i++) jac[i][j] = (r1[i] - r2[i]) / (2.0 * h);
-      } else if (good_plus) {
-        for (i = 0; i < n; i++) jac[i][j] = (r1[i] - r0[i]) / h;
-      } else {
-        goto solve_jac_fail;
-      }
+    if (best < sc->tolerance) return SBX_OK;
+    if (rc < 0) {
+      j = curve_fd_jacobian(curve, n, x, r0, jac);
+      if (j >= 0)
+        return curve_fail(curve, "%s: solve Jacobian failed for unknown '%s' at iteration %d", curve->src_file, curve->solve_unknown_names[j], iter + 1);
     }
 
     {
@@ -755,94 +2330,106 @@ curve_apply_solve(SbxCurveProgram *curve, te_variable *vars, int vcnt) {
         for (j = 0; j < n; j++) a[i][j] = jac[i][j];
         b[i] = -r0[i];
       }
-      if (!curve_linear_solve(n, a, b, step))
-        goto solve_singular_fail;
+      newton_ok = curve_linear_solve(n, a, b, step);
     }
 
-    snorm = curve_vec_norm_inf(n, step);
-    alpha = 1.0;
-    for (i = 0; i < 12; i++) {
-      double trial[SBX_CURVE_MAX_SOLVE_UNK];
-      double trial_norm;
-      for (j = 0; j < n; j++) trial[j] = x[j] + alpha * step[j];
-      curve_set_unknown_vector(curve, n, trial);
-      if (!curve_eval_solve_residuals(n, lhs, rhs, r1)) {
+    if (newton_ok) {
+      snorm = curve_vec_norm_inf(n, step);
+      for (i = 0; i < 12; i++) {
+        double trial[SBX_CURVE_MAX_SOLVE_UNK];
+        double trial_norm;
+        for (j = 0; j < n; j++) trial[j] = x[j] + alpha * step[j];
+        curve_set_unknown_vector(curve, n, trial);
+        if (!curve_eval_solve_residuals(n, lhs, rhs, r1)) {
+          alpha *= 0.5;
+          continue;
+        }
+        trial_norm = curve_vec_norm_inf(n, r1);
+        if (trial_norm < best || trial_norm < sc->tolerance) {
+          for (j = 0; j < n; j++) x[j] = trial[j];
+          best = trial_norm;
+          accepted = 1;
+          break;
+        }
         alpha *= 0.5;
-        continue;
       }
-      trial_norm = curve_vec_norm_inf(n, r1);
-      if (trial_norm < best || trial_norm < 1e-9) {
-        for (j = 0; j < n; j++) x[j] = trial[j];
-        best = trial_norm;
-        accepted = 1;
-        break;
+      if (!accepted && snorm < 1e-12 && best < 100.0 * sc->tolerance) {
+        curve_set_unknown_vector(curve, n, x);
+        return SBX_OK;
       }
-      alpha *= 0.5;
     }
     if (!accepted) {
-      if (snorm < 1e-12 && best < 1e-7) { ok = 1; break; }
-      goto solve_descent_fail;
+      double lm_norm = 0.0;
+      if (!curve_lm_step(curve, n, x, r0, jac, &lambda, &best, &lm_norm)) {
+        if (!newton_ok)
+          return curve_fail(curve, "%s: solve Jacobian is singular/ill-conditioned at iteration %d", curve->src_file, iter + 1);
+        return curve_fail(curve, "%s: solve failed to find a descent step at iteration %d", curve->src_file, iter + 1);
+      }
+      alpha = 1.0;
+      snorm = lm_norm;
     }
-    if (best < 1e-9 || alpha * snorm < 1e-12) { ok = 1; break; }
+    curve_set_unknown_vector(curve, n, x);
+    if (best < sc->tolerance || alpha * snorm < 1e-12) return SBX_OK;
   }
 
-  if (!ok) goto solve_converge_fail;
+  return curve_fail(curve, "%s: solve did not converge after %d iterations", curve->src_file, sc->max_iterations);
+}
 
-  curve_set_unknown_vector(curve, n, x);
-  for (i = 0; i < n; i++) {
-    if (lhs[i]) te_free(lhs[i]);
-    if (rhs[i]) te_free(rhs[i]);
-  }
-  return SBX_OK;
+/*
+ * Solves from the current unknown parameter values: the file's initial
+ * guesses on first prepare, the previous solution (or a value set with
+ * sbx_curve_set_param) after. If that fails and multi-start is enabled,
+ * deterministic perturbations of the same start are tried in turn; the
+ * first start's error is kept when none of them converges.
+ */
+static int
+curve_run_solve(SbxCurveProgram *curve) {
+  SbxCurveAd ad;
+  double x0[SBX_CURVE_MAX_SOLVE_UNK];
+  double x[SBX_CURVE_MAX_SOLVE_UNK];
+  char first_error[sizeof(curve->last_error)];
+  size_t nodes = 0;
+  uint32_t seed = 0x9e3779b9u;
+  int n, i, k, rc;
 
-solve_unknown_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
-  }
-  return curve_fail(curve, "%s: solve unknown '%s' is not a defined parameter", curve->src_file, curve->solve_unknown_names[i]);
-solve_compile_lhs_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
-  }
-  return curve_fail(curve, "%s: solve equation #%d lhs failed near column %d", curve->src_file, i + 1, err_lhs);
-solve_compile_rhs_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
-  }
-  return curve_fail(curve, "%s: solve equation #%d rhs failed near column %d", curve->src_file, i + 1, err_rhs);
-solve_eval_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
-  }
-  return curve_fail(curve, "%s: solve evaluation failed at iteration %d (non-finite residual)", curve->src_file, iter + 1);
-solve_jac_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
-  }
-  return curve_fail(curve, "%s: solve Jacobian failed for unknown '%s' at iteration %d", curve->src_file, curve->solve_unknown_names[j], iter + 1);
-solve_singular_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
-  }
-  return curve_fail(curve, "%s: solve Jacobian is singular/ill-conditioned at iteration %d", curve->src_file, iter + 1);
-solve_descent_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
+  if (!curve->has_solve) return SBX_OK;
+  n = curve->solve_unknown_count;
+  memset(&ad, 0, sizeof(ad));
+  ad.curve = curve;
+  ad.n = n;
+  for (i = 0; i < SBX_CURVE_MAX_PARAMS; i++) ad.unk_of[i] = -1;
+  for (i = 0; i < n; i++) {
+    ad.unk_of[curve->solve_unknown_param_idx[i]] = i;
+    x0[i] = curve->param_values[curve->solve_unknown_param_idx[i]];
+    nodes += curve_tree_size(curve->solve_lhs[i]) + curve_tree_size(curve->solve_rhs[i]);
   }
-  return curve_fail(curve, "%s: solve failed to find a descent step at iteration %d", curve->src_file, iter + 1);
-solve_converge_fail:
-  for (j = 0; j < n; j++) {
-    if (lhs[j]) te_free(lhs[j]);
-    if (rhs[j]) te_free(rhs[j]);
+  /* Argument gradients nest at most one slot per node deep. */
+  ad.cap = nodes * (size_t)n;
+  ad.buf = (double *)malloc(ad.cap * sizeof(double));
+  if (!ad.buf) return curve_fail(curve, "%s: out of memory in solve", curve->src_file);
+
+  memcpy(x, x0, sizeof(x));
+  rc = curve_solve_from(curve, &ad, x);
+  if (rc != SBX_OK && curve->solve_cfg.multistart > 0) {
+    memcpy(first_error, curve->last_error, sizeof(first_error));
+    for (k = 0; k < curve->solve_cfg.multistart && rc != SBX_OK; k++) {
+      for (i = 0; i < n; i++) {
+        double u;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        u = (double)seed / 2147483648.0 - 1.0;
+        x[i] = x0[i] + curve->solve_cfg.multistart_spread * (fabs(x0[i]) + 1.0) * u;
+      }
+      rc = curve_solve_from(curve, &ad, x);
+    }
+    if (rc != SBX_OK) {
+      curve_set_unknown_vector(curve, n, x0);
+      memcpy(curve->last_error, first_error, sizeof(first_error));
+    }
   }
-  return curve_fail(curve, "%s: solve did not converge after 40 iterations", curve->src_file);
+  free(ad.buf);
+  return rc;
 }
 
 static void
@@ -895,35 +2482,131 @@ curve_compile_expr_target(SbxCurveProgram *curve,
   return SBX_OK;
 }
 
+/* Evaluates a baked lane at t; returns 0 outside it or on a fallback segment. */
 static int
-curve_eval_expr_target(SbxCurveProgram *curve,
-                       const SbxCurveExprTarget *target,
-                       const char *kind,
-                       double default_value,
-                       double *out_value) {
-  int i, matched;
-  double condv, value;
-  if (!curve || !target || !kind || !out_value) return SBX_EINVAL;
-  value = default_value;
-  if (target->piece_count > 0) {
-    matched = 0;
-    for (i = 0; i < target->piece_count; i++) {
-      if (!target->piece_cond[i] || !target->piece_expr[i])
+curve_bake_lookup(const SbxCurveBakeLane *lane, int *cursor, double t, double *out_value) {
+  const double *knot = lane->knot;
+  const double *c;
+  int i, lo, hi;
+  double u;
+
+  if (lane->count <= 0 || !(t >= knot[0] && t <= knot[lane->count])) return 0;
+  i = *cursor;
+  if (i < 0 || i >= lane->count) i = 0;
+  if (!(t >= knot[i] && t < knot[i + 1])) {
+    if (i + 1 < lane->count && t >= knot[i + 1] && t < knot[i + 2]) {
+      i++;
+    } else {
+      lo = 0;
+      hi = lane->count - 1;
+      while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (knot[mid] <= t) lo = mid;
+        else hi = mid - 1;
+      }
+      i = lo;
+    }
+    *cursor = i;
+  }
+  c = lane->coef + 4 * i;
+  if (isnan(c[0])) return 0;
+  u = t - knot[i];
+  *out_value = ((c[3] * u + c[2]) * u + c[1]) * u + c[0];
+  return 1;
+}
+
+/*
+ * Evaluates one prepared target at the current ev_t/ev_m: from its baked
+ * segment when one covers ev_t, else through the VM program when one was
+ * compiled, else through te_eval. *out_has is
+ * cleared when the target has no expression. With an eval state st, time,
+ * registers and cursors come from st and errors go to st->last_error; the
+ * program itself is only read.
+ */
+static int
+curve_eval_compiled(SbxCurveProgram *curve,
+                    SbxCurveEvalState *st,
+                    int vm_target,
+                    te_expr *const *piece_cond,
+                    te_expr *const *piece_expr,
+                    int piece_count,
+                    const te_expr *expr,
+                    const char *kind,
+                    int *out_has,
+                    double *out_value) {
+  int i;
+  double condv;
+
+  *out_has = 1;
+  if (st) {
+    int pc = curve->vm->entry[vm_target];
+    if (curve->bake &&
+        curve_bake_lookup(&curve->bake->lane[vm_target], &st->cursor[vm_target],
+                          st->t, out_value))
+      return SBX_OK;
+    if (pc < 0) {
+      *out_has = 0;
+      return SBX_OK;
+    }
+    curve_vm_sync(curve->vm, st->regs, &st->frame_ok, st->t, st->m);
+    if (curve_vm_exec(curve->vm, st->regs, pc, out_value) != SBX_OK)
+      return curve_state_fail(curve, st, "Curve %s piece condition evaluated non-finite", kind);
+    return SBX_OK;
+  }
+  if (curve->bake &&
+      curve_bake_lookup(&curve->bake->lane[vm_target], &curve->bake->lane[vm_target].cursor,
+                        curve->ev_t, out_value))
+    return SBX_OK;
+  if (curve->vm) {
+    int pc = curve->vm->entry[vm_target];
+    if (pc < 0) {
+      *out_has = 0;
+      return SBX_OK;
+    }
+    curve_vm_sync(curve->vm, curve->vm->regs, &curve->vm->frame_ok, curve->ev_t, curve->ev_m);
+    if (curve_vm_exec(curve->vm, curve->vm->regs, pc, out_value) != SBX_OK)
+      return curve_fail(curve, "Curve %s piece condition evaluated non-finite", kind);
+    return SBX_OK;
+  }
+  if (piece_count > 0) {
+    for (i = 0; i < piece_count; i++) {
+      if (!piece_cond[i] || !piece_expr[i])
         return curve_fail(curve, "Curve %s piece state is incomplete", kind);
-      condv = te_eval(target->piece_cond[i]);
+      condv = te_eval(piece_cond[i]);
       if (!isfinite(condv))
         return curve_fail(curve, "Curve %s piece condition evaluated non-finite", kind);
       if (condv != 0.0) {
-        value = te_eval(target->piece_expr[i]);
-        matched = 1;
-        break;
+        *out_value = te_eval(piece_expr[i]);
+        return SBX_OK;
       }
     }
-    if (!matched)
-      value = te_eval(target->piece_expr[target->piece_count - 1]);
-  } else if (target->has_expr && target->expr) {
-    value = te_eval(target->expr);
+    *out_value = te_eval(piece_expr[piece_count - 1]);
+    return SBX_OK;
+  }
+  if (expr) {
+    *out_value = te_eval(expr);
+    return SBX_OK;
   }
+  *out_has = 0;
+  return SBX_OK;
+}
+
+static int
+curve_eval_expr_target(SbxCurveProgram *curve,
+                       const SbxCurveExprTarget *target,
+                       const char *kind,
+                       double default_value,
+                       double *out_value) {
+  int rc, has;
+  double value;
+  if (!curve || !target || !kind || !out_value) return SBX_EINVAL;
+  value = default_value;
+  rc = curve_eval_compiled(curve, 0,
+                           SBX_CURVE_VM_MIXFX0 + (int)(target - curve->mixfx_targets),
+                           target->piece_cond, target->piece_expr, target->piece_count,
+                           target->has_expr ? target->expr : 0,
+                           kind, &has, &value);
+  if (rc != SBX_OK) return rc;
   if (!isfinite(value))
     return curve_fail(curve, "Curve %s evaluated non-finite", kind);
   *out_value = value;
@@ -932,7 +2615,9 @@ curve_eval_expr_target(SbxCurveProgram *curve,
 
 int
 sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source_name) {
-  char *buf, *line, *saveptr;
+  char *buf = 0, *line;
+  const char *cursor = text;
+  size_t buf_cap = 0, line_len;
   int lno = 0;
   int have_beat = 0;
 
@@ -949,14 +2634,15 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
       return curve_fail(curve, "Curve source must use .sbgf extension: %s", curve->src_file);
   }
 
-  buf = strdup(text);
-  if (!buf)
-    return curve_fail(curve, "Out of memory loading %s", curve->src_file);
-
-  saveptr = 0;
-  for (line = strtok_r(buf, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+  while (*cursor) {
     char *s;
     int prc;
+    if (sbx_text_next_line(&cursor, &buf, &buf_cap, &line_len) != SBX_OK) {
+      free(buf);
+      return curve_fail(curve, "Out of memory loading %s", curve->src_file);
+    }
+    if (line_len == 0) continue; /* empty lines are not numbered */
+    line = buf;
     lno++;
     if (strchr(line, '\r')) *strchr(line, '\r') = 0;
     s = curve_trim(line);
@@ -976,19 +2662,21 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
     if (!strncmp(s, "beat", 4) &&
         (isspace((unsigned char)s[4]) || s[4] == '=' || s[4] == '<' || s[4] == '>')) {
       prc = curve_parse_piece_line(curve, s, lno, curve->src_file, "beat", 4,
-                                   curve->beat_piece_cond_src,
-                                   curve->beat_piece_expr_src,
+                                   &curve->beat_piece_cond_src,
+                                   &curve->beat_piece_expr_src,
+                                   &curve->beat_piece_cond,
+                                   &curve->beat_piece_expr,
                                    &curve->beat_piece_count);
       if (prc < 0) { free(buf); return SBX_EINVAL; }
       if (prc > 0) {
-        if (curve->beat_expr_src[0]) { free(buf); return curve_fail(curve, "%s:%d: cannot mix 'beat = ...' with piecewise beat<... lines", curve->src_file, lno); }
+        if (curve->beat_expr_src) { free(buf); return curve_fail(curve, "%s:%d: cannot mix 'beat = ...' with piecewise beat<... lines", curve->src_file, lno); }
         have_beat = 1;
         continue;
       }
       if (curve->beat_piece_count > 0) { free(buf); return curve_fail(curve, "%s:%d: cannot mix piecewise beat<... lines with 'beat = ...'", curve->src_file, lno); }
       {
         int rc = curve_parse_expr_line(curve, s, lno, curve->src_file, "beat",
-                                       curve->beat_expr_src, sizeof(curve->beat_expr_src));
+                                       &curve->beat_expr_src);
         if (rc != SBX_OK) { free(buf); return rc; }
       }
       have_beat = 1;
@@ -997,8 +2685,10 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
     if (!strncmp(s, "carrier", 7) &&
         (isspace((unsigned char)s[7]) || s[7] == '=' || s[7] == '<' || s[7] == '>')) {
       prc = curve_parse_piece_line(curve, s, lno, curve->src_file, "carrier", 7,
-                                   curve->carrier_piece_cond_src,
-                                   curve->carrier_piece_expr_src,
+                                   &curve->carrier_piece_cond_src,
+                                   &curve->carrier_piece_expr_src,
+                                   &curve->carrier_piece_cond,
+                                   &curve->carrier_piece_expr,
                                    &curve->carrier_piece_count);
       if (prc < 0) { free(buf); return SBX_EINVAL; }
       if (prc > 0) {
@@ -1008,7 +2698,7 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
       if (curve->carrier_piece_count > 0) { free(buf); return curve_fail(curve, "%s:%d: cannot mix piecewise carrier<... lines with 'carrier = ...'", curve->src_file, lno); }
       {
         int rc = curve_parse_expr_line(curve, s, lno, curve->src_file, "carrier",
-                                       curve->carrier_expr_src, sizeof(curve->carrier_expr_src));
+                                       &curve->carrier_expr_src);
         if (rc != SBX_OK) { free(buf); return rc; }
       }
       curve->has_carrier_expr = 1;
@@ -1017,8 +2707,10 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
     if (!strncmp(s, "amp", 3) &&
         (isspace((unsigned char)s[3]) || s[3] == '=' || s[3] == '<' || s[3] == '>')) {
       prc = curve_parse_piece_line(curve, s, lno, curve->src_file, "amp", 3,
-                                   curve->amp_piece_cond_src,
-                                   curve->amp_piece_expr_src,
+                                   &curve->amp_piece_cond_src,
+                                   &curve->amp_piece_expr_src,
+                                   &curve->amp_piece_cond,
+                                   &curve->amp_piece_expr,
                                    &curve->amp_piece_count);
       if (prc < 0) { free(buf); return SBX_EINVAL; }
       if (prc > 0) {
@@ -1028,7 +2720,7 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
       if (curve->amp_piece_count > 0) { free(buf); return curve_fail(curve, "%s:%d: cannot mix piecewise amp<... lines with 'amp = ...'", curve->src_file, lno); }
       {
         int rc = curve_parse_expr_line(curve, s, lno, curve->src_file, "amp",
-                                       curve->amp_expr_src, sizeof(curve->amp_expr_src));
+                                       &curve->amp_expr_src);
         if (rc != SBX_OK) { free(buf); return rc; }
       }
       curve->has_amp_expr = 1;
@@ -1037,8 +2729,10 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
     if (!strncmp(s, "mixamp", 6) &&
         (isspace((unsigned char)s[6]) || s[6] == '=' || s[6] == '<' || s[6] == '>')) {
       prc = curve_parse_piece_line(curve, s, lno, curve->src_file, "mixamp", 6,
-                                   curve->mixamp_piece_cond_src,
-                                   curve->mixamp_piece_expr_src,
+                                   &curve->mixamp_piece_cond_src,
+                                   &curve->mixamp_piece_expr_src,
+                                   &curve->mixamp_piece_cond,
+                                   &curve->mixamp_piece_expr,
                                    &curve->mixamp_piece_count);
       if (prc < 0) { free(buf); return SBX_EINVAL; }
       if (prc > 0) {
@@ -1048,7 +2742,7 @@ sbx_curve_load_text(SbxCurveProgram *curve, const char *text, const char *source
       if (curve->mixamp_piece_count > 0) { free(buf); return curve_fail(curve, "%s:%d: cannot mix piecewise mixamp<... lines with 'mixamp = ...'", curve->src_file, lno); }
       {
         int rc = curve_parse_expr_line(curve, s, lno, curve->src_file, "mixamp",
-                                       curve->mixamp_expr_src, sizeof(curve->mixamp_expr_src));
+                                       &curve->mixamp_expr_src);
         if (rc != SBX_OK) { free(buf); return rc; }
       }
       curve->has_mixamp_expr = 1;
@@ -1089,46 +2783,63 @@ parsed_line:
 
 int
 sbx_curve_load_file(SbxCurveProgram *curve, const char *path) {
-  FILE *fp;
-  long sz;
-  char *buf;
+  SbxTextFile tf;
   int rc;
 
   if (!curve || !path) return SBX_EINVAL;
   if (!curve_has_sbgf_ext(path))
     return curve_fail(curve, "Curve file must use .sbgf extension: %s", path);
 
-  fp = fopen(path, "rb");
-  if (!fp)
-    return curve_fail(curve, "Cannot open curve file: %s (%s)", path, strerror(errno));
-  if (fseek(fp, 0, SEEK_END) != 0) {
-    fclose(fp);
-    return curve_fail(curve, "Cannot seek curve file: %s", path);
-  }
-  sz = ftell(fp);
-  if (sz < 0) {
-    fclose(fp);
-    return curve_fail(curve, "Cannot size curve file: %s", path);
-  }
-  if (fseek(fp, 0, SEEK_SET) != 0) {
-    fclose(fp);
-    return curve_fail(curve, "Cannot rewind curve file: %s", path);
-  }
-  buf = (char *)malloc((size_t)sz + 1);
-  if (!buf) {
-    fclose(fp);
+  rc = sbx_text_file_open(path, &tf);
+  if (rc == SBX_ENOMEM)
     return curve_fail(curve, "Out of memory reading curve file: %s", path);
+  if (rc != SBX_OK)
+    return curve_fail(curve, "Cannot open curve file: %s (%s)", path, strerror(errno));
+  rc = sbx_curve_load_text(curve, tf.text, path);
+  sbx_text_file_close(&tf);
+  return rc;
+}
+
+/*
+ * Re-prepare after sbx_curve_set_param with an unchanged config: re-solves
+ * only if a changed parameter feeds the solve or the solve config changed,
+ * and rebuilds the VM only if a changed (or solved) parameter is folded
+ * into it.
+ */
+static int
+curve_reprepare(SbxCurveProgram *curve) {
+  uint32_t dirty = curve->param_dirty;
+  int i, rc;
+
+  if ((dirty & curve->solve_deps) || curve->solve_dirty) {
+    rc = curve_run_solve(curve);
+    if (rc != SBX_OK) {
+      char msg[sizeof(curve->last_error)];
+      memcpy(msg, curve->last_error, sizeof(msg));
+      sbx_curve_clear_compiled(curve);
+      memcpy(curve->last_error, msg, sizeof(msg));
+      return rc;
+    }
+    for (i = 0; i < curve->solve_unknown_count; i++)
+      dirty |= (uint32_t)1 << curve->solve_unknown_param_idx[i];
   }
-  if (fread(buf, 1, (size_t)sz, fp) != (size_t)sz) {
-    free(buf);
-    fclose(fp);
-    return curve_fail(curve, "Cannot read curve file: %s", path);
+  if (dirty & curve->target_deps) {
+    curve_vm_free(curve->vm);
+    curve->vm = 0;
+    curve_bake_free(curve->bake);
+    curve->bake = 0;
+    rc = curve_compile_vm(curve);
+    if (rc != SBX_OK) {
+      sbx_curve_clear_compiled(curve);
+      curve_set_error(curve, "Out of memory compiling %s", curve->src_file);
+      return rc;
+    }
   }
-  fclose(fp);
-  buf[sz] = 0;
-  rc = sbx_curve_load_text(curve, buf, path);
-  free(buf);
-  return rc;
+  curve->param_dirty = 0;
+  curve->solve_dirty = 0;
+  curve->prepared = 1;
+  curve->last_error[0] = 0;
+  return SBX_OK;
 }
 
 int
@@ -1150,6 +2861,9 @@ sbx_curve_prepare(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg_in) {
   if (!(cfg.carrier_span_sec > 0.0) || !(cfg.beat_span_sec > 0.0))
     return curve_fail(curve, "Curve spans must be > 0");
 
+  if (curve->trees_ok && !memcmp(&cfg, &curve->cfg, sizeof(cfg)))
+    return curve_reprepare(curve);
+
   sbx_curve_clear_compiled(curve);
   curve->cfg = cfg;
   curve->ev_D = cfg.beat_span_sec / 60.0;
@@ -1234,7 +2948,9 @@ sbx_curve_prepare(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg_in) {
   for (i = 0; i < curve->param_count; i++)
     ADD_VAR(curve->param_names[i], &curve->param_values[i]);
 
-  rc = curve_apply_solve(curve, vars, vcnt);
+  rc = curve_compile_solve(curve, vars, vcnt);
+  if (rc != SBX_OK) goto prepare_fail;
+  rc = curve_run_solve(curve);
   if (rc != SBX_OK) goto prepare_fail;
 
   if (curve->beat_piece_count > 0) {
@@ -1306,6 +3022,20 @@ sbx_curve_prepare(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg_in) {
 #undef ADD_FN3
 #undef ADD_FN5
 
+  rc = curve_compile_vm(curve);
+  if (rc != SBX_OK) {
+    sbx_curve_clear_compiled(curve);
+    curve_set_error(curve, "Out of memory compiling %s", curve->src_file);
+    return rc;
+  }
+
+  curve->solve_deps = 0;
+  for (i = 0; i < curve->solve_eq_count && curve->has_solve; i++)
+    curve->solve_deps |= curve_tree_param_deps(curve, curve->solve_lhs[i]) |
+                         curve_tree_param_deps(curve, curve->solve_rhs[i]);
+  curve->trees_ok = 1;
+  curve->param_dirty = 0;
+  curve->solve_dirty = 0;
   curve->prepared = 1;
   curve->last_error[0] = 0;
   return SBX_OK;
@@ -1366,125 +3096,429 @@ prepare_fail:
   return SBX_EINVAL;
 }
 
+static const char *const curve_point_kind[4] = { "beat", "carrier", "amp", "mixamp" };
+
+/*
+ * Hot path of curve_eval_point for an unbaked program: syncs the frame once
+ * and runs the four point targets straight off their VM entries. A target
+ * that is a bare register (constant or shared value) is read without
+ * entering the dispatch loop; absent targets keep the value in val[].
+ */
+static int
+curve_vm_eval_point(SbxCurveProgram *curve, SbxCurveEvalState *st,
+                    double t, double m, double *val) {
+  const SbxCurveVm *vm = curve->vm;
+  double *regs = st ? st->regs : vm->regs;
+  int k;
+
+  curve_vm_sync(vm, regs, st ? &st->frame_ok : &curve->vm->frame_ok, t, m);
+  for (k = 0; k < 4; k++) {
+    int pc = vm->entry[k];
+    const SbxCurveVmInsn *ip;
+    if (pc < 0) continue;
+    ip = vm->code + pc;
+    if (ip->op == SBX_CVM_RET) {
+      val[k] = regs[ip->a[0]];
+      continue;
+    }
+    if (curve_vm_exec(vm, regs, pc, &val[k]) != SBX_OK)
+      return curve_state_fail(curve, st, "Curve %s piece condition evaluated non-finite",
+                              curve_point_kind[k]);
+  }
+  return SBX_OK;
+}
+
+/*
+ * Per-target path of curve_eval_point for baked programs and programs
+ * without a VM. Leaves the carrier/amp fallbacks to the caller.
+ */
+static int
+curve_eval_point_targets(SbxCurveProgram *curve, SbxCurveEvalState *st, double *val) {
+  int rc, has;
+
+  rc = curve_eval_compiled(curve, st, SBX_CURVE_VM_BEAT,
+                           curve->beat_piece_cond, curve->beat_piece_expr,
+                           curve->beat_piece_count, curve->beat_expr,
+                           "beat", &has, &val[0]);
+  if (rc != SBX_OK) return rc;
+  if (!isfinite(val[0])) return SBX_OK;
+  rc = curve_eval_compiled(curve, st, SBX_CURVE_VM_CARRIER,
+                           curve->carrier_piece_cond, curve->carrier_piece_expr,
+                           curve->carrier_piece_count,
+                           curve->has_carrier_expr ? curve->carrier_expr : 0,
+                           "carrier", &has, &val[1]);
+  if (rc != SBX_OK) return rc;
+  rc = curve_eval_compiled(curve, st, SBX_CURVE_VM_AMP,
+                           curve->amp_piece_cond, curve->amp_piece_expr,
+                           curve->amp_piece_count,
+                           curve->has_amp_expr ? curve->amp_expr : 0,
+                           "amp", &has, &val[2]);
+  if (rc != SBX_OK) return rc;
+  return curve_eval_compiled(curve, st, SBX_CURVE_VM_MIXAMP,
+                             curve->mixamp_piece_cond, curve->mixamp_piece_expr,
+                             curve->mixamp_piece_count,
+                             curve->has_mixamp_expr ? curve->mixamp_expr : 0,
+                             "mixamp", &has, &val[3]);
+}
+
+/* Carrier of a program without a carrier target: the config's linear ramp. */
+static double
+curve_carrier_ramp(const SbxCurveProgram *curve, double t) {
+  return curve->cfg.carrier_start_hz +
+         (curve->cfg.carrier_end_hz - curve->cfg.carrier_start_hz) *
+         (curve->cfg.carrier_span_sec > 0.0 ? (t / curve->cfg.carrier_span_sec) : 0.0);
+}
+
+/*
+ * One evaluation point, either through the program's own frame (st NULL,
+ * sbx_curve_eval) or through a caller-owned eval state (sbx_curve_eval_batch).
+ */
+static int
+curve_eval_point(SbxCurveProgram *curve,
+                 SbxCurveEvalState *st,
+                 double t_sec,
+                 SbxCurveEvalPoint *out_point) {
+  double val[4];
+  double t, m;
+  int rc;
+
+  t = t_sec < 0.0 ? 0.0 : t_sec;
+  if (st) {
+    st->t = t;
+    st->m = m = t / 60.0;
+  } else {
+    curve_set_eval_time(curve, t);
+    t = curve->ev_t;
+    m = curve->ev_m;
+  }
+
+  if (curve->vm && !curve->bake && curve->vm->point_const) {
+    const double *pv = curve->vm->point_value;
+    out_point->beat_hz = pv[0];
+    out_point->carrier_hz = isfinite(pv[1]) ? pv[1] : curve_carrier_ramp(curve, t);
+    out_point->beat_amp_pct = pv[2];
+    out_point->mix_amp_pct = pv[3];
+    return SBX_OK;
+  }
+
+  val[0] = NAN;
+  val[1] = NAN;
+  val[2] = curve->cfg.beat_amp0_pct;
+  val[3] = curve->cfg.mix_amp0_pct;
+  if (curve->vm && !curve->bake)
+    rc = curve_vm_eval_point(curve, st, t, m, val);
+  else
+    rc = curve_eval_point_targets(curve, st, val);
+  if (rc != SBX_OK) return rc;
+  if (!isfinite(val[0]))
+    return curve_state_fail(curve, st, "Curve beat evaluated non-finite");
+  if (!isfinite(val[1])) val[1] = curve_carrier_ramp(curve, t);
+  if (!isfinite(val[2])) val[2] = curve->cfg.beat_amp0_pct;
+  if (!isfinite(val[3])) val[3] = curve->cfg.mix_amp0_pct;
+
+  out_point->beat_hz = val[0];
+  out_point->carrier_hz = val[1];
+  out_point->beat_amp_pct = val[2] < 0.0 ? 0.0 : val[2];
+  out_point->mix_amp_pct = val[3] < 0.0 ? 0.0 : val[3];
+  return SBX_OK;
+}
+
 int
 sbx_curve_eval(SbxCurveProgram *curve, double t_sec, SbxCurveEvalPoint *out_point) {
-  int i, matched;
-  double condv;
-  double beat, carrier, amp_pct, mixamp_pct;
-  double t;
+  int rc;
 
   if (!curve || !out_point) return SBX_EINVAL;
   if (!curve->prepared)
     return curve_fail(curve, "Curve is not prepared for evaluation");
+  rc = curve_eval_point(curve, 0, t_sec, out_point);
+  if (rc == SBX_OK) curve->last_error[0] = 0;
+  return rc;
+}
 
-  t = t_sec;
-  curve_set_eval_time(curve, t);
-  t = curve->ev_t;
+SbxCurveEvalState *
+sbx_curve_eval_state_create(void) {
+  return (SbxCurveEvalState *)calloc(1, sizeof(SbxCurveEvalState));
+}
 
-  if (curve->beat_piece_count > 0) {
-    matched = 0;
-    for (i = 0; i < curve->beat_piece_count; i++) {
-      if (!curve->beat_piece_cond[i] || !curve->beat_piece_expr[i])
-        return curve_fail(curve, "Curve beat piece state is incomplete");
-      condv = te_eval(curve->beat_piece_cond[i]);
-      if (!isfinite(condv))
-        return curve_fail(curve, "Curve beat piece condition evaluated non-finite");
-      if (condv != 0.0) {
-        beat = te_eval(curve->beat_piece_expr[i]);
-        matched = 1;
-        break;
-      }
-    }
-    if (!matched)
-      beat = te_eval(curve->beat_piece_expr[curve->beat_piece_count - 1]);
-  } else {
-    beat = te_eval(curve->beat_expr);
+void
+sbx_curve_eval_state_destroy(SbxCurveEvalState *state) {
+  if (!state) return;
+  free(state->regs);
+  free(state);
+}
+
+const char *
+sbx_curve_eval_state_last_error(const SbxCurveEvalState *state) {
+  if (!state) return "null curve eval state";
+  return state->last_error;
+}
+
+int
+sbx_curve_eval_batch(const SbxCurveProgram *curve_in,
+                     SbxCurveEvalState *state,
+                     const double *t_sec,
+                     size_t count,
+                     SbxCurveEvalPoint *out_points) {
+  /* The state path only reads the program; see curve_eval_compiled. */
+  SbxCurveProgram *curve = (SbxCurveProgram *)curve_in;
+  const SbxCurveVm *vm;
+  size_t i;
+  int rc;
+
+  if (!curve || !state || (count > 0 && (!t_sec || !out_points))) return SBX_EINVAL;
+  if (!curve->prepared)
+    return curve_state_fail(curve, state, "Curve is not prepared for evaluation");
+  vm = curve->vm;
+  if (!vm)
+    return curve_state_fail(curve, state,
+                            "Curve %s is too large for batch evaluation", curve->src_file);
+
+  /*
+   * Constants never change after prepare, so copying them here keeps the
+   * state valid across re-prepares and across programs.
+   */
+  if (state->reg_cap < vm->reg_count) {
+    double *regs = (double *)realloc(state->regs, (size_t)vm->reg_count * sizeof(double));
+    if (!regs)
+      return curve_state_fail(curve, state, "Out of memory for curve eval state");
+    state->regs = regs;
+    state->reg_cap = vm->reg_count;
   }
-  if (!isfinite(beat))
-    return curve_fail(curve, "Curve beat evaluated non-finite");
+  memcpy(state->regs + 2, vm->regs + 2, (size_t)vm->const_count * sizeof(double));
+  state->frame_ok = 0;
 
-  if (curve->carrier_piece_count > 0) {
-    matched = 0;
-    for (i = 0; i < curve->carrier_piece_count; i++) {
-      if (!curve->carrier_piece_cond[i] || !curve->carrier_piece_expr[i])
-        return curve_fail(curve, "Curve carrier piece state is incomplete");
-      condv = te_eval(curve->carrier_piece_cond[i]);
-      if (!isfinite(condv))
-        return curve_fail(curve, "Curve carrier piece condition evaluated non-finite");
-      if (condv != 0.0) {
-        carrier = te_eval(curve->carrier_piece_expr[i]);
-        matched = 1;
-        break;
-      }
-    }
-    if (!matched)
-      carrier = te_eval(curve->carrier_piece_expr[curve->carrier_piece_count - 1]);
-    if (!isfinite(carrier))
-      carrier = curve->cfg.carrier_start_hz +
-                (curve->cfg.carrier_end_hz - curve->cfg.carrier_start_hz) *
-                (curve->cfg.carrier_span_sec > 0.0 ? (t / curve->cfg.carrier_span_sec) : 0.0);
-  } else if (curve->has_carrier_expr && curve->carrier_expr) {
-    carrier = te_eval(curve->carrier_expr);
-    if (!isfinite(carrier))
-      carrier = curve->cfg.carrier_start_hz +
-                (curve->cfg.carrier_end_hz - curve->cfg.carrier_start_hz) *
-                (curve->cfg.carrier_span_sec > 0.0 ? (t / curve->cfg.carrier_span_sec) : 0.0);
-  } else {
-    carrier = curve->cfg.carrier_start_hz +
-              (curve->cfg.carrier_end_hz - curve->cfg.carrier_start_hz) *
-              (curve->cfg.carrier_span_sec > 0.0 ? (t / curve->cfg.carrier_span_sec) : 0.0);
+  for (i = 0; i < count; i++) {
+    rc = curve_eval_point(curve, state, t_sec[i], &out_points[i]);
+    if (rc != SBX_OK) return rc;
   }
+  state->last_error[0] = 0;
+  return SBX_OK;
+}
 
-  amp_pct = curve->cfg.beat_amp0_pct;
-  if (curve->amp_piece_count > 0) {
-    matched = 0;
-    for (i = 0; i < curve->amp_piece_count; i++) {
-      if (!curve->amp_piece_cond[i] || !curve->amp_piece_expr[i])
-        return curve_fail(curve, "Curve amp piece state is incomplete");
-      condv = te_eval(curve->amp_piece_cond[i]);
-      if (!isfinite(condv))
-        return curve_fail(curve, "Curve amp piece condition evaluated non-finite");
-      if (condv != 0.0) {
-        amp_pct = te_eval(curve->amp_piece_expr[i]);
-        matched = 1;
-        break;
-      }
+/*
+ * Maps a VM target id to its prepared trees. Returns 0 when the target has
+ * no expression.
+ */
+static int
+curve_target_trees(SbxCurveProgram *curve,
+                   int target,
+                   te_expr *const **out_cond,
+                   te_expr *const **out_expr,
+                   int *out_count,
+                   const te_expr **out_single,
+                   const char **out_kind) {
+  SbxCurveExprTarget *fx;
+  switch (target) {
+    case SBX_CURVE_VM_BEAT:
+      *out_cond = curve->beat_piece_cond;
+      *out_expr = curve->beat_piece_expr;
+      *out_count = curve->beat_piece_count;
+      *out_single = curve->beat_expr;
+      *out_kind = "beat";
+      break;
+    case SBX_CURVE_VM_CARRIER:
+      *out_cond = curve->carrier_piece_cond;
+      *out_expr = curve->carrier_piece_expr;
+      *out_count = curve->carrier_piece_count;
+      *out_single = curve->has_carrier_expr ? curve->carrier_expr : 0;
+      *out_kind = "carrier";
+      break;
+    case SBX_CURVE_VM_AMP:
+      *out_cond = curve->amp_piece_cond;
+      *out_expr = curve->amp_piece_expr;
+      *out_count = curve->amp_piece_count;
+      *out_single = curve->has_amp_expr ? curve->amp_expr : 0;
+      *out_kind = "amp";
+      break;
+    case SBX_CURVE_VM_MIXAMP:
+      *out_cond = curve->mixamp_piece_cond;
+      *out_expr = curve->mixamp_piece_expr;
+      *out_count = curve->mixamp_piece_count;
+      *out_single = curve->has_mixamp_expr ? curve->mixamp_expr : 0;
+      *out_kind = "mixamp";
+      break;
+    default:
+      fx = &curve->mixfx_targets[target - SBX_CURVE_VM_MIXFX0];
+      *out_cond = fx->piece_cond;
+      *out_expr = fx->piece_expr;
+      *out_count = fx->piece_count;
+      *out_single = fx->has_expr ? fx->expr : 0;
+      *out_kind = sbx_curve_mixfx_target_names[target - SBX_CURVE_VM_MIXFX0];
+      break;
+  }
+  return *out_count > 0 || *out_single != 0;
+}
+
+typedef struct {
+  SbxCurveProgram *curve;
+  SbxCurveBakeLane *lane;
+  int target;
+  int knot_cap;
+  int coef_cap;
+  double tolerance;
+  double min_len;
+  double max_error;
+  size_t fallback_count;
+  int status;
+} SbxCurveBakeBuild;
+
+/* Exact raw value of the lane's target at t; 0 if it errors or is non-finite. */
+static int
+curve_bake_sample(SbxCurveBakeBuild *b, double t, double *out_value) {
+  te_expr *const *cond;
+  te_expr *const *expr;
+  const te_expr *single;
+  const char *kind;
+  int count, has = 0;
+  curve_target_trees(b->curve, b->target, &cond, &expr, &count, &single, &kind);
+  curve_set_eval_time(b->curve, t);
+  if (curve_eval_compiled(b->curve, 0, b->target, cond, expr, count, single,
+                          kind, &has, out_value) != SBX_OK)
+    return 0;
+  return has && isfinite(*out_value);
+}
+
+static void
+curve_bake_append(SbxCurveBakeBuild *b, double a, double e, const double *c) {
+  SbxCurveBakeLane *lane = b->lane;
+  if (b->status != SBX_OK) return;
+  if (!curve_vm_grow((void **)&lane->knot, &b->knot_cap, lane->count + 2, sizeof(double)) ||
+      !curve_vm_grow((void **)&lane->coef, &b->coef_cap, 4 * (lane->count + 1), sizeof(double))) {
+    b->status = SBX_ENOMEM;
+    return;
+  }
+  if (lane->count == 0) lane->knot[0] = a;
+  lane->knot[lane->count + 1] = e;
+  memcpy(lane->coef + 4 * lane->count, c, 4 * sizeof(double));
+  lane->count++;
+}
+
+/*
+ * Fits [a, e] with the cubic through four equally spaced samples and checks
+ * it at eight interior points between them; splits in half while the error
+ * exceeds the tolerance and the halves stay above min_len.
+ */
+static void
+curve_bake_fit(SbxCurveBakeBuild *b, double a, double e, int depth) {
+  double y[4], c[4];
+  double h = e - a;
+  double d1, d2, d3, err = 0.0;
+  int i, ok = 1;
+
+  if (b->status != SBX_OK) return;
+  for (i = 0; i < 4 && ok; i++)
+    ok = curve_bake_sample(b, i == 3 ? e : a + h * (double)i / 3.0, &y[i]);
+  if (ok) {
+    d1 = y[1] - y[0];
+    d2 = y[2] - 2.0 * y[1] + y[0];
+    d3 = y[3] - 3.0 * y[2] + 3.0 * y[1] - y[0];
+    c[0] = y[0];
+    c[1] = (d1 - d2 / 2.0 + d3 / 3.0) * 3.0 / h;
+    c[2] = (d2 / 2.0 - d3 / 2.0) * 9.0 / (h * h);
+    c[3] = (d3 / 6.0) * 27.0 / (h * h * h);
+    for (i = 0; i < 8 && ok; i++) {
+      double u = h * ((double)i + 0.5) / 8.0;
+      double v, fit;
+      ok = curve_bake_sample(b, a + u, &v);
+      fit = ((c[3] * u + c[2]) * u + c[1]) * u + c[0];
+      if (ok && fabs(fit - v) > err) err = fabs(fit - v);
     }
-    if (!matched)
-      amp_pct = te_eval(curve->amp_piece_expr[curve->amp_piece_count - 1]);
-  } else if (curve->has_amp_expr && curve->amp_expr) {
-    amp_pct = te_eval(curve->amp_expr);
   }
-  if (!isfinite(amp_pct)) amp_pct = curve->cfg.beat_amp0_pct;
-  if (amp_pct < 0.0) amp_pct = 0.0;
+  if ((!ok || err > b->tolerance) && h > 2.0 * b->min_len && depth < 64) {
+    double mid = a + h / 2.0;
+    curve_bake_fit(b, a, mid, depth + 1);
+    curve_bake_fit(b, mid, e, depth + 1);
+    return;
+  }
+  if (!ok) {
+    c[0] = NAN;
+    c[1] = c[2] = c[3] = 0.0;
+    b->fallback_count++;
+  } else if (err > b->max_error) {
+    b->max_error = err;
+  }
+  curve_bake_append(b, a, e, c);
+}
 
-  mixamp_pct = curve->cfg.mix_amp0_pct;
-  if (curve->mixamp_piece_count > 0) {
-    matched = 0;
-    for (i = 0; i < curve->mixamp_piece_count; i++) {
-      if (!curve->mixamp_piece_cond[i] || !curve->mixamp_piece_expr[i])
-        return curve_fail(curve, "Curve mixamp piece state is incomplete");
-      condv = te_eval(curve->mixamp_piece_cond[i]);
-      if (!isfinite(condv))
-        return curve_fail(curve, "Curve mixamp piece condition evaluated non-finite");
-      if (condv != 0.0) {
-        mixamp_pct = te_eval(curve->mixamp_piece_expr[i]);
-        matched = 1;
-        break;
-      }
+void
+sbx_curve_clear_bake(SbxCurveProgram *curve) {
+  if (!curve) return;
+  curve_bake_free(curve->bake);
+  curve->bake = 0;
+}
+
+int
+sbx_curve_bake(SbxCurveProgram *curve,
+               const SbxCurveBakeConfig *cfg_in,
+               SbxCurveBakeInfo *out_info) {
+  SbxCurveBakeConfig cfg;
+  SbxCurveBake *bake;
+  SbxCurveBakeBuild b;
+  te_expr *const *cond;
+  te_expr *const *expr;
+  const te_expr *single;
+  const char *kind;
+  double t0, t1;
+  size_t segments = 0;
+  int target, count, k, chunks;
+
+  if (!curve) return SBX_EINVAL;
+  if (!curve->prepared)
+    return curve_fail(curve, "Curve is not prepared for baking");
+  if (cfg_in) cfg = *cfg_in;
+  else sbx_default_curve_bake_config(&cfg);
+  if (!isfinite(cfg.t0_sec) || !isfinite(cfg.t1_sec) ||
+      !(cfg.tolerance > 0.0) || !(cfg.min_segment_sec > 0.0) ||
+      !(cfg.max_segment_sec >= cfg.min_segment_sec) || !isfinite(cfg.max_segment_sec))
+    return curve_fail(curve, "Invalid curve bake configuration");
+
+  t0 = cfg.t0_sec > 0.0 ? cfg.t0_sec : 0.0;
+  t1 = cfg.t1_sec;
+  if (!(t1 > t0)) {
+    t1 = (curve->cfg.total_min + (curve->cfg.wake_min > 0.0 ? curve->cfg.wake_min : 0.0)) * 60.0;
+    if (curve->cfg.beat_span_sec > t1) t1 = curve->cfg.beat_span_sec;
+    if (curve->cfg.carrier_span_sec > t1) t1 = curve->cfg.carrier_span_sec;
+  }
+  if (!(t1 > t0))
+    return curve_fail(curve, "Curve bake range is empty");
+
+  sbx_curve_clear_bake(curve);
+  bake = (SbxCurveBake *)calloc(1, sizeof(*bake));
+  if (!bake)
+    return curve_fail(curve, "Out of memory baking %s", curve->src_file);
+
+  memset(&b, 0, sizeof(b));
+  b.curve = curve;
+  b.tolerance = cfg.tolerance;
+  b.min_len = cfg.min_segment_sec;
+  b.status = SBX_OK;
+  chunks = (int)ceil((t1 - t0) / cfg.max_segment_sec);
+  if (chunks < 1) chunks = 1;
+  for (target = 0; target < SBX_CURVE_VM_TARGETS && b.status == SBX_OK; target++) {
+    if (!curve_target_trees(curve, target, &cond, &expr, &count, &single, &kind))
+      continue;
+    b.lane = &bake->lane[target];
+    b.target = target;
+    b.knot_cap = 0;
+    b.coef_cap = 0;
+    for (k = 0; k < chunks && b.status == SBX_OK; k++) {
+      double a = t0 + (t1 - t0) * (double)k / (double)chunks;
+      double e = (k == chunks - 1) ? t1 : t0 + (t1 - t0) * (double)(k + 1) / (double)chunks;
+      curve_bake_fit(&b, a, e, 0);
     }
-    if (!matched)
-      mixamp_pct = te_eval(curve->mixamp_piece_expr[curve->mixamp_piece_count - 1]);
-  } else if (curve->has_mixamp_expr && curve->mixamp_expr) {
-    mixamp_pct = te_eval(curve->mixamp_expr);
-  }
-  if (!isfinite(mixamp_pct)) mixamp_pct = curve->cfg.mix_amp0_pct;
-  if (mixamp_pct < 0.0) mixamp_pct = 0.0;
-
-  out_point->beat_hz = beat;
-  out_point->carrier_hz = carrier;
-  out_point->beat_amp_pct = amp_pct;
-  out_point->mix_amp_pct = mixamp_pct;
+    segments += (size_t)b.lane->count;
+  }
+  if (b.status != SBX_OK) {
+    curve_bake_free(bake);
+    return curve_fail(curve, "Out of memory baking %s", curve->src_file);
+  }
+
+  curve->bake = bake;
+  if (out_info) {
+    out_info->segment_count = segments;
+    out_info->fallback_segment_count = b.fallback_count;
+    out_info->max_error = b.max_error;
+  }
   curve->last_error[0] = 0;
   return SBX_OK;
 }
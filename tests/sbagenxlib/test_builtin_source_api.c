@@ -0,0 +1,188 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sbagenxlib.h"
+
+static void fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static int near(double a, double b, double eps) {
+  return fabs(a - b) <= eps;
+}
+
+static SbxContext *make_ctx(void) {
+  SbxEngineConfig cfg;
+  SbxContext *ctx;
+  sbx_default_engine_config(&cfg);
+  cfg.sample_rate = 44100.0;
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+  return ctx;
+}
+
+static void fill_start_tone(SbxToneSpec *tone) {
+  sbx_default_tone_spec(tone);
+  tone->mode = SBX_TONE_BINAURAL;
+  tone->carrier_hz = 205.0;
+  tone->beat_hz = 10.0;
+  tone->amplitude = 0.8;
+}
+
+static void expect_matches_curve(SbxContext *ctx, SbxCurveProgram *curve,
+                                 double t1_sec, const char *what) {
+  SbxToneSpec tones[97];
+  double ts[97];
+  SbxCurveEvalPoint pt;
+  size_t i;
+
+  if (sbx_context_sample_tones(ctx, 0.0, t1_sec, 97, ts, tones) != SBX_OK)
+    fail("sample native source failed");
+  for (i = 0; i < 97; i++) {
+    if (sbx_curve_eval(curve, ts[i], &pt) != SBX_OK) fail("curve eval failed");
+    if (!near(tones[i].beat_hz, pt.beat_hz, 1e-9) ||
+        !near(tones[i].carrier_hz, pt.carrier_hz, 1e-9)) {
+      fprintf(stderr, "%s mismatch at t=%g: native beat=%g carrier=%g, curve beat=%g carrier=%g\n",
+              what, ts[i], tones[i].beat_hz, tones[i].carrier_hz, pt.beat_hz, pt.carrier_hz);
+      fail("native source differs from curve program");
+    }
+  }
+}
+
+static void expect_matches_keyframes(SbxContext *ctx, const SbxProgramKeyframe *kfs,
+                                     size_t kf_count, double t1_sec, const char *what) {
+  SbxContext *kctx = make_ctx();
+  SbxToneSpec a[211], b[211];
+  size_t i;
+
+  if (sbx_context_load_keyframes(kctx, kfs, kf_count, 0) != SBX_OK)
+    fail("load reference keyframes failed");
+  /* Offset grid keeps samples off step boundaries. */
+  if (sbx_context_sample_tones(ctx, 0.37, t1_sec, 211, NULL, a) != SBX_OK ||
+      sbx_context_sample_tones(kctx, 0.37, t1_sec, 211, NULL, b) != SBX_OK)
+    fail("sample tones failed");
+  for (i = 0; i < 211; i++) {
+    if (!near(a[i].beat_hz, b[i].beat_hz, 1e-9) ||
+        !near(a[i].carrier_hz, b[i].carrier_hz, 1e-9) ||
+        !near(a[i].amplitude, b[i].amplitude, 1e-9)) {
+      fprintf(stderr, "%s mismatch at sample %u: native %g/%g/%g, keyframes %g/%g/%g\n",
+              what, (unsigned)i, a[i].carrier_hz, a[i].beat_hz, a[i].amplitude,
+              b[i].carrier_hz, b[i].beat_hz, b[i].amplitude);
+      fail("native source differs from keyframes");
+    }
+  }
+  sbx_context_destroy(kctx);
+}
+
+static void expect_seek_continuity(SbxContext *ctx, double seek_sec) {
+  enum { BLOCK = 4410, PROBE = 256 };
+  static float cont[BLOCK * 2];
+  float seek[PROBE * 2];
+  size_t blocks = (size_t)(seek_sec * 44100.0 + 0.5) / BLOCK;
+  size_t i;
+
+  if (sbx_context_set_time_sec(ctx, 0.0) != SBX_OK) fail("rewind failed");
+  for (i = 0; i < blocks; i++) {
+    if (sbx_context_render_f32(ctx, cont, BLOCK) != SBX_OK) fail("render failed");
+  }
+  if (sbx_context_render_f32(ctx, cont, PROBE) != SBX_OK) fail("render failed");
+  if (sbx_context_set_time_sec(ctx, (double)(blocks * BLOCK) / 44100.0) != SBX_OK)
+    fail("seek failed");
+  if (sbx_context_render_f32(ctx, seek, PROBE) != SBX_OK) fail("render after seek failed");
+  for (i = 0; i < PROBE * 2; i++) {
+    if (!near(cont[i], seek[i], 2e-3)) {
+      fprintf(stderr, "sample %u: continuous=%g seek=%g\n", (unsigned)i, cont[i], seek[i]);
+      fail("seek does not restore analytic oscillator phase");
+    }
+  }
+}
+
+int main(void) {
+  SbxBuiltinDropConfig drop_cfg;
+  SbxBuiltinSigmoidConfig sig_cfg;
+  SbxBuiltinSlideConfig slide_cfg;
+  SbxProgramKeyframe *kfs = NULL;
+  size_t kf_count = 0;
+  SbxCurveProgram *curve = NULL;
+  SbxContext *ctx = make_ctx();
+
+  sbx_default_builtin_drop_config(&drop_cfg);
+  fill_start_tone(&drop_cfg.start_tone);
+  drop_cfg.carrier_end_hz = 200.0;
+  drop_cfg.beat_target_hz = 2.5;
+  drop_cfg.drop_sec = 600;
+  drop_cfg.hold_sec = 120;
+  drop_cfg.wake_sec = 60;
+  drop_cfg.slide = 1;
+  drop_cfg.step_len_sec = 60;
+  drop_cfg.fade_sec = 2.5;
+
+  if (sbx_context_load_builtin_drop(ctx, &drop_cfg) != SBX_OK)
+    fail("sbx_context_load_builtin_drop failed");
+  if (sbx_context_source_mode(ctx) != SBX_SOURCE_BUILTIN)
+    fail("native drop should report SBX_SOURCE_BUILTIN");
+  if (sbx_context_keyframe_count(ctx) != 0)
+    fail("native drop should not materialize keyframes");
+  if (!near(sbx_context_duration_sec(ctx), 782.5, 1e-12))
+    fail("native drop duration mismatch");
+  if (sbx_build_drop_curve_program(&drop_cfg, &curve) != SBX_OK)
+    fail("sbx_build_drop_curve_program failed");
+  expect_matches_curve(ctx, curve, 780.0, "drop slide");
+  sbx_curve_destroy(curve);
+  expect_seek_continuity(ctx, 30.0);
+
+  drop_cfg.slide = 0;
+  if (sbx_context_load_builtin_drop(ctx, &drop_cfg) != SBX_OK)
+    fail("stepped native drop load failed");
+  if (sbx_build_drop_keyframes(&drop_cfg, &kfs, &kf_count) != SBX_OK)
+    fail("sbx_build_drop_keyframes failed");
+  expect_matches_keyframes(ctx, kfs, kf_count, 790.0, "drop stepped");
+  free(kfs);
+  kfs = NULL;
+  expect_seek_continuity(ctx, 70.0);
+
+  sbx_default_builtin_sigmoid_config(&sig_cfg);
+  fill_start_tone(&sig_cfg.start_tone);
+  sig_cfg.carrier_end_hz = 200.0;
+  sig_cfg.beat_target_hz = 2.5;
+  sig_cfg.drop_sec = 1800;
+  sig_cfg.hold_sec = 0;
+  sig_cfg.wake_sec = 0;
+  sig_cfg.slide = 1;
+  sig_cfg.step_len_sec = 60;
+  sig_cfg.fade_sec = 0.0;
+  sig_cfg.sig_l = 0.125;
+  sig_cfg.sig_h = 0.0;
+  if (sbx_context_load_builtin_sigmoid(ctx, &sig_cfg) != SBX_OK)
+    fail("sbx_context_load_builtin_sigmoid failed");
+  if (sbx_build_sigmoid_curve_program(&sig_cfg, &curve) != SBX_OK)
+    fail("sbx_build_sigmoid_curve_program failed");
+  expect_matches_curve(ctx, curve, 1800.0, "sigmoid slide");
+  sbx_curve_destroy(curve);
+  expect_seek_continuity(ctx, 45.0);
+
+  sbx_default_builtin_slide_config(&slide_cfg);
+  fill_start_tone(&slide_cfg.start_tone);
+  slide_cfg.carrier_end_hz = 150.0;
+  slide_cfg.slide_sec = 300;
+  slide_cfg.fade_sec = 5.0;
+  if (sbx_context_load_builtin_slide(ctx, &slide_cfg) != SBX_OK)
+    fail("sbx_context_load_builtin_slide failed");
+  if (sbx_build_slide_keyframes(&slide_cfg, &kfs, &kf_count) != SBX_OK)
+    fail("sbx_build_slide_keyframes failed");
+  expect_matches_keyframes(ctx, kfs, kf_count, 310.0, "slide");
+  free(kfs);
+  expect_seek_continuity(ctx, 20.0);
+
+  drop_cfg.drop_sec = 0;
+  if (sbx_context_load_builtin_drop(ctx, &drop_cfg) != SBX_EINVAL)
+    fail("invalid drop config should be rejected");
+  if (sbx_context_source_mode(ctx) != SBX_SOURCE_BUILTIN)
+    fail("rejected load should keep the previous source");
+
+  sbx_context_destroy(ctx);
+  printf("PASS: native built-in drop/sigmoid/slide sources\n");
+  return 0;
+}
@@ -0,0 +1,234 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static SbxContext *
+make_ctx(double rate) {
+  SbxEngineConfig cfg;
+  SbxContext *ctx;
+  sbx_default_engine_config(&cfg);
+  cfg.sample_rate = rate;
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+  return ctx;
+}
+
+static float *
+render(SbxContext *ctx, size_t frames) {
+  float *buf = (float *)calloc(frames * 2, sizeof(float));
+  if (!buf) fail("alloc failed (render)");
+  if (sbx_context_render_f32(ctx, buf, frames) != SBX_OK)
+    fail("render failed");
+  return buf;
+}
+
+static int
+tone_equal(const SbxToneSpec *a, const SbxToneSpec *b) {
+  return a->mode == b->mode && a->carrier_hz == b->carrier_hz && a->beat_hz == b->beat_hz &&
+         a->orbit_hz == b->orbit_hz && a->orbit_distance_m == b->orbit_distance_m &&
+         a->orbit_envelope_mode == b->orbit_envelope_mode && a->amplitude == b->amplitude &&
+         a->waveform == b->waveform && a->envelope_waveform == b->envelope_waveform &&
+         a->noise_waveform == b->noise_waveform && a->duty_cycle == b->duty_cycle &&
+         a->iso_start == b->iso_start && a->iso_attack == b->iso_attack &&
+         a->iso_release == b->iso_release && a->iso_edge_mode == b->iso_edge_mode;
+}
+
+static unsigned char *
+read_file(const char *path, size_t *out_len) {
+  FILE *fp = fopen(path, "rb");
+  unsigned char *data;
+  long n;
+  if (!fp) fail("cannot reopen compiled program");
+  fseek(fp, 0, SEEK_END);
+  n = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data = (unsigned char *)malloc((size_t)n + 1);
+  if (!data || fread(data, 1, (size_t)n, fp) != (size_t)n) fail("cannot read compiled program");
+  fclose(fp);
+  *out_len = (size_t)n;
+  return data;
+}
+
+static void
+write_file(const char *path, const unsigned char *data, size_t len) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp || fwrite(data, 1, len, fp) != len) fail("cannot write temp file");
+  fclose(fp);
+}
+
+int
+main(void) {
+  const char *text =
+      "wave00: 0 1 0 0.25\n"
+      "custom00: e=2 0 0.2 1 0.2 0\n"
+      "spin00: e=0 0 0 100 100 -100 -100\n"
+      "noise00: 12 12 11 11 10 10 9 8 7 6 5 4 3 2 1 0 -1 -2 -3 -4 -5 -6 -7 -8 -9 -10 -11 -12 -12 -12 -12 -12\n"
+      "off: -\n"
+      "duo: wave00:180+2/20 custom00:220@4/15\n"
+      "wash: mix/60 custom00:triangle:spin00:mixspin:350+3/25 spin00:noise00:spin:300+1/20\n"
+      "burst: {\n"
+      "  +00:00 off ==\n"
+      "  +00:00:01 duo ->\n"
+      "}\n"
+      "NOW burst\n"
+      "+00:00:02 wash ==\n"
+      "+00:00:03 mix/80 duo\n";
+  const char *preamble = "-SE\n-w triangle\n";
+  const char *path = "/tmp/sbagenxlib_compiled_test.sbgc";
+  const char *bad_path = "/tmp/sbagenxlib_compiled_bad.sbgc";
+  const size_t frames = 44100 * 4;
+  SbxContext *src, *dst;
+  float *a, *b;
+  unsigned char *data;
+  size_t len, i;
+  char *pre = 0;
+  char err[256];
+  SbxProgramKeyframe ka, kb;
+
+  src = make_ctx(44100.0);
+  if (sbx_context_load_sbg_timing_text(src, text, 0) != SBX_OK)
+    fail(sbx_context_last_error(src));
+  if (sbx_context_save_compiled(src, path, preamble) != SBX_OK)
+    fail("sbx_context_save_compiled failed");
+
+  dst = make_ctx(44100.0);
+  if (sbx_context_load_compiled(dst, path, 0) != SBX_OK)
+    fail(sbx_context_last_error(dst));
+  if (sbx_context_keyframe_count(dst) != sbx_context_keyframe_count(src))
+    fail("compiled keyframe count mismatch");
+  if (sbx_context_voice_count(dst) != sbx_context_voice_count(src) ||
+      sbx_context_voice_count(dst) < 2)
+    fail("compiled voice count mismatch");
+  if (!sbx_context_has_mix_amp_control(dst) || !sbx_context_has_mix_effects(dst))
+    fail("compiled program lost its mix keyframes");
+  if (fabs(sbx_context_duration_sec(dst) - sbx_context_duration_sec(src)) > 1e-12)
+    fail("compiled duration mismatch");
+  for (i = 0; i < sbx_context_keyframe_count(src); i++) {
+    if (sbx_context_get_keyframe_voice(src, i, 1, &ka) != SBX_OK ||
+        sbx_context_get_keyframe_voice(dst, i, 1, &kb) != SBX_OK ||
+        !tone_equal(&ka.tone, &kb.tone) || ka.time_sec != kb.time_sec)
+      fail("compiled secondary voice keyframe mismatch");
+  }
+
+  a = render(src, frames);
+  b = render(dst, frames);
+  if (memcmp(a, b, frames * 2 * sizeof(float)) != 0)
+    fail("compiled program should render identically to its source");
+  free(a);
+  free(b);
+
+  if (sbx_compiled_read_preamble(path, &pre, err, sizeof(err)) != SBX_OK)
+    fail(err);
+  if (strcmp(pre, preamble) != 0) fail("compiled preamble mismatch");
+  free(pre);
+
+  /* In-memory load, then damaged copies. */
+  data = read_file(path, &len);
+  sbx_context_destroy(dst);
+  dst = make_ctx(44100.0);
+  if (sbx_context_load_compiled_memory(dst, data, len, 1) != SBX_OK)
+    fail("sbx_context_load_compiled_memory failed");
+  if (!sbx_context_is_looping(dst)) fail("compiled load should honor loop flag");
+  if (sbx_context_load_compiled_memory(dst, data, len - 9, 0) != SBX_EINVAL)
+    fail("truncated compiled program should be rejected");
+  for (i = 0; i < len; i += len / 97 + 1) {
+    /* Truncations anywhere must fail cleanly rather than read past the end. */
+    if (sbx_context_load_compiled_memory(dst, data, i, 0) == SBX_OK)
+      fail("prefix of compiled program should be rejected");
+  }
+  data[0] ^= 0x55;
+  write_file(bad_path, data, len);
+  if (sbx_context_load_compiled(dst, bad_path, 0) != SBX_EINVAL)
+    fail("bad magic should be rejected");
+  if (!strstr(sbx_context_last_error(dst), "not a compiled"))
+    fail("bad magic error message mismatch");
+  if (sbx_compiled_read_preamble(bad_path, &pre, err, sizeof(err)) != SBX_EINVAL)
+    fail("bad magic should be rejected when reading the preamble");
+  data[0] ^= 0x55;
+  data[8] = 99;
+  if (sbx_context_load_compiled_memory(dst, data, len, 0) != SBX_EINVAL)
+    fail("unknown compiled version should be rejected");
+  data[8] = 1;
+  if (sbx_context_load_compiled_memory(dst, data, len, 0) != SBX_OK)
+    fail("restored compiled program should load");
+
+  /* Damaged values with an intact layout must not reach the engine. */
+  {
+    size_t pre_len = (size_t)data[56] | ((size_t)data[57] << 8);
+    size_t nkf = (size_t)data[32] | ((size_t)data[33] << 8);
+    size_t kf0 = 64 + pre_len;
+    size_t tone0 = kf0 + nkf * 10;
+    size_t tones_end = tone0 + (size_t)data[24] * nkf * 96;
+    static const struct { size_t at; unsigned char set; const char *what; } hits[] = {
+      {11, 0x7f, "huge carrier"},       /* tone 0 carrier exponent byte */
+      {11, 0xff, "non-finite carrier"},
+      {0, 99, "bad tone mode"},
+      {67, 0x7f, "huge duty cycle"},    /* tone 0 duty_cycle exponent byte */
+    };
+    float buf[882];
+    unsigned char keep;
+    size_t k;
+    for (k = 0; k < sizeof(hits) / sizeof(hits[0]); k++) {
+      keep = data[tone0 + hits[k].at];
+      data[tone0 + hits[k].at] = hits[k].set;
+      if (sbx_context_load_compiled_memory(dst, data, len, 0) != SBX_EINVAL)
+        fail(hits[k].what);
+      data[tone0 + hits[k].at] = keep;
+    }
+    keep = data[kf0 + 10 + 7];
+    data[kf0 + 10 + 7] |= 0x80;
+    if (sbx_context_load_compiled_memory(dst, data, len, 0) != SBX_EINVAL)
+      fail("negative keyframe time should be rejected");
+    data[kf0 + 10 + 7] = keep;
+    data[16 + 7] |= 0x80;
+    if (sbx_context_load_compiled_memory(dst, data, len, 0) != SBX_EINVAL)
+      fail("negative sample rate should be rejected");
+    data[16 + 7] &= 0x7f;
+
+    /* Any single bit flip before the tables either fails or plays. */
+    for (i = 8; i < tones_end && i < len; i++) {
+      keep = data[i];
+      data[i] ^= (unsigned char)(1u << (i % 8));
+      if (sbx_context_load_compiled_memory(dst, data, len, 0) == SBX_OK &&
+          sbx_context_render_f32(dst, buf, 441) != SBX_OK)
+        fail("accepted bit flip should render");
+      data[i] = keep;
+    }
+  }
+  remove(bad_path);
+  free(data);
+
+  /* Noise FIRs are rate specific. */
+  sbx_context_destroy(dst);
+  dst = make_ctx(48000.0);
+  if (sbx_context_load_compiled(dst, path, 0) != SBX_EINVAL)
+    fail("noise profiles compiled at 44100 Hz should not load at 48000 Hz");
+
+  {
+    SbxToneSpec tone;
+    memset(&tone, 0, sizeof(tone));
+    tone.mode = SBX_TONE_BINAURAL;
+    tone.carrier_hz = 200.0;
+    tone.beat_hz = 4.0;
+    tone.amplitude = 0.2;
+    if (sbx_context_set_tone(src, &tone) != SBX_OK)
+      fail("static tone load failed");
+    if (sbx_context_save_compiled(src, path, 0) != SBX_EINVAL)
+      fail("only keyframe programs should compile");
+  }
+
+  remove(path);
+  sbx_context_destroy(dst);
+  sbx_context_destroy(src);
+  printf("PASS: sbagenxlib compiled program API checks\n");
+  return 0;
+}
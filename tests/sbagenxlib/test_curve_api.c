@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdlib.h>
 
 #include "sbagenxlib.h"
@@ -15,6 +16,460 @@ near(double a, double b, double eps) {
   return fabs(a - b) <= eps;
 }
 
+static double
+ref_ramp(double x, double x0, double x1) {
+  double u;
+  if (x1 == x0) return x >= x1 ? 1.0 : 0.0;
+  u = (x - x0) / (x1 - x0);
+  return u < 0.0 ? 0.0 : (u > 1.0 ? 1.0 : u);
+}
+
+static double
+ref_smoothstep(double e0, double e1, double x) {
+  double u = ref_ramp(x, e0, e1);
+  return u * u * (3.0 - 2.0 * u);
+}
+
+static double
+ref_smootherstep(double e0, double e1, double x) {
+  double u = ref_ramp(x, e0, e1);
+  return u * u * u * (u * (u * 6.0 - 15.0) + 10.0);
+}
+
+static double
+ref_seg(double x, double x0, double x1, double y0, double y1) {
+  if (x <= x0) return y0;
+  if (x >= x1) return y1;
+  return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+}
+
+/* Every helper and operator the compiled evaluator lowers to an opcode. */
+static const char *ops_curve_text =
+  "param k = 3\n"
+  "beat = 4 + 2*sin(t/7) - (k % 2) + max2(1, min2(2, t/100))"
+  " + ifelse(gt(t,50),1,-1)*step(t-20) + (t, 0.5)\n"
+  "carrier = clamp(200 + lerp(-5, 5, smootherstep(0, 600, t)), 250, 150)"
+  " + between(t, 20, 10) + pulse(t, 30, 40) + ne(t,35) - ge(t,35) + le(t,35) - lt(t,35)\n"
+  "amp<2 = 80 + eq(t,0)*10\n"
+  "amp<4 = 70 - -t/1000\n"
+  "amp>=1e9 = 1\n"
+  "mixamp = seg(t, 100, 200, 20, 40) + ramp(t, 0, 50)*smoothstep(0, 1, ramp(t, 0, 50)) + 2^3\n";
+
+/* Targets sharing time-dependent and parameter-only subexpressions. */
+static const char *shared_curve_text =
+  "param w = 2\n"
+  "beat = 3 + 4*ramp(m, 0, T) + w*w/8\n"
+  "carrier = 200 + 10*ramp(m, 0, T) + w*w/8\n"
+  "amp = 50 + 20*ramp(m, 0, T)*ramp(m, 0, T)\n";
+
+static void
+check_shared_curve(SbxCurveProgram *curve) {
+  static const double times[] = { 600.0, 0.0, 600.0, 600.0, 1800.0, 4000.0, 1800.0 };
+  SbxCurveEvalPoint pt;
+  SbxCurveVmStats vs;
+  size_t i;
+  int rc, pass;
+
+  rc = sbx_curve_load_text(curve, shared_curve_text, "<shared>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  if (sbx_curve_get_vm_stats(curve, &vs) != SBX_EINVAL)
+    fail("VM stats should need a prepared curve");
+  for (pass = 0; pass < 2; pass++) {
+    double w = pass ? 4.0 : 2.0;
+    if (pass) {
+      rc = sbx_curve_set_param(curve, "w", w);
+      if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    }
+    rc = sbx_curve_prepare(curve, 0);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    /*
+     * 17 operators as written. w*w/8 folds away and ramp(m, 0, T) runs once
+     * in the prelude, leaving 3 per target plus the shared ramp.
+     */
+    if (sbx_curve_get_vm_stats(curve, &vs) != SBX_OK) fail("sbx_curve_get_vm_stats failed");
+    if (vs.tree_op_count != 17 || vs.vm_op_count != 10 || vs.shared_count != 1)
+      fail("folded program should run 10 of 17 operators");
+    /* Repeated and alternating times exercise the per-time shared values. */
+    for (i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+      double u = ref_ramp(times[i] / 60.0, 0.0, 60.0);
+      rc = sbx_curve_eval(curve, times[i], &pt);
+      if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+      if (!near(pt.beat_hz, 3.0 + 4.0 * u + w * w / 8.0, 1e-12))
+        fail("shared-subexpression beat mismatch");
+      if (!near(pt.carrier_hz, 200.0 + 10.0 * u + w * w / 8.0, 1e-12))
+        fail("shared-subexpression carrier mismatch");
+      if (!near(pt.beat_amp_pct, 50.0 + 20.0 * u * u, 1e-12))
+        fail("shared-subexpression amp mismatch");
+    }
+  }
+}
+
+static void
+check_ops_curve(SbxCurveProgram *curve) {
+  static const double times[] = { 0.0, 15.0, 35.0, 75.0, 150.0, 200.0, 300.0, 900.0 };
+  SbxCurveEvalPoint pt;
+  size_t i;
+  int rc;
+
+  rc = sbx_curve_load_text(curve, ops_curve_text, "<ops>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, 0);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+    double t = times[i];
+    double m = t / 60.0;
+    double beat, carrier, amp, mixamp, c;
+    beat = 4.0 + 2.0 * sin(t / 7.0) - fmod(3.0, 2.0) +
+           fmax(1.0, fmin(2.0, t / 100.0)) +
+           (t > 50.0 ? 1.0 : -1.0) * (t - 20.0 >= 0.0 ? 1.0 : 0.0) + 0.5;
+    c = 200.0 + (-5.0 + 10.0 * ref_smootherstep(0.0, 600.0, t));
+    c = c < 150.0 ? 150.0 : (c > 250.0 ? 250.0 : c);
+    carrier = c + ((t >= 10.0 && t <= 20.0) ? 1.0 : 0.0) +
+              ((t >= 30.0 && t <= 40.0) ? 1.0 : 0.0) +
+              (t != 35.0) - (t >= 35.0) + (t <= 35.0) - (t < 35.0);
+    if (m < 2.0) amp = 80.0 + (t == 0.0 ? 10.0 : 0.0);
+    else if (m < 4.0) amp = 70.0 + t / 1000.0;
+    else amp = 1.0;
+    mixamp = ref_seg(t, 100.0, 200.0, 20.0, 40.0) +
+             ref_ramp(t, 0.0, 50.0) * ref_smoothstep(0.0, 1.0, ref_ramp(t, 0.0, 50.0)) + 8.0;
+    rc = sbx_curve_eval(curve, t, &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (!near(pt.beat_hz, beat, 1e-12)) fail("compiled curve beat mismatch");
+    if (!near(pt.carrier_hz, carrier, 1e-12)) fail("compiled curve carrier mismatch");
+    if (!near(pt.beat_amp_pct, amp, 1e-12)) fail("compiled curve piecewise amp mismatch");
+    if (!near(pt.mix_amp_pct, mixamp, 1e-12)) fail("compiled curve mixamp mismatch");
+  }
+}
+
+/* Every point target folds to a constant: defaults, clamps and the carrier ramp still apply. */
+static void
+check_const_curve(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg) {
+  static const double times[] = { 0.0, 60.0, 900.0, 1800.0 };
+  SbxCurveEvalPoint pt;
+  size_t i;
+  int rc;
+
+  rc = sbx_curve_load_text(curve, "param k = 2\nbeat = 3 + k\namp = k - 5\n", "<const>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+    double t = times[i];
+    rc = sbx_curve_eval(curve, t, &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (pt.beat_hz != 5.0) fail("constant curve beat mismatch");
+    if (!near(pt.carrier_hz, cfg->carrier_start_hz + (cfg->carrier_end_hz - cfg->carrier_start_hz) *
+                             (t / cfg->carrier_span_sec), 1e-12))
+      fail("constant curve should keep the carrier ramp");
+    if (pt.beat_amp_pct != 0.0) fail("constant curve amp should clamp at zero");
+    if (pt.mix_amp_pct != cfg->mix_amp0_pct) fail("constant curve mixamp default mismatch");
+  }
+  rc = sbx_curve_set_param(curve, "k", 7.0);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_eval(curve, 60.0, &pt);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  if (pt.beat_hz != 10.0 || pt.beat_amp_pct != 2.0)
+    fail("constant curve re-prepare kept stale values");
+
+  rc = sbx_curve_load_text(curve, "beat = 0/0\n", "<nan>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  if (sbx_curve_eval(curve, 0.0, &pt) == SBX_OK)
+    fail("constant non-finite beat should fail evaluation");
+}
+
+static void
+check_bake_curve(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg) {
+  SbxCurveBakeConfig bcfg;
+  SbxCurveBakeInfo binfo;
+  SbxCurveEvalPoint exact[181], pt;
+  int i, rc;
+
+  rc = sbx_curve_load_file(curve, "examples/basics/curve-sigmoid-like.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i <= 180; i++) {
+    rc = sbx_curve_eval(curve, 10.0 * i + 0.37, &exact[i]);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  }
+
+  sbx_default_curve_bake_config(&bcfg);
+  bcfg.tolerance = 1e-6;
+  rc = sbx_curve_bake(curve, &bcfg, &binfo);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  if (binfo.segment_count == 0 || binfo.fallback_segment_count != 0)
+    fail("baked curve segment counts unexpected");
+  if (!(binfo.max_error <= bcfg.tolerance))
+    fail("baked curve reported error above tolerance");
+  for (i = 0; i <= 180; i++) {
+    rc = sbx_curve_eval(curve, 10.0 * i + 0.37, &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (!near(pt.beat_hz, exact[i].beat_hz, 10.0 * bcfg.tolerance) ||
+        !near(pt.carrier_hz, exact[i].carrier_hz, 10.0 * bcfg.tolerance))
+      fail("baked curve deviates from exact evaluation");
+  }
+
+  /* Clearing the bake restores exact evaluation. */
+  sbx_curve_clear_bake(curve);
+  for (i = 0; i <= 180; i++) {
+    rc = sbx_curve_eval(curve, 10.0 * i + 0.37, &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (pt.beat_hz != exact[i].beat_hz || pt.carrier_hz != exact[i].carrier_hz)
+      fail("cleared bake should restore exact evaluation");
+  }
+  bcfg.tolerance = 0.0;
+  if (sbx_curve_bake(curve, &bcfg, &binfo) != SBX_EINVAL)
+    fail("zero bake tolerance should be rejected");
+}
+
+static void
+check_eval_batch(SbxCurveProgram *curve) {
+  double ts[64];
+  SbxCurveEvalPoint a[64], b[64], pt;
+  SbxCurveEvalState *sa, *sb;
+  int i, rc;
+
+  rc = sbx_curve_load_text(curve, shared_curve_text, "<shared>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, 0);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i < 64; i++)
+    ts[i] = (i % 3 == 0) ? 4000.0 - 50.0 * i : 61.0 * i;
+
+  sa = sbx_curve_eval_state_create();
+  sb = sbx_curve_eval_state_create();
+  if (!sa || !sb) fail("sbx_curve_eval_state_create failed");
+  if (sbx_curve_eval_batch(curve, sa, ts, 0, 0) != SBX_OK)
+    fail("empty batch should succeed");
+  /* Interleave two states and the program's own frame on one program. */
+  for (i = 0; i < 64; i += 16) {
+    rc = sbx_curve_eval_batch(curve, sa, ts + i, 16, a + i);
+    if (rc != SBX_OK) fail(sbx_curve_eval_state_last_error(sa));
+    rc = sbx_curve_eval(curve, 1234.5, &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    rc = sbx_curve_eval_batch(curve, sb, ts + 63 - i - 15, 16, b + 63 - i - 15);
+    if (rc != SBX_OK) fail(sbx_curve_eval_state_last_error(sb));
+  }
+  for (i = 0; i < 64; i++) {
+    rc = sbx_curve_eval(curve, ts[i], &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (memcmp(&pt, &a[i], sizeof(pt)) != 0 || memcmp(&pt, &b[i], sizeof(pt)) != 0)
+      fail("batch evaluation differs from sbx_curve_eval");
+  }
+
+  /* A state follows its program across re-prepares. */
+  rc = sbx_curve_set_param(curve, "w", 6.0);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  if (sbx_curve_eval_batch(curve, sa, ts, 1, a) != SBX_EINVAL)
+    fail("batch on unprepared curve should fail");
+  if (!*sbx_curve_eval_state_last_error(sa))
+    fail("batch failure should set the state error");
+  rc = sbx_curve_prepare(curve, 0);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_eval_batch(curve, sa, ts, 64, a);
+  if (rc != SBX_OK) fail(sbx_curve_eval_state_last_error(sa));
+  for (i = 0; i < 64; i++) {
+    rc = sbx_curve_eval(curve, ts[i], &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (memcmp(&pt, &a[i], sizeof(pt)) != 0)
+      fail("batch evaluation after re-prepare differs from sbx_curve_eval");
+  }
+  sbx_curve_eval_state_destroy(sa);
+  sbx_curve_eval_state_destroy(sb);
+}
+
+/*
+ * Many pieces with unsorted, repeated and overlapping thresholds, so the
+ * first matching piece is not simply the nearest breakpoint.
+ */
+static void
+check_interval_curve(SbxCurveProgram *curve) {
+  static const int thresholds[] = { 5, 2, 9, 2, 14, 30, 7, 21, 30, 3, 40, 11 };
+  const int count = (int)(sizeof(thresholds) / sizeof(thresholds[0]));
+  char text[2048];
+  size_t len = 0;
+  SbxCurveEvalPoint pt;
+  int i, rc;
+
+  for (i = 0; i < count; i++)
+    len += (size_t)snprintf(text + len, sizeof(text) - len, "beat%s%d = %d\n",
+                            (i % 3 == 2) ? "<=" : "<", thresholds[i], 100 + i);
+  len += (size_t)snprintf(text + len, sizeof(text) - len, "beat>=45 = 1\n");
+  rc = sbx_curve_load_text(curve, text, "<interval>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, 0);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i <= 4 * 50; i++) {
+    double m = i / 4.0;
+    double want = 1.0;
+    int p;
+    for (p = 0; p < count; p++) {
+      int le = (p % 3 == 2);
+      if (le ? (m <= thresholds[p]) : (m < thresholds[p])) {
+        want = 100 + p;
+        break;
+      }
+    }
+    rc = sbx_curve_eval(curve, m * 60.0, &pt);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (pt.beat_hz != want) fail("interval piece dispatch picked the wrong piece");
+  }
+}
+
+static const char *reprepare_curve_text =
+  "param l = 0.15\n"
+  "param k = 1\n"
+  "solve A,C : A*exp(-l*0)+C=b0 ; A*exp(-l*D)+C=b1\n"
+  "beat = A*exp(-l*m) + C\n"
+  "carrier = c0 + k*ramp(m, 0, T)\n";
+
+/* Re-prepare after set_param must match a fresh prepare with the same values. */
+static void
+check_reprepare_curve(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg) {
+  static const double times[] = { 0.0, 300.0, 900.0, 1800.0 };
+  static const struct { const char *name; double value; } steps[] = {
+    { "k", 2.0 }, { "l", 0.3 }, { "l", 0.05 }, { "k", -1.0 }
+  };
+  SbxCurveProgram *fresh = sbx_curve_create();
+  SbxCurveEvalPoint a, b;
+  size_t i, j, k;
+  int rc;
+
+  if (!fresh) fail("sbx_curve_create failed");
+  rc = sbx_curve_load_text(curve, reprepare_curve_text, "<reprepare>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+    rc = sbx_curve_set_param(curve, steps[i].name, steps[i].value);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+    if (sbx_curve_eval(curve, 0.0, &a) == SBX_OK)
+      fail("set_param should require a new prepare");
+    rc = sbx_curve_prepare(curve, cfg);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+
+    rc = sbx_curve_load_text(fresh, reprepare_curve_text, "<reprepare>.sbgf");
+    if (rc != SBX_OK) fail(sbx_curve_last_error(fresh));
+    for (k = 0; k <= i; k++) {
+      rc = sbx_curve_set_param(fresh, steps[k].name, steps[k].value);
+      if (rc != SBX_OK) fail(sbx_curve_last_error(fresh));
+    }
+    rc = sbx_curve_prepare(fresh, cfg);
+    if (rc != SBX_OK) fail(sbx_curve_last_error(fresh));
+    for (j = 0; j < sizeof(times) / sizeof(times[0]); j++) {
+      rc = sbx_curve_eval(curve, times[j], &a);
+      if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+      rc = sbx_curve_eval(fresh, times[j], &b);
+      if (rc != SBX_OK) fail(sbx_curve_last_error(fresh));
+      if (!near(a.beat_hz, b.beat_hz, 1e-9) || !near(a.carrier_hz, b.carrier_hz, 1e-12))
+        fail("incremental re-prepare differs from a fresh prepare");
+    }
+    if (!near(a.beat_hz, cfg->beat_target_hz, 1e-6))
+      fail("re-solved curve misses its end boundary");
+  }
+  sbx_curve_destroy(fresh);
+}
+
+/* Ten coupled unknowns, a singular start Jacobian, and a multi-start rescue. */
+static void
+check_solver_curve(SbxCurveProgram *curve, const SbxCurveEvalConfig *cfg) {
+  static const char *chain_text =
+    "solve u0,u1,u2,u3,u4,u5,u6,u7,u8,u9 : "
+    "u0+0.3*sin(u1)=1 ; u1+0.3*sin(u2)=2 ; u2+0.3*sin(u3)=3 ; u3+0.3*sin(u4)=4 ; "
+    "u4+0.3*sin(u5)=5 ; u5+0.3*sin(u6)=6 ; u6+0.3*sin(u7)=7 ; u7+0.3*sin(u8)=8 ; "
+    "u8+0.3*sin(u9)=9 ; u9+0.3*exp(-u0)=10\n"
+    "beat = b0 + (b1 - b0)*ramp(m, 0, D) + 0*u9\n";
+  static const char *singular_text =
+    "param p = 1\n"
+    "param q = -1\n"
+    "solve p,q : p*q=1 ; p-q=0\n"
+    "beat = b0 + 0*p\n";
+  static const char *cycle_text =
+    "solve p : p*p*p - 2*p + 2 = 0\n"
+    "beat = b0 + 0*p\n";
+  static const char *root_text =
+    "param p = 3\n"
+    "solve p : p*p = 2\n"
+    "beat = b0 + 0*p\n";
+  SbxCurveSolveConfig sc;
+  SbxCurveEvalPoint pt;
+  double a[10];
+  const char *name;
+  size_t i;
+  int rc;
+
+  rc = sbx_curve_load_text(curve, chain_text, "<chain>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  for (i = 0; i < 10; i++) {
+    rc = sbx_curve_get_param(curve, i, &name, &a[i]);
+    if (rc != SBX_OK) fail("sbx_curve_get_param failed for chain unknown");
+  }
+  for (i = 0; i < 9; i++)
+    if (!near(a[i] + 0.3 * sin(a[i + 1]), (double)(i + 1), 1e-8))
+      fail("ten-unknown solve residual too large");
+  if (!near(a[9] + 0.3 * exp(-a[0]), 10.0, 1e-8))
+    fail("ten-unknown solve residual too large");
+
+  /* det J = -(p + q) is zero at the start; LM steps take over. */
+  rc = sbx_curve_load_text(curve, singular_text, "<singular>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  sbx_curve_get_param(curve, 0, &name, &a[0]);
+  sbx_curve_get_param(curve, 1, &name, &a[1]);
+  if (!near(a[0] * a[1], 1.0, 1e-8) || !near(a[0], a[1], 1e-8))
+    fail("singular-start solve did not reach a root");
+
+  /* Newton from p = 0 stalls at the local minimum of |f| near p = 0.82. */
+  rc = sbx_curve_load_text(curve, cycle_text, "<cycle>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  if (sbx_curve_prepare(curve, cfg) == SBX_OK)
+    fail("cycling solve should fail from a single start");
+  sbx_default_curve_solve_config(&sc);
+  sc.multistart = 8;
+  sc.multistart_spread = 3.0;
+  rc = sbx_curve_set_solve_config(curve, &sc);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  sbx_curve_get_param(curve, 0, &name, &a[0]);
+  if (!near(a[0] * a[0] * a[0] - 2.0 * a[0] + 2.0, 0.0, 1e-8))
+    fail("multi-start solve did not reach the root");
+  sc.tolerance = 0.0;
+  if (sbx_curve_set_solve_config(curve, &sc) == SBX_OK)
+    fail("zero solve tolerance should be rejected");
+  rc = sbx_curve_set_solve_config(curve, NULL);
+  if (rc != SBX_OK) fail("restoring default solve config failed");
+
+  /* A tighter config on a prepared curve re-solves on the next prepare. */
+  rc = sbx_curve_load_text(curve, root_text, "<root>.sbgf");
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  sbx_default_curve_solve_config(&sc);
+  sc.tolerance = 0.5;
+  rc = sbx_curve_set_solve_config(curve, &sc);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  sbx_curve_get_param(curve, 0, &name, &a[0]);
+  if (near(a[0] * a[0], 2.0, 1e-3))
+    fail("loose solve tolerance should stop short of the root");
+  rc = sbx_curve_set_solve_config(curve, NULL);
+  if (rc != SBX_OK) fail("restoring default solve config failed");
+  if (sbx_curve_eval(curve, 0.0, &pt) == SBX_OK)
+    fail("set_solve_config should require a new prepare");
+  rc = sbx_curve_prepare(curve, cfg);
+  if (rc != SBX_OK) fail(sbx_curve_last_error(curve));
+  sbx_curve_get_param(curve, 0, &name, &a[0]);
+  if (!near(a[0] * a[0], 2.0, 1e-9))
+    fail("prepare after set_solve_config did not re-solve");
+}
+
 int
 main(void) {
   SbxCurveProgram *curve;
@@ -106,6 +561,15 @@ main(void) {
   if (!near(pt1.beat_hz, 2.5, 1e-6))
     fail("solve curve end boundary mismatch");
 
+  check_ops_curve(curve);
+  check_const_curve(curve, &cfg);
+  check_shared_curve(curve);
+  check_bake_curve(curve, &cfg);
+  check_interval_curve(curve);
+  check_reprepare_curve(curve, &cfg);
+  check_eval_batch(curve);
+  check_solver_curve(curve, &cfg);
+
   sbx_curve_destroy(curve);
   puts("PASS: sbagenxlib curve API checks");
   return 0;
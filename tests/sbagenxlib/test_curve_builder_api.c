@@ -23,12 +23,13 @@ main(void) {
   SbxCurveInfo info;
   SbxCurveEvalPoint pt0, pt1;
   SbxCurveTimelineConfig tl_cfg;
-  SbxCurveTimeline tl;
+  SbxCurveTimeline tl, atl;
   SbxEngineConfig eng_cfg;
   SbxContext *ctx = 0;
   SbxCurveSourceConfig src_cfg;
   SbxToneSpec tone;
   int rc;
+  size_t i;
 
   sbx_default_curve_file_program_config(&file_cfg);
   file_cfg.path = "examples/basics/curve-sigmoid-like.sbgf";
@@ -94,6 +95,32 @@ main(void) {
     fail("curve timeline fade frame time mismatch");
   if (!near(tl.program_frames[tl.program_frame_count - 1].tone.amplitude, 0.0, 1e-12))
     fail("curve timeline fade frame amplitude mismatch");
+  if (tl.max_error != 0.0) fail("fixed-step timeline should report zero max_error");
+
+  /* Adaptive placement: fewer frames, bounded chord error */
+  tl_cfg.adaptive_tolerance = 0.05;
+  tl_cfg.adaptive_max_gap_sec = 600.0;
+  rc = sbx_build_curve_timeline(curve, &tl_cfg, &atl);
+  if (rc != SBX_OK) fail("adaptive sbx_build_curve_timeline failed");
+  if (atl.program_frame_count >= tl.program_frame_count)
+    fail("adaptive timeline should use fewer frames than fixed step");
+  if (!(atl.max_error > 0.0) || atl.max_error > tl_cfg.adaptive_tolerance)
+    fail("adaptive timeline max_error out of range");
+  for (i = 1; i < atl.program_frame_count; i++) {
+    if (!(atl.program_frames[i].time_sec > atl.program_frames[i - 1].time_sec))
+      fail("adaptive timeline frames should be strictly increasing");
+    if (atl.program_frames[i].time_sec - atl.program_frames[i - 1].time_sec >
+        tl_cfg.adaptive_max_gap_sec + 1e-9)
+      fail("adaptive timeline exceeded max gap");
+  }
+  if (!near(atl.program_frames[atl.program_frame_count - 2].time_sec, 1800.0, 1e-9))
+    fail("adaptive timeline main-end frame time mismatch");
+  sbx_free_curve_timeline(&atl);
+
+  tl_cfg.adaptive_tolerance = -1.0;
+  if (sbx_build_curve_timeline(curve, &tl_cfg, &atl) == SBX_OK)
+    fail("negative adaptive tolerance should be rejected");
+  tl_cfg.adaptive_tolerance = 0.0;
 
   sbx_default_engine_config(&eng_cfg);
   ctx = sbx_context_create(&eng_cfg);
@@ -0,0 +1,171 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static const char *expfit_text =
+  "param l = 0.15\n"
+  "solve A,C : A*exp(-l*0)+C=b0 ; A*exp(-l*D)+C=b1\n"
+  "beat = A*exp(-l*m) + C\n"
+  "carrier = c0 + (c1 - c0)*ramp(m, 0, T)\n";
+
+typedef struct {
+  SbxCurveCache *cache;
+  const SbxCurveEvalConfig *cfg;
+  int index;
+  int failed;
+} Worker;
+
+/* Each worker cycles through four parameter sets and checks the end beat. */
+static void *
+worker_main(void *arg) {
+  Worker *w = (Worker *)arg;
+  SbxCurveEvalState *st = sbx_curve_eval_state_create();
+  int i;
+
+  if (!st) {
+    w->failed = 1;
+    return NULL;
+  }
+  for (i = 0; i < 200; i++) {
+    SbxCurveParamOverride ov;
+    SbxCurveCacheEntry *e = 0;
+    SbxCurveEvalPoint pt;
+    double t = 1800.0;
+    ov.name = "l";
+    ov.value = 0.1 + 0.05 * ((i + w->index) % 4);
+    if (sbx_curve_cache_acquire(w->cache, expfit_text, "expfit.sbgf", &ov, 1,
+                                w->cfg, NULL, &e, NULL, 0) != SBX_OK ||
+        sbx_curve_eval_batch(sbx_curve_cache_entry_curve(e), st, &t, 1, &pt) != SBX_OK ||
+        fabs(pt.beat_hz - w->cfg->beat_target_hz) > 1e-6)
+      w->failed = 1;
+    sbx_curve_cache_release(w->cache, e);
+  }
+  sbx_curve_eval_state_destroy(st);
+  return NULL;
+}
+
+int
+main(void) {
+  SbxCurveCacheConfig cc;
+  SbxCurveCache *cache;
+  SbxCurveEvalConfig cfg;
+  SbxCurveTimelineConfig tc;
+  SbxCurveCacheStats stats;
+  SbxCurveCacheEntry *e1 = 0, *e2 = 0, *e3 = 0, *e4 = 0;
+  SbxCurveParamOverride ov = { "l", 0.3 };
+  const SbxCurveTimeline *tl;
+  pthread_t th[4];
+  Worker w[4];
+  char err[256];
+  int i, rc;
+
+  sbx_default_curve_eval_config(&cfg);
+  sbx_default_curve_timeline_config(&tc);
+  tc.sample_span_sec = 1800;
+  tc.main_span_sec = 1800;
+  tc.step_len_sec = 60;
+  tc.slide = 0;
+  sbx_default_curve_cache_config(&cc);
+  cc.max_entries = 2;
+  cache = sbx_curve_cache_create(&cc);
+  if (!cache) fail("sbx_curve_cache_create failed");
+
+  rc = sbx_curve_cache_acquire(cache, expfit_text, "expfit.sbgf", NULL, 0, &cfg, &tc,
+                               &e1, err, sizeof(err));
+  if (rc != SBX_OK) fail(err);
+  rc = sbx_curve_cache_acquire(cache, expfit_text, "expfit.sbgf", NULL, 0, &cfg, &tc,
+                               &e2, err, sizeof(err));
+  if (rc != SBX_OK) fail(err);
+  if (e1 != e2) fail("identical request should return the cached entry");
+  tl = sbx_curve_cache_entry_timeline(e1);
+  if (!tl || tl->program_frame_count < 2)
+    fail("cached entry should carry the built timeline");
+  {
+    SbxCurveEvalState *st = sbx_curve_eval_state_create();
+    SbxCurveEvalPoint pt;
+    double t = (double)tc.step_len_sec;
+    if (!st) fail("sbx_curve_eval_state_create failed");
+    if (sbx_curve_eval_batch(sbx_curve_cache_entry_curve(e1), st, &t, 1, &pt) != SBX_OK ||
+        fabs(tl->program_frames[0].tone.beat_hz - pt.beat_hz) > 1e-9)
+      fail("cached timeline does not follow the curve");
+    sbx_curve_eval_state_destroy(st);
+  }
+  sbx_curve_cache_get_stats(cache, &stats);
+  if (stats.hits != 1 || stats.misses != 1 || stats.entry_count != 1 || stats.bytes == 0)
+    fail("hit/miss counters mismatch after a repeat request");
+
+  /* Different parameters and no timeline are separate keys. */
+  rc = sbx_curve_cache_acquire(cache, expfit_text, "expfit.sbgf", &ov, 1, &cfg, NULL,
+                               &e3, err, sizeof(err));
+  if (rc != SBX_OK) fail(err);
+  if (e3 == e1 || sbx_curve_cache_entry_timeline(e3))
+    fail("override request should be a separate entry without a timeline");
+
+  /* A third key evicts the least recently used entry (e1) while it is held. */
+  cfg.beat_target_hz = 3.0;
+  rc = sbx_curve_cache_acquire(cache, expfit_text, "expfit.sbgf", NULL, 0, &cfg, NULL,
+                               &e4, err, sizeof(err));
+  if (rc != SBX_OK) fail(err);
+  sbx_curve_cache_get_stats(cache, &stats);
+  if (stats.evictions != 1 || stats.entry_count != 2)
+    fail("max_entries should evict the least recently used entry");
+  {
+    SbxCurveEvalState *st = sbx_curve_eval_state_create();
+    SbxCurveEvalPoint pt;
+    double t = 1800.0;
+    if (!st) fail("sbx_curve_eval_state_create failed");
+    if (sbx_curve_eval_batch(sbx_curve_cache_entry_curve(e1), st, &t, 1, &pt) != SBX_OK ||
+        fabs(pt.beat_hz - 2.5) > 1e-6)
+      fail("evicted entry should stay usable until released");
+    sbx_curve_eval_state_destroy(st);
+  }
+  sbx_curve_cache_release(cache, e1);
+  sbx_curve_cache_release(cache, e2);
+  sbx_curve_cache_release(cache, e3);
+  sbx_curve_cache_release(cache, e4);
+
+  /* Failures report through errbuf and are not cached. */
+  rc = sbx_curve_cache_acquire(cache, "beat = (", "bad.sbgf", NULL, 0, &cfg, NULL,
+                               &e1, err, sizeof(err));
+  if (rc == SBX_OK || e1 || !err[0]) fail("bad curve text should fail with a message");
+  sbx_curve_cache_get_stats(cache, &stats);
+  if (stats.entry_count != 2) fail("failed request should not be cached");
+
+  sbx_curve_cache_clear(cache);
+  sbx_curve_cache_get_stats(cache, &stats);
+  if (stats.entry_count != 0 || stats.bytes != 0) fail("clear should empty the cache");
+  sbx_curve_cache_destroy(cache);
+
+  sbx_default_curve_eval_config(&cfg);
+  cache = sbx_curve_cache_create(NULL);
+  if (!cache) fail("sbx_curve_cache_create failed");
+  for (i = 0; i < 4; i++) {
+    w[i].cache = cache;
+    w[i].cfg = &cfg;
+    w[i].index = i;
+    w[i].failed = 0;
+    if (pthread_create(&th[i], NULL, worker_main, &w[i]) != 0)
+      fail("pthread_create failed");
+  }
+  for (i = 0; i < 4; i++) {
+    pthread_join(th[i], NULL);
+    if (w[i].failed) fail("threaded cache request failed");
+  }
+  sbx_curve_cache_get_stats(cache, &stats);
+  if (stats.hits + stats.misses != 800 || stats.entry_count != 4 || stats.misses < 4)
+    fail("threaded hit/miss counters mismatch");
+  sbx_curve_cache_destroy(cache);
+
+  puts("PASS: sbagenxlib curve cache API checks");
+  return 0;
+}
@@ -0,0 +1,197 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static const char *expfit_text =
+  "param l = 0.15\n"
+  "param k = 1\n"
+  "solve A,C : A*exp(-l*0)+C=b0 ; A*exp(-l*D)+C=b1\n"
+  "beat = k * (A*exp(-l*m) + C)\n"
+  "carrier = c0 + (c1 - c0)*ramp(m, 0, T)\n";
+
+static void *
+worker_main(void *arg) {
+  if (sbx_curve_sweep_work((SbxCurveSweep *)arg) != SBX_OK)
+    fail("sbx_curve_sweep_work failed");
+  return NULL;
+}
+
+static SbxCurveSweep *
+run_sweep(const SbxCurveProgram *curve,
+          const SbxCurveSweepAxis *axes,
+          size_t axis_count,
+          const SbxCurveSweepConfig *cfg,
+          int threads) {
+  pthread_t th[8];
+  char err[256];
+  SbxCurveSweep *sweep = sbx_curve_sweep_create(curve, axes, axis_count, cfg, err, sizeof(err));
+  int i;
+
+  if (!sweep) {
+    fprintf(stderr, "%s\n", err);
+    fail("sbx_curve_sweep_create failed");
+  }
+  for (i = 0; i < threads; i++) {
+    if (pthread_create(&th[i], NULL, worker_main, sweep) != 0)
+      fail("pthread_create failed");
+  }
+  for (i = 0; i < threads; i++)
+    pthread_join(th[i], NULL);
+  return sweep;
+}
+
+int
+main(void) {
+  static const double l_vals[] = { 0.05, 0.1, 0.15, 0.2, 0.3 };
+  static const double k_vals[] = { 0.5, 1.0 };
+  static const double d_vals[] = { 20.0, 30.0, 45.0 };
+  SbxCurveSweepAxis axes[3];
+  SbxCurveSweepConfig cfg;
+  SbxCurveSweep *sweep, *serial;
+  SbxCurveProgram *curve, *ref;
+  SbxCurveSweepPoint pt;
+  const double *beat, *beat1;
+  double v[3];
+  double ref_hz[21];
+  char err[256];
+  char line[256];
+  FILE *fp;
+  size_t p, i;
+  int c;
+
+  sbx_default_curve_sweep_config(&cfg);
+  cfg.eval_config.beat_start_hz = 10.0;
+  cfg.eval_config.beat_target_hz = 2.0;
+  cfg.eval_config.beat_span_sec = 1800.0;
+  cfg.eval_config.hold_min = 10.0;
+  cfg.eval_config.total_min = 40.0;
+  cfg.eval_config.carrier_span_sec = 2400.0;
+  cfg.eval_config.wake_min = 0.0;
+  cfg.sample_count = 21;
+
+  curve = sbx_curve_create();
+  if (!curve || sbx_curve_load_text(curve, expfit_text, "sweep.sbgf") != SBX_OK)
+    fail("load failed");
+
+  axes[0].name = "l";
+  axes[0].values = l_vals;
+  axes[0].value_count = 5;
+  axes[1].name = "k";
+  axes[1].values = k_vals;
+  axes[1].value_count = 2;
+  axes[2].name = "D";
+  axes[2].values = d_vals;
+  axes[2].value_count = 3;
+
+  sweep = run_sweep(curve, axes, 3, &cfg, 4);
+  if (sbx_curve_sweep_point_count(sweep) != 30) fail("point count mismatch");
+  if (sbx_curve_sweep_first_error(sweep)[0]) fail("unexpected sweep error");
+
+  /* Every point matches a fresh load/override/prepare/sample cycle. */
+  for (p = 0; p < 30; p++) {
+    SbxCurveEvalConfig ec = cfg.eval_config;
+    if (sbx_curve_sweep_get_point(sweep, p, v, &pt, &beat) != SBX_OK)
+      fail("get_point failed");
+    if (v[0] != l_vals[p / 6] || v[1] != k_vals[(p / 3) % 2] || v[2] != d_vals[p % 3])
+      fail("axis values are not in row-major order");
+    if (pt.status != SBX_OK) fail("point failed");
+    ec.beat_span_sec = v[2] * 60.0;
+    ec.total_min = v[2] + ec.hold_min;
+    ec.carrier_span_sec = ec.total_min * 60.0;
+    if (fabs(pt.duration_sec - ec.total_min * 60.0) > 1e-9 ||
+        pt.t0_sec != 0.0 || pt.t1_sec != pt.duration_sec)
+      fail("point duration/range mismatch");
+    ref = sbx_curve_create();
+    if (sbx_curve_load_text(ref, expfit_text, "sweep.sbgf") != SBX_OK ||
+        sbx_curve_set_param(ref, "l", v[0]) != SBX_OK ||
+        sbx_curve_set_param(ref, "k", v[1]) != SBX_OK ||
+        sbx_curve_prepare(ref, &ec) != SBX_OK ||
+        sbx_curve_sample_program_beat(ref, 0.0, pt.duration_sec, 21, NULL, ref_hz) != SBX_OK)
+      fail("reference prepare failed");
+    for (i = 0; i < 21; i++) {
+      if (fabs(beat[i] - ref_hz[i]) > 1e-9) fail("sweep beat differs from reference");
+    }
+    if (fabs(beat[0] - 10.0 * v[1]) > 1e-6) fail("solve start beat mismatch");
+    sbx_curve_destroy(ref);
+  }
+
+  /* Thread count does not change results. */
+  serial = run_sweep(curve, axes, 3, &cfg, 1);
+  for (p = 0; p < 30; p++) {
+    sbx_curve_sweep_get_point(sweep, p, NULL, NULL, &beat);
+    sbx_curve_sweep_get_point(serial, p, NULL, NULL, &beat1);
+    if (memcmp(beat, beat1, 21 * sizeof(double)))
+      fail("threaded sweep differs from serial sweep");
+  }
+  sbx_curve_sweep_destroy(serial);
+
+  fp = tmpfile();
+  if (!fp || sbx_curve_sweep_write(sweep, fp, SBX_CURVE_SWEEP_CSV) != SBX_OK)
+    fail("CSV write failed");
+  rewind(fp);
+  if (!fgets(line, sizeof(line), fp) ||
+      strncmp(line, "point,l,k,D,status,duration_sec,t0_sec,t1_sec,beat_0,", 53))
+    fail("CSV header mismatch");
+  for (i = 0, c = fgetc(fp); c != EOF; c = fgetc(fp))
+    if (c == '\n') i++;
+  if (i != 30) fail("CSV row count mismatch");
+  fclose(fp);
+
+  fp = tmpfile();
+  if (!fp || sbx_curve_sweep_write(sweep, fp, SBX_CURVE_SWEEP_BINARY) != SBX_OK)
+    fail("binary write failed");
+  if (ftell(fp) != 8 + 16 + 8 + 6 + 30 * (8 + 6 * 8 + 21 * 8))
+    fail("binary size mismatch");
+  rewind(fp);
+  if (fread(line, 1, 8, fp) != 8 || memcmp(line, "SBXSWEEP", 8)) fail("binary magic mismatch");
+  fclose(fp);
+  sbx_curve_sweep_destroy(sweep);
+
+  /* A fixed sampling range and a failing point. */
+  cfg.t0_sec = 0.0;
+  cfg.t1_sec = 600.0;
+  {
+    static const double k_bad[] = { 1.0, NAN };
+    axes[1].values = k_bad;
+    if (sbx_curve_sweep_create(curve, axes, 2, &cfg, err, sizeof(err)))
+      fail("non-finite sweep value should be rejected");
+  }
+  {
+    static const double l_bad[] = { 0.1, 0.0 };
+    axes[0].values = l_bad;
+    axes[0].value_count = 2;
+    axes[1].values = k_vals;
+    sweep = run_sweep(curve, axes, 2, &cfg, 2);
+    sbx_curve_sweep_get_point(sweep, 0, NULL, &pt, NULL);
+    if (pt.status != SBX_OK || pt.t1_sec != 600.0) fail("fixed-range point mismatch");
+    sbx_curve_sweep_get_point(sweep, 2, NULL, &pt, &beat);
+    if (pt.status == SBX_OK || !isnan(beat[0])) fail("singular solve point should fail");
+    if (strncmp(sbx_curve_sweep_first_error(sweep), "point 2:", 8))
+      fail("first error should name the lowest failed point");
+    sbx_curve_sweep_destroy(sweep);
+  }
+
+  axes[0].name = "nope";
+  if (sbx_curve_sweep_create(curve, axes, 1, &cfg, err, sizeof(err)) || !strstr(err, "nope"))
+    fail("unknown sweep parameter should be rejected");
+  axes[0].name = "A";
+  if (sbx_curve_sweep_create(curve, axes, 1, &cfg, err, sizeof(err)))
+    fail("solve unknown should not be sweepable");
+  axes[0].name = "k";
+  if (sbx_curve_sweep_create(curve, axes, 2, &cfg, err, sizeof(err)))
+    fail("duplicate sweep axis should be rejected");
+
+  sbx_curve_destroy(curve);
+  printf("PASS: curve sweep API\n");
+  return 0;
+}
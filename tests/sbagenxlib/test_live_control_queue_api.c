@@ -0,0 +1,150 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+#define POST_COUNT 20000
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static int
+near(double a, double b, double eps) {
+  return fabs(a - b) <= eps;
+}
+
+static void
+expect_ok(int rc, const char *msg) {
+  if (rc != SBX_OK) fail(msg);
+}
+
+static double
+live_value(SbxContext *ctx, int kind) {
+  SbxLiveControlState st;
+  expect_ok(sbx_context_get_live_control(ctx, kind, &st), "get live control failed");
+  return st.active ? st.current_value : -1.0;
+}
+
+static void *
+producer_main(void *arg) {
+  SbxContext *ctx = (SbxContext *)arg;
+  int i, rc;
+  for (i = 1; i <= POST_COUNT; i++) {
+    do {
+      rc = sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_CARRIER_HZ,
+                                         100.0 + (double)i * 0.01, 0.0);
+    } while (rc == SBX_EBUSY);
+    if (rc != SBX_OK) fail("threaded post failed");
+  }
+  return 0;
+}
+
+int
+main(void) {
+  SbxEngineConfig cfg;
+  SbxToneSpec tone;
+  SbxContext *ctx = 0;
+  pthread_t producer;
+  float buf[256 * 2];
+  double last = 0.0, v = 0.0;
+  int i, rc;
+
+  sbx_default_engine_config(&cfg);
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+
+  sbx_default_tone_spec(&tone);
+  tone.mode = SBX_TONE_BINAURAL;
+  tone.carrier_hz = 200.0;
+  tone.beat_hz = 10.0;
+  tone.amplitude = 0.2;
+  expect_ok(sbx_context_set_tone(ctx, &tone), "set static tone failed");
+
+  if (sbx_context_post_live_control(ctx, 99, 1.0, 0.0) != SBX_EINVAL)
+    fail("unknown live control kind should be rejected at post time");
+  if (sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_BEAT_HZ, NAN, 0.0) != SBX_EINVAL)
+    fail("non-finite live control value should be rejected at post time");
+  if (sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_BEAT_HZ, 5.0, -1.0) != SBX_EINVAL)
+    fail("negative ramp duration should be rejected at post time");
+
+  /* Posted commands are deferred until the render thread drains them. */
+  expect_ok(sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_CARRIER_HZ, 240.0, 0.0),
+            "post live carrier failed");
+  if (live_value(ctx, SBX_LIVE_CONTROL_CARRIER_HZ) >= 0.0)
+    fail("posted command should not apply before the next render block");
+  expect_ok(sbx_context_render_f32(ctx, buf, 256), "render after post failed");
+  if (!near(live_value(ctx, SBX_LIVE_CONTROL_CARRIER_HZ), 240.0, 1e-9))
+    fail("posted carrier should apply at block start");
+
+  /* Ramps start at the draining block's timeline time. */
+  expect_ok(sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_BEAT_HZ, 4.0, 1.0),
+            "post live beat ramp failed");
+  sbx_context_apply_posted_live_controls(ctx);
+  {
+    SbxLiveControlState st;
+    expect_ok(sbx_context_get_live_control(ctx, SBX_LIVE_CONTROL_BEAT_HZ, &st),
+              "get live beat failed");
+    if (!st.active || !st.ramp_active ||
+        !near(st.start_time_sec, sbx_context_time_sec(ctx), 1e-12) ||
+        !near(st.end_time_sec, sbx_context_time_sec(ctx) + 1.0, 1e-12) ||
+        !near(st.current_value, 10.0, 1e-9))
+      fail("posted ramp should start from the current value at drain time");
+  }
+
+  /* Value checks happen on apply; rejections surface via last_error. */
+  expect_ok(sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_CARRIER_HZ, -5.0, 0.0),
+            "post of out-of-range carrier should be queued");
+  expect_ok(sbx_context_render_f32(ctx, buf, 256), "render after rejected command failed");
+  if (!near(live_value(ctx, SBX_LIVE_CONTROL_CARRIER_HZ), 240.0, 1e-9))
+    fail("rejected posted command should leave the previous override in place");
+  if (!strstr(sbx_context_last_error(ctx), "carrier"))
+    fail("rejected posted command should report its reason");
+
+  expect_ok(sbx_context_post_clear_live_control(ctx, SBX_LIVE_CONTROL_CARRIER_HZ),
+            "post clear failed");
+  sbx_context_apply_posted_live_controls(ctx);
+  if (live_value(ctx, SBX_LIVE_CONTROL_CARRIER_HZ) >= 0.0)
+    fail("posted clear should disable the override");
+  expect_ok(sbx_context_post_clear_live_controls(ctx), "post clear-all failed");
+  sbx_context_apply_posted_live_controls(ctx);
+  if (live_value(ctx, SBX_LIVE_CONTROL_BEAT_HZ) >= 0.0)
+    fail("posted clear-all should disable every override");
+
+  /* The queue is bounded and reports back-pressure instead of blocking. */
+  for (i = 0; i < 64; i++)
+    expect_ok(sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_AMPLITUDE, 0.3, 0.0),
+              "post into non-full queue failed");
+  if (sbx_context_post_live_control(ctx, SBX_LIVE_CONTROL_AMPLITUDE, 0.3, 0.0) != SBX_EBUSY)
+    fail("post into full queue should return SBX_EBUSY");
+
+  /* Loading a new source discards commands posted against the old one. */
+  expect_ok(sbx_context_set_tone(ctx, &tone), "reload static tone failed");
+  sbx_context_apply_posted_live_controls(ctx);
+  if (live_value(ctx, SBX_LIVE_CONTROL_AMPLITUDE) >= 0.0)
+    fail("pending commands should be discarded on load");
+
+  /* One posting thread against one rendering thread: every command lands in order. */
+  if (pthread_create(&producer, 0, producer_main, ctx) != 0)
+    fail("pthread_create failed");
+  for (;;) {
+    expect_ok(sbx_context_render_f32(ctx, buf, 64), "threaded render failed");
+    v = live_value(ctx, SBX_LIVE_CONTROL_CARRIER_HZ);
+    if (v >= 0.0) {
+      if (v < last) fail("posted commands should apply in order");
+      last = v;
+    }
+    if (near(v, 100.0 + POST_COUNT * 0.01, 1e-9)) break;
+  }
+  rc = pthread_join(producer, 0);
+  if (rc != 0) fail("pthread_join failed");
+
+  sbx_context_destroy(ctx);
+  printf("PASS: live-control queue defers, orders, bounds, and discards posted commands\n");
+  return 0;
+}
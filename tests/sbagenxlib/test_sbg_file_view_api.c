@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbagenxlib.h"
+
+static const char *path = "/tmp/sbagenxlib_file_view_test.sbg";
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static SbxContext *
+make_ctx(void) {
+  SbxEngineConfig cfg;
+  SbxContext *ctx;
+  sbx_default_engine_config(&cfg);
+  cfg.sample_rate = 8000.0;
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+  return ctx;
+}
+
+static void
+write_bytes(const char *data, size_t len) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp || fwrite(data, 1, len, fp) != len) fail("cannot write temp program");
+  fclose(fp);
+}
+
+/*
+ * Named sets used over and over (their frames share one stored body),
+ * then inline sets that are all different, on one to three voices.
+ */
+static char *
+make_program(size_t lines) {
+  const char *head =
+      "alpha: mix/60 200+10/20\n"
+      "beta: 300+4/20 150+2/10\n"
+      "gamma: 180+6/25 -\n";
+  size_t cap = strlen(head) + lines * 64 + 1;
+  char *text = (char *)malloc(cap);
+  size_t len, i;
+  if (!text) fail("alloc failed (program)");
+  strcpy(text, head);
+  len = strlen(text);
+  for (i = 0; i < lines; i++) {
+    unsigned s = (unsigned)(i * 2);
+    char what[48];
+    if (i < lines / 2)
+      snprintf(what, sizeof(what), "%s", (i % 3 == 0) ? "alpha" : ((i % 3 == 1) ? "beta ->" : "gamma"));
+    else if (i % 2)
+      snprintf(what, sizeof(what), "%u+%u/20", 100 + (unsigned)i, 1 + (unsigned)(i % 9));
+    else
+      snprintf(what, sizeof(what), "%u+4/20 %u+2/10 pink/5", 100 + (unsigned)i, 400 + (unsigned)i);
+    len += (size_t)snprintf(text + len, cap - len, "%02u:%02u:%02u %s\n",
+                            s / 3600, (s / 60) % 60, s % 60, what);
+  }
+  return text;
+}
+
+/* Copy of text with every LF turned into CR LF. */
+static char *
+to_crlf(const char *text, size_t *out_len) {
+  size_t n = strlen(text), i, o = 0;
+  char *out = (char *)malloc(n * 2 + 1);
+  if (!out) fail("alloc failed (crlf)");
+  for (i = 0; i < n; i++) {
+    if (text[i] == '\n') out[o++] = '\r';
+    out[o++] = text[i];
+  }
+  out[o] = 0;
+  *out_len = o;
+  return out;
+}
+
+static float *
+render_all(SbxContext *ctx, size_t frames) {
+  float *buf = (float *)calloc(frames * 2, sizeof(float));
+  if (!buf) fail("alloc failed (render)");
+  if (sbx_context_render_f32(ctx, buf, frames) != SBX_OK) fail(sbx_context_last_error(ctx));
+  return buf;
+}
+
+/* Loads the file at path and checks it against ref, sample for sample. */
+static void
+check_file(SbxContext *ref, const float *want, size_t frames, const char *what) {
+  SbxContext *ctx = make_ctx();
+  float *got;
+  char msg[160];
+  if (sbx_context_load_sbg_timing_file(ctx, path, 0) != SBX_OK) {
+    snprintf(msg, sizeof(msg), "%s: %s", what, sbx_context_last_error(ctx));
+    fail(msg);
+  }
+  snprintf(msg, sizeof(msg), "%s: program mismatch", what);
+  if (sbx_context_keyframe_count(ctx) != sbx_context_keyframe_count(ref) ||
+      sbx_context_voice_count(ctx) != sbx_context_voice_count(ref) ||
+      sbx_context_duration_sec(ctx) != sbx_context_duration_sec(ref))
+    fail(msg);
+  got = render_all(ctx, frames);
+  snprintf(msg, sizeof(msg), "%s: render differs from the text load", what);
+  if (memcmp(got, want, frames * 2 * sizeof(float)) != 0) fail(msg);
+  free(got);
+  sbx_context_destroy(ctx);
+}
+
+int
+main(void) {
+  char *text = make_program(240);
+  size_t text_len = strlen(text);
+  size_t frames, crlf_len, page, pad, i;
+  char *crlf, *buf;
+  SbxContext *ref, *ctx;
+  SbxSbgStreamConfig scfg;
+  float *want, *got;
+  FILE *fp;
+
+  ref = make_ctx();
+  if (sbx_context_load_sbg_timing_text(ref, text, 0) != SBX_OK)
+    fail(sbx_context_last_error(ref));
+  if (sbx_context_voice_count(ref) != 3) fail("reference should have three voices");
+  frames = (size_t)(sbx_context_duration_sec(ref) * 8000.0) + 8000;
+  want = render_all(ref, frames);
+
+  write_bytes(text, text_len);
+  check_file(ref, want, frames, "LF");
+
+  crlf = to_crlf(text, &crlf_len);
+  write_bytes(crlf, crlf_len);
+  check_file(ref, want, frames, "CRLF");
+
+  /* Last line without its newline, LF and CRLF. */
+  write_bytes(text, text_len - 1);
+  check_file(ref, want, frames, "no trailing LF");
+  write_bytes(crlf, crlf_len - 2);
+  check_file(ref, want, frames, "no trailing CRLF");
+  free(crlf);
+
+  /* A comment line far longer than any line buffer starts out. */
+  buf = (char *)malloc(text_len + 200000 + 4);
+  if (!buf) fail("alloc failed (long line)");
+  buf[0] = '#';
+  memset(buf + 1, 'x', 200000);
+  buf[200001] = '\n';
+  memcpy(buf + 200002, text, text_len + 1);
+  write_bytes(buf, strlen(buf));
+  check_file(ref, want, frames, "long line");
+  free(buf);
+
+  /* A size that is a whole number of pages has no mapped NUL after it. */
+  page = (size_t)sysconf(_SC_PAGESIZE);
+  if (page < 64) page = 4096;
+  pad = page - (text_len % page) + page;
+  buf = (char *)malloc(text_len + pad + 1);
+  if (!buf) fail("alloc failed (page)");
+  memcpy(buf, text, text_len);
+  buf[text_len] = '#';
+  for (i = 1; i + 1 < pad; i++)
+    buf[text_len + i] = (i % 60 == 0) ? '\n' : ((i % 60 == 1) ? '#' : 'y');
+  buf[text_len + pad - 1] = '\n';
+  buf[text_len + pad] = 0;
+  if ((text_len + pad) % page != 0) fail("padding should reach a page boundary");
+  write_bytes(buf, text_len + pad);
+  check_file(ref, want, frames, "page multiple");
+  free(buf);
+
+  /* Empty file: nothing to load, and the context says so. */
+  write_bytes("", 0);
+  ctx = make_ctx();
+  if (sbx_context_load_sbg_timing_file(ctx, path, 0) == SBX_OK)
+    fail("empty file should not load");
+  if (!sbx_context_last_error(ctx)[0]) fail("empty file should set an error");
+  sbx_context_destroy(ctx);
+
+  /* Streaming drops frames; their stored bodies must go with them. */
+  write_bytes(text, text_len);
+  ctx = make_ctx();
+  sbx_default_sbg_stream_config(&scfg);
+  scfg.window_frames = 4;
+  scfg.take_stream_ownership = 1;
+  fp = fopen(path, "rb");
+  if (!fp || sbx_context_open_sbg_timing_stream(ctx, fp, &scfg) != SBX_OK)
+    fail("stream open failed");
+  got = (float *)calloc(frames * 2, sizeof(float));
+  if (!got) fail("alloc failed (stream)");
+  for (i = 0; i < frames; i += 1000) {
+    size_t n = (frames - i < 1000) ? frames - i : 1000;
+    if (sbx_context_pump_sbg_stream(ctx, n / 8000.0) != SBX_OK) fail("stream pump failed");
+    if (sbx_context_render_f32(ctx, got + i * 2, n) != SBX_OK) fail(sbx_context_last_error(ctx));
+    if (sbx_context_keyframe_count(ctx) > scfg.window_frames + 4)
+      fail("stream window should stay bounded");
+  }
+  if (memcmp(got, want, frames * 2 * sizeof(float)) != 0)
+    fail("stream render differs from the text load");
+  free(got);
+  sbx_context_destroy(ctx);
+
+  remove(path);
+  free(want);
+  sbx_context_destroy(ref);
+  free(text);
+  printf("PASS: sbagenxlib sbg file view checks\n");
+  return 0;
+}
@@ -0,0 +1,306 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static SbxContext *
+make_ctx(void) {
+  SbxEngineConfig cfg;
+  SbxContext *ctx;
+  sbx_default_engine_config(&cfg);
+  cfg.sample_rate = 8000.0;
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+  return ctx;
+}
+
+/* Definitions first, then a keyframe or block call every three seconds. */
+static char *
+make_program(size_t lines) {
+  const char *head =
+      "wave03: 0 0.5 1 0.5\n"
+      "custom01: e=2 0 0.3 1 0.3 0\n"
+      "alpha: mix/70 200+10/20 wave03:150+2/10 custom01:mixpulse:2/30\n"
+      "beta: mix/40 210+14/20 custom01:300@4/15 custom01:mixpulse:4/50\n"
+      "gamma: mix/55 180+6/25 -\n"
+      "blk: {\n"
+      "  +00:00 alpha\n"
+      "  +00:00:01 beta ->\n"
+      "  +00:00:02 gamma ==\n"
+      "}\n";
+  size_t cap = strlen(head) + lines * 48 + 1;
+  char *text = (char *)malloc(cap);
+  size_t len, i;
+  if (!text) fail("alloc failed (program)");
+  strcpy(text, head);
+  len = strlen(text);
+  for (i = 0; i < lines; i++) {
+    unsigned s = (unsigned)(i * 3);
+    const char *what = (i % 4 == 0) ? "blk" : ((i % 4 == 1) ? "alpha" : ((i % 4 == 2) ? "<> beta" : "gamma"));
+    len += (size_t)snprintf(text + len, cap - len, "%02u:%02u:%02u %s\n",
+                            s / 3600, (s / 60) % 60, s % 60, what);
+  }
+  return text;
+}
+
+static void
+write_text(const char *path, const char *text) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp || fputs(text, fp) < 0) fail("cannot write temp program");
+  fclose(fp);
+}
+
+/* Renders ref and the stream side by side; both must match sample for sample. */
+static void
+compare_stream(SbxContext *ref, SbxContext *st, size_t window, const char *what) {
+  const size_t chunk = 1000;
+  float *a = (float *)malloc(chunk * 2 * sizeof(float));
+  float *b = (float *)malloc(chunk * 2 * sizeof(float));
+  double end = sbx_context_duration_sec(ref) + 1.0;
+  size_t max_kf = 0;
+  char msg[160];
+  if (!a || !b) fail("alloc failed (render)");
+  while (sbx_context_time_sec(ref) < end) {
+    if (sbx_context_render_f32(ref, a, chunk) != SBX_OK) fail("reference render failed");
+    if (sbx_context_pump_sbg_stream(st, chunk / 8000.0) != SBX_OK) fail("stream pump failed");
+    if (sbx_context_render_f32(st, b, chunk) != SBX_OK) fail(sbx_context_last_error(st));
+    if (memcmp(a, b, chunk * 2 * sizeof(float)) != 0) {
+      snprintf(msg, sizeof(msg), "%s: stream render differs at t=%.3f", what,
+               sbx_context_time_sec(ref));
+      fail(msg);
+    }
+    if (sbx_context_keyframe_count(st) > max_kf) max_kf = sbx_context_keyframe_count(st);
+  }
+  /* Window, plus the frame playback is in and one block expansion. */
+  if (max_kf > window + 4) {
+    snprintf(msg, sizeof(msg), "%s: window grew to %lu keyframes", what, (unsigned long)max_kf);
+    fail(msg);
+  }
+  if (sbx_context_is_streaming(st)) fail("stream should be exhausted after the program end");
+  if (sbx_context_sbg_stream_underruns(st) != 0) fail("pumped stream should not underrun");
+  if (fabs(sbx_context_duration_sec(st) - sbx_context_duration_sec(ref)) > 1e-9)
+    fail("final stream duration should match the whole program");
+  free(a);
+  free(b);
+}
+
+#ifndef _WIN32
+typedef struct {
+  SbxContext *ctx;
+  int rc;
+} PumpArg;
+
+/* Stands in for a host's loader thread. */
+static void *
+pump_main(void *arg) {
+  PumpArg *pa = (PumpArg *)arg;
+  while (sbx_context_is_streaming(pa->ctx)) {
+    pa->rc = sbx_context_pump_sbg_stream(pa->ctx, 0.5);
+    if (pa->rc != SBX_OK) break;
+    usleep(200);
+  }
+  return 0;
+}
+
+/*
+ * Render never waits on a pipe: with nothing new written it holds the
+ * window and counts underruns, then a pump thread catches it up.
+ */
+static void
+check_render_never_blocks(void) {
+  const char *first = "a: 200+10/20\nb: 300+4/20\n00:00:00 a\n00:00:02 b\n";
+  char rest[256];
+  size_t len = 0;
+  SbxSbgStreamConfig scfg;
+  SbxContext *ctx;
+  pthread_t pump;
+  PumpArg pa;
+  float buf[2000];
+  unsigned int stalled;
+  int fds[2], i;
+  FILE *fp;
+
+  if (pipe(fds) != 0) fail("pipe failed");
+  if (write(fds[1], first, strlen(first)) != (ssize_t)strlen(first)) fail("pipe write failed");
+  fp = fdopen(fds[0], "r");
+  if (!fp) fail("fdopen failed");
+  ctx = make_ctx();
+  sbx_default_sbg_stream_config(&scfg);
+  scfg.window_frames = 1;
+  scfg.take_stream_ownership = 1;
+  if (sbx_context_open_sbg_timing_stream(ctx, fp, &scfg) != SBX_OK)
+    fail(sbx_context_last_error(ctx));
+
+  /* No pump yet and the writer is idle: 5 s of audio must still come out. */
+  for (i = 0; i < 40; i++) {
+    if (sbx_context_render_f32(ctx, buf, 1000) != SBX_OK) fail(sbx_context_last_error(ctx));
+  }
+  stalled = sbx_context_sbg_stream_underruns(ctx);
+  if (stalled == 0) fail("render past the window should count underruns");
+  if (!sbx_context_is_streaming(ctx)) fail("stream should still be open while the pipe is");
+
+  for (i = 4; i <= 20; i += 2)
+    len += (size_t)snprintf(rest + len, sizeof(rest) - len, "00:00:%02d %s\n", i, (i % 4) ? "b" : "a");
+  if (write(fds[1], rest, len) != (ssize_t)len) fail("pipe write failed");
+  close(fds[1]);
+
+  pa.ctx = ctx;
+  pa.rc = SBX_OK;
+  if (pthread_create(&pump, 0, pump_main, &pa) != 0) fail("pthread_create failed");
+  for (i = 0; i < 100000 && sbx_context_is_streaming(ctx); i++) {
+    if (sbx_context_render_f32(ctx, buf, 1000) != SBX_OK) fail(sbx_context_last_error(ctx));
+    usleep(50);
+  }
+  if (pthread_join(pump, 0) != 0) fail("pthread_join failed");
+  if (pa.rc != SBX_OK) fail("pump thread failed");
+  if (sbx_context_is_streaming(ctx)) fail("pump thread should reach the end of the pipe");
+  if (fabs(sbx_context_duration_sec(ctx) - 20.0) > 1e-9)
+    fail("pumped window should end at the last keyframe");
+  if (sbx_context_sbg_stream_underruns(ctx) < stalled) fail("underrun count went backwards");
+  sbx_context_destroy(ctx);
+}
+#endif
+
+int
+main(void) {
+  const char *path = "/tmp/sbagenxlib_stream_test.sbg";
+  char *text = make_program(200);
+  SbxContext *ref, *st;
+  SbxSbgStreamConfig scfg;
+  FILE *fp;
+  float buf[2000];
+
+  write_text(path, text);
+  ref = make_ctx();
+  if (sbx_context_load_sbg_timing_text(ref, text, 0) != SBX_OK)
+    fail(sbx_context_last_error(ref));
+
+  /* File stream with a small window. */
+  st = make_ctx();
+  sbx_default_sbg_stream_config(&scfg);
+  if (scfg.window_frames != 64) fail("default stream window should be 64");
+  scfg.window_frames = 8;
+  scfg.take_stream_ownership = 1;
+  fp = fopen(path, "rb");
+  if (!fp) fail("cannot open temp program");
+  if (sbx_context_open_sbg_timing_stream(st, fp, &scfg) != SBX_OK)
+    fail(sbx_context_last_error(st));
+  if (!sbx_context_is_streaming(st)) fail("stream should report pending keyframes");
+  if (sbx_context_keyframe_count(st) >= sbx_context_keyframe_count(ref))
+    fail("stream should not parse the whole program up front");
+  if (sbx_context_voice_count(st) != sbx_context_voice_count(ref))
+    fail("stream voice count mismatch");
+  compare_stream(ref, st, scfg.window_frames, "file");
+  sbx_context_destroy(st);
+
+#ifndef _WIN32
+  /* Pipe, with the definitions handed over as initial_text. */
+  {
+    char cmd[256];
+    const char *split = strstr(text, "}\n") + 2;
+    char *head = (char *)malloc((size_t)(split - text) + 1);
+    if (!head) fail("alloc failed (head)");
+    memcpy(head, text, (size_t)(split - text));
+    head[split - text] = 0;
+    write_text(path, split);
+    snprintf(cmd, sizeof(cmd), "cat %s", path);
+    fp = popen(cmd, "r");
+    if (!fp) fail("popen failed");
+    sbx_context_reset(ref);
+    st = make_ctx();
+    scfg.window_frames = 3;
+    scfg.take_stream_ownership = 0;
+    scfg.initial_text = head;
+    if (sbx_context_open_sbg_timing_stream(st, fp, &scfg) != SBX_OK)
+      fail(sbx_context_last_error(st));
+    free(head);
+    compare_stream(ref, st, scfg.window_frames, "pipe");
+    sbx_context_destroy(st);
+    pclose(fp);
+    write_text(path, text);
+  }
+#endif
+
+  /* Seeking: forward is fine, back before the window is refused. */
+  st = make_ctx();
+  scfg.window_frames = 4;
+  scfg.take_stream_ownership = 1;
+  scfg.initial_text = 0;
+  fp = fopen(path, "rb");
+  if (!fp || sbx_context_open_sbg_timing_stream(st, fp, &scfg) != SBX_OK)
+    fail("stream open failed (seek)");
+  if (sbx_context_set_time_sec(st, 120.0) != SBX_OK) fail("forward seek should work");
+  if (sbx_context_pump_sbg_stream(st, 1000 / 8000.0) != SBX_OK) fail("stream pump failed (seek)");
+  if (sbx_context_render_f32(st, buf, 1000) != SBX_OK) fail(sbx_context_last_error(st));
+  if (sbx_context_duration_sec(st) <= 120.0)
+    fail("pump should move the window to the seek position");
+  if (sbx_context_set_time_sec(st, 1.0) != SBX_EINVAL)
+    fail("seek before the window should fail");
+  if (!strstr(sbx_context_last_error(st), "buffered window"))
+    fail("seek error message mismatch");
+  sbx_context_destroy(st);
+
+  /* A bad line far ahead stops the pump and fails the render that reaches it. */
+  {
+    char *bad = (char *)malloc(strlen(text) + 64);
+    if (!bad) fail("alloc failed (bad)");
+    strcpy(bad, text);
+    strcat(bad, "01:00:00 nosuchtone\n");
+    write_text(path, bad);
+    free(bad);
+    st = make_ctx();
+    fp = fopen(path, "rb");
+    if (!fp || sbx_context_open_sbg_timing_stream(st, fp, &scfg) != SBX_OK)
+      fail("stream open should not see the late error");
+    {
+      int rc = SBX_OK;
+      int i;
+      for (i = 0; i < 10000 && rc == SBX_OK; i++) {
+        sbx_context_pump_sbg_stream(st, 1000 / 8000.0);
+        rc = sbx_context_render_f32(st, buf, 1000);
+      }
+      if (rc != SBX_EINVAL) fail("late parse error should fail the render");
+      if (sbx_context_pump_sbg_stream(st, 1.0) != SBX_EINVAL)
+        fail("pump should keep returning the parse error");
+      if (!strstr(sbx_context_last_error(st), "nosuchtone"))
+        fail("late parse error message mismatch");
+      if (sbx_context_render_f32(st, buf, 1000) != SBX_EINVAL)
+        fail("stream should stay failed after a parse error");
+    }
+    sbx_context_destroy(st);
+  }
+
+#ifndef _WIN32
+  check_render_never_blocks();
+#endif
+
+  /* Nothing to play, and an empty window. */
+  write_text(path, "# only a comment\n");
+  st = make_ctx();
+  fp = fopen(path, "rb");
+  if (!fp) fail("cannot open temp program");
+  if (sbx_context_open_sbg_timing_stream(st, fp, 0) != SBX_EINVAL)
+    fail("empty stream should be rejected");
+  scfg.window_frames = 0;
+  rewind(fp);
+  if (sbx_context_open_sbg_timing_stream(st, fp, &scfg) != SBX_EINVAL)
+    fail("zero window should be rejected");
+  fclose(fp);
+  sbx_context_destroy(st);
+
+  remove(path);
+  sbx_context_destroy(ref);
+  free(text);
+  printf("PASS: sbagenxlib sbg stream API checks\n");
+  return 0;
+}
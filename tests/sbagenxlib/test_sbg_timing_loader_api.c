@@ -267,6 +267,33 @@ main(void) {
   remove(tmp_path);
   if (rc != SBX_OK) fail("load_sbg_timing_file failed");
 
+  {
+    /* Sizes around a page boundary exercise both the mapped path and the
+     * heap fallback; no trailing newline on the last line. */
+    static const size_t sizes[] = { 4095, 4096, 4097, 8192 };
+    size_t si;
+    for (si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+      const char *body = "00:00 100+0/40\n00:00:05 220+0/40";
+      char *padded = (char *)malloc(sizes[si] + 1);
+      size_t blen = strlen(body), pos;
+      if (!padded) fail("alloc failed (page-sized sbg)");
+      padded[0] = '#';
+      for (pos = 1; pos < sizes[si] - blen - 1; pos++) padded[pos] = 'x';
+      padded[pos++] = '\n';
+      memcpy(padded + pos, body, blen + 1);
+      if (strlen(padded) != sizes[si]) fail("page-sized sbg text has wrong length");
+      write_text_file(tmp_path, padded);
+      free(padded);
+      rc = sbx_context_load_sbg_timing_file(ctx, tmp_path, 0);
+      remove(tmp_path);
+      if (rc != SBX_OK) fail("page-sized load_sbg_timing_file failed");
+      if (sbx_context_keyframe_count(ctx) != 2)
+        fail("page-sized sbg timing file should produce 2 keyframes");
+      if (sbx_context_get_keyframe(ctx, 1, &kf) != SBX_OK || fabs(kf.tone.carrier_hz - 220.0) > 1e-9)
+        fail("page-sized sbg timing file last line parsed incorrectly");
+    }
+  }
+
   rc = sbx_context_load_sbg_timing_text(ctx, "00:00 100+0/40\n00:00:05 220+0/40\n", 1);
   if (rc != SBX_OK) fail("looped sbg timing load failed");
   frames = (size_t)(12.4 * cfg.sample_rate);
@@ -774,6 +801,38 @@ main(void) {
   if (!(abs_sum_window(buf, (size_t)(0.02 * cfg.sample_rate), (size_t)(0.25 * cfg.sample_rate)) > 1e-3))
     fail("block multivoice timing render should produce non-zero energy");
 
+  {
+    /* Enough names to rehash the lookup index; lookups stay case-sensitive
+     * and a redefinition replaces the earlier tone-set. */
+    size_t cap = 64 * 1024, len = 0;
+    char *many = (char *)malloc(cap);
+    int i;
+    if (!many) fail("alloc failed (many tone-sets)");
+    for (i = 0; i < 500; i++)
+      len += (size_t)snprintf(many + len, cap - len, "ts%d: %d+4/20\n", i, 100 + i);
+    len += (size_t)snprintf(many + len, cap - len,
+                            "ts7: 777+4/20\nAlpha: 150+4/20\nalpha: 160+4/20\n"
+                            "00:00 ts499\n00:01 ts7\n00:02 Alpha\n00:03 alpha\n00:04 ts0\n");
+    rc = sbx_context_load_sbg_timing_text(ctx, many, 0);
+    free(many);
+    if (rc != SBX_OK) fail("many named tone-sets sbg timing load failed");
+    if (sbx_context_keyframe_count(ctx) != 5)
+      fail("many named tone-sets should produce 5 keyframes");
+    if (sbx_context_get_keyframe(ctx, 0, &kf) != SBX_OK || fabs(kf.tone.carrier_hz - 599.0) > 1e-9)
+      fail("last of many tone-sets resolved incorrectly");
+    if (sbx_context_get_keyframe(ctx, 1, &kf) != SBX_OK || fabs(kf.tone.carrier_hz - 777.0) > 1e-9)
+      fail("redefined tone-set should use its latest definition");
+    if (sbx_context_get_keyframe(ctx, 2, &kf) != SBX_OK || fabs(kf.tone.carrier_hz - 150.0) > 1e-9)
+      fail("tone-set lookup should be case-sensitive (Alpha)");
+    if (sbx_context_get_keyframe(ctx, 3, &kf) != SBX_OK || fabs(kf.tone.carrier_hz - 160.0) > 1e-9)
+      fail("tone-set lookup should be case-sensitive (alpha)");
+    if (sbx_context_get_keyframe(ctx, 4, &kf) != SBX_OK || fabs(kf.tone.carrier_hz - 100.0) > 1e-9)
+      fail("first of many tone-sets resolved incorrectly");
+    rc = sbx_context_load_sbg_timing_text(ctx, "a: 100+4/20\nb: {\n+00:00 a\n}\nB: {\n+00:00 A\n}\nNOW b\n", 0);
+    if (rc != SBX_EINVAL)
+      fail("block entry naming an undefined tone-set (wrong case) should fail");
+  }
+
   rc = sbx_context_load_sbg_timing_text(ctx, "self: {\n+00:00 self\n}\nNOW self\n", 0);
   if (rc != SBX_EINVAL)
     fail("self-referential nested block should fail");
@@ -0,0 +1,236 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+#define TOTAL_FRAMES 6000
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static void
+expect_ok(int rc, const char *msg) {
+  if (rc != SBX_OK) fail(msg);
+}
+
+static SbxContext *
+make_ctx(void) {
+  SbxEngineConfig cfg;
+  SbxToneSpec tone;
+  SbxContext *ctx;
+  sbx_default_engine_config(&cfg);
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+  sbx_default_tone_spec(&tone);
+  tone.mode = SBX_TONE_BINAURAL;
+  tone.carrier_hz = 200.0;
+  tone.beat_hz = 10.0;
+  tone.amplitude = 0.2;
+  expect_ok(sbx_context_set_tone(ctx, &tone), "set static tone failed");
+  return ctx;
+}
+
+static void
+schedule(SbxContext *ctx, uint64_t frame, int type, int kind, double value, double dur) {
+  SbxScheduledEvent ev;
+  sbx_default_scheduled_event(&ev);
+  ev.type = type;
+  ev.kind = kind;
+  ev.value = value;
+  ev.duration_sec = dur;
+  expect_ok(sbx_context_schedule_event(ctx, frame, &ev), "schedule event failed");
+}
+
+/* Render TOTAL_FRAMES with a fixed event list, using the given block size. */
+static void
+render_with_events(size_t block, float *out, int with_events) {
+  SbxContext *ctx = make_ctx();
+  size_t done = 0;
+  if (with_events) {
+    /* Scheduled out of order on purpose; the context keeps them sorted. */
+    schedule(ctx, 3001, SBX_EVENT_RAMP_CONTROL, SBX_LIVE_CONTROL_BEAT_HZ, 4.0, 0.02);
+    schedule(ctx, 1000, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_CARRIER_HZ, 260.0, 0.0);
+    schedule(ctx, 4500, SBX_EVENT_CLEAR_CONTROL, SBX_LIVE_CONTROL_CARRIER_HZ, 0.0, 0.0);
+    schedule(ctx, 1000, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_AMPLITUDE, 0.4, 0.0);
+    if (sbx_context_scheduled_event_count(ctx) != 4)
+      fail("scheduled event count mismatch");
+  }
+  while (done < TOTAL_FRAMES) {
+    size_t n = TOTAL_FRAMES - done < block ? TOTAL_FRAMES - done : block;
+    expect_ok(sbx_context_render_f32(ctx, out + done * 2, n), "render failed");
+    done += n;
+  }
+  if (sbx_context_frame_position(ctx) != TOTAL_FRAMES)
+    fail("frame position should count rendered frames");
+  if (sbx_context_scheduled_event_count(ctx) != 0)
+    fail("all events should have been applied");
+  sbx_context_destroy(ctx);
+}
+
+/* 2 s looping keyframe program at 1 kHz, carrier 200 Hz. */
+static SbxContext *
+make_loop_ctx(int loop) {
+  SbxEngineConfig cfg;
+  SbxContext *ctx;
+  sbx_default_engine_config(&cfg);
+  cfg.sample_rate = 1000.0;
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed (loop)");
+  expect_ok(sbx_context_load_sbg_timing_text(ctx, "a: 200+10/20\n00:00:00 a\n00:00:02 a\n", loop),
+            "load looping program failed");
+  return ctx;
+}
+
+/*
+ * A scheduled SET must behave like sbx_context_set_live_control called on
+ * the same frame, also once the loop wraps or the transport seeks back.
+ */
+static void
+check_event_persists(int loop, double seek_sec) {
+  static float a[5000 * 2], b[5000 * 2];
+  SbxContext *ev = make_loop_ctx(loop), *ref = make_loop_ctx(loop);
+  size_t done;
+
+  schedule(ev, 1500, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_CARRIER_HZ, 300.0, 0.0);
+  schedule(ev, 1500, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_MIX_AMP_PCT, 40.0, 0.0);
+  for (done = 0; done < 2500; done += 500)
+    expect_ok(sbx_context_render_f32(ev, a + done * 2, 500), "render with event failed");
+  expect_ok(sbx_context_render_f32(ref, b, 1500), "reference render failed");
+  expect_ok(sbx_context_set_live_control(ref, SBX_LIVE_CONTROL_CARRIER_HZ, 300.0),
+            "reference set failed");
+  expect_ok(sbx_context_set_live_control(ref, SBX_LIVE_CONTROL_MIX_AMP_PCT, 40.0),
+            "reference mix set failed");
+  expect_ok(sbx_context_render_f32(ref, b + 1500 * 2, 1000), "reference render failed");
+  if (seek_sec >= 0.0) {
+    expect_ok(sbx_context_set_time_sec(ev, seek_sec), "seek failed");
+    expect_ok(sbx_context_set_time_sec(ref, seek_sec), "reference seek failed");
+    if (fabs(sbx_context_mix_amp_effective_at(ev, seek_sec) - 40.0) > 1e-9)
+      fail("mix amp after seeking back should keep the event's level");
+  }
+  for (done = 2500; done < 5000; done += 500)
+    expect_ok(sbx_context_render_f32(ev, a + done * 2, 500), "render after event failed");
+  expect_ok(sbx_context_render_f32(ref, b + 2500 * 2, 2500), "reference render failed");
+  if (memcmp(a, b, sizeof(a)) != 0)
+    fail(seek_sec >= 0.0 ? "scheduled set should survive a seek back"
+                         : "scheduled set should survive the loop wrap");
+  if (fabs(sbx_context_mix_amp_effective_at(ev, sbx_context_time_sec(ev)) - 40.0) > 1e-9)
+    fail("mix amp should keep the event's level on later blocks");
+  sbx_context_destroy(ev);
+  sbx_context_destroy(ref);
+}
+
+int
+main(void) {
+  static float ref[TOTAL_FRAMES * 2];
+  static float buf[TOTAL_FRAMES * 2];
+  static float plain[TOTAL_FRAMES * 2];
+  static const size_t blocks[] = { 1, 97, 256, 1000, 4096 };
+  SbxContext *ctx;
+  SbxScheduledEvent ev;
+  size_t i, bi;
+  double sr;
+
+  /* Output must not depend on how the host slices its buffers. */
+  render_with_events(TOTAL_FRAMES, ref, 1);
+  for (bi = 0; bi < sizeof(blocks) / sizeof(blocks[0]); bi++) {
+    render_with_events(blocks[bi], buf, 1);
+    if (memcmp(ref, buf, sizeof(ref)) != 0)
+      fail("scheduled events should render identically for every block size");
+  }
+
+  /* Nothing changes before the first event frame; it changes from that frame. */
+  render_with_events(TOTAL_FRAMES, plain, 0);
+  if (memcmp(ref, plain, 1000 * 2 * sizeof(float)) != 0)
+    fail("frames before the first event should be unaffected");
+  if (ref[1000 * 2] == plain[1000 * 2] && ref[1000 * 2 + 1] == plain[1000 * 2 + 1])
+    fail("event frame should already carry the new amplitude");
+
+  ctx = make_ctx();
+  sr = 44100.0;
+
+  sbx_default_scheduled_event(&ev);
+  ev.type = 99;
+  if (sbx_context_schedule_event(ctx, 0, &ev) != SBX_EINVAL)
+    fail("unknown event type should be rejected");
+  sbx_default_scheduled_event(&ev);
+  ev.kind = 99;
+  if (sbx_context_schedule_event(ctx, 0, &ev) != SBX_EINVAL)
+    fail("unknown live control kind should be rejected");
+
+  /* Mix-side state before the event frame is preserved for mix sampling. */
+  schedule(ctx, 441, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_MIX_AMP_PCT, 40.0, 0.0);
+  expect_ok(sbx_context_render_f32(ctx, buf, 1024), "render across mix event failed");
+  if (fabs(sbx_context_mix_amp_effective_at(ctx, 440.0 / sr) - 100.0) > 1e-9)
+    fail("mix amp before the event frame should keep the base level");
+  if (fabs(sbx_context_mix_amp_effective_at(ctx, 441.0 / sr) - 40.0) > 1e-9)
+    fail("mix amp from the event frame should use the new level");
+
+  /* Mix effects can be toggled on exact frames. */
+  {
+    SbxMixFxSpec fx;
+    double l0 = 0.0, r0 = 0.0, l1 = 0.0, r1 = 0.0;
+    double t_pre = 2047.0 / sr, t_post = 2048.0 / sr;
+    expect_ok(sbx_parse_mix_fx_spec("mixspin:400+6/40", SBX_WAVE_SINE, &fx),
+              "mix fx parse failed");
+    expect_ok(sbx_context_set_mix_effects(ctx, &fx, 1), "set mix effects failed");
+    sbx_default_scheduled_event(&ev);
+    ev.type = SBX_EVENT_MIX_EFFECT_ENABLE;
+    ev.index = 3;
+    expect_ok(sbx_context_schedule_event(ctx, 1500, &ev), "schedule bad index failed");
+    ev.index = 0;
+    ev.value = 0.0;
+    expect_ok(sbx_context_schedule_event(ctx, 2048, &ev), "schedule mix bypass failed");
+    expect_ok(sbx_context_render_f32(ctx, buf, 1024), "render before bypass failed");
+    if (!strstr(sbx_context_last_error(ctx), "mix effect index"))
+      fail("out-of-range mix effect event should report its reason");
+    if (sbx_context_scheduled_event_count(ctx) != 1)
+      fail("event on the next block's first frame should still be pending");
+    expect_ok(sbx_context_render_f32(ctx, buf, 16), "render across bypass failed");
+    expect_ok(sbx_context_mix_stream_sample(ctx, t_pre, 20000, 10000, 1.0, &l0, &r0),
+              "mix sample before bypass failed");
+    expect_ok(sbx_context_mix_stream_sample(ctx, t_post, 20000, 10000, 1.0, &l1, &r1),
+              "mix sample after bypass failed");
+    if (fabs(l1 - (20000 >> 4) * 0.4) > 1e-9 || fabs(r1 - (10000 >> 4) * 0.4) > 1e-9)
+      fail("bypassed mix effect should leave only the dry mix");
+    if (fabs(l0 - l1) < 1e-9 && fabs(r0 - r1) < 1e-9)
+      fail("mix effect should still apply before the bypass frame");
+  }
+
+  /* Late events apply at the start of the next block; seeking moves the transport. */
+  schedule(ctx, 10, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_BEAT_HZ, 6.0, 0.0);
+  expect_ok(sbx_context_render_f32(ctx, buf, 1), "render with late event failed");
+  {
+    SbxLiveControlState st;
+    expect_ok(sbx_context_get_live_control(ctx, SBX_LIVE_CONTROL_BEAT_HZ, &st),
+              "get live beat failed");
+    if (!st.active || fabs(st.current_value - 6.0) > 1e-9)
+      fail("late event should apply on the next render");
+  }
+  expect_ok(sbx_context_set_time_sec(ctx, 2.0), "seek failed");
+  if (sbx_context_frame_position(ctx) != 88200)
+    fail("seek should move the transport frame position");
+
+  /* Pre-event state only covers the block the event landed in. */
+  check_event_persists(1, -1.0);
+  check_event_persists(0, 0.5);
+
+  /* Loading a new source discards pending events. */
+  schedule(ctx, 100000, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_BEAT_HZ, 5.0, 0.0);
+  expect_ok(sbx_context_load_tone_spec(ctx, "220+8/20"), "reload failed");
+  if (sbx_context_scheduled_event_count(ctx) != 0 || sbx_context_frame_position(ctx) != 0)
+    fail("loading should discard events and reset the transport");
+  for (i = 0; i < 3; i++)
+    schedule(ctx, 5, SBX_EVENT_SET_CONTROL, SBX_LIVE_CONTROL_BEAT_HZ, 5.0, 0.0);
+  sbx_context_clear_scheduled_events(ctx);
+  if (sbx_context_scheduled_event_count(ctx) != 0)
+    fail("clear should drop pending events");
+
+  sbx_context_destroy(ctx);
+  printf("PASS: scheduled events land on exact frames independent of block size\n");
+  return 0;
+}
@@ -0,0 +1,8 @@
+#!/usr/bin/env bash
+set -euo pipefail
+cd "$(dirname "$0")/../.."
+cc -I. -Itests/sbagenxlib -Wall -Wextra \
+  -o /tmp/test_scheduled_events_api \
+  tests/sbagenxlib/test_scheduled_events_api.c \
+  sbagenxlib.c -lm -ldl
+/tmp/test_scheduled_events_api
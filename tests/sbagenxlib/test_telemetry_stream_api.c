@@ -0,0 +1,118 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static void
+expect_ok(int rc, const char *msg) {
+  if (rc != SBX_OK) fail(msg);
+}
+
+typedef struct {
+  SbxContext *ctx;
+  volatile int done;
+  size_t count;
+  double last_t;
+  int out_of_order;
+} Reader;
+
+static void *
+reader_main(void *arg) {
+  Reader *rd = (Reader *)arg;
+  SbxRuntimeTelemetry snaps[8];
+  for (;;) {
+    int finished = __atomic_load_n(&rd->done, __ATOMIC_ACQUIRE);
+    size_t i, n = sbx_context_read_telemetry(rd->ctx, snaps, 8);
+    for (i = 0; i < n; i++) {
+      if (snaps[i].time_sec <= rd->last_t) rd->out_of_order = 1;
+      rd->last_t = snaps[i].time_sec;
+    }
+    rd->count += n;
+    if (finished && n == 0) break;
+  }
+  return 0;
+}
+
+int
+main(void) {
+  SbxEngineConfig cfg;
+  SbxContext *ctx;
+  SbxRuntimeTelemetry snaps[64];
+  float buf[256 * 2];
+  size_t i, n;
+  pthread_t th;
+  Reader rd;
+
+  sbx_default_engine_config(&cfg);
+  ctx = sbx_context_create(&cfg);
+  if (!ctx) fail("sbx_context_create failed");
+  expect_ok(sbx_context_load_tone_spec(ctx, "200+10/20"), "load tone failed");
+
+  if (sbx_context_read_telemetry(ctx, snaps, 64) != 0)
+    fail("disabled stream should read nothing");
+  expect_ok(sbx_context_set_telemetry_stream(ctx, 30.0, 64), "enable stream failed");
+
+  /* One second in 256-frame blocks yields one snapshot per 1/30 s grid point. */
+  for (i = 0; i < 44100 / 256 + 1; i++)
+    expect_ok(sbx_context_render_f32(ctx, buf, 256), "render failed");
+  n = sbx_context_read_telemetry(ctx, snaps, 64);
+  if (n != 30)
+    fail("expected 30 decimated snapshots per second of audio");
+  for (i = 0; i < n; i++) {
+    double grid = (double)i / 30.0;
+    if (snaps[i].time_sec < grid - 1e-9 || snaps[i].time_sec > grid + 256.0 / 44100.0)
+      fail("snapshot should land on the first block at or after its grid point");
+    if (snaps[i].source_mode != SBX_SOURCE_STATIC ||
+        fabs(snaps[i].primary_tone.carrier_hz - 200.0) > 1e-9)
+      fail("snapshot content mismatch");
+  }
+  if (sbx_context_read_telemetry(ctx, snaps, 64) != 0)
+    fail("read should consume snapshots");
+
+  /* A full ring drops and counts new snapshots instead of blocking. */
+  expect_ok(sbx_context_set_telemetry_stream(ctx, 1000.0, 4), "resize stream failed");
+  for (i = 0; i < 20; i++)
+    expect_ok(sbx_context_render_f32(ctx, buf, 256), "render into full ring failed");
+  if (sbx_context_read_telemetry(ctx, snaps, 64) != 4)
+    fail("full ring should hold exactly its capacity");
+  if (sbx_context_telemetry_dropped(ctx) != 16)
+    fail("dropped snapshot count mismatch");
+
+  /* Seeking restarts the grid at the new transport position. */
+  expect_ok(sbx_context_set_telemetry_stream(ctx, 10.0, 16), "reconfigure stream failed");
+  expect_ok(sbx_context_set_time_sec(ctx, 5.0), "seek failed");
+  expect_ok(sbx_context_render_f32(ctx, buf, 256), "render after seek failed");
+  if (sbx_context_read_telemetry(ctx, snaps, 16) != 1 || fabs(snaps[0].time_sec - 5.0) > 1e-9)
+    fail("first block after a seek should publish a snapshot");
+
+  /* Render and read concurrently from two threads. */
+  memset(&rd, 0, sizeof(rd));
+  rd.ctx = ctx;
+  rd.last_t = 5.0;
+  expect_ok(sbx_context_set_telemetry_stream(ctx, 441.0, 8), "threaded stream setup failed");
+  if (pthread_create(&th, 0, reader_main, &rd) != 0)
+    fail("pthread_create failed");
+  for (i = 0; i < 2000; i++)
+    expect_ok(sbx_context_render_f32(ctx, buf, 100), "threaded render failed");
+  __atomic_store_n(&rd.done, 1, __ATOMIC_RELEASE);
+  if (pthread_join(th, 0) != 0)
+    fail("pthread_join failed");
+  if (rd.out_of_order)
+    fail("snapshots should arrive in time order");
+  if (rd.count + sbx_context_telemetry_dropped(ctx) != 2000)
+    fail("every due snapshot should be either delivered or counted as dropped");
+
+  expect_ok(sbx_context_set_telemetry_stream(ctx, 0.0, 0), "disable stream failed");
+  sbx_context_destroy(ctx);
+  printf("PASS: telemetry stream decimates, bounds, and delivers snapshots lock-free\n");
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+#define N_FILES 40
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static void *
+worker_main(void *vp) {
+  if (sbx_validate_batch_work((SbxValidateBatch *)vp) != SBX_OK)
+    fail("sbx_validate_batch_work failed");
+  return NULL;
+}
+
+static const char *
+file_text(size_t i) {
+  switch (i % 5) {
+  case 0: return "alpha: 200+10/20\nNOW alpha\n+00:01:00 alpha\n";
+  case 1: return "alpha: 200+10/20\nNOW alpha\n+00:01:00 nosuch\n";
+  case 2: return "beat = 10 - 6*ramp(t, 0, T)\ncarrier = 200\n";
+  case 3: return "# wrapper\n-p drop 00ds+\n";
+  default: return "beat = 10 +\n";
+  }
+}
+
+static void
+file_path(size_t i, char *out, size_t out_sz) {
+  snprintf(out, out_sz, "/tmp/sbagenxlib_vbatch_%02lu.%s", (unsigned long)i,
+           (i % 5 == 2 || i % 5 == 4) ? "sbgf" : "sbg");
+}
+
+int
+main(void) {
+  char paths[N_FILES + 1][64];
+  const char *ptrs[N_FILES + 1];
+  SbxValidateBatch *batch;
+  SbxValidateBatchResult res;
+  SbxValidateBatchStats st;
+  pthread_t th[4];
+  char err[256];
+  const char *path;
+  size_t i, j;
+  FILE *fp;
+  char *json;
+  long json_len;
+
+  for (i = 0; i < N_FILES; i++) {
+    file_path(i, paths[i], sizeof(paths[i]));
+    fp = fopen(paths[i], "wb");
+    if (!fp || fputs(file_text(i), fp) < 0) fail("cannot write temp file");
+    fclose(fp);
+    ptrs[i] = paths[i];
+  }
+  strcpy(paths[N_FILES], "/tmp/sbagenxlib_vbatch_missing \"q\".sbg");
+  ptrs[N_FILES] = paths[N_FILES];
+  remove(paths[N_FILES]);
+
+  batch = sbx_validate_batch_create(ptrs, N_FILES + 1, err, sizeof(err));
+  if (!batch) fail(err);
+  if (sbx_validate_batch_count(batch) != N_FILES + 1) fail("batch count mismatch");
+  if (sbx_validate_batch_get_result(batch, 0, NULL, &res) != SBX_OK || res.status != -1)
+    fail("results should be pending before any work");
+  for (i = 0; i < 4; i++) {
+    if (pthread_create(&th[i], NULL, worker_main, batch) != 0)
+      fail("pthread_create failed");
+  }
+  for (i = 0; i < 4; i++)
+    pthread_join(th[i], NULL);
+
+  /* Every file must match its serial validation exactly. */
+  for (i = 0; i < N_FILES; i++) {
+    SbxDiagnostic *diags = 0;
+    size_t count = 0;
+    int rc;
+    if (sbx_validate_batch_get_result(batch, i, &path, &res) != SBX_OK)
+      fail("sbx_validate_batch_get_result failed");
+    if (strcmp(path, paths[i]) != 0) fail("batch result path mismatch");
+    if (i % 5 == 3) {
+      if (res.status != SBX_OK || res.error_count || res.warning_count != 1 ||
+          strcmp(res.diags[0].code, "sbg-wrapper") != 0)
+        fail("option-only wrapper should give one sbg-wrapper warning");
+      continue;
+    }
+    if (i % 5 == 2 || i % 5 == 4)
+      rc = sbx_validate_sbgf_text(file_text(i), paths[i], &diags, &count);
+    else
+      rc = sbx_validate_sbg_text(file_text(i), paths[i], &diags, &count);
+    if (res.status != rc || res.diag_count != count)
+      fail("batch result differs from serial validation");
+    for (j = 0; j < count; j++) {
+      if (memcmp(&res.diags[j], &diags[j], sizeof(diags[j])) != 0)
+        fail("batch diagnostic differs from serial validation");
+    }
+    if ((i % 5 == 1 || i % 5 == 4) != (res.error_count > 0))
+      fail("unexpected error count");
+    if (res.byte_count != strlen(file_text(i))) fail("byte count mismatch");
+    sbx_free_diagnostics(diags);
+  }
+  sbx_validate_batch_get_result(batch, N_FILES, NULL, &res);
+  if (res.error_count != 1 || strcmp(res.diags[0].code, "file-read") != 0)
+    fail("missing file should give a file-read error");
+  if (sbx_validate_batch_get_result(batch, N_FILES + 1, NULL, &res) != SBX_EINVAL)
+    fail("out of range result should fail");
+
+  sbx_validate_batch_get_stats(batch, &st);
+  if (st.file_count != N_FILES + 1 || st.failed_count != 2 * N_FILES / 5 + 1)
+    fail("batch stats mismatch");
+  if (!(st.wall_sec > 0.0) || !(st.busy_sec > 0.0)) fail("batch timings missing");
+
+  fp = tmpfile();
+  if (!fp || sbx_validate_batch_write_jsonl(batch, fp) != SBX_OK)
+    fail("sbx_validate_batch_write_jsonl failed");
+  json_len = ftell(fp);
+  rewind(fp);
+  json = (char *)malloc((size_t)json_len + 1);
+  if (!json || fread(json, 1, (size_t)json_len, fp) != (size_t)json_len)
+    fail("cannot read back JSON lines");
+  json[json_len] = 0;
+  fclose(fp);
+  for (i = 0, j = 0; i < (size_t)json_len; i++)
+    if (json[i] == '\n') j++;
+  if (j != N_FILES + 2) fail("expected one JSON line per file plus a summary");
+  if (!strstr(json, "{\"path\":\"/tmp/sbagenxlib_vbatch_01.sbg\",\"status\":\"error\""))
+    fail("JSON error record mismatch");
+  if (!strstr(json, "\"code\":\"sbg-parse\",\"line\":3,\"column\":11,\"end_line\":3,\"end_column\":17"))
+    fail("JSON diagnostic span mismatch");
+  if (!strstr(json, "vbatch_missing \\\"q\\\".sbg")) fail("JSON string escaping mismatch");
+  if (!strstr(json, "{\"summary\":{\"files\":41,\"failed\":17,")) fail("JSON summary mismatch");
+  free(json);
+  sbx_validate_batch_destroy(batch);
+
+  batch = sbx_validate_batch_create(NULL, 1, err, sizeof(err));
+  if (batch || !err[0]) fail("NULL path list should be rejected");
+
+  /*
+   * A path that is not UTF-8: a stray byte, a valid e-acute, a surrogate,
+   * an overlong '/', and a sequence cut short. Each bad byte becomes U+FFFD.
+   */
+  path = "/tmp/sbagenxlib_vbatch_\xff_\xc3\xa9_\xed\xa0\x80_\xc0\xaf_\xe2\x82.sbg";
+  remove(path);
+  batch = sbx_validate_batch_create(&path, 1, err, sizeof(err));
+  if (!batch) fail(err);
+  if (sbx_validate_batch_work(batch) != SBX_OK) fail("sbx_validate_batch_work failed");
+  fp = tmpfile();
+  if (!fp || sbx_validate_batch_write_jsonl(batch, fp) != SBX_OK)
+    fail("sbx_validate_batch_write_jsonl failed");
+  json_len = ftell(fp);
+  rewind(fp);
+  json = (char *)malloc((size_t)json_len + 1);
+  if (!json || fread(json, 1, (size_t)json_len, fp) != (size_t)json_len)
+    fail("cannot read back JSON lines");
+  json[json_len] = 0;
+  fclose(fp);
+#define FFFD "\xef\xbf\xbd"
+  if (!strstr(json, "\"/tmp/sbagenxlib_vbatch_" FFFD "_\xc3\xa9_" FFFD FFFD FFFD "_"
+                    FFFD FFFD "_" FFFD FFFD ".sbg\""))
+    fail("JSON should replace bytes that are not UTF-8 with U+FFFD");
+#undef FFFD
+  for (i = 0; i < (size_t)json_len; i++) {
+    unsigned char c = (unsigned char)json[i];
+    if (c == 0xff || c == 0xc0 || c == 0xed) fail("JSON kept a byte that is not UTF-8");
+  }
+  free(json);
+  sbx_validate_batch_destroy(batch);
+
+  for (i = 0; i < N_FILES; i++) remove(paths[i]);
+  printf("PASS: sbagenxlib validation batch API checks\n");
+  return 0;
+}
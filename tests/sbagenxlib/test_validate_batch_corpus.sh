@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+BIN="$ROOT_DIR/dist/sbagenx-linux64"
+OUT=/tmp/sbx_validate_batch_corpus.jsonl
+
+if [[ ! -x "$BIN" ]]; then
+  echo "FAIL: expected built binary at $BIN" >&2
+  exit 1
+fi
+
+mapfile -t FILES < <(find "$ROOT_DIR/examples" -type f -name '*.sbg' | sort)
+
+if [[ ${#FILES[@]} -eq 0 ]]; then
+  echo "FAIL: no .sbg examples found under $ROOT_DIR/examples" >&2
+  exit 1
+fi
+
+# Same skip list as test_seq_backend_full_example_corpus.sh.
+should_skip() {
+  local rel="$1"
+  case "$rel" in
+    examples/basics/prog-drop-old-demo.sbg)
+      return 0
+      ;;
+  esac
+  return 1
+}
+
+CHECKED=()
+SKIP_COUNT=0
+
+for file in "${FILES[@]}"; do
+  rel="$(realpath --relative-to="$ROOT_DIR" "$file")"
+  if should_skip "$rel"; then
+    SKIP_COUNT=$((SKIP_COUNT + 1))
+    continue
+  fi
+  CHECKED+=("$file")
+done
+
+# Every example the -D smoke test accepts must also pass the parallel validator.
+if ! printf '%s\n' "${CHECKED[@]}" | "$BIN" -Q --validate-batch --validate-jobs 4 - >"$OUT"; then
+  grep '"status":"\(error\|failed\)"' "$OUT" | head -n 3 >&2 || true
+  echo "FAIL: --validate-batch reported errors" >&2
+  exit 1
+fi
+
+if ! grep -q "\"summary\":{\"files\":${#CHECKED[@]}," "$OUT"; then
+  tail -n 1 "$OUT" >&2 || true
+  echo "FAIL: --validate-batch summary should cover ${#CHECKED[@]} files" >&2
+  exit 1
+fi
+
+echo "PASS: validate-batch example corpus test (${#CHECKED[@]} examples, $SKIP_COUNT skipped)"
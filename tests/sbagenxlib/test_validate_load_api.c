@@ -0,0 +1,147 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+static float *
+render(SbxContext *ctx, size_t frames) {
+  float *buf = (float *)calloc(frames * 2, sizeof(float));
+  if (!buf) fail("alloc failed (render)");
+  if (sbx_context_render_f32(ctx, buf, frames) != SBX_OK)
+    fail("render failed");
+  return buf;
+}
+
+/* The single-pass result must lead with what sbx_validate_sbg_text reports. */
+static void
+check_failure(const char *text, size_t min_count, const char *what) {
+  SbxDiagnostic *diags = 0, *first = 0;
+  size_t count = 0, first_count = 0;
+  SbxContext *ctx = (SbxContext *)1;
+  SbxSafeSeqfilePreamble pre;
+  char msg[256];
+
+  if (sbx_validate_and_load_sbg_text(text, 0, &ctx, &pre, &diags, &count) != SBX_OK)
+    fail("sbx_validate_and_load_sbg_text failed");
+  if (sbx_validate_sbg_text(text, 0, &first, &first_count) != SBX_OK || first_count != 1)
+    fail("sbx_validate_sbg_text should report one error");
+  snprintf(msg, sizeof(msg), "%s: %lu diagnostics", what, (unsigned long)count);
+  if (ctx) fail("a failing document should not return a context");
+  if (count < min_count) fail(msg);
+  if (strcmp(diags[0].message, first[0].message) != 0 || diags[0].line != first[0].line ||
+      diags[0].column != first[0].column || diags[0].end_column != first[0].end_column)
+    fail("first diagnostic should match sbx_validate_sbg_text");
+  sbx_free_safe_seqfile_preamble(&pre);
+  sbx_free_diagnostics(diags);
+  sbx_free_diagnostics(first);
+}
+
+int
+main(void) {
+  const char *text =
+      "-SE\n"
+      "-r 8000\n"
+      "-w triangle\n"
+      "custom00: e=2 0 0.2 1 0.2 0\n"
+      "alpha: mix/60 200+10/20 custom00:300@4/15\n"
+      "beta: 220+6/15\n"
+      "NOW alpha\n"
+      "+00:00:01 beta ->\n"
+      "+00:00:02 alpha\n";
+  const char *path = "/tmp/sbagenxlib_validate_load_test.sbgc";
+  const size_t frames = 8000 * 3;
+  SbxSbgLoadConfig cfg;
+  SbxEngineConfig eng;
+  SbxSafeSeqfilePreamble pre;
+  SbxContext *ctx, *ref, *dst;
+  SbxDiagnostic *diags;
+  size_t count;
+  char *prepared;
+  char err[256];
+  float *a, *b;
+
+  sbx_default_sbg_load_config(&cfg);
+  if (!cfg.rate_from_preamble || cfg.loop || cfg.engine.sample_rate != 44100.0)
+    fail("load config defaults mismatch");
+  if (sbx_validate_and_load_sbg_text(0, 0, &ctx, 0, &diags, &count) != SBX_EINVAL)
+    fail("NULL text should be rejected");
+
+  /* One call against prepare + create + load done by hand. */
+  if (sbx_validate_and_load_sbg_text(text, &cfg, &ctx, &pre, &diags, &count) != SBX_OK)
+    fail("sbx_validate_and_load_sbg_text failed");
+  if (count != 0 || diags || !ctx) fail("valid document should load without diagnostics");
+  if (!pre.have_r || pre.rate != 8000 || !pre.opt_E || !pre.have_w)
+    fail("preamble should be returned");
+
+  sbx_default_safe_seqfile_preamble(&pre);
+  if (sbx_prepare_safe_seq_text(text, &prepared, &pre, err, sizeof(err)) != SBX_OK) fail(err);
+  sbx_default_engine_config(&eng);
+  eng.sample_rate = 8000.0;
+  ref = sbx_context_create(&eng);
+  if (!ref || sbx_context_set_default_waveform(ref, pre.waveform) != SBX_OK ||
+      sbx_context_load_sbg_timing_text(ref, prepared, 0) != SBX_OK)
+    fail("reference load failed");
+  free(prepared);
+  sbx_free_safe_seqfile_preamble(&pre);
+  if (sbx_context_keyframe_count(ctx) != sbx_context_keyframe_count(ref) ||
+      sbx_context_duration_sec(ctx) != sbx_context_duration_sec(ref))
+    fail("loaded program mismatch");
+  a = render(ctx, frames);
+  b = render(ref, frames);
+  if (memcmp(a, b, frames * 2 * sizeof(float)) != 0)
+    fail("single-pass load should render like a separate load");
+  if (fabs(sbx_context_time_sec(ctx) - 3.0) > 1e-9)
+    fail("-r should set the context sample rate");
+  free(a);
+  free(b);
+
+  /* The loaded context compiles as is. */
+  if (sbx_context_save_compiled(ctx, path, "-SE\n-r 8000\n") != SBX_OK)
+    fail("loaded context should compile");
+  dst = sbx_context_create(&eng);
+  if (!dst || sbx_context_load_compiled(dst, path, 0) != SBX_OK)
+    fail("compiled program should load");
+  if (sbx_context_keyframe_count(dst) != sbx_context_keyframe_count(ref))
+    fail("compiled keyframe count mismatch");
+  remove(path);
+  sbx_context_destroy(dst);
+  sbx_context_destroy(ref);
+  sbx_context_destroy(ctx);
+
+  /* Host rate wins when the preamble rate is not wanted; validation only. */
+  cfg.engine.sample_rate = 16000.0;
+  cfg.rate_from_preamble = 0;
+  cfg.loop = 1;
+  if (sbx_validate_and_load_sbg_text(text, &cfg, &ctx, 0, &diags, &count) != SBX_OK || !ctx)
+    fail("load with host rate failed");
+  a = render(ctx, 1600);
+  if (fabs(sbx_context_time_sec(ctx) - 0.1) > 1e-9)
+    fail("host sample rate should be kept");
+  if (!sbx_context_is_looping(ctx)) fail("loop flag should reach the loader");
+  free(a);
+  sbx_context_destroy(ctx);
+  if (sbx_validate_and_load_sbg_text(text, &cfg, 0, 0, &diags, &count) != SBX_OK || count)
+    fail("validation-only call failed");
+
+  /* Failures list every broken line, led by the load error. */
+  check_failure("alpha: 200+10/20\n"
+                "NOW alpha\n"
+                "+00:00:01 nosuch\n"
+                "+00:00:02 alpha 300+\n"
+                "+00:00:03 other\n",
+                3, "timing errors");
+  check_failure("-w bogus\nNOW nosuch\n", 2, "preamble error");
+  check_failure("# nothing\n", 1, "empty program");
+  check_failure("alpha: 200+10/20\nblk: {\n  +00:00 alpha\n  +00:01 nosuch\n", 2,
+                "unterminated block");
+  printf("PASS: sbagenxlib validate and load API checks\n");
+  return 0;
+}
@@ -0,0 +1,8 @@
+#!/usr/bin/env bash
+set -euo pipefail
+cd "$(dirname "$0")/../.."
+cc -I. -Itests/sbagenxlib -Wall -Wextra \
+  -o /tmp/test_validate_load_api \
+  tests/sbagenxlib/test_validate_load_api.c \
+  sbagenxlib.c -lm -ldl -lpthread
+/tmp/test_validate_load_api
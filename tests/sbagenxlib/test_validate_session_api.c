@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sbagenxlib.h"
+
+static void
+fail(const char *msg) {
+  fprintf(stderr, "FAIL: %s\n", msg);
+  exit(1);
+}
+
+/* The document as lines, mirrored by hand next to the session. */
+typedef struct {
+  char **v;
+  size_t n, cap;
+} Doc;
+
+static void
+doc_insert(Doc *d, size_t at, const char *line) {
+  if (d->n == d->cap) {
+    d->cap = d->cap ? d->cap * 2 : 64;
+    d->v = (char **)realloc(d->v, d->cap * sizeof(*d->v));
+    if (!d->v) fail("alloc failed (doc)");
+  }
+  memmove(d->v + at + 1, d->v + at, (d->n - at) * sizeof(*d->v));
+  d->v[at] = strdup(line);
+  if (!d->v[at]) fail("alloc failed (line)");
+  d->n++;
+}
+
+static void
+doc_remove(Doc *d, size_t at) {
+  free(d->v[at]);
+  memmove(d->v + at, d->v + at + 1, (d->n - at - 1) * sizeof(*d->v));
+  d->n--;
+}
+
+static char *
+doc_text(const Doc *d) {
+  size_t len = 0, i;
+  char *text, *p;
+  for (i = 0; i < d->n; i++) len += strlen(d->v[i]) + 1;
+  text = (char *)malloc(len + 1);
+  if (!text) fail("alloc failed (text)");
+  p = text;
+  for (i = 0; i < d->n; i++) {
+    size_t n = strlen(d->v[i]);
+    memcpy(p, d->v[i], n);
+    p += n;
+    if (i + 1 < d->n) *p++ = '\n';
+  }
+  *p = 0;
+  return text;
+}
+
+/* Lines that define, use, break and reshape things. */
+static const char *pool[] = {
+    "alpha: 200+10/20",
+    "alpha: 220+6/15 mix/50",
+    "beta: alpha 300+4/10",
+    "beta: nosuch",
+    "gamma: beta",
+    "wave03: 0 0.5 1 0.5",
+    "wave03: 0 1",
+    "custom01: e=2 0 0.3 1 0.3 0",
+    "noise02: 3 2 1 0 -1 -2",
+    "blk: {",
+    "inner: {",
+    "  +00:00 alpha",
+    "  +00:00:01 beta ->",
+    "  +00:00:02 inner",
+    "  +00:00:03 blk",
+    "  oops alpha",
+    "}",
+    "} extra",
+    "NOW alpha",
+    "+00:00:05 beta",
+    "00:01:00 blk",
+    "00:02:00 inner",
+    "00:03:00 <> gamma",
+    "00:04:00 wave03:150+2/10",
+    "00:05:00 custom01:mixpulse:2/30",
+    "12:00 nosuch",
+    "00:06:00",
+    "-SE",
+    "-r 8000",
+    "-w triangle",
+    "# comment",
+    "",
+};
+#define POOL_COUNT (sizeof(pool) / sizeof(pool[0]))
+
+static unsigned long rng_state = 12345;
+
+static unsigned
+rng(unsigned n) {
+  rng_state = rng_state * 6364136223846793005UL + 1442695040888963407UL;
+  return (unsigned)((rng_state >> 33) % n);
+}
+
+static void
+check_against_full(SbxValidateSession *s, const Doc *d, const char *what) {
+  char *text = doc_text(d);
+  SbxDiagnostic *full = 0;
+  size_t full_count = 0, count = 0;
+  const SbxDiagnostic *diags = 0;
+  char msg[1400];
+
+  if (sbx_validate_sbg_text(text, 0, &full, &full_count) != SBX_OK)
+    fail("sbx_validate_sbg_text failed");
+  if (sbx_validate_session_diagnostics(s, &diags, &count) != SBX_OK)
+    fail("sbx_validate_session_diagnostics failed");
+  if (sbx_validate_session_line_count(s) != d->n)
+    fail("session line count mismatch");
+  if ((full_count == 0) != (count == 0) ||
+      (full_count && (diags[0].severity != full[0].severity ||
+                      strcmp(diags[0].code, full[0].code) != 0 ||
+                      strcmp(diags[0].message, full[0].message) != 0 ||
+                      diags[0].line != full[0].line || diags[0].column != full[0].column ||
+                      diags[0].end_line != full[0].end_line ||
+                      diags[0].end_column != full[0].end_column))) {
+    snprintf(msg, sizeof(msg), "%s: session says \"%s\" (%u:%u), full validation \"%s\" (%u:%u)\n%s",
+             what, count ? diags[0].message : "ok", count ? diags[0].line : 0,
+             count ? diags[0].column : 0, full_count ? full[0].message : "ok",
+             full_count ? full[0].line : 0, full_count ? full[0].column : 0, text);
+    fail(msg);
+  }
+  sbx_free_diagnostics(full);
+  free(text);
+}
+
+static void
+random_edits(void) {
+  Doc d;
+  SbxValidateSession *s;
+  char *text;
+  char err[256];
+  size_t i, round;
+
+  memset(&d, 0, sizeof(d));
+  for (i = 0; i < 12; i++) doc_insert(&d, d.n, pool[i]);
+  text = doc_text(&d);
+  s = sbx_validate_session_create(text, err, sizeof(err));
+  free(text);
+  if (!s) fail(err);
+  check_against_full(s, &d, "initial");
+
+  for (round = 0; round < 4000; round++) {
+    size_t at = rng((unsigned)d.n + 1);
+    size_t removed = (at < d.n) ? rng((unsigned)(d.n - at < 3 ? d.n - at + 1 : 4)) : 0;
+    size_t added = rng(3);
+    char repl[512];
+    char what[64];
+    repl[0] = 0;
+    for (i = 0; i < removed; i++) doc_remove(&d, at);
+    for (i = 0; i < added; i++) {
+      const char *line = pool[rng(POOL_COUNT)];
+      doc_insert(&d, at + i, line);
+      if (i) strcat(repl, "\n");
+      strcat(repl, line);
+    }
+    /* Keep the document from emptying or growing without bound. */
+    if (d.n == 0) {
+      doc_insert(&d, 0, "NOW alpha");
+      strcpy(repl, "NOW alpha");
+      added = 1;
+    }
+    if (sbx_validate_session_edit(s, at, removed, added ? repl : 0) != SBX_OK)
+      fail("sbx_validate_session_edit failed");
+    snprintf(what, sizeof(what), "edit %lu", (unsigned long)round);
+    check_against_full(s, &d, what);
+    if (d.n > 60) {
+      while (d.n > 20) doc_remove(&d, d.n - 1);
+      if (sbx_validate_session_edit(s, 20, sbx_validate_session_line_count(s) - 20, 0) != SBX_OK)
+        fail("sbx_validate_session_edit (trim) failed");
+      check_against_full(s, &d, "trim");
+    }
+  }
+  sbx_validate_session_destroy(s);
+  for (i = 0; i < d.n; i++) free(d.v[i]);
+  free(d.v);
+}
+
+static double
+now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* 10k lines; only the edited line and the users of a changed name re-parse. */
+static void
+large_document(void) {
+  const size_t lines = 10000;
+  size_t cap = lines * 48 + 256, len, i;
+  char *text = (char *)malloc(cap);
+  SbxValidateSession *s;
+  const SbxDiagnostic *diags;
+  size_t count, users = 0;
+  double t0, worst = 0.0;
+  char err[256];
+
+  if (!text) fail("alloc failed (large)");
+  strcpy(text, "-SE\nalpha: 200+10/20\nbeta: 300+4/10\n");
+  len = strlen(text);
+  for (i = 0; i < lines; i++) {
+    unsigned sec = (unsigned)(i * 2);
+    const char *what = (i % 5 == 0) ? "beta" : "alpha 150+2/10";
+    if (i % 5 == 0) users++;
+    len += (size_t)snprintf(text + len, cap - len, "%02u:%02u:%02u %s\n",
+                            sec / 3600, (sec / 60) % 60, sec % 60, what);
+  }
+  s = sbx_validate_session_create(text, err, sizeof(err));
+  if (!s) fail(err);
+  if (sbx_validate_session_diagnostics(s, &diags, &count) != SBX_OK || count != 0)
+    fail("large document should validate cleanly");
+
+  /* Typing in one timing line. */
+  for (i = 0; i < 50; i++) {
+    size_t at = 3 + (i * 197) % lines;
+    char line[64];
+    snprintf(line, sizeof(line), "%02u:%02u:%02u %s %u+2/10",
+             (unsigned)(at - 3) * 2 / 3600, ((unsigned)(at - 3) * 2 / 60) % 60,
+             (unsigned)(at - 3) * 2 % 60, (at - 3) % 5 == 0 ? "beta" : "alpha",
+             100 + (unsigned)i);
+    t0 = now_sec();
+    if (sbx_validate_session_edit(s, at, 1, line) != SBX_OK) fail("edit failed (large)");
+    if (now_sec() - t0 > worst) worst = now_sec() - t0;
+    if (sbx_validate_session_revalidated_lines(s) != 1)
+      fail("a local timing edit should re-parse one line");
+  }
+
+  /* A typo in beta's definition reaches every line that uses beta. */
+  if (sbx_validate_session_edit(s, 2, 1, "beta: 300+4/") != SBX_OK) fail("edit failed (def)");
+  if (sbx_validate_session_revalidated_lines(s) != users + 1)
+    fail("a definition edit should re-parse the definition and its users");
+  if (sbx_validate_session_diagnostics(s, &diags, &count) != SBX_OK || count != users + 1 ||
+      diags[0].line != 3)
+    fail("a broken definition should flag itself and each user");
+  if (sbx_validate_session_edit(s, 2, 1, "beta: 300+4/10") != SBX_OK) fail("edit failed (fix)");
+  if (sbx_validate_session_diagnostics(s, &diags, &count) != SBX_OK || count != 0)
+    fail("fixing the definition should clear every diagnostic");
+
+  /* A comment line only renumbers the lines below it. */
+  if (sbx_validate_session_edit(s, 1, 0, "# note") != SBX_OK) fail("edit failed (insert)");
+  if (sbx_validate_session_revalidated_lines(s) != 0)
+    fail("inserting a comment should re-parse nothing");
+
+  if (worst > 1.0 / 60.0) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "keystroke edit took %.2f ms on %lu lines",
+             worst * 1000.0, (unsigned long)lines);
+    fail(msg);
+  }
+  sbx_validate_session_destroy(s);
+  free(text);
+}
+
+int
+main(void) {
+  SbxValidateSession *s;
+  const SbxDiagnostic *diags;
+  size_t count;
+  char err[256];
+
+  if (sbx_validate_session_create(0, err, sizeof(err)) != 0 || !err[0])
+    fail("NULL text should be rejected");
+
+  s = sbx_validate_session_create("alpha: 200+10/20\nNOW alpha\n", err, sizeof(err));
+  if (!s) fail(err);
+  if (sbx_validate_session_line_count(s) != 3)
+    fail("trailing newline should leave a final empty line");
+  if (sbx_validate_session_edit(s, 4, 0, "x") != SBX_EINVAL ||
+      sbx_validate_session_edit(s, 2, 2, 0) != SBX_EINVAL)
+    fail("out-of-range edits should be rejected");
+  if (sbx_validate_session_edit(s, 1, 1, "NOW alpha\n+00:01 nosuch") != SBX_OK)
+    fail("edit failed");
+  if (sbx_validate_session_diagnostics(s, &diags, &count) != SBX_OK || count != 1 ||
+      diags[0].line != 3 || diags[0].column != 8 || diags[0].end_column != 14)
+    fail("unknown name should be flagged with its span");
+  if (sbx_validate_session_edit(s, 0, 0, "-w bogus") != SBX_OK) fail("edit failed (preamble)");
+  if (sbx_validate_session_diagnostics(s, &diags, &count) != SBX_OK || count != 2 ||
+      diags[0].line != 1 || diags[1].line != 4)
+    fail("preamble error should come first and later lines should renumber");
+  sbx_validate_session_destroy(s);
+
+  random_edits();
+  large_document();
+  printf("PASS: sbagenxlib validate session API checks\n");
+  return 0;
+}